@@ -10,7 +10,7 @@ pgmoneta_cli_completions()
     if [ "${#COMP_WORDS[@]}" == "2" ]; then
         # main completion: the user has specified nothing at all
         # or a single word, that is a command
-        COMPREPLY=($(compgen -W "backup list-backup restore verify archive delete retain expunge encrypt decrypt info ping shutdown status conf clear annotate mode" "${COMP_WORDS[1]}"))
+        COMPREPLY=($(compgen -W "backup list-backup restore verify verify-wal wal-fetch archive delete retain expunge encrypt decrypt info ping shutdown status conf clear annotate mode job" "${COMP_WORDS[1]}"))
     else
         # the user has specified something else
         # subcommand required?
@@ -24,6 +24,9 @@ pgmoneta_cli_completions()
             clear)
                 COMPREPLY+=($(compgen -W "prometheus" "${COMP_WORDS[2]}"))
                 ;;
+            job)
+                COMPREPLY+=($(compgen -W "list cancel subscribe" "${COMP_WORDS[2]}"))
+                ;;
         esac
     fi
 }
@@ -75,6 +75,7 @@
 #define COMMAND_ENCRYPT        "encrypt"
 #define COMMAND_EXPUNGE        "expunge"
 #define COMMAND_INFO           "info"
+#define COMMAND_JOB            "job"
 #define COMMAND_LIST_BACKUP    "list-backup"
 #define COMMAND_MODE           "mode"
 #define COMMAND_PING           "ping"
@@ -86,6 +87,8 @@
 #define COMMAND_STATUS         "status"
 #define COMMAND_STATUS_DETAILS "status-details"
 #define COMMAND_VERIFY         "verify"
+#define COMMAND_VERIFY_WAL     "verify-wal"
+#define COMMAND_WAL_FETCH      "wal-fetch"
 
 #define OUTPUT_FORMAT_JSON "json"
 #define OUTPUT_FORMAT_TEXT "text"
@@ -113,14 +116,17 @@ static void help_clear(void);
 static void help_info(void);
 static void help_annotate(void);
 static void help_mode(void);
+static void help_verify_wal(void);
+static void help_wal_fetch(void);
+static void help_job(void);
 static void display_helper(char* command);
 
-static int backup(SSL* ssl, int socket, char* server, uint8_t compression, uint8_t encryption, char* incremental, int32_t output_format);
+static int backup(SSL* ssl, int socket, char* server, bool async, int32_t priority, uint8_t compression, uint8_t encryption, char* incremental, int32_t output_format);
 static int list_backup(SSL* ssl, int socket, char* server, char* sort_order, uint8_t compression, uint8_t encryption, int32_t output_format);
-static int restore(SSL* ssl, int socket, char* server, char* backup_id, char* position, char* directory, uint8_t compression, uint8_t encryption, int32_t output_format);
-static int verify(SSL* ssl, int socket, char* server, char* backup_id, char* directory, char* files, uint8_t compression, uint8_t encryption, int32_t output_format);
-static int archive(SSL* ssl, int socket, char* server, char* backup_id, char* position, char* directory, uint8_t compression, uint8_t encryption, int32_t output_format);
-static int delete(SSL* ssl, int socket, char* server, char* backup_id, uint8_t compression, uint8_t encryption, int32_t output_format);
+static int restore(SSL* ssl, int socket, char* server, char* backup_id, char* position, char* directory, bool async, int32_t priority, uint8_t compression, uint8_t encryption, int32_t output_format);
+static int verify(SSL* ssl, int socket, char* server, char* backup_id, char* directory, char* files, bool async, int32_t priority, uint8_t compression, uint8_t encryption, int32_t output_format);
+static int archive(SSL* ssl, int socket, char* server, char* backup_id, char* position, char* directory, bool async, int32_t priority, uint8_t compression, uint8_t encryption, int32_t output_format);
+static int delete(SSL* ssl, int socket, char* server, char* backup_id, bool async, int32_t priority, uint8_t compression, uint8_t encryption, int32_t output_format);
 static int pgmoneta_shutdown(SSL* ssl, int socket, uint8_t compression, uint8_t encryption, int32_t output_format);
 static int status(SSL* ssl, int socket, uint8_t compression, uint8_t encryption, int32_t output_format);
 static int details(SSL* ssl, int socket, uint8_t compression, uint8_t encryption, int32_t output_format);
@@ -140,9 +146,14 @@ static int compress_data_server(SSL* ssl, int socket, char* path, uint8_t compre
 static int info(SSL* ssl, int socket, char* server, char* backup, uint8_t compression, uint8_t encryption, int32_t output_format);
 static int annotate(SSL* ssl, int socket, char* server, char* backup, char* command, char* key, char* comment, uint8_t compression, uint8_t encryption, int32_t output_format);
 static int mode(SSL* ssl, int socket, char* server, char* action, uint8_t compression, uint8_t encryption, int32_t output_format);
+static int verify_wal(SSL* ssl, int socket, char* server, uint8_t compression, uint8_t encryption, int32_t output_format);
+static int wal_fetch(SSL* ssl, int socket, char* server, char* file, char* path, uint8_t compression, uint8_t encryption, int32_t output_format);
 static int conf_ls(SSL* ssl, int socket, uint8_t compression, uint8_t encryption, int32_t output_format);
 static int conf_get(SSL* ssl, int socket, char* config_key, uint8_t compression, uint8_t encryption, int32_t output_format);
 static int conf_set(SSL* ssl, int socket, char* config_key, char* config_value, uint8_t compression, uint8_t encryption, int32_t output_format);
+static int job_list(SSL* ssl, int socket, uint8_t compression, uint8_t encryption, int32_t output_format);
+static int job_cancel(SSL* ssl, int socket, char* job, uint8_t compression, uint8_t encryption, int32_t output_format);
+static int job_subscribe(SSL* ssl, int socket, char* job, uint8_t compression, uint8_t encryption, int32_t output_format);
 
 static int process_result(SSL* ssl, int socket, int32_t output_format);
 static int process_get_result(SSL* ssl, int socket, char* param, int32_t output_format);
@@ -200,6 +211,8 @@ usage(void)
    printf("  -E, --encrypt none|aes|aes256|aes192|aes128    Encrypt the wire protocol\n");
    printf("  -s, --sort asc|desc                            Sort result (for list-backup)\n");
    printf("      --cascade                                  Cascade a retain/expunge backup\n");
+   printf("      --async                                    Queue the command as a job and return at once\n");
+   printf("      --priority PRIORITY                        Set the priority of the job (higher runs first)\n");
    printf("  -?, --help                                     Display help\n");
    printf("\n");
    printf("Commands:\n");
@@ -222,6 +235,10 @@ usage(void)
    printf("  encrypt                  Encrypt a file using master-key\n");
    printf("  expunge                  Expunge a backup from a server\n");
    printf("  info                     Information about a backup\n");
+   printf("  job <action>             Manage the jobs, with one of subcommands:\n");
+   printf("                           - 'list' to list the jobs\n");
+   printf("                           - 'cancel' to cancel a job\n");
+   printf("                           - 'subscribe' to follow the progress of a job\n");
    printf("  list-backup              List the backups for a server\n");
    printf("  mode                     Switch the mode for a server\n");
    printf("  ping                     Check if pgmoneta is alive\n");
@@ -230,6 +247,8 @@ usage(void)
    printf("  shutdown                 Shutdown pgmoneta\n");
    printf("  status [details]         Status of pgmoneta, with optional details\n");
    printf("  verify                   Verify a backup from a server\n");
+   printf("  verify-wal               Verify the WAL archive of a server\n");
+   printf("  wal-fetch                Fetch a WAL file for restore_command\n");
    printf("\n");
    printf("pgmoneta: %s\n", PGMONETA_HOMEPAGE);
    printf("Report bugs: %s\n", PGMONETA_ISSUES);
@@ -427,6 +446,46 @@ struct pgmoneta_command command_table[] = {
       .action = MANAGEMENT_MODE,
       .deprecated = false,
       .log_message = "<mode> [%s]"
+   },
+   {
+      .command = "verify-wal",
+      .subcommand = "",
+      .accepted_argument_count = {1},
+      .action = MANAGEMENT_VERIFY_WAL,
+      .deprecated = false,
+      .log_message = "<verify-wal> [%s]"
+   },
+   {
+      .command = "wal-fetch",
+      .subcommand = "",
+      .accepted_argument_count = {3},
+      .action = MANAGEMENT_WAL_FETCH,
+      .deprecated = false,
+      .log_message = "<wal-fetch> [%s]"
+   },
+   {
+      .command = "job",
+      .subcommand = "list",
+      .accepted_argument_count = {0},
+      .action = MANAGEMENT_JOB_LIST,
+      .deprecated = false,
+      .log_message = "<job list>"
+   },
+   {
+      .command = "job",
+      .subcommand = "cancel",
+      .accepted_argument_count = {1},
+      .action = MANAGEMENT_JOB_CANCEL,
+      .deprecated = false,
+      .log_message = "<job cancel> [%s]"
+   },
+   {
+      .command = "job",
+      .subcommand = "subscribe",
+      .accepted_argument_count = {1},
+      .action = MANAGEMENT_JOB_SUBSCRIBE,
+      .deprecated = false,
+      .log_message = "<job subscribe> [%s]"
    }
 };
 
@@ -461,6 +520,8 @@ main(int argc, char** argv)
    int num_options = 0;
    int num_results = 0;
    bool cascade = false;
+   bool async = false;
+   int32_t priority = 0;
    char* sort_option = NULL;
 
    cli_option options[] = {
@@ -477,6 +538,8 @@ main(int argc, char** argv)
       {"E", "encrypt", true},
       {"s", "sort", true},
       {"", "cascade", false},
+      {"", "async", false},
+      {"", "priority", true},
       {"?", "help", false}
    };
 
@@ -628,6 +691,14 @@ main(int argc, char** argv)
       {
          cascade = true;
       }
+      else if (!strcmp(optname, "async"))
+      {
+         async = true;
+      }
+      else if (!strcmp(optname, "priority"))
+      {
+         priority = atoi(optarg);
+      }
       else if (!strcmp(optname, "?") || !strcmp(optname, "help"))
       {
          usage();
@@ -852,11 +923,11 @@ execute:
    {
       if (parsed.args[1])
       {
-         exit_code = backup(s_ssl, socket, parsed.args[0], compression, encryption, parsed.args[1], output_format);
+         exit_code = backup(s_ssl, socket, parsed.args[0], async, priority, compression, encryption, parsed.args[1], output_format);
       }
       else
       {
-         exit_code = backup(s_ssl, socket, parsed.args[0], compression, encryption, NULL, output_format);
+         exit_code = backup(s_ssl, socket, parsed.args[0], async, priority, compression, encryption, NULL, output_format);
       }
    }
    else if (parsed.cmd->action == MANAGEMENT_LIST_BACKUP)
@@ -867,38 +938,38 @@ execute:
    {
       if (parsed.args[3])
       {
-         exit_code = restore(s_ssl, socket, parsed.args[0], parsed.args[1], parsed.args[2], parsed.args[3], compression, encryption, output_format);
+         exit_code = restore(s_ssl, socket, parsed.args[0], parsed.args[1], parsed.args[2], parsed.args[3], async, priority, compression, encryption, output_format);
       }
       else
       {
-         exit_code = restore(s_ssl, socket, parsed.args[0], parsed.args[1], NULL, parsed.args[2], compression, encryption, output_format);
+         exit_code = restore(s_ssl, socket, parsed.args[0], parsed.args[1], NULL, parsed.args[2], async, priority, compression, encryption, output_format);
       }
    }
    else if (parsed.cmd->action == MANAGEMENT_VERIFY)
    {
       if (parsed.args[3])
       {
-         exit_code = verify(s_ssl, socket, parsed.args[0], parsed.args[1], parsed.args[2], parsed.args[3], compression, encryption, output_format);
+         exit_code = verify(s_ssl, socket, parsed.args[0], parsed.args[1], parsed.args[2], parsed.args[3], async, priority, compression, encryption, output_format);
       }
       else
       {
-         exit_code = verify(s_ssl, socket, parsed.args[0], parsed.args[1], parsed.args[2], "failed", compression, encryption, output_format);
+         exit_code = verify(s_ssl, socket, parsed.args[0], parsed.args[1], parsed.args[2], "failed", async, priority, compression, encryption, output_format);
       }
    }
    else if (parsed.cmd->action == MANAGEMENT_ARCHIVE)
    {
       if (parsed.args[3])
       {
-         exit_code = archive(s_ssl, socket, parsed.args[0], parsed.args[1], parsed.args[2], parsed.args[3], compression, encryption, output_format);
+         exit_code = archive(s_ssl, socket, parsed.args[0], parsed.args[1], parsed.args[2], parsed.args[3], async, priority, compression, encryption, output_format);
       }
       else
       {
-         exit_code = archive(s_ssl, socket, parsed.args[0], parsed.args[1], NULL, parsed.args[2], compression, encryption, output_format);
+         exit_code = archive(s_ssl, socket, parsed.args[0], parsed.args[1], NULL, parsed.args[2], async, priority, compression, encryption, output_format);
       }
    }
    else if (parsed.cmd->action == MANAGEMENT_DELETE)
    {
-      exit_code = delete(s_ssl, socket, parsed.args[0], parsed.args[1], compression, encryption, output_format);
+      exit_code = delete(s_ssl, socket, parsed.args[0], parsed.args[1], async, priority, compression, encryption, output_format);
    }
    else if (parsed.cmd->action == MANAGEMENT_SHUTDOWN)
    {
@@ -989,6 +1060,14 @@ execute:
    {
       exit_code = mode(s_ssl, socket, parsed.args[0], parsed.args[1], compression, encryption, output_format);
    }
+   else if (parsed.cmd->action == MANAGEMENT_VERIFY_WAL)
+   {
+      exit_code = verify_wal(s_ssl, socket, parsed.args[0], compression, encryption, output_format);
+   }
+   else if (parsed.cmd->action == MANAGEMENT_WAL_FETCH)
+   {
+      exit_code = wal_fetch(s_ssl, socket, parsed.args[0], parsed.args[1], parsed.args[2], compression, encryption, output_format);
+   }
    else if (parsed.cmd->action == MANAGEMENT_CONF_LS)
    {
       exit_code = conf_ls(s_ssl, socket, compression, encryption, output_format);
@@ -1008,6 +1087,18 @@ execute:
    {
       exit_code = conf_set(s_ssl, socket, parsed.args[0], parsed.args[1], compression, encryption, output_format);
    }
+   else if (parsed.cmd->action == MANAGEMENT_JOB_LIST)
+   {
+      exit_code = job_list(s_ssl, socket, compression, encryption, output_format);
+   }
+   else if (parsed.cmd->action == MANAGEMENT_JOB_CANCEL)
+   {
+      exit_code = job_cancel(s_ssl, socket, parsed.args[0], compression, encryption, output_format);
+   }
+   else if (parsed.cmd->action == MANAGEMENT_JOB_SUBSCRIBE)
+   {
+      exit_code = job_subscribe(s_ssl, socket, parsed.args[0], compression, encryption, output_format);
+   }
 
 done:
 
@@ -1191,6 +1282,29 @@ help_mode(void)
    printf("  pgmoneta-cli mode <server> <online|offline>\n");
 }
 
+static void
+help_verify_wal(void)
+{
+   printf("Verify the WAL archive of a server\n");
+   printf("  pgmoneta-cli verify-wal <server>\n");
+}
+
+static void
+help_wal_fetch(void)
+{
+   printf("Fetch a WAL file for restore_command\n");
+   printf("  pgmoneta-cli wal-fetch <server> <file> <path>\n");
+}
+
+static void
+help_job(void)
+{
+   printf("Manage the jobs\n");
+   printf("  pgmoneta-cli job [list]\n");
+   printf("  pgmoneta-cli job [cancel] <job>\n");
+   printf("  pgmoneta-cli job [subscribe] <job>\n");
+}
+
 static void
 display_helper(char* command)
 {
@@ -1274,6 +1388,18 @@ display_helper(char* command)
    {
       help_mode();
    }
+   else if (!strcmp(command, COMMAND_VERIFY_WAL))
+   {
+      help_verify_wal();
+   }
+   else if (!strcmp(command, COMMAND_WAL_FETCH))
+   {
+      help_wal_fetch();
+   }
+   else if (!strcmp(command, COMMAND_JOB))
+   {
+      help_job();
+   }
    else
    {
       usage();
@@ -1281,9 +1407,9 @@ display_helper(char* command)
 }
 
 static int
-backup(SSL* ssl, int socket, char* server, uint8_t compression, uint8_t encryption, char* incremental, int32_t output_format)
+backup(SSL* ssl, int socket, char* server, bool async, int32_t priority, uint8_t compression, uint8_t encryption, char* incremental, int32_t output_format)
 {
-   if (pgmoneta_management_request_backup(ssl, socket, server, compression, encryption, incremental, output_format))
+   if (pgmoneta_management_request_backup(ssl, socket, server, async, priority, compression, encryption, incremental, output_format))
    {
       goto error;
    }
@@ -1321,9 +1447,9 @@ error:
 }
 
 static int
-restore(SSL* ssl, int socket, char* server, char* backup_id, char* position, char* directory, uint8_t compression, uint8_t encryption, int32_t output_format)
+restore(SSL* ssl, int socket, char* server, char* backup_id, char* position, char* directory, bool async, int32_t priority, uint8_t compression, uint8_t encryption, int32_t output_format)
 {
-   if (pgmoneta_management_request_restore(ssl, socket, server, backup_id, position, directory, compression, encryption, output_format))
+   if (pgmoneta_management_request_restore(ssl, socket, server, backup_id, position, directory, async, priority, compression, encryption, output_format))
    {
       goto error;
    }
@@ -1341,9 +1467,9 @@ error:
 }
 
 static int
-verify(SSL* ssl, int socket, char* server, char* backup_id, char* directory, char* files, uint8_t compression, uint8_t encryption, int32_t output_format)
+verify(SSL* ssl, int socket, char* server, char* backup_id, char* directory, char* files, bool async, int32_t priority, uint8_t compression, uint8_t encryption, int32_t output_format)
 {
-   if (pgmoneta_management_request_verify(ssl, socket, server, backup_id, directory, files, compression, encryption, output_format))
+   if (pgmoneta_management_request_verify(ssl, socket, server, backup_id, directory, files, async, priority, compression, encryption, output_format))
    {
       goto error;
    }
@@ -1361,9 +1487,9 @@ error:
 }
 
 static int
-archive(SSL* ssl, int socket, char* server, char* backup_id, char* position, char* directory, uint8_t compression, uint8_t encryption, int32_t output_format)
+archive(SSL* ssl, int socket, char* server, char* backup_id, char* position, char* directory, bool async, int32_t priority, uint8_t compression, uint8_t encryption, int32_t output_format)
 {
-   if (pgmoneta_management_request_archive(ssl, socket, server, backup_id, position, directory, compression, encryption, output_format))
+   if (pgmoneta_management_request_archive(ssl, socket, server, backup_id, position, directory, async, priority, compression, encryption, output_format))
    {
       goto error;
    }
@@ -1381,9 +1507,9 @@ error:
 }
 
 static int
-delete(SSL* ssl, int socket, char* server, char* backup_id, uint8_t compression, uint8_t encryption, int32_t output_format)
+delete(SSL* ssl, int socket, char* server, char* backup_id, bool async, int32_t priority, uint8_t compression, uint8_t encryption, int32_t output_format)
 {
-   if (pgmoneta_management_request_delete(ssl, socket, server, backup_id, compression, encryption, output_format))
+   if (pgmoneta_management_request_delete(ssl, socket, server, backup_id, async, priority, compression, encryption, output_format))
    {
       goto error;
    }
@@ -1885,6 +2011,82 @@ error:
    return 1;
 }
 
+static int
+verify_wal(SSL* ssl, int socket, char* server, uint8_t compression, uint8_t encryption, int32_t output_format)
+{
+   if (pgmoneta_management_request_verify_wal(ssl, socket, server, compression, encryption, output_format))
+   {
+      goto error;
+   }
+
+   if (process_result(ssl, socket, output_format))
+   {
+      goto error;
+   }
+
+   return 0;
+
+error:
+
+   return 1;
+}
+
+static int
+wal_fetch(SSL* ssl, int socket, char* server, char* file, char* path, uint8_t compression, uint8_t encryption, int32_t output_format)
+{
+   char cwd[MAX_PATH];
+   char* p = NULL;
+   struct json* read = NULL;
+   struct json* outcome = NULL;
+
+   /* restore_command gets a path relative to the data directory */
+   if (path[0] != '/')
+   {
+      memset(&cwd[0], 0, sizeof(cwd));
+      if (getcwd(&cwd[0], sizeof(cwd)) == NULL)
+      {
+         goto error;
+      }
+
+      p = pgmoneta_append(p, &cwd[0]);
+      p = pgmoneta_append(p, "/");
+   }
+   p = pgmoneta_append(p, path);
+
+   if (pgmoneta_management_request_wal_fetch(ssl, socket, server, file, p, compression, encryption, output_format))
+   {
+      goto error;
+   }
+
+   if (pgmoneta_management_read_json(ssl, socket, NULL, NULL, &read))
+   {
+      goto error;
+   }
+
+   /* The output goes to the PostgreSQL log, so only report failures */
+   outcome = (struct json*)pgmoneta_json_get(read, MANAGEMENT_CATEGORY_OUTCOME);
+   if (outcome == NULL || !(bool)pgmoneta_json_get(outcome, MANAGEMENT_ARGUMENT_STATUS))
+   {
+      if (MANAGEMENT_OUTPUT_FORMAT_JSON == output_format)
+      {
+         pgmoneta_json_print(read, FORMAT_JSON);
+      }
+      goto error;
+   }
+
+   pgmoneta_json_destroy(read);
+   free(p);
+
+   return 0;
+
+error:
+
+   pgmoneta_json_destroy(read);
+   free(p);
+
+   return 1;
+}
+
 static int
 conf_ls(SSL* ssl, int socket, uint8_t compression, uint8_t encryption, int32_t output_format)
 {
@@ -1945,6 +2147,106 @@ error:
    return 1;
 }
 
+static int
+job_list(SSL* ssl, int socket, uint8_t compression, uint8_t encryption, int32_t output_format)
+{
+   if (pgmoneta_management_request_job_list(ssl, socket, compression, encryption, output_format))
+   {
+      goto error;
+   }
+
+   if (process_result(ssl, socket, output_format))
+   {
+      goto error;
+   }
+
+   return 0;
+
+error:
+
+   return 1;
+}
+
+static int
+job_cancel(SSL* ssl, int socket, char* job, uint8_t compression, uint8_t encryption, int32_t output_format)
+{
+   if (pgmoneta_management_request_job_cancel(ssl, socket, strtoull(job, NULL, 10), compression, encryption, output_format))
+   {
+      goto error;
+   }
+
+   if (process_result(ssl, socket, output_format))
+   {
+      goto error;
+   }
+
+   return 0;
+
+error:
+
+   return 1;
+}
+
+static int
+job_subscribe(SSL* ssl, int socket, char* job, uint8_t compression, uint8_t encryption, int32_t output_format)
+{
+   bool done = false;
+   bool status = true;
+   struct json* read = NULL;
+   struct json* outcome = NULL;
+
+   if (pgmoneta_management_request_job_subscribe(ssl, socket, strtoull(job, NULL, 10), compression, encryption, output_format))
+   {
+      goto error;
+   }
+
+   /* Progress events are sent until the job is done, and only the last one has an outcome */
+   while (!done)
+   {
+      if (pgmoneta_management_read_json(ssl, socket, NULL, NULL, &read))
+      {
+         goto error;
+      }
+
+      outcome = (struct json*)pgmoneta_json_get(read, MANAGEMENT_CATEGORY_OUTCOME);
+      if (outcome != NULL)
+      {
+         done = true;
+         status = (bool)pgmoneta_json_get(outcome, MANAGEMENT_ARGUMENT_STATUS);
+      }
+
+      if (MANAGEMENT_OUTPUT_FORMAT_RAW != output_format)
+      {
+         translate_json_object(read);
+      }
+
+      if (MANAGEMENT_OUTPUT_FORMAT_TEXT == output_format)
+      {
+         pgmoneta_json_print(read, FORMAT_TEXT);
+      }
+      else
+      {
+         pgmoneta_json_print(read, FORMAT_JSON);
+      }
+
+      pgmoneta_json_destroy(read);
+      read = NULL;
+   }
+
+   if (!status)
+   {
+      goto error;
+   }
+
+   return 0;
+
+error:
+
+   pgmoneta_json_destroy(read);
+
+   return 1;
+}
+
 static int
 process_result(SSL* ssl, int socket, int32_t output_format)
 {
@@ -2521,6 +2823,12 @@ translate_command(int32_t cmd_code)
       case MANAGEMENT_MODE:
          command_output = pgmoneta_append(command_output, COMMAND_MODE);
          break;
+      case MANAGEMENT_VERIFY_WAL:
+         command_output = pgmoneta_append(command_output, COMMAND_VERIFY_WAL);
+         break;
+      case MANAGEMENT_WAL_FETCH:
+         command_output = pgmoneta_append(command_output, COMMAND_WAL_FETCH);
+         break;
       case MANAGEMENT_CONF_LS:
          command_output = pgmoneta_append(command_output, COMMAND_CONF);
          command_output = pgmoneta_append_char(command_output, ' ');
@@ -2536,6 +2844,21 @@ translate_command(int32_t cmd_code)
          command_output = pgmoneta_append_char(command_output, ' ');
          command_output = pgmoneta_append(command_output, "set");
          break;
+      case MANAGEMENT_JOB_LIST:
+         command_output = pgmoneta_append(command_output, COMMAND_JOB);
+         command_output = pgmoneta_append_char(command_output, ' ');
+         command_output = pgmoneta_append(command_output, "list");
+         break;
+      case MANAGEMENT_JOB_CANCEL:
+         command_output = pgmoneta_append(command_output, COMMAND_JOB);
+         command_output = pgmoneta_append_char(command_output, ' ');
+         command_output = pgmoneta_append(command_output, "cancel");
+         break;
+      case MANAGEMENT_JOB_SUBSCRIBE:
+         command_output = pgmoneta_append(command_output, COMMAND_JOB);
+         command_output = pgmoneta_append_char(command_output, ' ');
+         command_output = pgmoneta_append(command_output, "subscribe");
+         break;
       default:
          break;
    }
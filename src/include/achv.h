@@ -96,12 +96,14 @@ pgmoneta_receive_archive_files(int srv, SSL* ssl, int socket, struct stream_buff
  * @param buffer The stream buffer
  * @param basedir The base directory for the backup data
  * @param tablespaces The user level tablespaces
+ * @param passthrough Keep the server side compressed data archive as received
  * @param bucket The rate limit bucket
  * @param network_bucket The network rate limit bucket
  * @return 0 upon success, otherwise 1
  */
 int
-pgmoneta_receive_archive_stream(int srv, SSL* ssl, int socket, struct stream_buffer* buffer, char* basedir, struct tablespace* tablespaces, struct token_bucket* bucket, struct token_bucket* network_bucket);
+pgmoneta_receive_archive_stream(int srv, SSL* ssl, int socket, struct stream_buffer* buffer, char* basedir, struct tablespace* tablespaces, bool passthrough,
+                                struct token_bucket* bucket, struct token_bucket* network_bucket);
 
 #ifdef __cplusplus
 }
@@ -51,18 +51,40 @@ struct art
 {
    struct art_node* root;                 /**< The root node of ART */
    uint64_t size;                         /**< The size of the ART */
+   struct memory_arena* arena;            /**< The arena of the nodes, leaves and values, NULL for the heap */
+};
+
+#define ART_ITERATOR_FRAMES 32
+
+/** @struct art_iterator_frame
+ * Defines a position inside an inner node on the iterator stack
+ */
+struct art_iterator_frame
+{
+   struct art_node* node;       /**< The node, or a tagged leaf waiting to be returned */
+   uint32_t position;           /**< The next child slot (Node4/16) or key byte (Node48/256) */
 };
 
 /** @struct art_iterator
- * Defines an art_iterator
+ * Defines an art_iterator, which walks the keys in ascending byte order
  */
 struct art_iterator
 {
-   struct deque* que;           /**< The deque */
-   struct art* tree;            /**< The ART */
-   uint32_t count;              /**< The count of the iterator */
-   char* key;                   /**< The key */
-   struct value* value;         /**< The value */
+   struct art* tree;                                        /**< The ART */
+   uint32_t count;                                          /**< The count of the iterator */
+   char* key;                                               /**< The key */
+   struct value* value;                                     /**< The value */
+   struct art_iterator_frame* stack;                        /**< The traversal stack */
+   uint32_t depth;                                          /**< The number of frames on the stack */
+   uint32_t capacity;                                       /**< The capacity of the stack */
+   void* peek;                                              /**< The leaf found by has_next, if any */
+   bool end;                                                /**< Whether the iteration is exhausted */
+   bool reseek;                                             /**< Whether the stack must be rebuilt after a remove */
+   bool prefix;                                             /**< Whether the bound is a prefix rather than an exclusive upper key */
+   char* bound;                                             /**< The upper bound or prefix, NULL if none */
+   char* resume;                                            /**< The removed key to resume after */
+   size_t resume_size;                                      /**< The size of the resume buffer */
+   struct art_iterator_frame frames[ART_ITERATOR_FRAMES];   /**< The inline stack storage */
 };
 
 /**
@@ -73,6 +95,17 @@ struct art_iterator
 int
 pgmoneta_art_create(struct art** tree);
 
+/**
+ * Initializes an adaptive radix tree whose nodes, leaves, values and
+ * copied strings are allocated from an arena. Deleted entries are only
+ * given back when the arena is reset, so the tree must not outlive it
+ * @param arena The arena, or NULL for the heap
+ * @param tree [out] The tree
+ * @return 0 on success, 1 if otherwise
+ */
+int
+pgmoneta_art_create_with_arena(struct memory_arena* arena, struct art** tree);
+
 /**
  * inserts a new value into the art tree,note that the key is copied while the value is sometimes not(depending on value type)
  * @param t The tree
@@ -141,7 +174,8 @@ int
 pgmoneta_art_clear(struct art* t);
 
 /**
- * Get the next key value pair into iterator
+ * Get the next key value pair into iterator.
+ * Keys are returned in ascending byte order
  * @param iter The iterator
  * @return true if iterator has next, otherwise false
  */
@@ -158,12 +192,43 @@ pgmoneta_art_iterator_has_next(struct art_iterator* iter);
 
 /**
  * Remove the current key value pair the iterator points to.
- * The key and value will be set to NULL afterward.
+ * The key and value will be set to NULL afterward, and the
+ * iteration continues with the key following the removed one.
  * @param iter The iterator
  */
 void
 pgmoneta_art_iterator_remove(struct art_iterator* iter);
 
+/**
+ * Position the iterator so that the next key returned is
+ * the smallest key greater than or equal to the given key.
+ * Any bound set by a previous range or prefix scan is kept
+ * @param iter The iterator
+ * @param key The key
+ * @return 0 on success, otherwise 1
+ */
+int
+pgmoneta_art_iterator_seek(struct art_iterator* iter, char* key);
+
+/**
+ * Restrict the iterator to the keys in [from, to)
+ * @param iter The iterator
+ * @param from The inclusive lower bound, or NULL for the first key
+ * @param to The exclusive upper bound, or NULL for no bound
+ * @return 0 on success, otherwise 1
+ */
+int
+pgmoneta_art_iterator_range(struct art_iterator* iter, char* from, char* to);
+
+/**
+ * Restrict the iterator to the keys starting with a prefix
+ * @param iter The iterator
+ * @param prefix The prefix
+ * @return 0 on success, otherwise 1
+ */
+int
+pgmoneta_art_iterator_prefix(struct art_iterator* iter, char* prefix);
+
 /**
  * Create an art iterator
  * @param t The tree
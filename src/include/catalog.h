@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2025 The pgmoneta community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PGMONETA_CATALOG_H
+#define PGMONETA_CATALOG_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <pgmoneta.h>
+#include <info.h>
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define CATALOG_MAX_BACKUPS 1024
+
+/** @struct catalog_entry
+ * Defines a compact backup record in the catalog
+ */
+struct catalog_entry
+{
+   char label[MISC_LENGTH];        /**< The label of the backup, which is its directory name */
+   char parent_label[MISC_LENGTH]; /**< The label of the parent backup */
+   int type;                       /**< The backup type */
+   char valid;                     /**< Is the backup valid */
+   bool keep;                      /**< Keep the backup */
+   bool sha512;                    /**< Does backup.sha512 exist */
+   uint64_t backup_size;           /**< The backup size */
+   uint64_t restore_size;          /**< The restore size */
+   int parent;                     /**< The index of the parent, or -1 */
+   int child;                      /**< The index of the child, or -1 */
+} __attribute__ ((aligned (64)));
+
+/** @struct catalog_server
+ * Defines the catalog of a server
+ */
+struct catalog_server
+{
+   atomic_int lock;                                   /**< The process holding the lock, or 0 */
+   char name[MISC_LENGTH];                            /**< The name of the server */
+   bool loaded;                                       /**< Is the catalog loaded */
+   unsigned long generation;                          /**< Bumped on every change of the entries */
+   struct timespec mtime;                             /**< The modification time of the backup directory */
+   int number_of_entries;                             /**< The number of entries */
+   struct catalog_entry entries[CATALOG_MAX_BACKUPS]; /**< The entries, sorted by label */
+} __attribute__ ((aligned (64)));
+
+/** @struct catalog
+ * Defines the backup catalog
+ */
+struct catalog
+{
+   int number_of_servers;           /**< The number of servers */
+   struct catalog_server servers[]; /**< The servers */
+};
+
+/**
+ * Create and initialize the backup catalog shared memory
+ * @param size The size of the segment
+ * @param shmem The shared memory segment
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_catalog_init(size_t* size, void** shmem);
+
+/**
+ * Load the catalog of a server from its backup directory
+ * @param server The server
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_catalog_load(int server);
+
+/**
+ * Update the catalog entry of a backup
+ * @param directory The backup directory of the server
+ * @param backup The backup
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_catalog_update(char* directory, struct backup* backup);
+
+/**
+ * Remove a backup from the catalog
+ * @param server The server
+ * @param label The label
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_catalog_remove(int server, char* label);
+
+/**
+ * Get the server of a backup directory
+ * @param directory The directory
+ * @return The server, or -1 if the directory isn't a server backup directory
+ */
+int
+pgmoneta_catalog_server(char* directory);
+
+/**
+ * Get the labels of the backups of a server, in ascending order
+ * @param server The server
+ * @param number_of_labels The number of labels
+ * @param labels The labels
+ * @return 0 upon success, otherwise 1 if the catalog is unavailable
+ */
+int
+pgmoneta_catalog_labels(int server, int* number_of_labels, char*** labels);
+
+/**
+ * Get the number of valid backups of a server
+ * @param server The server
+ * @param number The number of valid backups
+ * @return 0 upon success, otherwise 1 if the catalog is unavailable
+ */
+int
+pgmoneta_catalog_number_of_valid_backups(int server, int* number);
+
+/**
+ * Get the label of the child of a backup
+ * @param server The server
+ * @param label The label
+ * @param child The label of the child, or NULL if there is none
+ * @return 0 upon success, otherwise 1 if the catalog is unavailable
+ */
+int
+pgmoneta_catalog_child(int server, char* label, char** child);
+
+/**
+ * Get the label of the root of an incremental backup chain
+ * @param server The server
+ * @param label The label
+ * @param root The label of the root, or NULL if there is none
+ * @return 0 upon success, otherwise 1 if the catalog is unavailable
+ */
+int
+pgmoneta_catalog_root(int server, char* label, char** root);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -49,4 +49,12 @@ typedef int (*compression_func)(char*, char*);
 int
 pgmoneta_decompress(char* from, char* to);
 
+/**
+ * Get the number of server side compression workers for a server
+ * @param server The server
+ * @return The number of workers, 0 if the server should compress in a single thread
+ */
+int
+pgmoneta_get_compression_workers(int server);
+
 #endif //PGMONETA_COMPRESSION_H
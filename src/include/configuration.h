@@ -48,6 +48,7 @@ extern "C" {
 #define CONFIGURATION_ARGUMENT_ADMIN_CONF_PATH         "admin_configuration_path"
 #define CONFIGURATION_ARGUMENT_AZURE_BASE_DIR         "azure_base_dir"
 #define CONFIGURATION_ARGUMENT_AZURE_CONTAINER        "azure_container"
+#define CONFIGURATION_ARGUMENT_AZURE_ENDPOINT         "azure_endpoint"
 #define CONFIGURATION_ARGUMENT_AZURE_SHARED_KEY       "azure_shared_key"
 #define CONFIGURATION_ARGUMENT_AZURE_STORAGE_ACCOUNT  "azure_storage_account"
 #define CONFIGURATION_ARGUMENT_BACKLOG                "backlog"
@@ -94,6 +95,7 @@ extern "C" {
 #define CONFIGURATION_ARGUMENT_S3_AWS_REGION          "s3_aws_region"
 #define CONFIGURATION_ARGUMENT_S3_BASE_DIR            "s3_base_dir"
 #define CONFIGURATION_ARGUMENT_S3_BUCKET              "s3_bucket"
+#define CONFIGURATION_ARGUMENT_S3_ENDPOINT            "s3_endpoint"
 #define CONFIGURATION_ARGUMENT_S3_SECRET_ACCESS_KEY   "s3_secret_access_key"
 #define CONFIGURATION_ARGUMENT_SSH_BASE_DIR           "ssh_base_dir"
 #define CONFIGURATION_ARGUMENT_SSH_CIPHERS            "ssh_ciphers"
@@ -109,6 +111,8 @@ extern "C" {
 #define CONFIGURATION_ARGUMENT_USER                    "user"
 #define CONFIGURATION_ARGUMENT_USER_CONF_PATH          "users_configuration_path"
 #define CONFIGURATION_ARGUMENT_VERIFICATION            "verification"
+#define CONFIGURATION_ARGUMENT_VERIFICATION_BACKUPS    "verification_backups"
+#define CONFIGURATION_ARGUMENT_VERIFICATION_MAX_RATE   "verification_max_rate"
 #define CONFIGURATION_ARGUMENT_WAL_SHIPPING            "wal_shipping"
 #define CONFIGURATION_ARGUMENT_WAL_SLOT                "wal_slot"
 #define CONFIGURATION_ARGUMENT_WORKERS                "workers"
@@ -54,6 +54,26 @@ pgmoneta_delete(int srv, char* backup_id);
 int
 pgmoneta_delete_wal(int srv);
 
+/**
+ * Move a directory of a server into its trash. The directory is renamed,
+ * so this is cheap and can be done while holding the repository lock.
+ * The directory is deleted in place if it can't be renamed
+ * @param srv The server index
+ * @param directory The directory
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_move_to_trash(int srv, char* directory);
+
+/**
+ * Purge the trash of a server. The files are removed by the workers
+ * under the delete_max_rate budget, without the repository lock
+ * @param srv The server index
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_purge_trash(int srv);
+
 #ifdef __cplusplus
 }
 #endif
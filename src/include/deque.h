@@ -39,27 +39,54 @@ extern "C" {
 #include <stdbool.h>
 #include <stdint.h>
 
+#define DEQUE_MINIMUM_CAPACITY 8
+#define DEQUE_INDEX_THRESHOLD  32
+
 /** @struct deque_node
- * Defines a deque node
+ * Defines a deque node, stored inline in the ring buffer
  */
 struct deque_node
 {
    struct value* data;      /**< The value */
    char* tag;               /**< The tag */
-   struct deque_node* next; /**< The next pointer */
-   struct deque_node* prev; /**< The previous pointer */
+};
+
+/** @struct deque_index_entry
+ * Defines an entry of the tag index
+ */
+struct deque_index_entry
+{
+   uint64_t hash;           /**< The hash of the tag */
+   char* tag;               /**< The tag, owned by the node, NULL if the entry is empty */
+   struct value* data;      /**< The value of the first node with the tag */
+};
+
+/** @struct deque_index
+ * Defines the tag index of a deque, an open addressing hash table
+ * mapping each tag to its first node
+ */
+struct deque_index
+{
+   uint32_t size;                     /**< The number of entries */
+   uint32_t capacity;                 /**< The capacity, a power of two */
+   bool duplicates;                   /**< If a tag is used by more than one node */
+   struct deque_index_entry* entries; /**< The entries */
 };
 
 /** @struct deque
- * Defines a deque
+ * Defines a deque, a ring buffer of nodes
  */
 struct deque
 {
-   uint32_t size;            /**< The size of the deque */
-   bool thread_safe;         /**< If the deque is thread safe */
-   pthread_rwlock_t mutex;   /**< The mutex of the deque */
-   struct deque_node* start; /**< The start node */
-   struct deque_node* end;   /**< The end node */
+   uint32_t size;              /**< The size of the deque */
+   bool thread_safe;           /**< If the deque is thread safe */
+   pthread_rwlock_t mutex;     /**< The mutex of the deque */
+   struct deque_node* nodes;   /**< The ring buffer */
+   uint32_t capacity;          /**< The capacity of the ring buffer, a power of two */
+   uint32_t head;              /**< The position of the first node in the ring buffer */
+   uint32_t gap_start;         /**< The position of the first slot emptied by iterator removes */
+   uint32_t gap;               /**< The number of slots emptied by iterator removes, not counted in size */
+   struct deque_index* index;  /**< The tag index, built by the first lookup once the deque is large enough */
 };
 
 /** @struct deque_iterator
@@ -68,7 +95,8 @@ struct deque
 struct deque_iterator
 {
    struct deque* deque;      /**< The deque */
-   struct deque_node* cur;   /**< The current deque node */
+   int64_t position;         /**< The position of the current node, -1 before the first node */
+   int64_t next;             /**< The position of the next node, the nodes in between are removed */
    char* tag;                /**< The current tag */
    struct value* value;      /**< The current value */
 };
@@ -176,7 +204,9 @@ uintptr_t
 pgmoneta_deque_peek_last(struct deque* deque, char** tag);
 
 /**
- * Get the data for the specified tag
+ * Get the data of the first node with the specified tag.
+ * Deques of at least DEQUE_INDEX_THRESHOLD nodes build a tag index
+ * on the first lookup, which is maintained until the deque is destroyed
  * @param deque The deque
  * @param tag The tag
  * @return The data, or 0
@@ -185,7 +215,7 @@ uintptr_t
 pgmoneta_deque_get(struct deque* deque, char* tag);
 
 /**
- * Does the tag exists
+ * Does the tag exists, uses the tag index like pgmoneta_deque_get
  * @param deque The deque
  * @param tag The tag
  * @return True if exists, otherwise false
@@ -219,14 +249,18 @@ bool
 pgmoneta_deque_iterator_has_next(struct deque_iterator* iter);
 
 /**
- * Remove the current node iterator points to and place the iterator to the previous node
+ * Remove the current node iterator points to and place the iterator to the previous node.
+ * The node leaves an empty slot that the following nodes are moved into as the iterator
+ * advances. The size, lookups and the string forms skip the empty slots, and the deque
+ * is compacted when the iteration ends or the iterator is destroyed.
+ * Only one iterator at a time may remove nodes from a deque
  * @param iter The iterator
  */
 void
 pgmoneta_deque_iterator_remove(struct deque_iterator* iter);
 
 /**
- * Destroy a deque iterator
+ * Destroy a deque iterator, compacting the deque if the iteration ended early
  * @param iter The iterator
  */
 void
@@ -256,7 +290,8 @@ void
 pgmoneta_deque_list(struct deque* deque);
 
 /**
- * Sort the deque
+ * Sort the deque by tag, nodes without a tag last.
+ * The sort is stable
  * @param deque The deque
  */
 void
@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2025 The pgmoneta community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PGMONETA_DOWNLOAD_H
+#define PGMONETA_DOWNLOAD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <pgmoneta.h>
+#include <deque.h>
+#include <http.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define DOWNLOAD_PART_SIZE (16 * 1024 * 1024)
+#define DOWNLOAD_RETRIES   3
+
+/** @struct download_buffer
+ * Defines a memory buffer for a response body
+ */
+struct download_buffer
+{
+   char* data;    /**< The data, zero terminated */
+   size_t size;   /**< The size of the data */
+};
+
+/** @struct download_engine
+ * Defines an object storage that a backup can be downloaded from
+ */
+struct download_engine
+{
+   char* name;   /**< The name of the engine */
+   int server;   /**< The server */
+   char* root;   /**< The remote root of the backup */
+
+   /**
+    * List the objects of the backup
+    * @param engine The engine
+    * @param objects The objects, the tag is the key relative to the root and the value is the size
+    * @return 0 on success, otherwise 1
+    */
+   int (*list)(struct download_engine* engine, struct deque* objects);
+
+   /**
+    * Create a signed GET request for a range of an object
+    * @param engine The engine
+    * @param key The key relative to the root
+    * @param offset The offset of the range
+    * @param length The length of the range, 0 for the whole object
+    * @param connection The resulting connection
+    * @param request The resulting request
+    * @return 0 on success, otherwise 1
+    */
+   int (*get)(struct download_engine* engine, char* key, uint64_t offset, uint64_t length,
+              struct http** connection, struct http_request** request);
+};
+
+/**
+ * Download the objects of a backup that are missing in the local backup directory.
+ * Objects are fetched with parallel range requests, and verified against
+ * backup.sha256 when it is present. pg_control and backup_label are fetched last
+ * @param engine The engine
+ * @param label The label
+ * @return 0 on success, otherwise 1
+ */
+int
+pgmoneta_download_backup(struct download_engine* engine, char* label);
+
+/**
+ * A sink for pgmoneta_http_invoke_stream that appends to a download_buffer
+ * @param arg The download_buffer
+ * @param data The data
+ * @param size The size of the data
+ * @return 0 on success, otherwise 1
+ */
+int
+pgmoneta_download_buffer_sink(void* arg, void* data, size_t size);
+
+/**
+ * Get the value of the next XML element with the given name
+ * @param xml The XML document
+ * @param name The element name
+ * @param end The position after the element, or NULL
+ * @return The value, or NULL if not found
+ */
+char*
+pgmoneta_download_xml_value(char* xml, char* name, char** end);
+
+/**
+ * Make sure that the data of a backup is present locally, by downloading it
+ * from the S3 or Azure storage engine if needed
+ * @param server The server
+ * @param label The label
+ * @param fetched Was the data downloaded
+ * @return 0 on success, otherwise 1
+ */
+int
+pgmoneta_download_fetch(int server, char* label, bool* fetched);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -104,18 +104,6 @@ pgmoneta_ext_get_file(SSL* ssl, int socket, char* file_path, struct query_respon
 int
 pgmoneta_ext_get_files(SSL* ssl, int socket, char* file_path, struct query_response** qr);
 
-/**
- * Send a file chunk to the extension
- * @param ssl The SSL structure
- * @param socket The socket
- * @param dest_path The path where the file will be written
- * @param base64_data The encoded file chunk in base64
- * @param qr The query result
- * @return 0 upon success, otherwise 1
- */
-int
-pgmoneta_ext_send_file_chunk(SSL* ssl, int socket, char* dest_path, char* base64_data, struct query_response** qr);
-
 /**
  * Promote a standby (replica) server to become the primary server
  * @param ssl The SSL structure
@@ -47,6 +47,7 @@ extern "C" {
 #define PGMONETA_HTTP_GET  0
 #define PGMONETA_HTTP_POST 1
 #define PGMONETA_HTTP_PUT  2
+#define PGMONETA_HTTP_HEAD 3
 
 /* HTTP status codes */
 #define PGMONETA_HTTP_STATUS_OK    0
@@ -181,6 +182,41 @@ pgmoneta_http_get_response_header(struct http_response* response, char* name);
 int
 pgmoneta_http_invoke(struct http* connection, struct http_request* request, struct http_response** response);
 
+/**
+ * Execute a HTTP request and stream the response body to a sink.
+ * The body is binary safe and is passed to the sink as it arrives.
+ * The sink is only called for 2xx responses
+ * @param connection The HTTP connection
+ * @param request The HTTP request
+ * @param sink The sink for the response body
+ * @param arg The argument for the sink
+ * @param status_code The resulting HTTP status code
+ * @return PGMONETA_HTTP_STATUS_OK upon success, otherwise PGMONETA_HTTP_STATUS_ERROR
+ */
+int
+pgmoneta_http_invoke_stream(struct http* connection, struct http_request* request,
+                            int (*sink)(void* arg, void* data, size_t size), void* arg,
+                            int* status_code);
+
+/**
+ * Parse an endpoint of the form [http://|https://]host[:port]
+ * @param endpoint The endpoint
+ * @param host The resulting host
+ * @param port The resulting port
+ * @param secure The resulting secure flag
+ * @return PGMONETA_HTTP_STATUS_OK upon success, otherwise PGMONETA_HTTP_STATUS_ERROR
+ */
+int
+pgmoneta_http_parse_endpoint(char* endpoint, char** host, int* port, bool* secure);
+
+/**
+ * Percent-encode a string for use in a URI. Only unreserved characters are kept
+ * @param s The string
+ * @return The encoded string
+ */
+char*
+pgmoneta_http_uri_encode(char* s);
+
 /**
  * Destroy a HTTP request structure
  * @param request The HTTP request
@@ -64,6 +64,9 @@ extern "C" {
 #define INFO_MANIFEST_ELAPSED          "MANIFEST_ELAPSED"
 #define INFO_MINOR_VERSION             "MINOR_VERSION"
 #define INFO_PARENT                    "PARENT"
+#define INFO_PASSTHROUGH               "PASSTHROUGH"
+#define INFO_PHASE                     "PHASE"
+#define INFO_PHASE_METRICS             "PHASE_METRICS"
 #define INFO_REMOTE_AZURE_ELAPSED      "REMOTE_AZURE_ELAPSED"
 #define INFO_REMOTE_S3_ELAPSED         "REMOTE_S3_ELAPSED"
 #define INFO_REMOTE_SSH_ELAPSED        "REMOTE_SSH_ELAPSED"
@@ -88,6 +91,8 @@ extern "C" {
 
 #define INFO_BUFFER_SIZE 8192
 
+#define NUMBER_OF_PHASES 32
+
 /**
  * @struct rfile
  * An rfile stores the metadata we need to use a file on disk for reconstruction.
@@ -113,6 +118,20 @@ struct rfile
    uint32_t truncation_block_length;   /**< truncation_block_length only reflects length until the checkpoint before backup starts. */
 };
 
+/** @struct backup_phase
+ * Defines the measurements of a workflow step of a backup
+ */
+struct backup_phase
+{
+   char name[MISC_LENGTH]; /**< The name of the workflow step */
+   double elapsed_time;    /**< The wall time in seconds */
+   double cpu_time;        /**< The CPU time in seconds */
+   double wait_time;       /**< The wall time not spent on the CPU in seconds */
+   uint64_t bytes_in;      /**< The bytes read */
+   uint64_t bytes_out;     /**< The bytes written */
+   uint64_t files;         /**< The files processed */
+};
+
 /** @struct backup
  * Defines a backup
  */
@@ -158,6 +177,9 @@ struct backup
    char extra[MAX_EXTRA_PATH];                                    /**< The extra directory */
    int type;                                                      /**< The backup type */
    char parent_label[MISC_LENGTH];                                /**< The label of backup's parent, only used when backup is incremental */
+   bool passthrough;                                              /**< Is the data kept as the server side compressed archive */
+   int number_of_phases;                                          /**< The number of measured workflow steps */
+   struct backup_phase phases[NUMBER_OF_PHASES];                  /**< The measured workflow steps */
 } __attribute__ ((aligned (64)));
 
 /**
@@ -297,6 +319,17 @@ pgmoneta_rfile_destroy(struct rfile* rf);
 int
 pgmoneta_incremental_rfile_initialize(int server, char* label, char* relative_dir, char* base_file_name, int encryption, int compression, struct rfile** rfile);
 
+/**
+ * Get the name a backup file is stored under, with the compression and encryption suffixes
+ * @param file The file name
+ * @param encryption The encryption method
+ * @param compression The compression method
+ * @param finalname [out] The stored file name
+ * @return 0 if success, otherwise 1
+ */
+int
+pgmoneta_backup_file_final_name(char* file, int encryption, int compression, char** finalname);
+
 /**
  * Extract a file from a backup
  * @param server The server
@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2025 The pgmoneta community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PGMONETA_INSTRUMENT_H
+#define PGMONETA_INSTRUMENT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <pgmoneta.h>
+#include <info.h>
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define NUMBER_OF_PHASE_SLOTS   32
+#define NUMBER_OF_PHASE_BUCKETS 12
+
+#define PHASE_SLOT_FREE    0
+#define PHASE_SLOT_CLAIMED 1
+#define PHASE_SLOT_READY   2
+
+/** @struct phase_histogram
+ * Defines a histogram of durations, the last bucket is +Inf
+ */
+struct phase_histogram
+{
+   atomic_ullong buckets[NUMBER_OF_PHASE_BUCKETS]; /**< The number of observations per bucket */
+   atomic_ullong count;                            /**< The number of observations */
+   atomic_ullong sum;                              /**< The sum of the observations in microseconds */
+};
+
+/** @struct phase_metrics
+ * Defines the metrics of a workflow step of a server
+ */
+struct phase_metrics
+{
+   atomic_schar state;                /**< The state of the slot */
+   int type;                          /**< The workflow type */
+   char name[MISC_LENGTH];            /**< The name of the workflow step */
+   struct phase_histogram elapsed;    /**< The wall time */
+   struct phase_histogram cpu;        /**< The CPU time */
+   struct phase_histogram wait;       /**< The wall time not spent on the CPU */
+   atomic_ullong bytes_in;            /**< The bytes read */
+   atomic_ullong bytes_out;           /**< The bytes written */
+   atomic_ullong files;               /**< The files processed */
+} __attribute__ ((aligned (64)));
+
+/** @struct instrument
+ * Defines the workflow step metrics of all servers
+ */
+struct instrument
+{
+   atomic_schar lock;                                                      /**< The lock for claiming slots */
+   struct phase_metrics phases[NUMBER_OF_SERVERS][NUMBER_OF_PHASE_SLOTS]; /**< The metrics */
+};
+
+/** @struct instrument_sample
+ * Defines the resource usage of the process at the start of a workflow step
+ */
+struct instrument_sample
+{
+   struct timespec start; /**< The start time */
+   double cpu;            /**< The CPU time in seconds */
+   uint64_t bytes_in;     /**< The bytes read */
+   uint64_t bytes_out;    /**< The bytes written */
+   uint64_t files;        /**< The files processed */
+};
+
+/**
+ * Create and initialize the instrumentation shared memory
+ * @param size The size of the segment
+ * @param shmem The shared memory segment
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_instrument_init(size_t* size, void** shmem);
+
+/**
+ * Sample the resource usage of the process before a workflow step
+ * @param sample The sample
+ */
+void
+pgmoneta_instrument_begin(struct instrument_sample* sample);
+
+/**
+ * Measure a workflow step since its sample, and record it for the server
+ * @param server The server, or -1
+ * @param type The workflow type
+ * @param name The name of the workflow step
+ * @param sample The sample taken by pgmoneta_instrument_begin
+ * @param phase The measurements, or NULL
+ */
+void
+pgmoneta_instrument_end(int server, int type, char* name, struct instrument_sample* sample, struct backup_phase* phase);
+
+/**
+ * Count files processed by the current workflow step
+ * @param files The number of files
+ */
+void
+pgmoneta_instrument_files(uint64_t files);
+
+/**
+ * Get the upper bound of a histogram bucket
+ * @param index The bucket
+ * @return The upper bound in seconds, or a negative value for +Inf
+ */
+double
+pgmoneta_instrument_bucket(int index);
+
+/**
+ * Get the name of a workflow type
+ * @param type The workflow type
+ * @return The name
+ */
+char*
+pgmoneta_instrument_workflow(int type);
+
+/**
+ * Reset the workflow step metrics
+ */
+void
+pgmoneta_instrument_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2025 The pgmoneta community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PGMONETA_JOB_H
+#define PGMONETA_JOB_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <pgmoneta.h>
+#include <json.h>
+
+#include <openssl/ssl.h>
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <time.h>
+
+#define NUMBER_OF_JOBS 64
+
+#define JOB_STATE_FREE      0
+#define JOB_STATE_QUEUED    1
+#define JOB_STATE_RUNNING   2
+#define JOB_STATE_SUCCESS   3
+#define JOB_STATE_FAILED    4
+#define JOB_STATE_CANCELLED 5
+
+/** @struct job
+ * Defines a management command running as a job
+ */
+struct job
+{
+   atomic_int state;             /**< The state */
+   atomic_bool cancel;           /**< Is cancellation requested */
+   uint64_t id;                  /**< The identifier */
+   int32_t command;              /**< The management command */
+   int server;                   /**< The server */
+   int32_t priority;             /**< The priority, higher runs first */
+   pid_t pid;                    /**< The process owning the job */
+   time_t submitted;             /**< The submit time */
+   time_t started;               /**< The start time */
+   time_t finished;              /**< The finish time */
+   char phase[MISC_LENGTH];      /**< The current phase */
+   atomic_ullong bytes_done;     /**< The bytes processed */
+   atomic_ullong bytes_total;    /**< The expected bytes, or 0 */
+   atomic_ullong files_done;     /**< The files processed */
+   atomic_ullong files_total;    /**< The expected files, or 0 */
+} __attribute__ ((aligned (64)));
+
+/** @struct jobs
+ * Defines the job table
+ */
+struct jobs
+{
+   atomic_schar lock;                   /**< The lock */
+   uint64_t next_id;                    /**< The next identifier */
+   struct job jobs[NUMBER_OF_JOBS];     /**< The jobs */
+};
+
+/**
+ * Create and initialize the job shared memory
+ * @param size The size of the segment
+ * @param shmem The shared memory segment
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_job_init(size_t* size, void** shmem);
+
+/**
+ * Run a management command as a job of its server. The job is queued
+ * behind the other jobs of the server by priority, and the function returns
+ * in a child process that runs the command once it is the job's turn.
+ * The calling process waits for the command and records its outcome.
+ * If the request is asynchronous the job identifier is sent right away
+ * and the client descriptor of the command is redirected
+ * @param client_fd The client, updated for asynchronous requests
+ * @param server The server
+ * @param command The management command
+ * @param compression The compress method for wire protocol
+ * @param encryption The encrypt method for wire protocol
+ * @param payload The payload
+ */
+void
+pgmoneta_job_schedule(int* client_fd, int server, int32_t command, uint8_t compression, uint8_t encryption, struct json* payload);
+
+/**
+ * Set the phase of the current job
+ * @param phase The phase
+ */
+void
+pgmoneta_job_phase(char* phase);
+
+/**
+ * Set the expected work of the current job
+ * @param bytes The bytes
+ * @param files The files
+ */
+void
+pgmoneta_job_total(uint64_t bytes, uint64_t files);
+
+/**
+ * Add progress to the current job
+ * @param bytes The bytes
+ * @param files The files
+ */
+void
+pgmoneta_job_progress(uint64_t bytes, uint64_t files);
+
+/**
+ * Is cancellation of the current job requested
+ * @return True if cancelled, otherwise false
+ */
+bool
+pgmoneta_job_cancelled(void);
+
+/**
+ * List the jobs
+ * @param ssl The SSL connection
+ * @param client_fd The client
+ * @param compression The compress method for wire protocol
+ * @param encryption The encrypt method for wire protocol
+ * @param payload The payload
+ */
+void
+pgmoneta_job_list(SSL* ssl, int client_fd, uint8_t compression, uint8_t encryption, struct json* payload);
+
+/**
+ * Cancel a job
+ * @param ssl The SSL connection
+ * @param client_fd The client
+ * @param compression The compress method for wire protocol
+ * @param encryption The encrypt method for wire protocol
+ * @param payload The payload
+ */
+void
+pgmoneta_job_cancel(SSL* ssl, int client_fd, uint8_t compression, uint8_t encryption, struct json* payload);
+
+/**
+ * Stream the progress of a job until it is finished
+ * @param ssl The SSL connection
+ * @param client_fd The client
+ * @param compression The compress method for wire protocol
+ * @param encryption The encrypt method for wire protocol
+ * @param payload The payload
+ */
+void
+pgmoneta_job_subscribe(SSL* ssl, int client_fd, uint8_t compression, uint8_t encryption, struct json* payload);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -84,6 +84,11 @@ extern "C" {
 #define MANAGEMENT_CONF_GET       22
 #define MANAGEMENT_CONF_SET       23
 #define MANAGEMENT_MODE           24
+#define MANAGEMENT_VERIFY_WAL     25
+#define MANAGEMENT_WAL_FETCH      26
+#define MANAGEMENT_JOB_LIST       27
+#define MANAGEMENT_JOB_CANCEL     28
+#define MANAGEMENT_JOB_SUBSCRIBE  29
 
 #define MANAGEMENT_MASTER_KEY     24
 #define MANAGEMENT_ADD_USER       25
@@ -104,10 +109,13 @@ extern "C" {
  */
 #define MANAGEMENT_ARGUMENT_ACTION                "Action"
 #define MANAGEMENT_ARGUMENT_ALL                   "All"
+#define MANAGEMENT_ARGUMENT_ASYNC                 "Async"
 #define MANAGEMENT_ARGUMENT_BACKUP                "Backup"
 #define MANAGEMENT_ARGUMENT_BACKUPS               "Backups"
 #define MANAGEMENT_ARGUMENT_BACKUP_SIZE           "BackupSize"
 #define MANAGEMENT_ARGUMENT_BIGGEST_FILE_SIZE     "BiggestFileSize"
+#define MANAGEMENT_ARGUMENT_BYTES_DONE            "BytesDone"
+#define MANAGEMENT_ARGUMENT_BYTES_TOTAL           "BytesTotal"
 #define MANAGEMENT_ARGUMENT_CALCULATED            "Calculated"
 #define MANAGEMENT_ARGUMENT_CASCADE               "Cascade"
 #define MANAGEMENT_ARGUMENT_CHECKPOINT_HILSN      "CheckpointHiLSN"
@@ -131,14 +139,21 @@ extern "C" {
 #define MANAGEMENT_ARGUMENT_END_LOLSN             "EndLoLSN"
 #define MANAGEMENT_ARGUMENT_END_TIMELINE          "EndTimeline"
 #define MANAGEMENT_ARGUMENT_ERROR                 "Error"
+#define MANAGEMENT_ARGUMENT_ETA                   "ETA"
 #define MANAGEMENT_ARGUMENT_FAILED                "Failed"
 #define MANAGEMENT_ARGUMENT_FILENAME              "FileName"
 #define MANAGEMENT_ARGUMENT_FILES                 "Files"
+#define MANAGEMENT_ARGUMENT_FILES_DONE            "FilesDone"
+#define MANAGEMENT_ARGUMENT_FILES_TOTAL           "FilesTotal"
+#define MANAGEMENT_ARGUMENT_FIRST_BAD_LSN         "FirstBadLSN"
 #define MANAGEMENT_ARGUMENT_FREE_SPACE            "FreeSpace"
+#define MANAGEMENT_ARGUMENT_GAPS                  "Gaps"
 #define MANAGEMENT_ARGUMENT_HASH_ALGORITHM        "HashAlgorithm"
 #define MANAGEMENT_ARGUMENT_HOT_STANDBY_SIZE      "HotStandbySize"
 #define MANAGEMENT_ARGUMENT_INCREMENTAL           "Incremental"
 #define MANAGEMENT_ARGUMENT_INCREMENTAL_PARENT    "IncrementalParent"
+#define MANAGEMENT_ARGUMENT_JOB                   "Job"
+#define MANAGEMENT_ARGUMENT_JOBS                  "Jobs"
 #define MANAGEMENT_ARGUMENT_KEEP                  "Keep"
 #define MANAGEMENT_ARGUMENT_KEY                   "Key"
 #define MANAGEMENT_ARGUMENT_MAJOR_VERSION         "MajorVersion"
@@ -149,14 +164,19 @@ extern "C" {
 #define MANAGEMENT_ARGUMENT_ONLINE                "Online"
 #define MANAGEMENT_ARGUMENT_ORIGINAL              "Original"
 #define MANAGEMENT_ARGUMENT_OUTPUT                "Output"
+#define MANAGEMENT_ARGUMENT_PHASE                 "Phase"
 #define MANAGEMENT_ARGUMENT_POSITION              "Position"
 #define MANAGEMENT_ARGUMENT_PRIMARY               "Primary"
+#define MANAGEMENT_ARGUMENT_PRIORITY              "Priority"
+#define MANAGEMENT_ARGUMENT_REASON                "Reason"
+#define MANAGEMENT_ARGUMENT_RECORDS               "Records"
 #define MANAGEMENT_ARGUMENT_RESTART               "Restart"
 #define MANAGEMENT_ARGUMENT_RESTORE_SIZE          "RestoreSize"
 #define MANAGEMENT_ARGUMENT_RETENTION_DAYS        "RetentionDays"
 #define MANAGEMENT_ARGUMENT_RETENTION_MONTHS      "RetentionMonths"
 #define MANAGEMENT_ARGUMENT_RETENTION_WEEKS       "RetentionWeeks"
 #define MANAGEMENT_ARGUMENT_RETENTION_YEARS       "RetentionYears"
+#define MANAGEMENT_ARGUMENT_SEGMENTS              "Segments"
 #define MANAGEMENT_ARGUMENT_SERVER                "Server"
 #define MANAGEMENT_ARGUMENT_SERVERS               "Servers"
 #define MANAGEMENT_ARGUMENT_SERVER_SIZE           "ServerSize"
@@ -166,10 +186,12 @@ extern "C" {
 #define MANAGEMENT_ARGUMENT_START_HILSN           "StartHiLSN"
 #define MANAGEMENT_ARGUMENT_START_LOLSN           "StartLoLSN"
 #define MANAGEMENT_ARGUMENT_START_TIMELINE        "StartTimeline"
+#define MANAGEMENT_ARGUMENT_STATE                 "State"
 #define MANAGEMENT_ARGUMENT_STATUS                "Status"
 #define MANAGEMENT_ARGUMENT_TABLESPACE            "Tablespace"
 #define MANAGEMENT_ARGUMENT_TABLESPACES           "Tablespaces"
 #define MANAGEMENT_ARGUMENT_TABLESPACE_NAME       "TablespaceName"
+#define MANAGEMENT_ARGUMENT_THROUGHPUT            "Throughput"
 #define MANAGEMENT_ARGUMENT_TIME                  "Time"
 #define MANAGEMENT_ARGUMENT_TIMESTAMP             "Timestamp"
 #define MANAGEMENT_ARGUMENT_TOTAL_SPACE           "TotalSpace"
@@ -363,6 +385,24 @@ extern "C" {
 #define MANAGEMENT_ERROR_MODE_ERROR          2804
 #define MANAGEMENT_ERROR_MODE_UNKNOWN_ACTION 2805
 
+#define MANAGEMENT_ERROR_VERIFY_WAL_NOSERVER 2900
+#define MANAGEMENT_ERROR_VERIFY_WAL_NOFORK   2901
+#define MANAGEMENT_ERROR_VERIFY_WAL_NETWORK  2902
+#define MANAGEMENT_ERROR_VERIFY_WAL_ERROR    2903
+
+#define MANAGEMENT_ERROR_WAL_FETCH_NOSERVER 3000
+#define MANAGEMENT_ERROR_WAL_FETCH_NOFORK   3001
+#define MANAGEMENT_ERROR_WAL_FETCH_NOFILE   3002
+#define MANAGEMENT_ERROR_WAL_FETCH_NETWORK  3003
+#define MANAGEMENT_ERROR_WAL_FETCH_ERROR    3004
+
+#define MANAGEMENT_ERROR_JOB_FULL      3100
+#define MANAGEMENT_ERROR_JOB_CANCELLED 3101
+#define MANAGEMENT_ERROR_JOB_NOJOB     3102
+#define MANAGEMENT_ERROR_JOB_NOFORK    3103
+#define MANAGEMENT_ERROR_JOB_NETWORK   3104
+#define MANAGEMENT_ERROR_JOB_ERROR     3105
+
 /**
  * Output formats
  */
@@ -418,6 +458,8 @@ pgmoneta_management_create_outcome_failure(struct json* json, int32_t error, cha
  * @param ssl The SSL connection
  * @param socket The socket descriptor
  * @param server The server
+ * @param async Return the job identifier without waiting for the command
+ * @param priority The priority of the job
  * @param compression The compress method for wire protocol
  * @param encryption The encrypt method for wire protocol
  * @param incremental The base of incremental backup
@@ -425,7 +467,7 @@ pgmoneta_management_create_outcome_failure(struct json* json, int32_t error, cha
  * @return 0 upon success, otherwise 1
  */
 int
-pgmoneta_management_request_backup(SSL* ssl, int socket, char* server, uint8_t compression, uint8_t encryption, char* incremental, int32_t output_format);
+pgmoneta_management_request_backup(SSL* ssl, int socket, char* server, bool async, int32_t priority, uint8_t compression, uint8_t encryption, char* incremental, int32_t output_format);
 
 /**
  * Create a list backup request
@@ -449,13 +491,15 @@ pgmoneta_management_request_list_backup(SSL* ssl, int socket, char* server, char
  * @param backup_id The backup
  * @param position The position parameters
  * @param directory The directory
+ * @param async Return the job identifier without waiting for the command
+ * @param priority The priority of the job
  * @param compression The compress method for wire protocol
  * @param encryption The encrypt method for wire protocol
  * @param output_format The output format
  * @return 0 upon success, otherwise 1
  */
 int
-pgmoneta_management_request_restore(SSL* ssl, int socket, char* server, char* backup_id, char* position, char* directory, uint8_t compression, uint8_t encryption, int32_t output_format);
+pgmoneta_management_request_restore(SSL* ssl, int socket, char* server, char* backup_id, char* position, char* directory, bool async, int32_t priority, uint8_t compression, uint8_t encryption, int32_t output_format);
 
 /**
  * Create a verify request
@@ -465,13 +509,15 @@ pgmoneta_management_request_restore(SSL* ssl, int socket, char* server, char* ba
  * @param backup_id The backup
  * @param directory The directory
  * @param files The files filter
+ * @param async Return the job identifier without waiting for the command
+ * @param priority The priority of the job
  * @param compression The compress method for wire protocol
  * @param encryption The encrypt method for wire protocol
  * @param output_format The output format
  * @return 0 upon success, otherwise 1
  */
 int
-pgmoneta_management_request_verify(SSL* ssl, int socket, char* server, char* backup_id, char* directory, char* files, uint8_t compression, uint8_t encryption, int32_t output_format);
+pgmoneta_management_request_verify(SSL* ssl, int socket, char* server, char* backup_id, char* directory, char* files, bool async, int32_t priority, uint8_t compression, uint8_t encryption, int32_t output_format);
 
 /**
  * Create an archive request
@@ -481,13 +527,15 @@ pgmoneta_management_request_verify(SSL* ssl, int socket, char* server, char* bac
  * @param backup_id The backup
  * @param position The position parameters
  * @param directory The directory
+ * @param async Return the job identifier without waiting for the command
+ * @param priority The priority of the job
  * @param compression The compress method for wire protocol
  * @param encryption The encrypt method for wire protocol
  * @param output_format The output format
  * @return 0 upon success, otherwise 1
  */
 int
-pgmoneta_management_request_archive(SSL* ssl, int socket, char* server, char* backup_id, char* position, char* directory, uint8_t compression, uint8_t encryption, int32_t output_format);
+pgmoneta_management_request_archive(SSL* ssl, int socket, char* server, char* backup_id, char* position, char* directory, bool async, int32_t priority, uint8_t compression, uint8_t encryption, int32_t output_format);
 
 /**
  * Create a delete request
@@ -495,13 +543,15 @@ pgmoneta_management_request_archive(SSL* ssl, int socket, char* server, char* ba
  * @param socket The socket descriptor
  * @param server The server
  * @param backup_id The backup
+ * @param async Return the job identifier without waiting for the command
+ * @param priority The priority of the job
  * @param compression The compress method for wire protocol
  * @param encryption The encrypt method for wire protocol
  * @param output_format The output format
  * @return 0 upon success, otherwise 1
  */
 int
-pgmoneta_management_request_delete(SSL* ssl, int socket, char* server, char* backup_id, uint8_t compression, uint8_t encryption, int32_t output_format);
+pgmoneta_management_request_delete(SSL* ssl, int socket, char* server, char* backup_id, bool async, int32_t priority, uint8_t compression, uint8_t encryption, int32_t output_format);
 
 /**
  * Create a shutdown request
@@ -739,6 +789,72 @@ pgmoneta_management_request_annotate(SSL* ssl, int socket, char* server, char* b
  */
 int pgmoneta_management_request_mode(SSL* ssl, int socket, char* server, char* action, uint8_t compression, uint8_t encryption, int32_t output_format);
 
+/**
+ * Create a verify WAL request
+ * @param ssl The SSL connection
+ * @param socket The socket descriptor
+ * @param server The server
+ * @param compression The compress method for wire protocol
+ * @param encryption The encrypt method for wire protocol
+ * @param output_format The output format
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_management_request_verify_wal(SSL* ssl, int socket, char* server, uint8_t compression, uint8_t encryption, int32_t output_format);
+
+/**
+ * Create a WAL fetch request
+ * @param ssl The SSL connection
+ * @param socket The socket descriptor
+ * @param server The server
+ * @param file The WAL file name
+ * @param path The absolute path the WAL file is written to
+ * @param compression The compress method for wire protocol
+ * @param encryption The encrypt method for wire protocol
+ * @param output_format The output format
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_management_request_wal_fetch(SSL* ssl, int socket, char* server, char* file, char* path, uint8_t compression, uint8_t encryption, int32_t output_format);
+
+/**
+ * Create a job list request
+ * @param ssl The SSL connection
+ * @param socket The socket descriptor
+ * @param compression The compress method for wire protocol
+ * @param encryption The encrypt method for wire protocol
+ * @param output_format The output format
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_management_request_job_list(SSL* ssl, int socket, uint8_t compression, uint8_t encryption, int32_t output_format);
+
+/**
+ * Create a job cancel request
+ * @param ssl The SSL connection
+ * @param socket The socket descriptor
+ * @param job The job identifier
+ * @param compression The compress method for wire protocol
+ * @param encryption The encrypt method for wire protocol
+ * @param output_format The output format
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_management_request_job_cancel(SSL* ssl, int socket, uint64_t job, uint8_t compression, uint8_t encryption, int32_t output_format);
+
+/**
+ * Create a job subscribe request
+ * @param ssl The SSL connection
+ * @param socket The socket descriptor
+ * @param job The job identifier
+ * @param compression The compress method for wire protocol
+ * @param encryption The encrypt method for wire protocol
+ * @param output_format The output format
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_management_request_job_subscribe(SSL* ssl, int socket, uint64_t job, uint8_t compression, uint8_t encryption, int32_t output_format);
+
 /**
  * Create an ok response
  * @param ssl The SSL connection
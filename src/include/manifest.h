@@ -43,6 +43,13 @@ extern "C" {
 #define MANIFEST_COLUMN_COUNT 2
 #define MANIFEST_PATH_INDEX 0
 #define MANIFEST_CHECKSUM_INDEX 1
+#define MANIFEST_CHECKSUM_LENGTH 129
+
+#define MANIFEST_KEY_VERSION "PostgreSQL-Backup-Manifest-Version"
+#define MANIFEST_KEY_SYS_IDENTIFIER "System-Identifier"
+#define MANIFEST_KEY_FILES "Files"
+#define MANIFEST_KEY_WAL_RANGES "WAL-Ranges"
+#define MANIFEST_KEY_CHECKSUM "Manifest-Checksum"
 
 /** @struct manifest_file
  * Defines a manifest file
@@ -63,7 +70,39 @@ struct manifest_chunk
 };
 
 /**
- * Verify checksum of the manifest and the checksum
+ * Get the name of a manifest checksum algorithm
+ * @param algorithm The algorithm
+ * @return The name, as used by the backup manifest
+ */
+char*
+pgmoneta_manifest_checksum_name(int algorithm);
+
+/**
+ * Create the checksum column of a manifest csv entry.
+ * SHA512 entries are the bare checksum, other algorithms are stored as
+ * algorithm:checksum:size
+ * @param algorithm The algorithm
+ * @param checksum The checksum
+ * @param size The file size
+ * @return The entry
+ */
+char*
+pgmoneta_manifest_checksum_entry(char* algorithm, char* checksum, uint64_t size);
+
+/**
+ * Parse the checksum column of a manifest csv entry
+ * @param entry The entry
+ * @param algorithm The algorithm
+ * @param checksum The checksum
+ * @param size The file size, or -1 if not recorded
+ * @return 0 on success, otherwise 1
+ */
+int
+pgmoneta_manifest_checksum_parse(char* entry, char** algorithm, char** checksum, int64_t* size);
+
+/**
+ * Verify the files of a directory against the checksums of its backup manifest,
+ * using the checksum algorithm of each file
  * @param root The root directory holding the manifest
  * @return 0 if verification turns out ok, 1 otherwise
  */
@@ -71,7 +110,10 @@ int
 pgmoneta_manifest_checksum_verify(char* root);
 
 /**
- * Compare manifests
+ * Compare manifests.
+ * The result trees are allocated from the scope arena of the
+ * calling workflow step, see pgmoneta_memory_arena_scope().
+ * Files with a CRC32C checksum are always reported as changed
  * @param manifest1 The path to the first manifest
  * @param manifest2 The path to the second manifest
  * @param deleted_files The deleted files
@@ -35,8 +35,12 @@ extern "C" {
 
 #include <pgmoneta.h>
 
+#include <stdint.h>
 #include <stdlib.h>
 
+#define MEMORY_ARENA_BLOCK_SIZE (64 * 1024)
+#define MEMORY_ARENA_ALIGNMENT  16
+
 /** @struct stream_buffer
  * Defines a streaming buffer
  */
@@ -49,8 +53,33 @@ struct stream_buffer
    size_t cursor; /**< next byte to consume */
 } __attribute__ ((aligned (64)));
 
+/** @struct memory_arena_block
+ * Defines a block of a memory arena
+ */
+struct memory_arena_block
+{
+   struct memory_arena_block* next;                                  /**< The next (older) block */
+   size_t size;                                                      /**< The usable size of the block */
+   size_t used;                                                      /**< The number of bytes handed out */
+   char data[] __attribute__ ((aligned (MEMORY_ARENA_ALIGNMENT)));  /**< The data */
+};
+
+/** @struct memory_arena
+ * Defines a region allocator. Allocations are carved out of large
+ * blocks and are only given back all at once, by a reset or a destroy
+ */
+struct memory_arena
+{
+   struct memory_arena_block* block; /**< The current block */
+   size_t block_size;                /**< The size of a regular block */
+   size_t size;                      /**< The number of bytes held in blocks */
+   size_t peak;                      /**< The largest number of bytes held in blocks */
+   uint64_t allocations;             /**< The number of allocations served */
+   uint64_t blocks;                  /**< The number of blocks allocated */
+};
+
 /**
- * Initialize a memory segment for the process local message structure
+ * Initialize a memory segment for the thread local message structure
  */
 void
 pgmoneta_memory_init(void);
@@ -124,6 +153,74 @@ pgmoneta_memory_stream_buffer_enlarge(struct stream_buffer* buffer, int bytes_ne
 void
 pgmoneta_memory_stream_buffer_free(struct stream_buffer* buffer);
 
+/**
+ * Create a memory arena
+ * @param block_size The size of a block, 0 for MEMORY_ARENA_BLOCK_SIZE
+ * @param arena [out] The arena
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_memory_arena_create(size_t block_size, struct memory_arena** arena);
+
+/**
+ * Allocate memory from an arena. The memory is aligned to
+ * MEMORY_ARENA_ALIGNMENT and must not be passed to free()
+ * @param arena The arena, or NULL to allocate with malloc()
+ * @param size The size
+ * @return The memory, or NULL
+ */
+void*
+pgmoneta_memory_arena_alloc(struct memory_arena* arena, size_t size);
+
+/**
+ * Copy a string into an arena
+ * @param arena The arena, or NULL to copy with strdup()
+ * @param str The string
+ * @return The copy, or NULL
+ */
+char*
+pgmoneta_memory_arena_strdup(struct memory_arena* arena, char* str);
+
+/**
+ * Give back memory from pgmoneta_memory_arena_alloc().
+ * Only memory from malloc() is freed, arena memory is kept until a reset
+ * @param arena The arena, or NULL
+ * @param ptr The memory
+ */
+void
+pgmoneta_memory_arena_free(struct memory_arena* arena, void* ptr);
+
+/**
+ * Release every allocation of an arena, keeping one block for reuse
+ * @param arena The arena
+ */
+void
+pgmoneta_memory_arena_reset(struct memory_arena* arena);
+
+/**
+ * Destroy an arena and all of its allocations
+ * @param arena The arena
+ */
+void
+pgmoneta_memory_arena_destroy(struct memory_arena* arena);
+
+/**
+ * Get the arena of the current scope, which is the running workflow
+ * step or worker task of this thread. It is created on first use and
+ * everything allocated from it is released when the scope ends, so
+ * nothing from it may be kept in the workflow nodes or handed to
+ * another thread
+ * @return The arena, or NULL if it could not be created
+ */
+struct memory_arena*
+pgmoneta_memory_arena_scope(void);
+
+/**
+ * End the current scope and release its arena
+ */
+void
+pgmoneta_memory_arena_scope_release(void);
+
 #ifdef __cplusplus
 }
 #endif
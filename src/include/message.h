@@ -360,13 +360,15 @@ pgmoneta_create_standby_status_update_message(int64_t received, int64_t flushed,
  * @param include_wal The indication of whether to also include WAL
  * @param compression The compression type
  * @param compression_level The compression level
+ * @param compression_workers The number of server side compression workers, 0 for none
+ * @param manifest_checksum The checksum algorithm of the backup manifest
  * @param msg The resulting message
  * @return 0 upon success, otherwise 1
  */
 int
 pgmoneta_create_base_backup_message(int server_version, bool incremental, char* label, bool include_wal,
-                                    int compression, int compression_level,
-                                    struct message** msg);
+                                    int compression, int compression_level, int compression_workers,
+                                    int manifest_checksum, struct message** msg);
 
 /**
  * Create a replication slot
@@ -540,6 +542,7 @@ pgmoneta_receive_manifest_file(int srv, SSL* ssl, int socket, struct stream_buff
 
 /**
  * Receive extra file from the server side
+ * @param srv The server index
  * @param ssl The SSL structure
  * @param socket The socket
  * @param username The current server username
@@ -549,19 +552,43 @@ pgmoneta_receive_manifest_file(int srv, SSL* ssl, int socket, struct stream_buff
  * @return 0 upon success, otherwise 1
  */
 int
-pgmoneta_receive_extra_files(SSL* ssl, int socket, char* username, char* source_dir, char* target_dir, char** info_extra);
+pgmoneta_receive_extra_files(int srv, SSL* ssl, int socket, char* username, char* source_dir, char* target_dir, char** info_extra);
 
 /**
- * Send a file from the client side to the extension side
+ * Receive a file from the server side as a binary COPY of its chunks
+ * @param srv The server index
  * @param ssl The SSL structure
  * @param socket The socket
- * @param username The current server username
- * @param source_path The file path of the source on the client side
- * @param target_path The file path where the file will be written on the server side
+ * @param source_path The file path on the server side
+ * @param target_path The file path to write
+ * @param bucket The backup token bucket, or NULL
+ * @param network_bucket The network token bucket, or NULL
+ * @param exists Does the file exist on the server side
+ * @param size The size of the file, or NULL
+ * @param algorithm The manifest checksum algorithm (CRC32C, SHA224, SHA256, SHA384 or SHA512), or NULL
+ * @param checksum The buffer for the checksum of the file, encoded as in a backup manifest,
+ *                 of at least MANIFEST_CHECKSUM_LENGTH bytes, or NULL
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_receive_file(int srv, SSL* ssl, int socket, char* source_path, char* target_path,
+                      struct token_bucket* bucket, struct token_bucket* network_bucket,
+                      bool* exists, uint64_t* size, char* algorithm, char* checksum);
+
+/**
+ * Receive a range of a file from the server side as a binary COPY of its chunks
+ * @param srv The server index
+ * @param ssl The SSL structure
+ * @param socket The socket
+ * @param source_path The file path on the server side
+ * @param offset The offset
+ * @param length The maximum length
+ * @param data The data
+ * @param size The size of the data
  * @return 0 upon success, otherwise 1
  */
 int
-pgmoneta_send_file(SSL* ssl, int socket, char* username, char* source_path, char* target_path);
+pgmoneta_receive_file_range(int srv, SSL* ssl, int socket, char* source_path, uint64_t offset, uint64_t length, void** data, size_t* size);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2025 The pgmoneta community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PGMONETA_PASSTHROUGH_H
+#define PGMONETA_PASSTHROUGH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <pgmoneta.h>
+#include <art.h>
+#include <csv.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define PASSTHROUGH_ARCHIVE "base.tar"
+#define PASSTHROUGH_INDEX   "base.tar.index"
+#define PASSTHROUGH_WINDOW  "base.tar.window"
+
+/** @struct passthrough
+ * Stores a server side compressed tar archive as received, and indexes
+ * the compressed frames and the tar members while it streams through.
+ * GZIP streams are also indexed at checkpoints inside a member, which
+ * keep the bit offset and the 32 kB window needed to resume inflating
+ */
+struct passthrough
+{
+   int compression;                 /**< The server side compression type */
+   char archive_path[MAX_PATH];     /**< The path of the archive */
+   FILE* archive;                   /**< The archive */
+   struct csv_writer* index;        /**< The index of the archive */
+   FILE* window;                    /**< The windows of the GZIP checkpoints */
+   void* decoder;                   /**< The decompression state */
+   bool frame;                      /**< Does the next compressed byte start a frame */
+   uint64_t compressed;             /**< The number of compressed bytes received */
+   uint64_t uncompressed;           /**< The number of uncompressed bytes parsed */
+   uint64_t checkpoint;             /**< The uncompressed offset of the last frame or checkpoint */
+   char header[512];                /**< The tar header being assembled */
+   size_t header_length;            /**< The length of the assembled tar header */
+   uint64_t skip;                   /**< The member data and padding left to skip */
+   uint64_t size;                   /**< The total size of the members */
+   uint64_t biggest;                /**< The size of the biggest member */
+};
+
+/**
+ * Create a passthrough archive in a directory
+ * @param directory The directory
+ * @param compression The server side compression type
+ * @param passthrough The resulting passthrough archive
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_passthrough_create(char* directory, int compression, struct passthrough** passthrough);
+
+/**
+ * Append compressed data as received from the server
+ * @param passthrough The passthrough archive
+ * @param data The data
+ * @param size The size of the data
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_passthrough_write(struct passthrough* passthrough, void* data, size_t size);
+
+/**
+ * Finish a passthrough archive, and write out its index
+ * @param passthrough The passthrough archive
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_passthrough_finish(struct passthrough* passthrough);
+
+/**
+ * Destroy a passthrough archive
+ * @param passthrough The passthrough archive
+ */
+void
+pgmoneta_passthrough_destroy(struct passthrough* passthrough);
+
+/**
+ * Does a directory hold a passthrough archive
+ * @param directory The directory
+ * @return True if it does, otherwise false
+ */
+bool
+pgmoneta_is_passthrough(char* directory);
+
+/**
+ * Get the uncompressed size of a passthrough archive from its index
+ * @param directory The directory
+ * @param size The total size of the files
+ * @param biggest The size of the biggest file
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_passthrough_size(char* directory, uint64_t* size, uint64_t* biggest);
+
+/**
+ * Extract a passthrough archive
+ * @param directory The directory holding the archive
+ * @param files The paths to extract, or NULL for all of them
+ * @param destination The destination directory
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_passthrough_extract(char* directory, struct art* files, char* destination);
+
+/**
+ * Extract a single file from a passthrough archive. The index is used to
+ * start decompressing at the closest frame or GZIP checkpoint, and only
+ * the file is written
+ * @param directory The directory holding the archive
+ * @param path The path of the file in the archive
+ * @param target The target file
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_passthrough_extract_file(char* directory, char* path, char* target);
+
+/**
+ * Remove a passthrough archive and its index
+ * @param directory The directory holding the archive
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_passthrough_remove(char* directory);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
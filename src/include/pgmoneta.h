@@ -85,6 +85,13 @@ extern "C" {
 #define STATE_FREE        0
 #define STATE_IN_USE      1
 
+#define DISK_USAGE_SERVER       0
+#define DISK_USAGE_BACKUP       1
+#define DISK_USAGE_WAL          2
+#define DISK_USAGE_WAL_SHIPPING 3
+#define DISK_USAGE_HOT_STANDBY  4
+#define NUMBER_OF_DISK_USAGES   5
+
 #define AUTH_SUCCESS      0
 #define AUTH_BAD_PASSWORD 1
 #define AUTH_ERROR        2
@@ -98,6 +105,12 @@ extern "C" {
 #define ENCRYPTION_AES_192_CTR  5
 #define ENCRYPTION_AES_128_CTR  6
 
+#define MANIFEST_CHECKSUM_CRC32C 0
+#define MANIFEST_CHECKSUM_SHA224 1
+#define MANIFEST_CHECKSUM_SHA256 2
+#define MANIFEST_CHECKSUM_SHA384 3
+#define MANIFEST_CHECKSUM_SHA512 4
+
 #define HUGEPAGE_OFF 0
 #define HUGEPAGE_TRY 1
 #define HUGEPAGE_ON  2
@@ -208,6 +221,21 @@ extern void* shmem;
  */
 extern void* prometheus_cache_shmem;
 
+/**
+ * Shared memory used to contain the backup catalog
+ */
+extern void* catalog_shmem;
+
+/**
+ * Shared memory used to contain the jobs
+ */
+extern void* jobs_shmem;
+
+/**
+ * Shared memory used to contain the workflow step metrics
+ */
+extern void* instrument_shmem;
+
 /**
  * @struct version
  * Semantic version structure for extensions (major.minor.patch format)
@@ -273,6 +301,19 @@ struct server
    uint32_t cur_timeline;                   /**< Current timeline the server is on*/
    atomic_llong last_operation_time;        /**< Last operation time of the server */
    atomic_llong last_failed_operation_time; /**< Last failed operation time of the server */
+   atomic_ulong verification_files;         /**< The number of files verified */
+   atomic_ulong verification_failed_files;  /**< The number of files that failed verification */
+   atomic_ulong verification_bytes;         /**< The number of bytes verified */
+   atomic_ulong verification_throughput;    /**< The throughput of the latest verification in bytes per second */
+   atomic_llong last_verification_time;     /**< The time of the latest verification */
+   atomic_int trash_pid;                    /**< The process purging the trash, or 0 */
+   atomic_ulong trash_reclaimed_files;      /**< The number of files removed from the trash */
+   atomic_ullong trash_reclaimed_bytes;     /**< The number of bytes reclaimed from the trash */
+   atomic_ullong disk_usage[NUMBER_OF_DISK_USAGES]; /**< The disk usage counters */
+   atomic_bool disk_usage_valid;            /**< Are the disk usage counters reconciled */
+   atomic_bool wal_archive_active;          /**< Is WAL archiving to object storage active */
+   atomic_ullong wal_archive_lsn;           /**< The LSN up to which the WAL is archived to object storage */
+   atomic_llong wal_archive_pending_time;   /**< The time of the oldest WAL segment waiting to be archived, or 0 */
    char wal_shipping[MAX_PATH];             /**< The WAL shipping directory */
    int number_of_hot_standbys;              /**< The number of hot standby directories */
    int number_of_extensions;                /**< The number of extensions */
@@ -283,6 +324,7 @@ struct server
    char tls_key_file[MAX_PATH];             /**< TLS key path */
    char tls_ca_file[MAX_PATH];              /**< TLS CA certificate path */
    int workers;                             /**< The number of workers */
+   int compression_workers;                 /**< The number of server side compression workers */
    int backup_max_rate;                     /**< Number of tokens added to the bucket with each replenishment for backup. */
    int network_max_rate;                    /**< Number of bytes of tokens added every one second to limit the netowrk backup rate */
    int number_of_extra;                     /**< The number of source directory*/
@@ -314,13 +356,19 @@ struct user
  *
  * The `size` field stores the size of the allocated
  * `data` payload.
+ *
+ * The payload holds the response body of `length` bytes
+ * and a zero byte, followed by the gzip compressed body
+ * of `compressed_length` bytes if it fits.
  */
 struct prometheus_cache
 {
-   time_t valid_until;   /**< when the cache will become not valid */
-   atomic_schar lock;    /**< lock to protect the cache */
-   size_t size;          /**< size of the cache */
-   char data[];          /**< the payload */
+   time_t valid_until;       /**< when the cache will become not valid */
+   atomic_schar lock;        /**< lock to protect the cache */
+   size_t size;              /**< size of the cache */
+   size_t length;            /**< length of the response body */
+   size_t compressed_length; /**< length of the compressed response body */
+   char data[];              /**< the payload */
 } __attribute__ ((aligned (64)));
 
 /** @struct prometheus
@@ -388,6 +436,8 @@ struct main_configuration
 
    int compression_type;                        /**< The compression type */
    int compression_level;                       /**< The compression level */
+   bool compression_passthrough;                /**< Keep server side compressed archives as received */
+   int compression_workers;                     /**< The number of server side compression workers */
 
    int create_slot;                             /**< Create a slot */
 
@@ -395,6 +445,8 @@ struct main_configuration
 
    int encryption;                              /**< The AES encryption mode */
 
+   int manifest_checksum;                       /**< The checksum algorithm of the backup manifest */
+
    char ssh_hostname[MISC_LENGTH];              /**< The SSH hostname */
    char ssh_username[MISC_LENGTH];              /**< The SSH username */
    char ssh_base_dir[MAX_PATH];                 /**< The SSH base directory */
@@ -405,17 +457,22 @@ struct main_configuration
    char s3_secret_access_key[MISC_LENGTH];      /**< The IAM Secret Access Key */
    char s3_bucket[MISC_LENGTH];                 /**< The S3 bucket */
    char s3_base_dir[MAX_PATH];                  /**< The S3 base directory */
+   char s3_endpoint[MISC_LENGTH];               /**< The S3 endpoint, empty for AWS */
 
    char azure_storage_account[MISC_LENGTH];     /**< The Azure storage account name */
    char azure_container[MISC_LENGTH];           /**< The Azure container name */
    char azure_shared_key[MISC_LENGTH];          /**< The Azure storage account key */
    char azure_base_dir[MAX_PATH];               /**< The Azure base directory */
+   char azure_endpoint[MISC_LENGTH];            /**< The Azure endpoint, empty for Azure */
 
    int retention_days;                          /**< The retention days for the server */
    int retention_weeks;                         /**< The retention weeks for the server */
    int retention_months;                        /**< The retention months for the server */
    int retention_years;                         /**< The retention years for the server */
    int retention_interval;                      /**< The retention interval */
+   int disk_usage_interval;                     /**< The disk usage reconciliation interval */
+   atomic_ullong used_space;                    /**< The disk space used in base_dir */
+   atomic_bool used_space_valid;                /**< Is the used space reconciled */
 
    char workspace[MAX_PATH];                    /**< A workspace for combining incremental backups */
 
@@ -444,8 +501,17 @@ struct main_configuration
 
    int backup_max_rate;                         /**< Number of tokens added to the bucket with each replenishment for backup. */
    int network_max_rate;                        /**< Number of bytes of tokens added every one second to limit the netowrk backup rate */
+   int backup_connections;                      /**< The number of connections used for a backup */
+   int transfer_chunk_size;                     /**< The size of the chunks of a file transfer over SQL */
 
    int verification;                            /**< The sha512 verification interval */
+   int verification_max_rate;                   /**< Number of bytes of tokens added every one second to limit the verification rate */
+   int verification_backups;                    /**< The number of backups verified per server for each interval */
+   int delete_max_rate;                         /**< Number of bytes of tokens added every one second to limit the deletion rate */
+   int wal_verification;                        /**< The WAL verification interval */
+
+   bool wal_fetch;                              /**< Serve the WAL of a restore through restore_command */
+   int wal_prefetch;                            /**< The number of WAL segments prefetched ahead of a fetch */
 
 #ifdef DEBUG
    bool link;                                   /**< Do linking */
@@ -61,12 +61,17 @@ extern "C" {
 #define PROMETHEUS_DEFAULT_CACHE_SIZE (256 * 1024)
 
 /**
- * Create a prometheus instance
- * @param client_ssl The client SSL structure
- * @param fd The client descriptor
+ * Run the metrics server.
+ *
+ * The server accepts connections on the listening sockets,
+ * serves them without blocking, keeps them open between scrapes
+ * and renders the metrics in the background. It runs until
+ * pgmoneta shuts down.
+ * @param fds The listening descriptors
+ * @param fds_length The number of listening descriptors
  */
 void
-pgmoneta_prometheus(SSL* client_ssl, int fd);
+pgmoneta_prometheus_server(int* fds, int fds_length);
 
 /**
  * Reset the counters and histograms
@@ -99,7 +99,9 @@ pgmoneta_combine_backups(int server, char* label, char* base, char* input_dir, c
                          struct backup* bck, struct json* manifest, bool incremental, bool combine_as_is);
 
 /**
- * Rollup backups into a new backup
+ * Rollup backups into a new backup.
+ * When the oldest backup is the incremental parent of the newest one the incremental files
+ * are merged block by block in place, otherwise the backups are combined into a new backup
  * @param server The server
  * @param newest_label The newest backup label
  * @param oldest_label The oldest backup label
@@ -119,6 +121,19 @@ pgmoneta_rollup_backups(int server, char* newest_label, char* oldest_label);
 int
 pgmoneta_extract_incremental_backup(int server, char* label, char** root, char** base);
 
+/**
+ * Apply an incremental backup in place onto a directory holding the data of its parent.
+ * Only the changed blocks of the incremental files are written, and each file is truncated
+ * to its new length. Other files are copied, and files that are no longer in the backup are removed
+ * @param server The server
+ * @param label The label of the incremental backup
+ * @param to The directory
+ * @param workers The optional workers
+ * @return 0 on success, 1 if otherwise
+ */
+int
+pgmoneta_apply_incremental_backup(int server, char* label, char* to, struct workers* workers);
+
 /**
  * Copy a PostgreSQL installation
  * @param from The from directory
@@ -35,6 +35,7 @@ extern "C" {
 
 #include <pgmoneta.h>
 #include <deque.h>
+#include <utils.h>
 
 #include <stdlib.h>
 #include <openssl/ssl.h>
@@ -107,6 +108,36 @@ pgmoneta_create_sha256_file(char* filename, char** sha256);
 int
 pgmoneta_create_sha512_file(char* filename, char** sha512);
 
+/**
+ * Generate SHA512 for a file, taking each chunk read from a token bucket
+ * @param filename The file path
+ * @param bucket The token bucket, or NULL for no limit
+ * @param sha512 The hash value
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_create_sha512_file_limited(char* filename, struct token_bucket* bucket, char** sha512);
+
+/**
+ * Generate SHA256 and SHA512 for a file while reading it only once
+ * @param filename The file path
+ * @param sha256 The SHA256 hash value
+ * @param sha512 The SHA512 hash value
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_create_sha256_sha512_file(char* filename, char** sha256, char** sha512);
+
+/**
+ * Generate the checksum for a file with a backup manifest algorithm
+ * @param filename The file path
+ * @param algorithm The algorithm (CRC32C, SHA224, SHA256, SHA384 or SHA512)
+ * @param checksum The checksum value
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_create_checksum_file(char* filename, char* algorithm, char** checksum);
+
 /**
  * Update the SHA512 hash for a specific file in the backup.sha512 file
  * @param root_dir The root directory of the backup
@@ -140,6 +171,12 @@ pgmoneta_generate_string_hmac_sha256_hash(char* key, int key_length, char* value
                                           int value_length, unsigned char** hmac,
                                           int* hmac_length);
 
+/**
+ * Select the CRC32C implementation for the CPU
+ */
+void
+pgmoneta_crc_init(void);
+
 /**
  * Generate CRC32C for a buffer
  * @param buffer The buffer
@@ -151,6 +188,7 @@ int
 pgmoneta_create_crc32c_buffer(void* buffer, size_t size, uint32_t* crc_buf);
 
 /**
+ * Generate CRC32C for a file, encoded as in a backup manifest
  * @param path The file path.
  * @param crc The hash value.
  * @return 0 upon success, otherwise 1.
@@ -34,6 +34,7 @@ extern "C" {
 #endif
 
 #include <pgmoneta.h>
+#include <message.h>
 
 #include <stdlib.h>
 #include <time.h>
@@ -156,7 +157,7 @@ int
 pgmoneta_server_file_stat(int srv, SSL* ssl, int socket, char* relative_file_path, struct file_stats* stat);
 
 /**
- * Start the backup
+ * Start the backup, with a fast checkpoint
  *
  * @param srv The server index
  * @param ssl The SSL connection
@@ -174,11 +175,39 @@ pgmoneta_server_start_backup(int srv, SSL* ssl, int socket, char* label, char**
  * @param srv The server index
  * @param ssl The SSL connection
  * @param socket The socket
- * @param label The backup label
+ * @param lsn [out] The stop backup lsn
+ * @param label_file [out] The content of the backup_label file, or NULL
+ * @param lf [out] The label file contents
+ * @return return 0 if success, otherwise failure
+ */
+int
+pgmoneta_server_stop_backup(int srv, SSL* ssl, int socket, char** lsn, char** label_file, struct label_file_contents* lf);
+
+/**
+ * Get the system identifier
+ *
+ * @param srv The server index
+ * @param ssl The SSL connection
+ * @param socket The socket
+ * @param system_identifier [out] The system identifier
+ * @return return 0 if success, otherwise failure
+ */
+int
+pgmoneta_server_system_identifier(int srv, SSL* ssl, int socket, uint64_t* system_identifier);
+
+/**
+ * List the files of the data directory that belong in a backup, leaving out
+ * the same contents as BASE_BACKUP. Directories come first, and then the files
+ * by descending size
+ *
+ * @param srv The server index
+ * @param ssl The SSL connection
+ * @param socket The socket
+ * @param response [out] The path, size, is directory and last modified of each entry
  * @return return 0 if success, otherwise failure
  */
 int
-pgmoneta_server_stop_backup(int srv, SSL* ssl, int socket, char** lsn, struct label_file_contents* lf);
+pgmoneta_server_data_files(int srv, SSL* ssl, int socket, struct query_response** response);
 
 #ifdef __cplusplus
 }
@@ -70,6 +70,42 @@ pgmoneta_storage_create_s3(void);
 struct workflow*
 pgmoneta_storage_create_azure(void);
 
+/**
+ * Download the data of a backup from the S3 storage engine
+ * @param server The server
+ * @param label The label
+ * @return 0 on success, otherwise 1
+ */
+int
+pgmoneta_s3_download(int server, char* label);
+
+/**
+ * Download the data of a backup from the Azure storage engine
+ * @param server The server
+ * @param label The label
+ * @return 0 on success, otherwise 1
+ */
+int
+pgmoneta_azure_download(int server, char* label);
+
+/**
+ * Upload a closed WAL file to the S3 storage engine
+ * @param server The server
+ * @param filename The name of the file in the WAL directory
+ * @return 0 on success, otherwise 1
+ */
+int
+pgmoneta_s3_wal_upload(int server, char* filename);
+
+/**
+ * Upload a closed WAL file to the Azure storage engine
+ * @param server The server
+ * @param filename The name of the file in the WAL directory
+ * @return 0 on success, otherwise 1
+ */
+int
+pgmoneta_azure_wal_upload(int server, char* filename);
+
 /**
  * Open WAL shipping file in remote ssh server
  * @param srv The server index
@@ -81,6 +117,17 @@ pgmoneta_storage_create_azure(void);
 int
 pgmoneta_sftp_wal_open(int server, char* filename, int segsize, sftp_file* file);
 
+/**
+ * Write to a WAL shipping file in remote ssh server. The write is pipelined,
+ * and completed by pgmoneta_sftp_wal_close
+ * @param file WAL streaming file
+ * @param data The data
+ * @param size The size of the data
+ * @return 0 on success, otherwise 1
+ */
+int
+pgmoneta_sftp_wal_write(sftp_file file, void* data, size_t size);
+
 /**
  * Close WAL shipping file in remote ssh server
  * @param srv The server index
@@ -672,6 +672,63 @@ pgmoneta_remove_suffix(char* orig, char* suffix);
 unsigned long
 pgmoneta_directory_size(char* directory);
 
+/**
+ * Calculate the disk size of a file, rounded up to whole blocks
+ * @param file The file
+ * @return The size in bytes
+ */
+unsigned long
+pgmoneta_file_disk_size(char* file);
+
+/**
+ * Adjust a disk usage counter of a server. Backup and WAL changes
+ * are also applied to the server counter and the used space
+ * @param server The server
+ * @param kind The disk usage kind (DISK_USAGE_*)
+ * @param delta The number of bytes added (positive) or removed (negative)
+ */
+void
+pgmoneta_disk_usage_add(int server, int kind, int64_t delta);
+
+/**
+ * Get a disk usage counter of a server. The counters are reconciled
+ * with the file system first if they haven't been yet
+ * @param server The server
+ * @param kind The disk usage kind (DISK_USAGE_*)
+ * @return The size in bytes
+ */
+unsigned long
+pgmoneta_disk_usage(int server, int kind);
+
+/**
+ * Recalculate a disk usage counter of a server from the file system
+ * @param server The server
+ * @param kind The disk usage kind (DISK_USAGE_*)
+ */
+void
+pgmoneta_disk_usage_refresh(int server, int kind);
+
+/**
+ * Recalculate all disk usage counters of a server from the file system
+ * @param server The server
+ */
+void
+pgmoneta_disk_usage_reconcile(int server);
+
+/**
+ * Get the disk space used in base_dir. The value is calculated
+ * from the file system first if it hasn't been yet
+ * @return The size in bytes
+ */
+unsigned long
+pgmoneta_used_space(void);
+
+/**
+ * Recalculate the disk space used in base_dir from the file system
+ */
+void
+pgmoneta_used_space_refresh(void);
+
 /**
  * Get directories
  * @param base The base directory
@@ -848,16 +905,19 @@ pgmoneta_get_symlink(char* symlink);
 bool
 pgmoneta_is_symlink_valid(char* path);
 
+struct wal_range;
+
 /**
- * Copy WAL files
+ * Copy WAL files, compressed and encrypted segments are restored as plain segments
  * @param from The from directory
  * @param to The to directory
  * @param start The start file
+ * @param range The optional WAL range needed by the recovery target
  * @param workers The optional workers
  * @return The result
  */
 int
-pgmoneta_copy_wal_files(char* from, char* to, char* start, struct workers* workers);
+pgmoneta_copy_wal_files(char* from, char* to, char* start, struct wal_range* range, struct workers* workers);
 
 /**
  * Get the number of WAL files
@@ -996,6 +1056,30 @@ pgmoneta_get_server(int server);
 char*
 pgmoneta_get_server_backup(int server);
 
+/**
+ * Get the WAL index file for a server
+ * @param server The server
+ * @return The WAL index file
+ */
+char*
+pgmoneta_get_server_wal_index(int server);
+
+/**
+ * Get the WAL prefetch directory for a server
+ * @param server The server
+ * @return The WAL prefetch directory
+ */
+char*
+pgmoneta_get_server_wal_prefetch(int server);
+
+/**
+ * Get the trash directory for a server
+ * @param server The server
+ * @return The trash directory
+ */
+char*
+pgmoneta_get_server_trash(int server);
+
 /**
  * Get the wal directory for a server
  * @param server The server
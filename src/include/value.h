@@ -36,6 +36,8 @@ extern "C" {
 #include <inttypes.h>
 #include <stdbool.h>
 
+struct memory_arena;
+
 typedef void (*data_destroy_cb)(uintptr_t data);
 typedef char* (*data_to_string_cb)(uintptr_t data, int32_t format, char* tag, int indent);
 
@@ -112,6 +114,20 @@ pgmoneta_value_create(enum value_type type, uintptr_t data, struct value** value
 int
 pgmoneta_value_create_with_config(uintptr_t data, struct value_config* config, struct value** value);
 
+/**
+ * Create a value inside an arena. The value and any string copied
+ * into it live in the arena, other owned data is still destroyed by
+ * pgmoneta_value_destroy_with_arena
+ * @param arena The arena, or NULL for the heap
+ * @param type The value type, ValueRef if a config is given
+ * @param data The value data, type cast it to uintptr_t before passing into function
+ * @param config The optional configuration
+ * @param value [out] The value
+ * @return 0 on success, 1 if otherwise
+ */
+int
+pgmoneta_value_create_with_arena(struct memory_arena* arena, enum value_type type, uintptr_t data, struct value_config* config, struct value** value);
+
 /**
  * Destroy a value along with the data within
  * @param value The value
@@ -120,6 +136,15 @@ pgmoneta_value_create_with_config(uintptr_t data, struct value_config* config, s
 int
 pgmoneta_value_destroy(struct value* value);
 
+/**
+ * Destroy a value created by pgmoneta_value_create_with_arena
+ * @param arena The arena, or NULL for the heap
+ * @param value The value
+ * @return 0 on success, 1 if otherwise
+ */
+int
+pgmoneta_value_destroy_with_arena(struct memory_arena* arena, struct value* value);
+
 /**
  * Get the raw data from the value, which can be casted back to its original type
  * @param value The value
@@ -34,10 +34,25 @@ extern "C" {
 #endif
 
 #include <pgmoneta.h>
+#include <deque.h>
 #include <json.h>
 
 #include <stdlib.h>
 
+/** @struct wal_verification
+ * Defines the outcome of a WAL archive verification
+ */
+struct wal_verification
+{
+   uint64_t segments;              /**< The number of segments verified */
+   uint64_t records;               /**< The number of records verified */
+   uint64_t bytes;                 /**< The number of bytes verified */
+   bool valid;                     /**< Is the WAL archive valid */
+   uint64_t first_bad_lsn;         /**< The first bad LSN, or 0 */
+   char reason[MISC_LENGTH];       /**< The reason for the first bad LSN */
+   struct deque* gaps;             /**< The missing segment ranges */
+};
+
 /**
  * Create a verify
  * @param ssl The SSL connection
@@ -57,6 +72,43 @@ pgmoneta_verify(SSL* ssl, int client_fd, int server, uint8_t compression, uint8_
 void
 pgmoneta_sha512_verification(char** argv);
 
+/**
+ * Verify the WAL archive of a server
+ * @param ssl The SSL connection
+ * @param client_fd The client
+ * @param server The server
+ * @param compression The compress method for wire protocol
+ * @param encryption The encrypt method for wire protocol
+ * @param payload The payload
+ */
+void
+pgmoneta_verify_wal(SSL* ssl, int client_fd, int server, uint8_t compression, uint8_t encryption, struct json* payload);
+
+/**
+ * Run WAL verification job
+ * @param argv The argv
+ */
+void
+pgmoneta_wal_verification(char** argv);
+
+/**
+ * Scan the WAL archive of a server. Each segment is checked in parallel for
+ * its page headers, the CRC32C of its records, the LSN continuity and the
+ * timeline history, and the archive is checked for missing segments
+ * @param server The server
+ * @param result [out] The result
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_verify_wal_archive(int server, struct wal_verification** result);
+
+/**
+ * Destroy a WAL verification result
+ * @param result The result
+ */
+void
+pgmoneta_destroy_wal_verification(struct wal_verification* result);
+
 #ifdef __cplusplus
 }
 #endif
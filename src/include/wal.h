@@ -34,6 +34,7 @@ extern "C" {
 #endif
 
 #include <pgmoneta.h>
+#include <info.h>
 
 #include <ev.h>
 #include <stdint.h>
@@ -50,6 +51,18 @@ struct timeline_history
    struct timeline_history* next; /**< the next history entry */
 };
 
+/** @struct wal_range
+ * Defines the WAL segments of a timeline that a recovery needs.
+ * Segments are keyed by the log and segment parts of their name, (log << 32) | seg
+ */
+struct wal_range
+{
+   uint32_t tli;                  /**< the timeline */
+   uint64_t from;                 /**< the key of the first segment */
+   uint64_t to;                   /**< the key of the last segment */
+   struct wal_range* next;        /**< the next range */
+};
+
 /**
  * @brief Enum representing types of PostgreSQL objects
  */
@@ -95,6 +108,44 @@ pgmoneta_get_timeline_history(int srv, uint32_t tli, struct timeline_history** h
 void
 pgmoneta_free_timeline_history(struct timeline_history* history);
 
+/**
+ * Compute the WAL segments a restore of a backup needs for a recovery target.
+ * The target timeline selects the timelines through its history, an LSN target bounds
+ * the range directly and a time target is bounded through the WAL index
+ * @param srv The server index
+ * @param backup The backup
+ * @param position The recovery positions
+ * @param range [out] The ranges, NULL if every segment from the backup start is needed
+ * @return 0 on success, otherwise 1
+ */
+int
+pgmoneta_wal_recovery_range(int srv, struct backup* backup, char* position, struct wal_range** range);
+
+/**
+ * Is a WAL file part of the ranges.
+ * Files that are not WAL segments, like history files, are always part of them
+ * @param range The ranges, NULL for all files
+ * @param file The file name
+ * @return true if the file is needed, otherwise false
+ */
+bool
+pgmoneta_wal_range_contains(struct wal_range* range, char* file);
+
+/**
+ * Free the ranges
+ * @param range The ranges
+ */
+void
+pgmoneta_free_wal_range(struct wal_range* range);
+
+/**
+ * Drop the WAL index entries of segments that are no longer in the WAL archive
+ * @param srv The server index
+ * @return 0 on success, otherwise 1
+ */
+int
+pgmoneta_wal_index_prune(int srv);
+
 /**
  * @brief Read OID mappings from PostgreSQL server
  *
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2025 The pgmoneta community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PGMONETA_WALARCHIVE_H
+#define PGMONETA_WALARCHIVE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <pgmoneta.h>
+#include <art.h>
+
+#define WAL_ARCHIVE_STATUS  "wal_archive.status"
+#define WAL_ARCHIVE_RETRIES 3
+
+/**
+ * Archive the closed WAL files of a server to the S3 and Azure storage engines.
+ * Files are uploaded in parallel using the workers of the server, and the names
+ * of the archived files are persisted in the server directory, such that each
+ * file is only uploaded once. The WAL receiver isn't involved
+ * @param server The server
+ * @return 0 on success, otherwise 1
+ */
+int
+pgmoneta_wal_archive(int server);
+
+/**
+ * Load the names of the WAL files of a server that are archived to the S3
+ * and Azure storage engines
+ * @param server The server
+ * @param archived [out] The archived file names, NULL when WAL isn't archived
+ * @return 0 on success, otherwise 1
+ */
+int
+pgmoneta_wal_archive_status(int server, struct art** archived);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -106,6 +106,19 @@ struct walfile
 int
 pgmoneta_read_walfile(int server, char* path, struct walfile** wf);
 
+/**
+ * Read a WAL file, decoding only the records accepted by a filter on the
+ * record header. The other records keep their data undecoded
+ * @param server The server index
+ * @param path The path to the WAL file
+ * @param filter The filter on the record header
+ * @param filter_data The data of the filter
+ * @param wf The WAL file structure to populate
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_read_walfile_filtered(int server, char* path, wal_record_filter filter, void* filter_data, struct walfile** wf);
+
 /**
  * Write a WAL file
  * @param wf The WAL file structure
@@ -331,6 +331,7 @@ struct decoded_bkp_block
  * - max_block_id: Highest block ID in use (-1 if none).
  * - blocks: Array of decoded backup blocks.
  * - partial: Indicates if the record is partial.
+ * - raw: The undecoded data of the record, or NULL if the record was decoded.
  */
 struct decoded_xlog_record
 {
@@ -347,8 +348,20 @@ struct decoded_xlog_record
    int max_block_id;                                          /**< Highest block ID in use (-1 if none). */
    struct decoded_bkp_block blocks[XLR_MAX_BLOCK_ID + 1];     /**< Array of decoded backup blocks. */
    bool partial;                                              /**< Indicates if the record is partial. */
+   char* raw;                                                 /**< The undecoded data of the record, or NULL. */
 };
 
+/**
+ * Decide from the header of a record if the record is decoded.
+ * A record that isn't decoded keeps its data as is, and is encoded back unchanged
+ * except for its header.
+ *
+ * @param record The header of the record.
+ * @param data The data of the filter.
+ * @return true if the record is decoded, otherwise false.
+ */
+typedef bool (*wal_record_filter)(struct xlog_record* record, void* data);
+
 /**
  * @struct rel_file_node
  * @brief Identifies a relation file node.
@@ -400,11 +413,13 @@ extern struct server* server_config;
  *
  * @param path The file path of the WAL file.
  * @param server The index of the server structure, if -1, config.servers[0] will be initialized based on magic value.
+ * @param filter The filter deciding which records are decoded, or NULL to decode all records.
+ * @param filter_data The data of the filter.
  * @param wal_file The WAL file structure to be populated with parsed data.
  * @return 0 on success, otherwise 1.
  */
 int
-pgmoneta_wal_parse_wal_file(char* path, int server, struct walfile* wal_file);
+pgmoneta_wal_parse_wal_file(char* path, int server, wal_record_filter filter, void* filter_data, struct walfile* wal_file);
 
 /**
  * Retrieves block data from the decoded XLOG record.
@@ -417,6 +432,15 @@ pgmoneta_wal_parse_wal_file(char* path, int server, struct walfile* wal_file);
 char*
 pgmoneta_wal_get_record_block_data(struct decoded_xlog_record* record, uint8_t block_id, size_t* len);
 
+/**
+ * Get the PostgreSQL major version of a WAL page magic value
+ *
+ * @param magic_value The xlp_magic of a page header
+ * @return The major version, or -1 if the magic value is unknown
+ */
+int
+pgmoneta_wal_magic_to_version(uint16_t magic_value);
+
 /**
  * Checks if the backup image is compressed.
  *
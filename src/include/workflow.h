@@ -128,6 +128,15 @@ pgmoneta_workflow_create(int workflow_type, struct backup* backup);
 int
 pgmoneta_workflow_nodes(int server, char* identifier, struct art* nodes, struct backup** backup);
 
+/**
+ * Execute a step of a workflow, and measure it
+ * @param workflow The workflow step
+ * @param nodes The nodes
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_workflow_step(struct workflow* workflow, struct art* nodes);
+
 /**
  * Execute a workflow
  * @param workflow The workflow
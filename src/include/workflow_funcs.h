@@ -82,14 +82,8 @@ struct workflow*
 pgmoneta_create_retention(void);
 
 /**
- * Create a workflow for the SHA-256
- * @return The workflow
- */
-struct workflow*
-pgmoneta_create_sha256(void);
-
-/**
- * Create a workflow for the SHA-256
+ * Create a workflow for the SHA-512, which also creates the
+ * SHA-256 of the data files for the remote storage engines
  * @return The workflow
  */
 struct workflow*
@@ -134,6 +128,13 @@ pgmoneta_create_lz4(bool compress);
 struct workflow*
 pgmoneta_create_bzip2(bool compress);
 
+/**
+ * Create a workflow that extracts a server side compressed passthrough archive
+ * @return The workflow
+ */
+struct workflow*
+pgmoneta_create_passthrough(void);
+
 /**
  * Create a workflow for symlinking
  * @return The workflow
@@ -55,6 +55,7 @@ typedef struct
    int operation_count;             /**< Number of operations in the array */
    int* xids;                       /**< Array of XIDs from rules */
    int xid_count;                   /**< Number of XIDs in the array */
+   int workers;                     /**< Number of workers, 0 for one per CPU */
 } config_t;
 
 /**
@@ -28,6 +28,7 @@
 
 #include <pgmoneta.h>
 #include <aes.h>
+#include <instrument.h>
 #include <logging.h>
 #include <management.h>
 #include <security.h>
@@ -150,6 +151,7 @@ do_encrypt_file(struct worker_common* wc)
       if (pgmoneta_exists(wi->from))
       {
          pgmoneta_delete_file(wi->from, NULL);
+         pgmoneta_instrument_files(1);
       }
       else
       {
@@ -549,6 +551,7 @@ do_decrypt_file(struct worker_common* wc)
       if (pgmoneta_exists(wi->from))
       {
          pgmoneta_delete_file(wi->from, NULL);
+         pgmoneta_instrument_files(1);
       }
       else
       {
@@ -30,11 +30,13 @@
 #include <pgmoneta.h>
 #include <achv.h>
 #include <gzip_compression.h>
+#include <job.h>
 #include <logging.h>
 #include <lz4_compression.h>
 #include <management.h>
 #include <manifest.h>
 #include <network.h>
+#include <passthrough.h>
 #include <restore.h>
 #include <security.h>
 #include <utils.h>
@@ -498,6 +500,8 @@ pgmoneta_receive_archive_files(int srv, SSL* ssl, int socket, struct stream_buff
                fclose(file);
                goto error;
             }
+
+            pgmoneta_job_progress(msg->length, 0);
          }
          pgmoneta_consume_copy_stream_end(buffer, msg);
       }
@@ -583,9 +587,12 @@ error:
 }
 
 int
-pgmoneta_receive_archive_stream(int srv, SSL* ssl, int socket, struct stream_buffer* buffer, char* basedir, struct tablespace* tablespaces, struct token_bucket* bucket, struct token_bucket* network_bucket)
+pgmoneta_receive_archive_stream(int srv, SSL* ssl, int socket, struct stream_buffer* buffer, char* basedir, struct tablespace* tablespaces, bool passthrough,
+                                struct token_bucket* bucket, struct token_bucket* network_bucket)
 {
    struct query_response* response = NULL;
+   struct passthrough* pt = NULL;
+   struct main_configuration* config;
    struct message* msg = (struct message*)malloc(sizeof (struct message));
    struct tuple* tup = NULL;
    struct tablespace* tblspc = NULL;
@@ -604,6 +611,8 @@ pgmoneta_receive_archive_stream(int srv, SSL* ssl, int socket, struct stream_buf
    char type;
    FILE* file = NULL;
 
+   config = (struct main_configuration*)shmem;
+
    if (msg == NULL)
    {
       goto error;
@@ -644,6 +653,15 @@ pgmoneta_receive_archive_stream(int srv, SSL* ssl, int socket, struct stream_buf
          {
             case 'n':
             {
+               if (pt != NULL)
+               {
+                  if (pgmoneta_passthrough_finish(pt))
+                  {
+                     goto error;
+                  }
+                  pgmoneta_passthrough_destroy(pt);
+                  pt = NULL;
+               }
                // append two blocks of null buffer and extract the tar file
                if (file != NULL)
                {
@@ -716,6 +734,15 @@ pgmoneta_receive_archive_stream(int srv, SSL* ssl, int socket, struct stream_buf
                   }
                }
                pgmoneta_mkdir(directory);
+               if (passthrough && tup->data[1] == NULL)
+               {
+                  // keep the server side compressed archive as received
+                  if (pgmoneta_passthrough_create(directory, config->compression_type, &pt))
+                  {
+                     goto error;
+                  }
+                  break;
+               }
                file = fopen(file_path, "wb");
                if (file == NULL)
                {
@@ -727,6 +754,15 @@ pgmoneta_receive_archive_stream(int srv, SSL* ssl, int socket, struct stream_buf
             case 'm':
             {
                // start of manifest, finish off previous data archive receiving
+               if (pt != NULL)
+               {
+                  if (pgmoneta_passthrough_finish(pt))
+                  {
+                     goto error;
+                  }
+                  pgmoneta_passthrough_destroy(pt);
+                  pt = NULL;
+               }
                if (file != NULL)
                {
                   if ((!is_server_side_compression()) && fwrite(null_buffer, 2 * 512, 1, file) != 1)
@@ -779,11 +815,20 @@ pgmoneta_receive_archive_stream(int srv, SSL* ssl, int socket, struct stream_buf
                   }
                }
 
-               if (fwrite(msg->data + 1, msg->length - 1, 1, file) != 1)
+               if (pt != NULL)
+               {
+                  if (pgmoneta_passthrough_write(pt, msg->data + 1, msg->length - 1))
+                  {
+                     goto error;
+                  }
+               }
+               else if (fwrite(msg->data + 1, msg->length - 1, 1, file) != 1)
                {
                   pgmoneta_log_error("could not write to file %s", file_path);
                   goto error;
                }
+
+               pgmoneta_job_progress(msg->length - 1, 0);
                break;
             }
             case 'p':
@@ -868,6 +913,7 @@ error:
       fflush(file);
       fclose(file);
    }
+   pgmoneta_passthrough_destroy(pt);
    pgmoneta_free_query_response(response);
    pgmoneta_free_message(msg);
    return 1;
@@ -29,6 +29,7 @@
 #include <art.h>
 #include <json.h>
 #include <logging.h>
+#include <memory.h>
 #include <utils.h>
 
 #include <string.h>
@@ -133,26 +134,26 @@ static struct art_leaf*
 node_get_minimum(struct art_node* node);
 
 static void
-create_art_leaf(struct art_leaf** leaf, unsigned char* key, uint32_t key_len, uintptr_t value, enum value_type type, struct value_config* config);
+create_art_leaf(struct memory_arena* arena, struct art_leaf** leaf, unsigned char* key, uint32_t key_len, uintptr_t value, enum value_type type, struct value_config* config);
 
 static void
-create_art_node(struct art_node** node, enum art_node_type type);
+create_art_node(struct memory_arena* arena, struct art_node** node, enum art_node_type type);
 
 static void
-create_art_node4(struct art_node4** node);
+create_art_node4(struct memory_arena* arena, struct art_node4** node);
 
 static void
-create_art_node16(struct art_node16** node);
+create_art_node16(struct memory_arena* arena, struct art_node16** node);
 
 static void
-create_art_node48(struct art_node48** node);
+create_art_node48(struct memory_arena* arena, struct art_node48** node);
 
 static void
-create_art_node256(struct art_node256** node);
+create_art_node256(struct memory_arena* arena, struct art_node256** node);
 
 // Destroy ART nodes/leaves recursively
 static void
-destroy_art_node(struct art_node* node);
+destroy_art_node(struct memory_arena* arena, struct art_node* node);
 
 static int
 art_iterate(struct art* t, art_callback cb, void* data);
@@ -218,7 +219,7 @@ find_index(unsigned char ch, unsigned char* keys, int length);
  * @return Old value if the key exists, otherwise NULL
  */
 static struct value*
-art_node_insert(struct art_node* node, struct art_node** node_ref, uint32_t depth, unsigned char* key, uint32_t key_len, uintptr_t value, enum value_type type, struct value_config* config, bool* new);
+art_node_insert(struct memory_arena* arena, struct art_node* node, struct art_node** node_ref, uint32_t depth, unsigned char* key, uint32_t key_len, uintptr_t value, enum value_type type, struct value_config* config, bool* new);
 
 /**
  * Delete a value from a node recursively.
@@ -230,13 +231,13 @@ art_node_insert(struct art_node* node, struct art_node** node_ref, uint32_t dept
  * @return Deleted value if the key exists, otherwise NULL
  */
 static struct art_leaf*
-art_node_delete(struct art_node* node, struct art_node** node_ref, uint32_t depth, unsigned char* key, uint32_t key_len);
+art_node_delete(struct memory_arena* arena, struct art_node* node, struct art_node** node_ref, uint32_t depth, unsigned char* key, uint32_t key_len);
 
 static int
 art_node_iterate(struct art_node* node, art_callback cb, void* data);
 
 static void
-node_add_child(struct art_node* node, struct art_node** node_ref, unsigned char ch, void* child);
+node_add_child(struct memory_arena* arena, struct art_node* node, struct art_node** node_ref, unsigned char ch, void* child);
 
 /**
  * Add a child to the node. The function assumes node is not NULL,
@@ -249,13 +250,13 @@ node_add_child(struct art_node* node, struct art_node** node_ref, unsigned char
  * @param child The child
  */
 static void
-node4_add_child(struct art_node4* node, struct art_node** node_ref, unsigned char ch, void* child);
+node4_add_child(struct memory_arena* arena, struct art_node4* node, struct art_node** node_ref, unsigned char ch, void* child);
 
 static void
-node16_add_child(struct art_node16* node, struct art_node** node_ref, unsigned char ch, void* child);
+node16_add_child(struct memory_arena* arena, struct art_node16* node, struct art_node** node_ref, unsigned char ch, void* child);
 
 static void
-node48_add_child(struct art_node48* node, struct art_node** node_ref, unsigned char ch, void* child);
+node48_add_child(struct memory_arena* arena, struct art_node48* node, struct art_node** node_ref, unsigned char ch, void* child);
 
 static void
 node256_add_child(struct art_node256* node, unsigned char ch, void* child);
@@ -264,19 +265,19 @@ node256_add_child(struct art_node256* node, unsigned char ch, void* child);
 // They also do not free the leaf node for bookkeeping purpose. The key insight is that due to path compression,
 // no node will have only one child, if node has only one child after deletion, it merges with this child
 static void
-node_remove_child(struct art_node* node, struct art_node** node_ref, unsigned char ch);
+node_remove_child(struct memory_arena* arena, struct art_node* node, struct art_node** node_ref, unsigned char ch);
 
 static void
-node4_remove_child(struct art_node4* node, struct art_node** node_ref, unsigned char ch);
+node4_remove_child(struct memory_arena* arena, struct art_node4* node, struct art_node** node_ref, unsigned char ch);
 
 static void
-node16_remove_child(struct art_node16* node, struct art_node** node_ref, unsigned char ch);
+node16_remove_child(struct memory_arena* arena, struct art_node16* node, struct art_node** node_ref, unsigned char ch);
 
 static void
-node48_remove_child(struct art_node48* node, struct art_node** node_ref, unsigned char ch);
+node48_remove_child(struct memory_arena* arena, struct art_node48* node, struct art_node** node_ref, unsigned char ch);
 
 static void
-node256_remove_child(struct art_node256* node, struct art_node** node_ref, unsigned char ch);
+node256_remove_child(struct memory_arena* arena, struct art_node256* node, struct art_node** node_ref, unsigned char ch);
 
 static void
 copy_header(struct art_node* dest, struct art_node* src);
@@ -305,13 +306,57 @@ to_compact_json_string(struct art* t, char* tag, int indent);
 static char*
 to_text_string(struct art* t, char* tag, int indent);
 
+static int
+iterator_push(struct art_iterator* iter, struct art_node* node, uint32_t position);
+
+static struct art_node*
+iterator_next_child(struct art_iterator_frame* frame);
+
+static uint32_t
+iterator_position(struct art_node* node, unsigned char ch);
+
+static int
+iterator_prefix_compare(struct art_node* node, unsigned char* key, uint32_t key_len, uint32_t depth);
+
+static int
+iterator_leaf_compare(struct art_leaf* leaf, unsigned char* key, uint32_t key_len);
+
+/**
+ * Rebuild the iterator stack so that the next leaf is the first one
+ * greater than (strict) or greater than or equal to the key
+ * @param iter The iterator
+ * @param key The key
+ * @param key_len The length of the key
+ * @param strict Whether an equal key is skipped
+ * @return 0 on success, otherwise 1
+ */
+static int
+iterator_seek(struct art_iterator* iter, unsigned char* key, uint32_t key_len, bool strict);
+
+static int
+iterator_rewind(struct art_iterator* iter);
+
+static struct art_leaf*
+iterator_advance(struct art_iterator* iter);
+
 int
 pgmoneta_art_create(struct art** tree)
+{
+   return pgmoneta_art_create_with_arena(NULL, tree);
+}
+
+int
+pgmoneta_art_create_with_arena(struct memory_arena* arena, struct art** tree)
 {
    struct art* t = NULL;
-   t = malloc(sizeof(struct art));
+   t = pgmoneta_memory_arena_alloc(arena, sizeof(struct art));
+   if (t == NULL)
+   {
+      return 1;
+   }
    t->size = 0;
    t->root = NULL;
+   t->arena = arena;
    *tree = t;
    return 0;
 }
@@ -323,8 +368,8 @@ pgmoneta_art_destroy(struct art* tree)
    {
       return 0;
    }
-   destroy_art_node(tree->root);
-   free(tree);
+   destroy_art_node(tree->arena, tree->root);
+   pgmoneta_memory_arena_free(tree->arena, tree);
    return 0;
 }
 
@@ -382,8 +427,8 @@ pgmoneta_art_insert(struct art* t, char* key, uintptr_t value, enum value_type t
       // c'mon, at least create a tree first...
       goto error;
    }
-   old_val = art_node_insert(t->root, &t->root, 0, (unsigned char*)key, strlen(key) + 1, value, type, NULL, &new);
-   pgmoneta_value_destroy(old_val);
+   old_val = art_node_insert(t->arena, t->root, &t->root, 0, (unsigned char*)key, strlen(key) + 1, value, type, NULL, &new);
+   pgmoneta_value_destroy_with_arena(t->arena, old_val);
    if (new)
    {
       t->size++;
@@ -402,8 +447,8 @@ pgmoneta_art_insert_with_config(struct art* t, char* key, uintptr_t value, struc
    {
       goto error;
    }
-   old_val = art_node_insert(t->root, &t->root, 0, (unsigned char*)key, strlen(key) + 1, value, ValueRef, config, &new);
-   pgmoneta_value_destroy(old_val);
+   old_val = art_node_insert(t->arena, t->root, &t->root, 0, (unsigned char*)key, strlen(key) + 1, value, ValueRef, config, &new);
+   pgmoneta_value_destroy_with_arena(t->arena, old_val);
    if (new)
    {
       t->size++;
@@ -421,14 +466,14 @@ pgmoneta_art_delete(struct art* t, char* key)
    {
       return 1;
    }
-   l = art_node_delete(t->root, &t->root, 0, (unsigned char*)key, strlen(key) + 1);
+   l = art_node_delete(t->arena, t->root, &t->root, 0, (unsigned char*)key, strlen(key) + 1);
    if (l != NULL)
    {
       t->size--;
-      pgmoneta_value_destroy(l->value);
+      pgmoneta_value_destroy_with_arena(t->arena, l->value);
    }
 
-   free(l);
+   pgmoneta_memory_arena_free(t->arena, l);
    return 0;
 }
 
@@ -439,7 +484,7 @@ pgmoneta_art_clear(struct art* t)
    {
       return 0;
    }
-   destroy_art_node(t->root);
+   destroy_art_node(t->arena, t->root);
    t->root = NULL;
    t->size = 0;
    return 0;
@@ -474,19 +519,12 @@ min(uint32_t a, uint32_t b)
 }
 
 static void
-create_art_leaf(struct art_leaf** leaf, unsigned char* key, uint32_t key_len, uintptr_t value, enum value_type type, struct value_config* config)
+create_art_leaf(struct memory_arena* arena, struct art_leaf** leaf, unsigned char* key, uint32_t key_len, uintptr_t value, enum value_type type, struct value_config* config)
 {
    struct art_leaf* l = NULL;
-   l = malloc(sizeof(struct art_leaf) + key_len);
+   l = pgmoneta_memory_arena_alloc(arena, sizeof(struct art_leaf) + key_len);
    memset(l, 0, sizeof(struct art_leaf) + key_len);
-   if (config != NULL)
-   {
-      pgmoneta_value_create_with_config(value, config, &l->value);
-   }
-   else
-   {
-      pgmoneta_value_create(type, value, &l->value);
-   }
+   pgmoneta_value_create_with_arena(arena, type, value, config, &l->value);
 
    l->key_len = key_len;
    memcpy(l->key, key, key_len);
@@ -494,14 +532,14 @@ create_art_leaf(struct art_leaf** leaf, unsigned char* key, uint32_t key_len, ui
 }
 
 static void
-create_art_node(struct art_node** node, enum art_node_type type)
+create_art_node(struct memory_arena* arena, struct art_node** node, enum art_node_type type)
 {
    struct art_node* n = NULL;
    switch (type)
    {
       case Node4:
       {
-         struct art_node4* n4 = malloc(sizeof(struct art_node4));
+         struct art_node4* n4 = pgmoneta_memory_arena_alloc(arena, sizeof(struct art_node4));
          memset(n4, 0, sizeof(struct art_node4));
          n4->node.type = Node4;
          n = (struct art_node*) n4;
@@ -509,7 +547,7 @@ create_art_node(struct art_node** node, enum art_node_type type)
       }
       case Node16:
       {
-         struct art_node16* n16 = malloc(sizeof(struct art_node16));
+         struct art_node16* n16 = pgmoneta_memory_arena_alloc(arena, sizeof(struct art_node16));
          memset(n16, 0, sizeof(struct art_node16));
          n16->node.type = Node16;
          n = (struct art_node*) n16;
@@ -517,7 +555,7 @@ create_art_node(struct art_node** node, enum art_node_type type)
       }
       case Node48:
       {
-         struct art_node48* n48 = malloc(sizeof(struct art_node48));
+         struct art_node48* n48 = pgmoneta_memory_arena_alloc(arena, sizeof(struct art_node48));
          memset(n48, 0, sizeof(struct art_node48));
          n48->node.type = Node48;
          n = (struct art_node*) n48;
@@ -525,7 +563,7 @@ create_art_node(struct art_node** node, enum art_node_type type)
       }
       case Node256:
       {
-         struct art_node256* n256 = malloc(sizeof(struct art_node256));
+         struct art_node256* n256 = pgmoneta_memory_arena_alloc(arena, sizeof(struct art_node256));
          memset(n256, 0, sizeof(struct art_node256));
          n256->node.type = Node256;
          n = (struct art_node*) n256;
@@ -536,39 +574,39 @@ create_art_node(struct art_node** node, enum art_node_type type)
 }
 
 static void
-create_art_node4(struct art_node4** node)
+create_art_node4(struct memory_arena* arena, struct art_node4** node)
 {
    struct art_node* n = NULL;
-   create_art_node(&n, Node4);
+   create_art_node(arena, &n, Node4);
    *node = (struct art_node4*)n;
 }
 
 static void
-create_art_node16(struct art_node16** node)
+create_art_node16(struct memory_arena* arena, struct art_node16** node)
 {
    struct art_node* n = NULL;
-   create_art_node(&n, Node16);
+   create_art_node(arena, &n, Node16);
    *node = (struct art_node16*)n;
 }
 
 static void
-create_art_node48(struct art_node48** node)
+create_art_node48(struct memory_arena* arena, struct art_node48** node)
 {
    struct art_node* n = NULL;
-   create_art_node(&n, Node48);
+   create_art_node(arena, &n, Node48);
    *node = (struct art_node48*)n;
 }
 
 static void
-create_art_node256(struct art_node256** node)
+create_art_node256(struct memory_arena* arena, struct art_node256** node)
 {
    struct art_node* n = NULL;
-   create_art_node(&n, Node256);
+   create_art_node(arena, &n, Node256);
    *node = (struct art_node256*)n;
 }
 
 static void
-destroy_art_node(struct art_node* node)
+destroy_art_node(struct memory_arena* arena, struct art_node* node)
 {
    if (node == NULL)
    {
@@ -576,8 +614,8 @@ destroy_art_node(struct art_node* node)
    }
    if (IS_LEAF(node))
    {
-      pgmoneta_value_destroy(GET_LEAF(node)->value);
-      free(GET_LEAF(node));
+      pgmoneta_value_destroy_with_arena(arena, GET_LEAF(node)->value);
+      pgmoneta_memory_arena_free(arena, GET_LEAF(node));
       return;
    }
    switch (node->type)
@@ -587,7 +625,7 @@ destroy_art_node(struct art_node* node)
          struct art_node4* n = (struct art_node4*) node;
          for (int i = 0; i < node->num_children; i++)
          {
-            destroy_art_node(n->children[i]);
+            destroy_art_node(arena, n->children[i]);
          }
          break;
       }
@@ -596,7 +634,7 @@ destroy_art_node(struct art_node* node)
          struct art_node16* n = (struct art_node16*) node;
          for (int i = 0; i < node->num_children; i++)
          {
-            destroy_art_node(n->children[i]);
+            destroy_art_node(arena, n->children[i]);
          }
          break;
       }
@@ -610,7 +648,7 @@ destroy_art_node(struct art_node* node)
             {
                continue;
             }
-            destroy_art_node(n->children[idx - 1]);
+            destroy_art_node(arena, n->children[idx - 1]);
          }
          break;
       }
@@ -624,12 +662,12 @@ destroy_art_node(struct art_node* node)
             {
                continue;
             }
-            destroy_art_node(n->children[i]);
+            destroy_art_node(arena, n->children[i]);
          }
          break;
       }
    }
-   free(node);
+   pgmoneta_memory_arena_free(arena, node);
 }
 
 static struct art_node**
@@ -677,7 +715,7 @@ error:
 }
 
 static struct value*
-art_node_insert(struct art_node* node, struct art_node** node_ref, uint32_t depth, unsigned char* key, uint32_t key_len, uintptr_t value, enum value_type type, struct value_config* config, bool* new)
+art_node_insert(struct memory_arena* arena, struct art_node* node, struct art_node** node_ref, uint32_t depth, unsigned char* key, uint32_t key_len, uintptr_t value, enum value_type type, struct value_config* config, bool* new)
 {
    struct art_leaf* leaf = NULL;
    struct art_leaf* min_leaf = NULL;
@@ -691,7 +729,7 @@ art_node_insert(struct art_node* node, struct art_node** node_ref, uint32_t dept
    {
       // Lazy expansion, skip creating an inner node since it currently will have only this one leaf.
       // We will compare keys when reach leaf anyway, the path doesn't need to 100% match the key along the way
-      create_art_leaf(&leaf, key, key_len, value, type, config);
+      create_art_leaf(arena, &leaf, key, key_len, value, type, config);
       *node_ref = SET_LEAF(leaf);
       *new = true;
       return NULL;
@@ -704,14 +742,7 @@ art_node_insert(struct art_node* node, struct art_node** node_ref, uint32_t dept
       if (leaf_match(GET_LEAF(node), key, key_len))
       {
          old_val = GET_LEAF(node)->value;
-         if (config != NULL)
-         {
-            pgmoneta_value_create_with_config(value, config, &(GET_LEAF(node)->value));
-         }
-         else
-         {
-            pgmoneta_value_create(type, value, &(GET_LEAF(node)->value));
-         }
+         pgmoneta_value_create_with_arena(arena, type, value, config, &(GET_LEAF(node)->value));
          return old_val;
       }
       // If the key does not match with existing key, old key and new key diverged some point after depth
@@ -720,8 +751,8 @@ art_node_insert(struct art_node* node, struct art_node** node_ref, uint32_t dept
       // we compare with the existing key in the left most leaf and find an exact diverging point to split the node (see details below).
       // This way we inductively guarantee that all children to a parent share the same prefix even if it's only partially stored
       leaf_key = GET_LEAF(node)->key;
-      create_art_node(&new_node, Node4);
-      create_art_leaf(&leaf, key, key_len, value, type, config);
+      create_art_node(arena, &new_node, Node4);
+      create_art_leaf(arena, &leaf, key, key_len, value, type, config);
       // Get the diverging index after point of depth
       for (idx = depth; idx < min(key_len, GET_LEAF(node)->key_len); idx++)
       {
@@ -736,8 +767,8 @@ art_node_insert(struct art_node* node, struct art_node** node_ref, uint32_t dept
       }
       new_node->prefix_len = idx - depth;
       depth += new_node->prefix_len;
-      node_add_child(new_node, &new_node, key[depth], SET_LEAF(leaf));
-      node_add_child(new_node, &new_node, leaf_key[depth], (void*)node);
+      node_add_child(arena, new_node, &new_node, key[depth], SET_LEAF(leaf));
+      node_add_child(arena, new_node, &new_node, leaf_key[depth], (void*)node);
       // replace with new node
       *node_ref = new_node;
       *new = true;
@@ -762,8 +793,8 @@ art_node_insert(struct art_node* node, struct art_node** node_ref, uint32_t dept
    if (diff_len < node->prefix_len)
    {
       // case 2, split the node
-      create_art_node(&new_node, Node4);
-      create_art_leaf(&leaf, key, key_len, value, type, config);
+      create_art_node(arena, &new_node, Node4);
+      create_art_leaf(arena, &leaf, key, key_len, value, type, config);
       new_node->prefix_len = diff_len;
       memcpy(new_node->prefix, node->prefix, min(MAX_PREFIX_LEN, diff_len));
       // We need to know if new bytes that were once outside the partial prefix range will now come into the range
@@ -772,8 +803,8 @@ art_node_insert(struct art_node* node, struct art_node** node_ref, uint32_t dept
       if (node->prefix_len <= MAX_PREFIX_LEN)
       {
          node->prefix_len = node->prefix_len - (diff_len + 1);
-         node_add_child(new_node, &new_node, key[depth + diff_len], SET_LEAF(leaf));
-         node_add_child(new_node, &new_node, node->prefix[diff_len], node);
+         node_add_child(arena, new_node, &new_node, key[depth + diff_len], SET_LEAF(leaf));
+         node_add_child(arena, new_node, &new_node, node->prefix[diff_len], node);
          // Update node's prefix info since we move it downwards
          // The first diverging character serves as the key byte in keys array,
          // so we don't duplicate store it in the prefix.
@@ -787,8 +818,8 @@ art_node_insert(struct art_node* node, struct art_node** node_ref, uint32_t dept
       {
          node->prefix_len = node->prefix_len - (diff_len + 1);
          min_leaf = node_get_minimum(node);
-         node_add_child(new_node, &new_node, key[depth + diff_len], SET_LEAF(leaf));
-         node_add_child(new_node, &new_node, min_leaf->key[depth + diff_len], node);
+         node_add_child(arena, new_node, &new_node, key[depth + diff_len], SET_LEAF(leaf));
+         node_add_child(arena, new_node, &new_node, min_leaf->key[depth + diff_len], node);
          // node is moved downwards
          memmove(node->prefix, min_leaf->key + depth + diff_len + 1, min(MAX_PREFIX_LEN, node->prefix_len));
       }
@@ -809,13 +840,13 @@ art_node_insert(struct art_node* node, struct art_node** node_ref, uint32_t dept
          {
             node->num_children++;
          }
-         return art_node_insert(*next, next, depth + 1, key, key_len, value, type, config, new);
+         return art_node_insert(arena, *next, next, depth + 1, key, key_len, value, type, config, new);
       }
       else
       {
          // add a child to current node since the spot is available
-         create_art_leaf(&leaf, key, key_len, value, type, config);
-         node_add_child(node, node_ref, key[depth], SET_LEAF(leaf));
+         create_art_leaf(arena, &leaf, key, key_len, value, type, config);
+         node_add_child(arena, node, node_ref, key[depth], SET_LEAF(leaf));
          *new = true;
          return NULL;
       }
@@ -823,7 +854,7 @@ art_node_insert(struct art_node* node, struct art_node** node_ref, uint32_t dept
 }
 
 static struct art_leaf*
-art_node_delete(struct art_node* node, struct art_node** node_ref, uint32_t depth, unsigned char* key, uint32_t key_len)
+art_node_delete(struct memory_arena* arena, struct art_node* node, struct art_node** node_ref, uint32_t depth, unsigned char* key, uint32_t key_len)
 {
    struct art_leaf* l = NULL;
    struct art_node** child = NULL;
@@ -866,7 +897,7 @@ art_node_delete(struct art_node* node, struct art_node** node_ref, uint32_t dept
          if (leaf_match(GET_LEAF(*child), key, key_len))
          {
             l = GET_LEAF(*child);
-            node_remove_child(node, node_ref, key[depth]);
+            node_remove_child(arena, node, node_ref, key[depth]);
             return l;
          }
          else
@@ -876,7 +907,7 @@ art_node_delete(struct art_node* node, struct art_node** node_ref, uint32_t dept
       }
       else
       {
-         return art_node_delete(*child, child, depth + 1, key, key_len);
+         return art_node_delete(arena, *child, child, depth + 1, key, key_len);
       }
    }
 }
@@ -969,18 +1000,18 @@ art_node_iterate(struct art_node* node, art_callback cb, void* data)
 }
 
 static void
-node_add_child(struct art_node* node, struct art_node** node_ref, unsigned char ch, void* child)
+node_add_child(struct memory_arena* arena, struct art_node* node, struct art_node** node_ref, unsigned char ch, void* child)
 {
    switch (node->type)
    {
       case Node4:
-         node4_add_child((struct art_node4*) node, node_ref, ch, child);
+         node4_add_child(arena, (struct art_node4*) node, node_ref, ch, child);
          break;
       case Node16:
-         node16_add_child((struct art_node16*) node, node_ref, ch, child);
+         node16_add_child(arena, (struct art_node16*) node, node_ref, ch, child);
          break;
       case Node48:
-         node48_add_child((struct art_node48*) node, node_ref, ch, child);
+         node48_add_child(arena, (struct art_node48*) node, node_ref, ch, child);
          break;
       case Node256:
          node256_add_child((struct art_node256*) node, ch, child);
@@ -989,7 +1020,7 @@ node_add_child(struct art_node* node, struct art_node** node_ref, unsigned char
 }
 
 static void
-node4_add_child(struct art_node4* node, struct art_node** node_ref, unsigned char ch, void* child)
+node4_add_child(struct memory_arena* arena, struct art_node4* node, struct art_node** node_ref, unsigned char ch, void* child)
 {
    if (node->node.num_children < 4)
    {
@@ -1006,20 +1037,20 @@ node4_add_child(struct art_node4* node, struct art_node** node_ref, unsigned cha
    {
       // expand
       struct art_node16* new_node = NULL;
-      create_art_node16(&new_node);
+      create_art_node16(arena, &new_node);
       copy_header((struct art_node*)new_node, (struct art_node*)node);
       memcpy(new_node->children, node->children, node->node.num_children * sizeof(void*));
       memcpy(new_node->keys, node->keys, node->node.num_children);
       // replace the node through node reference
       *node_ref = (struct art_node*)new_node;
-      free(node);
+      pgmoneta_memory_arena_free(arena, node);
 
-      node16_add_child(new_node, node_ref, ch, child);
+      node16_add_child(arena, new_node, node_ref, ch, child);
    }
 }
 
 static void
-node16_add_child(struct art_node16* node, struct art_node** node_ref, unsigned char ch, void* child)
+node16_add_child(struct memory_arena* arena, struct art_node16* node, struct art_node** node_ref, unsigned char ch, void* child)
 {
    if (node->node.num_children < 16)
    {
@@ -1036,7 +1067,7 @@ node16_add_child(struct art_node16* node, struct art_node** node_ref, unsigned c
    {
       // expand
       struct art_node48* new_node = NULL;
-      create_art_node48(&new_node);
+      create_art_node48(arena, &new_node);
       copy_header((struct art_node*)new_node, (struct art_node*)node);
       memcpy(new_node->children, node->children, node->node.num_children * sizeof(void*));
       for (int i = 0; i < node->node.num_children; i++)
@@ -1045,13 +1076,13 @@ node16_add_child(struct art_node16* node, struct art_node** node_ref, unsigned c
       }
       // replace the node through node reference
       *node_ref = (struct art_node*)new_node;
-      free(node);
-      node48_add_child(new_node, node_ref, ch, child);
+      pgmoneta_memory_arena_free(arena, node);
+      node48_add_child(arena, new_node, node_ref, ch, child);
    }
 }
 
 static void
-node48_add_child(struct art_node48* node, struct art_node** node_ref, unsigned char ch, void* child)
+node48_add_child(struct memory_arena* arena, struct art_node48* node, struct art_node** node_ref, unsigned char ch, void* child)
 {
    if (node->node.num_children < 48)
    {
@@ -1069,7 +1100,7 @@ node48_add_child(struct art_node48* node, struct art_node** node_ref, unsigned c
    {
       // expand
       struct art_node256* new_node = NULL;
-      create_art_node256(&new_node);
+      create_art_node256(arena, &new_node);
       copy_header((struct art_node*)new_node, (struct art_node*)node);
       for (int i = 0; i < 256; i++)
       {
@@ -1081,7 +1112,7 @@ node48_add_child(struct art_node48* node, struct art_node** node_ref, unsigned c
       }
       // replace the node through node reference
       *node_ref = (struct art_node*)new_node;
-      free(node);
+      pgmoneta_memory_arena_free(arena, node);
       node256_add_child(new_node, ch, child);
    }
 }
@@ -1241,27 +1272,27 @@ node_get_minimum(struct art_node* node)
 }
 
 static void
-node_remove_child(struct art_node* node, struct art_node** node_ref, unsigned char ch)
+node_remove_child(struct memory_arena* arena, struct art_node* node, struct art_node** node_ref, unsigned char ch)
 {
    switch (node->type)
    {
       case Node4:
-         node4_remove_child((struct art_node4*)node, node_ref, ch);
+         node4_remove_child(arena, (struct art_node4*)node, node_ref, ch);
          break;
       case Node16:
-         node16_remove_child((struct art_node16*)node, node_ref, ch);
+         node16_remove_child(arena, (struct art_node16*)node, node_ref, ch);
          break;
       case Node48:
-         node48_remove_child((struct art_node48*)node, node_ref, ch);
+         node48_remove_child(arena, (struct art_node48*)node, node_ref, ch);
          break;
       case Node256:
-         node256_remove_child((struct art_node256*)node, node_ref, ch);
+         node256_remove_child(arena, (struct art_node256*)node, node_ref, ch);
          break;
    }
 }
 
 static void
-node4_remove_child(struct art_node4* node, struct art_node** node_ref, unsigned char ch)
+node4_remove_child(struct memory_arena* arena, struct art_node4* node, struct art_node** node_ref, unsigned char ch)
 {
    int idx = 0;
    uint32_t len = 0;
@@ -1277,7 +1308,7 @@ node4_remove_child(struct art_node4* node, struct art_node** node_ref, unsigned
       if (IS_LEAF(child))
       {
          // replace directly
-         free(node);
+         pgmoneta_memory_arena_free(arena, node);
          *node_ref = child;
          return;
       }
@@ -1295,14 +1326,14 @@ node4_remove_child(struct art_node4* node, struct art_node** node_ref, unsigned
       }
       child->prefix_len = node->node.prefix_len + 1 + child->prefix_len;
       memcpy(child->prefix, node->node.prefix, min(child->prefix_len, MAX_PREFIX_LEN));
-      free(node);
+      pgmoneta_memory_arena_free(arena, node);
       // replace
       *node_ref = child;
    }
 }
 
 static void
-node16_remove_child(struct art_node16* node, struct art_node** node_ref, unsigned char ch)
+node16_remove_child(struct memory_arena* arena, struct art_node16* node, struct art_node** node_ref, unsigned char ch)
 {
    int idx = 0;
    struct art_node4* new_node = NULL;
@@ -1314,17 +1345,17 @@ node16_remove_child(struct art_node16* node, struct art_node** node_ref, unsigne
    // Trick from libart, do not downgrade immediately to avoid jumping on 4/5 boundary
    if (node->node.num_children <= 3)
    {
-      create_art_node4(&new_node);
+      create_art_node4(arena, &new_node);
       copy_header((struct art_node*)new_node, (struct art_node*)node);
       memcpy(new_node->keys, node->keys, node->node.num_children);
       memcpy(new_node->children, node->children, node->node.num_children * sizeof(void*));
-      free(node);
+      pgmoneta_memory_arena_free(arena, node);
       *node_ref = (struct art_node*)new_node;
    }
 }
 
 static void
-node48_remove_child(struct art_node48* node, struct art_node** node_ref, unsigned char ch)
+node48_remove_child(struct memory_arena* arena, struct art_node48* node, struct art_node** node_ref, unsigned char ch)
 {
    int idx = node->keys[ch];
    int cnt = 0;
@@ -1335,7 +1366,7 @@ node48_remove_child(struct art_node48* node, struct art_node** node_ref, unsigne
 
    if (node->node.num_children <= 12)
    {
-      create_art_node16(&new_node);
+      create_art_node16(arena, &new_node);
       copy_header((struct art_node*)new_node, (struct art_node*)node);
       for (int i = 0; i < 256; i++)
       {
@@ -1346,13 +1377,13 @@ node48_remove_child(struct art_node48* node, struct art_node** node_ref, unsigne
             cnt++;
          }
       }
-      free(node);
+      pgmoneta_memory_arena_free(arena, node);
       *node_ref = (struct art_node*)new_node;
    }
 }
 
 static void
-node256_remove_child(struct art_node256* node, struct art_node** node_ref, unsigned char ch)
+node256_remove_child(struct memory_arena* arena, struct art_node256* node, struct art_node** node_ref, unsigned char ch)
 {
    int num = 0;
    for (int i = 0; i < 48; i++)
@@ -1373,7 +1404,7 @@ node256_remove_child(struct art_node256* node, struct art_node** node_ref, unsig
 
    if (node->node.num_children <= 37)
    {
-      create_art_node48(&new_node);
+      create_art_node48(arena, &new_node);
       copy_header((struct art_node*)new_node, (struct art_node*)node);
       for (int i = 0; i < 256; i++)
       {
@@ -1384,7 +1415,7 @@ node256_remove_child(struct art_node256* node, struct art_node** node_ref, unsig
             cnt++;
          }
       }
-      free(node);
+      pgmoneta_memory_arena_free(arena, node);
       *node_ref = (struct art_node*)new_node;
    }
 }
@@ -1398,11 +1429,15 @@ pgmoneta_art_iterator_create(struct art* t, struct art_iterator** iter)
       return 1;
    }
    i = malloc(sizeof(struct art_iterator));
-   i->count = 0;
+   if (i == NULL)
+   {
+      return 1;
+   }
+   memset(i, 0, sizeof(struct art_iterator));
    i->tree = t;
-   i->key = NULL;
-   i->value = NULL;
-   pgmoneta_deque_create(false, &i->que);
+   i->stack = i->frames;
+   i->capacity = ART_ITERATOR_FRAMES;
+   iterator_rewind(i);
    *iter = i;
    return 0;
 }
@@ -1410,85 +1445,25 @@ pgmoneta_art_iterator_create(struct art* t, struct art_iterator** iter)
 bool
 pgmoneta_art_iterator_next(struct art_iterator* iter)
 {
-   struct deque* que = NULL;
-   struct art* tree = NULL;
-   struct art_node* node = NULL;
-   struct art_node* child = NULL;
-   int idx = 0;
-   if (iter == NULL || iter->que == NULL || iter->tree == NULL || iter->count == iter->tree->size)
+   struct art_leaf* leaf = NULL;
+   if (iter == NULL || iter->tree == NULL)
    {
       return false;
    }
-   que = iter->que;
-   tree = iter->tree;
-   if (iter->count == 0)
+   leaf = (struct art_leaf*)iter->peek;
+   iter->peek = NULL;
+   if (leaf == NULL)
    {
-      pgmoneta_deque_add(que, NULL, (uintptr_t)tree->root, ValueRef);
+      leaf = iterator_advance(iter);
    }
-   while (!pgmoneta_deque_empty(que))
+   if (leaf == NULL)
    {
-      node = (struct art_node*)pgmoneta_deque_poll(que, NULL);
-      if (IS_LEAF(node))
-      {
-         iter->count++;
-         iter->key = (char*)GET_LEAF(node)->key;
-         iter->value = GET_LEAF(node)->value;
-         return true;
-      }
-      switch (node->type)
-      {
-         case Node4:
-         {
-            struct art_node4* n = (struct art_node4*) node;
-            for (int i = 0; i < node->num_children; i++)
-            {
-               child = n->children[i];
-               pgmoneta_deque_add(que, NULL, (uintptr_t)child, ValueRef);
-            }
-            break;
-         }
-         case Node16:
-         {
-            struct art_node16* n = (struct art_node16*) node;
-            for (int i = 0; i < node->num_children; i++)
-            {
-               child = n->children[i];
-               pgmoneta_deque_add(que, NULL, (uintptr_t)child, ValueRef);
-            }
-            break;
-         }
-         case Node48:
-         {
-            struct art_node48* n = (struct art_node48*) node;
-            for (int i = 0; i < 256; i++)
-            {
-               idx = n->keys[i];
-               if (idx == 0)
-               {
-                  continue;
-               }
-               child = n->children[idx - 1];
-               pgmoneta_deque_add(que, NULL, (uintptr_t)child, ValueRef);
-            }
-            break;
-         }
-         case Node256:
-         {
-            struct art_node256* n = (struct art_node256*) node;
-            for (int i = 0; i < 256; i++)
-            {
-               if (n->children[i] == NULL)
-               {
-                  continue;
-               }
-               child = n->children[i];
-               pgmoneta_deque_add(que, NULL, (uintptr_t)child, ValueRef);
-            }
-            break;
-         }
-      }
+      return false;
    }
-   return false;
+   iter->count++;
+   iter->key = (char*)leaf->key;
+   iter->value = leaf->value;
+   return true;
 }
 
 bool
@@ -1498,23 +1473,110 @@ pgmoneta_art_iterator_has_next(struct art_iterator* iter)
    {
       return false;
    }
-   return iter->count < iter->tree->size;
+   if (iter->peek == NULL)
+   {
+      iter->peek = iterator_advance(iter);
+   }
+   return iter->peek != NULL;
 }
 
 void
 pgmoneta_art_iterator_remove(struct art_iterator* iter)
 {
+   size_t len = 0;
+   char* resume = NULL;
+
    if (iter == NULL || iter->tree == NULL || iter->key == NULL)
    {
       return;
    }
 
-   pgmoneta_art_delete(iter->tree, iter->key);
+   // Deleting may shrink or free the nodes on the stack,
+   // so remember the key and descend again on the next step
+   len = strlen(iter->key) + 1;
+   if (len > iter->resume_size)
+   {
+      resume = realloc(iter->resume, len);
+      if (resume == NULL)
+      {
+         pgmoneta_art_delete(iter->tree, iter->key);
+         iter->end = true;
+         goto done;
+      }
+      iter->resume = resume;
+      iter->resume_size = len;
+   }
+   memcpy(iter->resume, iter->key, len);
+
+   pgmoneta_art_delete(iter->tree, iter->resume);
+   iter->reseek = true;
+
+done:
+   iter->depth = 0;
+   iter->peek = NULL;
    iter->key = NULL;
    iter->value = NULL;
    iter->count--;
 }
 
+int
+pgmoneta_art_iterator_seek(struct art_iterator* iter, char* key)
+{
+   if (iter == NULL || iter->tree == NULL || key == NULL)
+   {
+      return 1;
+   }
+   return iterator_seek(iter, (unsigned char*)key, strlen(key) + 1, false);
+}
+
+int
+pgmoneta_art_iterator_range(struct art_iterator* iter, char* from, char* to)
+{
+   if (iter == NULL || iter->tree == NULL)
+   {
+      return 1;
+   }
+
+   free(iter->bound);
+   iter->bound = NULL;
+   iter->prefix = false;
+
+   if (to != NULL)
+   {
+      iter->bound = strdup(to);
+      if (iter->bound == NULL)
+      {
+         return 1;
+      }
+   }
+
+   if (from != NULL)
+   {
+      return pgmoneta_art_iterator_seek(iter, from);
+   }
+   return iterator_rewind(iter);
+}
+
+int
+pgmoneta_art_iterator_prefix(struct art_iterator* iter, char* prefix)
+{
+   if (iter == NULL || iter->tree == NULL || prefix == NULL)
+   {
+      return 1;
+   }
+
+   free(iter->bound);
+   iter->bound = strdup(prefix);
+   iter->prefix = true;
+   if (iter->bound == NULL)
+   {
+      return 1;
+   }
+
+   // Every key starting with the prefix sorts at or after the prefix itself
+   return pgmoneta_art_iterator_seek(iter, prefix);
+}
+
 void
 pgmoneta_art_iterator_destroy(struct art_iterator* iter)
 {
@@ -1522,7 +1584,12 @@ pgmoneta_art_iterator_destroy(struct art_iterator* iter)
    {
       return;
    }
-   pgmoneta_deque_destroy(iter->que);
+   if (iter->stack != iter->frames)
+   {
+      free(iter->stack);
+   }
+   free(iter->bound);
+   free(iter->resume);
    free(iter);
 }
 
@@ -1755,3 +1822,309 @@ art_iterate(struct art* t, art_callback cb, void* data)
 {
    return art_node_iterate(t->root, cb, data);
 }
+
+static int
+iterator_push(struct art_iterator* iter, struct art_node* node, uint32_t position)
+{
+   struct art_iterator_frame* stack = NULL;
+
+   if (iter->depth == iter->capacity)
+   {
+      if (iter->stack == iter->frames)
+      {
+         stack = malloc(iter->capacity * 2 * sizeof(struct art_iterator_frame));
+         if (stack != NULL)
+         {
+            memcpy(stack, iter->frames, iter->depth * sizeof(struct art_iterator_frame));
+         }
+      }
+      else
+      {
+         stack = realloc(iter->stack, iter->capacity * 2 * sizeof(struct art_iterator_frame));
+      }
+      if (stack == NULL)
+      {
+         return 1;
+      }
+      iter->stack = stack;
+      iter->capacity *= 2;
+   }
+
+   iter->stack[iter->depth].node = node;
+   iter->stack[iter->depth].position = position;
+   iter->depth++;
+   return 0;
+}
+
+static struct art_node*
+iterator_next_child(struct art_iterator_frame* frame)
+{
+   struct art_node* node = frame->node;
+   struct art_node* child = NULL;
+   int idx = 0;
+
+   switch (node->type)
+   {
+      case Node4:
+      {
+         struct art_node4* n = (struct art_node4*)node;
+         if (frame->position < node->num_children)
+         {
+            return n->children[frame->position++];
+         }
+         break;
+      }
+      case Node16:
+      {
+         struct art_node16* n = (struct art_node16*)node;
+         if (frame->position < node->num_children)
+         {
+            return n->children[frame->position++];
+         }
+         break;
+      }
+      case Node48:
+      {
+         struct art_node48* n = (struct art_node48*)node;
+         while (frame->position < 256)
+         {
+            idx = n->keys[frame->position++];
+            if (idx != 0)
+            {
+               return n->children[idx - 1];
+            }
+         }
+         break;
+      }
+      case Node256:
+      {
+         struct art_node256* n = (struct art_node256*)node;
+         while (frame->position < 256)
+         {
+            child = n->children[frame->position++];
+            if (child != NULL)
+            {
+               return child;
+            }
+         }
+         break;
+      }
+   }
+   return NULL;
+}
+
+static uint32_t
+iterator_position(struct art_node* node, unsigned char ch)
+{
+   uint32_t i = 0;
+
+   switch (node->type)
+   {
+      case Node4:
+      {
+         struct art_node4* n = (struct art_node4*)node;
+         while (i < node->num_children && n->keys[i] <= ch)
+         {
+            i++;
+         }
+         return i;
+      }
+      case Node16:
+      {
+         struct art_node16* n = (struct art_node16*)node;
+         while (i < node->num_children && n->keys[i] <= ch)
+         {
+            i++;
+         }
+         return i;
+      }
+      case Node48:
+      case Node256:
+         return (uint32_t)ch + 1;
+   }
+   return 0;
+}
+
+static int
+iterator_prefix_compare(struct art_node* node, unsigned char* key, uint32_t key_len, uint32_t depth)
+{
+   unsigned char* prefix = node->prefix;
+
+   // Only the first MAX_PREFIX_LEN bytes are stored in the node,
+   // the rest is taken from any leaf below it
+   if (node->prefix_len > MAX_PREFIX_LEN)
+   {
+      prefix = node_get_minimum(node)->key + depth;
+   }
+
+   for (uint32_t i = 0; i < node->prefix_len; i++)
+   {
+      if (depth + i >= key_len)
+      {
+         return 1;
+      }
+      if (prefix[i] != key[depth + i])
+      {
+         return prefix[i] < key[depth + i] ? -1 : 1;
+      }
+   }
+   return 0;
+}
+
+static int
+iterator_leaf_compare(struct art_leaf* leaf, unsigned char* key, uint32_t key_len)
+{
+   int cmp = memcmp(leaf->key, key, min(leaf->key_len, key_len));
+   if (cmp != 0)
+   {
+      return cmp;
+   }
+   return (int)leaf->key_len - (int)key_len;
+}
+
+static int
+iterator_seek(struct art_iterator* iter, unsigned char* key, uint32_t key_len, bool strict)
+{
+   struct art_node* node = iter->tree->root;
+   struct art_node** child = NULL;
+   uint32_t depth = 0;
+   int cmp = 0;
+
+   iter->depth = 0;
+   iter->peek = NULL;
+   iter->end = false;
+   iter->reseek = false;
+
+   // Walk down the path of the key; every node passed keeps
+   // the children after the key byte for later, and the walk stops
+   // at the first subtree that is entirely before or after the key
+   while (node != NULL)
+   {
+      if (IS_LEAF(node))
+      {
+         cmp = iterator_leaf_compare(GET_LEAF(node), key, key_len);
+         if (cmp > 0 || (cmp == 0 && !strict))
+         {
+            if (iterator_push(iter, node, 0))
+            {
+               goto error;
+            }
+         }
+         break;
+      }
+
+      cmp = iterator_prefix_compare(node, key, key_len, depth);
+      if (cmp < 0)
+      {
+         break;
+      }
+      depth += node->prefix_len;
+      if (cmp > 0 || depth >= key_len)
+      {
+         if (iterator_push(iter, node, 0))
+         {
+            goto error;
+         }
+         break;
+      }
+
+      if (iterator_push(iter, node, iterator_position(node, key[depth])))
+      {
+         goto error;
+      }
+
+      child = node_get_child(node, key[depth]);
+      node = child != NULL ? *child : NULL;
+      depth++;
+   }
+
+   return 0;
+
+error:
+   iter->depth = 0;
+   iter->end = true;
+   return 1;
+}
+
+static int
+iterator_rewind(struct art_iterator* iter)
+{
+   iter->depth = 0;
+   iter->peek = NULL;
+   iter->end = false;
+   iter->reseek = false;
+
+   if (iter->tree->root != NULL && iterator_push(iter, iter->tree->root, 0))
+   {
+      iter->end = true;
+      return 1;
+   }
+   return 0;
+}
+
+static struct art_leaf*
+iterator_advance(struct art_iterator* iter)
+{
+   struct art_iterator_frame* frame = NULL;
+   struct art_node* child = NULL;
+   struct art_leaf* leaf = NULL;
+
+   if (iter->end)
+   {
+      return NULL;
+   }
+
+   if (iter->reseek && iterator_seek(iter, (unsigned char*)iter->resume, strlen(iter->resume) + 1, true))
+   {
+      return NULL;
+   }
+
+   while (leaf == NULL && iter->depth > 0)
+   {
+      frame = &iter->stack[iter->depth - 1];
+
+      if (IS_LEAF(frame->node))
+      {
+         leaf = GET_LEAF(frame->node);
+         iter->depth--;
+         continue;
+      }
+
+      child = iterator_next_child(frame);
+      if (child == NULL)
+      {
+         iter->depth--;
+      }
+      else if (IS_LEAF(child))
+      {
+         leaf = GET_LEAF(child);
+      }
+      else if (iterator_push(iter, child, 0))
+      {
+         iter->depth = 0;
+      }
+   }
+
+   if (leaf != NULL && iter->bound != NULL)
+   {
+      if (iter->prefix)
+      {
+         if (strncmp((char*)leaf->key, iter->bound, strlen(iter->bound)))
+         {
+            leaf = NULL;
+         }
+      }
+      else if (strcmp((char*)leaf->key, iter->bound) >= 0)
+      {
+         leaf = NULL;
+      }
+   }
+
+   if (leaf == NULL)
+   {
+      iter->depth = 0;
+      iter->end = true;
+   }
+
+   return leaf;
+}
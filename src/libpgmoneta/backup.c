@@ -32,6 +32,7 @@
 #include <art.h>
 #include <backup.h>
 #include <compression.h>
+#include <delete.h>
 #include <info.h>
 #include <logging.h>
 #include <management.h>
@@ -200,6 +201,13 @@ pgmoneta_backup(int client_fd, int server, uint8_t compression, uint8_t encrypti
          goto error;
       }
 
+      if (backups[backup_index]->passthrough)
+      {
+         ec = MANAGEMENT_ERROR_BACKUP_INVALID;
+         pgmoneta_log_error("Backup: Incremental backup not supported on passthrough archive %s/%s", config->common.servers[server].name, incremental);
+         goto error;
+      }
+
       incremental_base = pgmoneta_get_server_backup_identifier(server, backups[backup_index]->label);
 
       pgmoneta_art_insert(nodes, NODE_INCREMENTAL_BASE, (uintptr_t) incremental_base, ValueString);
@@ -220,6 +228,7 @@ pgmoneta_backup(int client_fd, int server, uint8_t compression, uint8_t encrypti
    }
 
    backup->backup_size = pgmoneta_directory_size(backup_data);
+   pgmoneta_disk_usage_add(server, DISK_USAGE_BACKUP, backup->backup_size);
 
    if (pgmoneta_save_info(server_backup, backup))
    {
@@ -713,6 +722,9 @@ pgmoneta_delete_backup(int client_fd, int srv, uint8_t compression, uint8_t encr
 
    pgmoneta_disconnect(client_fd);
 
+   /* The client has the response, the files are removed in the background */
+   pgmoneta_purge_trash(srv);
+
    pgmoneta_stop_logging();
 
    exit(0);
@@ -35,8 +35,12 @@
 #include <wal.h>
 #include <walfile/wal_reader.h>
 
-static void generate_art_key_from_brt_key(block_ref_table_key brt_key, char** art_key);
-static int brt_comparator(const void* a, const void* b);
+#include <stdio.h>
+
+/* Four zero padded hex fields and the terminator, so the ART keys sort like the serialized entries */
+#define BRT_ART_KEY_LENGTH 33
+
+static void generate_art_key_from_brt_key(block_ref_table_key brt_key, char* art_key);
 static int brt_insert(block_ref_table* brt, block_ref_table_key key, block_ref_table_entry** brt_entry, bool* found);
 static block_ref_table_entry* brt_lookup(block_ref_table* brt, block_ref_table_key key);
 
@@ -272,13 +276,12 @@ int
 pgmoneta_brt_write(block_ref_table* brt, char* file_path)
 {
    FILE* file = NULL;
-   block_ref_table_serialized_entry* sdata = NULL;
    block_ref_table_buffer* buffer = NULL;
    uint32_t magic = BLOCKREFTABLE_MAGIC;
    struct art_iterator* it = NULL;
    block_ref_table_entry* brtentry = NULL;
-   block_ref_table_serialized_entry* sentry = NULL;
-   unsigned i = 0, j;
+   block_ref_table_serialized_entry sentry;
+   unsigned j;
 
    file = fopen(file_path, "w+");
    if (file == NULL)
@@ -297,57 +300,36 @@ pgmoneta_brt_write(block_ref_table* brt, char* file_path)
 
    if (brt->table->size > 0)
    {
-      i = 0;
-
-      /* Extract entries into serializable format and sort them. */
-      if ((sdata = malloc(brt->table->size * sizeof(block_ref_table_serialized_entry))) == NULL)
-      {
-         goto error;
-      }
-
       if (pgmoneta_art_iterator_create(brt->table, &it))
       {
          goto error;
       }
 
+      /* The ART keys sort in (spcOid, dbOid, relNumber, forknum) order, so entries stream out already sorted. */
       while (pgmoneta_art_iterator_next(it))
       {
          brtentry = (block_ref_table_entry*)it->value->data;
-         block_ref_table_serialized_entry* sentry = &sdata[i++];
 
-         sentry->rlocator = brtentry->key.rlocator;
-         sentry->forknum = brtentry->key.forknum;
-         sentry->limit_block = brtentry->limit_block;
-         sentry->nchunks = brtentry->nchunks;
+         memset(&sentry, 0, sizeof(block_ref_table_serialized_entry));
+         sentry.rlocator = brtentry->key.rlocator;
+         sentry.forknum = brtentry->key.forknum;
+         sentry.limit_block = brtentry->limit_block;
+         sentry.nchunks = brtentry->nchunks;
 
          /* trim trailing zero entries */
-         while (sentry->nchunks > 0 &&
-                brtentry->chunk_usage[sentry->nchunks - 1] == 0)
+         while (sentry.nchunks > 0 &&
+                brtentry->chunk_usage[sentry.nchunks - 1] == 0)
          {
-            sentry->nchunks--;
+            sentry.nchunks--;
          }
-      }
-      pgmoneta_art_iterator_destroy(it);
-      qsort(sdata, i, sizeof(block_ref_table_serialized_entry), brt_comparator);
-
-      /* Loop over entries in sorted order and serialize each one. */
-      for (i = 0; i < brt->table->size; ++i)
-      {
-         sentry = &sdata[i];
-         block_ref_table_key key = {0};
 
          /* Write the serialized entry itself. */
-         brt_write(file, buffer, sentry, sizeof(block_ref_table_serialized_entry));
-
-         /* Look up the original entry so we can access the chunks. */
-         memcpy(&key.rlocator, &sentry->rlocator, sizeof(struct rel_file_locator));
-         key.forknum = sentry->forknum;
-         brtentry = brt_lookup(brt, key);
+         brt_write(file, buffer, &sentry, sizeof(block_ref_table_serialized_entry));
 
          /* Write the untruncated portion of the chunk length array. */
-         if (sentry->nchunks != 0)
+         if (sentry.nchunks != 0)
          {
-            brt_write(file, buffer, brtentry->chunk_usage, sentry->nchunks * sizeof(uint16_t));
+            brt_write(file, buffer, brtentry->chunk_usage, sentry.nchunks * sizeof(uint16_t));
          }
 
          /* Write the contents of each chunk. */
@@ -360,13 +342,13 @@ pgmoneta_brt_write(block_ref_table* brt, char* file_path)
             brt_write(file, buffer, brtentry->chunk_data[j], brtentry->chunk_usage[j] * sizeof(uint16_t));
          }
       }
+      pgmoneta_art_iterator_destroy(it);
    }
 
    // /* Write out appropriate terminator and flush buffer. */
    brt_file_terminate(file, buffer);
 
    fclose(file);
-   free(sdata);
    free(buffer);
    return 0;
 error:
@@ -374,7 +356,6 @@ error:
    {
       fclose(file);
    }
-   free(sdata);
    free(buffer);
    return 1;
 }
@@ -460,29 +441,24 @@ error:
 }
 
 static void
-generate_art_key_from_brt_key(block_ref_table_key brt_key, char** art_key)
+generate_art_key_from_brt_key(block_ref_table_key brt_key, char* art_key)
 {
-   char* k = NULL;
-   k = pgmoneta_append_int(k, brt_key.rlocator.spcOid);
-   k = pgmoneta_append_char(k, '_');
-   k = pgmoneta_append_int(k, brt_key.rlocator.dbOid);
-   k = pgmoneta_append_char(k, '_');
-   k = pgmoneta_append_int(k, brt_key.rlocator.relNumber);
-   k = pgmoneta_append_char(k, '_');
-   k = pgmoneta_append_int(k, brt_key.forknum);
-
-   *art_key = k;
+   snprintf(art_key, BRT_ART_KEY_LENGTH, "%08x%08x%08x%08x",
+            (uint32_t)brt_key.rlocator.spcOid,
+            (uint32_t)brt_key.rlocator.dbOid,
+            (uint32_t)brt_key.rlocator.relNumber,
+            (uint32_t)brt_key.forknum);
 }
 
 static int
 brt_insert(block_ref_table* brt, block_ref_table_key key, block_ref_table_entry** brt_entry, bool* found)
 {
-   char* art_key = NULL;
+   char art_key[BRT_ART_KEY_LENGTH];
    block_ref_table_entry* e = NULL;
    struct value_config value_config;
    value_config.destroy_data = pgmoneta_brt_entry_destroy;
 
-   generate_art_key_from_brt_key(key, &art_key);
+   generate_art_key_from_brt_key(key, art_key);
 
    if ((e = (block_ref_table_entry*)pgmoneta_art_search(brt->table, art_key)) != NULL)
    {
@@ -506,25 +482,19 @@ brt_insert(block_ref_table* brt, block_ref_table_key key, block_ref_table_entry*
    }
    *brt_entry = e;
 done:
-   free(art_key);
    return 0;
 error:
    free(e);
-   free(art_key);
    return 1;
 }
 
 static block_ref_table_entry*
 brt_lookup(block_ref_table* brt, block_ref_table_key key)
 {
-   char* art_key = NULL;
-   block_ref_table_entry* e = NULL;
-
-   generate_art_key_from_brt_key(key, &art_key);
-   e = (block_ref_table_entry*)pgmoneta_art_search(brt->table, art_key);
+   char art_key[BRT_ART_KEY_LENGTH];
 
-   free(art_key);
-   return e;
+   generate_art_key_from_brt_key(key, art_key);
+   return (block_ref_table_entry*)pgmoneta_art_search(brt->table, art_key);
 }
 
 static void
@@ -892,51 +862,6 @@ pgmoneta_brt_entry_destroy(uintptr_t entry)
  * We make the tablespace OID the first column of the sort key to match
  * the on-disk tree structure.
  */
-static int
-brt_comparator(const void* a, const void* b)
-{
-   const block_ref_table_serialized_entry* sa = a;
-   const block_ref_table_serialized_entry* sb = b;
-
-   if (sa->rlocator.spcOid > sb->rlocator.spcOid)
-   {
-      return 1;
-   }
-   if (sa->rlocator.spcOid < sb->rlocator.spcOid)
-   {
-      return -1;
-   }
-
-   if (sa->rlocator.dbOid > sb->rlocator.dbOid)
-   {
-      return 1;
-   }
-   if (sa->rlocator.dbOid < sb->rlocator.dbOid)
-   {
-      return -1;
-   }
-
-   if (sa->rlocator.relNumber > sb->rlocator.relNumber)
-   {
-      return 1;
-   }
-   if (sa->rlocator.relNumber < sb->rlocator.relNumber)
-   {
-      return -1;
-   }
-
-   if (sa->forknum > sb->forknum)
-   {
-      return 1;
-   }
-   if (sa->forknum < sb->forknum)
-   {
-      return -1;
-   }
-
-   return 0;
-}
-
 static void
 brt_flush(FILE* f, block_ref_table_buffer* buffer)
 {
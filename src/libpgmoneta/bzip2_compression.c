@@ -29,6 +29,7 @@
 /* pgmoneta */
 #include <pgmoneta.h>
 #include <bzip2_compression.h>
+#include <instrument.h>
 #include <logging.h>
 #include <management.h>
 #include <utils.h>
@@ -179,6 +180,7 @@ do_bzip2_compress(struct worker_common* wc)
       else
       {
          pgmoneta_delete_file(wi->from, NULL);
+         pgmoneta_instrument_files(1);
       }
    }
 
@@ -513,6 +515,7 @@ do_bzip2_decompress(struct worker_common* wc)
       else
       {
          pgmoneta_delete_file(wi->from, NULL);
+         pgmoneta_instrument_files(1);
       }
    }
 
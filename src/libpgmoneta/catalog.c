@@ -0,0 +1,810 @@
+/*
+ * Copyright (C) 2025 The pgmoneta community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* pgmoneta */
+#include <pgmoneta.h>
+#include <catalog.h>
+#include <info.h>
+#include <logging.h>
+#include <shmem.h>
+#include <utils.h>
+
+/* system */
+#include <errno.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+static struct catalog_server* get_catalog_server(int server);
+static void catalog_lock(struct catalog_server* cs);
+static void catalog_unlock(struct catalog_server* cs);
+static int catalog_ensure(int server, struct catalog_server* cs);
+static int catalog_load(int server, struct catalog_server* cs);
+static int catalog_build(int server, struct catalog_entry* entries, int* number_of_entries, struct timespec* mtime);
+static int directory_mtime(int server, struct timespec* mtime);
+static int find_entry(struct catalog_server* cs, char* label);
+static void fill_entry(int server, struct catalog_entry* entry, char* label, struct backup* backup);
+static void link_entries(struct catalog_server* cs);
+static int entry_compare(const void* a, const void* b);
+
+int
+pgmoneta_catalog_init(size_t* size, void** shmem_catalog)
+{
+   struct catalog* c = NULL;
+   size_t s = 0;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   *size = 0;
+   *shmem_catalog = NULL;
+
+   s = sizeof(struct catalog) + config->common.number_of_servers * sizeof(struct catalog_server);
+
+   if (pgmoneta_create_shared_memory(s, config->hugepage, (void**)&c))
+   {
+      goto error;
+   }
+
+   memset(c, 0, s);
+   c->number_of_servers = config->common.number_of_servers;
+
+   for (int i = 0; i < c->number_of_servers; i++)
+   {
+      atomic_init(&c->servers[i].lock, 0);
+      snprintf(&c->servers[i].name[0], sizeof(c->servers[i].name), "%s", config->common.servers[i].name);
+      c->servers[i].loaded = false;
+      c->servers[i].generation = 0;
+      c->servers[i].number_of_entries = 0;
+   }
+
+   *size = s;
+   *shmem_catalog = c;
+
+   return 0;
+
+error:
+
+   pgmoneta_log_error("Cannot allocate shared memory for the backup catalog");
+
+   return 1;
+}
+
+int
+pgmoneta_catalog_load(int server)
+{
+   struct catalog_server* cs = NULL;
+
+   cs = get_catalog_server(server);
+   if (cs == NULL)
+   {
+      return 1;
+   }
+
+   return catalog_load(server, cs);
+}
+
+int
+pgmoneta_catalog_update(char* directory, struct backup* backup)
+{
+   int server = -1;
+   int index = -1;
+   struct catalog_server* cs = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   if (backup == NULL)
+   {
+      return 1;
+   }
+
+   server = pgmoneta_catalog_server(directory);
+   cs = get_catalog_server(server);
+   if (cs == NULL)
+   {
+      return 1;
+   }
+
+   catalog_lock(cs);
+
+   /* The backup.info is written to the directory named by the label */
+   if (cs->loaded)
+   {
+      index = find_entry(cs, backup->label);
+
+      if (index != -1)
+      {
+         fill_entry(server, &cs->entries[index], backup->label, backup);
+      }
+      else if (cs->number_of_entries < CATALOG_MAX_BACKUPS)
+      {
+         fill_entry(server, &cs->entries[cs->number_of_entries], backup->label, backup);
+         cs->number_of_entries++;
+         qsort(&cs->entries[0], cs->number_of_entries, sizeof(struct catalog_entry), entry_compare);
+      }
+      else
+      {
+         pgmoneta_log_debug("Catalog: Too many backups for %s", config->common.servers[server].name);
+         cs->loaded = false;
+      }
+
+      link_entries(cs);
+   }
+
+   cs->generation++;
+
+   catalog_unlock(cs);
+
+   return 0;
+}
+
+int
+pgmoneta_catalog_remove(int server, char* label)
+{
+   int index = -1;
+   struct catalog_server* cs = NULL;
+
+   cs = get_catalog_server(server);
+   if (cs == NULL || label == NULL)
+   {
+      return 1;
+   }
+
+   catalog_lock(cs);
+
+   if (cs->loaded)
+   {
+      index = find_entry(cs, label);
+
+      if (index != -1)
+      {
+         memmove(&cs->entries[index], &cs->entries[index + 1],
+                 (cs->number_of_entries - index - 1) * sizeof(struct catalog_entry));
+         cs->number_of_entries--;
+         link_entries(cs);
+      }
+   }
+
+   cs->generation++;
+
+   catalog_unlock(cs);
+
+   return 0;
+}
+
+int
+pgmoneta_catalog_server(char* directory)
+{
+   int server = -1;
+   char* d = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   if (directory == NULL || catalog_shmem == NULL)
+   {
+      return -1;
+   }
+
+   for (int i = 0; server == -1 && i < config->common.number_of_servers; i++)
+   {
+      d = pgmoneta_get_server_backup(i);
+
+      if (d != NULL && (!strcmp(d, directory) ||
+                        (strlen(directory) == strlen(d) - 1 && !strncmp(d, directory, strlen(directory)))))
+      {
+         server = i;
+      }
+
+      free(d);
+      d = NULL;
+   }
+
+   return server;
+}
+
+int
+pgmoneta_catalog_labels(int server, int* number_of_labels, char*** labels)
+{
+   int n = 0;
+   char** l = NULL;
+   struct catalog_server* cs = NULL;
+
+   *number_of_labels = 0;
+   *labels = NULL;
+
+   cs = get_catalog_server(server);
+   if (cs == NULL)
+   {
+      return 1;
+   }
+
+   if (catalog_ensure(server, cs))
+   {
+      return 1;
+   }
+
+   catalog_lock(cs);
+
+   if (!cs->loaded)
+   {
+      goto error;
+   }
+
+   n = cs->number_of_entries;
+
+   if (n > 0)
+   {
+      l = (char**)malloc(n * sizeof(char*));
+      if (l == NULL)
+      {
+         goto error;
+      }
+
+      for (int i = 0; i < n; i++)
+      {
+         l[i] = NULL;
+         l[i] = pgmoneta_append(l[i], cs->entries[i].label);
+      }
+   }
+
+   catalog_unlock(cs);
+
+   *number_of_labels = n;
+   *labels = l;
+
+   return 0;
+
+error:
+
+   catalog_unlock(cs);
+
+   return 1;
+}
+
+int
+pgmoneta_catalog_number_of_valid_backups(int server, int* number)
+{
+   int n = 0;
+   struct catalog_server* cs = NULL;
+
+   *number = 0;
+
+   cs = get_catalog_server(server);
+   if (cs == NULL)
+   {
+      return 1;
+   }
+
+   if (catalog_ensure(server, cs))
+   {
+      return 1;
+   }
+
+   catalog_lock(cs);
+
+   if (!cs->loaded)
+   {
+      goto error;
+   }
+
+   for (int i = 0; i < cs->number_of_entries; i++)
+   {
+      if (cs->entries[i].valid == VALID_TRUE && cs->entries[i].sha512)
+      {
+         n++;
+      }
+   }
+
+   catalog_unlock(cs);
+
+   *number = n;
+
+   return 0;
+
+error:
+
+   catalog_unlock(cs);
+
+   return 1;
+}
+
+int
+pgmoneta_catalog_child(int server, char* label, char** child)
+{
+   int index = -1;
+   char* c = NULL;
+   struct catalog_server* cs = NULL;
+
+   *child = NULL;
+
+   cs = get_catalog_server(server);
+   if (cs == NULL || label == NULL)
+   {
+      return 1;
+   }
+
+   if (catalog_ensure(server, cs))
+   {
+      return 1;
+   }
+
+   catalog_lock(cs);
+
+   if (!cs->loaded)
+   {
+      goto error;
+   }
+
+   index = find_entry(cs, label);
+
+   if (index != -1 && cs->entries[index].child != -1)
+   {
+      c = pgmoneta_append(c, cs->entries[cs->entries[index].child].label);
+   }
+
+   catalog_unlock(cs);
+
+   *child = c;
+
+   return 0;
+
+error:
+
+   catalog_unlock(cs);
+
+   return 1;
+}
+
+int
+pgmoneta_catalog_root(int server, char* label, char** root)
+{
+   int index = -1;
+   int steps = 0;
+   char* r = NULL;
+   struct catalog_server* cs = NULL;
+
+   *root = NULL;
+
+   cs = get_catalog_server(server);
+   if (cs == NULL || label == NULL)
+   {
+      return 1;
+   }
+
+   if (catalog_ensure(server, cs))
+   {
+      return 1;
+   }
+
+   catalog_lock(cs);
+
+   if (!cs->loaded)
+   {
+      goto error;
+   }
+
+   index = find_entry(cs, label);
+
+   while (index != -1 && cs->entries[index].type != TYPE_FULL && steps < cs->number_of_entries)
+   {
+      index = cs->entries[index].parent;
+      steps++;
+   }
+
+   if (index != -1 && cs->entries[index].type == TYPE_FULL && strcmp(cs->entries[index].label, label))
+   {
+      r = pgmoneta_append(r, cs->entries[index].label);
+   }
+
+   catalog_unlock(cs);
+
+   *root = r;
+
+   return 0;
+
+error:
+
+   catalog_unlock(cs);
+
+   return 1;
+}
+
+static struct catalog_server*
+get_catalog_server(int server)
+{
+   struct catalog* c = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+   c = (struct catalog*)catalog_shmem;
+
+   if (c == NULL || server < 0 || server >= config->common.number_of_servers)
+   {
+      return NULL;
+   }
+
+   /* The slots are keyed by the server name, so a server that moved never gets the catalog of another */
+   if (server < c->number_of_servers && !strcmp(c->servers[server].name, config->common.servers[server].name))
+   {
+      return &c->servers[server];
+   }
+
+   for (int i = 0; i < c->number_of_servers; i++)
+   {
+      if (!strcmp(c->servers[i].name, config->common.servers[server].name))
+      {
+         return &c->servers[i];
+      }
+   }
+
+   return NULL;
+}
+
+static void
+catalog_lock(struct catalog_server* cs)
+{
+   int owner;
+
+retry:
+   owner = 0;
+   if (!atomic_compare_exchange_strong(&cs->lock, &owner, (int)getpid()))
+   {
+      /* The owner is a process id, so the lock of a process that died is taken over */
+      if (owner != (int)getpid() && kill((pid_t)owner, 0) == -1 && errno == ESRCH &&
+          atomic_compare_exchange_strong(&cs->lock, &owner, (int)getpid()))
+      {
+         errno = 0;
+         pgmoneta_log_debug("Catalog: Taking over the lock of %s from %d", cs->name, owner);
+
+         /* The entries may be half written */
+         cs->loaded = false;
+         cs->number_of_entries = 0;
+         cs->generation++;
+         return;
+      }
+
+      errno = 0;
+
+      /* Sleep for 1ms */
+      SLEEP_AND_GOTO(1000000L, retry);
+   }
+}
+
+static void
+catalog_unlock(struct catalog_server* cs)
+{
+   atomic_store(&cs->lock, 0);
+}
+
+static int
+catalog_ensure(int server, struct catalog_server* cs)
+{
+   bool current = false;
+   struct timespec mtime;
+
+   if (directory_mtime(server, &mtime))
+   {
+      catalog_lock(cs);
+      cs->loaded = false;
+      catalog_unlock(cs);
+      return 1;
+   }
+
+   catalog_lock(cs);
+   current = cs->loaded &&
+             cs->mtime.tv_sec == mtime.tv_sec &&
+             cs->mtime.tv_nsec == mtime.tv_nsec;
+   catalog_unlock(cs);
+
+   if (current)
+   {
+      return 0;
+   }
+
+   return catalog_load(server, cs);
+}
+
+/**
+ * Load the catalog of a server.
+ *
+ * The entries are built without the lock, which is only held
+ * to swap them in. A build that raced with an update or a
+ * removal is thrown away and done again.
+ *
+ * @param server The server
+ * @param cs The catalog of the server
+ * @return 0 upon success, otherwise 1
+ */
+static int
+catalog_load(int server, struct catalog_server* cs)
+{
+   int number_of_entries = 0;
+   unsigned long generation;
+   struct timespec mtime;
+   struct catalog_entry* entries = NULL;
+
+   entries = (struct catalog_entry*)aligned_alloc(64, CATALOG_MAX_BACKUPS * sizeof(struct catalog_entry));
+   if (entries == NULL)
+   {
+      goto error;
+   }
+
+   for (int attempt = 0; attempt < 3; attempt++)
+   {
+      catalog_lock(cs);
+      generation = cs->generation;
+      catalog_unlock(cs);
+
+      if (catalog_build(server, entries, &number_of_entries, &mtime))
+      {
+         goto error;
+      }
+
+      catalog_lock(cs);
+
+      if (cs->generation == generation)
+      {
+         memcpy(&cs->entries[0], entries, number_of_entries * sizeof(struct catalog_entry));
+         cs->number_of_entries = number_of_entries;
+         link_entries(cs);
+
+         cs->mtime = mtime;
+         cs->loaded = true;
+         cs->generation++;
+
+         catalog_unlock(cs);
+
+         free(entries);
+
+         return 0;
+      }
+
+      catalog_unlock(cs);
+   }
+
+   pgmoneta_log_debug("Catalog: Too many concurrent changes for %s", cs->name);
+
+error:
+
+   catalog_lock(cs);
+   cs->loaded = false;
+   cs->number_of_entries = 0;
+   cs->generation++;
+   catalog_unlock(cs);
+
+   free(entries);
+
+   return 1;
+}
+
+static int
+catalog_build(int server, struct catalog_entry* entries, int* number_of_entries, struct timespec* mtime)
+{
+   char* d = NULL;
+   char* info = NULL;
+   int n = 0;
+   int number_of_dirs = 0;
+   char** dirs = NULL;
+   struct backup* backup = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   *number_of_entries = 0;
+
+   if (directory_mtime(server, mtime))
+   {
+      goto error;
+   }
+
+   d = pgmoneta_get_server_backup(server);
+
+   if (pgmoneta_get_directories(d, &number_of_dirs, &dirs))
+   {
+      goto error;
+   }
+
+   if (number_of_dirs > CATALOG_MAX_BACKUPS)
+   {
+      pgmoneta_log_debug("Catalog: Too many backups for %s (%d)", config->common.servers[server].name, number_of_dirs);
+      goto error;
+   }
+
+   for (int i = 0; i < number_of_dirs; i++)
+   {
+      info = pgmoneta_append(info, d);
+      info = pgmoneta_append(info, dirs[i]);
+      info = pgmoneta_append(info, "/backup.info");
+
+      /* A backup that is still being written is added by pgmoneta_save_info */
+      if (!pgmoneta_exists(info))
+      {
+         pgmoneta_log_trace("Catalog: No backup.info in %s%s", d, dirs[i]);
+      }
+      else if (pgmoneta_load_info(d, dirs[i], &backup))
+      {
+         pgmoneta_log_debug("Catalog: Unable to load %s", info);
+      }
+      else
+      {
+         fill_entry(server, &entries[n], dirs[i], backup);
+         n++;
+      }
+
+      free(backup);
+      backup = NULL;
+      free(info);
+      info = NULL;
+   }
+
+   qsort(entries, n, sizeof(struct catalog_entry), entry_compare);
+
+   *number_of_entries = n;
+
+   for (int i = 0; i < number_of_dirs; i++)
+   {
+      free(dirs[i]);
+   }
+   free(dirs);
+   free(d);
+
+   return 0;
+
+error:
+
+   for (int i = 0; i < number_of_dirs; i++)
+   {
+      free(dirs[i]);
+   }
+   free(dirs);
+   free(backup);
+   free(info);
+   free(d);
+
+   return 1;
+}
+
+static int
+directory_mtime(int server, struct timespec* mtime)
+{
+   char* d = NULL;
+   struct stat st;
+
+   memset(mtime, 0, sizeof(struct timespec));
+
+   d = pgmoneta_get_server_backup(server);
+   if (d == NULL || stat(d, &st))
+   {
+      free(d);
+      return 1;
+   }
+
+   *mtime = st.st_mtim;
+
+   free(d);
+
+   return 0;
+}
+
+static int
+find_entry(struct catalog_server* cs, char* label)
+{
+   int low = 0;
+   int high = cs->number_of_entries - 1;
+
+   while (low <= high)
+   {
+      int mid = low + (high - low) / 2;
+      int cmp = strcmp(cs->entries[mid].label, label);
+
+      if (cmp == 0)
+      {
+         return mid;
+      }
+      else if (cmp < 0)
+      {
+         low = mid + 1;
+      }
+      else
+      {
+         high = mid - 1;
+      }
+   }
+
+   return -1;
+}
+
+static void
+fill_entry(int server, struct catalog_entry* entry, char* label, struct backup* backup)
+{
+   char* sha = NULL;
+
+   memset(entry, 0, sizeof(struct catalog_entry));
+
+   snprintf(&entry->label[0], sizeof(entry->label), "%s", label);
+   snprintf(&entry->parent_label[0], sizeof(entry->parent_label), "%s", backup->parent_label);
+   entry->type = backup->type;
+   entry->valid = backup->valid;
+   entry->keep = backup->keep;
+   entry->backup_size = backup->backup_size;
+   entry->restore_size = backup->restore_size;
+   entry->parent = -1;
+   entry->child = -1;
+
+   sha = pgmoneta_get_server_backup_identifier(server, label);
+   if (!pgmoneta_ends_with(sha, "/"))
+   {
+      sha = pgmoneta_append_char(sha, '/');
+   }
+   sha = pgmoneta_append(sha, "backup.sha512");
+
+   entry->sha512 = pgmoneta_exists(sha);
+
+   free(sha);
+}
+
+static void
+link_entries(struct catalog_server* cs)
+{
+   for (int i = 0; i < cs->number_of_entries; i++)
+   {
+      cs->entries[i].parent = -1;
+      cs->entries[i].child = -1;
+   }
+
+   for (int i = 0; i < cs->number_of_entries; i++)
+   {
+      struct catalog_entry* e = &cs->entries[i];
+
+      if (e->type != TYPE_FULL && strlen(e->parent_label) > 0)
+      {
+         e->parent = find_entry(cs, e->parent_label);
+
+         if (e->parent != -1 && cs->entries[e->parent].child == -1)
+         {
+            cs->entries[e->parent].child = i;
+         }
+      }
+   }
+}
+
+static int
+entry_compare(const void* a, const void* b)
+{
+   const struct catalog_entry* ea = (const struct catalog_entry*)a;
+   const struct catalog_entry* eb = (const struct catalog_entry*)b;
+
+   return strcmp(ea->label, eb->label);
+}
@@ -74,3 +74,18 @@ pgmoneta_decompress(char* from, char* to)
 error:
    return 1;
 }
+
+int
+pgmoneta_get_compression_workers(int server)
+{
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   if (config->common.servers[server].compression_workers != -1)
+   {
+      return config->common.servers[server].compression_workers;
+   }
+
+   return config->compression_workers;
+}
@@ -72,6 +72,7 @@ static int as_compression(char* str);
 static int as_storage_engine(char* str);
 static char* as_ciphers(char* str);
 static int as_encryption_mode(char* str);
+static int as_manifest_checksum(char* str);
 static unsigned int as_update_process_title(char* str, unsigned int default_policy);
 static int as_logging_rotation_size(char* str, int* size);
 static int as_seconds(char* str, int* age, int default_age);
@@ -114,8 +115,11 @@ pgmoneta_init_main_configuration(void* shm)
 
    config->compression_type = COMPRESSION_CLIENT_ZSTD;
    config->compression_level = 3;
+   config->compression_passthrough = false;
+   config->compression_workers = 4;
 
    config->encryption = ENCRYPTION_NONE;
+   config->manifest_checksum = MANIFEST_CHECKSUM_SHA512;
 
    config->storage_engine = STORAGE_ENGINE_LOCAL;
 
@@ -126,6 +130,9 @@ pgmoneta_init_main_configuration(void* shm)
    config->retention_months = -1;
    config->retention_years = -1;
    config->retention_interval = 300;
+   config->disk_usage_interval = 3600;
+   atomic_init(&config->used_space, 0);
+   atomic_init(&config->used_space_valid, false);
 
    config->tls = false;
 
@@ -150,8 +157,16 @@ pgmoneta_init_main_configuration(void* shm)
 
    config->backup_max_rate = 0;
    config->network_max_rate = 0;
+   config->backup_connections = 1;
+   config->transfer_chunk_size = 1024 * 1024;
 
    config->verification = 0;
+   config->verification_max_rate = 0;
+   config->verification_backups = 0;
+   config->delete_max_rate = 0;
+   config->wal_fetch = false;
+   config->wal_prefetch = 4;
+   config->wal_verification = 0;
 
 #ifdef DEBUG
    config->link = true;
@@ -247,10 +262,27 @@ pgmoneta_read_main_configuration(void* shm, char* filename)
                   srv.cur_timeline = 1;
                   atomic_init(&srv.operation_count, 0);
                   atomic_init(&srv.failed_operation_count, 0);
+                  atomic_init(&srv.verification_files, 0);
+                  atomic_init(&srv.verification_failed_files, 0);
+                  atomic_init(&srv.verification_bytes, 0);
+                  atomic_init(&srv.verification_throughput, 0);
+                  atomic_init(&srv.last_verification_time, 0);
+                  atomic_init(&srv.trash_pid, 0);
+                  atomic_init(&srv.trash_reclaimed_files, 0);
+                  atomic_init(&srv.trash_reclaimed_bytes, 0);
+                  for (int j = 0; j < NUMBER_OF_DISK_USAGES; j++)
+                  {
+                     atomic_init(&srv.disk_usage[j], 0);
+                  }
+                  atomic_init(&srv.disk_usage_valid, false);
+                  atomic_init(&srv.wal_archive_active, false);
+                  atomic_init(&srv.wal_archive_lsn, 0);
+                  atomic_init(&srv.wal_archive_pending_time, 0);
                   atomic_init(&srv.last_operation_time, 0);
                   atomic_init(&srv.last_failed_operation_time, 0);
                   memset(srv.wal_shipping, 0, MAX_PATH);
                   srv.workers = -1;
+                  srv.compression_workers = -1;
                   srv.backup_max_rate = -1;
                   srv.network_max_rate = -1;
 
@@ -1086,6 +1118,41 @@ pgmoneta_read_main_configuration(void* shm, char* filename)
                      unknown = true;
                   }
                }
+               else if (!strcmp(key, "compression_passthrough"))
+               {
+                  if (!strcmp(section, "pgmoneta"))
+                  {
+                     if (as_bool(value, &config->compression_passthrough))
+                     {
+                        unknown = true;
+                     }
+                  }
+                  else
+                  {
+                     unknown = true;
+                  }
+               }
+               else if (!strcmp(key, "compression_workers"))
+               {
+                  if (!strcmp(section, "pgmoneta"))
+                  {
+                     if (as_int(value, &config->compression_workers))
+                     {
+                        unknown = true;
+                     }
+                  }
+                  if (strlen(section) > 0)
+                  {
+                     if (as_int(value, &srv.compression_workers))
+                     {
+                        unknown = true;
+                     }
+                  }
+                  else
+                  {
+                     unknown = true;
+                  }
+               }
                else if (!strcmp(key, "storage_engine"))
                {
                   if (!strcmp(section, "pgmoneta"))
@@ -1245,6 +1312,22 @@ pgmoneta_read_main_configuration(void* shm, char* filename)
                      unknown = true;
                   }
                }
+               else if (!strcmp(key, "s3_endpoint"))
+               {
+                  if (!strcmp(section, "pgmoneta"))
+                  {
+                     max = strlen(value);
+                     if (max > MISC_LENGTH - 1)
+                     {
+                        max = MISC_LENGTH - 1;
+                     }
+                     memcpy(config->s3_endpoint, value, max);
+                  }
+                  else
+                  {
+                     unknown = true;
+                  }
+               }
                else if (!strcmp(key, "azure_storage_account"))
                {
                   if (!strcmp(section, "pgmoneta"))
@@ -1309,6 +1392,22 @@ pgmoneta_read_main_configuration(void* shm, char* filename)
                      unknown = true;
                   }
                }
+               else if (!strcmp(key, "azure_endpoint"))
+               {
+                  if (!strcmp(section, "pgmoneta"))
+                  {
+                     max = strlen(value);
+                     if (max > MISC_LENGTH - 1)
+                     {
+                        max = MISC_LENGTH - 1;
+                     }
+                     memcpy(config->azure_endpoint, value, max);
+                  }
+                  else
+                  {
+                     unknown = true;
+                  }
+               }
                else if (!strcmp(key, "workspace"))
                {
                   if (!strcmp(section, "pgmoneta"))
@@ -1390,6 +1489,48 @@ pgmoneta_read_main_configuration(void* shm, char* filename)
                      unknown = true;
                   }
                }
+               else if (!strcmp(key, "backup_connections"))
+               {
+                  if (!strcmp(section, "pgmoneta"))
+                  {
+                     if (as_int(value, &config->backup_connections))
+                     {
+                        unknown = true;
+                     }
+                  }
+                  else
+                  {
+                     unknown = true;
+                  }
+               }
+               else if (!strcmp(key, "transfer_chunk_size"))
+               {
+                  if (!strcmp(section, "pgmoneta"))
+                  {
+                     if (as_bytes(value, &config->transfer_chunk_size, 1024 * 1024))
+                     {
+                        unknown = true;
+                     }
+                  }
+                  else
+                  {
+                     unknown = true;
+                  }
+               }
+               else if (!strcmp(key, "disk_usage_interval"))
+               {
+                  if (!strcmp(section, "pgmoneta"))
+                  {
+                     if (as_int(value, &config->disk_usage_interval))
+                     {
+                        unknown = true;
+                     }
+                  }
+                  else
+                  {
+                     unknown = true;
+                  }
+               }
                else if (!strcmp(key, "encryption"))
                {
                   if (!strcmp(section, "pgmoneta"))
@@ -1401,6 +1542,17 @@ pgmoneta_read_main_configuration(void* shm, char* filename)
                      unknown = true;
                   }
                }
+               else if (!strcmp(key, "manifest_checksum"))
+               {
+                  if (!strcmp(section, "pgmoneta"))
+                  {
+                     config->manifest_checksum = as_manifest_checksum(value);
+                  }
+                  else
+                  {
+                     unknown = true;
+                  }
+               }
                else if (!strcmp(key, "backup_max_rate"))
                {
                   if (!strcmp(section, "pgmoneta"))
@@ -1469,6 +1621,90 @@ pgmoneta_read_main_configuration(void* shm, char* filename)
                      unknown = true;
                   }
                }
+               else if (!strcmp(key, "verification_max_rate"))
+               {
+                  if (!strcmp(section, "pgmoneta"))
+                  {
+                     if (as_int(value, &config->verification_max_rate))
+                     {
+                        unknown = true;
+                     }
+                  }
+                  else
+                  {
+                     unknown = true;
+                  }
+               }
+               else if (!strcmp(key, "delete_max_rate"))
+               {
+                  if (!strcmp(section, "pgmoneta"))
+                  {
+                     if (as_int(value, &config->delete_max_rate))
+                     {
+                        unknown = true;
+                     }
+                  }
+                  else
+                  {
+                     unknown = true;
+                  }
+               }
+               else if (!strcmp(key, "wal_fetch"))
+               {
+                  if (!strcmp(section, "pgmoneta"))
+                  {
+                     if (as_bool(value, &config->wal_fetch))
+                     {
+                        unknown = true;
+                     }
+                  }
+                  else
+                  {
+                     unknown = true;
+                  }
+               }
+               else if (!strcmp(key, "wal_prefetch"))
+               {
+                  if (!strcmp(section, "pgmoneta"))
+                  {
+                     if (as_int(value, &config->wal_prefetch))
+                     {
+                        unknown = true;
+                     }
+                  }
+                  else
+                  {
+                     unknown = true;
+                  }
+               }
+               else if (!strcmp(key, "verification_backups"))
+               {
+                  if (!strcmp(section, "pgmoneta"))
+                  {
+                     if (as_int(value, &config->verification_backups))
+                     {
+                        unknown = true;
+                     }
+                  }
+                  else
+                  {
+                     unknown = true;
+                  }
+               }
+               else if (!strcmp(key, "wal_verification"))
+               {
+                  if (!strcmp(section, "pgmoneta"))
+                  {
+                     if (as_seconds(value, &config->wal_verification, 0))
+                     {
+                        unknown = true;
+                     }
+                  }
+                  else
+                  {
+                     unknown = true;
+                  }
+               }
 #ifdef DEBUG
                else if (!strcmp(key, "link"))
                {
@@ -1648,6 +1884,24 @@ pgmoneta_validate_main_configuration(void* shm)
       return 1;
    }
 
+   if (config->disk_usage_interval < 1)
+   {
+      pgmoneta_log_fatal("disk usage interval should be at least 1");
+      return 1;
+   }
+
+   if (config->backup_connections < 1)
+   {
+      pgmoneta_log_fatal("backup connections should be at least 1");
+      return 1;
+   }
+
+   if (config->transfer_chunk_size < 8192)
+   {
+      pgmoneta_log_fatal("transfer chunk size should be at least 8192");
+      return 1;
+   }
+
    if (config->backlog < 16)
    {
       config->backlog = 16;
@@ -1709,6 +1963,11 @@ pgmoneta_validate_main_configuration(void* shm)
       config->workers = 0;
    }
 
+   if (config->compression_workers < 0)
+   {
+      config->compression_workers = 0;
+   }
+
    if (strlen(config->metrics_cert_file) > 0)
    {
       if (!pgmoneta_exists(config->metrics_cert_file))
@@ -1803,6 +2062,11 @@ pgmoneta_validate_main_configuration(void* shm)
          config->common.servers[i].workers = -1;
       }
 
+      if (config->common.servers[i].compression_workers < -1)
+      {
+         config->common.servers[i].compression_workers = -1;
+      }
+
       if (config->common.servers[i].backup_max_rate < -1)
       {
          config->common.servers[i].backup_max_rate = -1;
@@ -1819,6 +2083,36 @@ pgmoneta_validate_main_configuration(void* shm)
       pgmoneta_log_fatal("verification cannot be less than 0");
       return 1;
    }
+
+   if (config->verification_max_rate < 0)
+   {
+      pgmoneta_log_fatal("verification_max_rate cannot be less than 0");
+      return 1;
+   }
+
+   if (config->verification_backups < 0)
+   {
+      pgmoneta_log_fatal("verification_backups cannot be less than 0");
+      return 1;
+   }
+
+   if (config->wal_verification < 0)
+   {
+      pgmoneta_log_fatal("wal_verification cannot be less than 0");
+      return 1;
+   }
+
+   if (config->delete_max_rate < 0)
+   {
+      pgmoneta_log_fatal("delete_max_rate cannot be less than 0");
+      return 1;
+   }
+
+   if (config->wal_prefetch < 0)
+   {
+      pgmoneta_log_fatal("wal_prefetch cannot be less than 0");
+      return 1;
+   }
    return 0;
 }
 
@@ -2857,10 +3151,12 @@ add_configuration_response(struct json* res)
    pgmoneta_json_put(res, CONFIGURATION_ARGUMENT_S3_SECRET_ACCESS_KEY, (uintptr_t)config->s3_secret_access_key, ValueString);
    pgmoneta_json_put(res, CONFIGURATION_ARGUMENT_S3_BUCKET, (uintptr_t)config->s3_bucket, ValueString);
    pgmoneta_json_put(res, CONFIGURATION_ARGUMENT_S3_BASE_DIR, (uintptr_t)config->s3_base_dir, ValueString);
+   pgmoneta_json_put(res, CONFIGURATION_ARGUMENT_S3_ENDPOINT, (uintptr_t)config->s3_endpoint, ValueString);
    pgmoneta_json_put(res, CONFIGURATION_ARGUMENT_AZURE_BASE_DIR, (uintptr_t)config->azure_base_dir, ValueString);
    pgmoneta_json_put(res, CONFIGURATION_ARGUMENT_AZURE_STORAGE_ACCOUNT, (uintptr_t)config->azure_storage_account, ValueString);
    pgmoneta_json_put(res, CONFIGURATION_ARGUMENT_AZURE_CONTAINER, (uintptr_t)config->azure_container, ValueString);
    pgmoneta_json_put(res, CONFIGURATION_ARGUMENT_AZURE_SHARED_KEY, (uintptr_t)config->azure_shared_key, ValueString);
+   pgmoneta_json_put(res, CONFIGURATION_ARGUMENT_AZURE_ENDPOINT, (uintptr_t)config->azure_endpoint, ValueString);
    pgmoneta_json_put(res, CONFIGURATION_ARGUMENT_WORKSPACE, (uintptr_t)config->workspace, ValueString);
    pgmoneta_json_put(res, CONFIGURATION_ARGUMENT_RETENTION, (uintptr_t)ret, ValueString);
    pgmoneta_json_put(res, CONFIGURATION_ARGUMENT_LOG_TYPE, (uintptr_t)config->common.log_type, ValueInt32);
@@ -2893,6 +3189,8 @@ add_configuration_response(struct json* res)
    pgmoneta_json_put(res, CONFIGURATION_ARGUMENT_USER_CONF_PATH, (uintptr_t)config->common.users_path, ValueString);
    pgmoneta_json_put(res, CONFIGURATION_ARGUMENT_ADMIN_CONF_PATH, (uintptr_t)config->common.admins_path, ValueString);
    pgmoneta_json_put(res, CONFIGURATION_ARGUMENT_VERIFICATION, (uintptr_t)config->verification, ValueInt64);
+   pgmoneta_json_put(res, CONFIGURATION_ARGUMENT_VERIFICATION_MAX_RATE, (uintptr_t)config->verification_max_rate, ValueInt64);
+   pgmoneta_json_put(res, CONFIGURATION_ARGUMENT_VERIFICATION_BACKUPS, (uintptr_t)config->verification_backups, ValueInt64);
 
    free(ret);
 }
@@ -3674,6 +3972,20 @@ apply_main_configuration(struct main_configuration* config, struct server* srv,
             unknown = true;
          }
       }
+      else if (!strcmp(key, "verification_max_rate"))
+      {
+         if (as_int(value, &config->verification_max_rate))
+         {
+            unknown = true;
+         }
+      }
+      else if (!strcmp(key, "verification_backups"))
+      {
+         if (as_int(value, &config->verification_backups))
+         {
+            unknown = true;
+         }
+      }
       else
       {
          unknown = true;
@@ -3764,6 +4076,14 @@ write_config_value(char* buffer, char* config_key, size_t buffer_size)
          {
             snprintf(buffer, buffer_size, "%d", config->verification);
          }
+         else if (!strcmp(key_info.key, "verification_max_rate"))
+         {
+            snprintf(buffer, buffer_size, "%d", config->verification_max_rate);
+         }
+         else if (!strcmp(key_info.key, "verification_backups"))
+         {
+            snprintf(buffer, buffer_size, "%d", config->verification_backups);
+         }
          else if (!strcmp(key_info.key, "retention"))
          {
             char* ret = get_retention_string(config->retention_days, config->retention_weeks, config->retention_months, config->retention_years);
@@ -4941,6 +5261,39 @@ as_encryption_mode(char* str)
    return ENCRYPTION_NONE;
 }
 
+static int
+as_manifest_checksum(char* str)
+{
+   if (!strcasecmp(str, "crc32c"))
+   {
+      return MANIFEST_CHECKSUM_CRC32C;
+   }
+
+   if (!strcasecmp(str, "sha224"))
+   {
+      return MANIFEST_CHECKSUM_SHA224;
+   }
+
+   if (!strcasecmp(str, "sha256"))
+   {
+      return MANIFEST_CHECKSUM_SHA256;
+   }
+
+   if (!strcasecmp(str, "sha384"))
+   {
+      return MANIFEST_CHECKSUM_SHA384;
+   }
+
+   if (!strcasecmp(str, "sha512"))
+   {
+      return MANIFEST_CHECKSUM_SHA512;
+   }
+
+   warnx("Unknown manifest checksum: %s", str);
+
+   return MANIFEST_CHECKSUM_SHA512;
+}
+
 static int
 as_create_slot(char* str, int* create_slot)
 {
@@ -5032,6 +5385,9 @@ transfer_configuration(struct main_configuration* config, struct main_configurat
    config->create_slot = reload->create_slot;
    config->compression_type = reload->compression_type;
    config->compression_level = reload->compression_level;
+   config->compression_passthrough = reload->compression_passthrough;
+   config->compression_workers = reload->compression_workers;
+   config->manifest_checksum = reload->manifest_checksum;
    if (restart_string("workspace", config->workspace, reload->workspace))
    {
       changed = true;
@@ -5044,6 +5400,11 @@ transfer_configuration(struct main_configuration* config, struct main_configurat
    {
       changed = true;
    }
+   if (restart_int("disk_usage_interval", config->disk_usage_interval, reload->disk_usage_interval))
+   {
+      changed = true;
+   }
+   atomic_store(&config->used_space_valid, false);
    if (restart_int("log_type", config->common.log_type, reload->common.log_type))
    {
       changed = true;
@@ -5055,6 +5416,11 @@ transfer_configuration(struct main_configuration* config, struct main_configurat
       changed = true;
    }
 
+   if (restart_int("wal_verification", config->wal_verification, reload->wal_verification))
+   {
+      changed = true;
+   }
+
    if (strncmp(config->common.log_path, reload->common.log_path, MISC_LENGTH) ||
        config->common.log_rotation_size != reload->common.log_rotation_size ||
        config->common.log_rotation_age != reload->common.log_rotation_age ||
@@ -5100,6 +5466,8 @@ transfer_configuration(struct main_configuration* config, struct main_configurat
    }
 
    config->blocking_timeout = reload->blocking_timeout;
+   config->backup_connections = reload->backup_connections;
+   config->transfer_chunk_size = reload->transfer_chunk_size;
    config->authentication_timeout = reload->authentication_timeout;
 
    if (strcmp("", reload->pidfile))
@@ -5155,6 +5523,11 @@ transfer_configuration(struct main_configuration* config, struct main_configurat
    config->workers = reload->workers;
    config->backup_max_rate = reload->backup_max_rate;
    config->network_max_rate = reload->network_max_rate;
+   config->verification_max_rate = reload->verification_max_rate;
+   config->verification_backups = reload->verification_backups;
+   config->delete_max_rate = reload->delete_max_rate;
+   config->wal_fetch = reload->wal_fetch;
+   config->wal_prefetch = reload->wal_prefetch;
 
    /* prometheus */
    atomic_init(&config->common.prometheus.logging_info, 0);
@@ -5221,6 +5594,7 @@ copy_server(struct server* dst, struct server* src)
    {
       memcpy(&dst->hot_standby_tablespaces[i][0], &src->hot_standby_tablespaces[i][0], MAX_PATH);
    }
+   atomic_store(&dst->disk_usage_valid, false);
    /* dst->cur_timeline = src->cur_timeline; */
    dst->retention_days = src->retention_days;
    dst->retention_weeks = src->retention_weeks;
@@ -5233,6 +5607,7 @@ copy_server(struct server* dst, struct server* src)
    /* memcpy(&dst->current_wal_filename[0], &src->current_wal_filename[0], MISC_LENGTH); */
    /* memcpy(&dst->current_wal_lsn[0], &src->current_wal_lsn[0], MISC_LENGTH); */
    dst->workers = src->workers;
+   dst->compression_workers = src->compression_workers;
    dst->backup_max_rate = src->backup_max_rate;
    dst->network_max_rate = src->network_max_rate;
 
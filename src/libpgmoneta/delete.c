@@ -29,25 +29,64 @@
 /* pgmoneta */
 #include <pgmoneta.h>
 #include <backup.h>
+#include <delete.h>
 #include <logging.h>
 #include <utils.h>
+#include <wal.h>
+#include <walarchive.h>
+#include <workers.h>
 #include <workflow.h>
 
 /* system */
+#include <dirent.h>
+#include <errno.h>
+#include <signal.h>
 #include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define TRASH_BATCH_SIZE 4096
+
+/** @struct trash_purge
+ * Defines the shared state of a trash purge
+ */
+struct trash_purge
+{
+   int server;                  /**< The server */
+   struct token_bucket* bucket; /**< The I/O budget, optional */
+   atomic_ulong files;          /**< The number of files removed */
+   atomic_ullong usage;         /**< The disk usage of the removed files */
+   atomic_ullong reclaimed;     /**< The number of bytes reclaimed */
+};
+
+/** @struct trash_input
+ * Defines the input of a trash unlink task
+ */
+struct trash_input
+{
+   struct worker_common common; /**< The common base */
+   char path[MAX_PATH];         /**< The file */
+   struct trash_purge* purge;   /**< The purge */
+};
 
 /**
  * Delete wal files older than the given srv_wal file under the base directory
  * Base directory could be the wal/ or the wal_shipping directory
+ * @param srv The server
+ * @param kind The disk usage kind of the base directory
  * @param srv_wal The oldest wal segment file we would like to keep
  * @param base The base directory holding the wal segments
  * @param backup_index The index of the oldest backup
  */
 static void
-delete_wal_older_than(char* srv_wal, char* base, int backup_index);
+delete_wal_older_than(int srv, int kind, char* srv_wal, char* base, int backup_index);
+
+static int purge_directory(char* path, struct trash_purge* purge, struct workers* workers, int* queued);
+static void do_unlink(struct worker_common* wc);
 
 int
 pgmoneta_delete(int srv, char* label)
@@ -138,7 +177,7 @@ pgmoneta_delete_wal(int srv)
    if (backup == NULL)
    {
       d = pgmoneta_get_server_wal(srv);
-      delete_wal_older_than(srv_wal, d, backup_index);
+      delete_wal_older_than(srv, DISK_USAGE_WAL, srv_wal, d, backup_index);
       free(d);
       d = NULL;
 
@@ -146,11 +185,13 @@ pgmoneta_delete_wal(int srv)
       wal_shipping = pgmoneta_get_server_wal_shipping_wal(srv);
       if (wal_shipping != NULL)
       {
-         delete_wal_older_than(srv_wal, wal_shipping, backup_index);
+         delete_wal_older_than(srv, DISK_USAGE_WAL_SHIPPING, srv_wal, wal_shipping, backup_index);
       }
 
       free(wal_shipping);
       wal_shipping = NULL;
+
+      pgmoneta_wal_index_prune(srv);
    }
 
    free(backup);
@@ -180,18 +221,27 @@ error:
 }
 
 static void
-delete_wal_older_than(char* srv_wal, char* base, int backup_index)
+delete_wal_older_than(int srv, int kind, char* srv_wal, char* base, int backup_index)
 {
    int number_of_wal_files = 0;
    char** wal_files = NULL;
    char wal_address[MAX_PATH];
+   unsigned long size = 0;
    bool delete;
+   struct art* archived = NULL;
 
    if (pgmoneta_get_wal_files(base, &number_of_wal_files, &wal_files))
    {
       pgmoneta_log_warn("Unable to get WAL segments under %s", base);
       goto error;
    }
+
+   /* Segments that aren't uploaded to the WAL archive yet are kept */
+   if (kind == DISK_USAGE_WAL && pgmoneta_wal_archive_status(srv, &archived))
+   {
+      pgmoneta_log_warn("Unable to read the WAL archive status, keeping the WAL under %s", base);
+      goto error;
+   }
    for (int i = 0; i < number_of_wal_files; i++)
    {
       delete = false;
@@ -208,6 +258,12 @@ delete_wal_older_than(char* srv_wal, char* base, int backup_index)
          }
       }
 
+      if (delete && archived != NULL && !pgmoneta_art_contains_key(archived, wal_files[i]))
+      {
+         pgmoneta_log_debug("WAL: Keeping %s until it is archived", wal_files[i]);
+         continue;
+      }
+
       if (delete)
       {
          memset(wal_address, 0, MAX_PATH);
@@ -223,7 +279,12 @@ delete_wal_older_than(char* srv_wal, char* base, int backup_index)
          pgmoneta_log_trace("WAL: Deleting %s", wal_address);
          if (pgmoneta_exists(wal_address))
          {
+            size = pgmoneta_file_disk_size(wal_address);
             pgmoneta_delete_file(wal_address, NULL);
+            if (!pgmoneta_exists(wal_address))
+            {
+               pgmoneta_disk_usage_add(srv, kind, -(int64_t)size);
+            }
          }
          else
          {
@@ -242,6 +303,8 @@ delete_wal_older_than(char* srv_wal, char* base, int backup_index)
    }
    free(wal_files);
 
+   pgmoneta_art_destroy(archived);
+
    return;
 
 error:
@@ -250,4 +313,404 @@ error:
       free(wal_files[i]);
    }
    free(wal_files);
+
+   pgmoneta_art_destroy(archived);
+}
+
+int
+pgmoneta_move_to_trash(int srv, char* directory)
+{
+   unsigned long size = 0;
+   char* trash = NULL;
+   char* from = NULL;
+   char* name = NULL;
+   char* to = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   from = pgmoneta_append(from, directory);
+   while (strlen(from) > 1 && pgmoneta_ends_with(from, "/"))
+   {
+      from[strlen(from) - 1] = '\0';
+   }
+
+   name = strrchr(from, '/');
+   name = name != NULL ? name + 1 : from;
+
+   trash = pgmoneta_get_server_trash(srv);
+
+   if (pgmoneta_mkdir(trash))
+   {
+      pgmoneta_log_warn("Trash: Could not create %s", trash);
+      goto delete;
+   }
+
+   /* The same label can be deleted again after a new backup, so make the name unique */
+   to = pgmoneta_append(to, trash);
+   to = pgmoneta_append(to, name);
+   to = pgmoneta_append_char(to, '.');
+   to = pgmoneta_append_ulong(to, (unsigned long)time(NULL));
+   to = pgmoneta_append_char(to, '.');
+   to = pgmoneta_append_int(to, (int)getpid());
+
+   if (rename(from, to))
+   {
+      pgmoneta_log_warn("Trash: Could not move %s to %s: %s", from, to, strerror(errno));
+      errno = 0;
+      goto delete;
+   }
+
+   pgmoneta_log_debug("Trash: %s/%s", config->common.servers[srv].name, name);
+
+   free(trash);
+   free(from);
+   free(to);
+
+   return 0;
+
+delete:
+
+   /* Not on the same file system as the trash, so remove it in place */
+   size = pgmoneta_directory_size(from);
+
+   if (pgmoneta_delete_directory(from))
+   {
+      pgmoneta_log_error("Trash: Could not delete %s", from);
+      goto error;
+   }
+
+   pgmoneta_disk_usage_add(srv, DISK_USAGE_BACKUP, -(int64_t)size);
+
+   free(trash);
+   free(from);
+   free(to);
+
+   return 0;
+
+error:
+
+   free(trash);
+   free(from);
+   free(to);
+
+   return 1;
+}
+
+int
+pgmoneta_purge_trash(int srv)
+{
+   bool failed = false;
+   int owner = 0;
+   int queued = 0;
+   int number_of_workers = 0;
+   char* trash = NULL;
+   char* entry_path = NULL;
+   DIR* dir = NULL;
+   struct dirent* entry = NULL;
+   struct timespec start_t;
+   struct timespec end_t;
+   double total_seconds = 0;
+   struct trash_purge purge;
+   struct workers* workers = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   memset(&purge, 0, sizeof(struct trash_purge));
+
+   trash = pgmoneta_get_server_trash(srv);
+
+   if (!pgmoneta_exists(trash))
+   {
+      free(trash);
+      return 0;
+   }
+
+   /* One purge per server at a time, every other caller leaves it to the active one.
+    * The owner is a process id, so the purge of a process that died is taken over */
+   if (!atomic_compare_exchange_strong(&config->common.servers[srv].trash_pid, &owner, (int)getpid()))
+   {
+      if (owner == (int)getpid() || kill((pid_t)owner, 0) == 0 || errno != ESRCH ||
+          !atomic_compare_exchange_strong(&config->common.servers[srv].trash_pid, &owner, (int)getpid()))
+      {
+         errno = 0;
+         free(trash);
+         return 0;
+      }
+
+      errno = 0;
+      pgmoneta_log_debug("Trash: Taking over the purge of %s from %d", config->common.servers[srv].name, owner);
+   }
+
+#ifdef HAVE_FREEBSD
+   clock_gettime(CLOCK_MONOTONIC_FAST, &start_t);
+#else
+   clock_gettime(CLOCK_MONOTONIC_RAW, &start_t);
+#endif
+
+   purge.server = srv;
+   atomic_init(&purge.files, 0);
+   atomic_init(&purge.usage, 0);
+   atomic_init(&purge.reclaimed, 0);
+
+   if (config->delete_max_rate > 0)
+   {
+      purge.bucket = (struct token_bucket*)malloc(sizeof(struct token_bucket));
+      if (purge.bucket == NULL || pgmoneta_token_bucket_init(purge.bucket, config->delete_max_rate))
+      {
+         goto error;
+      }
+   }
+
+   number_of_workers = pgmoneta_get_number_of_workers(srv);
+   if (number_of_workers > 0)
+   {
+      pgmoneta_workers_initialize(number_of_workers, &workers);
+   }
+
+   dir = opendir(trash);
+   if (dir == NULL)
+   {
+      goto error;
+   }
+
+   while ((entry = readdir(dir)) != NULL)
+   {
+      if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, ".."))
+      {
+         continue;
+      }
+
+      entry_path = pgmoneta_append(entry_path, trash);
+      entry_path = pgmoneta_append(entry_path, entry->d_name);
+
+      failed = purge_directory(entry_path, &purge, workers, &queued);
+
+      pgmoneta_workers_wait(workers);
+      queued = 0;
+
+      if (failed)
+      {
+         /* Kept for the next purge, so the remaining files are accounted for */
+         pgmoneta_log_warn("Trash: Could not purge %s", entry_path);
+      }
+      else
+      {
+         /* Only the directories are left */
+         pgmoneta_delete_directory(entry_path);
+      }
+
+      free(entry_path);
+      entry_path = NULL;
+   }
+
+   closedir(dir);
+   dir = NULL;
+
+   pgmoneta_disk_usage_add(srv, DISK_USAGE_BACKUP, -(int64_t)atomic_load(&purge.usage));
+
+   atomic_fetch_add(&config->common.servers[srv].trash_reclaimed_files, atomic_load(&purge.files));
+   atomic_fetch_add(&config->common.servers[srv].trash_reclaimed_bytes, atomic_load(&purge.reclaimed));
+
+#ifdef HAVE_FREEBSD
+   clock_gettime(CLOCK_MONOTONIC_FAST, &end_t);
+#else
+   clock_gettime(CLOCK_MONOTONIC_RAW, &end_t);
+#endif
+
+   total_seconds = pgmoneta_compute_duration(start_t, end_t);
+
+   if (atomic_load(&purge.files) > 0)
+   {
+      pgmoneta_log_info("Trash: %s (Files: %lu, Reclaimed: %llu bytes, Elapsed: %.2fs)",
+                        config->common.servers[srv].name,
+                        atomic_load(&purge.files),
+                        (unsigned long long)atomic_load(&purge.reclaimed),
+                        total_seconds);
+   }
+
+   pgmoneta_workers_destroy(workers);
+   pgmoneta_token_bucket_destroy(purge.bucket);
+
+   atomic_store(&config->common.servers[srv].trash_pid, 0);
+
+   free(trash);
+
+   return 0;
+
+error:
+
+   if (dir != NULL)
+   {
+      closedir(dir);
+   }
+
+   pgmoneta_workers_wait(workers);
+   pgmoneta_workers_destroy(workers);
+   pgmoneta_token_bucket_destroy(purge.bucket);
+
+   atomic_store(&config->common.servers[srv].trash_pid, 0);
+
+   free(entry_path);
+   free(trash);
+
+   return 1;
+}
+
+static int
+purge_directory(char* path, struct trash_purge* purge, struct workers* workers, int* queued)
+{
+   bool is_dir;
+   bool failed = false;
+   char* p = NULL;
+   DIR* dir = NULL;
+   struct dirent* entry = NULL;
+   struct stat st;
+   struct trash_input* ti = NULL;
+
+   dir = opendir(path);
+   if (dir == NULL)
+   {
+      goto error;
+   }
+
+   while ((entry = readdir(dir)) != NULL)
+   {
+      if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, ".."))
+      {
+         continue;
+      }
+
+      p = pgmoneta_append(p, path);
+      p = pgmoneta_append_char(p, '/');
+      p = pgmoneta_append(p, entry->d_name);
+
+      is_dir = entry->d_type == DT_DIR;
+
+      /* Not all file systems fill in the type */
+      if (entry->d_type == DT_UNKNOWN)
+      {
+         if (lstat(p, &st))
+         {
+            pgmoneta_log_debug("Trash: Could not stat %s: %s", p, strerror(errno));
+            errno = 0;
+            failed = true;
+
+            free(p);
+            p = NULL;
+            continue;
+         }
+
+         is_dir = S_ISDIR(st.st_mode);
+      }
+
+      if (is_dir)
+      {
+         if (purge_directory(p, purge, workers, queued))
+         {
+            failed = true;
+         }
+      }
+      else
+      {
+         ti = (struct trash_input*)malloc(sizeof(struct trash_input));
+         if (ti == NULL)
+         {
+            goto error;
+         }
+
+         memset(ti, 0, sizeof(struct trash_input));
+         snprintf(ti->path, sizeof(ti->path), "%s", p);
+         ti->purge = purge;
+         ti->common.workers = workers;
+
+         if (workers != NULL)
+         {
+            pgmoneta_workers_add(workers, do_unlink, (struct worker_common*)ti);
+
+            /* Bound the queue, so memory doesn't grow with the number of files */
+            if (++(*queued) >= TRASH_BATCH_SIZE)
+            {
+               pgmoneta_workers_wait(workers);
+               *queued = 0;
+            }
+         }
+         else
+         {
+            do_unlink((struct worker_common*)ti);
+         }
+      }
+
+      free(p);
+      p = NULL;
+   }
+
+   closedir(dir);
+
+   return failed ? 1 : 0;
+
+error:
+
+   if (dir != NULL)
+   {
+      closedir(dir);
+   }
+
+   free(p);
+
+   return 1;
+}
+
+static void
+do_unlink(struct worker_common* wc)
+{
+   unsigned long size = 0;
+   struct stat st;
+   struct trash_input* ti = (struct trash_input*)wc;
+
+   memset(&st, 0, sizeof(struct stat));
+
+   if (lstat(ti->path, &st))
+   {
+      errno = 0;
+      goto done;
+   }
+
+   if (S_ISLNK(st.st_mode))
+   {
+      size = st.st_blksize;
+   }
+   else
+   {
+      size = pgmoneta_file_disk_size(ti->path);
+   }
+
+   if (ti->purge->bucket != NULL)
+   {
+      while (pgmoneta_token_bucket_consume(ti->purge->bucket, size))
+      {
+         SLEEP(100000000L);
+      }
+   }
+
+   if (unlink(ti->path))
+   {
+      pgmoneta_log_debug("Trash: Could not delete %s: %s", ti->path, strerror(errno));
+      errno = 0;
+      goto done;
+   }
+
+   atomic_fetch_add(&ti->purge->files, 1);
+   atomic_fetch_add(&ti->purge->usage, size);
+
+   /* Hard linked files are still used by another backup */
+   if (S_ISREG(st.st_mode) && st.st_nlink == 1)
+   {
+      atomic_fetch_add(&ti->purge->reclaimed, (unsigned long long)st.st_blocks * 512);
+   }
+
+done:
+
+   free(ti);
 }
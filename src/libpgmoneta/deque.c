@@ -26,6 +26,7 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+
 #include <pgmoneta.h>
 #include <deque.h>
 #include <logging.h>
@@ -35,12 +36,12 @@
 #include <string.h>
 
 // tag is copied if not NULL
-static void
+static int
 deque_offer(struct deque* deque, char* tag, uintptr_t data, enum value_type type, struct value_config* config);
 
 // tag is copied if not NULL
 static void
-deque_node_create(uintptr_t data, enum value_type type, char* tag, struct value_config* config, struct deque_node** node);
+deque_node_create(uintptr_t data, enum value_type type, char* tag, struct value_config* config, struct deque_node* node);
 
 // tag will always be freed
 static void
@@ -52,14 +53,23 @@ deque_read_lock(struct deque* deque);
 static void
 deque_write_lock(struct deque* deque);
 
+static bool
+deque_lookup_lock(struct deque* deque);
+
 static void
 deque_unlock(struct deque* deque);
 
 static struct deque_node*
-deque_next(struct deque* deque, struct deque_node* node);
+deque_at(struct deque* deque, uint32_t position);
 
 static struct deque_node*
-deque_find(struct deque* deque, char* tag);
+deque_slot(struct deque* deque, uint32_t slot);
+
+static int
+deque_grow(struct deque* deque);
+
+static struct value*
+deque_find(struct deque* deque, char* tag, bool build);
 
 static char*
 to_json_string(struct deque* deque, char* tag, int indent);
@@ -70,21 +80,39 @@ to_compact_json_string(struct deque* deque, char* tag, int indent);
 static char*
 to_text_string(struct deque* deque, char* tag, int indent);
 
-static struct deque_node*
-deque_remove(struct deque* deque, struct deque_node* node);
-
-static struct deque_node*
-get_middle(struct deque_node* node);
+static void
+deque_compact(struct deque* deque);
 
-static struct deque_node*
-deque_sort(struct deque_node* node);
+static int64_t
+iterator_next_position(struct deque_iterator* iter);
 
-static struct deque_node*
-deque_merge(struct deque_node* node1, struct deque_node* node2);
+static void
+deque_sort(struct deque_node* nodes, struct deque_node* buffer, uint32_t size);
 
 static int
 tag_compare(char* tag1, char* tag2);
 
+static uint64_t
+index_hash(char* tag);
+
+static void
+index_create(struct deque* deque);
+
+static void
+index_destroy(struct deque* deque);
+
+static void
+index_insert(struct deque_index* index, char* tag, struct value* data);
+
+static void
+index_add(struct deque* deque, struct deque_node* node);
+
+static void
+index_remove(struct deque* deque, struct deque_node* node);
+
+static struct deque_index_entry*
+index_find(struct deque_index* index, char* tag);
+
 int
 pgmoneta_deque_create(bool thread_safe, struct deque** deque)
 {
@@ -96,10 +124,12 @@ pgmoneta_deque_create(bool thread_safe, struct deque** deque)
    {
       pthread_rwlock_init(&q->mutex, NULL);
    }
-   deque_node_create(0, ValueInt32, NULL, NULL, &q->start);
-   deque_node_create(0, ValueInt32, NULL, NULL, &q->end);
-   q->start->next = q->end;
-   q->end->prev = q->start;
+   q->nodes = NULL;
+   q->capacity = 0;
+   q->head = 0;
+   q->gap_start = 0;
+   q->gap = 0;
+   q->index = NULL;
    *deque = q;
    return 0;
 }
@@ -107,8 +137,7 @@ pgmoneta_deque_create(bool thread_safe, struct deque** deque)
 int
 pgmoneta_deque_add(struct deque* deque, char* tag, uintptr_t data, enum value_type type)
 {
-   deque_offer(deque, tag, data, type, NULL);
-   return 0;
+   return deque_offer(deque, tag, data, type, NULL);
 }
 
 int
@@ -136,58 +165,62 @@ pgmoneta_deque_remove(struct deque* deque, char* tag)
 int
 pgmoneta_deque_clear(struct deque* deque)
 {
-   struct deque_iterator* iter = NULL;
    if (deque == NULL)
    {
       return 0;
    }
-   pgmoneta_deque_iterator_create(deque, &iter);
-   while (pgmoneta_deque_iterator_next(iter))
+   deque_write_lock(deque);
+   for (uint32_t i = 0; i < deque->size; i++)
    {
-      pgmoneta_deque_iterator_remove(iter);
+      deque_node_destroy(deque_at(deque, i));
    }
-   pgmoneta_deque_iterator_destroy(iter);
+   deque->size = 0;
+   deque->head = 0;
+   deque->gap_start = 0;
+   deque->gap = 0;
+   index_destroy(deque);
+   deque_unlock(deque);
    return 0;
 }
 
 int
 pgmoneta_deque_add_with_config(struct deque* deque, char* tag, uintptr_t data, struct value_config* config)
 {
-   deque_offer(deque, tag, data, ValueRef, config);
-   return 0;
+   return deque_offer(deque, tag, data, ValueRef, config);
 }
 
 uintptr_t
 pgmoneta_deque_poll(struct deque* deque, char** tag)
 {
    struct deque_node* head = NULL;
-   struct value* val = NULL;
    uintptr_t data = 0;
-   if (deque == NULL || pgmoneta_deque_size(deque) == 0)
+   if (deque == NULL)
    {
       return 0;
    }
    deque_write_lock(deque);
-   head = deque->start->next;
-   // this should not happen when size is not 0, but just in case
-   if (head == deque->end)
+   if (deque->size == 0)
    {
       deque_unlock(deque);
       return 0;
    }
-   // remove node
-   deque->start->next = head->next;
-   head->next->prev = deque->start;
+   deque_compact(deque);
+   head = deque_at(deque, 0);
+   index_remove(deque, head);
+   deque->head = (deque->head + 1) & (deque->capacity - 1);
    deque->size--;
-   val = head->data;
+
    if (tag != NULL)
    {
       *tag = head->tag;
    }
-   free(head);
+   else
+   {
+      free(head->tag);
+   }
 
-   data = pgmoneta_value_data(val);
-   free(val);
+   data = pgmoneta_value_data(head->data);
+   free(head->data);
 
    deque_unlock(deque);
    return data;
@@ -197,33 +230,33 @@ uintptr_t
 pgmoneta_deque_poll_last(struct deque* deque, char** tag)
 {
    struct deque_node* tail = NULL;
-   struct value* val = NULL;
    uintptr_t data = 0;
-   if (deque == NULL || pgmoneta_deque_size(deque) == 0)
+   if (deque == NULL)
    {
       return 0;
    }
    deque_write_lock(deque);
-   tail = deque->end->prev;
-   if (tail == deque->start)
+   if (deque->size == 0)
    {
       deque_unlock(deque);
       return 0;
    }
-   // remove node
-   deque->end->prev = tail->prev;
-   tail->prev->next = deque->end;
+   deque_compact(deque);
+   tail = deque_at(deque, deque->size - 1);
+   index_remove(deque, tail);
    deque->size--;
 
-   val = tail->data;
    if (tag != NULL)
    {
       *tag = tail->tag;
    }
-   free(tail);
+   else
+   {
+      free(tail->tag);
+   }
 
-   data = pgmoneta_value_data(val);
-   free(val);
+   data = pgmoneta_value_data(tail->data);
+   free(tail->data);
 
    deque_unlock(deque);
    return data;
@@ -233,67 +266,66 @@ uintptr_t
 pgmoneta_deque_peek(struct deque* deque, char** tag)
 {
    struct deque_node* head = NULL;
-   struct value* val = NULL;
-   if (deque == NULL || pgmoneta_deque_size(deque) == 0)
+   uintptr_t data = 0;
+   if (deque == NULL)
    {
       return 0;
    }
    deque_read_lock(deque);
-   head = deque->start->next;
-   // this should not happen when size is not 0, but just in case
-   if (head == deque->end)
+   if (deque->size == 0)
    {
       deque_unlock(deque);
       return 0;
    }
-   val = head->data;
+   head = deque_at(deque, 0);
    if (tag != NULL)
    {
       *tag = head->tag;
    }
+   data = pgmoneta_value_data(head->data);
    deque_unlock(deque);
-   return pgmoneta_value_data(val);
+   return data;
 }
 
 uintptr_t
 pgmoneta_deque_peek_last(struct deque* deque, char** tag)
 {
    struct deque_node* tail = NULL;
-   struct value* val = NULL;
-   if (deque == NULL || pgmoneta_deque_size(deque) == 0)
+   uintptr_t data = 0;
+   if (deque == NULL)
    {
       return 0;
    }
    deque_read_lock(deque);
-   tail = deque->end->prev;
-   // this should not happen when size is not 0, but just in case
-   if (tail == deque->start)
+   if (deque->size == 0)
    {
       deque_unlock(deque);
       return 0;
    }
-   val = tail->data;
+   tail = deque_at(deque, deque->size - 1);
    if (tag != NULL)
    {
       *tag = tail->tag;
    }
+   data = pgmoneta_value_data(tail->data);
    deque_unlock(deque);
-   return pgmoneta_value_data(val);
+   return data;
 }
 
 uintptr_t
 pgmoneta_deque_get(struct deque* deque, char* tag)
 {
-   struct deque_node* n = NULL;
+   struct value* v = NULL;
    uintptr_t ret = 0;
+   bool build = false;
 
-   deque_read_lock(deque);
-   n = deque_find(deque, tag);
-   if (n == NULL)
+   build = deque_lookup_lock(deque);
+   v = deque_find(deque, tag, build);
+   if (v == NULL)
    {
       goto error;
    }
-   ret = pgmoneta_value_data(n->data);
+   ret = pgmoneta_value_data(v);
    deque_unlock(deque);
    return ret;
 error:
@@ -305,12 +337,11 @@ bool
 pgmoneta_deque_exists(struct deque* deque, char* tag)
 {
    bool ret = false;
-   struct deque_node* n = NULL;
+   bool build = false;
 
-   deque_read_lock(deque);
+   build = deque_lookup_lock(deque);
 
-   n = deque_find(deque, tag);
-   if (n != NULL)
+   if (deque_find(deque, tag, build) != NULL)
    {
       ret = true;
    }
@@ -341,48 +372,56 @@ pgmoneta_deque_list(struct deque* deque)
 void
 pgmoneta_deque_sort(struct deque* deque)
 {
+   struct deque_node* nodes = NULL;
+   struct deque_node* buffer = NULL;
+
    deque_write_lock(deque);
-   if (deque == NULL || deque->start == NULL || deque->end == NULL || deque->size <= 1)
+   if (deque == NULL || deque->size <= 1)
+   {
+      deque_unlock(deque);
+      return;
+   }
+
+   deque_compact(deque);
+
+   nodes = malloc(deque->capacity * sizeof(struct deque_node));
+   buffer = malloc(deque->size * sizeof(struct deque_node));
+   if (nodes == NULL || buffer == NULL)
    {
+      free(nodes);
+      free(buffer);
       deque_unlock(deque);
       return;
    }
-   // break the connection to start and end node since we are going to move nodes around
-   struct deque_node* first = deque->start->next;
-   struct deque_node* last = deque->end->prev;
-   struct deque_node* node = NULL;
-   first->prev = NULL;
-   last->next = NULL;
-   deque->start->next = NULL;
-   deque->end->prev = NULL;
-   node = deque_sort(first);
-   deque->start->next = node;
-   node->prev = deque->start;
-   while (node->next != NULL)
-   {
-      node = node->next;
-   }
-   deque->end->prev = node;
-   node->next = deque->end;
+
+   for (uint32_t i = 0; i < deque->size; i++)
+   {
+      nodes[i] = *deque_at(deque, i);
+   }
+
+   // the sort is stable, so the tag index still points to the first node of each tag
+   deque_sort(nodes, buffer, deque->size);
+
+   free(buffer);
+   free(deque->nodes);
+   deque->nodes = nodes;
+   deque->head = 0;
    deque_unlock(deque);
 }
 
 void
 pgmoneta_deque_destroy(struct deque* deque)
 {
-   struct deque_node* n = NULL;
-   struct deque_node* next = NULL;
    if (deque == NULL)
    {
       return;
    }
-   n = deque->start;
-   while (n != NULL)
+   for (uint32_t i = 0; i < deque->size; i++)
    {
-      next = n->next;
-      deque_node_destroy(n);
-      n = next;
+      deque_node_destroy(deque_at(deque, i));
    }
+   index_destroy(deque);
+   free(deque->nodes);
    if (deque->thread_safe)
    {
       pthread_rwlock_destroy(&deque->mutex);
@@ -443,7 +482,8 @@ pgmoneta_deque_iterator_create(struct deque* deque, struct deque_iterator** iter
    }
    i = malloc(sizeof(struct deque_iterator));
    i->deque = deque;
-   i->cur = deque->start;
+   i->position = -1;
+   i->next = 0;
    i->tag = NULL;
    i->value = NULL;
    *iter = i;
@@ -453,20 +493,33 @@ pgmoneta_deque_iterator_create(struct deque* deque, struct deque_iterator** iter
 void
 pgmoneta_deque_iterator_remove(struct deque_iterator* iter)
 {
-   if (iter == NULL || iter->cur == NULL || iter->deque == NULL ||
-       iter->cur == iter->deque->start || iter->cur == iter->deque->end)
+   struct deque* deque = NULL;
+   struct deque_node* n = NULL;
+
+   if (iter == NULL || iter->deque == NULL || iter->position < 0 ||
+       iter->position >= iter->deque->size + iter->deque->gap)
    {
       return;
    }
-   iter->cur = deque_remove(iter->deque, iter->cur);
-   if (iter->cur == iter->deque->start)
+   deque = iter->deque;
+   // leave an empty slot, the following nodes are moved into it by pgmoneta_deque_iterator_next
+   n = deque_slot(deque, (uint32_t)iter->position);
+   index_remove(deque, n);
+   deque_node_destroy(n);
+   deque->gap_start = (uint32_t)iter->position;
+   deque->gap++;
+   deque->size--;
+   iter->position--;
+   iter->next = iterator_next_position(iter);
+   if (iter->position < 0)
    {
       iter->value = NULL;
       iter->tag = NULL;
       return;
    }
-   iter->value = iter->cur->data;
-   iter->tag = iter->cur->tag;
+   n = deque_slot(deque, (uint32_t)iter->position);
+   iter->value = n->data;
+   iter->tag = n->tag;
    return;
 }
 
@@ -477,81 +530,100 @@ pgmoneta_deque_iterator_destroy(struct deque_iterator* iter)
    {
       return;
    }
+   deque_compact(iter->deque);
    free(iter);
 }
 
 bool
 pgmoneta_deque_iterator_next(struct deque_iterator* iter)
 {
-   if (iter == NULL)
+   struct deque* deque = NULL;
+   struct deque_node* n = NULL;
+
+   if (iter == NULL || iter->deque == NULL)
    {
       return false;
    }
-   iter->cur = deque_next(iter->deque, iter->cur);
-   if (iter->cur == NULL)
+   deque = iter->deque;
+   iter->next = iterator_next_position(iter);
+   if (iter->next >= deque->size + deque->gap)
    {
+      deque_compact(deque);
+      // park the iterator past the last node, so a remove is a no-op
+      iter->position = deque->size;
+      iter->next = deque->size;
       return false;
    }
-   iter->value = iter->cur->data;
-   iter->tag = iter->cur->tag;
+   iter->position++;
+   n = deque_slot(deque, (uint32_t)iter->position);
+   if (iter->position != iter->next)
+   {
+      // move the next node to the front of the empty slots
+      *n = *deque_slot(deque, (uint32_t)iter->next);
+      memset(deque_slot(deque, (uint32_t)iter->next), 0, sizeof(struct deque_node));
+      deque->gap_start++;
+   }
+   iter->next++;
+   iter->value = n->data;
+   iter->tag = n->tag;
    return true;
 }
 
 bool
 pgmoneta_deque_iterator_has_next(struct deque_iterator* iter)
 {
-   if (iter == NULL)
+   if (iter == NULL || iter->deque == NULL)
    {
       return false;
    }
-   return deque_next(iter->deque, iter->cur) != NULL;
+   return iterator_next_position(iter) < iter->deque->size + iter->deque->gap;
 }
 
-static void
+static int
 deque_offer(struct deque* deque, char* tag, uintptr_t data, enum value_type type, struct value_config* config)
 {
-   struct deque_node* n = NULL;
-   struct deque_node* last = NULL;
+   struct deque_node n;
 
    if (type == ValueNone)
    {
-      return;
+      return 0;
    }
 
    deque_node_create(data, type, tag, config, &n);
    deque_write_lock(deque);
+   if (deque->size + deque->gap == deque->capacity && deque_grow(deque))
+   {
+      deque_unlock(deque);
+      deque_node_destroy(&n);
+      return 1;
+   }
+   *deque_slot(deque, deque->size + deque->gap) = n;
    deque->size++;
-   last = deque->end->prev;
-   last->next = n;
-   n->prev = last;
-   n->next = deque->end;
-   deque->end->prev = n;
+   index_add(deque, &n);
    deque_unlock(deque);
+   return 0;
 }
 
 static void
-deque_node_create(uintptr_t data, enum value_type type, char* tag, struct value_config* config, struct deque_node** node)
+deque_node_create(uintptr_t data, enum value_type type, char* tag, struct value_config* config, struct deque_node* node)
 {
-   struct deque_node* n = NULL;
-   n = malloc(sizeof(struct deque_node));
-   memset(n, 0, sizeof(struct deque_node));
+   memset(node, 0, sizeof(struct deque_node));
    if (config != NULL)
    {
-      pgmoneta_value_create_with_config(data, config, &n->data);
+      pgmoneta_value_create_with_config(data, config, &node->data);
    }
    else
    {
-      pgmoneta_value_create(type, data, &n->data);
+      pgmoneta_value_create(type, data, &node->data);
    }
    if (tag != NULL)
    {
-      n->tag = pgmoneta_append(NULL, tag);
+      node->tag = pgmoneta_append(NULL, tag);
    }
    else
    {
-      n->tag = NULL;
+      node->tag = NULL;
    }
-   *node = n;
 }
 
 static void
@@ -563,7 +635,8 @@ deque_node_destroy(struct deque_node* node)
    }
    pgmoneta_value_destroy(node->data);
    free(node->tag);
-   free(node);
+   node->data = NULL;
+   node->tag = NULL;
 }
 
 static void
@@ -586,6 +659,28 @@ deque_write_lock(struct deque* deque)
    pthread_rwlock_wrlock(&deque->mutex);
 }
 
+// takes the write lock when the lookup has to build the tag index, returns true if it may be built
+static bool
+deque_lookup_lock(struct deque* deque)
+{
+   if (deque == NULL)
+   {
+      return false;
+   }
+   if (!deque->thread_safe)
+   {
+      return true;
+   }
+   pthread_rwlock_rdlock(&deque->mutex);
+   if (deque->index != NULL || deque->size < DEQUE_INDEX_THRESHOLD)
+   {
+      return false;
+   }
+   pthread_rwlock_unlock(&deque->mutex);
+   pthread_rwlock_wrlock(&deque->mutex);
+   return true;
+}
+
 static void
 deque_unlock(struct deque* deque)
 {
@@ -596,40 +691,86 @@ deque_unlock(struct deque* deque)
    pthread_rwlock_unlock(&deque->mutex);
 }
 
+// the node at a position, skipping the slots emptied by iterator removes
 static struct deque_node*
-deque_next(struct deque* deque, struct deque_node* node)
+deque_at(struct deque* deque, uint32_t position)
 {
-   struct deque_node* next = NULL;
-   if (deque == NULL || deque->size == 0 || node == NULL)
+   if (position >= deque->gap_start)
    {
-      return NULL;
+      position += deque->gap;
    }
-   if (node->next == deque->end)
+   return deque_slot(deque, position);
+}
+
+static struct deque_node*
+deque_slot(struct deque* deque, uint32_t slot)
+{
+   return &deque->nodes[(deque->head + slot) & (deque->capacity - 1)];
+}
+
+static int
+deque_grow(struct deque* deque)
+{
+   uint32_t capacity = 0;
+   uint32_t first = 0;
+   struct deque_node* nodes = NULL;
+
+   capacity = deque->capacity == 0 ? DEQUE_MINIMUM_CAPACITY : deque->capacity * 2;
+   nodes = malloc(capacity * sizeof(struct deque_node));
+   if (nodes == NULL)
    {
-      return NULL;
+      pgmoneta_log_error("Unable to grow deque to %u nodes", capacity);
+      return 1;
    }
-   next = node->next;
-   return next;
+
+   if (deque->size + deque->gap > 0)
+   {
+      // the slots from the head to the end of the buffer, then the wrapped part
+      first = deque->capacity - deque->head;
+      if (first > deque->size + deque->gap)
+      {
+         first = deque->size + deque->gap;
+      }
+      memcpy(nodes, deque->nodes + deque->head, first * sizeof(struct deque_node));
+      memcpy(nodes + first, deque->nodes, (deque->size + deque->gap - first) * sizeof(struct deque_node));
+   }
+
+   free(deque->nodes);
+   deque->nodes = nodes;
+   deque->capacity = capacity;
+   deque->head = 0;
+
+   return 0;
 }
 
-static struct deque_node*
-deque_find(struct deque* deque, char* tag)
+static struct value*
+deque_find(struct deque* deque, char* tag, bool build)
 {
    struct deque_node* n = NULL;
+   struct deque_index_entry* entry = NULL;
    if (tag == NULL || strlen(tag) == 0 || deque == NULL || deque->size == 0)
    {
       return NULL;
    }
-   n = deque_next(deque, deque->start);
 
-   while (n != NULL)
+   if (deque->index == NULL && build && deque->size >= DEQUE_INDEX_THRESHOLD)
+   {
+      index_create(deque);
+   }
+
+   if (deque->index != NULL)
+   {
+      entry = index_find(deque->index, tag);
+      return entry != NULL ? entry->data : NULL;
+   }
+
+   for (uint32_t i = 0; i < deque->size; i++)
    {
+      n = deque_at(deque, i);
       if (pgmoneta_compare_string(tag, n->tag))
       {
-         return n;
+         return n->data;
       }
-
-      n = deque_next(deque, n);
    }
    return NULL;
 }
@@ -647,12 +788,12 @@ to_json_string(struct deque* deque, char* tag, int indent)
    }
    deque_read_lock(deque);
    ret = pgmoneta_append(ret, "[\n");
-   cur = deque_next(deque, deque->start);
-   while (cur != NULL)
+   for (uint32_t i = 0; i < deque->size; i++)
    {
-      bool has_next = cur->next != deque->end;
+      bool has_next = i + 1 < deque->size;
       char* str = NULL;
       char* t = NULL;
+      cur = deque_at(deque, i);
       if (cur->tag != NULL)
       {
          t = pgmoneta_append(t, cur->tag);
@@ -663,7 +804,6 @@ to_json_string(struct deque* deque, char* tag, int indent)
       ret = pgmoneta_append(ret, str);
       ret = pgmoneta_append(ret, has_next ? ",\n" : "\n");
       free(str);
-      cur = deque_next(deque, cur);
    }
    ret = pgmoneta_indent(ret, NULL, indent);
    ret = pgmoneta_append(ret, "]");
@@ -684,12 +824,12 @@ to_compact_json_string(struct deque* deque, char* tag, int indent)
    }
    deque_read_lock(deque);
    ret = pgmoneta_append(ret, "[");
-   cur = deque_next(deque, deque->start);
-   while (cur != NULL)
+   for (uint32_t i = 0; i < deque->size; i++)
    {
-      bool has_next = cur->next != deque->end;
+      bool has_next = i + 1 < deque->size;
       char* str = NULL;
       char* t = NULL;
+      cur = deque_at(deque, i);
       if (cur->tag != NULL)
       {
          t = pgmoneta_append(t, cur->tag);
@@ -700,7 +840,6 @@ to_compact_json_string(struct deque* deque, char* tag, int indent)
       ret = pgmoneta_append(ret, str);
       ret = pgmoneta_append(ret, has_next ? "," : "");
       free(str);
-      cur = deque_next(deque, cur);
    }
    ret = pgmoneta_append(ret, "]");
    deque_unlock(deque);
@@ -726,11 +865,11 @@ to_text_string(struct deque* deque, char* tag, int indent)
       return ret;
    }
    deque_read_lock(deque);
-   cur = deque_next(deque, deque->start);
-   while (cur != NULL)
+   for (uint32_t i = 0; i < deque->size; i++)
    {
-      bool has_next = cur->next != deque->end;
+      bool has_next = i + 1 < deque->size;
       char* str = NULL;
+      cur = deque_at(deque, i);
       str = pgmoneta_value_to_string(cur->data, FORMAT_TEXT, BULLET_POINT, next_indent);
       if (cnt == 0)
       {
@@ -747,136 +886,109 @@ to_text_string(struct deque* deque, char* tag, int indent)
       ret = pgmoneta_append(ret, str);
       ret = pgmoneta_append(ret, has_next ? "\n" : "");
       free(str);
-      cur = deque_next(deque, cur);
    }
    deque_unlock(deque);
    return ret;
 }
 
-static struct deque_node*
-deque_remove(struct deque* deque, struct deque_node* node)
+// close the gap left by the nodes removed through an iterator by moving the shorter side
+static void
+deque_compact(struct deque* deque)
 {
-   if (deque == NULL || node == NULL || node == deque->start || node == deque->end)
+   uint32_t first = 0;
+   uint32_t gap = 0;
+
+   if (deque == NULL || deque->gap == 0)
    {
-      return NULL;
+      return;
    }
-   struct deque_node* prev = node->prev;
-   struct deque_node* next = node->next;
-   prev->next = next;
-   next->prev = prev;
-   deque_node_destroy(node);
-   deque->size--;
-   return prev;
-}
 
-static struct deque_node*
-get_middle(struct deque_node* node)
-{
-   struct deque_node* slow = node;
-   struct deque_node* fast = node;
-   while (fast != NULL && fast->next != NULL)
+   first = deque->gap_start;
+   gap = deque->gap;
+
+   if (first < deque->size - first)
    {
-      slow = slow->next;
-      fast = fast->next->next;
+      for (uint32_t i = first; i > 0; i--)
+      {
+         *deque_slot(deque, i - 1 + gap) = *deque_slot(deque, i - 1);
+      }
+      deque->head = (deque->head + gap) & (deque->capacity - 1);
    }
-   return slow;
+   else
+   {
+      for (uint32_t i = first + gap; i < deque->size + gap; i++)
+      {
+         *deque_slot(deque, i - gap) = *deque_slot(deque, i);
+      }
+   }
+
+   deque->gap_start = 0;
+   deque->gap = 0;
 }
 
-static struct deque_node*
-deque_sort(struct deque_node* node)
+// the slot of the node following the current one, past the empty slots behind it
+static int64_t
+iterator_next_position(struct deque_iterator* iter)
 {
-   struct deque_node* mid = NULL;
-   struct deque_node* prevmid = NULL;
-   struct deque_node* node1 = NULL;
-   struct deque_node* node2 = NULL;
-   if (node == NULL || node->next == NULL)
+   int64_t next = iter->position + 1;
+
+   if (iter->deque->gap > 0 && iter->deque->gap_start == next)
    {
-      return node;
+      next += iter->deque->gap;
    }
-   mid = get_middle(node);
-   prevmid = mid->prev;
-   mid->prev = NULL;
-   prevmid->next = NULL;
-   node1 = deque_sort(node);
-   node2 = deque_sort(mid);
-   return deque_merge(node1, node2);
+
+   return next;
 }
 
-static struct deque_node*
-deque_merge(struct deque_node* node1, struct deque_node* node2)
+static void
+deque_sort(struct deque_node* nodes, struct deque_node* buffer, uint32_t size)
 {
-   struct deque_node* node = NULL;
-   struct deque_node* left = node1;
-   struct deque_node* right = node2;
-   struct deque_node* next = NULL;
-   struct deque_node* start = NULL;
-   if (node1 == NULL)
-   {
-      return node2;
-   }
-   if (node2 == NULL)
-   {
-      return node1;
-   }
-   while (left != NULL && right != NULL)
+   struct deque_node* from = nodes;
+   struct deque_node* to = buffer;
+   struct deque_node* swap = NULL;
+
+   // bottom up merge sort, equal tags keep their order
+   for (uint64_t width = 1; width < size; width *= 2)
    {
-      if (tag_compare(left->tag, right->tag) <= 0)
+      for (uint64_t left = 0; left < size; left += 2 * width)
       {
-         next = left->next;
-         if (node == NULL)
-         {
-            start = left;
-            node = left;
-            node->prev = NULL;
-            node->next = NULL;
-         }
-         else
+         uint64_t mid = left + width < size ? left + width : size;
+         uint64_t right = left + 2 * width < size ? left + 2 * width : size;
+         uint64_t i = left;
+         uint64_t j = mid;
+         uint64_t k = left;
+
+         while (i < mid && j < right)
          {
-            node->next = left;
-            left->prev = node;
-            left->next = NULL;
-            node = node->next;
+            if (tag_compare(from[i].tag, from[j].tag) <= 0)
+            {
+               to[k++] = from[i++];
+            }
+            else
+            {
+               to[k++] = from[j++];
+            }
          }
-         left = next;
-      }
-      else
-      {
-         next = right->next;
-         if (node == NULL)
+         while (i < mid)
          {
-            start = right;
-            node = right;
-            node->prev = NULL;
-            node->next = NULL;
+            to[k++] = from[i++];
          }
-         else
+         while (j < right)
          {
-            node->next = right;
-            right->prev = node;
-            right->next = NULL;
-            node = node->next;
+            to[k++] = from[j++];
          }
-         right = next;
       }
+      swap = from;
+      from = to;
+      to = swap;
    }
-   while (left != NULL)
-   {
-      next = left->next;
-      node->next = left;
-      left->prev = node;
-      left = next;
-      node = node->next;
-   }
-   while (right != NULL)
+
+   if (from != nodes)
    {
-      next = right->next;
-      node->next = right;
-      right->prev = node;
-      right = next;
-      node = node->next;
+      memcpy(nodes, from, size * sizeof(struct deque_node));
    }
-   return start;
 }
+
 static int
 tag_compare(char* tag1, char* tag2)
 {
@@ -890,3 +1002,202 @@ tag_compare(char* tag1, char* tag2)
    }
    return strcmp(tag1, tag2);
 }
+
+static uint64_t
+index_hash(char* tag)
+{
+   uint64_t hash = 14695981039346656037ULL;
+
+   // FNV-1a
+   for (unsigned char* c = (unsigned char*)tag; *c != '\0'; c++)
+   {
+      hash ^= *c;
+      hash *= 1099511628211ULL;
+   }
+
+   return hash;
+}
+
+static void
+index_create(struct deque* deque)
+{
+   struct deque_index* index = NULL;
+   struct deque_node* n = NULL;
+   uint32_t capacity = DEQUE_MINIMUM_CAPACITY;
+
+   while (capacity < deque->size * 2)
+   {
+      capacity *= 2;
+   }
+
+   index = malloc(sizeof(struct deque_index));
+   if (index == NULL)
+   {
+      return;
+   }
+   index->size = 0;
+   index->capacity = capacity;
+   index->duplicates = false;
+   index->entries = calloc(capacity, sizeof(struct deque_index_entry));
+   if (index->entries == NULL)
+   {
+      free(index);
+      return;
+   }
+
+   deque->index = index;
+
+   for (uint32_t i = 0; i < deque->size; i++)
+   {
+      n = deque_at(deque, i);
+      index_add(deque, n);
+   }
+}
+
+static void
+index_destroy(struct deque* deque)
+{
+   if (deque->index == NULL)
+   {
+      return;
+   }
+   free(deque->index->entries);
+   free(deque->index);
+   deque->index = NULL;
+}
+
+static void
+index_insert(struct deque_index* index, char* tag, struct value* data)
+{
+   uint64_t hash = index_hash(tag);
+   uint32_t mask = index->capacity - 1;
+   uint32_t slot = hash & mask;
+
+   while (index->entries[slot].tag != NULL)
+   {
+      slot = (slot + 1) & mask;
+   }
+
+   index->entries[slot].hash = hash;
+   index->entries[slot].tag = tag;
+   index->entries[slot].data = data;
+   index->size++;
+}
+
+static void
+index_add(struct deque* deque, struct deque_node* node)
+{
+   struct deque_index* index = deque->index;
+   struct deque_index_entry* entries = NULL;
+   uint32_t capacity = 0;
+
+   if (index == NULL || node->tag == NULL || strlen(node->tag) == 0)
+   {
+      return;
+   }
+
+   if (index_find(index, node->tag) != NULL)
+   {
+      // nodes are added at the tail, so the index keeps the first one
+      index->duplicates = true;
+      return;
+   }
+
+   if ((index->size + 1) * 2 > index->capacity)
+   {
+      entries = index->entries;
+      capacity = index->capacity;
+
+      index->entries = calloc(capacity * 2, sizeof(struct deque_index_entry));
+      if (index->entries == NULL)
+      {
+         index->entries = entries;
+         index_destroy(deque);
+         return;
+      }
+      index->capacity = capacity * 2;
+      index->size = 0;
+
+      for (uint32_t i = 0; i < capacity; i++)
+      {
+         if (entries[i].tag != NULL)
+         {
+            index_insert(index, entries[i].tag, entries[i].data);
+         }
+      }
+      free(entries);
+   }
+
+   index_insert(index, node->tag, node->data);
+}
+
+static void
+index_remove(struct deque* deque, struct deque_node* node)
+{
+   struct deque_index* index = deque->index;
+   struct deque_index_entry* entry = NULL;
+   uint32_t mask = 0;
+   uint32_t hole = 0;
+   uint32_t slot = 0;
+   uint32_t home = 0;
+
+   if (index == NULL || node->tag == NULL)
+   {
+      return;
+   }
+
+   entry = index_find(index, node->tag);
+   if (entry == NULL || entry->data != node->data)
+   {
+      // not the first node with the tag
+      return;
+   }
+
+   if (index->duplicates)
+   {
+      // the next node with the tag is unknown, rebuild on the next lookup
+      index_destroy(deque);
+      return;
+   }
+
+   // backward shift deletion keeps the probe sequences intact
+   mask = index->capacity - 1;
+   hole = (uint32_t)(entry - index->entries);
+   slot = hole;
+   for (;;)
+   {
+      slot = (slot + 1) & mask;
+      if (index->entries[slot].tag == NULL)
+      {
+         break;
+      }
+      home = index->entries[slot].hash & mask;
+      if (((slot - home) & mask) >= ((slot - hole) & mask))
+      {
+         index->entries[hole] = index->entries[slot];
+         hole = slot;
+      }
+   }
+
+   memset(&index->entries[hole], 0, sizeof(struct deque_index_entry));
+   index->size--;
+}
+
+static struct deque_index_entry*
+index_find(struct deque_index* index, char* tag)
+{
+   uint64_t hash = index_hash(tag);
+   uint32_t mask = index->capacity - 1;
+   uint32_t slot = hash & mask;
+
+   while (index->entries[slot].tag != NULL)
+   {
+      if (index->entries[slot].hash == hash && !strcmp(index->entries[slot].tag, tag))
+      {
+         return &index->entries[slot];
+      }
+      slot = (slot + 1) & mask;
+   }
+
+   return NULL;
+}
@@ -0,0 +1,767 @@
+/*
+ * Copyright (C) 2025 The pgmoneta community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* pgmoneta */
+#include <pgmoneta.h>
+#include <art.h>
+#include <deque.h>
+#include <download.h>
+#include <http.h>
+#include <logging.h>
+#include <security.h>
+#include <storage.h>
+#include <utils.h>
+#include <workers.h>
+
+/* system */
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <libgen.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/** @struct download_file
+ * Defines an object that is downloaded
+ */
+struct download_file
+{
+   char key[MAX_PATH];    /**< The key relative to the remote root */
+   char path[MAX_PATH];   /**< The local path */
+   uint64_t size;         /**< The size */
+   bool last;             /**< Download after the other files */
+   char* sha256;          /**< The expected SHA-256, or NULL */
+   atomic_int remaining;  /**< The number of parts remaining */
+   atomic_bool failed;    /**< Did a part fail */
+};
+
+/** @struct download_input
+ * Defines a range of an object that is downloaded by a worker
+ */
+struct download_input
+{
+   struct worker_common common;      /**< The worker common */
+   struct download_engine* engine;   /**< The engine */
+   struct download_file* file;       /**< The file */
+   uint64_t offset;                  /**< The offset of the range */
+   uint64_t length;                  /**< The length of the range, 0 for the whole object */
+   uint64_t received;                /**< The number of bytes received */
+   int fd;                           /**< The file descriptor */
+};
+
+static int download_sink(void* arg, void* data, size_t size);
+static void do_download(struct worker_common* wc);
+static int download_part(struct download_input* di);
+static int verify_file(struct download_file* file);
+static int read_sha256(char* path, struct art* sha256);
+static bool is_last_file(char* key);
+static int compare_files(const void* a, const void* b);
+
+int
+pgmoneta_download_backup(struct download_engine* engine, char* label)
+{
+   int number_of_workers = 0;
+   int number_of_files = 0;
+   int number_of_inputs = 0;
+   int capacity = 0;
+   uint64_t total = 0;
+   double elapsed = 0;
+   char* root = NULL;
+   char* sha256_path = NULL;
+   char* s = NULL;
+   char* t = NULL;
+   struct deque* objects = NULL;
+   struct deque_iterator* iter = NULL;
+   struct art* sha256 = NULL;
+   struct download_file** files = NULL;
+   struct download_input** inputs = NULL;
+   struct download_input* di = NULL;
+   struct workers* workers = NULL;
+   struct timespec start_t;
+   struct timespec end_t;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+#ifdef HAVE_FREEBSD
+   clock_gettime(CLOCK_MONOTONIC_FAST, &start_t);
+#else
+   clock_gettime(CLOCK_MONOTONIC_RAW, &start_t);
+#endif
+
+   root = pgmoneta_get_server_backup_identifier(engine->server, label);
+
+   if (pgmoneta_deque_create(false, &objects))
+   {
+      goto error;
+   }
+
+   if (engine->list(engine, objects))
+   {
+      pgmoneta_log_error("%s: Could not list %s", engine->name, engine->root);
+      goto error;
+   }
+
+   if (pgmoneta_deque_empty(objects))
+   {
+      pgmoneta_log_error("%s: No objects for %s/%s", engine->name, config->common.servers[engine->server].name, label);
+      goto error;
+   }
+
+   if (pgmoneta_art_create(&sha256))
+   {
+      goto error;
+   }
+
+   sha256_path = pgmoneta_append(sha256_path, root);
+   sha256_path = pgmoneta_append(sha256_path, "backup.sha256");
+
+   files = (struct download_file**)calloc(pgmoneta_deque_size(objects), sizeof(struct download_file*));
+   if (files == NULL)
+   {
+      goto error;
+   }
+
+   if (pgmoneta_deque_iterator_create(objects, &iter))
+   {
+      goto error;
+   }
+
+   while (pgmoneta_deque_iterator_next(iter))
+   {
+      struct download_file* f = NULL;
+
+      if (strstr(iter->tag, "..") != NULL)
+      {
+         pgmoneta_log_warn("%s: Skipping %s", engine->name, iter->tag);
+         continue;
+      }
+
+      f = (struct download_file*)calloc(1, sizeof(struct download_file));
+      if (f == NULL)
+      {
+         goto error;
+      }
+
+      snprintf(f->key, sizeof(f->key), "%s", iter->tag);
+      snprintf(f->path, sizeof(f->path), "%s%s", root, iter->tag);
+      f->size = (uint64_t)pgmoneta_value_data(iter->value);
+      f->last = is_last_file(f->key);
+      atomic_init(&f->remaining, 0);
+      atomic_init(&f->failed, false);
+
+      /* The backup information is kept locally */
+      if (pgmoneta_exists(f->path))
+      {
+         free(f);
+         continue;
+      }
+
+      files[number_of_files++] = f;
+   }
+
+   pgmoneta_deque_iterator_destroy(iter);
+   iter = NULL;
+
+   /* The checksums are needed before the data arrives */
+   if (!pgmoneta_exists(sha256_path))
+   {
+      for (int i = 0; i < number_of_files; i++)
+      {
+         if (!strcmp(files[i]->key, "backup.sha256"))
+         {
+            struct download_input input;
+
+            memset(&input, 0, sizeof(struct download_input));
+            input.engine = engine;
+            input.file = files[i];
+            atomic_store(&files[i]->remaining, 1);
+
+            do_download((struct worker_common*)&input);
+
+            if (atomic_load(&files[i]->failed))
+            {
+               goto error;
+            }
+
+            files[i] = files[--number_of_files];
+            free(input.file);
+            break;
+         }
+      }
+   }
+
+   if (pgmoneta_exists(sha256_path))
+   {
+      if (read_sha256(sha256_path, sha256))
+      {
+         pgmoneta_log_error("%s: Could not read %s", engine->name, sha256_path);
+         goto error;
+      }
+   }
+   else
+   {
+      pgmoneta_log_warn("%s: No backup.sha256 for %s/%s, checksums will not be verified",
+                        engine->name, config->common.servers[engine->server].name, label);
+   }
+
+   qsort(files, number_of_files, sizeof(struct download_file*), compare_files);
+
+   for (int i = 0; i < number_of_files; i++)
+   {
+      struct download_file* f = files[i];
+      char* dir = NULL;
+      int fd = -1;
+      int parts = 0;
+
+      if (pgmoneta_starts_with(f->key, "data/"))
+      {
+         f->sha256 = (char*)pgmoneta_art_search(sha256, f->key + strlen("data"));
+      }
+
+      dir = pgmoneta_append(dir, f->path);
+      if (pgmoneta_mkdir(dirname(dir)))
+      {
+         pgmoneta_log_error("%s: Could not create directory for %s", engine->name, f->path);
+         free(dir);
+         goto error;
+      }
+      free(dir);
+
+      fd = open(f->path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+      if (fd == -1 || ftruncate(fd, f->size) != 0)
+      {
+         pgmoneta_log_error("%s: Could not create %s: %s", engine->name, f->path, strerror(errno));
+         if (fd != -1)
+         {
+            close(fd);
+         }
+         goto error;
+      }
+      close(fd);
+
+      parts = (int)((f->size + DOWNLOAD_PART_SIZE - 1) / DOWNLOAD_PART_SIZE);
+      atomic_store(&f->remaining, parts);
+
+      for (int j = 0; j < parts; j++)
+      {
+         if (number_of_inputs == capacity)
+         {
+            struct download_input** n = NULL;
+
+            capacity = capacity == 0 ? 64 : capacity * 2;
+            n = (struct download_input**)realloc(inputs, capacity * sizeof(struct download_input*));
+            if (n == NULL)
+            {
+               goto error;
+            }
+            inputs = n;
+         }
+
+         di = (struct download_input*)calloc(1, sizeof(struct download_input));
+         if (di == NULL)
+         {
+            goto error;
+         }
+
+         di->engine = engine;
+         di->file = f;
+         di->offset = (uint64_t)j * DOWNLOAD_PART_SIZE;
+         di->length = MIN((uint64_t)DOWNLOAD_PART_SIZE, f->size - di->offset);
+         di->fd = -1;
+
+         inputs[number_of_inputs++] = di;
+         di = NULL;
+      }
+
+      if (parts == 0 && verify_file(f))
+      {
+         goto error;
+      }
+
+      total += f->size;
+   }
+
+   number_of_workers = pgmoneta_get_number_of_workers(engine->server);
+   if (number_of_workers > 0)
+   {
+      pgmoneta_workers_initialize(number_of_workers, &workers);
+   }
+
+   for (int i = 0; i < number_of_inputs; i++)
+   {
+      inputs[i]->common.workers = workers;
+
+      if (workers != NULL)
+      {
+         pgmoneta_workers_add(workers, do_download, (struct worker_common*)inputs[i]);
+      }
+      else
+      {
+         do_download((struct worker_common*)inputs[i]);
+      }
+   }
+
+   pgmoneta_workers_wait(workers);
+
+   for (int i = 0; i < number_of_files; i++)
+   {
+      if (atomic_load(&files[i]->failed))
+      {
+         goto error;
+      }
+   }
+
+   if (workers != NULL && !workers->outcome)
+   {
+      goto error;
+   }
+
+#ifdef HAVE_FREEBSD
+   clock_gettime(CLOCK_MONOTONIC_FAST, &end_t);
+#else
+   clock_gettime(CLOCK_MONOTONIC_RAW, &end_t);
+#endif
+
+   elapsed = pgmoneta_compute_duration(start_t, end_t);
+
+   s = pgmoneta_translate_file_size(total);
+   t = pgmoneta_translate_file_size(elapsed > 0 ? (uint64_t)(total / elapsed) : total);
+
+   pgmoneta_log_info("%s: Downloaded %s/%s (%d files, %s in %.3f seconds, %s/s)", engine->name,
+                     config->common.servers[engine->server].name, label, number_of_files, s, elapsed, t);
+
+   pgmoneta_workers_destroy(workers);
+
+   for (int i = 0; i < number_of_inputs; i++)
+   {
+      free(inputs[i]);
+   }
+   free(inputs);
+
+   for (int i = 0; i < number_of_files; i++)
+   {
+      free(files[i]);
+   }
+   free(files);
+
+   pgmoneta_art_destroy(sha256);
+   pgmoneta_deque_destroy(objects);
+
+   free(s);
+   free(t);
+   free(sha256_path);
+   free(root);
+
+   return 0;
+
+error:
+
+   pgmoneta_workers_wait(workers);
+   pgmoneta_workers_destroy(workers);
+
+   pgmoneta_deque_iterator_destroy(iter);
+
+   free(di);
+
+   for (int i = 0; i < number_of_inputs; i++)
+   {
+      free(inputs[i]);
+   }
+   free(inputs);
+
+   if (files != NULL)
+   {
+      for (int i = 0; i < number_of_files; i++)
+      {
+         free(files[i]);
+      }
+      free(files);
+   }
+
+   pgmoneta_art_destroy(sha256);
+   pgmoneta_deque_destroy(objects);
+
+   free(s);
+   free(t);
+   free(sha256_path);
+   free(root);
+
+   return 1;
+}
+
+int
+pgmoneta_download_fetch(int server, char* label, bool* fetched)
+{
+   char* data = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   *fetched = false;
+
+   data = pgmoneta_get_server_backup_identifier_data(server, label);
+
+   if (pgmoneta_exists(data))
+   {
+      free(data);
+      return 0;
+   }
+
+   if (config->storage_engine & STORAGE_ENGINE_S3)
+   {
+      if (pgmoneta_s3_download(server, label))
+      {
+         goto error;
+      }
+   }
+   else if (config->storage_engine & STORAGE_ENGINE_AZURE)
+   {
+      if (pgmoneta_azure_download(server, label))
+      {
+         goto error;
+      }
+   }
+   else
+   {
+      pgmoneta_log_error("No data for %s/%s", config->common.servers[server].name, label);
+      goto error;
+   }
+
+   *fetched = true;
+
+   free(data);
+
+   return 0;
+
+error:
+
+   /* Don't leave a partial backup behind */
+   pgmoneta_delete_directory(data);
+
+   free(data);
+
+   return 1;
+}
+
+int
+pgmoneta_download_buffer_sink(void* arg, void* data, size_t size)
+{
+   char* d = NULL;
+   struct download_buffer* buffer = (struct download_buffer*)arg;
+
+   d = (char*)realloc(buffer->data, buffer->size + size + 1);
+   if (d == NULL)
+   {
+      return 1;
+   }
+
+   memcpy(d + buffer->size, data, size);
+   buffer->data = d;
+   buffer->size += size;
+   buffer->data[buffer->size] = '\0';
+
+   return 0;
+}
+
+char*
+pgmoneta_download_xml_value(char* xml, char* name, char** end)
+{
+   char open_tag[MISC_LENGTH];
+   char close_tag[MISC_LENGTH];
+   char* start = NULL;
+   char* stop = NULL;
+
+   if (xml == NULL)
+   {
+      return NULL;
+   }
+
+   snprintf(open_tag, sizeof(open_tag), "<%s>", name);
+   snprintf(close_tag, sizeof(close_tag), "</%s>", name);
+
+   start = strstr(xml, open_tag);
+   if (start == NULL)
+   {
+      return NULL;
+   }
+   start += strlen(open_tag);
+
+   stop = strstr(start, close_tag);
+   if (stop == NULL)
+   {
+      return NULL;
+   }
+
+   if (end != NULL)
+   {
+      *end = stop + strlen(close_tag);
+   }
+
+   return strndup(start, stop - start);
+}
+
+static int
+download_sink(void* arg, void* data, size_t size)
+{
+   ssize_t written = 0;
+   size_t total = 0;
+   struct download_input* di = (struct download_input*)arg;
+
+   if (di->length > 0 && di->received + size > di->length)
+   {
+      pgmoneta_log_error("Received more than the requested range of %s", di->file->key);
+      return 1;
+   }
+
+   while (total < size)
+   {
+      written = pwrite(di->fd, (char*)data + total, size - total, di->offset + di->received);
+      if (written < 0)
+      {
+         if (errno == EINTR)
+         {
+            continue;
+         }
+         pgmoneta_log_error("Could not write %s: %s", di->file->path, strerror(errno));
+         return 1;
+      }
+
+      total += written;
+      di->received += written;
+   }
+
+   return 0;
+}
+
+static void
+do_download(struct worker_common* wc)
+{
+   bool success = false;
+   struct download_input* di = (struct download_input*)wc;
+
+   di->fd = open(di->file->path, O_WRONLY | O_CREAT, 0600);
+   if (di->fd == -1)
+   {
+      pgmoneta_log_error("%s: Could not open %s: %s", di->engine->name, di->file->path, strerror(errno));
+      goto done;
+   }
+
+   for (int attempt = 1; !success && attempt <= DOWNLOAD_RETRIES; attempt++)
+   {
+      if (!download_part(di))
+      {
+         success = true;
+      }
+      else
+      {
+         pgmoneta_log_debug("%s: Download of %s at %" PRIu64 " failed (%d/%d)", di->engine->name,
+                            di->file->key, di->offset, attempt, DOWNLOAD_RETRIES);
+      }
+   }
+
+   close(di->fd);
+   di->fd = -1;
+
+done:
+
+   if (!success)
+   {
+      pgmoneta_log_error("%s: Could not download %s", di->engine->name, di->file->key);
+      atomic_store(&di->file->failed, true);
+   }
+
+   /* The last part to finish verifies the whole file */
+   if (atomic_fetch_sub(&di->file->remaining, 1) == 1 && !atomic_load(&di->file->failed))
+   {
+      if (verify_file(di->file))
+      {
+         atomic_store(&di->file->failed, true);
+      }
+   }
+
+   if (atomic_load(&di->file->failed) && wc->workers != NULL)
+   {
+      wc->workers->outcome = false;
+   }
+}
+
+static int
+download_part(struct download_input* di)
+{
+   int status_code = 0;
+   uint64_t expected = 0;
+   struct http* connection = NULL;
+   struct http_request* request = NULL;
+
+   di->received = 0;
+
+   if (di->engine->get(di->engine, di->file->key, di->offset, di->length, &connection, &request))
+   {
+      goto error;
+   }
+
+   if (pgmoneta_http_invoke_stream(connection, request, download_sink, di, &status_code))
+   {
+      goto error;
+   }
+
+   if (status_code != 200 && status_code != 206)
+   {
+      pgmoneta_log_error("%s: Download of %s failed with status code %d", di->engine->name, di->file->key, status_code);
+      goto error;
+   }
+
+   expected = di->length > 0 ? di->length : di->file->size;
+   if (di->received != expected)
+   {
+      pgmoneta_log_error("%s: Received %" PRIu64 " of %" PRIu64 " bytes for %s", di->engine->name,
+                         di->received, expected, di->file->key);
+      goto error;
+   }
+
+   pgmoneta_http_request_destroy(request);
+   pgmoneta_http_destroy(connection);
+
+   return 0;
+
+error:
+
+   pgmoneta_http_request_destroy(request);
+   pgmoneta_http_destroy(connection);
+
+   return 1;
+}
+
+static int
+verify_file(struct download_file* file)
+{
+   char* actual = NULL;
+
+   if (file->sha256 == NULL)
+   {
+      return 0;
+   }
+
+   if (pgmoneta_create_sha256_file(file->path, &actual))
+   {
+      pgmoneta_log_error("Could not create hash for %s", file->path);
+      goto error;
+   }
+
+   if (strcmp(actual, file->sha256))
+   {
+      pgmoneta_log_error("Checksum mismatch for %s (expected %s, got %s)", file->key, file->sha256, actual);
+      goto error;
+   }
+
+   free(actual);
+
+   return 0;
+
+error:
+
+   free(actual);
+
+   return 1;
+}
+
+static int
+read_sha256(char* path, struct art* sha256)
+{
+   char line[MAX_PATH + 128];
+   char* colon = NULL;
+   FILE* file = NULL;
+
+   file = fopen(path, "r");
+   if (file == NULL)
+   {
+      goto error;
+   }
+
+   while (fgets(line, sizeof(line), file) != NULL)
+   {
+      line[strcspn(line, "\r\n")] = '\0';
+
+      colon = strrchr(line, ':');
+      if (colon == NULL)
+      {
+         continue;
+      }
+
+      *colon = '\0';
+
+      if (pgmoneta_art_insert(sha256, line, (uintptr_t)(colon + 1), ValueString))
+      {
+         goto error;
+      }
+   }
+
+   fclose(file);
+
+   return 0;
+
+error:
+
+   if (file != NULL)
+   {
+      fclose(file);
+   }
+
+   return 1;
+}
+
+static bool
+is_last_file(char* key)
+{
+   return strstr(key, "global/pg_control") != NULL || strstr(key, "backup_label") != NULL;
+}
+
+static int
+compare_files(const void* a, const void* b)
+{
+   struct download_file* fa = *(struct download_file**)a;
+   struct download_file* fb = *(struct download_file**)b;
+
+   if (fa->last != fb->last)
+   {
+      return fa->last ? 1 : -1;
+   }
+
+   /* Start the biggest files first to shorten the tail */
+   if (fa->size != fb->size)
+   {
+      return fa->size < fb->size ? 1 : -1;
+   }
+
+   return strcmp(fa->key, fb->key);
+}
@@ -29,6 +29,7 @@
 /* pgmoneta */
 #include <pgmoneta.h>
 #include <gzip_compression.h>
+#include <instrument.h>
 #include <logging.h>
 #include <management.h>
 #include <utils.h>
@@ -176,6 +177,7 @@ do_gz_compress(struct worker_common* wc)
       else
       {
          pgmoneta_delete_file(wi->from, NULL);
+         pgmoneta_instrument_files(1);
       }
    }
 
@@ -835,6 +837,7 @@ do_gz_decompress(struct worker_common* wc)
       else
       {
          pgmoneta_delete_file(wi->from, NULL);
+         pgmoneta_instrument_files(1);
       }
    }
 
@@ -45,6 +45,25 @@ static int http_parse_response(char* response, struct http_response* http_respon
 static int http_build_request(struct http* connection, struct http_request* request, char** full_request, size_t* full_request_size);
 static char* http_method_to_string(int method);
 
+#define HTTP_STREAM_BUFFER_SIZE 65536
+
+/** @struct http_stream
+ * Defines a buffered reader for a HTTP response
+ */
+struct http_stream
+{
+   SSL* ssl;                                /**< The SSL connection */
+   int socket;                              /**< The socket */
+   char buffer[HTTP_STREAM_BUFFER_SIZE];    /**< The buffer */
+   size_t offset;                           /**< The offset of the unread data */
+   size_t length;                           /**< The length of the buffered data */
+};
+
+static ssize_t http_stream_fill(struct http_stream* stream);
+static int http_stream_line(struct http_stream* stream, char* line, size_t size);
+static int http_stream_body(struct http_stream* stream, uint64_t size, bool eof,
+                            int (*sink)(void* arg, void* data, size_t size), void* arg);
+
 int
 pgmoneta_http_create(char* hostname, int port, bool secure, struct http** result)
 {
@@ -454,6 +473,265 @@ error:
    return PGMONETA_HTTP_STATUS_ERROR;
 }
 
+int
+pgmoneta_http_invoke_stream(struct http* connection, struct http_request* request,
+                            int (*sink)(void* arg, void* data, size_t size), void* arg,
+                            int* status_code)
+{
+   struct message* msg_request = NULL;
+   struct http_stream* stream = NULL;
+   char* full_request = NULL;
+   size_t full_request_size = 0;
+   char line[8192];
+   bool chunked = false;
+   bool has_length = false;
+   uint64_t content_length = 0;
+   int (*s)(void* arg, void* data, size_t size) = NULL;
+   int error = 0;
+   int status;
+
+   if (connection == NULL || request == NULL || status_code == NULL)
+   {
+      pgmoneta_log_error("Invalid parameters for HTTP invoke");
+      goto error;
+   }
+
+   *status_code = 0;
+
+   if (http_build_request(connection, request, &full_request, &full_request_size))
+   {
+      pgmoneta_log_error("Failed to build HTTP request");
+      goto error;
+   }
+
+   msg_request = (struct message*)malloc(sizeof(struct message));
+   stream = (struct http_stream*)malloc(sizeof(struct http_stream));
+   if (msg_request == NULL || stream == NULL)
+   {
+      pgmoneta_log_error("Failed to allocate HTTP stream");
+      goto error;
+   }
+
+   memset(msg_request, 0, sizeof(struct message));
+   msg_request->data = full_request;
+   msg_request->length = full_request_size;
+
+   memset(stream, 0, sizeof(struct http_stream));
+   stream->ssl = connection->ssl;
+   stream->socket = connection->socket;
+
+   error = 0;
+req:
+   if (error < 5)
+   {
+      status = pgmoneta_write_message(connection->ssl, connection->socket, msg_request);
+      if (status != MESSAGE_STATUS_OK)
+      {
+         error++;
+         pgmoneta_log_debug("Write failed, retrying (%d/5)", error);
+         goto req;
+      }
+   }
+   else
+   {
+      pgmoneta_log_error("Failed to write after 5 attempts");
+      goto error;
+   }
+
+   /* Status line, skipping any 100 Continue */
+   do
+   {
+      if (http_stream_line(stream, line, sizeof(line)))
+      {
+         pgmoneta_log_error("Failed to read HTTP status line");
+         goto error;
+      }
+
+      if (sscanf(line, "HTTP/1.%*d %d", status_code) != 1)
+      {
+         pgmoneta_log_error("Failed to parse HTTP status code");
+         goto error;
+      }
+
+      while (true)
+      {
+         if (http_stream_line(stream, line, sizeof(line)))
+         {
+            pgmoneta_log_error("Failed to read HTTP headers");
+            goto error;
+         }
+
+         if (strlen(line) == 0)
+         {
+            break;
+         }
+
+         if (!strncasecmp(line, "Content-Length:", strlen("Content-Length:")))
+         {
+            content_length = strtoull(line + strlen("Content-Length:"), NULL, 10);
+            has_length = true;
+         }
+         else if (!strncasecmp(line, "Transfer-Encoding:", strlen("Transfer-Encoding:")) &&
+                  strcasestr(line, "chunked") != NULL)
+         {
+            chunked = true;
+         }
+      }
+   }
+   while (*status_code == 100);
+
+   if (*status_code >= 200 && *status_code < 300)
+   {
+      s = sink;
+   }
+
+   if (chunked)
+   {
+      while (true)
+      {
+         uint64_t chunk;
+
+         if (http_stream_line(stream, line, sizeof(line)))
+         {
+            pgmoneta_log_error("Failed to read HTTP chunk size");
+            goto error;
+         }
+
+         chunk = strtoull(line, NULL, 16);
+         if (chunk == 0)
+         {
+            break;
+         }
+
+         if (http_stream_body(stream, chunk, false, s, arg))
+         {
+            goto error;
+         }
+
+         if (http_stream_line(stream, line, sizeof(line)))
+         {
+            pgmoneta_log_error("Failed to read HTTP chunk trailer");
+            goto error;
+         }
+      }
+   }
+   else if (has_length)
+   {
+      if (http_stream_body(stream, content_length, false, s, arg))
+      {
+         goto error;
+      }
+   }
+   else if (request->method != PGMONETA_HTTP_HEAD && *status_code != 204 && *status_code != 304)
+   {
+      if (http_stream_body(stream, 0, true, s, arg))
+      {
+         goto error;
+      }
+   }
+
+   free(full_request);
+   free(msg_request);
+   free(stream);
+
+   return PGMONETA_HTTP_STATUS_OK;
+
+error:
+   free(full_request);
+   free(msg_request);
+   free(stream);
+
+   return PGMONETA_HTTP_STATUS_ERROR;
+}
+
+int
+pgmoneta_http_parse_endpoint(char* endpoint, char** host, int* port, bool* secure)
+{
+   char* h = NULL;
+   char* colon = NULL;
+   char* slash = NULL;
+
+   *host = NULL;
+   *port = 443;
+   *secure = true;
+
+   if (endpoint == NULL || strlen(endpoint) == 0)
+   {
+      goto error;
+   }
+
+   if (!strncmp(endpoint, "http://", strlen("http://")))
+   {
+      *secure = false;
+      *port = 80;
+      endpoint += strlen("http://");
+   }
+   else if (!strncmp(endpoint, "https://", strlen("https://")))
+   {
+      endpoint += strlen("https://");
+   }
+
+   h = strdup(endpoint);
+   if (h == NULL)
+   {
+      goto error;
+   }
+
+   slash = strchr(h, '/');
+   if (slash != NULL)
+   {
+      *slash = '\0';
+   }
+
+   colon = strrchr(h, ':');
+   if (colon != NULL)
+   {
+      *colon = '\0';
+      *port = atoi(colon + 1);
+   }
+
+   if (strlen(h) == 0 || *port <= 0)
+   {
+      goto error;
+   }
+
+   *host = h;
+
+   return PGMONETA_HTTP_STATUS_OK;
+
+error:
+   free(h);
+
+   return PGMONETA_HTTP_STATUS_ERROR;
+}
+
+char*
+pgmoneta_http_uri_encode(char* s)
+{
+   char hex[4];
+   char* encoded = NULL;
+
+   encoded = pgmoneta_append(encoded, "");
+
+   for (size_t i = 0; i < strlen(s); i++)
+   {
+      unsigned char c = (unsigned char)s[i];
+
+      if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') ||
+          c == '-' || c == '_' || c == '.' || c == '~')
+      {
+         encoded = pgmoneta_append_char(encoded, (char)c);
+      }
+      else
+      {
+         snprintf(hex, sizeof(hex), "%%%02X", c);
+         encoded = pgmoneta_append(encoded, hex);
+      }
+   }
+
+   return encoded;
+}
+
 int
 pgmoneta_http_request_destroy(struct http_request* request)
 {
@@ -772,6 +1050,138 @@ error:
    return PGMONETA_HTTP_STATUS_ERROR;
 }
 
+static ssize_t
+http_stream_fill(struct http_stream* stream)
+{
+   ssize_t bytes_read;
+
+   if (stream->offset > 0)
+   {
+      memmove(stream->buffer, stream->buffer + stream->offset, stream->length - stream->offset);
+      stream->length -= stream->offset;
+      stream->offset = 0;
+   }
+
+   if (stream->length == sizeof(stream->buffer))
+   {
+      return -1;
+   }
+
+   while (true)
+   {
+      if (stream->ssl != NULL)
+      {
+         bytes_read = SSL_read(stream->ssl, stream->buffer + stream->length, sizeof(stream->buffer) - stream->length);
+         if (bytes_read <= 0)
+         {
+            int err = SSL_get_error(stream->ssl, bytes_read);
+            if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE)
+            {
+               continue;
+            }
+            return err == SSL_ERROR_ZERO_RETURN ? 0 : -1;
+         }
+      }
+      else
+      {
+         bytes_read = read(stream->socket, stream->buffer + stream->length, sizeof(stream->buffer) - stream->length);
+         if (bytes_read < 0)
+         {
+            if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+               continue;
+            }
+            return -1;
+         }
+      }
+
+      break;
+   }
+
+   stream->length += bytes_read;
+
+   return bytes_read;
+}
+
+static int
+http_stream_line(struct http_stream* stream, char* line, size_t size)
+{
+   char* eol = NULL;
+   size_t length;
+
+   while ((eol = memchr(stream->buffer + stream->offset, '\n', stream->length - stream->offset)) == NULL)
+   {
+      if (http_stream_fill(stream) <= 0)
+      {
+         return 1;
+      }
+   }
+
+   length = eol - (stream->buffer + stream->offset);
+   if (length > 0 && *(eol - 1) == '\r')
+   {
+      length--;
+   }
+
+   if (length >= size)
+   {
+      return 1;
+   }
+
+   memcpy(line, stream->buffer + stream->offset, length);
+   line[length] = '\0';
+
+   stream->offset = (eol - stream->buffer) + 1;
+
+   return 0;
+}
+
+static int
+http_stream_body(struct http_stream* stream, uint64_t size, bool eof,
+                 int (*sink)(void* arg, void* data, size_t size), void* arg)
+{
+   size_t available;
+   ssize_t bytes_read;
+
+   while (eof || size > 0)
+   {
+      available = stream->length - stream->offset;
+
+      if (available == 0)
+      {
+         bytes_read = http_stream_fill(stream);
+         if (bytes_read == 0 && eof)
+         {
+            break;
+         }
+         else if (bytes_read <= 0)
+         {
+            pgmoneta_log_error("Failed to read HTTP response body");
+            return 1;
+         }
+         continue;
+      }
+
+      if (!eof && available > size)
+      {
+         available = size;
+      }
+
+      if (sink != NULL && sink(arg, stream->buffer + stream->offset, available))
+      {
+         return 1;
+      }
+
+      stream->offset += available;
+      if (!eof)
+      {
+         size -= available;
+      }
+   }
+
+   return 0;
+}
+
 static char*
 http_method_to_string(int method)
 {
@@ -783,6 +1193,8 @@ http_method_to_string(int method)
          return "POST";
       case PGMONETA_HTTP_PUT:
          return "PUT";
+      case PGMONETA_HTTP_HEAD:
+         return "HEAD";
       default:
          return NULL;
    }
@@ -30,6 +30,7 @@
 #include <assert.h>
 #include <pgmoneta.h>
 #include <backup.h>
+#include <catalog.h>
 #include <info.h>
 #include <logging.h>
 #include <management.h>
@@ -41,6 +42,7 @@
 
 /* system */
 #include <errno.h>
+#include <inttypes.h>
 #include <libgen.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -58,9 +60,6 @@
 static void __attribute__((unused))
 create_info(char* directory, char* label, int status);
 
-static int
-file_final_name(char* file, int encryption, int compression, char** finalname);
-
 /**
  * Best effort to split a file path into a relative path and a bare file name
  * a wrapper around `dirname()`
@@ -361,7 +360,10 @@ pgmoneta_load_infos(char* directory, int* number_of_backups, struct backup*** ba
    *number_of_backups = 0;
    *backups = NULL;
 
-   pgmoneta_get_directories(directory, &number_of_bcks, &dirs);
+   if (pgmoneta_catalog_labels(pgmoneta_catalog_server(directory), &number_of_bcks, &dirs))
+   {
+      pgmoneta_get_directories(directory, &number_of_bcks, &dirs);
+   }
 
    if (number_of_bcks > 0)
    {
@@ -433,6 +435,7 @@ pgmoneta_load_info(char* directory, char* identifier, struct backup** backup)
    char buffer[INFO_BUFFER_SIZE];
    FILE* file = NULL;
    int tbl_idx = 0;
+   int phase_idx = 0;
    struct backup* bck = NULL;
    int number_of_backups = 0;
    struct backup** backups = NULL;
@@ -450,32 +453,62 @@ pgmoneta_load_info(char* directory, char* identifier, struct backup** backup)
    {
       int number_of_backups = 0;
       struct backup** backups = NULL;
+      int number_of_labels = 0;
+      char** labels = NULL;
 
-      if (pgmoneta_load_infos(directory, &number_of_backups, &backups))
+      if (!pgmoneta_catalog_labels(pgmoneta_catalog_server(directory), &number_of_labels, &labels))
       {
-         goto error;
-      }
+         if (number_of_labels > 0)
+         {
+            if (!strcmp(identifier, "oldest"))
+            {
+               label = pgmoneta_append(label, labels[0]);
+            }
+            else
+            {
+               label = pgmoneta_append(label, labels[number_of_labels - 1]);
+            }
+         }
 
-      if (number_of_backups == 0)
-      {
-         goto error;
-      }
+         for (int i = 0; i < number_of_labels; i++)
+         {
+            free(labels[i]);
+         }
+         free(labels);
 
-      if (!strcmp(identifier, "oldest"))
-      {
-         label = pgmoneta_append(label, backups[0]->label);
+         if (label == NULL)
+         {
+            goto error;
+         }
       }
-      else if (!strcmp(identifier, "latest") || !strcmp(identifier, "newest"))
+      else
       {
-         label = pgmoneta_append(label, backups[number_of_backups - 1]->label);
-      }
+         if (pgmoneta_load_infos(directory, &number_of_backups, &backups))
+         {
+            goto error;
+         }
 
-      for (int i = 0; i < number_of_backups; i++)
-      {
-         free(backups[i]);
+         if (number_of_backups == 0)
+         {
+            goto error;
+         }
+
+         if (!strcmp(identifier, "oldest"))
+         {
+            label = pgmoneta_append(label, backups[0]->label);
+         }
+         else if (!strcmp(identifier, "latest") || !strcmp(identifier, "newest"))
+         {
+            label = pgmoneta_append(label, backups[number_of_backups - 1]->label);
+         }
+
+         for (int i = 0; i < number_of_backups; i++)
+         {
+            free(backups[i]);
+         }
+         free(backups);
+         backups = NULL;
       }
-      free(backups);
-      backups = NULL;
    }
    else
    {
@@ -695,6 +728,30 @@ pgmoneta_load_info(char* directory, char* identifier, struct backup** backup)
          {
             memcpy(&bck->parent_label[0], &value[0], strlen(&value[0]));
          }
+         else if (pgmoneta_starts_with(&key[0], INFO_PASSTHROUGH))
+         {
+            bck->passthrough = atoi(&value[0]) == 1 ? true : false;
+         }
+         else if (pgmoneta_starts_with(&key[0], INFO_PHASE_METRICS))
+         {
+            phase_idx = atoi(&key[strlen(INFO_PHASE_METRICS)]) - 1;
+            if (phase_idx >= 0 && phase_idx < NUMBER_OF_PHASES)
+            {
+               sscanf(&value[0], "%lf,%lf,%lf,%" SCNu64 ",%" SCNu64 ",%" SCNu64,
+                      &bck->phases[phase_idx].elapsed_time, &bck->phases[phase_idx].cpu_time,
+                      &bck->phases[phase_idx].wait_time, &bck->phases[phase_idx].bytes_in,
+                      &bck->phases[phase_idx].bytes_out, &bck->phases[phase_idx].files);
+            }
+         }
+         else if (pgmoneta_starts_with(&key[0], INFO_PHASE))
+         {
+            phase_idx = atoi(&key[strlen(INFO_PHASE)]) - 1;
+            if (phase_idx >= 0 && phase_idx < NUMBER_OF_PHASES)
+            {
+               memcpy(&bck->phases[phase_idx].name[0], &value[0], MIN(strlen(&value[0]), (size_t)MISC_LENGTH - 1));
+               bck->number_of_phases = MAX(bck->number_of_phases, phase_idx + 1);
+            }
+         }
       }
    }
 
@@ -761,6 +818,11 @@ pgmoneta_get_number_of_valid_backups(int server)
    struct backup** backups = NULL;
    int result = 0;
 
+   if (!pgmoneta_catalog_number_of_valid_backups(server, &result))
+   {
+      return result;
+   }
+
    server_path = pgmoneta_get_server_backup(server);
    if (server_path == NULL)
    {
@@ -841,6 +903,8 @@ error:
 int
 pgmoneta_get_backup_root(int server, struct backup* backup, struct backup** root)
 {
+   char* d = NULL;
+   char* r_identifier = NULL;
    struct backup* p = NULL;
    struct backup* bck = NULL;
 
@@ -856,6 +920,28 @@ pgmoneta_get_backup_root(int server, struct backup* backup, struct backup** root
       goto error;
    }
 
+   if (!pgmoneta_catalog_root(server, backup->label, &r_identifier) && r_identifier != NULL)
+   {
+      d = pgmoneta_get_server_backup(server);
+
+      if (!pgmoneta_load_info(d, r_identifier, &p) && p != NULL)
+      {
+         *root = p;
+
+         free(d);
+         free(r_identifier);
+
+         return 0;
+      }
+
+      free(p);
+      p = NULL;
+      free(d);
+      d = NULL;
+   }
+   free(r_identifier);
+   r_identifier = NULL;
+
    if (pgmoneta_get_backup_parent(server, backup, &p))
    {
       goto error;
@@ -899,16 +985,19 @@ pgmoneta_get_backup_child(int server, struct backup* backup, struct backup** chi
 
    d = pgmoneta_get_server_backup(server);
 
-   if (pgmoneta_load_infos(d, &number_of_backups, &backups))
+   if (pgmoneta_catalog_child(server, backup->label, &c_identifier))
    {
-      goto error;
-   }
+      if (pgmoneta_load_infos(d, &number_of_backups, &backups))
+      {
+         goto error;
+      }
 
-   for (int j = 0; c_identifier == NULL && j < number_of_backups; j++)
-   {
-      if (!strcmp(backup->label, backups[j]->parent_label))
+      for (int j = 0; c_identifier == NULL && j < number_of_backups; j++)
       {
-         c_identifier = pgmoneta_append(c_identifier, backups[j]->label);
+         if (!strcmp(backup->label, backups[j]->parent_label))
+         {
+            c_identifier = pgmoneta_append(c_identifier, backups[j]->label);
+         }
       }
    }
 
@@ -1412,8 +1501,17 @@ pgmoneta_save_info(char* directory, struct backup* backup)
    write_info(sfile, "%s=%u\n", INFO_END_TIMELINE, backup->end_timeline);
    write_info(sfile, "%s=%d\n", INFO_TYPE, backup->type);
    write_info(sfile, "%s=%s\n", INFO_PARENT, backup->parent_label);
+   write_info(sfile, "%s=%d\n", INFO_PASSTHROUGH, backup->passthrough ? 1 : 0);
    write_info(sfile, "%s=%s\n", INFO_COMMENTS, backup->comments);
 
+   for (int i = 0; i < backup->number_of_phases; i++)
+   {
+      write_info(sfile, "PHASE%d=%s\n", i + 1, backup->phases[i].name);
+      write_info(sfile, "PHASE_METRICS%d=%.4f,%.4f,%.4f,%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n", i + 1,
+                 backup->phases[i].elapsed_time, backup->phases[i].cpu_time, backup->phases[i].wait_time,
+                 backup->phases[i].bytes_in, backup->phases[i].bytes_out, backup->phases[i].files);
+   }
+
    memset(&buffer[0], 0, sizeof(buffer));
    snprintf(&buffer[0], sizeof(buffer), "%s=%.1024s\n", INFO_EXTRA, backup->extra);
    fputs(&buffer[0], sfile);
@@ -1428,6 +1526,8 @@ pgmoneta_save_info(char* directory, struct backup* backup)
    pgmoneta_log_trace("Updating SHA512 for %s", bck_root_dir);
    pgmoneta_update_sha512(bck_root_dir, "backup.info");
 
+   pgmoneta_catalog_update(directory, backup);
+
    free(bck_root_dir);
    free(bck_info_file);
    return 0;
@@ -1468,7 +1568,7 @@ pgmoneta_rfile_create(int server, char* label, char* relative_dir, char* base_fi
    {
       free(extracted_file_path);
       extracted_file_path = NULL;
-      file_final_name(base_relative_path, encryption, compression, &final_relative_path);
+      pgmoneta_backup_file_final_name(base_relative_path, encryption, compression, &final_relative_path);
       if (pgmoneta_extract_backup_file(server, label, final_relative_path, NULL, &extracted_file_path))
       {
          goto error;
@@ -1810,8 +1910,8 @@ error:
    return 1;
 }
 
-static int
-file_final_name(char* file, int encryption, int compression, char** finalname)
+int
+pgmoneta_backup_file_final_name(char* file, int encryption, int compression, char** finalname)
 {
    char* final = NULL;
 
@@ -0,0 +1,399 @@
+/*
+ * Copyright (C) 2025 The pgmoneta community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* pgmoneta */
+#include <pgmoneta.h>
+#include <instrument.h>
+#include <logging.h>
+#include <shmem.h>
+#include <utils.h>
+#include <workflow.h>
+
+/* system */
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+
+static const double buckets[NUMBER_OF_PHASE_BUCKETS - 1] = {0.01, 0.1, 0.5, 1.0, 5.0, 10.0, 30.0, 60.0, 300.0, 900.0, 3600.0};
+
+static atomic_ullong files_processed = 0;
+
+static double cpu_time(void);
+static void io_bytes(uint64_t* in, uint64_t* out);
+static struct phase_metrics* phase_slot(int server, int type, char* name);
+static void histogram_observe(struct phase_histogram* h, double seconds);
+
+int
+pgmoneta_instrument_init(size_t* size, void** shmem_instrument)
+{
+   struct instrument* instrument = NULL;
+   size_t s = 0;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   *size = 0;
+   *shmem_instrument = NULL;
+
+   s = sizeof(struct instrument);
+
+   if (pgmoneta_create_shared_memory(s, config->hugepage, (void**)&instrument))
+   {
+      goto error;
+   }
+
+   memset(instrument, 0, s);
+   atomic_init(&instrument->lock, STATE_FREE);
+
+   for (int i = 0; i < NUMBER_OF_SERVERS; i++)
+   {
+      for (int j = 0; j < NUMBER_OF_PHASE_SLOTS; j++)
+      {
+         atomic_init(&instrument->phases[i][j].state, PHASE_SLOT_FREE);
+      }
+   }
+
+   *size = s;
+   *shmem_instrument = instrument;
+
+   return 0;
+
+error:
+
+   pgmoneta_log_error("Cannot allocate shared memory for the instrumentation");
+
+   return 1;
+}
+
+void
+pgmoneta_instrument_begin(struct instrument_sample* sample)
+{
+   memset(sample, 0, sizeof(struct instrument_sample));
+
+#ifdef HAVE_FREEBSD
+   clock_gettime(CLOCK_MONOTONIC_FAST, &sample->start);
+#else
+   clock_gettime(CLOCK_MONOTONIC_RAW, &sample->start);
+#endif
+
+   sample->cpu = cpu_time();
+   io_bytes(&sample->bytes_in, &sample->bytes_out);
+   sample->files = atomic_load(&files_processed);
+}
+
+void
+pgmoneta_instrument_end(int server, int type, char* name, struct instrument_sample* sample, struct backup_phase* phase)
+{
+   struct timespec end_t;
+   double elapsed;
+   double cpu;
+   double wait;
+   uint64_t bytes_in = 0;
+   uint64_t bytes_out = 0;
+   uint64_t files;
+   struct phase_metrics* pm = NULL;
+
+#ifdef HAVE_FREEBSD
+   clock_gettime(CLOCK_MONOTONIC_FAST, &end_t);
+#else
+   clock_gettime(CLOCK_MONOTONIC_RAW, &end_t);
+#endif
+
+   elapsed = pgmoneta_compute_duration(sample->start, end_t);
+   cpu = MAX(cpu_time() - sample->cpu, 0.0);
+   /* Workers may run on several CPUs at once, so the waiting can't be negative */
+   wait = MAX(elapsed - cpu, 0.0);
+   io_bytes(&bytes_in, &bytes_out);
+   bytes_in = bytes_in >= sample->bytes_in ? bytes_in - sample->bytes_in : 0;
+   bytes_out = bytes_out >= sample->bytes_out ? bytes_out - sample->bytes_out : 0;
+   files = atomic_load(&files_processed) - sample->files;
+
+   pgmoneta_log_debug("%s: Elapsed %.4f, CPU %.4f, Wait %.4f, In %" PRIu64 ", Out %" PRIu64 ", Files %" PRIu64,
+                      name, elapsed, cpu, wait, bytes_in, bytes_out, files);
+
+   if (phase != NULL)
+   {
+      memset(phase, 0, sizeof(struct backup_phase));
+      memcpy(&phase->name[0], name, MIN(strlen(name), (size_t)MISC_LENGTH - 1));
+      phase->elapsed_time = elapsed;
+      phase->cpu_time = cpu;
+      phase->wait_time = wait;
+      phase->bytes_in = bytes_in;
+      phase->bytes_out = bytes_out;
+      phase->files = files;
+   }
+
+   pm = phase_slot(server, type, name);
+   if (pm != NULL)
+   {
+      histogram_observe(&pm->elapsed, elapsed);
+      histogram_observe(&pm->cpu, cpu);
+      histogram_observe(&pm->wait, wait);
+      atomic_fetch_add(&pm->bytes_in, bytes_in);
+      atomic_fetch_add(&pm->bytes_out, bytes_out);
+      atomic_fetch_add(&pm->files, files);
+   }
+}
+
+void
+pgmoneta_instrument_files(uint64_t files)
+{
+   atomic_fetch_add(&files_processed, files);
+}
+
+double
+pgmoneta_instrument_bucket(int index)
+{
+   if (index < 0 || index >= NUMBER_OF_PHASE_BUCKETS - 1)
+   {
+      return -1.0;
+   }
+
+   return buckets[index];
+}
+
+char*
+pgmoneta_instrument_workflow(int type)
+{
+   switch (type)
+   {
+      case WORKFLOW_TYPE_BACKUP:
+         return "backup";
+      case WORKFLOW_TYPE_RESTORE:
+         return "restore";
+      case WORKFLOW_TYPE_ARCHIVE:
+         return "archive";
+      case WORKFLOW_TYPE_DELETE_BACKUP:
+         return "delete";
+      case WORKFLOW_TYPE_RETENTION:
+         return "retention";
+      case WORKFLOW_TYPE_WAL_SHIPPING:
+         return "wal_shipping";
+      case WORKFLOW_TYPE_VERIFY:
+         return "verify";
+      case WORKFLOW_TYPE_INCREMENTAL_BACKUP:
+         return "incremental_backup";
+      case WORKFLOW_TYPE_COMBINE:
+      case WORKFLOW_TYPE_COMBINE_AS_IS:
+         return "combine";
+      case WORKFLOW_TYPE_POST_ROLLUP:
+         return "rollup";
+      default:
+         break;
+   }
+
+   return "unknown";
+}
+
+void
+pgmoneta_instrument_reset(void)
+{
+   struct instrument* instrument = NULL;
+   struct phase_metrics* pm = NULL;
+
+   instrument = (struct instrument*)instrument_shmem;
+
+   if (instrument == NULL)
+   {
+      return;
+   }
+
+   for (int i = 0; i < NUMBER_OF_SERVERS; i++)
+   {
+      for (int j = 0; j < NUMBER_OF_PHASE_SLOTS; j++)
+      {
+         pm = &instrument->phases[i][j];
+
+         for (int k = 0; k < NUMBER_OF_PHASE_BUCKETS; k++)
+         {
+            atomic_store(&pm->elapsed.buckets[k], 0);
+            atomic_store(&pm->cpu.buckets[k], 0);
+            atomic_store(&pm->wait.buckets[k], 0);
+         }
+
+         atomic_store(&pm->elapsed.count, 0);
+         atomic_store(&pm->elapsed.sum, 0);
+         atomic_store(&pm->cpu.count, 0);
+         atomic_store(&pm->cpu.sum, 0);
+         atomic_store(&pm->wait.count, 0);
+         atomic_store(&pm->wait.sum, 0);
+         atomic_store(&pm->bytes_in, 0);
+         atomic_store(&pm->bytes_out, 0);
+         atomic_store(&pm->files, 0);
+      }
+   }
+}
+
+static double
+cpu_time(void)
+{
+   double t = 0.0;
+   struct rusage ru;
+
+   /* Workers are threads, and helper processes are reaped, so both are included */
+   if (!getrusage(RUSAGE_SELF, &ru))
+   {
+      t += ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6;
+      t += ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+   }
+
+   if (!getrusage(RUSAGE_CHILDREN, &ru))
+   {
+      t += ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6;
+      t += ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+   }
+
+   return t;
+}
+
+static void
+io_bytes(uint64_t* in, uint64_t* out)
+{
+#if defined(HAVE_LINUX)
+   char line[MISC_LENGTH];
+   unsigned long long value;
+   FILE* file = NULL;
+
+   *in = 0;
+   *out = 0;
+
+   /* The bytes passed to read(2) and write(2), for both files and sockets */
+   file = fopen("/proc/self/io", "r");
+   if (file != NULL)
+   {
+      while (fgets(&line[0], sizeof(line), file) != NULL)
+      {
+         if (sscanf(&line[0], "rchar: %llu", &value) == 1)
+         {
+            *in = value;
+         }
+         else if (sscanf(&line[0], "wchar: %llu", &value) == 1)
+         {
+            *out = value;
+         }
+      }
+
+      fclose(file);
+   }
+#else
+   struct rusage ru;
+
+   *in = 0;
+   *out = 0;
+
+   /* Only block operations are known, so count them as 512 byte blocks */
+   if (!getrusage(RUSAGE_SELF, &ru))
+   {
+      *in = (uint64_t)ru.ru_inblock * 512;
+      *out = (uint64_t)ru.ru_oublock * 512;
+   }
+#endif
+}
+
+static struct phase_metrics*
+phase_slot(int server, int type, char* name)
+{
+   signed char free_state;
+   struct phase_metrics* pm = NULL;
+   struct instrument* instrument = NULL;
+
+   instrument = (struct instrument*)instrument_shmem;
+
+   if (instrument == NULL || server < 0 || server >= NUMBER_OF_SERVERS || name == NULL)
+   {
+      return NULL;
+   }
+
+   for (int i = 0; i < NUMBER_OF_PHASE_SLOTS; i++)
+   {
+      pm = &instrument->phases[server][i];
+
+      if (atomic_load(&pm->state) == PHASE_SLOT_READY && pm->type == type && !strcmp(pm->name, name))
+      {
+         return pm;
+      }
+   }
+
+   /* Claim a new slot under the lock, so a step only gets one slot */
+retry:
+   free_state = STATE_FREE;
+   if (!atomic_compare_exchange_strong(&instrument->lock, &free_state, STATE_IN_USE))
+   {
+      SLEEP_AND_GOTO(1000000L, retry);
+   }
+
+   pm = NULL;
+   for (int i = 0; pm == NULL && i < NUMBER_OF_PHASE_SLOTS; i++)
+   {
+      struct phase_metrics* p = &instrument->phases[server][i];
+      signed char state = atomic_load(&p->state);
+
+      if (state == PHASE_SLOT_READY && p->type == type && !strcmp(p->name, name))
+      {
+         pm = p;
+      }
+      else if (state == PHASE_SLOT_FREE)
+      {
+         free_state = PHASE_SLOT_FREE;
+         if (atomic_compare_exchange_strong(&p->state, &free_state, PHASE_SLOT_CLAIMED))
+         {
+            p->type = type;
+            memset(&p->name[0], 0, MISC_LENGTH);
+            memcpy(&p->name[0], name, MIN(strlen(name), (size_t)MISC_LENGTH - 1));
+            atomic_store(&p->state, PHASE_SLOT_READY);
+            pm = p;
+         }
+      }
+   }
+
+   atomic_store(&instrument->lock, STATE_FREE);
+
+   return pm;
+}
+
+static void
+histogram_observe(struct phase_histogram* h, double seconds)
+{
+   int bucket = NUMBER_OF_PHASE_BUCKETS - 1;
+
+   for (int i = 0; i < NUMBER_OF_PHASE_BUCKETS - 1; i++)
+   {
+      if (seconds <= buckets[i])
+      {
+         bucket = i;
+         break;
+      }
+   }
+
+   atomic_fetch_add(&h->buckets[bucket], 1);
+   atomic_fetch_add(&h->count, 1);
+   atomic_fetch_add(&h->sum, (unsigned long long)(seconds * 1e6));
+}
@@ -0,0 +1,935 @@
+/*
+ * Copyright (C) 2025 The pgmoneta community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* pgmoneta */
+#include <pgmoneta.h>
+#include <job.h>
+#include <logging.h>
+#include <management.h>
+#include <network.h>
+#include <shmem.h>
+#include <utils.h>
+
+/* system */
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NAME "job"
+
+static struct job* current = NULL;
+
+static void jobs_lock(struct jobs* jobs);
+static void jobs_unlock(struct jobs* jobs);
+static struct job* job_submit(struct jobs* jobs, int server, int32_t command, int32_t priority);
+static bool job_turn(struct jobs* jobs, struct job* job);
+static void job_reap(struct jobs* jobs);
+static void job_finish(struct job* job, int state);
+static struct job* job_find(struct jobs* jobs, uint64_t id);
+static bool job_done(int state);
+static char* job_state(int state);
+static char* job_command(int32_t command);
+static int job_json(struct job* job, struct json** json);
+
+int
+pgmoneta_job_init(size_t* size, void** shmem_jobs)
+{
+   struct jobs* jobs = NULL;
+   size_t s = 0;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   *size = 0;
+   *shmem_jobs = NULL;
+
+   s = sizeof(struct jobs);
+
+   if (pgmoneta_create_shared_memory(s, config->hugepage, (void**)&jobs))
+   {
+      goto error;
+   }
+
+   memset(jobs, 0, s);
+   atomic_init(&jobs->lock, STATE_FREE);
+   jobs->next_id = 0;
+
+   for (int i = 0; i < NUMBER_OF_JOBS; i++)
+   {
+      atomic_init(&jobs->jobs[i].state, JOB_STATE_FREE);
+      atomic_init(&jobs->jobs[i].cancel, false);
+      atomic_init(&jobs->jobs[i].bytes_done, 0);
+      atomic_init(&jobs->jobs[i].bytes_total, 0);
+      atomic_init(&jobs->jobs[i].files_done, 0);
+      atomic_init(&jobs->jobs[i].files_total, 0);
+   }
+
+   *size = s;
+   *shmem_jobs = jobs;
+
+   return 0;
+
+error:
+
+   pgmoneta_log_error("Cannot allocate shared memory for the jobs");
+
+   return 1;
+}
+
+void
+pgmoneta_job_schedule(int* client_fd, int server, int32_t command, uint8_t compression, uint8_t encryption, struct json* payload)
+{
+   bool async = false;
+   int32_t priority = 0;
+   int status = 0;
+   pid_t pid;
+   struct timespec start_t;
+   struct timespec end_t;
+   struct job* job = NULL;
+   struct jobs* jobs = NULL;
+   struct json* request = NULL;
+   struct json* reply = NULL;
+   struct json* response = NULL;
+   struct main_configuration* config;
+
+   pgmoneta_start_logging();
+
+   config = (struct main_configuration*)shmem;
+   jobs = (struct jobs*)jobs_shmem;
+
+#ifdef HAVE_FREEBSD
+   clock_gettime(CLOCK_MONOTONIC_FAST, &start_t);
+#else
+   clock_gettime(CLOCK_MONOTONIC_RAW, &start_t);
+#endif
+
+   request = (struct json*)pgmoneta_json_get(payload, MANAGEMENT_CATEGORY_REQUEST);
+   async = (bool)pgmoneta_json_get(request, MANAGEMENT_ARGUMENT_ASYNC);
+   priority = (int32_t)pgmoneta_json_get(request, MANAGEMENT_ARGUMENT_PRIORITY);
+
+   job = job_submit(jobs, server, command, priority);
+   if (job == NULL)
+   {
+      pgmoneta_management_response_error(NULL, *client_fd, config->common.servers[server].name, MANAGEMENT_ERROR_JOB_FULL, NAME, compression, encryption, payload);
+      pgmoneta_log_error("Job: No free job for %s (%d)", config->common.servers[server].name, MANAGEMENT_ERROR_JOB_FULL);
+      goto error;
+   }
+
+   pgmoneta_log_debug("Job: %" PRIu64 " %s/%s queued with priority %d", job->id, job_command(command),
+                      config->common.servers[server].name, priority);
+
+   if (async)
+   {
+      /* The command responds to its own copy of the payload */
+      if (pgmoneta_json_clone(payload, &reply) ||
+          pgmoneta_management_create_response(reply, server, &response))
+      {
+         pgmoneta_management_response_error(NULL, *client_fd, config->common.servers[server].name, MANAGEMENT_ERROR_ALLOCATION, NAME, compression, encryption, payload);
+         goto error;
+      }
+
+      pgmoneta_json_put(response, MANAGEMENT_ARGUMENT_JOB, (uintptr_t)job->id, ValueUInt64);
+      pgmoneta_json_put(response, MANAGEMENT_ARGUMENT_STATE, (uintptr_t)job_state(atomic_load(&job->state)), ValueString);
+
+#ifdef HAVE_FREEBSD
+      clock_gettime(CLOCK_MONOTONIC_FAST, &end_t);
+#else
+      clock_gettime(CLOCK_MONOTONIC_RAW, &end_t);
+#endif
+
+      if (pgmoneta_management_response_ok(NULL, *client_fd, start_t, end_t, compression, encryption, reply))
+      {
+         pgmoneta_log_warn("Job: Error sending response for %" PRIu64, job->id);
+      }
+
+      pgmoneta_json_destroy(reply);
+      reply = NULL;
+
+      /* The client is gone, so the response of the command is dropped */
+      pgmoneta_disconnect(*client_fd);
+      *client_fd = open("/dev/null", O_WRONLY);
+   }
+
+   while (!job_turn(jobs, job))
+   {
+      if (atomic_load(&job->cancel))
+      {
+         job_finish(job, JOB_STATE_CANCELLED);
+         pgmoneta_management_response_error(NULL, *client_fd, config->common.servers[server].name, MANAGEMENT_ERROR_JOB_CANCELLED, NAME, compression, encryption, payload);
+         pgmoneta_log_info("Job: %" PRIu64 " cancelled while queued", job->id);
+         job = NULL;
+         goto error;
+      }
+
+      /* Sleep for 100ms */
+      SLEEP(100000000L);
+   }
+
+   pgmoneta_log_debug("Job: %" PRIu64 " %s/%s started", job->id, job_command(command), config->common.servers[server].name);
+
+   current = job;
+
+   pid = fork();
+   if (pid == -1)
+   {
+      current = NULL;
+      pgmoneta_management_response_error(NULL, *client_fd, config->common.servers[server].name, MANAGEMENT_ERROR_JOB_NOFORK, NAME, compression, encryption, payload);
+      pgmoneta_log_error("Job: No fork %s (%d)", config->common.servers[server].name, MANAGEMENT_ERROR_JOB_NOFORK);
+      goto error;
+   }
+   else if (pid == 0)
+   {
+      /* The command starts its own logging */
+      pgmoneta_stop_logging();
+      return;
+   }
+
+   current = NULL;
+
+   while (waitpid(pid, &status, 0) == -1 && errno == EINTR)
+   {
+   }
+
+   if (atomic_load(&job->cancel))
+   {
+      job_finish(job, JOB_STATE_CANCELLED);
+   }
+   else if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+   {
+      job_finish(job, JOB_STATE_SUCCESS);
+   }
+   else
+   {
+      job_finish(job, JOB_STATE_FAILED);
+   }
+
+   pgmoneta_log_debug("Job: %" PRIu64 " %s/%s %s", job->id, job_command(command), config->common.servers[server].name,
+                      job_state(atomic_load(&job->state)));
+
+   pgmoneta_json_destroy(payload);
+
+   pgmoneta_disconnect(*client_fd);
+
+   pgmoneta_stop_logging();
+
+   exit(0);
+
+error:
+
+   if (job != NULL)
+   {
+      job_finish(job, JOB_STATE_FAILED);
+   }
+
+   pgmoneta_json_destroy(reply);
+   pgmoneta_json_destroy(payload);
+
+   pgmoneta_disconnect(*client_fd);
+
+   pgmoneta_stop_logging();
+
+   exit(1);
+}
+
+void
+pgmoneta_job_phase(char* phase)
+{
+   if (current == NULL || phase == NULL)
+   {
+      return;
+   }
+
+   memset(&current->phase[0], 0, MISC_LENGTH);
+   memcpy(&current->phase[0], phase, MIN(strlen(phase), (size_t)MISC_LENGTH - 1));
+}
+
+void
+pgmoneta_job_total(uint64_t bytes, uint64_t files)
+{
+   if (current == NULL)
+   {
+      return;
+   }
+
+   atomic_store(&current->bytes_total, bytes);
+   atomic_store(&current->files_total, files);
+}
+
+void
+pgmoneta_job_progress(uint64_t bytes, uint64_t files)
+{
+   if (current == NULL)
+   {
+      return;
+   }
+
+   if (bytes > 0)
+   {
+      atomic_fetch_add(&current->bytes_done, bytes);
+   }
+
+   if (files > 0)
+   {
+      atomic_fetch_add(&current->files_done, files);
+   }
+}
+
+bool
+pgmoneta_job_cancelled(void)
+{
+   return current != NULL && atomic_load(&current->cancel);
+}
+
+void
+pgmoneta_job_list(SSL* ssl, int client_fd, uint8_t compression, uint8_t encryption, struct json* payload)
+{
+   int n = 0;
+   int order[NUMBER_OF_JOBS];
+   struct timespec start_t;
+   struct timespec end_t;
+   struct jobs* jobs = NULL;
+   struct json* response = NULL;
+   struct json* list = NULL;
+
+   pgmoneta_start_logging();
+
+   jobs = (struct jobs*)jobs_shmem;
+
+#ifdef HAVE_FREEBSD
+   clock_gettime(CLOCK_MONOTONIC_FAST, &start_t);
+#else
+   clock_gettime(CLOCK_MONOTONIC_RAW, &start_t);
+#endif
+
+   if (pgmoneta_management_create_response(payload, -1, &response) || pgmoneta_json_create(&list))
+   {
+      pgmoneta_management_response_error(ssl, client_fd, NULL, MANAGEMENT_ERROR_ALLOCATION, NAME, compression, encryption, payload);
+      goto error;
+   }
+
+   jobs_lock(jobs);
+   job_reap(jobs);
+
+   /* Oldest first */
+   for (int i = 0; i < NUMBER_OF_JOBS; i++)
+   {
+      int j = n;
+
+      if (atomic_load(&jobs->jobs[i].state) == JOB_STATE_FREE)
+      {
+         continue;
+      }
+
+      while (j > 0 && jobs->jobs[order[j - 1]].id > jobs->jobs[i].id)
+      {
+         order[j] = order[j - 1];
+         j--;
+      }
+      order[j] = i;
+      n++;
+   }
+
+   for (int i = 0; i < n; i++)
+   {
+      struct json* j = NULL;
+
+      if (job_json(&jobs->jobs[order[i]], &j))
+      {
+         jobs_unlock(jobs);
+         pgmoneta_management_response_error(ssl, client_fd, NULL, MANAGEMENT_ERROR_ALLOCATION, NAME, compression, encryption, payload);
+         goto error;
+      }
+
+      pgmoneta_json_append(list, (uintptr_t)j, ValueJSON);
+   }
+
+   jobs_unlock(jobs);
+
+   pgmoneta_json_put(response, MANAGEMENT_ARGUMENT_JOBS, (uintptr_t)list, ValueJSON);
+   list = NULL;
+
+#ifdef HAVE_FREEBSD
+   clock_gettime(CLOCK_MONOTONIC_FAST, &end_t);
+#else
+   clock_gettime(CLOCK_MONOTONIC_RAW, &end_t);
+#endif
+
+   if (pgmoneta_management_response_ok(ssl, client_fd, start_t, end_t, compression, encryption, payload))
+   {
+      pgmoneta_management_response_error(ssl, client_fd, NULL, MANAGEMENT_ERROR_JOB_NETWORK, NAME, compression, encryption, payload);
+      pgmoneta_log_error("Job: Error sending response");
+      goto error;
+   }
+
+   pgmoneta_json_destroy(payload);
+
+   pgmoneta_disconnect(client_fd);
+
+   pgmoneta_stop_logging();
+
+   exit(0);
+
+error:
+
+   pgmoneta_json_destroy(list);
+   pgmoneta_json_destroy(payload);
+
+   pgmoneta_disconnect(client_fd);
+
+   pgmoneta_stop_logging();
+
+   exit(1);
+}
+
+void
+pgmoneta_job_cancel(SSL* ssl, int client_fd, uint8_t compression, uint8_t encryption, struct json* payload)
+{
+   uint64_t id = 0;
+   int state;
+   struct timespec start_t;
+   struct timespec end_t;
+   struct job* job = NULL;
+   struct jobs* jobs = NULL;
+   struct json* request = NULL;
+   struct json* response = NULL;
+   struct main_configuration* config;
+
+   pgmoneta_start_logging();
+
+   config = (struct main_configuration*)shmem;
+   jobs = (struct jobs*)jobs_shmem;
+
+#ifdef HAVE_FREEBSD
+   clock_gettime(CLOCK_MONOTONIC_FAST, &start_t);
+#else
+   clock_gettime(CLOCK_MONOTONIC_RAW, &start_t);
+#endif
+
+   request = (struct json*)pgmoneta_json_get(payload, MANAGEMENT_CATEGORY_REQUEST);
+   id = (uint64_t)pgmoneta_json_get(request, MANAGEMENT_ARGUMENT_JOB);
+
+   jobs_lock(jobs);
+   job_reap(jobs);
+
+   job = job_find(jobs, id);
+   if (job == NULL)
+   {
+      jobs_unlock(jobs);
+      pgmoneta_management_response_error(ssl, client_fd, NULL, MANAGEMENT_ERROR_JOB_NOJOB, NAME, compression, encryption, payload);
+      pgmoneta_log_warn("Job: No job %" PRIu64 " (%d)", id, MANAGEMENT_ERROR_JOB_NOJOB);
+      goto error;
+   }
+
+   state = atomic_load(&job->state);
+   if (job_done(state))
+   {
+      jobs_unlock(jobs);
+      pgmoneta_management_response_error(ssl, client_fd, config->common.servers[job->server].name, MANAGEMENT_ERROR_JOB_ERROR, NAME, compression, encryption, payload);
+      pgmoneta_log_warn("Job: %" PRIu64 " is %s (%d)", id, job_state(state), MANAGEMENT_ERROR_JOB_ERROR);
+      goto error;
+   }
+
+   /* A running command stops at its next workflow step */
+   atomic_store(&job->cancel, true);
+
+   if (pgmoneta_management_create_response(payload, job->server, &response))
+   {
+      jobs_unlock(jobs);
+      pgmoneta_management_response_error(ssl, client_fd, NULL, MANAGEMENT_ERROR_ALLOCATION, NAME, compression, encryption, payload);
+      goto error;
+   }
+
+   pgmoneta_json_put(response, MANAGEMENT_ARGUMENT_JOB, (uintptr_t)job->id, ValueUInt64);
+   pgmoneta_json_put(response, MANAGEMENT_ARGUMENT_STATE, (uintptr_t)job_state(state), ValueString);
+
+   jobs_unlock(jobs);
+
+   pgmoneta_log_info("Job: %" PRIu64 " cancellation requested", id);
+
+#ifdef HAVE_FREEBSD
+   clock_gettime(CLOCK_MONOTONIC_FAST, &end_t);
+#else
+   clock_gettime(CLOCK_MONOTONIC_RAW, &end_t);
+#endif
+
+   if (pgmoneta_management_response_ok(ssl, client_fd, start_t, end_t, compression, encryption, payload))
+   {
+      pgmoneta_management_response_error(ssl, client_fd, NULL, MANAGEMENT_ERROR_JOB_NETWORK, NAME, compression, encryption, payload);
+      pgmoneta_log_error("Job: Error sending response");
+      goto error;
+   }
+
+   pgmoneta_json_destroy(payload);
+
+   pgmoneta_disconnect(client_fd);
+
+   pgmoneta_stop_logging();
+
+   exit(0);
+
+error:
+
+   pgmoneta_json_destroy(payload);
+
+   pgmoneta_disconnect(client_fd);
+
+   pgmoneta_stop_logging();
+
+   exit(1);
+}
+
+void
+pgmoneta_job_subscribe(SSL* ssl, int client_fd, uint8_t compression, uint8_t encryption, struct json* payload)
+{
+   uint64_t id = 0;
+   int state;
+   int server;
+   struct timespec start_t;
+   struct timespec end_t;
+   struct job* job = NULL;
+   struct jobs* jobs = NULL;
+   struct json* request = NULL;
+   struct json* response = NULL;
+   struct json* event = NULL;
+   struct json* progress = NULL;
+   struct main_configuration* config;
+
+   pgmoneta_start_logging();
+
+   config = (struct main_configuration*)shmem;
+   jobs = (struct jobs*)jobs_shmem;
+
+#ifdef HAVE_FREEBSD
+   clock_gettime(CLOCK_MONOTONIC_FAST, &start_t);
+#else
+   clock_gettime(CLOCK_MONOTONIC_RAW, &start_t);
+#endif
+
+   request = (struct json*)pgmoneta_json_get(payload, MANAGEMENT_CATEGORY_REQUEST);
+   id = (uint64_t)pgmoneta_json_get(request, MANAGEMENT_ARGUMENT_JOB);
+
+   jobs_lock(jobs);
+   job = job_find(jobs, id);
+   jobs_unlock(jobs);
+
+   if (job == NULL)
+   {
+      pgmoneta_management_response_error(ssl, client_fd, NULL, MANAGEMENT_ERROR_JOB_NOJOB, NAME, compression, encryption, payload);
+      pgmoneta_log_warn("Job: No job %" PRIu64 " (%d)", id, MANAGEMENT_ERROR_JOB_NOJOB);
+      goto error;
+   }
+
+   server = job->server;
+
+   /* An event per second until the job is done, the last one has the outcome */
+   while (true)
+   {
+      jobs_lock(jobs);
+      job_reap(jobs);
+
+      if (job->id != id)
+      {
+         /* The slot was reused */
+         jobs_unlock(jobs);
+         pgmoneta_management_response_error(ssl, client_fd, NULL, MANAGEMENT_ERROR_JOB_NOJOB, NAME, compression, encryption, payload);
+         goto error;
+      }
+
+      state = atomic_load(&job->state);
+      if (job_json(job, &progress))
+      {
+         jobs_unlock(jobs);
+         pgmoneta_management_response_error(ssl, client_fd, NULL, MANAGEMENT_ERROR_ALLOCATION, NAME, compression, encryption, payload);
+         goto error;
+      }
+      jobs_unlock(jobs);
+
+      if (job_done(state))
+      {
+         break;
+      }
+
+      if (pgmoneta_json_clone(payload, &event) ||
+          pgmoneta_management_create_response(event, server, &response))
+      {
+         pgmoneta_management_response_error(ssl, client_fd, NULL, MANAGEMENT_ERROR_ALLOCATION, NAME, compression, encryption, payload);
+         goto error;
+      }
+
+      pgmoneta_json_put(response, MANAGEMENT_ARGUMENT_JOB, (uintptr_t)progress, ValueJSON);
+      progress = NULL;
+
+      if (pgmoneta_management_write_json(ssl, client_fd, compression, encryption, event))
+      {
+         /* The subscriber is gone */
+         goto error;
+      }
+
+      pgmoneta_json_destroy(event);
+      event = NULL;
+
+      SLEEP(1000000000L);
+   }
+
+   if (state == JOB_STATE_CANCELLED)
+   {
+      pgmoneta_management_response_error(ssl, client_fd, config->common.servers[server].name, MANAGEMENT_ERROR_JOB_CANCELLED, NAME, compression, encryption, payload);
+      goto error;
+   }
+   else if (state != JOB_STATE_SUCCESS)
+   {
+      pgmoneta_management_response_error(ssl, client_fd, config->common.servers[server].name, MANAGEMENT_ERROR_JOB_ERROR, NAME, compression, encryption, payload);
+      goto error;
+   }
+
+   if (pgmoneta_management_create_response(payload, server, &response))
+   {
+      pgmoneta_management_response_error(ssl, client_fd, NULL, MANAGEMENT_ERROR_ALLOCATION, NAME, compression, encryption, payload);
+      goto error;
+   }
+
+   pgmoneta_json_put(response, MANAGEMENT_ARGUMENT_JOB, (uintptr_t)progress, ValueJSON);
+   progress = NULL;
+
+#ifdef HAVE_FREEBSD
+   clock_gettime(CLOCK_MONOTONIC_FAST, &end_t);
+#else
+   clock_gettime(CLOCK_MONOTONIC_RAW, &end_t);
+#endif
+
+   if (pgmoneta_management_response_ok(ssl, client_fd, start_t, end_t, compression, encryption, payload))
+   {
+      pgmoneta_log_error("Job: Error sending response");
+      goto error;
+   }
+
+   pgmoneta_json_destroy(payload);
+
+   pgmoneta_disconnect(client_fd);
+
+   pgmoneta_stop_logging();
+
+   exit(0);
+
+error:
+
+   pgmoneta_json_destroy(progress);
+   pgmoneta_json_destroy(event);
+   pgmoneta_json_destroy(payload);
+
+   pgmoneta_disconnect(client_fd);
+
+   pgmoneta_stop_logging();
+
+   exit(1);
+}
+
+static void
+jobs_lock(struct jobs* jobs)
+{
+   signed char is_free;
+
+retry:
+   is_free = STATE_FREE;
+   if (!atomic_compare_exchange_strong(&jobs->lock, &is_free, STATE_IN_USE))
+   {
+      /* Sleep for 1ms */
+      SLEEP_AND_GOTO(1000000L, retry);
+   }
+}
+
+static void
+jobs_unlock(struct jobs* jobs)
+{
+   atomic_store(&jobs->lock, STATE_FREE);
+}
+
+static struct job*
+job_submit(struct jobs* jobs, int server, int32_t command, int32_t priority)
+{
+   struct job* job = NULL;
+
+   jobs_lock(jobs);
+   job_reap(jobs);
+
+   for (int i = 0; job == NULL && i < NUMBER_OF_JOBS; i++)
+   {
+      if (atomic_load(&jobs->jobs[i].state) == JOB_STATE_FREE)
+      {
+         job = &jobs->jobs[i];
+      }
+   }
+
+   /* Reuse the slot of the job that finished first */
+   for (int i = 0; job == NULL && i < NUMBER_OF_JOBS; i++)
+   {
+      if (job_done(atomic_load(&jobs->jobs[i].state)))
+      {
+         job = &jobs->jobs[i];
+      }
+   }
+
+   for (int i = 0; job != NULL && i < NUMBER_OF_JOBS; i++)
+   {
+      if (job_done(atomic_load(&jobs->jobs[i].state)) && jobs->jobs[i].finished < job->finished)
+      {
+         job = &jobs->jobs[i];
+      }
+   }
+
+   if (job != NULL)
+   {
+      job->id = ++jobs->next_id;
+      job->command = command;
+      job->server = server;
+      job->priority = priority;
+      job->pid = getpid();
+      job->submitted = time(NULL);
+      job->started = 0;
+      job->finished = 0;
+      memset(&job->phase[0], 0, MISC_LENGTH);
+      atomic_store(&job->cancel, false);
+      atomic_store(&job->bytes_done, 0);
+      atomic_store(&job->bytes_total, 0);
+      atomic_store(&job->files_done, 0);
+      atomic_store(&job->files_total, 0);
+      atomic_store(&job->state, JOB_STATE_QUEUED);
+   }
+
+   jobs_unlock(jobs);
+
+   return job;
+}
+
+static bool
+job_turn(struct jobs* jobs, struct job* job)
+{
+   bool turn = true;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   jobs_lock(jobs);
+   job_reap(jobs);
+
+   if (atomic_load(&job->cancel) || atomic_load(&config->common.servers[job->server].repository))
+   {
+      turn = false;
+   }
+
+   for (int i = 0; turn && i < NUMBER_OF_JOBS; i++)
+   {
+      struct job* j = &jobs->jobs[i];
+      int state = atomic_load(&j->state);
+
+      if (j == job || j->server != job->server)
+      {
+         continue;
+      }
+
+      if (state == JOB_STATE_RUNNING)
+      {
+         turn = false;
+      }
+      else if (state == JOB_STATE_QUEUED &&
+               (j->priority > job->priority || (j->priority == job->priority && j->id < job->id)))
+      {
+         turn = false;
+      }
+   }
+
+   if (turn)
+   {
+      job->started = time(NULL);
+      atomic_store(&job->state, JOB_STATE_RUNNING);
+   }
+
+   jobs_unlock(jobs);
+
+   return turn;
+}
+
+static void
+job_reap(struct jobs* jobs)
+{
+   for (int i = 0; i < NUMBER_OF_JOBS; i++)
+   {
+      int state = atomic_load(&jobs->jobs[i].state);
+
+      /* The owner died without recording the outcome */
+      if ((state == JOB_STATE_QUEUED || state == JOB_STATE_RUNNING) &&
+          kill(jobs->jobs[i].pid, 0) == -1 && errno == ESRCH)
+      {
+         jobs->jobs[i].finished = time(NULL);
+         atomic_store(&jobs->jobs[i].state, JOB_STATE_FAILED);
+         errno = 0;
+      }
+   }
+}
+
+static void
+job_finish(struct job* job, int state)
+{
+   job->finished = time(NULL);
+   atomic_store(&job->state, state);
+}
+
+static struct job*
+job_find(struct jobs* jobs, uint64_t id)
+{
+   for (int i = 0; i < NUMBER_OF_JOBS; i++)
+   {
+      if (atomic_load(&jobs->jobs[i].state) != JOB_STATE_FREE && jobs->jobs[i].id == id)
+      {
+         return &jobs->jobs[i];
+      }
+   }
+
+   return NULL;
+}
+
+static bool
+job_done(int state)
+{
+   return state == JOB_STATE_SUCCESS || state == JOB_STATE_FAILED || state == JOB_STATE_CANCELLED;
+}
+
+static char*
+job_state(int state)
+{
+   switch (state)
+   {
+      case JOB_STATE_QUEUED:
+         return "queued";
+      case JOB_STATE_RUNNING:
+         return "running";
+      case JOB_STATE_SUCCESS:
+         return "success";
+      case JOB_STATE_FAILED:
+         return "failed";
+      case JOB_STATE_CANCELLED:
+         return "cancelled";
+      default:
+         break;
+   }
+
+   return "free";
+}
+
+static char*
+job_command(int32_t command)
+{
+   switch (command)
+   {
+      case MANAGEMENT_BACKUP:
+         return "backup";
+      case MANAGEMENT_RESTORE:
+         return "restore";
+      case MANAGEMENT_ARCHIVE:
+         return "archive";
+      case MANAGEMENT_VERIFY:
+         return "verify";
+      case MANAGEMENT_DELETE:
+         return "delete";
+      default:
+         break;
+   }
+
+   return "unknown";
+}
+
+static int
+job_json(struct job* job, struct json** json)
+{
+   int state;
+   time_t elapsed = 0;
+   uint64_t bytes_done;
+   uint64_t bytes_total;
+   uint64_t throughput = 0;
+   uint64_t eta = 0;
+   struct json* j = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   *json = NULL;
+
+   if (pgmoneta_json_create(&j))
+   {
+      goto error;
+   }
+
+   state = atomic_load(&job->state);
+   bytes_done = atomic_load(&job->bytes_done);
+   bytes_total = atomic_load(&job->bytes_total);
+
+   if (job->started > 0)
+   {
+      elapsed = (job_done(state) ? job->finished : time(NULL)) - job->started;
+   }
+
+   if (elapsed > 0)
+   {
+      throughput = bytes_done / (uint64_t)elapsed;
+   }
+
+   if (state == JOB_STATE_RUNNING && throughput > 0 && bytes_total > bytes_done)
+   {
+      eta = (bytes_total - bytes_done) / throughput;
+   }
+
+   pgmoneta_json_put(j, MANAGEMENT_ARGUMENT_JOB, (uintptr_t)job->id, ValueUInt64);
+   pgmoneta_json_put(j, MANAGEMENT_ARGUMENT_SERVER, (uintptr_t)config->common.servers[job->server].name, ValueString);
+   pgmoneta_json_put(j, MANAGEMENT_ARGUMENT_COMMAND, (uintptr_t)job_command(job->command), ValueString);
+   pgmoneta_json_put(j, MANAGEMENT_ARGUMENT_PRIORITY, (uintptr_t)job->priority, ValueInt32);
+   pgmoneta_json_put(j, MANAGEMENT_ARGUMENT_STATE, (uintptr_t)job_state(state), ValueString);
+   pgmoneta_json_put(j, MANAGEMENT_ARGUMENT_PHASE, (uintptr_t)&job->phase[0], ValueString);
+   pgmoneta_json_put(j, MANAGEMENT_ARGUMENT_BYTES_DONE, (uintptr_t)bytes_done, ValueUInt64);
+   pgmoneta_json_put(j, MANAGEMENT_ARGUMENT_BYTES_TOTAL, (uintptr_t)bytes_total, ValueUInt64);
+   pgmoneta_json_put(j, MANAGEMENT_ARGUMENT_FILES_DONE, (uintptr_t)atomic_load(&job->files_done), ValueUInt64);
+   pgmoneta_json_put(j, MANAGEMENT_ARGUMENT_FILES_TOTAL, (uintptr_t)atomic_load(&job->files_total), ValueUInt64);
+   pgmoneta_json_put(j, MANAGEMENT_ARGUMENT_THROUGHPUT, (uintptr_t)throughput, ValueUInt64);
+   pgmoneta_json_put(j, MANAGEMENT_ARGUMENT_ETA, (uintptr_t)eta, ValueUInt64);
+
+   *json = j;
+
+   return 0;
+
+error:
+
+   pgmoneta_json_destroy(j);
+
+   return 1;
+}
@@ -28,6 +28,7 @@
 
 /* pgmoneta */
 #include <pgmoneta.h>
+#include <instrument.h>
 #include <link.h>
 #include <logging.h>
 #include <utils.h>
@@ -157,6 +158,7 @@ do_link(struct worker_common* wc)
       if (pgmoneta_exists(wi->from))
       {
          pgmoneta_delete_file(wi->from, NULL);
+         pgmoneta_instrument_files(1);
       }
       else
       {
@@ -467,6 +469,7 @@ do_comparefiles(struct worker_common* wc)
       if (pgmoneta_exists(wi->from))
       {
          pgmoneta_delete_file(wi->from, NULL);
+         pgmoneta_instrument_files(1);
       }
       else
       {
@@ -28,6 +28,7 @@
 
 /* pgmoneta */
 #include <pgmoneta.h>
+#include <instrument.h>
 #include <logging.h>
 #include <lz4.h>
 #include <lz4_compression.h>
@@ -161,6 +162,7 @@ do_lz4_compress(struct worker_common* wc)
       else
       {
          pgmoneta_delete_file(wi->from, NULL);
+         pgmoneta_instrument_files(1);
       }
    }
 
@@ -380,6 +382,7 @@ do_lz4_decompress(struct worker_common* wc)
       else
       {
          pgmoneta_delete_file(wi->from, NULL);
+         pgmoneta_instrument_files(1);
       }
    }
 
@@ -53,7 +53,7 @@ static int write_socket(int socket, void* buf, size_t size);
 static int write_ssl(SSL* ssl, void* buf, size_t size);
 
 int
-pgmoneta_management_request_backup(SSL* ssl, int socket, char* server, uint8_t compression, uint8_t encryption, char* incremental, int32_t output_format)
+pgmoneta_management_request_backup(SSL* ssl, int socket, char* server, bool async, int32_t priority, uint8_t compression, uint8_t encryption, char* incremental, int32_t output_format)
 {
    struct json* j = NULL;
    struct json* request = NULL;
@@ -70,6 +70,8 @@ pgmoneta_management_request_backup(SSL* ssl, int socket, char* server, uint8_t c
 
    pgmoneta_json_put(request, MANAGEMENT_ARGUMENT_SERVER, (uintptr_t)server, ValueString);
    pgmoneta_json_put(request, MANAGEMENT_ARGUMENT_BACKUP, (uintptr_t)incremental, ValueString);
+   pgmoneta_json_put(request, MANAGEMENT_ARGUMENT_ASYNC, (uintptr_t)async, ValueBool);
+   pgmoneta_json_put(request, MANAGEMENT_ARGUMENT_PRIORITY, (uintptr_t)priority, ValueInt32);
 
    if (pgmoneta_management_write_json(ssl, socket, compression, encryption, j))
    {
@@ -124,7 +126,7 @@ error:
 }
 
 int
-pgmoneta_management_request_restore(SSL* ssl, int socket, char* server, char* backup_id, char* position, char* directory, uint8_t compression, uint8_t encryption, int32_t output_format)
+pgmoneta_management_request_restore(SSL* ssl, int socket, char* server, char* backup_id, char* position, char* directory, bool async, int32_t priority, uint8_t compression, uint8_t encryption, int32_t output_format)
 {
    struct json* j = NULL;
    struct json* request = NULL;
@@ -143,6 +145,8 @@ pgmoneta_management_request_restore(SSL* ssl, int socket, char* server, char* ba
    pgmoneta_json_put(request, MANAGEMENT_ARGUMENT_BACKUP, (uintptr_t)backup_id, ValueString);
    pgmoneta_json_put(request, MANAGEMENT_ARGUMENT_POSITION, (uintptr_t)position, ValueString);
    pgmoneta_json_put(request, MANAGEMENT_ARGUMENT_DIRECTORY, (uintptr_t)directory, ValueString);
+   pgmoneta_json_put(request, MANAGEMENT_ARGUMENT_ASYNC, (uintptr_t)async, ValueBool);
+   pgmoneta_json_put(request, MANAGEMENT_ARGUMENT_PRIORITY, (uintptr_t)priority, ValueInt32);
 
    if (pgmoneta_management_write_json(ssl, socket, compression, encryption, j))
    {
@@ -161,7 +165,7 @@ error:
 }
 
 int
-pgmoneta_management_request_verify(SSL* ssl, int socket, char* server, char* backup_id, char* directory, char* files, uint8_t compression, uint8_t encryption, int32_t output_format)
+pgmoneta_management_request_verify(SSL* ssl, int socket, char* server, char* backup_id, char* directory, char* files, bool async, int32_t priority, uint8_t compression, uint8_t encryption, int32_t output_format)
 {
    struct json* j = NULL;
    struct json* request = NULL;
@@ -180,6 +184,8 @@ pgmoneta_management_request_verify(SSL* ssl, int socket, char* server, char* bac
    pgmoneta_json_put(request, MANAGEMENT_ARGUMENT_BACKUP, (uintptr_t)backup_id, ValueString);
    pgmoneta_json_put(request, MANAGEMENT_ARGUMENT_DIRECTORY, (uintptr_t)directory, ValueString);
    pgmoneta_json_put(request, MANAGEMENT_ARGUMENT_FILES, (uintptr_t)files, ValueString);
+   pgmoneta_json_put(request, MANAGEMENT_ARGUMENT_ASYNC, (uintptr_t)async, ValueBool);
+   pgmoneta_json_put(request, MANAGEMENT_ARGUMENT_PRIORITY, (uintptr_t)priority, ValueInt32);
 
    if (pgmoneta_management_write_json(ssl, socket, compression, encryption, j))
    {
@@ -198,7 +204,7 @@ error:
 }
 
 int
-pgmoneta_management_request_archive(SSL* ssl, int socket, char* server, char* backup_id, char* position, char* directory, uint8_t compression, uint8_t encryption, int32_t output_format)
+pgmoneta_management_request_archive(SSL* ssl, int socket, char* server, char* backup_id, char* position, char* directory, bool async, int32_t priority, uint8_t compression, uint8_t encryption, int32_t output_format)
 {
    struct json* j = NULL;
    struct json* request = NULL;
@@ -217,6 +223,8 @@ pgmoneta_management_request_archive(SSL* ssl, int socket, char* server, char* ba
    pgmoneta_json_put(request, MANAGEMENT_ARGUMENT_BACKUP, (uintptr_t)backup_id, ValueString);
    pgmoneta_json_put(request, MANAGEMENT_ARGUMENT_POSITION, (uintptr_t)position, ValueString);
    pgmoneta_json_put(request, MANAGEMENT_ARGUMENT_DIRECTORY, (uintptr_t)directory, ValueString);
+   pgmoneta_json_put(request, MANAGEMENT_ARGUMENT_ASYNC, (uintptr_t)async, ValueBool);
+   pgmoneta_json_put(request, MANAGEMENT_ARGUMENT_PRIORITY, (uintptr_t)priority, ValueInt32);
 
    if (pgmoneta_management_write_json(ssl, socket, compression, encryption, j))
    {
@@ -235,7 +243,7 @@ error:
 }
 
 int
-pgmoneta_management_request_delete(SSL* ssl, int socket, char* server, char* backup_id, uint8_t compression, uint8_t encryption, int32_t output_format)
+pgmoneta_management_request_delete(SSL* ssl, int socket, char* server, char* backup_id, bool async, int32_t priority, uint8_t compression, uint8_t encryption, int32_t output_format)
 {
    struct json* j = NULL;
    struct json* request = NULL;
@@ -252,6 +260,8 @@ pgmoneta_management_request_delete(SSL* ssl, int socket, char* server, char* bac
 
    pgmoneta_json_put(request, MANAGEMENT_ARGUMENT_SERVER, (uintptr_t)server, ValueString);
    pgmoneta_json_put(request, MANAGEMENT_ARGUMENT_BACKUP, (uintptr_t)backup_id, ValueString);
+   pgmoneta_json_put(request, MANAGEMENT_ARGUMENT_ASYNC, (uintptr_t)async, ValueBool);
+   pgmoneta_json_put(request, MANAGEMENT_ARGUMENT_PRIORITY, (uintptr_t)priority, ValueInt32);
 
    if (pgmoneta_management_write_json(ssl, socket, compression, encryption, j))
    {
@@ -878,6 +888,176 @@ error:
    return 1;
 }
 
+int
+pgmoneta_management_request_verify_wal(SSL* ssl, int socket, char* server, uint8_t compression, uint8_t encryption, int32_t output_format)
+{
+   struct json* j = NULL;
+   struct json* request = NULL;
+
+   if (pgmoneta_management_create_header(MANAGEMENT_VERIFY_WAL, compression, encryption, output_format, &j))
+   {
+      goto error;
+   }
+
+   if (pgmoneta_management_create_request(j, &request))
+   {
+      goto error;
+   }
+
+   pgmoneta_json_put(request, MANAGEMENT_ARGUMENT_SERVER, (uintptr_t)server, ValueString);
+
+   if (pgmoneta_management_write_json(ssl, socket, compression, encryption, j))
+   {
+      goto error;
+   }
+
+   pgmoneta_json_destroy(j);
+
+   return 0;
+
+error:
+
+   pgmoneta_json_destroy(j);
+
+   return 1;
+}
+
+int
+pgmoneta_management_request_wal_fetch(SSL* ssl, int socket, char* server, char* file, char* path, uint8_t compression, uint8_t encryption, int32_t output_format)
+{
+   struct json* j = NULL;
+   struct json* request = NULL;
+
+   if (pgmoneta_management_create_header(MANAGEMENT_WAL_FETCH, compression, encryption, output_format, &j))
+   {
+      goto error;
+   }
+
+   if (pgmoneta_management_create_request(j, &request))
+   {
+      goto error;
+   }
+
+   pgmoneta_json_put(request, MANAGEMENT_ARGUMENT_SERVER, (uintptr_t)server, ValueString);
+   pgmoneta_json_put(request, MANAGEMENT_ARGUMENT_FILENAME, (uintptr_t)file, ValueString);
+   pgmoneta_json_put(request, MANAGEMENT_ARGUMENT_DESTINATION_FILE, (uintptr_t)path, ValueString);
+
+   if (pgmoneta_management_write_json(ssl, socket, compression, encryption, j))
+   {
+      goto error;
+   }
+
+   pgmoneta_json_destroy(j);
+
+   return 0;
+
+error:
+
+   pgmoneta_json_destroy(j);
+
+   return 1;
+}
+
+int
+pgmoneta_management_request_job_list(SSL* ssl, int socket, uint8_t compression, uint8_t encryption, int32_t output_format)
+{
+   struct json* j = NULL;
+   struct json* request = NULL;
+
+   if (pgmoneta_management_create_header(MANAGEMENT_JOB_LIST, compression, encryption, output_format, &j))
+   {
+      goto error;
+   }
+
+   if (pgmoneta_management_create_request(j, &request))
+   {
+      goto error;
+   }
+
+   if (pgmoneta_management_write_json(ssl, socket, compression, encryption, j))
+   {
+      goto error;
+   }
+
+   pgmoneta_json_destroy(j);
+
+   return 0;
+
+error:
+
+   pgmoneta_json_destroy(j);
+
+   return 1;
+}
+
+int
+pgmoneta_management_request_job_cancel(SSL* ssl, int socket, uint64_t job, uint8_t compression, uint8_t encryption, int32_t output_format)
+{
+   struct json* j = NULL;
+   struct json* request = NULL;
+
+   if (pgmoneta_management_create_header(MANAGEMENT_JOB_CANCEL, compression, encryption, output_format, &j))
+   {
+      goto error;
+   }
+
+   if (pgmoneta_management_create_request(j, &request))
+   {
+      goto error;
+   }
+
+   pgmoneta_json_put(request, MANAGEMENT_ARGUMENT_JOB, (uintptr_t)job, ValueUInt64);
+
+   if (pgmoneta_management_write_json(ssl, socket, compression, encryption, j))
+   {
+      goto error;
+   }
+
+   pgmoneta_json_destroy(j);
+
+   return 0;
+
+error:
+
+   pgmoneta_json_destroy(j);
+
+   return 1;
+}
+
+int
+pgmoneta_management_request_job_subscribe(SSL* ssl, int socket, uint64_t job, uint8_t compression, uint8_t encryption, int32_t output_format)
+{
+   struct json* j = NULL;
+   struct json* request = NULL;
+
+   if (pgmoneta_management_create_header(MANAGEMENT_JOB_SUBSCRIBE, compression, encryption, output_format, &j))
+   {
+      goto error;
+   }
+
+   if (pgmoneta_management_create_request(j, &request))
+   {
+      goto error;
+   }
+
+   pgmoneta_json_put(request, MANAGEMENT_ARGUMENT_JOB, (uintptr_t)job, ValueUInt64);
+
+   if (pgmoneta_management_write_json(ssl, socket, compression, encryption, j))
+   {
+      goto error;
+   }
+
+   pgmoneta_json_destroy(j);
+
+   return 0;
+
+error:
+
+   pgmoneta_json_destroy(j);
+
+   return 1;
+}
+
 int
 pgmoneta_management_create_response(struct json* json, int server, struct json** response)
 {
@@ -32,19 +32,16 @@
 #include <json.h>
 #include <logging.h>
 #include <manifest.h>
+#include <memory.h>
 #include <security.h>
 #include <utils.h>
 
 /* system */
 #include <inttypes.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
-
-#define MANIFEST_KEY_VERSION "PostgreSQL-Backup-Manifest-Version"
-#define MANIFEST_KEY_SYS_IDENTIFIER "System-Identifier"
-#define MANIFEST_KEY_FILES "Files"
-#define MANIFEST_KEY_WAL_RANGES "WAL-Ranges"
-#define MANIFEST_KEY_CHECKSUM "Manifest-Checksum"
+#include <strings.h>
 
 static void
 build_deque(struct deque* deque, struct csv_reader* reader, char** f);
@@ -52,11 +49,105 @@ build_deque(struct deque* deque, struct csv_reader* reader, char** f);
 static void
 build_tree(struct art* tree, struct csv_reader* reader, char** f);
 
+static bool
+checksum_identifies(char* entry);
+
+char*
+pgmoneta_manifest_checksum_name(int algorithm)
+{
+   switch (algorithm)
+   {
+      case MANIFEST_CHECKSUM_CRC32C:
+         return "CRC32C";
+      case MANIFEST_CHECKSUM_SHA224:
+         return "SHA224";
+      case MANIFEST_CHECKSUM_SHA256:
+         return "SHA256";
+      case MANIFEST_CHECKSUM_SHA384:
+         return "SHA384";
+      default:
+         break;
+   }
+
+   return "SHA512";
+}
+
+char*
+pgmoneta_manifest_checksum_entry(char* algorithm, char* checksum, uint64_t size)
+{
+   char* entry = NULL;
+
+   /* SHA512 entries are kept bare, so they still compare equal to older manifests */
+   if (algorithm == NULL || !strcasecmp(algorithm, "SHA512"))
+   {
+      return pgmoneta_append(NULL, checksum);
+   }
+
+   entry = pgmoneta_append(entry, algorithm);
+   entry = pgmoneta_append_char(entry, ':');
+   entry = pgmoneta_append(entry, checksum);
+   entry = pgmoneta_append_char(entry, ':');
+   entry = pgmoneta_append_ulong(entry, size);
+
+   return entry;
+}
+
+int
+pgmoneta_manifest_checksum_parse(char* entry, char** algorithm, char** checksum, int64_t* size)
+{
+   char* copy = NULL;
+   char* sep = NULL;
+   char* size_sep = NULL;
+
+   *algorithm = NULL;
+   *checksum = NULL;
+   *size = -1;
+
+   if (entry == NULL)
+   {
+      goto error;
+   }
+
+   sep = strchr(entry, ':');
+   if (sep == NULL)
+   {
+      *algorithm = pgmoneta_append(NULL, "SHA512");
+      *checksum = pgmoneta_append(NULL, entry);
+      return 0;
+   }
+
+   copy = pgmoneta_append(NULL, entry);
+   sep = copy + (sep - entry);
+   *sep = '\0';
+
+   size_sep = strchr(sep + 1, ':');
+   if (size_sep == NULL)
+   {
+      goto error;
+   }
+   *size_sep = '\0';
+
+   *algorithm = pgmoneta_append(NULL, copy);
+   *checksum = pgmoneta_append(NULL, sep + 1);
+   *size = strtoll(size_sep + 1, NULL, 10);
+
+   free(copy);
+
+   return 0;
+
+error:
+
+   free(copy);
+
+   return 1;
+}
+
 int
 pgmoneta_manifest_checksum_verify(char* root)
 {
    char manifest_path[MAX_PATH];
    char* key_path[1] = {"Files"};
+   int failures = 0;
    struct json_reader* reader = NULL;
    struct json* file = NULL;
 
@@ -83,6 +174,7 @@ pgmoneta_manifest_checksum_verify(char* root)
       char file_path[MAX_PATH];
       size_t file_size = 0;
       size_t file_size_manifest = 0;
+      char* algorithm = NULL;
       char* hash = NULL;
       char* checksum = NULL;
 
@@ -100,27 +192,36 @@ pgmoneta_manifest_checksum_verify(char* root)
       file_size_manifest = (int64_t)pgmoneta_json_get(file, "Size");
       if (file_size != file_size_manifest)
       {
-         pgmoneta_log_error("File size mismatch: %s, getting %lu, should be %lu", file_size, file_size_manifest);
-      }
-
-      if (pgmoneta_create_sha512_file(file_path, &hash))
-      {
-         pgmoneta_log_error("Unable to generate hash for file %s with algorithm SHA512", file_path);
-         goto error;
+         pgmoneta_log_error("File size mismatch: %s, getting %lu, should be %lu", file_path, file_size, file_size_manifest);
+         failures++;
       }
 
+      /* Verify with the algorithm the server used, so the server checksum is the only reference */
+      algorithm = (char*)pgmoneta_json_get(file, "Checksum-Algorithm");
       checksum = (char*)pgmoneta_json_get(file, "Checksum");
-      if (!pgmoneta_compare_string(hash, checksum))
+
+      if (algorithm != NULL && strcasecmp(algorithm, "NONE") && checksum != NULL)
       {
-         pgmoneta_log_error("File checksum mismatch, path: %s. Getting %s, should be %s", file_path, hash, checksum);
+         if (pgmoneta_create_checksum_file(file_path, algorithm, &hash))
+         {
+            pgmoneta_log_error("Unable to generate hash for file %s with algorithm %s", file_path, algorithm);
+            goto error;
+         }
+
+         if (!pgmoneta_compare_string(hash, checksum))
+         {
+            pgmoneta_log_error("File checksum mismatch, path: %s. Getting %s, should be %s", file_path, hash, checksum);
+            failures++;
+         }
+         free(hash);
       }
-      free(hash);
+
       pgmoneta_json_destroy(file);
       file = NULL;
    }
    pgmoneta_json_reader_close(reader);
    pgmoneta_json_destroy(file);
-   return 0;
+   return failures > 0 ? 1 : 0;
 
 error:
    pgmoneta_json_reader_close(reader);
@@ -142,6 +243,8 @@ pgmoneta_compare_manifests(char* old_manifest, char* new_manifest, struct art**
    int cols = 0;
    bool manifest_changed = false;
    struct art* tree = NULL;
+   struct memory_arena* arena = NULL;
+   struct memory_arena* scope = NULL;
    struct deque* que = NULL;
    struct deque_iterator* iter = NULL;
 
@@ -151,9 +254,16 @@ pgmoneta_compare_manifests(char* old_manifest, char* new_manifest, struct art**
 
    pgmoneta_deque_create(false, &que);
 
-   pgmoneta_art_create(&deleted);
-   pgmoneta_art_create(&added);
-   pgmoneta_art_create(&changed);
+   /* Every chunk tree is thrown away as a whole, so it lives in an arena that is reset per chunk */
+   if (pgmoneta_memory_arena_create(0, &arena))
+   {
+      goto error;
+   }
+
+   scope = pgmoneta_memory_arena_scope();
+   pgmoneta_art_create_with_arena(scope, &deleted);
+   pgmoneta_art_create_with_arena(scope, &added);
+   pgmoneta_art_create_with_arena(scope, &changed);
 
    if (pgmoneta_csv_reader_init(old_manifest, &r1))
    {
@@ -184,7 +294,7 @@ pgmoneta_compare_manifests(char* old_manifest, char* new_manifest, struct art**
             continue;
          }
          // build every right chunk into an ART
-         pgmoneta_art_create(&tree);
+         pgmoneta_art_create_with_arena(arena, &tree);
          build_tree(tree, r2, f2);
          pgmoneta_deque_iterator_create(que, &iter);
          while (pgmoneta_deque_iterator_next(iter))
@@ -192,7 +302,7 @@ pgmoneta_compare_manifests(char* old_manifest, char* new_manifest, struct art**
             checksum = (char*)pgmoneta_art_search(tree, iter->tag);
             if (checksum != NULL)
             {
-               if (!strcmp((char*)pgmoneta_value_data(iter->value), checksum))
+               if (!strcmp((char*)pgmoneta_value_data(iter->value), checksum) && checksum_identifies(checksum))
                {
                   // not changed but not deleted, remove the entry
                   pgmoneta_deque_iterator_remove(iter);
@@ -207,8 +317,8 @@ pgmoneta_compare_manifests(char* old_manifest, char* new_manifest, struct art**
                }
             }
          }
-         pgmoneta_art_destroy(tree);
          tree = NULL;
+         pgmoneta_memory_arena_reset(arena);
       }
       pgmoneta_deque_iterator_destroy(iter);
       iter = NULL;
@@ -252,7 +362,7 @@ pgmoneta_compare_manifests(char* old_manifest, char* new_manifest, struct art**
             free(f1);
             continue;
          }
-         pgmoneta_art_create(&tree);
+         pgmoneta_art_create_with_arena(arena, &tree);
          build_tree(tree, r1, f1);
          pgmoneta_deque_iterator_create(que, &iter);
          while (pgmoneta_deque_iterator_next(iter))
@@ -264,8 +374,8 @@ pgmoneta_compare_manifests(char* old_manifest, char* new_manifest, struct art**
                pgmoneta_deque_iterator_remove(iter);
             }
          }
-         pgmoneta_art_destroy(tree);
          tree = NULL;
+         pgmoneta_memory_arena_reset(arena);
       }
       pgmoneta_deque_iterator_destroy(iter);
       iter = NULL;
@@ -298,6 +408,7 @@ pgmoneta_compare_manifests(char* old_manifest, char* new_manifest, struct art**
    pgmoneta_csv_reader_destroy(r1);
    pgmoneta_csv_reader_destroy(r2);
    pgmoneta_art_destroy(tree);
+   pgmoneta_memory_arena_destroy(arena);
    pgmoneta_deque_destroy(que);
 
    return 0;
@@ -306,6 +417,7 @@ error:
    pgmoneta_csv_reader_destroy(r1);
    pgmoneta_csv_reader_destroy(r2);
    pgmoneta_art_destroy(tree);
+   pgmoneta_memory_arena_destroy(arena);
    pgmoneta_deque_destroy(que);
    return 1;
 }
@@ -477,3 +589,10 @@ build_tree(struct art* tree, struct csv_reader* reader, char** f)
       free(entry);
    }
 }
+
+static bool
+checksum_identifies(char* entry)
+{
+   /* A 32 bit CRC collides too easily to treat two files as the same, so they are always considered changed */
+   return strncasecmp(entry, "CRC32C:", strlen("CRC32C:")) != 0;
+}
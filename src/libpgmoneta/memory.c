@@ -28,17 +28,24 @@
 
 /* pgmoneta */
 #include <pgmoneta.h>
+#include <logging.h>
+#include <memory.h>
 #include <utils.h>
 
 /* system */
 #ifdef DEBUG
 #include <assert.h>
 #endif
+#include <inttypes.h>
 #include <stdlib.h>
 #include <string.h>
 
-static struct message* message = NULL;
-static void* data = NULL;
+/* Per thread, so workers can each run their own protocol exchange */
+static _Thread_local struct message* message = NULL;
+static _Thread_local void* data = NULL;
+static _Thread_local struct memory_arena* scope = NULL;
+
+static struct memory_arena_block* arena_block_create(struct memory_arena* arena, size_t size);
 
 void
 pgmoneta_memory_init(void)
@@ -206,3 +213,234 @@ pgmoneta_memory_stream_buffer_free(struct stream_buffer* buffer)
    }
    free(buffer);
 }
+
+int
+pgmoneta_memory_arena_create(size_t block_size, struct memory_arena** arena)
+{
+   struct memory_arena* a = NULL;
+
+   *arena = NULL;
+
+   a = (struct memory_arena*)malloc(sizeof(struct memory_arena));
+   if (a == NULL)
+   {
+      return 1;
+   }
+
+   memset(a, 0, sizeof(struct memory_arena));
+   a->block_size = block_size > 0 ? block_size : MEMORY_ARENA_BLOCK_SIZE;
+
+   *arena = a;
+
+   return 0;
+}
+
+void*
+pgmoneta_memory_arena_alloc(struct memory_arena* arena, size_t size)
+{
+   struct memory_arena_block* b = NULL;
+   void* p = NULL;
+
+   if (arena == NULL)
+   {
+      return malloc(size);
+   }
+
+   size = (size + MEMORY_ARENA_ALIGNMENT - 1) & ~((size_t)MEMORY_ARENA_ALIGNMENT - 1);
+   if (size == 0)
+   {
+      size = MEMORY_ARENA_ALIGNMENT;
+   }
+
+   b = arena->block;
+   if (b == NULL || b->size - b->used < size)
+   {
+      if (size > arena->block_size / 4)
+      {
+         /* Large allocations get a block of their own behind the current one */
+         b = arena_block_create(arena, size);
+         if (b == NULL)
+         {
+            return NULL;
+         }
+
+         if (arena->block != NULL)
+         {
+            b->next = arena->block->next;
+            arena->block->next = b;
+         }
+         else
+         {
+            arena->block = b;
+         }
+
+         b->used = size;
+         arena->allocations++;
+
+         return b->data;
+      }
+
+      b = arena_block_create(arena, arena->block_size);
+      if (b == NULL)
+      {
+         return NULL;
+      }
+
+      b->next = arena->block;
+      arena->block = b;
+   }
+
+   p = b->data + b->used;
+   b->used += size;
+   arena->allocations++;
+
+   return p;
+}
+
+char*
+pgmoneta_memory_arena_strdup(struct memory_arena* arena, char* str)
+{
+   char* s = NULL;
+   size_t length;
+
+   if (str == NULL)
+   {
+      return NULL;
+   }
+
+   if (arena == NULL)
+   {
+      return strdup(str);
+   }
+
+   length = strlen(str) + 1;
+
+   s = (char*)pgmoneta_memory_arena_alloc(arena, length);
+   if (s != NULL)
+   {
+      memcpy(s, str, length);
+   }
+
+   return s;
+}
+
+void
+pgmoneta_memory_arena_free(struct memory_arena* arena, void* ptr)
+{
+   if (arena == NULL)
+   {
+      free(ptr);
+   }
+}
+
+void
+pgmoneta_memory_arena_reset(struct memory_arena* arena)
+{
+   struct memory_arena_block* b = NULL;
+   struct memory_arena_block* next = NULL;
+   struct memory_arena_block* keep = NULL;
+
+   if (arena == NULL)
+   {
+      return;
+   }
+
+   b = arena->block;
+   while (b != NULL)
+   {
+      next = b->next;
+
+      if (keep == NULL && b->size == arena->block_size)
+      {
+         keep = b;
+      }
+      else
+      {
+         arena->size -= sizeof(struct memory_arena_block) + b->size;
+         free(b);
+      }
+
+      b = next;
+   }
+
+   if (keep != NULL)
+   {
+      keep->next = NULL;
+      keep->used = 0;
+   }
+
+   arena->block = keep;
+}
+
+void
+pgmoneta_memory_arena_destroy(struct memory_arena* arena)
+{
+   struct memory_arena_block* b = NULL;
+   struct memory_arena_block* next = NULL;
+
+   if (arena == NULL)
+   {
+      return;
+   }
+
+   b = arena->block;
+   while (b != NULL)
+   {
+      next = b->next;
+      free(b);
+      b = next;
+   }
+
+   free(arena);
+}
+
+struct memory_arena*
+pgmoneta_memory_arena_scope(void)
+{
+   if (scope == NULL)
+   {
+      pgmoneta_memory_arena_create(0, &scope);
+   }
+
+   return scope;
+}
+
+void
+pgmoneta_memory_arena_scope_release(void)
+{
+   if (scope == NULL)
+   {
+      return;
+   }
+
+   pgmoneta_log_trace("Arena: %" PRIu64 " allocations in %" PRIu64 " blocks, peak %zu bytes",
+                      scope->allocations, scope->blocks, scope->peak);
+
+   pgmoneta_memory_arena_destroy(scope);
+   scope = NULL;
+}
+
+static struct memory_arena_block*
+arena_block_create(struct memory_arena* arena, size_t size)
+{
+   struct memory_arena_block* b = NULL;
+
+   b = (struct memory_arena_block*)malloc(sizeof(struct memory_arena_block) + size);
+   if (b == NULL)
+   {
+      return NULL;
+   }
+
+   b->next = NULL;
+   b->size = size;
+   b->used = 0;
+
+   arena->blocks++;
+   arena->size += sizeof(struct memory_arena_block) + size;
+   if (arena->size > arena->peak)
+   {
+      arena->peak = arena->size;
+   }
+
+   return b;
+}
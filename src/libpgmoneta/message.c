@@ -46,6 +46,39 @@
 #include <openssl/ssl.h>
 #include <sys/time.h>
 #include <stdio.h>
+#include <inttypes.h>
+
+#define COPY_BINARY_SIGNATURE        "PGCOPY\n\377\r\n"
+#define COPY_BINARY_SIGNATURE_LENGTH 11
+#define COPY_BINARY_HEADER_LENGTH    19
+
+#define COPY_BINARY_HEADER    0
+#define COPY_BINARY_EXTENSION 1
+#define COPY_BINARY_TUPLE     2
+#define COPY_BINARY_FIELD     3
+#define COPY_BINARY_DATA      4
+#define COPY_BINARY_TRAILER   5
+
+/** @struct copy_binary
+ * Defines the state of a file received as a binary COPY of its chunks
+ */
+struct copy_binary
+{
+   int state;                                /**< The part of the stream being parsed */
+   char pending[COPY_BINARY_HEADER_LENGTH];  /**< The bytes of a header split over messages */
+   size_t pending_length;                    /**< The number of pending bytes */
+   size_t needed;                            /**< The number of bytes the header needs */
+   uint64_t remaining;                       /**< The bytes left of the current field or header extension */
+   bool missing;                             /**< Did a chunk come back NULL */
+   uint64_t size;                            /**< The number of bytes received */
+   FILE* file;                               /**< The target file, or NULL */
+   void* data;                               /**< The data, if there is no target file */
+   size_t data_size;                         /**< The size of the data */
+   EVP_MD_CTX* md_ctx;                       /**< The digest context, or NULL */
+   bool crc32c;                              /**< Is a CRC32C calculated */
+   uint32_t crc;                             /**< The CRC32C */
+   struct token_bucket* bucket;              /**< The backup token bucket, or NULL */
+};
 
 static struct message* allocate_message(size_t size);
 
@@ -60,7 +93,11 @@ static int create_C_tuple(struct message* msg, struct tuple** tuple);
 static int get_number_of_columns(struct message* msg);
 static int get_column_name(struct message* msg, int index, char** name);
 
-static unsigned char* decode_base64(char* base64_data, int* decoded_len);
+static char* copy_binary_query(char* path, bool whole, uint64_t offset, uint64_t length);
+static int receive_copy_binary(int srv, SSL* ssl, int socket, char* query, struct token_bucket* network_bucket, struct copy_binary* cb);
+static int copy_binary_consume(struct copy_binary* cb, char* data, size_t length);
+static int copy_binary_write(struct copy_binary* cb, char* data, size_t length);
+static int consume_ready_for_query(int srv, SSL* ssl, int socket, struct stream_buffer* buffer);
 static char** get_paths(char* data, int* count);
 static void extract_file_name(char* path, char* file_name, char* file_path);
 
@@ -790,8 +827,8 @@ pgmoneta_create_standby_status_update_message(int64_t received, int64_t flushed,
 
 int
 pgmoneta_create_base_backup_message(int server_version, bool incremental, char* label, bool include_wal,
-                                    int compression, int compression_level,
-                                    struct message** msg)
+                                    int compression, int compression_level, int compression_workers,
+                                    int manifest_checksum, struct message** msg)
 {
    bool use_new_format = server_version >= 15;
    char cmd[1024];
@@ -834,7 +871,12 @@ pgmoneta_create_base_backup_message(int server_version, bool incremental, char*
          options = pgmoneta_append(options, "COMPRESSION 'zstd', ");
          options = pgmoneta_append(options, "COMPRESSION_DETAIL 'level=");
          options = pgmoneta_append_int(options, compression_level);
-         options = pgmoneta_append(options, ",workers=4', ");
+         if (compression_workers > 0)
+         {
+            options = pgmoneta_append(options, ",workers=");
+            options = pgmoneta_append_int(options, compression_workers);
+         }
+         options = pgmoneta_append(options, "', ");
       }
       else if (compression == COMPRESSION_SERVER_LZ4)
       {
@@ -848,7 +890,9 @@ pgmoneta_create_base_backup_message(int server_version, bool incremental, char*
 
       options = pgmoneta_append(options, "MANIFEST 'yes', ");
 
-      options = pgmoneta_append(options, "MANIFEST_CHECKSUMS 'SHA512'");
+      options = pgmoneta_append(options, "MANIFEST_CHECKSUMS '");
+      options = pgmoneta_append(options, pgmoneta_manifest_checksum_name(manifest_checksum));
+      options = pgmoneta_append(options, "'");
 
       snprintf(cmd, sizeof(cmd), "BASE_BACKUP (%s)", options);
    }
@@ -869,7 +913,9 @@ pgmoneta_create_base_backup_message(int server_version, bool incremental, char*
 
       options = pgmoneta_append(options, "MANIFEST 'yes' ");
 
-      options = pgmoneta_append(options, "MANIFEST_CHECKSUMS 'SHA512'");
+      options = pgmoneta_append(options, "MANIFEST_CHECKSUMS '");
+      options = pgmoneta_append(options, pgmoneta_manifest_checksum_name(manifest_checksum));
+      options = pgmoneta_append(options, "'");
 
       snprintf(cmd, sizeof(cmd), "BASE_BACKUP %s;", options);
    }
@@ -986,11 +1032,8 @@ pgmoneta_create_query_message(char* query, struct message** msg)
 {
    struct message* m = NULL;
    size_t size;
-   char cmd[1024];
 
-   memset(&cmd[0], 0, sizeof(cmd));
-   strcpy(cmd, query);
-   size = 1 + 4 + strlen(cmd) + 1;
+   size = 1 + 4 + strlen(query) + 1;
 
    m = allocate_message(size);
 
@@ -998,7 +1041,7 @@ pgmoneta_create_query_message(char* query, struct message** msg)
 
    pgmoneta_write_byte(m->data, 'Q');
    pgmoneta_write_int32(m->data + 1, size - 1);
-   memcpy(m->data + 5, &cmd[0], strlen(cmd));
+   memcpy(m->data + 5, query, strlen(query));
 
    *msg = m;
 
@@ -2364,8 +2407,9 @@ error:
 }
 
 int
-pgmoneta_receive_extra_files(SSL* ssl, int socket, char* username, char* source_dir, char* target_dir, char** info_extra)
+pgmoneta_receive_extra_files(int srv, SSL* ssl, int socket, char* username, char* source_dir, char* target_dir, char** info_extra)
 {
+   bool exists = false;
    int count = 0;
    char** paths = NULL;
    struct query_response* qr = NULL;
@@ -2423,38 +2467,16 @@ pgmoneta_receive_extra_files(SSL* ssl, int socket, char* username, char* source_
             dest_path = (char*)malloc((strlen(dest_dir) + strlen(file_name) + 1) * sizeof(char));
             snprintf(dest_path, strlen(dest_dir) + strlen(file_name) + 1, "%s%s", dest_dir, file_name);
 
-            pgmoneta_ext_get_file(ssl, socket, paths[j], &qr);
-            if (qr != NULL && qr->tuples != NULL)
+            if (pgmoneta_receive_file(srv, ssl, socket, paths[j], dest_path, NULL, NULL, &exists, NULL, NULL, NULL))
+            {
+               pgmoneta_log_warn("Retrieving extra files: Could not receive \"%s\"", paths[j]);
+               free(dest_dir);
+               free(dest_path);
+               goto error;
+            }
+
+            if (exists)
             {
-               struct tuple* current_tuple = qr->tuples;
-               while (current_tuple != NULL)
-               {
-                  if (current_tuple->data != NULL && current_tuple->data[0] != NULL)
-                  {
-                     int decoded_len;
-                     unsigned char* decoded_data;
-
-                     decoded_data = decode_base64(current_tuple->data[0], &decoded_len);
-                     if (decoded_data != NULL)
-                     {
-                        FILE* file = fopen(dest_path, "wb");
-                        if (file != NULL)
-                        {
-                           fwrite(decoded_data, 1, decoded_len, file);
-                           fclose(file);
-                        }
-                        else
-                        {
-                           pgmoneta_log_error("Retrieving extra files: Could not open file \"%s\" for writing", dest_path);
-                           free(dest_dir);
-                           free(dest_path);
-                           goto error;
-                        }
-                        free(decoded_data);
-                     }
-                  }
-                  current_tuple = current_tuple->next;
-               }
                if (strlen(*info_extra) == 0)
                {
                   *info_extra = pgmoneta_append(*info_extra, paths[j]);
@@ -2465,17 +2487,11 @@ pgmoneta_receive_extra_files(SSL* ssl, int socket, char* username, char* source_
                   *info_extra = pgmoneta_append(*info_extra, paths[j]);
                }
             }
-            else
-            {
-               pgmoneta_log_warn("Retrieving extra files: Query failed");
-               goto error;
-            }
 
-            pgmoneta_free_query_response(qr);
             free(dest_dir);
             free(dest_path);
             free(paths[j]);
-            qr = NULL;
+            paths[j] = NULL;
          }
          free(paths);
       }
@@ -2615,114 +2631,479 @@ extract_file_name(char* path, char* file_name, char* file_path)
    }
 }
 
-static unsigned char*
-decode_base64(char* base64_data, int* decoded_len)
+int
+pgmoneta_receive_file(int srv, SSL* ssl, int socket, char* source_path, char* target_path,
+                      struct token_bucket* bucket, struct token_bucket* network_bucket,
+                      bool* exists, uint64_t* size, char* algorithm, char* checksum)
 {
-   size_t base64_len;
-   size_t max_decoded_len;
-   unsigned char* decoded_data;
-   int actual_decoded_len;
+   unsigned int md_len = 0;
+   unsigned char md_value[EVP_MAX_MD_SIZE];
+   unsigned char* bytes = NULL;
+   char* query = NULL;
+   const EVP_MD* md = NULL;
+   struct copy_binary cb;
+
+   memset(&cb, 0, sizeof(struct copy_binary));
+
+   *exists = false;
+
+   cb.needed = COPY_BINARY_HEADER_LENGTH;
+   cb.bucket = bucket;
+
+   if (checksum != NULL && algorithm != NULL)
+   {
+      if (!strcasecmp(algorithm, "CRC32C"))
+      {
+         cb.crc32c = true;
+         pgmoneta_init_crc32c(&cb.crc);
+      }
+      else
+      {
+         md = EVP_get_digestbyname(algorithm);
+         cb.md_ctx = EVP_MD_CTX_new();
+         if (md == NULL || cb.md_ctx == NULL || !EVP_DigestInit_ex(cb.md_ctx, md, NULL))
+         {
+            pgmoneta_log_error("Receive file: Unsupported checksum algorithm %s", algorithm);
+            goto error;
+         }
+      }
+   }
 
-   base64_len = strlen(base64_data);
-   max_decoded_len = (base64_len / 4) * 3;
-   decoded_data = (unsigned char*)malloc(max_decoded_len);
+   cb.file = fopen(target_path, "wb");
+   if (cb.file == NULL)
+   {
+      pgmoneta_log_error("Receive file: Could not create %s", target_path);
+      goto error;
+   }
 
-   // Perform base64 decoding using OpenSSL
-   actual_decoded_len = EVP_DecodeBlock(decoded_data, (unsigned char*)base64_data, base64_len);
+   query = copy_binary_query(source_path, true, 0, 0);
 
-   // Handle padding
-   if (base64_data[base64_len - 1] == '=')
+   if (receive_copy_binary(srv, ssl, socket, query, network_bucket, &cb))
    {
-      actual_decoded_len--;
+      goto error;
    }
-   if (base64_data[base64_len - 2] == '=')
+
+   if (fflush(cb.file))
    {
-      actual_decoded_len--;
+      goto error;
    }
 
-   if (actual_decoded_len < 0)
+   fclose(cb.file);
+   cb.file = NULL;
+
+   if (cb.missing)
    {
-      pgmoneta_log_error("error decode: Base64 decoding failed");
-      free(decoded_data);
-      return NULL;
+      /* Removed on the server since it was listed */
+      pgmoneta_delete_file(target_path, NULL);
+   }
+   else
+   {
+      if (cb.crc32c)
+      {
+         pgmoneta_finalize_crc32c(&cb.crc);
+
+         /* Same encoding as pgmoneta_create_crc32c_file */
+         bytes = (unsigned char*)&cb.crc;
+         for (int i = 0; i < 4; i++)
+         {
+            sprintf(&checksum[i * 2], "%02x", bytes[i]);
+         }
+      }
+      else if (cb.md_ctx != NULL)
+      {
+         if (!EVP_DigestFinal_ex(cb.md_ctx, md_value, &md_len))
+         {
+            goto error;
+         }
+
+         for (unsigned int i = 0; i < md_len; i++)
+         {
+            sprintf(&checksum[i * 2], "%02x", md_value[i]);
+         }
+      }
+
+      *exists = true;
    }
 
-   *decoded_len = actual_decoded_len;
-   return decoded_data;
+   if (size != NULL)
+   {
+      *size = cb.size;
+   }
+
+   EVP_MD_CTX_free(cb.md_ctx);
+   free(query);
+
+   return 0;
+
+error:
+   if (cb.file != NULL)
+   {
+      fclose(cb.file);
+   }
+
+   EVP_MD_CTX_free(cb.md_ctx);
+   free(query);
+
+   return 1;
 }
 
 int
-pgmoneta_send_file(SSL* ssl, int socket, char* username, char* source_path, char* target_path)
+pgmoneta_receive_file_range(int srv, SSL* ssl, int socket, char* source_path, uint64_t offset, uint64_t length, void** data, size_t* size)
 {
-   FILE* file = NULL;
-   struct query_response* qr = NULL;
-   unsigned char buffer[PGMONETA_CHUNK_SIZE];
-   char* encode_chunk = NULL;
-   size_t bytes_read;
-   size_t encoded_size;
+   char* query = NULL;
+   struct copy_binary cb;
 
-   // Check if the user has sufficient privileges
-   pgmoneta_ext_privilege(ssl, socket, &qr);
-   if (qr != NULL && qr->tuples != NULL && qr->tuples->data != NULL && qr->tuples->data[0] != NULL && qr->tuples->data[0][0] == 't')
+   memset(&cb, 0, sizeof(struct copy_binary));
+
+   *data = NULL;
+   *size = 0;
+
+   cb.needed = COPY_BINARY_HEADER_LENGTH;
+   cb.data = pgmoneta_memory_dynamic_create(&cb.data_size);
+
+   query = copy_binary_query(source_path, false, offset, length);
+
+   if (receive_copy_binary(srv, ssl, socket, query, NULL, &cb))
    {
-      pgmoneta_free_query_response(qr);
-      qr = NULL;
+      goto error;
+   }
+
+   if (cb.missing)
+   {
+      pgmoneta_log_error("Receive file: %s does not exist", source_path);
+      goto error;
+   }
+
+   *data = cb.data;
+   *size = cb.data_size;
+
+   free(query);
+
+   return 0;
+
+error:
+   pgmoneta_memory_dynamic_destroy(cb.data);
+   free(query);
+
+   return 1;
+}
+
+static char*
+copy_binary_query(char* path, bool whole, uint64_t offset, uint64_t length)
+{
+   char number[MISC_LENGTH];
+   char* literal = NULL;
+   char* stop = NULL;
+   char* query = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   literal = pgmoneta_append_char(NULL, '\'');
+   for (size_t i = 0; i < strlen(path); i++)
+   {
+      if (path[i] == '\'')
+      {
+         literal = pgmoneta_append_char(literal, '\'');
+      }
+      literal = pgmoneta_append_char(literal, path[i]);
+   }
+   literal = pgmoneta_append_char(literal, '\'');
+
+   if (whole)
+   {
+      stop = pgmoneta_append(stop, "COALESCE((pg_stat_file(");
+      stop = pgmoneta_append(stop, literal);
+      stop = pgmoneta_append(stop, ", true)).size, 0)");
+   }
+   else
+   {
+      memset(number, 0, sizeof(number));
+      snprintf(number, sizeof(number), "%" PRIu64, offset + length);
+      stop = pgmoneta_append(stop, number);
+   }
+
+   memset(number, 0, sizeof(number));
+   snprintf(number, sizeof(number), "%" PRIu64, offset);
+
+   /* One row, and so one CopyData message, per chunk of the file */
+   query = pgmoneta_append(query, "COPY (SELECT pg_read_binary_file(f.path, o, LEAST(");
+   query = pgmoneta_append_int(query, config->transfer_chunk_size);
+   query = pgmoneta_append(query, ", f.stop - o), true) FROM (SELECT ");
+   query = pgmoneta_append(query, literal);
+   query = pgmoneta_append(query, "::text AS path, ");
+   query = pgmoneta_append(query, stop);
+   query = pgmoneta_append(query, "::bigint AS stop) AS f, LATERAL generate_series(");
+   query = pgmoneta_append(query, number);
+   query = pgmoneta_append(query, "::bigint, GREATEST(f.stop - 1, ");
+   query = pgmoneta_append(query, number);
+   query = pgmoneta_append(query, "), ");
+   query = pgmoneta_append_int(query, config->transfer_chunk_size);
+   query = pgmoneta_append(query, "::bigint) AS o ORDER BY o) TO STDOUT (FORMAT binary);");
+
+   free(literal);
+   free(stop);
+
+   return query;
+}
+
+static int
+receive_copy_binary(int srv, SSL* ssl, int socket, char* query, struct token_bucket* network_bucket, struct copy_binary* cb)
+{
+   int status;
+   struct message* query_msg = NULL;
+   struct message* msg = NULL;
+   struct stream_buffer* buffer = NULL;
+
+   pgmoneta_memory_stream_buffer_init(&buffer);
+   if (buffer == NULL)
+   {
+      goto error;
+   }
+
+   msg = (struct message*)malloc(sizeof(struct message));
+   if (msg == NULL)
+   {
+      goto error;
+   }
+
+   memset(msg, 0, sizeof(struct message));
+
+   pgmoneta_create_query_message(query, &query_msg);
+   if (pgmoneta_write_message(ssl, socket, query_msg) != MESSAGE_STATUS_OK)
+   {
+      goto error;
+   }
+
+   // CopyOutResponse, the CopyData messages, CopyDone and CommandComplete
+   while (msg->kind != 'C')
+   {
+      status = pgmoneta_consume_copy_stream_start(srv, ssl, socket, buffer, msg, network_bucket);
+      if (status != MESSAGE_STATUS_OK)
+      {
+         goto error;
+      }
+
+      if (msg->kind == 'E' || msg->kind == 'f')
+      {
+         pgmoneta_log_copyfail_message(msg);
+         pgmoneta_log_error_response_message(msg);
+         pgmoneta_consume_copy_stream_end(buffer, msg);
+         consume_ready_for_query(srv, ssl, socket, buffer);
+         goto error;
+      }
 
-      // Open the file for reading
-      file = fopen(source_path, "rb");
-      if (file == NULL)
+      if (msg->kind == 'd' && copy_binary_consume(cb, msg->data, msg->length))
       {
-         pgmoneta_log_warn("Sending file: Failed to open file: %s", source_path);
          goto error;
       }
 
-      // Send the file content in chunks
-      while ((bytes_read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+      pgmoneta_consume_copy_stream_end(buffer, msg);
+   }
+
+   if (consume_ready_for_query(srv, ssl, socket, buffer))
+   {
+      goto error;
+   }
+
+   if (cb->state != COPY_BINARY_TRAILER)
+   {
+      pgmoneta_log_error("Receive file: Incomplete copy stream");
+      goto error;
+   }
+
+   pgmoneta_memory_stream_buffer_free(buffer);
+   pgmoneta_free_message(query_msg);
+   free(msg);
+
+   return 0;
+
+error:
+   pgmoneta_memory_stream_buffer_free(buffer);
+   pgmoneta_free_message(query_msg);
+   free(msg);
+
+   return 1;
+}
+
+static int
+copy_binary_consume(struct copy_binary* cb, char* data, size_t length)
+{
+   size_t offset = 0;
+   size_t n;
+   int16_t fields;
+   int32_t field_length;
+
+   while (offset < length)
+   {
+      if (cb->state == COPY_BINARY_TRAILER)
+      {
+         pgmoneta_log_error("Receive file: Data after the copy trailer");
+         return 1;
+      }
+
+      if (cb->state == COPY_BINARY_EXTENSION || cb->state == COPY_BINARY_DATA)
       {
-         pgmoneta_base64_encode(buffer, bytes_read, &encode_chunk, &encoded_size);
+         n = MIN(cb->remaining, (uint64_t)(length - offset));
 
-         pgmoneta_ext_send_file_chunk(ssl, socket, target_path, encode_chunk, &qr);
-         if (!qr)
+         if (cb->state == COPY_BINARY_DATA && copy_binary_write(cb, data + offset, n))
          {
-            pgmoneta_log_error("Sending file: Send file chunk failed");
-            goto error;
+            return 1;
          }
-         pgmoneta_free_query_response(qr);
-         free(encode_chunk);
-         encode_chunk = NULL;
-         qr = NULL;
+
+         offset += n;
+         cb->remaining -= n;
+
+         if (cb->remaining == 0)
+         {
+            cb->state = COPY_BINARY_TUPLE;
+            cb->needed = 2;
+         }
+
+         continue;
+      }
+
+      // Headers can be split over CopyData messages
+      cb->pending[cb->pending_length++] = data[offset++];
+      if (cb->pending_length < cb->needed)
+      {
+         continue;
+      }
+
+      cb->pending_length = 0;
+
+      switch (cb->state)
+      {
+         case COPY_BINARY_HEADER:
+            if (memcmp(cb->pending, COPY_BINARY_SIGNATURE, COPY_BINARY_SIGNATURE_LENGTH))
+            {
+               pgmoneta_log_error("Receive file: Invalid copy signature");
+               return 1;
+            }
+
+            field_length = pgmoneta_read_int32(cb->pending + COPY_BINARY_SIGNATURE_LENGTH + 4);
+            if (field_length < 0)
+            {
+               return 1;
+            }
+
+            cb->remaining = (uint64_t)field_length;
+            cb->state = cb->remaining > 0 ? COPY_BINARY_EXTENSION : COPY_BINARY_TUPLE;
+            cb->needed = 2;
+            break;
+         case COPY_BINARY_TUPLE:
+            fields = pgmoneta_read_int16(cb->pending);
+            if (fields == -1)
+            {
+               cb->state = COPY_BINARY_TRAILER;
+            }
+            else if (fields == 1)
+            {
+               cb->state = COPY_BINARY_FIELD;
+               cb->needed = 4;
+            }
+            else
+            {
+               pgmoneta_log_error("Receive file: Unexpected number of fields %d", fields);
+               return 1;
+            }
+            break;
+         case COPY_BINARY_FIELD:
+            field_length = pgmoneta_read_int32(cb->pending);
+            cb->needed = 2;
+            if (field_length < 0)
+            {
+               /* NULL, the file doesn't exist */
+               cb->missing = true;
+               cb->state = COPY_BINARY_TUPLE;
+            }
+            else if (field_length == 0)
+            {
+               cb->state = COPY_BINARY_TUPLE;
+            }
+            else
+            {
+               cb->remaining = (uint64_t)field_length;
+               cb->state = COPY_BINARY_DATA;
+            }
+            break;
+         default:
+            return 1;
       }
    }
-   else if (qr != NULL && qr->tuples != NULL && qr->tuples->data != NULL && qr->tuples->data[0] != NULL && qr->tuples->data[0][0] == 'f')
+
+   return 0;
+}
+
+static int
+copy_binary_write(struct copy_binary* cb, char* data, size_t length)
+{
+   if (cb->bucket != NULL)
    {
-      pgmoneta_log_error("Sending file: User %s is not SUPERUSER", username);
-      goto error;
+      while (pgmoneta_token_bucket_consume(cb->bucket, length))
+      {
+         SLEEP(500000000L)
+      }
+   }
+
+   if (cb->file != NULL)
+   {
+      if (fwrite(data, 1, length, cb->file) != length)
+      {
+         pgmoneta_log_error("Receive file: Could not write data");
+         return 1;
+      }
    }
    else
    {
-      pgmoneta_log_error("Sending file: Query failed");
-      goto error;
+      cb->data = pgmoneta_memory_dynamic_append(cb->data, cb->data_size, data, length, &cb->data_size);
+      if (cb->data == NULL)
+      {
+         return 1;
+      }
    }
 
-   fclose(file);
-   if (encode_chunk)
+   if (cb->md_ctx != NULL && !EVP_DigestUpdate(cb->md_ctx, data, length))
    {
-      free(encode_chunk);
+      return 1;
+   }
+
+   if (cb->crc32c && pgmoneta_create_crc32c_buffer(data, length, &cb->crc))
+   {
+      return 1;
    }
-   pgmoneta_free_query_response(qr);
+
+   cb->size += length;
 
    return 0;
+}
 
-error:
-   if (file)
+static int
+consume_ready_for_query(int srv, SSL* ssl, int socket, struct stream_buffer* buffer)
+{
+   int status;
+
+   /* The copy stream skips ReadyForQuery, so take it off before the next query */
+   while (buffer->end - buffer->cursor < 1 + 4 + 1)
    {
-      fclose(file);
+      status = pgmoneta_read_copy_stream(srv, ssl, socket, buffer);
+      if (status == MESSAGE_STATUS_ZERO)
+      {
+         SLEEP(1000000L);
+      }
+      else if (status != MESSAGE_STATUS_OK)
+      {
+         return 1;
+      }
    }
-   if (encode_chunk)
+
+   if (buffer->buffer[buffer->cursor] != 'Z')
    {
-      free(encode_chunk);
+      return 1;
    }
-   pgmoneta_free_query_response(qr);
 
-   return 1;
+   buffer->cursor += 1 + 4 + 1;
+   buffer->start = buffer->cursor;
+
+   return 0;
 }
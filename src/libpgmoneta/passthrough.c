@@ -0,0 +1,1213 @@
+/*
+ * Copyright (C) 2025 The pgmoneta community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* pgmoneta */
+#include <pgmoneta.h>
+#include <art.h>
+#include <csv.h>
+#include <logging.h>
+#include <passthrough.h>
+#include <utils.h>
+
+/* system */
+#include <archive.h>
+#include <archive_entry.h>
+#include <inttypes.h>
+#include <lz4frame.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#include <zstd.h>
+
+#define PASSTHROUGH_BUFFER_SIZE 131072
+#define PASSTHROUGH_CHECKPOINT  4194304
+#define GZIP_WINDOW_SIZE        32768
+#define GZIP_TRAILER_SIZE       8
+#define TAR_BLOCK_SIZE          512
+
+/** @struct decoder
+ * Streaming decompression of a server side compressed archive
+ */
+struct decoder
+{
+   int compression;    /**< The compression type */
+   z_stream gzip;      /**< The GZIP stream */
+   ZSTD_DCtx* zstd;    /**< The Zstandard context */
+   LZ4F_dctx* lz4;     /**< The LZ4 frame context */
+   bool raw;           /**< Is a GZIP member resumed from a checkpoint */
+   size_t trailer;     /**< The GZIP trailer left to skip */
+   char* buffer;       /**< The output buffer */
+};
+
+static int decoder_create(int compression, struct decoder** decoder);
+static int decoder_step(struct decoder* decoder, void* in, size_t in_size, size_t* consumed, size_t* produced, bool* end);
+static int decoder_resume(struct decoder* decoder, unsigned char* window, int bits, int value);
+static void decoder_destroy(struct decoder* decoder);
+static int tar_consume(struct passthrough* passthrough, char* data, size_t size);
+static int tar_header(struct passthrough* passthrough);
+static uint64_t tar_number(char* field, size_t length);
+static char* archive_suffix(int compression);
+static void build_path(char* directory, char* name, char* path, size_t size);
+static int write_row(struct csv_writer* writer, char* kind, uint64_t first, uint64_t second, char* third);
+static int write_checkpoint(struct passthrough* passthrough, uint64_t position);
+static int read_archive(char* directory, int* compression, char* path, size_t size);
+
+int
+pgmoneta_passthrough_create(char* directory, int compression, struct passthrough** passthrough)
+{
+   char path[MAX_PATH];
+   char name[MISC_LENGTH];
+   struct passthrough* p = NULL;
+
+   *passthrough = NULL;
+
+   p = (struct passthrough*)malloc(sizeof(struct passthrough));
+   if (p == NULL)
+   {
+      goto error;
+   }
+
+   memset(p, 0, sizeof(struct passthrough));
+   p->compression = compression;
+   p->frame = true;
+
+   if (decoder_create(compression, (struct decoder**)&p->decoder))
+   {
+      goto error;
+   }
+
+   memset(name, 0, sizeof(name));
+   snprintf(name, sizeof(name), "%s%s", PASSTHROUGH_ARCHIVE, archive_suffix(compression));
+   build_path(directory, name, p->archive_path, sizeof(p->archive_path));
+
+   p->archive = fopen(p->archive_path, "wb");
+   if (p->archive == NULL)
+   {
+      pgmoneta_log_error("Passthrough: Could not create %s", p->archive_path);
+      goto error;
+   }
+
+   memset(path, 0, sizeof(path));
+   build_path(directory, PASSTHROUGH_INDEX, path, sizeof(path));
+
+   if (pgmoneta_csv_writer_init(path, &p->index))
+   {
+      pgmoneta_log_error("Passthrough: Could not create %s", path);
+      goto error;
+   }
+
+   if (write_row(p->index, "archive", (uint64_t)compression, 0, name))
+   {
+      goto error;
+   }
+
+   if (compression == COMPRESSION_SERVER_GZIP)
+   {
+      memset(path, 0, sizeof(path));
+      build_path(directory, PASSTHROUGH_WINDOW, path, sizeof(path));
+
+      p->window = fopen(path, "wb");
+      if (p->window == NULL)
+      {
+         pgmoneta_log_error("Passthrough: Could not create %s", path);
+         goto error;
+      }
+   }
+
+   *passthrough = p;
+
+   return 0;
+
+error:
+
+   pgmoneta_passthrough_destroy(p);
+
+   return 1;
+}
+
+int
+pgmoneta_passthrough_write(struct passthrough* passthrough, void* data, size_t size)
+{
+   size_t offset = 0;
+   size_t consumed = 0;
+   size_t produced = 0;
+   bool end = false;
+   struct decoder* decoder = (struct decoder*)passthrough->decoder;
+
+   if (size == 0)
+   {
+      return 0;
+   }
+
+   if (fwrite(data, 1, size, passthrough->archive) != size)
+   {
+      pgmoneta_log_error("Passthrough: Could not write to %s", passthrough->archive_path);
+      goto error;
+   }
+
+   do
+   {
+      if (passthrough->frame && offset < size)
+      {
+         if (write_row(passthrough->index, "frame", passthrough->compressed + offset, passthrough->uncompressed, NULL))
+         {
+            goto error;
+         }
+         passthrough->frame = false;
+         passthrough->checkpoint = passthrough->uncompressed;
+      }
+
+      if (decoder_step(decoder, (char*)data + offset, size - offset, &consumed, &produced, &end))
+      {
+         goto error;
+      }
+
+      if (consumed == 0 && produced == 0 && offset < size && !end)
+      {
+         pgmoneta_log_error("Passthrough: Decompression of %s made no progress", passthrough->archive_path);
+         goto error;
+      }
+
+      offset += consumed;
+
+      if (tar_consume(passthrough, decoder->buffer, produced))
+      {
+         goto error;
+      }
+
+      if (end)
+      {
+         passthrough->frame = true;
+      }
+      else if (passthrough->window != NULL &&
+               (decoder->gzip.data_type & 128) && !(decoder->gzip.data_type & 64) &&
+               passthrough->uncompressed - passthrough->checkpoint >= PASSTHROUGH_CHECKPOINT)
+      {
+         /* At the end of a deflate block that isn't the last one of the member */
+         if (write_checkpoint(passthrough, passthrough->compressed + offset))
+         {
+            goto error;
+         }
+      }
+   }
+   while (offset < size || (produced > 0 && !end));
+
+   passthrough->compressed += size;
+
+   return 0;
+
+error:
+
+   return 1;
+}
+
+int
+pgmoneta_passthrough_finish(struct passthrough* passthrough)
+{
+   if (passthrough->header_length != 0 || passthrough->skip != 0)
+   {
+      pgmoneta_log_error("Passthrough: %s is truncated", passthrough->archive_path);
+      goto error;
+   }
+
+   if (fflush(passthrough->archive) != 0)
+   {
+      pgmoneta_log_error("Passthrough: Could not flush %s", passthrough->archive_path);
+      goto error;
+   }
+
+   fclose(passthrough->archive);
+   passthrough->archive = NULL;
+
+   if (passthrough->window != NULL)
+   {
+      if (fflush(passthrough->window) != 0)
+      {
+         pgmoneta_log_error("Passthrough: Could not flush the windows of %s", passthrough->archive_path);
+         goto error;
+      }
+
+      fclose(passthrough->window);
+      passthrough->window = NULL;
+   }
+
+   if (write_row(passthrough->index, "total", passthrough->size, passthrough->biggest, NULL))
+   {
+      goto error;
+   }
+
+   pgmoneta_csv_writer_destroy(passthrough->index);
+   passthrough->index = NULL;
+
+   pgmoneta_log_debug("Passthrough: %s (Compressed: %" PRIu64 " Uncompressed: %" PRIu64 ")",
+                      passthrough->archive_path, passthrough->compressed, passthrough->uncompressed);
+
+   return 0;
+
+error:
+
+   return 1;
+}
+
+void
+pgmoneta_passthrough_destroy(struct passthrough* passthrough)
+{
+   if (passthrough == NULL)
+   {
+      return;
+   }
+
+   if (passthrough->archive != NULL)
+   {
+      fclose(passthrough->archive);
+   }
+
+   if (passthrough->window != NULL)
+   {
+      fclose(passthrough->window);
+   }
+
+   if (passthrough->index != NULL)
+   {
+      pgmoneta_csv_writer_destroy(passthrough->index);
+   }
+
+   decoder_destroy((struct decoder*)passthrough->decoder);
+
+   free(passthrough);
+}
+
+bool
+pgmoneta_is_passthrough(char* directory)
+{
+   char path[MAX_PATH];
+
+   memset(path, 0, sizeof(path));
+   build_path(directory, PASSTHROUGH_INDEX, path, sizeof(path));
+
+   return pgmoneta_exists(path);
+}
+
+int
+pgmoneta_passthrough_size(char* directory, uint64_t* size, uint64_t* biggest)
+{
+   char path[MAX_PATH];
+   int number_of_columns = 0;
+   char** columns = NULL;
+   bool found = false;
+   struct csv_reader* reader = NULL;
+
+   *size = 0;
+   *biggest = 0;
+
+   memset(path, 0, sizeof(path));
+   build_path(directory, PASSTHROUGH_INDEX, path, sizeof(path));
+
+   if (pgmoneta_csv_reader_init(path, &reader))
+   {
+      goto error;
+   }
+
+   while (!found && pgmoneta_csv_next_row(reader, &number_of_columns, &columns))
+   {
+      if (number_of_columns == 3 && !strcmp(columns[0], "total"))
+      {
+         *size = strtoull(columns[1], NULL, 10);
+         *biggest = strtoull(columns[2], NULL, 10);
+         found = true;
+      }
+
+      free(columns);
+      columns = NULL;
+   }
+
+   pgmoneta_csv_reader_destroy(reader);
+
+   if (!found)
+   {
+      pgmoneta_log_error("Passthrough: No total in %s", path);
+      goto error;
+   }
+
+   return 0;
+
+error:
+
+   return 1;
+}
+
+int
+pgmoneta_passthrough_extract(char* directory, struct art* files, char* destination)
+{
+   int compression = COMPRESSION_NONE;
+   char path[MAX_PATH];
+   char dst_file_path[MAX_PATH];
+   struct archive* a = NULL;
+   struct archive_entry* entry = NULL;
+
+   memset(path, 0, sizeof(path));
+
+   if (read_archive(directory, &compression, path, sizeof(path)))
+   {
+      goto error;
+   }
+
+   a = archive_read_new();
+   archive_read_support_filter_all(a);
+   archive_read_support_format_tar(a);
+
+   if (archive_read_open_filename(a, path, PASSTHROUGH_BUFFER_SIZE) != ARCHIVE_OK)
+   {
+      pgmoneta_log_error("Passthrough: Could not open %s: %s", path, archive_error_string(a));
+      goto error;
+   }
+
+   while (archive_read_next_header(a, &entry) == ARCHIVE_OK)
+   {
+      const char* entry_path = archive_entry_pathname(entry);
+
+      if (files != NULL && !pgmoneta_art_contains_key(files, (char*)entry_path))
+      {
+         archive_read_data_skip(a);
+         continue;
+      }
+
+      memset(dst_file_path, 0, sizeof(dst_file_path));
+      build_path(destination, (char*)entry_path, dst_file_path, sizeof(dst_file_path));
+
+      archive_entry_set_pathname(entry, dst_file_path);
+      if (archive_read_extract(a, entry, 0) != ARCHIVE_OK)
+      {
+         pgmoneta_log_error("Passthrough: Could not extract %s: %s", dst_file_path, archive_error_string(a));
+         goto error;
+      }
+   }
+
+   archive_read_close(a);
+   archive_read_free(a);
+
+   return 0;
+
+error:
+
+   if (a != NULL)
+   {
+      archive_read_close(a);
+      archive_read_free(a);
+   }
+
+   return 1;
+}
+
+int
+pgmoneta_passthrough_extract_file(char* directory, char* path, char* target)
+{
+   int compression = COMPRESSION_NONE;
+   char archive_path[MAX_PATH];
+   char index_path[MAX_PATH];
+   char window_path[MAX_PATH];
+   int number_of_columns = 0;
+   char** columns = NULL;
+   bool found = false;
+   uint64_t frame_compressed = 0;
+   uint64_t frame_uncompressed = 0;
+   int bits = -1;
+   int value = 0;
+   uint64_t checkpoints = 0;
+   uint64_t checkpoint = 0;
+   uint64_t offset = 0;
+   uint64_t size = 0;
+   uint64_t position = 0;
+   uint64_t written = 0;
+   size_t in_offset = 0;
+   size_t in_length = 0;
+   size_t consumed = 0;
+   size_t produced = 0;
+   bool end = false;
+   char* in = NULL;
+   unsigned char* window = NULL;
+   FILE* archive = NULL;
+   FILE* windows = NULL;
+   FILE* file = NULL;
+   struct csv_reader* reader = NULL;
+   struct decoder* decoder = NULL;
+
+   memset(archive_path, 0, sizeof(archive_path));
+   memset(index_path, 0, sizeof(index_path));
+
+   if (read_archive(directory, &compression, archive_path, sizeof(archive_path)))
+   {
+      goto error;
+   }
+
+   build_path(directory, PASSTHROUGH_INDEX, index_path, sizeof(index_path));
+
+   if (pgmoneta_csv_reader_init(index_path, &reader))
+   {
+      goto error;
+   }
+
+   /* Frames, checkpoints and files are indexed in stream order, so the last start seen holds the file */
+   while (!found && pgmoneta_csv_next_row(reader, &number_of_columns, &columns))
+   {
+      if (number_of_columns == 3 && !strcmp(columns[0], "frame"))
+      {
+         frame_compressed = strtoull(columns[1], NULL, 10);
+         frame_uncompressed = strtoull(columns[2], NULL, 10);
+         bits = -1;
+      }
+      else if (number_of_columns == 4 && !strcmp(columns[0], "checkpoint"))
+      {
+         frame_compressed = strtoull(columns[1], NULL, 10);
+         frame_uncompressed = strtoull(columns[2], NULL, 10);
+         bits = atoi(columns[3]);
+         checkpoint = checkpoints++;
+      }
+      else if (number_of_columns == 4 && !strcmp(columns[0], "file") && !strcmp(columns[3], path))
+      {
+         offset = strtoull(columns[1], NULL, 10);
+         size = strtoull(columns[2], NULL, 10);
+         found = true;
+      }
+
+      free(columns);
+      columns = NULL;
+   }
+
+   pgmoneta_csv_reader_destroy(reader);
+   reader = NULL;
+
+   if (!found)
+   {
+      pgmoneta_log_error("Passthrough: %s not found in %s", path, archive_path);
+      goto error;
+   }
+
+   file = fopen(target, "wb");
+   if (file == NULL)
+   {
+      pgmoneta_log_error("Passthrough: Could not create %s", target);
+      goto error;
+   }
+
+   if (size > 0)
+   {
+      /* A checkpoint starts inside a byte when the previous deflate block ended inside it */
+      archive = fopen(archive_path, "rb");
+      if (archive == NULL || fseeko(archive, (off_t)(frame_compressed - (bits > 0 ? 1 : 0)), SEEK_SET) != 0)
+      {
+         pgmoneta_log_error("Passthrough: Could not open %s", archive_path);
+         goto error;
+      }
+
+      in = (char*)malloc(PASSTHROUGH_BUFFER_SIZE);
+      if (in == NULL || decoder_create(compression, &decoder))
+      {
+         goto error;
+      }
+
+      if (bits >= 0)
+      {
+         memset(window_path, 0, sizeof(window_path));
+         build_path(directory, PASSTHROUGH_WINDOW, window_path, sizeof(window_path));
+
+         window = (unsigned char*)malloc(GZIP_WINDOW_SIZE);
+         if (window == NULL)
+         {
+            goto error;
+         }
+
+         windows = fopen(window_path, "rb");
+         if (windows == NULL || fseeko(windows, (off_t)(checkpoint * GZIP_WINDOW_SIZE), SEEK_SET) != 0 ||
+             fread(window, 1, GZIP_WINDOW_SIZE, windows) != GZIP_WINDOW_SIZE)
+         {
+            pgmoneta_log_error("Passthrough: Could not read %s", window_path);
+            goto error;
+         }
+
+         if (bits > 0)
+         {
+            value = fgetc(archive);
+            if (value == EOF)
+            {
+               pgmoneta_log_error("Passthrough: %s is truncated", archive_path);
+               goto error;
+            }
+         }
+
+         if (decoder_resume(decoder, window, bits, value))
+         {
+            goto error;
+         }
+      }
+
+      position = frame_uncompressed;
+
+      while (written < size)
+      {
+         if (in_offset == in_length)
+         {
+            in_offset = 0;
+            in_length = fread(in, 1, PASSTHROUGH_BUFFER_SIZE, archive);
+         }
+
+         if (decoder_step(decoder, in + in_offset, in_length - in_offset, &consumed, &produced, &end))
+         {
+            goto error;
+         }
+
+         if (consumed == 0 && produced == 0 && !end)
+         {
+            pgmoneta_log_error("Passthrough: %s is truncated", archive_path);
+            goto error;
+         }
+
+         in_offset += consumed;
+
+         if (position + produced > offset && position < offset + size)
+         {
+            uint64_t from = position > offset ? position : offset;
+            uint64_t to = position + produced < offset + size ? position + produced : offset + size;
+
+            if (fwrite(decoder->buffer + (from - position), 1, to - from, file) != to - from)
+            {
+               pgmoneta_log_error("Passthrough: Could not write to %s", target);
+               goto error;
+            }
+
+            written += to - from;
+         }
+
+         position += produced;
+      }
+   }
+
+   fclose(file);
+   if (archive != NULL)
+   {
+      fclose(archive);
+   }
+   if (windows != NULL)
+   {
+      fclose(windows);
+   }
+   decoder_destroy(decoder);
+   free(window);
+   free(in);
+
+   return 0;
+
+error:
+
+   if (reader != NULL)
+   {
+      pgmoneta_csv_reader_destroy(reader);
+   }
+   if (file != NULL)
+   {
+      fclose(file);
+   }
+   if (archive != NULL)
+   {
+      fclose(archive);
+   }
+   if (windows != NULL)
+   {
+      fclose(windows);
+   }
+   decoder_destroy(decoder);
+   free(window);
+   free(in);
+
+   return 1;
+}
+
+int
+pgmoneta_passthrough_remove(char* directory)
+{
+   int compression = COMPRESSION_NONE;
+   char path[MAX_PATH];
+
+   memset(path, 0, sizeof(path));
+
+   if (read_archive(directory, &compression, path, sizeof(path)))
+   {
+      goto error;
+   }
+
+   if (pgmoneta_exists(path))
+   {
+      pgmoneta_delete_file(path, NULL);
+   }
+
+   memset(path, 0, sizeof(path));
+   build_path(directory, PASSTHROUGH_WINDOW, path, sizeof(path));
+
+   if (pgmoneta_exists(path))
+   {
+      pgmoneta_delete_file(path, NULL);
+   }
+
+   memset(path, 0, sizeof(path));
+   build_path(directory, PASSTHROUGH_INDEX, path, sizeof(path));
+
+   pgmoneta_delete_file(path, NULL);
+
+   return 0;
+
+error:
+
+   return 1;
+}
+
+static int
+decoder_create(int compression, struct decoder** decoder)
+{
+   struct decoder* d = NULL;
+
+   *decoder = NULL;
+
+   d = (struct decoder*)malloc(sizeof(struct decoder));
+   if (d == NULL)
+   {
+      goto error;
+   }
+
+   memset(d, 0, sizeof(struct decoder));
+   d->compression = compression;
+
+   d->buffer = (char*)malloc(PASSTHROUGH_BUFFER_SIZE);
+   if (d->buffer == NULL)
+   {
+      goto error;
+   }
+
+   if (compression == COMPRESSION_SERVER_GZIP)
+   {
+      if (inflateInit2(&d->gzip, MAX_WBITS + 16) != Z_OK)
+      {
+         pgmoneta_log_error("Passthrough: Could not initialize GZIP");
+         d->compression = COMPRESSION_NONE;
+         goto error;
+      }
+   }
+   else if (compression == COMPRESSION_SERVER_ZSTD)
+   {
+      d->zstd = ZSTD_createDCtx();
+      if (d->zstd == NULL)
+      {
+         pgmoneta_log_error("Passthrough: Could not initialize Zstandard");
+         goto error;
+      }
+   }
+   else if (compression == COMPRESSION_SERVER_LZ4)
+   {
+      if (LZ4F_isError(LZ4F_createDecompressionContext(&d->lz4, LZ4F_VERSION)))
+      {
+         pgmoneta_log_error("Passthrough: Could not initialize LZ4");
+         d->lz4 = NULL;
+         goto error;
+      }
+   }
+   else
+   {
+      pgmoneta_log_error("Passthrough: Unsupported compression %d", compression);
+      goto error;
+   }
+
+   *decoder = d;
+
+   return 0;
+
+error:
+
+   decoder_destroy(d);
+
+   return 1;
+}
+
+static int
+decoder_step(struct decoder* decoder, void* in, size_t in_size, size_t* consumed, size_t* produced, bool* end)
+{
+   *consumed = 0;
+   *produced = 0;
+   *end = false;
+
+   if (decoder->compression == COMPRESSION_SERVER_GZIP)
+   {
+      int ret;
+
+      /* A resumed member is inflated raw, so its trailer is skipped here */
+      if (decoder->trailer > 0)
+      {
+         *consumed = decoder->trailer < in_size ? decoder->trailer : in_size;
+         decoder->trailer -= *consumed;
+
+         return 0;
+      }
+
+      decoder->gzip.next_in = (Bytef*)in;
+      decoder->gzip.avail_in = (uInt)in_size;
+      decoder->gzip.next_out = (Bytef*)decoder->buffer;
+      decoder->gzip.avail_out = PASSTHROUGH_BUFFER_SIZE;
+
+      /* Stop at the deflate block boundaries, which is where checkpoints are taken */
+      do
+      {
+         ret = inflate(&decoder->gzip, Z_BLOCK);
+      }
+      while (ret == Z_OK && decoder->gzip.avail_in == in_size && decoder->gzip.avail_out == PASSTHROUGH_BUFFER_SIZE);
+
+      *consumed = in_size - decoder->gzip.avail_in;
+      *produced = PASSTHROUGH_BUFFER_SIZE - decoder->gzip.avail_out;
+
+      if (ret == Z_STREAM_END)
+      {
+         *end = true;
+
+         if (decoder->raw)
+         {
+            decoder->raw = false;
+            decoder->trailer = GZIP_TRAILER_SIZE;
+            inflateReset2(&decoder->gzip, MAX_WBITS + 16);
+         }
+         else
+         {
+            inflateReset(&decoder->gzip);
+         }
+      }
+      else if (ret != Z_OK && ret != Z_BUF_ERROR)
+      {
+         pgmoneta_log_error("Passthrough: GZIP error %d", ret);
+         goto error;
+      }
+   }
+   else if (decoder->compression == COMPRESSION_SERVER_ZSTD)
+   {
+      size_t ret;
+      ZSTD_inBuffer input = {in, in_size, 0};
+      ZSTD_outBuffer output = {decoder->buffer, PASSTHROUGH_BUFFER_SIZE, 0};
+
+      ret = ZSTD_decompressStream(decoder->zstd, &output, &input);
+      if (ZSTD_isError(ret))
+      {
+         pgmoneta_log_error("Passthrough: Zstandard error %s", ZSTD_getErrorName(ret));
+         goto error;
+      }
+
+      *consumed = input.pos;
+      *produced = output.pos;
+      *end = ret == 0;
+   }
+   else
+   {
+      size_t ret;
+      size_t src_size = in_size;
+      size_t dst_size = PASSTHROUGH_BUFFER_SIZE;
+
+      ret = LZ4F_decompress(decoder->lz4, decoder->buffer, &dst_size, in, &src_size, NULL);
+      if (LZ4F_isError(ret))
+      {
+         pgmoneta_log_error("Passthrough: LZ4 error %s", LZ4F_getErrorName(ret));
+         goto error;
+      }
+
+      *consumed = src_size;
+      *produced = dst_size;
+      *end = ret == 0;
+   }
+
+   return 0;
+
+error:
+
+   return 1;
+}
+
+static int
+decoder_resume(struct decoder* decoder, unsigned char* window, int bits, int value)
+{
+   if (inflateReset2(&decoder->gzip, -MAX_WBITS) != Z_OK)
+   {
+      goto error;
+   }
+
+   if (bits > 0 && inflatePrime(&decoder->gzip, bits, value >> (8 - bits)) != Z_OK)
+   {
+      goto error;
+   }
+
+   if (inflateSetDictionary(&decoder->gzip, window, GZIP_WINDOW_SIZE) != Z_OK)
+   {
+      goto error;
+   }
+
+   decoder->raw = true;
+
+   return 0;
+
+error:
+
+   pgmoneta_log_error("Passthrough: Could not resume GZIP at a checkpoint");
+
+   return 1;
+}
+
+static void
+decoder_destroy(struct decoder* decoder)
+{
+   if (decoder == NULL)
+   {
+      return;
+   }
+
+   if (decoder->compression == COMPRESSION_SERVER_GZIP)
+   {
+      inflateEnd(&decoder->gzip);
+   }
+
+   if (decoder->zstd != NULL)
+   {
+      ZSTD_freeDCtx(decoder->zstd);
+   }
+
+   if (decoder->lz4 != NULL)
+   {
+      LZ4F_freeDecompressionContext(decoder->lz4);
+   }
+
+   free(decoder->buffer);
+   free(decoder);
+}
+
+static int
+tar_consume(struct passthrough* passthrough, char* data, size_t size)
+{
+   size_t n;
+
+   while (size > 0)
+   {
+      if (passthrough->skip > 0)
+      {
+         n = passthrough->skip < size ? (size_t)passthrough->skip : size;
+         passthrough->skip -= n;
+      }
+      else
+      {
+         n = TAR_BLOCK_SIZE - passthrough->header_length;
+         if (n > size)
+         {
+            n = size;
+         }
+
+         memcpy(passthrough->header + passthrough->header_length, data, n);
+         passthrough->header_length += n;
+      }
+
+      data += n;
+      size -= n;
+      passthrough->uncompressed += n;
+
+      if (passthrough->header_length == TAR_BLOCK_SIZE)
+      {
+         passthrough->header_length = 0;
+
+         if (tar_header(passthrough))
+         {
+            goto error;
+         }
+      }
+   }
+
+   return 0;
+
+error:
+
+   return 1;
+}
+
+static int
+tar_header(struct passthrough* passthrough)
+{
+   char* h = passthrough->header;
+   char name[101];
+   char prefix[156];
+   char path[MAX_PATH];
+   uint64_t checksum = 0;
+   uint64_t size;
+   char type;
+
+   /* The end of the archive is marked by zero blocks */
+   if (h[0] == '\0')
+   {
+      return 0;
+   }
+
+   for (int i = 0; i < TAR_BLOCK_SIZE; i++)
+   {
+      checksum += (i >= 148 && i < 156) ? ' ' : (unsigned char)h[i];
+   }
+
+   if (checksum != tar_number(h + 148, 8))
+   {
+      pgmoneta_log_error("Passthrough: Invalid tar header at %" PRIu64 " in %s",
+                         passthrough->uncompressed - TAR_BLOCK_SIZE, passthrough->archive_path);
+      goto error;
+   }
+
+   size = tar_number(h + 124, 12);
+   type = h[156];
+
+   passthrough->skip = (size + TAR_BLOCK_SIZE - 1) & ~((uint64_t)TAR_BLOCK_SIZE - 1);
+
+   if (type == '0' || type == '\0')
+   {
+      memset(name, 0, sizeof(name));
+      memset(prefix, 0, sizeof(prefix));
+      memset(path, 0, sizeof(path));
+
+      memcpy(name, h, 100);
+
+      if (!memcmp(h + 257, "ustar", 5))
+      {
+         memcpy(prefix, h + 345, 155);
+      }
+
+      if (strlen(prefix) > 0)
+      {
+         snprintf(path, sizeof(path), "%s/%s", prefix, name);
+      }
+      else
+      {
+         snprintf(path, sizeof(path), "%s", name);
+      }
+
+      if (write_row(passthrough->index, "file", passthrough->uncompressed, size, path))
+      {
+         goto error;
+      }
+
+      passthrough->size += size;
+      if (size > passthrough->biggest)
+      {
+         passthrough->biggest = size;
+      }
+   }
+
+   return 0;
+
+error:
+
+   return 1;
+}
+
+static uint64_t
+tar_number(char* field, size_t length)
+{
+   uint64_t value = 0;
+
+   /* Base-256 is used for sizes that do not fit in octal */
+   if ((unsigned char)field[0] & 0x80)
+   {
+      value = (unsigned char)field[0] & 0x7f;
+      for (size_t i = 1; i < length; i++)
+      {
+         value = (value << 8) | (unsigned char)field[i];
+      }
+
+      return value;
+   }
+
+   for (size_t i = 0; i < length; i++)
+   {
+      if (field[i] >= '0' && field[i] <= '7')
+      {
+         value = (value << 3) | (uint64_t)(field[i] - '0');
+      }
+      else if (field[i] != ' ' || value != 0)
+      {
+         break;
+      }
+   }
+
+   return value;
+}
+
+static char*
+archive_suffix(int compression)
+{
+   switch (compression)
+   {
+      case COMPRESSION_SERVER_GZIP:
+         return ".gz";
+      case COMPRESSION_SERVER_ZSTD:
+         return ".zstd";
+      case COMPRESSION_SERVER_LZ4:
+         return ".lz4";
+      default:
+         break;
+   }
+
+   return "";
+}
+
+static void
+build_path(char* directory, char* name, char* path, size_t size)
+{
+   if (pgmoneta_ends_with(directory, "/"))
+   {
+      snprintf(path, size, "%s%s", directory, name);
+   }
+   else
+   {
+      snprintf(path, size, "%s/%s", directory, name);
+   }
+}
+
+static int
+write_row(struct csv_writer* writer, char* kind, uint64_t first, uint64_t second, char* third)
+{
+   char f[32];
+   char s[32];
+   char* columns[4];
+   int number_of_columns = 3;
+
+   memset(f, 0, sizeof(f));
+   memset(s, 0, sizeof(s));
+
+   snprintf(f, sizeof(f), "%" PRIu64, first);
+   snprintf(s, sizeof(s), "%" PRIu64, second);
+
+   columns[0] = kind;
+   columns[1] = f;
+   columns[2] = s;
+
+   if (third != NULL)
+   {
+      columns[3] = third;
+      number_of_columns = 4;
+   }
+
+   if (pgmoneta_csv_write(writer, number_of_columns, columns))
+   {
+      pgmoneta_log_error("Passthrough: Could not write the index");
+      return 1;
+   }
+
+   return 0;
+}
+
+static int
+write_checkpoint(struct passthrough* passthrough, uint64_t position)
+{
+   unsigned char window[GZIP_WINDOW_SIZE];
+   uInt length = GZIP_WINDOW_SIZE;
+   char bits[8];
+   struct decoder* decoder = (struct decoder*)passthrough->decoder;
+
+   memset(window, 0, sizeof(window));
+   memset(bits, 0, sizeof(bits));
+
+   if (inflateGetDictionary(&decoder->gzip, window, &length) != Z_OK)
+   {
+      pgmoneta_log_error("Passthrough: Could not get the GZIP window of %s", passthrough->archive_path);
+      goto error;
+   }
+
+   /* The window is kept right aligned, so every checkpoint takes the same space */
+   if (length < GZIP_WINDOW_SIZE)
+   {
+      memmove(window + GZIP_WINDOW_SIZE - length, window, length);
+      memset(window, 0, GZIP_WINDOW_SIZE - length);
+   }
+
+   if (fwrite(window, 1, GZIP_WINDOW_SIZE, passthrough->window) != GZIP_WINDOW_SIZE)
+   {
+      pgmoneta_log_error("Passthrough: Could not write the windows of %s", passthrough->archive_path);
+      goto error;
+   }
+
+   snprintf(bits, sizeof(bits), "%d", decoder->gzip.data_type & 7);
+
+   if (write_row(passthrough->index, "checkpoint", position, passthrough->uncompressed, bits))
+   {
+      goto error;
+   }
+
+   passthrough->checkpoint = passthrough->uncompressed;
+
+   return 0;
+
+error:
+
+   return 1;
+}
+
+static int
+read_archive(char* directory, int* compression, char* path, size_t size)
+{
+   char index_path[MAX_PATH];
+   int number_of_columns = 0;
+   char** columns = NULL;
+   struct csv_reader* reader = NULL;
+
+   memset(index_path, 0, sizeof(index_path));
+   build_path(directory, PASSTHROUGH_INDEX, index_path, sizeof(index_path));
+
+   if (pgmoneta_csv_reader_init(index_path, &reader))
+   {
+      pgmoneta_log_error("Passthrough: Could not open %s", index_path);
+      goto error;
+   }
+
+   if (!pgmoneta_csv_next_row(reader, &number_of_columns, &columns) ||
+       number_of_columns != 4 || strcmp(columns[0], "archive"))
+   {
+      pgmoneta_log_error("Passthrough: Invalid index %s", index_path);
+      goto error;
+   }
+
+   *compression = atoi(columns[1]);
+   build_path(directory, columns[3], path, size);
+
+   free(columns);
+   pgmoneta_csv_reader_destroy(reader);
+
+   return 0;
+
+error:
+
+   free(columns);
+   if (reader != NULL)
+   {
+      pgmoneta_csv_reader_destroy(reader);
+   }
+
+   return 1;
+}
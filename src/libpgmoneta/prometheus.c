@@ -30,7 +30,9 @@
 #include <pgmoneta.h>
 #include <backup.h>
 #include <extension.h>
+#include <gzip_compression.h>
 #include <info.h>
+#include <instrument.h>
 #include <logging.h>
 #include <network.h>
 #include <prometheus.h>
@@ -40,11 +42,18 @@
 #include <wal.h>
 
 /* system */
+#include <ctype.h>
+#include <errno.h>
 #include <ev.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
+#include <netinet/in.h>
+#include <openssl/err.h>
+#include <sys/socket.h>
 #include <sys/types.h>
 
 #define CHUNK_SIZE 32768
@@ -54,31 +63,112 @@
 #define PAGE_METRICS 2
 #define BAD_REQUEST  3
 
-static int resolve_page(struct message* msg);
-static int unknown_page(SSL* client_ssl, int client_fd);
-static int home_page(SSL* client_ssl, int client_fd);
-static int metrics_page(SSL* client_ssl, int client_fd);
-static int bad_request(SSL* client_ssl, int client_fd);
-static int redirect_page(SSL* client_ssl, int client_fd, char* path);
-static void general_information(SSL* client_ssl, int client_fd);
-static void backup_information(SSL* client_ssl, int client_fd);
-static void size_information(SSL* client_ssl, int client_fd);
+#define MAX_LISTENERS      64
+#define MAX_CONNECTIONS    64
+#define MAX_REQUEST_LENGTH 65536
+#define KEEP_ALIVE_TIMEOUT 60
+
+#define CONNECTION_NEGOTIATE 0
+#define CONNECTION_HANDSHAKE 1
+#define CONNECTION_READ      2
+#define CONNECTION_WRITE     3
+
+#define IO_DONE  0
+#define IO_AGAIN 1
+#define IO_ERROR 2
+
+/** @struct metrics_listener
+ * Defines a listening socket of the metrics server
+ */
+struct metrics_listener
+{
+   struct ev_io io; /**< The watcher */
+   int socket;      /**< The socket */
+};
+
+/** @struct metrics_connection
+ * Defines a client connection of the metrics server.
+ *
+ * The socket is non-blocking and the connection moves through
+ * negotiate, handshake, read and write as its watcher fires
+ */
+struct metrics_connection
+{
+   struct ev_io io;        /**< The watcher */
+   int socket;             /**< The socket */
+   SSL* ssl;               /**< The SSL structure */
+   int state;              /**< The state of the connection */
+   bool redirect;          /**< Answer the request with a redirect to https */
+   bool keep_alive;        /**< Keep the connection open after the response */
+   char* request;          /**< The bytes of the request read so far */
+   size_t request_length;  /**< The length of the request */
+   char* response;         /**< The response */
+   size_t response_length; /**< The length of the response */
+   size_t response_offset; /**< The number of bytes of the response written */
+   time_t last_active;     /**< The time of the last activity */
+};
+
+static struct ev_loop* metrics_loop = NULL;
+static struct metrics_listener listeners[MAX_LISTENERS];
+static int listeners_length = 0;
+static struct metrics_connection* connections[MAX_CONNECTIONS];
+static int server_status = 0;
+
+static char* metrics_body = NULL;
+static size_t metrics_body_length = 0;
+static unsigned char* metrics_compressed = NULL;
+static size_t metrics_compressed_length = 0;
+static time_t metrics_valid_until = 0;
+
+static void accept_cb(struct ev_loop* loop, struct ev_io* watcher, int revents);
+static void connection_cb(struct ev_loop* loop, struct ev_io* watcher, int revents);
+static void refresh_cb(struct ev_loop* loop, struct ev_periodic* watcher, int revents);
+static void connection_close(struct metrics_connection* connection);
+static void connection_wait(struct metrics_connection* connection, int events);
+static int connection_negotiate(struct metrics_connection* connection);
+static int connection_handshake(struct metrics_connection* connection);
+static int connection_read(struct metrics_connection* connection);
+static int connection_respond(struct metrics_connection* connection);
+static int connection_write(struct metrics_connection* connection);
+static int connection_recv(struct metrics_connection* connection, void* buffer, size_t size, ssize_t* length);
+static int connection_send(struct metrics_connection* connection, void* buffer, size_t size, ssize_t* length);
+static int ssl_status(struct metrics_connection* connection, int ret);
+static int queue_message(struct metrics_connection* connection, struct message* msg);
+static void serve_request(struct metrics_connection* connection, struct message* msg);
+static void redirect_request(struct metrics_connection* connection, struct message* msg);
+static void request_options(struct message* msg, bool* gzip, bool* keep_alive);
+static bool header_contains(char* request, char* name, char* token);
 
-static int send_chunk(SSL* client_ssl, int client_fd, char* data);
+static int resolve_page(struct message* msg);
+static int unknown_page(struct metrics_connection* connection);
+static int home_page(struct metrics_connection* connection);
+static int metrics_page(struct metrics_connection* connection, bool gzip, bool keep_alive);
+static int bad_request(struct metrics_connection* connection);
+static int redirect_page(struct metrics_connection* connection, char* path);
+static void metrics_refresh(void);
+static char* render_metrics(void);
+static void general_information(char** body);
+static void backup_information(char** body);
+static void size_information(char** body);
+static void phase_information(char** body);
+static char* phase_labels(char* data, int server, struct phase_metrics* pm);
+static char* phase_histogram(char* data, char* metric, int server, struct phase_metrics* pm, struct phase_histogram* h);
+static char* phase_counter(char* data, char* metric, int server, struct phase_metrics* pm, atomic_ullong* value);
+
+static int send_chunk(struct metrics_connection* connection, char* data);
 
 static bool is_metrics_cache_configured(void);
 static bool is_metrics_cache_valid(void);
-static bool metrics_cache_append(char* data);
+static void metrics_cache_refresh(void);
 static bool metrics_cache_finalize(void);
 static size_t metrics_cache_size_to_alloc(void);
 static void metrics_cache_invalidate(void);
 
 void
-pgmoneta_prometheus(SSL* client_ssl, int client_fd)
+pgmoneta_prometheus_server(int* fds, int fds_length)
 {
-   int status;
-   int page;
-   struct message* msg = NULL;
+   sigset_t mask;
+   struct ev_periodic refresh;
    struct main_configuration* config;
 
    pgmoneta_start_logging();
@@ -86,106 +176,732 @@ pgmoneta_prometheus(SSL* client_ssl, int client_fd)
 
    config = (struct main_configuration*)shmem;
 
-   if (client_ssl)
+   /* The handlers of the main loop are inherited, so fall back to the default actions */
+   signal(SIGTERM, SIG_DFL);
+   signal(SIGINT, SIG_DFL);
+
+   sigemptyset(&mask);
+   sigaddset(&mask, SIGTERM);
+   sigaddset(&mask, SIGINT);
+   sigprocmask(SIG_UNBLOCK, &mask, NULL);
+
+   metrics_loop = ev_loop_new(pgmoneta_libev(config->libev));
+   if (metrics_loop == NULL)
+   {
+      pgmoneta_log_fatal("Metrics: No loop implementation (%x) (%x)",
+                         pgmoneta_libev(config->libev), ev_supported_backends());
+      goto error;
+   }
+
+   memset(&connections, 0, sizeof(connections));
+
+   /* Scrapes are served from the rendered metrics, so have them ready before the first one */
+   metrics_refresh();
+
+   listeners_length = MIN(fds_length, MAX_LISTENERS);
+   for (int i = 0; i < listeners_length; i++)
    {
-      char buffer[5] = {0};
+      memset(&listeners[i], 0, sizeof(struct metrics_listener));
+      ev_io_init((struct ev_io*)&listeners[i], accept_cb, fds[i], EV_READ);
+      listeners[i].socket = fds[i];
+      ev_io_start(metrics_loop, (struct ev_io*)&listeners[i]);
+   }
+
+   /* Expires stalled connections, renders the metrics and checks for shutdown */
+   ev_periodic_init(&refresh, refresh_cb, 0., 1., 0);
+   ev_periodic_start(metrics_loop, &refresh);
+
+   ev_run(metrics_loop, 0);
 
-      recv(client_fd, buffer, 5, MSG_PEEK);
+   ev_periodic_stop(metrics_loop, &refresh);
 
-      if ((unsigned char)buffer[0] == 0x16 || (unsigned char)buffer[0] == 0x80) // SSL/TLS request
+   for (int i = 0; i < MAX_CONNECTIONS; i++)
+   {
+      if (connections[i] != NULL)
       {
-         if (SSL_accept(client_ssl) <= 0)
-         {
-            pgmoneta_log_error("Failed to accept SSL connection");
-            goto error;
-         }
+         connection_close(connections[i]);
+      }
+   }
+
+   for (int i = 0; i < listeners_length; i++)
+   {
+      ev_io_stop(metrics_loop, (struct ev_io*)&listeners[i]);
+   }
+
+   ev_loop_destroy(metrics_loop);
+   metrics_loop = NULL;
+
+   free(metrics_body);
+   free(metrics_compressed);
+
+   pgmoneta_memory_destroy();
+   pgmoneta_stop_logging();
+
+   exit(server_status);
+
+error:
+
+   pgmoneta_memory_destroy();
+   pgmoneta_stop_logging();
+
+   exit(1);
+}
+
+static void
+accept_cb(struct ev_loop* loop, struct ev_io* watcher, int revents)
+{
+   struct sockaddr_in6 client_addr;
+   socklen_t client_addr_length;
+   int client_fd;
+   int slot = -1;
+   SSL_CTX* ctx = NULL;
+   struct metrics_connection* connection = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   if (EV_ERROR & revents)
+   {
+      pgmoneta_log_debug("Metrics: Invalid accept event: %s", strerror(errno));
+      errno = 0;
+      return;
+   }
+
+   client_addr_length = sizeof(client_addr);
+   client_fd = accept(watcher->fd, (struct sockaddr*)&client_addr, &client_addr_length);
+   if (client_fd == -1)
+   {
+      if (errno == EBADF || errno == EINVAL || errno == ENOTSOCK)
+      {
+         /* The main process binds the port again once we are gone */
+         pgmoneta_log_warn("Metrics: Listening socket failed: %s (%d)", strerror(errno), watcher->fd);
+         server_status = 1;
+         ev_break(loop, EVBREAK_ALL);
       }
       else
       {
-         char* path = "/";
-         char* base_url = NULL;
+         pgmoneta_log_debug("Metrics: accept: %s (%d)", strerror(errno), watcher->fd);
+      }
+      errno = 0;
+      return;
+   }
 
-         if (pgmoneta_read_timeout_message(NULL, client_fd, config->authentication_timeout, &msg) != MESSAGE_STATUS_OK)
-         {
-            pgmoneta_log_error("Failed to read message");
-            goto error;
-         }
+   for (int i = 0; slot == -1 && i < MAX_CONNECTIONS; i++)
+   {
+      if (connections[i] == NULL)
+      {
+         slot = i;
+      }
+   }
 
-         char* path_start = strstr(msg->data, " ");
-         if (path_start)
-         {
-            path_start++;
-            char* path_end = strstr(path_start, " ");
-            if (path_end)
-            {
-               *path_end = '\0';
-               path = path_start;
-            }
-         }
+   if (slot == -1)
+   {
+      pgmoneta_log_warn("Metrics: Too many connections (%d)", MAX_CONNECTIONS);
+      pgmoneta_disconnect(client_fd);
+      return;
+   }
+
+   connection = (struct metrics_connection*)calloc(1, sizeof(struct metrics_connection));
+   if (connection == NULL)
+   {
+      pgmoneta_disconnect(client_fd);
+      return;
+   }
 
-         base_url = pgmoneta_format_and_append(base_url, "https://localhost:%d%s", config->metrics, path);
+   /* A slow client must never stall the other connections */
+   pgmoneta_socket_nonblocking(client_fd, true);
 
-         if (redirect_page(NULL, client_fd, base_url) != MESSAGE_STATUS_OK)
+   connection->socket = client_fd;
+   connection->state = CONNECTION_READ;
+   connection->last_active = time(NULL);
+
+   if (strlen(config->metrics_cert_file) > 0 && strlen(config->metrics_key_file) > 0)
+   {
+      if (pgmoneta_create_ssl_ctx(false, &ctx))
+      {
+         pgmoneta_log_error("Could not create metrics SSL context");
+         goto error;
+      }
+
+      if (pgmoneta_create_ssl_server(ctx, config->metrics_key_file, config->metrics_cert_file, config->metrics_ca_file,
+                                     client_fd, &connection->ssl))
+      {
+         pgmoneta_log_error("Could not create metrics SSL server");
+         if (connection->ssl == NULL)
          {
-            pgmoneta_log_error("Failed to redirect to: %s", base_url);
-            free(base_url);
-            goto error;
+            SSL_CTX_free(ctx);
          }
+         goto error;
+      }
+
+      connection->state = CONNECTION_NEGOTIATE;
+   }
+
+   connections[slot] = connection;
+
+   ev_io_init((struct ev_io*)connection, connection_cb, client_fd, EV_READ);
+   ev_io_start(loop, (struct ev_io*)connection);
+
+   return;
+
+error:
+
+   pgmoneta_close_ssl(connection->ssl);
+   pgmoneta_disconnect(client_fd);
+   free(connection);
+}
+
+static void
+connection_cb(struct ev_loop* loop __attribute__((unused)), struct ev_io* watcher, int revents)
+{
+   int status = 0;
+   struct metrics_connection* connection;
+
+   connection = (struct metrics_connection*)watcher;
+
+   if (EV_ERROR & revents)
+   {
+      connection_close(connection);
+      return;
+   }
+
+   connection->last_active = time(NULL);
+
+   switch (connection->state)
+   {
+      case CONNECTION_NEGOTIATE:
+         status = connection_negotiate(connection);
+         break;
+      case CONNECTION_HANDSHAKE:
+         status = connection_handshake(connection);
+         break;
+      case CONNECTION_READ:
+         status = connection_read(connection);
+         break;
+      case CONNECTION_WRITE:
+         status = connection_write(connection);
+         break;
+      default:
+         status = 1;
+         break;
+   }
+
+   if (status)
+   {
+      connection_close(connection);
+   }
+}
+
+static void
+refresh_cb(struct ev_loop* loop, struct ev_periodic* watcher __attribute__((unused)), int revents)
+{
+   time_t now;
+   int timeout;
+   struct metrics_connection* connection;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   if (EV_ERROR & revents)
+   {
+      pgmoneta_log_trace("Metrics: Invalid refresh event: %s", strerror(errno));
+      return;
+   }
+
+   if (!config->running)
+   {
+      ev_break(loop, EVBREAK_ALL);
+      return;
+   }
 
-         pgmoneta_close_ssl(client_ssl);
-         pgmoneta_disconnect(client_fd);
+   now = time(NULL);
 
-         pgmoneta_memory_destroy();
-         pgmoneta_stop_logging();
+   for (int i = 0; i < MAX_CONNECTIONS; i++)
+   {
+      connection = connections[i];
+      if (connection == NULL)
+      {
+         continue;
+      }
 
-         free(base_url);
+      /* Idle between requests or sending a response vs. stuck in the handshake or a request */
+      timeout = KEEP_ALIVE_TIMEOUT;
+      if (connection->state == CONNECTION_NEGOTIATE || connection->state == CONNECTION_HANDSHAKE ||
+          (connection->state == CONNECTION_READ && connection->request_length > 0))
+      {
+         timeout = config->authentication_timeout > 0 ? config->authentication_timeout : KEEP_ALIVE_TIMEOUT;
+      }
 
-         exit(0);
+      if (difftime(now, connection->last_active) > timeout)
+      {
+         connection_close(connection);
       }
    }
-   status = pgmoneta_read_timeout_message(client_ssl, client_fd, config->authentication_timeout, &msg);
 
-   if (status != MESSAGE_STATUS_OK)
+   metrics_refresh();
+}
+
+static void
+connection_close(struct metrics_connection* connection)
+{
+   ev_io_stop(metrics_loop, (struct ev_io*)connection);
+
+   for (int i = 0; i < MAX_CONNECTIONS; i++)
    {
-      goto error;
+      if (connections[i] == connection)
+      {
+         connections[i] = NULL;
+      }
+   }
+
+   pgmoneta_close_ssl(connection->ssl);
+   pgmoneta_disconnect(connection->socket);
+
+   free(connection->request);
+   free(connection->response);
+   free(connection);
+}
+
+static void
+connection_wait(struct metrics_connection* connection, int events)
+{
+   struct ev_io* io = (struct ev_io*)connection;
+
+   if ((io->events & (EV_READ | EV_WRITE)) == events)
+   {
+      return;
+   }
+
+   ev_io_stop(metrics_loop, io);
+   ev_io_set(io, connection->socket, events);
+   ev_io_start(metrics_loop, io);
+}
+
+static int
+connection_negotiate(struct metrics_connection* connection)
+{
+   unsigned char byte = 0;
+   ssize_t length;
+
+   length = recv(connection->socket, &byte, 1, MSG_PEEK);
+   if (length == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+   {
+      errno = 0;
+      return 0;
+   }
+   else if (length != 1)
+   {
+      return 1;
+   }
+
+   if (byte == 0x16 || byte == 0x80) // SSL/TLS request
+   {
+      connection->state = CONNECTION_HANDSHAKE;
+      return connection_handshake(connection);
+   }
+
+   /* A plain request on the TLS port is answered with a redirect to https */
+   pgmoneta_close_ssl(connection->ssl);
+   connection->ssl = NULL;
+   connection->redirect = true;
+   connection->state = CONNECTION_READ;
+
+   return connection_read(connection);
+}
+
+static int
+connection_handshake(struct metrics_connection* connection)
+{
+   int ret;
+
+   ERR_clear_error();
+   ret = SSL_accept(connection->ssl);
+
+   if (ret == 1)
+   {
+      connection->state = CONNECTION_READ;
+      return connection_read(connection);
+   }
+
+   if (ssl_status(connection, ret) == IO_AGAIN)
+   {
+      return 0;
+   }
+
+   pgmoneta_log_error("Failed to accept SSL connection");
+
+   return 1;
+}
+
+static int
+connection_read(struct metrics_connection* connection)
+{
+   char buffer[8192];
+   char* request = NULL;
+   ssize_t length = 0;
+   int status;
+
+   while (connection->request == NULL || strstr(connection->request, "\r\n\r\n") == NULL)
+   {
+      status = connection_recv(connection, buffer, sizeof(buffer), &length);
+      if (status == IO_AGAIN)
+      {
+         return 0;
+      }
+      else if (status != IO_DONE)
+      {
+         return 1;
+      }
+
+      if (connection->request_length + length > MAX_REQUEST_LENGTH)
+      {
+         pgmoneta_log_debug("Metrics: Request larger than %d bytes", MAX_REQUEST_LENGTH);
+         return 1;
+      }
+
+      request = (char*)realloc(connection->request, connection->request_length + length + 1);
+      if (request == NULL)
+      {
+         return 1;
+      }
+
+      memcpy(request + connection->request_length, buffer, length);
+      connection->request = request;
+      connection->request_length += length;
+      connection->request[connection->request_length] = '\0';
+   }
+
+   if (connection_respond(connection))
+   {
+      return 1;
+   }
+
+   connection->state = CONNECTION_WRITE;
+
+   return connection_write(connection);
+}
+
+static int
+connection_respond(struct metrics_connection* connection)
+{
+   size_t length;
+   struct message msg;
+
+   length = strstr(connection->request, "\r\n\r\n") - connection->request + 4;
+
+   memset(&msg, 0, sizeof(struct message));
+   msg.kind = 0;
+   msg.length = length;
+   msg.data = connection->request;
+
+   if (connection->redirect)
+   {
+      redirect_request(connection, &msg);
+   }
+   else
+   {
+      serve_request(connection, &msg);
+   }
+
+   /* Keep what the client sent after this request for the next round */
+   connection->request_length -= length;
+   memmove(connection->request, connection->request + length, connection->request_length + 1);
+
+   return connection->response_length == 0;
+}
+
+static int
+connection_write(struct metrics_connection* connection)
+{
+   ssize_t length = 0;
+   int status;
+
+   while (connection->response_offset < connection->response_length)
+   {
+      status = connection_send(connection, connection->response + connection->response_offset,
+                               connection->response_length - connection->response_offset, &length);
+      if (status == IO_AGAIN)
+      {
+         return 0;
+      }
+      else if (status != IO_DONE)
+      {
+         return 1;
+      }
+
+      connection->response_offset += length;
+   }
+
+   free(connection->response);
+   connection->response = NULL;
+   connection->response_length = 0;
+   connection->response_offset = 0;
+
+   if (!connection->keep_alive)
+   {
+      return 1;
+   }
+
+   connection->state = CONNECTION_READ;
+
+   return connection_read(connection);
+}
+
+static int
+connection_recv(struct metrics_connection* connection, void* buffer, size_t size, ssize_t* length)
+{
+   int ret;
+
+   *length = 0;
+
+   if (connection->ssl != NULL)
+   {
+      ERR_clear_error();
+      ret = SSL_read(connection->ssl, buffer, size);
+      if (ret > 0)
+      {
+         *length = ret;
+         return IO_DONE;
+      }
+
+      return ssl_status(connection, ret);
+   }
+
+   *length = recv(connection->socket, buffer, size, 0);
+   if (*length > 0)
+   {
+      return IO_DONE;
+   }
+   else if (*length == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+   {
+      errno = 0;
+      connection_wait(connection, EV_READ);
+      return IO_AGAIN;
+   }
+
+   /* The client closed the connection */
+   return IO_ERROR;
+}
+
+static int
+connection_send(struct metrics_connection* connection, void* buffer, size_t size, ssize_t* length)
+{
+   int ret;
+
+   *length = 0;
+
+   if (connection->ssl != NULL)
+   {
+      ERR_clear_error();
+      ret = SSL_write(connection->ssl, buffer, size);
+      if (ret > 0)
+      {
+         *length = ret;
+         return IO_DONE;
+      }
+
+      return ssl_status(connection, ret);
+   }
+
+   *length = send(connection->socket, buffer, size, MSG_NOSIGNAL);
+   if (*length > 0)
+   {
+      return IO_DONE;
+   }
+   else if (*length == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+   {
+      errno = 0;
+      connection_wait(connection, EV_WRITE);
+      return IO_AGAIN;
+   }
+
+   return IO_ERROR;
+}
+
+static int
+ssl_status(struct metrics_connection* connection, int ret)
+{
+   switch (SSL_get_error(connection->ssl, ret))
+   {
+      case SSL_ERROR_WANT_READ:
+         connection_wait(connection, EV_READ);
+         return IO_AGAIN;
+      case SSL_ERROR_WANT_WRITE:
+         connection_wait(connection, EV_WRITE);
+         return IO_AGAIN;
+      default:
+         return IO_ERROR;
    }
+}
+
+static int
+queue_message(struct metrics_connection* connection, struct message* msg)
+{
+   char* response = NULL;
+
+   response = (char*)realloc(connection->response, connection->response_length + msg->length);
+   if (response == NULL)
+   {
+      return MESSAGE_STATUS_ERROR;
+   }
+
+   memcpy(response + connection->response_length, msg->data, msg->length);
+   connection->response = response;
+   connection->response_length += msg->length;
+
+   return MESSAGE_STATUS_OK;
+}
+
+static void
+redirect_request(struct metrics_connection* connection, struct message* msg)
+{
+   char* path = "/";
+   char* path_start = NULL;
+   char* path_end = NULL;
+   char* base_url = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   connection->keep_alive = false;
+
+   path_start = strstr(msg->data, " ");
+   if (path_start)
+   {
+      path_start++;
+      path_end = strstr(path_start, " ");
+      if (path_end)
+      {
+         *path_end = '\0';
+         path = path_start;
+      }
+   }
+
+   base_url = pgmoneta_format_and_append(base_url, "https://localhost:%d%s", config->metrics, path);
+
+   if (redirect_page(connection, base_url) != MESSAGE_STATUS_OK)
+   {
+      pgmoneta_log_error("Failed to redirect to: %s", base_url);
+   }
+
+   free(base_url);
+}
+
+static void
+serve_request(struct metrics_connection* connection, struct message* msg)
+{
+   int page;
+   bool gzip = false;
+   bool persistent = false;
+
+   request_options(msg, &gzip, &persistent);
+   connection->keep_alive = persistent;
 
    page = resolve_page(msg);
 
    if (page == PAGE_HOME)
    {
-      home_page(client_ssl, client_fd);
+      if (home_page(connection) != MESSAGE_STATUS_OK)
+      {
+         connection->keep_alive = false;
+      }
    }
    else if (page == PAGE_METRICS)
    {
-      metrics_page(client_ssl, client_fd);
+      if (metrics_page(connection, gzip, connection->keep_alive))
+      {
+         connection->keep_alive = false;
+      }
    }
    else if (page == PAGE_UNKNOWN)
    {
-      unknown_page(client_ssl, client_fd);
+      unknown_page(connection);
+      connection->keep_alive = false;
    }
    else
    {
-      bad_request(client_ssl, client_fd);
+      bad_request(connection);
+      connection->keep_alive = false;
    }
+}
 
-   pgmoneta_close_ssl(client_ssl);
-   pgmoneta_disconnect(client_fd);
+static void
+request_options(struct message* msg, bool* gzip, bool* keep_alive)
+{
+   char* request = NULL;
+   char* eol = NULL;
 
-   pgmoneta_memory_destroy();
-   pgmoneta_stop_logging();
+   *gzip = false;
+   *keep_alive = false;
 
-   exit(0);
+   request = (char*)malloc(msg->length + 1);
+   if (request == NULL)
+   {
+      return;
+   }
 
-error:
+   /* Header names and the tokens we look for are case insensitive */
+   for (ssize_t i = 0; i < msg->length; i++)
+   {
+      request[i] = (char)tolower(*((unsigned char*)msg->data + i));
+   }
+   request[msg->length] = '\0';
 
-   pgmoneta_close_ssl(client_ssl);
-   pgmoneta_disconnect(client_fd);
+   /* HTTP/1.1 connections are persistent unless the client says otherwise */
+   eol = strstr(request, "\r\n");
+   if (eol != NULL)
+   {
+      *eol = '\0';
+      *keep_alive = strstr(request, "http/1.1") != NULL;
+      *eol = '\r';
+   }
 
-   pgmoneta_memory_destroy();
-   pgmoneta_stop_logging();
+   if (header_contains(request, "connection", "close"))
+   {
+      *keep_alive = false;
+   }
+   else if (header_contains(request, "connection", "keep-alive"))
+   {
+      *keep_alive = true;
+   }
 
-   exit(1);
+   *gzip = header_contains(request, "accept-encoding", "gzip");
+
+   free(request);
+}
+
+static bool
+header_contains(char* request, char* name, char* token)
+{
+   bool found = false;
+   char* key = NULL;
+   char* value = NULL;
+   char* eol = NULL;
+
+   key = pgmoneta_format_and_append(key, "\r\n%s:", name);
+
+   value = strstr(request, key);
+   if (value != NULL)
+   {
+      value += strlen(key);
+
+      eol = strstr(value, "\r\n");
+      if (eol != NULL)
+      {
+         *eol = '\0';
+      }
+
+      found = strstr(value, token) != NULL;
+
+      if (eol != NULL)
+      {
+         *eol = '\r';
+      }
+   }
+
+   free(key);
+
+   return found;
 }
 
 void
@@ -209,6 +925,8 @@ retry_cache_locking:
       atomic_store(&config->common.prometheus.logging_error, 0);
       atomic_store(&config->common.prometheus.logging_fatal, 0);
 
+      pgmoneta_instrument_reset();
+
       atomic_store(&cache->lock, STATE_FREE);
    }
    else
@@ -259,11 +977,16 @@ resolve_page(struct message* msg)
    index = 4;
    from = (char*)msg->data + index;
 
-   while (pgmoneta_read_byte(msg->data + index) != ' ')
+   while (index < msg->length && pgmoneta_read_byte(msg->data + index) != ' ')
    {
       index++;
    }
 
+   if (index >= msg->length)
+   {
+      return BAD_REQUEST;
+   }
+
    pgmoneta_write_byte(msg->data + index, '\0');
 
    if (strcmp(from, "/") == 0 || strcmp(from, "/index.html") == 0)
@@ -279,7 +1002,7 @@ resolve_page(struct message* msg)
 }
 
 static int
-redirect_page(SSL* client_ssl, int client_fd, char* path)
+redirect_page(struct metrics_connection* connection, char* path)
 {
    char* data = NULL;
    time_t now;
@@ -311,7 +1034,7 @@ redirect_page(SSL* client_ssl, int client_fd, char* path)
    msg.length = strlen(data);
    msg.data = data;
 
-   status = pgmoneta_write_message(client_ssl, client_fd, &msg);
+   status = queue_message(connection, &msg);
 
    free(data);
 
@@ -319,7 +1042,7 @@ redirect_page(SSL* client_ssl, int client_fd, char* path)
 }
 
 static int
-unknown_page(SSL* client_ssl, int client_fd)
+unknown_page(struct metrics_connection* connection)
 {
    char* data = NULL;
    time_t now;
@@ -345,7 +1068,7 @@ unknown_page(SSL* client_ssl, int client_fd)
    msg.length = strlen(data);
    msg.data = data;
 
-   status = pgmoneta_write_message(client_ssl, client_fd, &msg);
+   status = queue_message(connection, &msg);
 
    free(data);
 
@@ -353,7 +1076,7 @@ unknown_page(SSL* client_ssl, int client_fd)
 }
 
 static int
-home_page(SSL* client_ssl, int client_fd)
+home_page(struct metrics_connection* connection)
 {
    char* data = NULL;
    time_t now;
@@ -382,7 +1105,7 @@ home_page(SSL* client_ssl, int client_fd)
    msg.length = strlen(data);
    msg.data = data;
 
-   status = pgmoneta_write_message(client_ssl, client_fd, &msg);
+   status = queue_message(connection, &msg);
    if (status != MESSAGE_STATUS_OK)
    {
       goto done;
@@ -494,6 +1217,33 @@ home_page(SSL* client_ssl, int client_fd)
    data = pgmoneta_append(data, "  <h2>pgmoneta_server_last_failed_operation_time</h2>\n");
    data = pgmoneta_append(data, "  The time of the latest failed client operation of a server \n");
    data = pgmoneta_append(data, "  <p>\n");
+   data = pgmoneta_append(data, "  <h2>pgmoneta_server_verification_files</h2>\n");
+   data = pgmoneta_append(data, "  The number of files verified for a server\n");
+   data = pgmoneta_append(data, "  <p>\n");
+   data = pgmoneta_append(data, "  <h2>pgmoneta_server_verification_failed_files</h2>\n");
+   data = pgmoneta_append(data, "  The number of files that failed verification for a server\n");
+   data = pgmoneta_append(data, "  <p>\n");
+   data = pgmoneta_append(data, "  <h2>pgmoneta_server_verification_bytes</h2>\n");
+   data = pgmoneta_append(data, "  The number of bytes verified for a server\n");
+   data = pgmoneta_append(data, "  <p>\n");
+   data = pgmoneta_append(data, "  <h2>pgmoneta_server_verification_throughput</h2>\n");
+   data = pgmoneta_append(data, "  The throughput of the latest verification of a server in bytes per second\n");
+   data = pgmoneta_append(data, "  <p>\n");
+   data = pgmoneta_append(data, "  <h2>pgmoneta_server_last_verification_time</h2>\n");
+   data = pgmoneta_append(data, "  The time of the latest verification of a server\n");
+   data = pgmoneta_append(data, "  <p>\n");
+   data = pgmoneta_append(data, "  <h2>pgmoneta_server_trash_reclaimed_files</h2>\n");
+   data = pgmoneta_append(data, "  The number of files of deleted backups removed from the trash of a server\n");
+   data = pgmoneta_append(data, "  <p>\n");
+   data = pgmoneta_append(data, "  <h2>pgmoneta_server_trash_reclaimed_bytes</h2>\n");
+   data = pgmoneta_append(data, "  The number of bytes reclaimed from the trash of a server\n");
+   data = pgmoneta_append(data, "  <p>\n");
+   data = pgmoneta_append(data, "  <h2>pgmoneta_server_wal_archive_lag_bytes</h2>\n");
+   data = pgmoneta_append(data, "  The number of bytes of WAL received that aren't archived to object storage for a server\n");
+   data = pgmoneta_append(data, "  <p>\n");
+   data = pgmoneta_append(data, "  <h2>pgmoneta_server_wal_archive_lag_seconds</h2>\n");
+   data = pgmoneta_append(data, "  The age in seconds of the oldest WAL segment waiting to be archived to object storage for a server\n");
+   data = pgmoneta_append(data, "  <p>\n");
    data = pgmoneta_append(data, "  <h2>pgmoneta_wal_shipping</h2>\n");
    data = pgmoneta_append(data, "  The disk space used for WAL shipping for a server\n");
    data = pgmoneta_append(data, "  <p>\n");
@@ -1316,11 +2066,137 @@ home_page(SSL* client_ssl, int client_fd)
    data = pgmoneta_append(data, "    </tbody>\n");
    data = pgmoneta_append(data, "  </table>\n");
    data = pgmoneta_append(data, "  <p>\n");
+   data = pgmoneta_append(data, "  <h2>pgmoneta_phase_elapsed_seconds</h2>\n");
+   data = pgmoneta_append(data, "  The wall time of a workflow step\n");
+   data = pgmoneta_append(data, "  <table border=\"1\">\n");
+   data = pgmoneta_append(data, "    <tbody>\n");
+   data = pgmoneta_append(data, "      <tr>\n");
+   data = pgmoneta_append(data, "        <td>name</td>\n");
+   data = pgmoneta_append(data, "        <td>The identifier for the server</td>\n");
+   data = pgmoneta_append(data, "      </tr>\n");
+   data = pgmoneta_append(data, "      <tr>\n");
+   data = pgmoneta_append(data, "        <td>workflow</td>\n");
+   data = pgmoneta_append(data, "        <td>The workflow the step belongs to</td>\n");
+   data = pgmoneta_append(data, "      </tr>\n");
+   data = pgmoneta_append(data, "      <tr>\n");
+   data = pgmoneta_append(data, "        <td>phase</td>\n");
+   data = pgmoneta_append(data, "        <td>The name of the workflow step</td>\n");
+   data = pgmoneta_append(data, "      </tr>\n");
+   data = pgmoneta_append(data, "      <tr>\n");
+   data = pgmoneta_append(data, "        <td>le</td>\n");
+   data = pgmoneta_append(data, "        <td>The upper bound of the bucket in seconds</td>\n");
+   data = pgmoneta_append(data, "      </tr>\n");
+   data = pgmoneta_append(data, "    </tbody>\n");
+   data = pgmoneta_append(data, "  </table>\n");
+   data = pgmoneta_append(data, "  <p>\n");
+   data = pgmoneta_append(data, "  <h2>pgmoneta_phase_cpu_seconds</h2>\n");
+   data = pgmoneta_append(data, "  The CPU time of a workflow step\n");
+   data = pgmoneta_append(data, "  <table border=\"1\">\n");
+   data = pgmoneta_append(data, "    <tbody>\n");
+   data = pgmoneta_append(data, "      <tr>\n");
+   data = pgmoneta_append(data, "        <td>name</td>\n");
+   data = pgmoneta_append(data, "        <td>The identifier for the server</td>\n");
+   data = pgmoneta_append(data, "      </tr>\n");
+   data = pgmoneta_append(data, "      <tr>\n");
+   data = pgmoneta_append(data, "        <td>workflow</td>\n");
+   data = pgmoneta_append(data, "        <td>The workflow the step belongs to</td>\n");
+   data = pgmoneta_append(data, "      </tr>\n");
+   data = pgmoneta_append(data, "      <tr>\n");
+   data = pgmoneta_append(data, "        <td>phase</td>\n");
+   data = pgmoneta_append(data, "        <td>The name of the workflow step</td>\n");
+   data = pgmoneta_append(data, "      </tr>\n");
+   data = pgmoneta_append(data, "      <tr>\n");
+   data = pgmoneta_append(data, "        <td>le</td>\n");
+   data = pgmoneta_append(data, "        <td>The upper bound of the bucket in seconds</td>\n");
+   data = pgmoneta_append(data, "      </tr>\n");
+   data = pgmoneta_append(data, "    </tbody>\n");
+   data = pgmoneta_append(data, "  </table>\n");
+   data = pgmoneta_append(data, "  <p>\n");
+   data = pgmoneta_append(data, "  <h2>pgmoneta_phase_wait_seconds</h2>\n");
+   data = pgmoneta_append(data, "  The wall time of a workflow step not spent on the CPU\n");
+   data = pgmoneta_append(data, "  <table border=\"1\">\n");
+   data = pgmoneta_append(data, "    <tbody>\n");
+   data = pgmoneta_append(data, "      <tr>\n");
+   data = pgmoneta_append(data, "        <td>name</td>\n");
+   data = pgmoneta_append(data, "        <td>The identifier for the server</td>\n");
+   data = pgmoneta_append(data, "      </tr>\n");
+   data = pgmoneta_append(data, "      <tr>\n");
+   data = pgmoneta_append(data, "        <td>workflow</td>\n");
+   data = pgmoneta_append(data, "        <td>The workflow the step belongs to</td>\n");
+   data = pgmoneta_append(data, "      </tr>\n");
+   data = pgmoneta_append(data, "      <tr>\n");
+   data = pgmoneta_append(data, "        <td>phase</td>\n");
+   data = pgmoneta_append(data, "        <td>The name of the workflow step</td>\n");
+   data = pgmoneta_append(data, "      </tr>\n");
+   data = pgmoneta_append(data, "      <tr>\n");
+   data = pgmoneta_append(data, "        <td>le</td>\n");
+   data = pgmoneta_append(data, "        <td>The upper bound of the bucket in seconds</td>\n");
+   data = pgmoneta_append(data, "      </tr>\n");
+   data = pgmoneta_append(data, "    </tbody>\n");
+   data = pgmoneta_append(data, "  </table>\n");
+   data = pgmoneta_append(data, "  <p>\n");
+   data = pgmoneta_append(data, "  <h2>pgmoneta_phase_bytes_in</h2>\n");
+   data = pgmoneta_append(data, "  The bytes read by a workflow step\n");
+   data = pgmoneta_append(data, "  <table border=\"1\">\n");
+   data = pgmoneta_append(data, "    <tbody>\n");
+   data = pgmoneta_append(data, "      <tr>\n");
+   data = pgmoneta_append(data, "        <td>name</td>\n");
+   data = pgmoneta_append(data, "        <td>The identifier for the server</td>\n");
+   data = pgmoneta_append(data, "      </tr>\n");
+   data = pgmoneta_append(data, "      <tr>\n");
+   data = pgmoneta_append(data, "        <td>workflow</td>\n");
+   data = pgmoneta_append(data, "        <td>The workflow the step belongs to</td>\n");
+   data = pgmoneta_append(data, "      </tr>\n");
+   data = pgmoneta_append(data, "      <tr>\n");
+   data = pgmoneta_append(data, "        <td>phase</td>\n");
+   data = pgmoneta_append(data, "        <td>The name of the workflow step</td>\n");
+   data = pgmoneta_append(data, "      </tr>\n");
+   data = pgmoneta_append(data, "    </tbody>\n");
+   data = pgmoneta_append(data, "  </table>\n");
+   data = pgmoneta_append(data, "  <p>\n");
+   data = pgmoneta_append(data, "  <h2>pgmoneta_phase_bytes_out</h2>\n");
+   data = pgmoneta_append(data, "  The bytes written by a workflow step\n");
+   data = pgmoneta_append(data, "  <table border=\"1\">\n");
+   data = pgmoneta_append(data, "    <tbody>\n");
+   data = pgmoneta_append(data, "      <tr>\n");
+   data = pgmoneta_append(data, "        <td>name</td>\n");
+   data = pgmoneta_append(data, "        <td>The identifier for the server</td>\n");
+   data = pgmoneta_append(data, "      </tr>\n");
+   data = pgmoneta_append(data, "      <tr>\n");
+   data = pgmoneta_append(data, "        <td>workflow</td>\n");
+   data = pgmoneta_append(data, "        <td>The workflow the step belongs to</td>\n");
+   data = pgmoneta_append(data, "      </tr>\n");
+   data = pgmoneta_append(data, "      <tr>\n");
+   data = pgmoneta_append(data, "        <td>phase</td>\n");
+   data = pgmoneta_append(data, "        <td>The name of the workflow step</td>\n");
+   data = pgmoneta_append(data, "      </tr>\n");
+   data = pgmoneta_append(data, "    </tbody>\n");
+   data = pgmoneta_append(data, "  </table>\n");
+   data = pgmoneta_append(data, "  <p>\n");
+   data = pgmoneta_append(data, "  <h2>pgmoneta_phase_files</h2>\n");
+   data = pgmoneta_append(data, "  The files processed by a workflow step\n");
+   data = pgmoneta_append(data, "  <table border=\"1\">\n");
+   data = pgmoneta_append(data, "    <tbody>\n");
+   data = pgmoneta_append(data, "      <tr>\n");
+   data = pgmoneta_append(data, "        <td>name</td>\n");
+   data = pgmoneta_append(data, "        <td>The identifier for the server</td>\n");
+   data = pgmoneta_append(data, "      </tr>\n");
+   data = pgmoneta_append(data, "      <tr>\n");
+   data = pgmoneta_append(data, "        <td>workflow</td>\n");
+   data = pgmoneta_append(data, "        <td>The workflow the step belongs to</td>\n");
+   data = pgmoneta_append(data, "      </tr>\n");
+   data = pgmoneta_append(data, "      <tr>\n");
+   data = pgmoneta_append(data, "        <td>phase</td>\n");
+   data = pgmoneta_append(data, "        <td>The name of the workflow step</td>\n");
+   data = pgmoneta_append(data, "      </tr>\n");
+   data = pgmoneta_append(data, "    </tbody>\n");
+   data = pgmoneta_append(data, "  </table>\n");
+   data = pgmoneta_append(data, "  <p>\n");
    data = pgmoneta_append(data, "  <a href=\"https://pgmoneta.github.io/\">pgmoneta.github.io/</a>\n");
    data = pgmoneta_append(data, "</body>\n");
    data = pgmoneta_append(data, "</html>\n");
 
-   send_chunk(client_ssl, client_fd, data);
+   send_chunk(connection, data);
    free(data);
    data = NULL;
 
@@ -1331,125 +2207,216 @@ home_page(SSL* client_ssl, int client_fd)
    msg.length = strlen(data);
    msg.data = data;
 
-   status = pgmoneta_write_message(client_ssl, client_fd, &msg);
+   status = queue_message(connection, &msg);
+
+done:
+   if (data != NULL)
+   {
+      free(data);
+   }
+
+   return status;
+}
+
+static int
+metrics_page(struct metrics_connection* connection, bool gzip, bool keep_alive)
+{
+   char* data = NULL;
+   time_t now;
+   char time_buf[32];
+   int status;
+   struct message msg;
+
+   memset(&msg, 0, sizeof(struct message));
+
+   // the refresher renders the metrics, so only do it here when it never ran
+   if (metrics_body == NULL)
+   {
+      metrics_refresh();
+
+      if (metrics_body == NULL)
+      {
+         goto error;
+      }
+   }
+
+   if (metrics_compressed == NULL)
+   {
+      gzip = false;
+   }
+
+   now = time(NULL);
+
+   memset(&time_buf, 0, sizeof(time_buf));
+   ctime_r(&now, &time_buf[0]);
+   time_buf[strlen(time_buf) - 1] = 0;
+
+   data = pgmoneta_append(data, "HTTP/1.1 200 OK\r\n");
+   data = pgmoneta_append(data, "Content-Type: text/plain; version=0.0.1; charset=utf-8\r\n");
+   data = pgmoneta_append(data, "Date: ");
+   data = pgmoneta_append(data, &time_buf[0]);
+   data = pgmoneta_append(data, "\r\n");
+   data = pgmoneta_append(data, "Content-Length: ");
+   data = pgmoneta_append_ulong(data, gzip ? metrics_compressed_length : metrics_body_length);
+   data = pgmoneta_append(data, "\r\n");
+   if (gzip)
+   {
+      data = pgmoneta_append(data, "Content-Encoding: gzip\r\n");
+   }
+   data = pgmoneta_append(data, "Vary: Accept-Encoding\r\n");
+   if (keep_alive)
+   {
+      data = pgmoneta_append(data, "Connection: keep-alive\r\n");
+      data = pgmoneta_append(data, "Keep-Alive: timeout=");
+      data = pgmoneta_append_int(data, KEEP_ALIVE_TIMEOUT);
+      data = pgmoneta_append(data, "\r\n");
+   }
+   else
+   {
+      data = pgmoneta_append(data, "Connection: close\r\n");
+   }
+   data = pgmoneta_append(data, "\r\n");
+
+   msg.kind = 0;
+   msg.length = strlen(data);
+   msg.data = data;
+
+   status = queue_message(connection, &msg);
+   if (status != MESSAGE_STATUS_OK)
+   {
+      goto error;
+   }
+
+   msg.kind = 0;
+   msg.length = gzip ? metrics_compressed_length : metrics_body_length;
+   msg.data = gzip ? (void*)metrics_compressed : (void*)metrics_body;
 
-done:
-   if (data != NULL)
+   status = queue_message(connection, &msg);
+   if (status != MESSAGE_STATUS_OK)
    {
-      free(data);
+      goto error;
    }
 
-   return status;
+   free(data);
+
+   return 0;
+
+error:
+
+   free(data);
+
+   return 1;
 }
 
-static int
-metrics_page(SSL* client_ssl, int client_fd)
+/**
+ * Renders the metrics served to the clients.
+ *
+ * Runs from the refresh timer, so a scrape never waits for
+ * the rendering. With the cache configured the metrics are
+ * taken from the cache, which is rebuilt once it expires.
+ * Otherwise, or when the metrics do not fit in the cache,
+ * they are rendered on every refresh.
+ */
+static void
+metrics_refresh(void)
 {
-   char* data = NULL;
-   time_t now;
-   char time_buf[32];
-   int status;
-   struct message msg;
-   struct prometheus_cache* cache;
+   char* body = NULL;
+   unsigned char* compressed = NULL;
+   size_t body_length = 0;
+   size_t compressed_length = 0;
    signed char cache_is_free;
+   struct prometheus_cache* cache;
 
    cache = (struct prometheus_cache*)prometheus_cache_shmem;
 
-   memset(&msg, 0, sizeof(struct message));
-
-retry_cache_locking:
-   cache_is_free = STATE_FREE;
-   if (atomic_compare_exchange_strong(&cache->lock, &cache_is_free, STATE_IN_USE))
+   if (is_metrics_cache_configured())
    {
-      // can serve the message out of cache?
-      if (is_metrics_cache_configured() && is_metrics_cache_valid())
+      cache_is_free = STATE_FREE;
+      if (!atomic_compare_exchange_strong(&cache->lock, &cache_is_free, STATE_IN_USE))
       {
-         // serve the message directly out of the cache
-         pgmoneta_log_debug("Serving metrics out of cache (%d/%d bytes valid until %lld)",
-                            strlen(cache->data),
-                            cache->size,
-                            cache->valid_until);
-
-         msg.kind = 0;
-         msg.length = strlen(cache->data);
-         msg.data = cache->data;
+         /* A reset holds the lock, so try again on the next round */
+         return;
       }
-      else
-      {
-         // build the message without the cache
-         metrics_cache_invalidate();
-
-         now = time(NULL);
-
-         memset(&time_buf, 0, sizeof(time_buf));
-         ctime_r(&now, &time_buf[0]);
-         time_buf[strlen(time_buf) - 1] = 0;
-
-         data = pgmoneta_append(data, "HTTP/1.1 200 OK\r\n");
-         data = pgmoneta_append(data, "Content-Type: text/plain; version=0.0.1; charset=utf-8\r\n");
-         data = pgmoneta_append(data, "Date: ");
-         data = pgmoneta_append(data, &time_buf[0]);
-         data = pgmoneta_append(data, "\r\n");
-         data = pgmoneta_append(data, "Transfer-Encoding: chunked\r\n");
-         data = pgmoneta_append(data, "\r\n");
-         metrics_cache_append(data);
 
-         msg.kind = 0;
-         msg.length = strlen(data);
-         msg.data = data;
+      if (!is_metrics_cache_valid())
+      {
+         metrics_cache_refresh();
+      }
 
-         status = pgmoneta_write_message(client_ssl, client_fd, &msg);
-         if (status != MESSAGE_STATUS_OK)
+      if (is_metrics_cache_valid())
+      {
+         if (metrics_body != NULL && metrics_valid_until == cache->valid_until)
          {
-            goto error;
+            /* Already serving this version of the cache */
+            atomic_store(&cache->lock, STATE_FREE);
+            return;
          }
 
-         free(data);
-         data = NULL;
-
-         general_information(client_ssl, client_fd);
-         backup_information(client_ssl, client_fd);
-         size_information(client_ssl, client_fd);
-
-         /* Footer */
-         data = pgmoneta_append(data, "0\r\n\r\n");
-         metrics_cache_append(data);
-
-         msg.kind = 0;
-         msg.length = strlen(data);
-         msg.data = data;
+         body = (char*)malloc(cache->length + 1);
+         if (body != NULL)
+         {
+            memcpy(body, cache->data, cache->length);
+            body[cache->length] = '\0';
+            body_length = cache->length;
+            metrics_valid_until = cache->valid_until;
 
-         metrics_cache_finalize();
+            if (cache->compressed_length > 0)
+            {
+               compressed = (unsigned char*)malloc(cache->compressed_length);
+               if (compressed != NULL)
+               {
+                  memcpy(compressed, cache->data + cache->length + 1, cache->compressed_length);
+                  compressed_length = cache->compressed_length;
+               }
+            }
+         }
       }
 
-      // free the cache
       atomic_store(&cache->lock, STATE_FREE);
    }
-   else
+
+   if (body == NULL)
    {
-      /* Sleep for 1ms */
-      SLEEP_AND_GOTO(1000000L, retry_cache_locking)
+      body = render_metrics();
+      body_length = strlen(body);
+      metrics_valid_until = 0;
    }
 
-   status = pgmoneta_write_message(client_ssl, client_fd, &msg);
-   if (status != MESSAGE_STATUS_OK)
+   if (compressed == NULL && pgmoneta_gzip_string(body, &compressed, &compressed_length))
    {
-      goto error;
+      compressed = NULL;
+      compressed_length = 0;
    }
 
-   free(data);
+   free(metrics_body);
+   free(metrics_compressed);
 
-   return 0;
+   metrics_body = body;
+   metrics_body_length = body_length;
+   metrics_compressed = compressed;
+   metrics_compressed_length = compressed_length;
+}
 
-error:
+static char*
+render_metrics(void)
+{
+   char* body = NULL;
 
-   free(data);
+   general_information(&body);
+   backup_information(&body);
+   size_information(&body);
+   phase_information(&body);
 
-   return 1;
+   if (body == NULL)
+   {
+      body = pgmoneta_append(body, "");
+   }
+
+   return body;
 }
 
 static int
-bad_request(SSL* client_ssl, int client_fd)
+bad_request(struct metrics_connection* connection)
 {
    char* data = NULL;
    time_t now;
@@ -1475,7 +2442,7 @@ bad_request(SSL* client_ssl, int client_fd)
    msg.length = strlen(data);
    msg.data = data;
 
-   status = pgmoneta_write_message(client_ssl, client_fd, &msg);
+   status = queue_message(connection, &msg);
 
    free(data);
 
@@ -1483,7 +2450,7 @@ bad_request(SSL* client_ssl, int client_fd)
 }
 
 static void
-general_information(SSL* client_ssl, int client_fd)
+general_information(char** body)
 {
    char* d;
    unsigned long size;
@@ -1626,10 +2593,7 @@ general_information(SSL* client_ssl, int client_fd)
 
    d = NULL;
 
-   d = pgmoneta_append(d, config->base_dir);
-   d = pgmoneta_append(d, "/");
-
-   size = pgmoneta_directory_size(d);
+   size = pgmoneta_used_space();
 
    data = pgmoneta_append(data, "#HELP pgmoneta_used_space The disk space used for pgmoneta\n");
    data = pgmoneta_append(data, "#TYPE pgmoneta_used_space gauge\n");
@@ -1637,10 +2601,6 @@ general_information(SSL* client_ssl, int client_fd)
    data = pgmoneta_append_ulong(data, size);
    data = pgmoneta_append(data, "\n\n");
 
-   free(d);
-
-   d = NULL;
-
    d = pgmoneta_append(d, config->base_dir);
    d = pgmoneta_append(d, "/");
 
@@ -1713,7 +2673,7 @@ general_information(SSL* client_ssl, int client_fd)
       d = pgmoneta_get_server_wal_shipping(i);
       if (d != NULL)
       {
-         size = pgmoneta_directory_size(d);
+         size = pgmoneta_disk_usage(i, DISK_USAGE_WAL_SHIPPING);
          data = pgmoneta_append_ulong(data, size);
       }
       else
@@ -1889,23 +2849,7 @@ general_information(SSL* client_ssl, int client_fd)
       data = pgmoneta_append(data, config->common.servers[i].name);
       data = pgmoneta_append(data, "\"} ");
 
-      size = 0;
-      for (int j = 0; j < config->common.servers[i].number_of_hot_standbys; j++)
-      {
-         d = pgmoneta_append(d, config->common.servers[i].hot_standby[j]);
-         if (!pgmoneta_ends_with(d, "/"))
-         {
-            d = pgmoneta_append_char(d, '/');
-         }
-         d = pgmoneta_append(d, config->common.servers[i].name);
-
-         if (pgmoneta_exists(d))
-         {
-            size += pgmoneta_directory_size(d);
-         }
-         free(d);
-         d = NULL;
-      }
+      size = pgmoneta_disk_usage(i, DISK_USAGE_HOT_STANDBY);
       data = pgmoneta_append_ulong(data, size);
       data = pgmoneta_append(data, "\n");
    }
@@ -2074,191 +3018,374 @@ general_information(SSL* client_ssl, int client_fd)
          data = pgmoneta_append(data, config->common.servers[i].name);
          data = pgmoneta_append(data, "\", ");
 
-         data = pgmoneta_append(data, "tli=\"");
-         data = pgmoneta_append_int(data, tli);
-         data = pgmoneta_append(data, "\", ");
+         data = pgmoneta_append(data, "tli=\"");
+         data = pgmoneta_append_int(data, tli);
+         data = pgmoneta_append(data, "\", ");
+
+         data = pgmoneta_append(data, "walpos=\"");
+         data = pgmoneta_append(data, xlogpos);
+         data = pgmoneta_append(data, "\"} ");
+
+         data = pgmoneta_append_int(data, 1);
+
+         data = pgmoneta_append(data, "\n");
+
+         curh = curh->next;
+         tli++;
+      }
+      pgmoneta_free_timeline_history(history);
+   }
+   data = pgmoneta_append(data, "\n");
+
+   data = pgmoneta_append(data, "#HELP pgmoneta_server_workers The numbeer of workers for a server\n");
+   data = pgmoneta_append(data, "#TYPE pgmoneta_server_workers gauge\n");
+   for (int i = 0; i < config->common.number_of_servers; i++)
+   {
+      int workers = config->common.servers[i].workers != -1 ? config->common.servers[i].workers : config->workers;
+
+      data = pgmoneta_append(data, "pgmoneta_server_workers{");
+
+      data = pgmoneta_append(data, "name=\"");
+      data = pgmoneta_append(data, config->common.servers[i].name);
+      data = pgmoneta_append(data, "\"} ");
+
+      data = pgmoneta_append_int(data, workers);
+
+      data = pgmoneta_append(data, "\n");
+   }
+   data = pgmoneta_append(data, "\n");
+
+   data = pgmoneta_append(data, "#HELP pgmoneta_server_online Is the server in an online state\n");
+   data = pgmoneta_append(data, "#TYPE pgmoneta_server_online gauge\n");
+   for (int i = 0; i < config->common.number_of_servers; i++)
+   {
+      data = pgmoneta_append(data, "pgmoneta_server_online{");
+
+      data = pgmoneta_append(data, "name=\"");
+      data = pgmoneta_append(data, config->common.servers[i].name);
+      data = pgmoneta_append(data, "\"} ");
+
+      data = pgmoneta_append_bool(data, config->common.servers[i].online);
+
+      data = pgmoneta_append(data, "\n");
+   }
+   data = pgmoneta_append(data, "\n");
+
+   data = pgmoneta_append(data, "#HELP pgmoneta_server_primary Is the server a primary\n");
+   data = pgmoneta_append(data, "#TYPE pgmoneta_server_primary gauge\n");
+   for (int i = 0; i < config->common.number_of_servers; i++)
+   {
+      data = pgmoneta_append(data, "pgmoneta_server_primary{");
+
+      data = pgmoneta_append(data, "name=\"");
+      data = pgmoneta_append(data, config->common.servers[i].name);
+      data = pgmoneta_append(data, "\"} ");
+
+      data = pgmoneta_append_bool(data, config->common.servers[i].primary);
+
+      data = pgmoneta_append(data, "\n");
+   }
+   data = pgmoneta_append(data, "\n");
+
+   data = pgmoneta_append(data, "#HELP pgmoneta_server_valid Is the server in a valid state\n");
+   data = pgmoneta_append(data, "#TYPE pgmoneta_server_valid gauge\n");
+   for (int i = 0; i < config->common.number_of_servers; i++)
+   {
+      data = pgmoneta_append(data, "pgmoneta_server_valid{");
+
+      data = pgmoneta_append(data, "name=\"");
+      data = pgmoneta_append(data, config->common.servers[i].name);
+      data = pgmoneta_append(data, "\"} ");
+
+      data = pgmoneta_append_bool(data, config->common.servers[i].valid);
+
+      data = pgmoneta_append(data, "\n");
+   }
+   data = pgmoneta_append(data, "\n");
+
+   data = pgmoneta_append(data, "#HELP pgmoneta_wal_streaming The WAL streaming status of a server\n");
+   data = pgmoneta_append(data, "#TYPE pgmoneta_wal_streaming gauge\n");
+   for (int i = 0; i < config->common.number_of_servers; i++)
+   {
+      data = pgmoneta_append(data, "pgmoneta_wal_streaming{");
+
+      data = pgmoneta_append(data, "name=\"");
+      data = pgmoneta_append(data, config->common.servers[i].name);
+      data = pgmoneta_append(data, "\"} ");
+
+      data = pgmoneta_append_bool(data, config->common.servers[i].wal_streaming > 0);
+
+      data = pgmoneta_append(data, "\n");
+   }
+   data = pgmoneta_append(data, "\n");
+
+   data = pgmoneta_append(data, "#HELP pgmoneta_server_operation_count The count of client operations of a server\n");
+   data = pgmoneta_append(data, "#TYPE pgmoneta_server_operation_count gauge\n");
+   for (int i = 0; i < config->common.number_of_servers; i++)
+   {
+      data = pgmoneta_append(data, "pgmoneta_server_operation_count{");
+
+      data = pgmoneta_append(data, "name=\"");
+      data = pgmoneta_append(data, config->common.servers[i].name);
+      data = pgmoneta_append(data, "\"} ");
+
+      data = pgmoneta_append_ulong(data, atomic_load(&config->common.servers[i].operation_count));
+
+      data = pgmoneta_append(data, "\n");
+   }
+   data = pgmoneta_append(data, "\n");
+
+   data = pgmoneta_append(data, "#HELP pgmoneta_server_failed_operation_count The count of failed client operations of a server\n");
+   data = pgmoneta_append(data, "#TYPE pgmoneta_server_failed_operation_count gauge\n");
+   for (int i = 0; i < config->common.number_of_servers; i++)
+   {
+      data = pgmoneta_append(data, "pgmoneta_server_failed_operation_count{");
+
+      data = pgmoneta_append(data, "name=\"");
+      data = pgmoneta_append(data, config->common.servers[i].name);
+      data = pgmoneta_append(data, "\"} ");
+
+      data = pgmoneta_append_ulong(data, atomic_load(&config->common.servers[i].failed_operation_count));
+
+      data = pgmoneta_append(data, "\n");
+   }
+   data = pgmoneta_append(data, "\n");
+
+   data = pgmoneta_append(data, "#HELP pgmoneta_server_last_operation_time The time of the latest client operation of a server\n");
+   data = pgmoneta_append(data, "#TYPE pgmoneta_server_last_operation_time gauge\n");
+   for (int i = 0; i < config->common.number_of_servers; i++)
+   {
+      data = pgmoneta_append(data, "pgmoneta_server_last_operation_time{");
+
+      data = pgmoneta_append(data, "name=\"");
+      data = pgmoneta_append(data, config->common.servers[i].name);
+      data = pgmoneta_append(data, "\"} ");
+
+      if (atomic_load(&config->common.servers[i].operation_count) > 0)
+      {
+         memset(&time_str[0], 0, sizeof(time_str));
+         t = (time_t)atomic_load(&config->common.servers[i].last_operation_time);
+         time_info = localtime(&t);
+         strftime(&time_str[0], sizeof(time_str), "%Y%m%d%H%M%S", time_info);
+
+         data = pgmoneta_append(data, time_str);
+      }
+      else
+      {
+         data = pgmoneta_append_int(data, 0);
+      }
+
+      data = pgmoneta_append(data, "\n");
+   }
+   data = pgmoneta_append(data, "\n");
 
-         data = pgmoneta_append(data, "walpos=\"");
-         data = pgmoneta_append(data, xlogpos);
-         data = pgmoneta_append(data, "\"} ");
+   data = pgmoneta_append(data, "#HELP pgmoneta_server_last_failed_operation_time The time of the latest failed client operation of a server\n");
+   data = pgmoneta_append(data, "#TYPE pgmoneta_server_last_failed_operation_time gauge\n");
+   for (int i = 0; i < config->common.number_of_servers; i++)
+   {
+      data = pgmoneta_append(data, "pgmoneta_server_last_failed_operation_time{");
 
-         data = pgmoneta_append_int(data, 1);
+      data = pgmoneta_append(data, "name=\"");
+      data = pgmoneta_append(data, config->common.servers[i].name);
+      data = pgmoneta_append(data, "\"} ");
 
-         data = pgmoneta_append(data, "\n");
+      if (atomic_load(&config->common.servers[i].failed_operation_count) > 0)
+      {
+         memset(&time_str[0], 0, sizeof(time_str));
+         t = (time_t)atomic_load(&config->common.servers[i].last_failed_operation_time);
+         time_info = localtime(&t);
+         strftime(&time_str[0], sizeof(time_str), "%Y%m%d%H%M%S", time_info);
 
-         curh = curh->next;
-         tli++;
+         data = pgmoneta_append(data, time_str);
       }
-      pgmoneta_free_timeline_history(history);
+      else
+      {
+         data = pgmoneta_append_int(data, 0);
+      }
+
+      data = pgmoneta_append(data, "\n");
    }
    data = pgmoneta_append(data, "\n");
 
-   data = pgmoneta_append(data, "#HELP pgmoneta_server_workers The numbeer of workers for a server\n");
-   data = pgmoneta_append(data, "#TYPE pgmoneta_server_workers gauge\n");
+   data = pgmoneta_append(data, "#HELP pgmoneta_server_verification_files The number of files verified for a server\n");
+   data = pgmoneta_append(data, "#TYPE pgmoneta_server_verification_files gauge\n");
    for (int i = 0; i < config->common.number_of_servers; i++)
    {
-      int workers = config->common.servers[i].workers != -1 ? config->common.servers[i].workers : config->workers;
-
-      data = pgmoneta_append(data, "pgmoneta_server_workers{");
+      data = pgmoneta_append(data, "pgmoneta_server_verification_files{");
 
       data = pgmoneta_append(data, "name=\"");
       data = pgmoneta_append(data, config->common.servers[i].name);
       data = pgmoneta_append(data, "\"} ");
 
-      data = pgmoneta_append_int(data, workers);
+      data = pgmoneta_append_ulong(data, atomic_load(&config->common.servers[i].verification_files));
 
       data = pgmoneta_append(data, "\n");
    }
    data = pgmoneta_append(data, "\n");
 
-   data = pgmoneta_append(data, "#HELP pgmoneta_server_online Is the server in an online state\n");
-   data = pgmoneta_append(data, "#TYPE pgmoneta_server_online gauge\n");
+   data = pgmoneta_append(data, "#HELP pgmoneta_server_verification_failed_files The number of files that failed verification for a server\n");
+   data = pgmoneta_append(data, "#TYPE pgmoneta_server_verification_failed_files gauge\n");
    for (int i = 0; i < config->common.number_of_servers; i++)
    {
-      data = pgmoneta_append(data, "pgmoneta_server_online{");
+      data = pgmoneta_append(data, "pgmoneta_server_verification_failed_files{");
 
       data = pgmoneta_append(data, "name=\"");
       data = pgmoneta_append(data, config->common.servers[i].name);
       data = pgmoneta_append(data, "\"} ");
 
-      data = pgmoneta_append_bool(data, config->common.servers[i].online);
+      data = pgmoneta_append_ulong(data, atomic_load(&config->common.servers[i].verification_failed_files));
 
       data = pgmoneta_append(data, "\n");
    }
    data = pgmoneta_append(data, "\n");
 
-   data = pgmoneta_append(data, "#HELP pgmoneta_server_primary Is the server a primary\n");
-   data = pgmoneta_append(data, "#TYPE pgmoneta_server_primary gauge\n");
+   data = pgmoneta_append(data, "#HELP pgmoneta_server_verification_bytes The number of bytes verified for a server\n");
+   data = pgmoneta_append(data, "#TYPE pgmoneta_server_verification_bytes gauge\n");
    for (int i = 0; i < config->common.number_of_servers; i++)
    {
-      data = pgmoneta_append(data, "pgmoneta_server_primary{");
+      data = pgmoneta_append(data, "pgmoneta_server_verification_bytes{");
 
       data = pgmoneta_append(data, "name=\"");
       data = pgmoneta_append(data, config->common.servers[i].name);
       data = pgmoneta_append(data, "\"} ");
 
-      data = pgmoneta_append_bool(data, config->common.servers[i].primary);
+      data = pgmoneta_append_ulong(data, atomic_load(&config->common.servers[i].verification_bytes));
 
       data = pgmoneta_append(data, "\n");
    }
    data = pgmoneta_append(data, "\n");
 
-   data = pgmoneta_append(data, "#HELP pgmoneta_server_valid Is the server in a valid state\n");
-   data = pgmoneta_append(data, "#TYPE pgmoneta_server_valid gauge\n");
+   data = pgmoneta_append(data, "#HELP pgmoneta_server_verification_throughput The throughput of the latest verification of a server in bytes per second\n");
+   data = pgmoneta_append(data, "#TYPE pgmoneta_server_verification_throughput gauge\n");
    for (int i = 0; i < config->common.number_of_servers; i++)
    {
-      data = pgmoneta_append(data, "pgmoneta_server_valid{");
+      data = pgmoneta_append(data, "pgmoneta_server_verification_throughput{");
 
       data = pgmoneta_append(data, "name=\"");
       data = pgmoneta_append(data, config->common.servers[i].name);
       data = pgmoneta_append(data, "\"} ");
 
-      data = pgmoneta_append_bool(data, config->common.servers[i].valid);
+      data = pgmoneta_append_ulong(data, atomic_load(&config->common.servers[i].verification_throughput));
 
       data = pgmoneta_append(data, "\n");
    }
    data = pgmoneta_append(data, "\n");
 
-   data = pgmoneta_append(data, "#HELP pgmoneta_wal_streaming The WAL streaming status of a server\n");
-   data = pgmoneta_append(data, "#TYPE pgmoneta_wal_streaming gauge\n");
+   data = pgmoneta_append(data, "#HELP pgmoneta_server_last_verification_time The time of the latest verification of a server\n");
+   data = pgmoneta_append(data, "#TYPE pgmoneta_server_last_verification_time gauge\n");
    for (int i = 0; i < config->common.number_of_servers; i++)
    {
-      data = pgmoneta_append(data, "pgmoneta_wal_streaming{");
+      data = pgmoneta_append(data, "pgmoneta_server_last_verification_time{");
 
       data = pgmoneta_append(data, "name=\"");
       data = pgmoneta_append(data, config->common.servers[i].name);
       data = pgmoneta_append(data, "\"} ");
 
-      data = pgmoneta_append_bool(data, config->common.servers[i].wal_streaming > 0);
+      if (atomic_load(&config->common.servers[i].last_verification_time) > 0)
+      {
+         memset(&time_str[0], 0, sizeof(time_str));
+         t = (time_t)atomic_load(&config->common.servers[i].last_verification_time);
+         time_info = localtime(&t);
+         strftime(&time_str[0], sizeof(time_str), "%Y%m%d%H%M%S", time_info);
+
+         data = pgmoneta_append(data, time_str);
+      }
+      else
+      {
+         data = pgmoneta_append_int(data, 0);
+      }
 
       data = pgmoneta_append(data, "\n");
    }
    data = pgmoneta_append(data, "\n");
 
-   data = pgmoneta_append(data, "#HELP pgmoneta_server_operation_count The count of client operations of a server\n");
-   data = pgmoneta_append(data, "#TYPE pgmoneta_server_operation_count gauge\n");
+   data = pgmoneta_append(data, "#HELP pgmoneta_server_trash_reclaimed_files The number of files of deleted backups removed from the trash of a server\n");
+   data = pgmoneta_append(data, "#TYPE pgmoneta_server_trash_reclaimed_files counter\n");
    for (int i = 0; i < config->common.number_of_servers; i++)
    {
-      data = pgmoneta_append(data, "pgmoneta_server_operation_count{");
+      data = pgmoneta_append(data, "pgmoneta_server_trash_reclaimed_files{");
 
       data = pgmoneta_append(data, "name=\"");
       data = pgmoneta_append(data, config->common.servers[i].name);
       data = pgmoneta_append(data, "\"} ");
 
-      data = pgmoneta_append_ulong(data, atomic_load(&config->common.servers[i].operation_count));
+      data = pgmoneta_append_ulong(data, atomic_load(&config->common.servers[i].trash_reclaimed_files));
 
       data = pgmoneta_append(data, "\n");
    }
    data = pgmoneta_append(data, "\n");
 
-   data = pgmoneta_append(data, "#HELP pgmoneta_server_failed_operation_count The count of failed client operations of a server\n");
-   data = pgmoneta_append(data, "#TYPE pgmoneta_server_failed_operation_count gauge\n");
+   data = pgmoneta_append(data, "#HELP pgmoneta_server_trash_reclaimed_bytes The number of bytes reclaimed from the trash of a server\n");
+   data = pgmoneta_append(data, "#TYPE pgmoneta_server_trash_reclaimed_bytes counter\n");
    for (int i = 0; i < config->common.number_of_servers; i++)
    {
-      data = pgmoneta_append(data, "pgmoneta_server_failed_operation_count{");
+      data = pgmoneta_append(data, "pgmoneta_server_trash_reclaimed_bytes{");
 
       data = pgmoneta_append(data, "name=\"");
       data = pgmoneta_append(data, config->common.servers[i].name);
       data = pgmoneta_append(data, "\"} ");
 
-      data = pgmoneta_append_ulong(data, atomic_load(&config->common.servers[i].failed_operation_count));
+      data = pgmoneta_append_ulong(data, (unsigned long)atomic_load(&config->common.servers[i].trash_reclaimed_bytes));
 
       data = pgmoneta_append(data, "\n");
    }
    data = pgmoneta_append(data, "\n");
 
-   data = pgmoneta_append(data, "#HELP pgmoneta_server_last_operation_time The time of the latest client operation of a server\n");
-   data = pgmoneta_append(data, "#TYPE pgmoneta_server_last_operation_time gauge\n");
+   data = pgmoneta_append(data, "#HELP pgmoneta_server_wal_archive_lag_bytes The number of bytes of WAL received that aren't archived to object storage\n");
+   data = pgmoneta_append(data, "#TYPE pgmoneta_server_wal_archive_lag_bytes gauge\n");
    for (int i = 0; i < config->common.number_of_servers; i++)
    {
-      data = pgmoneta_append(data, "pgmoneta_server_last_operation_time{");
+      uint32_t high32 = 0;
+      uint32_t low32 = 0;
+      uint64_t current_lsn = 0;
+      uint64_t archive_lsn = 0;
+      uint64_t lag = 0;
+
+      data = pgmoneta_append(data, "pgmoneta_server_wal_archive_lag_bytes{");
 
       data = pgmoneta_append(data, "name=\"");
       data = pgmoneta_append(data, config->common.servers[i].name);
       data = pgmoneta_append(data, "\"} ");
 
-      if (atomic_load(&config->common.servers[i].operation_count) > 0)
+      if (config->storage_engine & (STORAGE_ENGINE_S3 | STORAGE_ENGINE_AZURE) &&
+          sscanf(config->common.servers[i].current_wal_lsn, "%X/%X", &high32, &low32) == 2)
       {
-         memset(&time_str[0], 0, sizeof(time_str));
-         t = (time_t)atomic_load(&config->common.servers[i].last_operation_time);
-         time_info = localtime(&t);
-         strftime(&time_str[0], sizeof(time_str), "%Y%m%d%H%M%S", time_info);
+         current_lsn = ((uint64_t)high32 << 32) | low32;
+         archive_lsn = atomic_load(&config->common.servers[i].wal_archive_lsn);
 
-         data = pgmoneta_append(data, time_str);
-      }
-      else
-      {
-         data = pgmoneta_append_int(data, 0);
+         if (current_lsn > archive_lsn)
+         {
+            lag = current_lsn - archive_lsn;
+         }
       }
 
+      data = pgmoneta_append_ulong(data, lag);
+
       data = pgmoneta_append(data, "\n");
    }
    data = pgmoneta_append(data, "\n");
 
-   data = pgmoneta_append(data, "#HELP pgmoneta_server_last_failed_operation_time The time of the latest failed client operation of a server\n");
-   data = pgmoneta_append(data, "#TYPE pgmoneta_server_last_failed_operation_time gauge\n");
+   data = pgmoneta_append(data, "#HELP pgmoneta_server_wal_archive_lag_seconds The age of the oldest WAL segment waiting to be archived to object storage\n");
+   data = pgmoneta_append(data, "#TYPE pgmoneta_server_wal_archive_lag_seconds gauge\n");
    for (int i = 0; i < config->common.number_of_servers; i++)
    {
-      data = pgmoneta_append(data, "pgmoneta_server_last_failed_operation_time{");
+      int64_t pending_time = 0;
+      int64_t lag = 0;
+
+      data = pgmoneta_append(data, "pgmoneta_server_wal_archive_lag_seconds{");
 
       data = pgmoneta_append(data, "name=\"");
       data = pgmoneta_append(data, config->common.servers[i].name);
       data = pgmoneta_append(data, "\"} ");
 
-      if (atomic_load(&config->common.servers[i].failed_operation_count) > 0)
-      {
-         memset(&time_str[0], 0, sizeof(time_str));
-         t = (time_t)atomic_load(&config->common.servers[i].last_failed_operation_time);
-         time_info = localtime(&t);
-         strftime(&time_str[0], sizeof(time_str), "%Y%m%d%H%M%S", time_info);
-
-         data = pgmoneta_append(data, time_str);
-      }
-      else
+      pending_time = atomic_load(&config->common.servers[i].wal_archive_pending_time);
+      if (pending_time > 0 && (int64_t)time(NULL) > pending_time)
       {
-         data = pgmoneta_append_int(data, 0);
+         lag = (int64_t)time(NULL) - pending_time;
       }
 
+      data = pgmoneta_append_ulong(data, (unsigned long)lag);
+
       data = pgmoneta_append(data, "\n");
    }
    data = pgmoneta_append(data, "\n");
@@ -2446,15 +3573,14 @@ general_information(SSL* client_ssl, int client_fd)
    data = pgmoneta_append(data, "\n");
    if (data != NULL)
    {
-      send_chunk(client_ssl, client_fd, data);
-      metrics_cache_append(data);
+      *body = pgmoneta_append(*body, data);
       free(data);
       data = NULL;
    }
 }
 
 static void
-backup_information(SSL* client_ssl, int client_fd)
+backup_information(char** body)
 {
    char* d;
    int number_of_backups;
@@ -2513,8 +3639,7 @@ backup_information(SSL* client_ssl, int client_fd)
 
    if (data != NULL)
    {
-      send_chunk(client_ssl, client_fd, data);
-      metrics_cache_append(data);
+      *body = pgmoneta_append(*body, data);
       free(data);
       data = NULL;
    }
@@ -2605,8 +3730,7 @@ backup_information(SSL* client_ssl, int client_fd)
 
    if (data != NULL)
    {
-      send_chunk(client_ssl, client_fd, data);
-      metrics_cache_append(data);
+      *body = pgmoneta_append(*body, data);
       free(data);
       data = NULL;
    }
@@ -2653,8 +3777,7 @@ backup_information(SSL* client_ssl, int client_fd)
 
    if (data != NULL)
    {
-      send_chunk(client_ssl, client_fd, data);
-      metrics_cache_append(data);
+      *body = pgmoneta_append(*body, data);
       free(data);
       data = NULL;
    }
@@ -2710,8 +3833,7 @@ backup_information(SSL* client_ssl, int client_fd)
 
    if (data != NULL)
    {
-      send_chunk(client_ssl, client_fd, data);
-      metrics_cache_append(data);
+      *body = pgmoneta_append(*body, data);
       free(data);
       data = NULL;
    }
@@ -2775,8 +3897,7 @@ backup_information(SSL* client_ssl, int client_fd)
 
    if (data != NULL)
    {
-      send_chunk(client_ssl, client_fd, data);
-      metrics_cache_append(data);
+      *body = pgmoneta_append(*body, data);
       free(data);
       data = NULL;
    }
@@ -3646,15 +4767,14 @@ backup_information(SSL* client_ssl, int client_fd)
 
    if (data != NULL)
    {
-      send_chunk(client_ssl, client_fd, data);
-      metrics_cache_append(data);
+      *body = pgmoneta_append(*body, data);
       free(data);
       data = NULL;
    }
 }
 
 static void
-size_information(SSL* client_ssl, int client_fd)
+size_information(char** body)
 {
    char* d;
    int number_of_backups;
@@ -3712,8 +4832,7 @@ size_information(SSL* client_ssl, int client_fd)
 
    if (data != NULL)
    {
-      send_chunk(client_ssl, client_fd, data);
-      metrics_cache_append(data);
+      *body = pgmoneta_append(*body, data);
       free(data);
       data = NULL;
    }
@@ -3764,8 +4883,7 @@ size_information(SSL* client_ssl, int client_fd)
 
    if (data != NULL)
    {
-      send_chunk(client_ssl, client_fd, data);
-      metrics_cache_append(data);
+      *body = pgmoneta_append(*body, data);
       free(data);
       data = NULL;
    }
@@ -3824,8 +4942,7 @@ size_information(SSL* client_ssl, int client_fd)
 
    if (data != NULL)
    {
-      send_chunk(client_ssl, client_fd, data);
-      metrics_cache_append(data);
+      *body = pgmoneta_append(*body, data);
       free(data);
       data = NULL;
    }
@@ -3891,8 +5008,7 @@ size_information(SSL* client_ssl, int client_fd)
 
    if (data != NULL)
    {
-      send_chunk(client_ssl, client_fd, data);
-      metrics_cache_append(data);
+      *body = pgmoneta_append(*body, data);
       free(data);
       data = NULL;
    }
@@ -3948,8 +5064,7 @@ size_information(SSL* client_ssl, int client_fd)
 
    if (data != NULL)
    {
-      send_chunk(client_ssl, client_fd, data);
-      metrics_cache_append(data);
+      *body = pgmoneta_append(*body, data);
       free(data);
       data = NULL;
    }
@@ -4015,8 +5130,7 @@ size_information(SSL* client_ssl, int client_fd)
 
    if (data != NULL)
    {
-      send_chunk(client_ssl, client_fd, data);
-      metrics_cache_append(data);
+      *body = pgmoneta_append(*body, data);
       free(data);
       data = NULL;
    }
@@ -4081,8 +5195,7 @@ size_information(SSL* client_ssl, int client_fd)
 
    if (data != NULL)
    {
-      send_chunk(client_ssl, client_fd, data);
-      metrics_cache_append(data);
+      *body = pgmoneta_append(*body, data);
       free(data);
       data = NULL;
    }
@@ -4147,8 +5260,7 @@ size_information(SSL* client_ssl, int client_fd)
 
    if (data != NULL)
    {
-      send_chunk(client_ssl, client_fd, data);
-      metrics_cache_append(data);
+      *body = pgmoneta_append(*body, data);
       free(data);
       data = NULL;
    }
@@ -4213,8 +5325,7 @@ size_information(SSL* client_ssl, int client_fd)
 
    if (data != NULL)
    {
-      send_chunk(client_ssl, client_fd, data);
-      metrics_cache_append(data);
+      *body = pgmoneta_append(*body, data);
       free(data);
       data = NULL;
    }
@@ -4279,8 +5390,7 @@ size_information(SSL* client_ssl, int client_fd)
 
    if (data != NULL)
    {
-      send_chunk(client_ssl, client_fd, data);
-      metrics_cache_append(data);
+      *body = pgmoneta_append(*body, data);
       free(data);
       data = NULL;
    }
@@ -4345,8 +5455,7 @@ size_information(SSL* client_ssl, int client_fd)
 
    if (data != NULL)
    {
-      send_chunk(client_ssl, client_fd, data);
-      metrics_cache_append(data);
+      *body = pgmoneta_append(*body, data);
       free(data);
       data = NULL;
    }
@@ -4411,8 +5520,7 @@ size_information(SSL* client_ssl, int client_fd)
 
    if (data != NULL)
    {
-      send_chunk(client_ssl, client_fd, data);
-      metrics_cache_append(data);
+      *body = pgmoneta_append(*body, data);
       free(data);
       data = NULL;
    }
@@ -4477,8 +5585,7 @@ size_information(SSL* client_ssl, int client_fd)
 
    if (data != NULL)
    {
-      send_chunk(client_ssl, client_fd, data);
-      metrics_cache_append(data);
+      *body = pgmoneta_append(*body, data);
       free(data);
       data = NULL;
    }
@@ -4543,8 +5650,7 @@ size_information(SSL* client_ssl, int client_fd)
 
    if (data != NULL)
    {
-      send_chunk(client_ssl, client_fd, data);
-      metrics_cache_append(data);
+      *body = pgmoneta_append(*body, data);
       free(data);
       data = NULL;
    }
@@ -4609,8 +5715,7 @@ size_information(SSL* client_ssl, int client_fd)
 
    if (data != NULL)
    {
-      send_chunk(client_ssl, client_fd, data);
-      metrics_cache_append(data);
+      *body = pgmoneta_append(*body, data);
       free(data);
       data = NULL;
    }
@@ -4675,8 +5780,7 @@ size_information(SSL* client_ssl, int client_fd)
 
    if (data != NULL)
    {
-      send_chunk(client_ssl, client_fd, data);
-      metrics_cache_append(data);
+      *body = pgmoneta_append(*body, data);
       free(data);
       data = NULL;
    }
@@ -4741,8 +5845,7 @@ size_information(SSL* client_ssl, int client_fd)
 
    if (data != NULL)
    {
-      send_chunk(client_ssl, client_fd, data);
-      metrics_cache_append(data);
+      *body = pgmoneta_append(*body, data);
       free(data);
       data = NULL;
    }
@@ -4807,8 +5910,7 @@ size_information(SSL* client_ssl, int client_fd)
 
    if (data != NULL)
    {
-      send_chunk(client_ssl, client_fd, data);
-      metrics_cache_append(data);
+      *body = pgmoneta_append(*body, data);
       free(data);
       data = NULL;
    }
@@ -4867,8 +5969,7 @@ size_information(SSL* client_ssl, int client_fd)
 
    if (data != NULL)
    {
-      send_chunk(client_ssl, client_fd, data);
-      metrics_cache_append(data);
+      *body = pgmoneta_append(*body, data);
       free(data);
       data = NULL;
    }
@@ -4877,9 +5978,7 @@ size_information(SSL* client_ssl, int client_fd)
    data = pgmoneta_append(data, "#TYPE pgmoneta_backup_total_size gauge\n");
    for (int i = 0; i < config->common.number_of_servers; i++)
    {
-      d = pgmoneta_get_server_backup(i);
-
-      size = pgmoneta_directory_size(d);
+      size = pgmoneta_disk_usage(i, DISK_USAGE_BACKUP);
 
       data = pgmoneta_append(data, "pgmoneta_backup_total_size{");
 
@@ -4890,15 +5989,12 @@ size_information(SSL* client_ssl, int client_fd)
       data = pgmoneta_append_ulong(data, size);
 
       data = pgmoneta_append(data, "\n");
-
-      free(d);
    }
    data = pgmoneta_append(data, "\n");
 
    if (data != NULL)
    {
-      send_chunk(client_ssl, client_fd, data);
-      metrics_cache_append(data);
+      *body = pgmoneta_append(*body, data);
       free(data);
       data = NULL;
    }
@@ -4907,19 +6003,7 @@ size_information(SSL* client_ssl, int client_fd)
    data = pgmoneta_append(data, "#TYPE pgmoneta_wal_total_size gauge\n");
    for (int i = 0; i < config->common.number_of_servers; i++)
    {
-      d = pgmoneta_get_server_wal(i);
-
-      size = pgmoneta_directory_size(d);
-
-      free(d);
-
-      d = pgmoneta_get_server_wal_shipping_wal(i);
-
-      if (d != NULL)
-      {
-
-         size += pgmoneta_directory_size(d);
-      }
+      size = pgmoneta_disk_usage(i, DISK_USAGE_WAL) + pgmoneta_disk_usage(i, DISK_USAGE_WAL_SHIPPING);
 
       data = pgmoneta_append(data, "pgmoneta_wal_total_size{");
 
@@ -4930,15 +6014,12 @@ size_information(SSL* client_ssl, int client_fd)
       data = pgmoneta_append_ulong(data, size);
 
       data = pgmoneta_append(data, "\n");
-
-      free(d);
    }
    data = pgmoneta_append(data, "\n");
 
    if (data != NULL)
    {
-      send_chunk(client_ssl, client_fd, data);
-      metrics_cache_append(data);
+      *body = pgmoneta_append(*body, data);
       free(data);
       data = NULL;
    }
@@ -4947,18 +6028,7 @@ size_information(SSL* client_ssl, int client_fd)
    data = pgmoneta_append(data, "#TYPE pgmoneta_total_size gauge\n");
    for (int i = 0; i < config->common.number_of_servers; i++)
    {
-      d = pgmoneta_get_server(i);
-
-      size = pgmoneta_directory_size(d);
-
-      free(d);
-
-      d = pgmoneta_get_server_wal_shipping(i);
-
-      if (d != NULL)
-      {
-         size += pgmoneta_directory_size(d);
-      }
+      size = pgmoneta_disk_usage(i, DISK_USAGE_SERVER) + pgmoneta_disk_usage(i, DISK_USAGE_WAL_SHIPPING);
 
       data = pgmoneta_append(data, "pgmoneta_total_size{");
 
@@ -4969,8 +6039,6 @@ size_information(SSL* client_ssl, int client_fd)
       data = pgmoneta_append_ulong(data, size);
 
       data = pgmoneta_append(data, "\n");
-
-      free(d);
    }
    data = pgmoneta_append(data, "\n");
 
@@ -5139,15 +6207,14 @@ size_information(SSL* client_ssl, int client_fd)
 
    if (data != NULL)
    {
-      send_chunk(client_ssl, client_fd, data);
-      metrics_cache_append(data);
+      *body = pgmoneta_append(*body, data);
       free(data);
       data = NULL;
    }
 }
 
 static int
-send_chunk(SSL* client_ssl, int client_fd, char* data)
+send_chunk(struct metrics_connection* connection, char* data)
 {
    int status;
    char* m = NULL;
@@ -5173,7 +6240,7 @@ send_chunk(SSL* client_ssl, int client_fd, char* data)
    msg.length = strlen(m);
    msg.data = m;
 
-   status = pgmoneta_write_message(client_ssl, client_fd, &msg);
+   status = queue_message(connection, &msg);
 
    free(m);
 
@@ -5225,7 +6292,7 @@ is_metrics_cache_valid(void)
 
    cache = (struct prometheus_cache*)prometheus_cache_shmem;
 
-   if (cache->valid_until == 0 || strlen(cache->data) == 0)
+   if (cache->valid_until == 0 || cache->length == 0)
    {
       return false;
    }
@@ -5310,7 +6377,7 @@ metrics_cache_size_to_alloc(void)
  * Requires the caller to hold the lock on the cache!
  *
  * Invalidating the cache means that the payload is zero-filled
- * and that the valid_until field is set to zero too.
+ * and that the valid_until and length fields are set to zero too.
  */
 static void
 metrics_cache_invalidate(void)
@@ -5320,58 +6387,67 @@ metrics_cache_invalidate(void)
    cache = (struct prometheus_cache*)prometheus_cache_shmem;
 
    memset(cache->data, 0, cache->size);
+   cache->length = 0;
+   cache->compressed_length = 0;
    cache->valid_until = 0;
 }
 
 /**
- * Appends data to the cache.
+ * Rebuilds the cache.
  *
  * Requires the caller to hold the lock on the cache!
  *
- * If the input data is empty, nothing happens.
- * The data is appended only if the cache does not overflows, that
- * means the current size of the cache plus the size of the data
- * to append does not exceed the current cache size.
- * If the cache overflows, the cache is flushed and marked
- * as invalid.
- * This makes safe to call this method along the workflow of
- * building the Prometheus response.
- *
- * @param data the string to append to the cache
- * @return true on success
+ * The response body is rendered and stored in the cache,
+ * followed by its gzip compressed copy when there is room
+ * for it.
+ * If the body does not fit, the cache is left invalid and
+ * responses are rendered on demand.
  */
-static bool
-metrics_cache_append(char* data)
+static void
+metrics_cache_refresh(void)
 {
-   size_t origin_length = 0;
-   size_t append_length = 0;
+   char* body = NULL;
+   unsigned char* compressed = NULL;
+   size_t length = 0;
+   size_t compressed_length = 0;
    struct prometheus_cache* cache;
 
    cache = (struct prometheus_cache*)prometheus_cache_shmem;
 
    if (!is_metrics_cache_configured())
    {
-      return false;
+      return;
    }
 
-   origin_length = strlen(cache->data);
-   append_length = strlen(data);
-   // need to append the data to the cache
-   if (origin_length + append_length >= cache->size)
+   metrics_cache_invalidate();
+
+   body = render_metrics();
+   length = strlen(body);
+
+   if (length + 1 > cache->size)
    {
-      // cannot append new data, so invalidate cache
-      pgmoneta_log_debug("Cannot append %d bytes to the Prometheus cache because it will overflow the size of %d bytes (currently at %d bytes). HINT: try adjusting `metrics_cache_max_size`",
-                         append_length,
-                         cache->size,
-                         origin_length);
-      metrics_cache_invalidate();
-      return false;
+      pgmoneta_log_debug("Cannot store %d bytes in the Prometheus cache because it will overflow the size of %d bytes. HINT: try adjusting `metrics_cache_max_size`",
+                         length,
+                         cache->size);
+      free(body);
+      return;
+   }
+
+   memcpy(cache->data, body, length);
+   cache->data[length] = '\0';
+   cache->length = length;
+
+   if (!pgmoneta_gzip_string(body, &compressed, &compressed_length) &&
+       length + 1 + compressed_length <= cache->size)
+   {
+      memcpy(cache->data + length + 1, compressed, compressed_length);
+      cache->compressed_length = compressed_length;
    }
 
-   // append the data to the data field
-   memcpy(cache->data + origin_length, data, append_length);
-   cache->data[origin_length + append_length + 1] = '\0';
-   return true;
+   metrics_cache_finalize();
+
+   free(body);
+   free(compressed);
 }
 
 /**
@@ -5403,3 +6479,192 @@ metrics_cache_finalize(void)
    cache->valid_until = now + config->metrics_cache_max_age;
    return cache->valid_until > now;
 }
+
+static void
+phase_information(char** body)
+{
+   struct instrument* instrument = NULL;
+   struct phase_metrics* pm = NULL;
+   char* data = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+   instrument = (struct instrument*)instrument_shmem;
+
+   if (instrument == NULL)
+   {
+      return;
+   }
+
+   data = pgmoneta_append(data, "#HELP pgmoneta_phase_elapsed_seconds The wall time of a workflow step\n");
+   data = pgmoneta_append(data, "#TYPE pgmoneta_phase_elapsed_seconds histogram\n");
+   for (int i = 0; i < config->common.number_of_servers; i++)
+   {
+      for (int j = 0; j < NUMBER_OF_PHASE_SLOTS; j++)
+      {
+         pm = &instrument->phases[i][j];
+         data = phase_histogram(data, "pgmoneta_phase_elapsed_seconds", i, pm, &pm->elapsed);
+      }
+   }
+   data = pgmoneta_append(data, "\n");
+
+   data = pgmoneta_append(data, "#HELP pgmoneta_phase_cpu_seconds The CPU time of a workflow step\n");
+   data = pgmoneta_append(data, "#TYPE pgmoneta_phase_cpu_seconds histogram\n");
+   for (int i = 0; i < config->common.number_of_servers; i++)
+   {
+      for (int j = 0; j < NUMBER_OF_PHASE_SLOTS; j++)
+      {
+         pm = &instrument->phases[i][j];
+         data = phase_histogram(data, "pgmoneta_phase_cpu_seconds", i, pm, &pm->cpu);
+      }
+   }
+   data = pgmoneta_append(data, "\n");
+
+   data = pgmoneta_append(data, "#HELP pgmoneta_phase_wait_seconds The wall time of a workflow step not spent on the CPU\n");
+   data = pgmoneta_append(data, "#TYPE pgmoneta_phase_wait_seconds histogram\n");
+   for (int i = 0; i < config->common.number_of_servers; i++)
+   {
+      for (int j = 0; j < NUMBER_OF_PHASE_SLOTS; j++)
+      {
+         pm = &instrument->phases[i][j];
+         data = phase_histogram(data, "pgmoneta_phase_wait_seconds", i, pm, &pm->wait);
+      }
+   }
+   data = pgmoneta_append(data, "\n");
+
+   if (data != NULL)
+   {
+      *body = pgmoneta_append(*body, data);
+      free(data);
+      data = NULL;
+   }
+
+   data = pgmoneta_append(data, "#HELP pgmoneta_phase_bytes_in The bytes read by a workflow step\n");
+   data = pgmoneta_append(data, "#TYPE pgmoneta_phase_bytes_in counter\n");
+   for (int i = 0; i < config->common.number_of_servers; i++)
+   {
+      for (int j = 0; j < NUMBER_OF_PHASE_SLOTS; j++)
+      {
+         pm = &instrument->phases[i][j];
+         data = phase_counter(data, "pgmoneta_phase_bytes_in", i, pm, &pm->bytes_in);
+      }
+   }
+   data = pgmoneta_append(data, "\n");
+
+   data = pgmoneta_append(data, "#HELP pgmoneta_phase_bytes_out The bytes written by a workflow step\n");
+   data = pgmoneta_append(data, "#TYPE pgmoneta_phase_bytes_out counter\n");
+   for (int i = 0; i < config->common.number_of_servers; i++)
+   {
+      for (int j = 0; j < NUMBER_OF_PHASE_SLOTS; j++)
+      {
+         pm = &instrument->phases[i][j];
+         data = phase_counter(data, "pgmoneta_phase_bytes_out", i, pm, &pm->bytes_out);
+      }
+   }
+   data = pgmoneta_append(data, "\n");
+
+   data = pgmoneta_append(data, "#HELP pgmoneta_phase_files The files processed by a workflow step\n");
+   data = pgmoneta_append(data, "#TYPE pgmoneta_phase_files counter\n");
+   for (int i = 0; i < config->common.number_of_servers; i++)
+   {
+      for (int j = 0; j < NUMBER_OF_PHASE_SLOTS; j++)
+      {
+         pm = &instrument->phases[i][j];
+         data = phase_counter(data, "pgmoneta_phase_files", i, pm, &pm->files);
+      }
+   }
+   data = pgmoneta_append(data, "\n");
+
+   if (data != NULL)
+   {
+      *body = pgmoneta_append(*body, data);
+      free(data);
+      data = NULL;
+   }
+}
+
+static char*
+phase_labels(char* data, int server, struct phase_metrics* pm)
+{
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   data = pgmoneta_append(data, "name=\"");
+   data = pgmoneta_append(data, config->common.servers[server].name);
+   data = pgmoneta_append(data, "\",workflow=\"");
+   data = pgmoneta_append(data, pgmoneta_instrument_workflow(pm->type));
+   data = pgmoneta_append(data, "\",phase=\"");
+   data = pgmoneta_append(data, pm->name);
+   data = pgmoneta_append(data, "\"");
+
+   return data;
+}
+
+static char*
+phase_histogram(char* data, char* metric, int server, struct phase_metrics* pm, struct phase_histogram* h)
+{
+   unsigned long cumulative = 0;
+   double bound;
+
+   if (atomic_load(&pm->state) != PHASE_SLOT_READY || atomic_load(&h->count) == 0)
+   {
+      return data;
+   }
+
+   for (int k = 0; k < NUMBER_OF_PHASE_BUCKETS; k++)
+   {
+      cumulative += atomic_load(&h->buckets[k]);
+      bound = pgmoneta_instrument_bucket(k);
+
+      data = pgmoneta_append(data, metric);
+      data = pgmoneta_append(data, "_bucket{");
+      data = phase_labels(data, server, pm);
+      data = pgmoneta_append(data, ",le=\"");
+      if (bound < 0)
+      {
+         data = pgmoneta_append(data, "+Inf");
+      }
+      else
+      {
+         data = pgmoneta_append_double_precision(data, bound, 2);
+      }
+      data = pgmoneta_append(data, "\"} ");
+      data = pgmoneta_append_ulong(data, cumulative);
+      data = pgmoneta_append(data, "\n");
+   }
+
+   data = pgmoneta_append(data, metric);
+   data = pgmoneta_append(data, "_sum{");
+   data = phase_labels(data, server, pm);
+   data = pgmoneta_append(data, "} ");
+   data = pgmoneta_append_double_precision(data, atomic_load(&h->sum) / 1000000.0, 6);
+   data = pgmoneta_append(data, "\n");
+
+   data = pgmoneta_append(data, metric);
+   data = pgmoneta_append(data, "_count{");
+   data = phase_labels(data, server, pm);
+   data = pgmoneta_append(data, "} ");
+   data = pgmoneta_append_ulong(data, atomic_load(&h->count));
+   data = pgmoneta_append(data, "\n");
+
+   return data;
+}
+
+static char*
+phase_counter(char* data, char* metric, int server, struct phase_metrics* pm, atomic_ullong* value)
+{
+   if (atomic_load(&pm->state) != PHASE_SLOT_READY || atomic_load(&pm->elapsed.count) == 0)
+   {
+      return data;
+   }
+
+   data = pgmoneta_append(data, metric);
+   data = pgmoneta_append(data, "{");
+   data = phase_labels(data, server, pm);
+   data = pgmoneta_append(data, "} ");
+   data = pgmoneta_append_ulong(data, atomic_load(value));
+   data = pgmoneta_append(data, "\n");
+
+   return data;
+}
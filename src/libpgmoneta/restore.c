@@ -28,6 +28,7 @@
 
 /* pgmoneta */
 #include <pgmoneta.h>
+#include <download.h>
 #include <logging.h>
 #include <management.h>
 #include <manifest.h>
@@ -42,6 +43,7 @@
 #include <assert.h>
 #include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -72,6 +74,18 @@ struct build_backup_file_input
    bool exclude;
 };
 
+/**
+ * @struct merge_block
+ * A block of a merged incremental file and where to read it from
+ */
+struct merge_block
+{
+   uint32_t blkno;       /**< The relative block number */
+   uint32_t priority;    /**< The age of the source, 0 is the newest */
+   struct rfile* source; /**< The file holding the block */
+   off_t offset;         /**< The offset of the block in the file */
+};
+
 static char* restore_last_files_names[] = {"/global/pg_control", "/postgresql.conf", "/pg_hba.conf"};
 
 static int restore_backup_full(struct art* nodes);
@@ -178,6 +192,92 @@ copy_backup_file(int server,
 static void
 do_copy_backup_file(struct worker_common* wc);
 
+/**
+ * Roll up the incremental backups of a backup into its parent backup in place.
+ * Only the incremental files are rewritten, everything else is kept as stored
+ * @param server The server
+ * @param label The label of the backup to roll up
+ * @param prior_labels The label of the parent incremental backup
+ * @param backup The backup
+ * @return 0 on success, 1 if otherwise
+ */
+static int
+rollup_backup_incremental(int server, char* label, struct deque* prior_labels, struct backup* backup);
+
+/**
+ * Roll up an incremental file into the file of the parent backup.
+ * When the parent has an incremental file too, the block lists are merged
+ * into a new incremental file, otherwise the full file is reconstructed
+ * @param server The server
+ * @param label The label of the backup to roll up
+ * @param output_dir The absolute directory for the rolled up file
+ * @param relative_dir The directory containing the incremental file relative to the root dir
+ * @param bare_file_name The name of the file without "INCREMENTAL." prefix
+ * @param prior_labels The label of the parent backup
+ * @param backups The backups, including the current one
+ * @param files The file entries in manifest
+ * @return 0 on success, 1 if otherwise
+ */
+static int
+rollup_backup_file(int server,
+                   char* label,
+                   char* output_dir,
+                   char* relative_dir,
+                   char* bare_file_name,
+                   struct deque* prior_labels,
+                   struct art* backups,
+                   struct json* files);
+
+static void
+do_rollup_backup_file(struct worker_common* wc);
+
+/**
+ * Apply a directory of an incremental backup onto the matching directory of the target
+ * @param server The server
+ * @param label The label of the incremental backup
+ * @param from_root The data directory of the backup
+ * @param to_root The target directory
+ * @param relative_dir The directory relative to the roots
+ * @param backups The backups
+ * @param workers The optional workers
+ * @return 0 on success, 1 if otherwise
+ */
+static int
+apply_backup_directory(int server, char* label, char* from_root, char* to_root, char* relative_dir,
+                       struct art* backups, struct workers* workers);
+
+/**
+ * Write the changed blocks of an incremental file into the full file of the parent
+ * @param server The server
+ * @param label The label of the incremental backup
+ * @param output_dir The absolute directory containing the full file
+ * @param relative_dir The directory containing the file relative to the root dir
+ * @param bare_file_name The name of the file without "INCREMENTAL." prefix
+ * @param backups The backups
+ * @return 0 on success, 1 if otherwise
+ */
+static int
+apply_backup_file(int server, char* label, char* output_dir, char* relative_dir, char* bare_file_name, struct art* backups);
+
+static void
+do_apply_backup_file(struct worker_common* wc);
+
+/**
+ * Merge the block lists of two incremental files into a new incremental file.
+ * A block present in both files is taken from the newest one, blocks of the
+ * oldest file beyond the truncation block length of the newest are dropped
+ * @param output_file_path The path of the merged file
+ * @param newest The rfile of the newest incremental file
+ * @param oldest The rfile of the oldest incremental file
+ * @param blocksz The block size
+ * @return 0 on success, 1 if otherwise
+ */
+static int
+write_merged_file_incremental(char* output_file_path, struct rfile* newest, struct rfile* oldest, uint32_t blocksz);
+
+static int
+merge_block_compare(const void* a, const void* b);
+
 static void
 create_copy_backup_file_input(
    int server,
@@ -258,6 +358,9 @@ construct_backup_label_chain(int server, char* newest_label, char* oldest_label,
 static int
 file_base_name(char* file, char** basename);
 
+static int
+fetch_backup_data(int server, char* label, struct deque* fetched);
+
 static int copy_tablespaces_restore(char* from, char* to, char* base,
                                     char* server, char* id,
                                     struct backup* backup,
@@ -479,7 +582,10 @@ pgmoneta_restore_backup(struct art* nodes)
    struct backup* backup = NULL;
    char* position = NULL;
    struct deque* labels = NULL;
+   struct deque* fetched = NULL;
+   struct deque_iterator* iter = NULL;
    int server = 0;
+   int ret = RESTORE_OK;
    char* label = NULL;
 
 #ifdef DEBUG
@@ -568,25 +674,65 @@ pgmoneta_restore_backup(struct art* nodes)
       pgmoneta_art_insert(nodes, NODE_RECOVERY_INFO, false, ValueBool);
    }
 
+   pgmoneta_deque_create(false, &fetched);
+
+   if (fetch_backup_data(server, label, fetched))
+   {
+      ret = RESTORE_ERROR;
+      goto done;
+   }
+
    if (backup->type == TYPE_FULL)
    {
-      return restore_backup_full(nodes);
+      ret = restore_backup_full(nodes);
    }
    else if (backup->type == TYPE_INCREMENTAL)
    {
       if (construct_backup_label_chain(server, label, NULL, false, &labels))
       {
-         return RESTORE_MISSING_LABEL;
+         ret = RESTORE_MISSING_LABEL;
+         goto done;
+      }
+
+      pgmoneta_deque_iterator_create(labels, &iter);
+      while (pgmoneta_deque_iterator_next(iter))
+      {
+         if (fetch_backup_data(server, (char*)pgmoneta_value_data(iter->value), fetched))
+         {
+            pgmoneta_deque_iterator_destroy(iter);
+            pgmoneta_deque_destroy(labels);
+            ret = RESTORE_ERROR;
+            goto done;
+         }
       }
+      pgmoneta_deque_iterator_destroy(iter);
+
       pgmoneta_art_insert(nodes, NODE_LABELS, (uintptr_t)labels, ValueDeque);
       pgmoneta_art_insert(nodes, NODE_INCREMENTAL_COMBINE, (uintptr_t)false, ValueBool);
       pgmoneta_art_insert(nodes, NODE_COMBINE_AS_IS, (uintptr_t)false, ValueBool);
-      return restore_backup_incremental(nodes);
+      ret = restore_backup_incremental(nodes);
    }
    else
    {
-      return RESTORE_TYPE_UNKNOWN;
+      ret = RESTORE_TYPE_UNKNOWN;
+   }
+
+done:
+
+   /* Data downloaded from a remote storage engine is only kept for the restore */
+   pgmoneta_deque_iterator_create(fetched, &iter);
+   while (pgmoneta_deque_iterator_next(iter))
+   {
+      char* d = pgmoneta_get_server_backup_identifier_data(server, (char*)pgmoneta_value_data(iter->value));
+
+      pgmoneta_delete_directory(d);
+
+      free(d);
    }
+   pgmoneta_deque_iterator_destroy(iter);
+   pgmoneta_deque_destroy(fetched);
+
+   return ret;
 }
 
 int
@@ -821,57 +967,85 @@ pgmoneta_rollup_backups(int server, char* newest_label, char* oldest_label)
    }
    pgmoneta_art_insert(nodes, NODE_LABELS, (uintptr_t)labels, ValueDeque);
 
-   // USER DIRECTORY
-   tmp_backup_label = pgmoneta_append(tmp_backup_label, TMP_SUFFIX);
-   tmp_backup_label = pgmoneta_append(tmp_backup_label, "_");
-   tmp_backup_label = pgmoneta_append(tmp_backup_label, newest_label);
-   tmp_backup_root = pgmoneta_append(tmp_backup_root, tmp_backup_dir);
-   tmp_backup_root = pgmoneta_append(tmp_backup_root, tmp_backup_label);
    backup_dir = pgmoneta_get_server_backup_identifier(server, newest_label);
 
-   pgmoneta_art_insert(nodes, USER_DIRECTORY, (uintptr_t)tmp_backup_root, ValueString);
-   pgmoneta_art_insert(nodes, NODE_INCREMENTAL_COMBINE, (uintptr_t)incremental, ValueBool);
-   pgmoneta_art_insert(nodes, NODE_COMBINE_AS_IS, (uintptr_t)true, ValueBool);
-   if (restore_backup_incremental(nodes))
+   if (incremental && pgmoneta_deque_size(labels) == 1)
    {
-      pgmoneta_log_error("Unable to roll up backups from %s to %s", oldest_label, newest_label);
-      goto error;
-   }
+      // Adjacent incremental backups are merged block by block in place,
+      // so the files that are stored in full are left untouched
+      if (rollup_backup_incremental(server, newest_label, labels, newest_backup))
+      {
+         pgmoneta_log_error("Unable to roll up backups from %s to %s", oldest_label, newest_label);
+         goto error;
+      }
+
+      if (pgmoneta_load_info(tmp_backup_dir, newest_label, &tmp_backup))
+      {
+         pgmoneta_log_error("Unable to get backup for directory %s", backup_dir);
+         goto error;
+      }
+      pgmoneta_art_insert(nodes, NODE_BACKUP, (uintptr_t)tmp_backup, ValueMem);
 
-   // rebuild backup.info
-   snprintf(backup_info_path, sizeof(backup_info_path), "%s%s", backup_dir, "backup.info");
-   snprintf(tmp_backup_info_path, sizeof(tmp_backup_info_path), "%s/%s", tmp_backup_root, "backup.info");
-   if (pgmoneta_copy_file(backup_info_path, tmp_backup_info_path, NULL))
-   {
-      pgmoneta_log_error("Unable to copy %s to %s", backup_info_path, tmp_backup_info_path);
-      goto error;
-   }
-   if (pgmoneta_load_info(tmp_backup_dir, tmp_backup_label, &tmp_backup))
-   {
-      pgmoneta_log_error("Unable to get backup for directory %s", tmp_backup_root);
-      goto error;
-   }
-   if (!incremental)
-   {
-      tmp_backup->type = TYPE_FULL;
-      memset(tmp_backup->parent_label, 0, sizeof(tmp_backup->parent_label));
-   }
-   else
-   {
       snprintf(tmp_backup->parent_label, sizeof(tmp_backup->parent_label), "%s", oldest_backup->parent_label);
+      if (pgmoneta_save_info(tmp_backup_dir, tmp_backup))
+      {
+         pgmoneta_log_error("Unable to save backup info for directory %s", backup_dir);
+         goto error;
+      }
    }
-   if (pgmoneta_save_info(tmp_backup_dir, tmp_backup))
-   {
-      pgmoneta_log_error("Unable to save backup info for directory %s", tmp_backup_root);
-      goto error;
-   }
-   //  Now that tmp_backup is the new new_backup, replace it inside the nodes
-   pgmoneta_art_insert(nodes, NODE_BACKUP, (uintptr_t)tmp_backup, ValueMem);
-   pgmoneta_delete_directory(backup_dir);
-   if (rename(tmp_backup_root, backup_dir) != 0)
+   else
    {
-      pgmoneta_log_error("rollup: could not rename directory %s to %s", tmp_backup_root, backup_dir);
-      goto error;
+      // USER DIRECTORY
+      tmp_backup_label = pgmoneta_append(tmp_backup_label, TMP_SUFFIX);
+      tmp_backup_label = pgmoneta_append(tmp_backup_label, "_");
+      tmp_backup_label = pgmoneta_append(tmp_backup_label, newest_label);
+      tmp_backup_root = pgmoneta_append(tmp_backup_root, tmp_backup_dir);
+      tmp_backup_root = pgmoneta_append(tmp_backup_root, tmp_backup_label);
+
+      pgmoneta_art_insert(nodes, USER_DIRECTORY, (uintptr_t)tmp_backup_root, ValueString);
+      pgmoneta_art_insert(nodes, NODE_INCREMENTAL_COMBINE, (uintptr_t)incremental, ValueBool);
+      pgmoneta_art_insert(nodes, NODE_COMBINE_AS_IS, (uintptr_t)true, ValueBool);
+      if (restore_backup_incremental(nodes))
+      {
+         pgmoneta_log_error("Unable to roll up backups from %s to %s", oldest_label, newest_label);
+         goto error;
+      }
+
+      // rebuild backup.info
+      snprintf(backup_info_path, sizeof(backup_info_path), "%s%s", backup_dir, "backup.info");
+      snprintf(tmp_backup_info_path, sizeof(tmp_backup_info_path), "%s/%s", tmp_backup_root, "backup.info");
+      if (pgmoneta_copy_file(backup_info_path, tmp_backup_info_path, NULL))
+      {
+         pgmoneta_log_error("Unable to copy %s to %s", backup_info_path, tmp_backup_info_path);
+         goto error;
+      }
+      if (pgmoneta_load_info(tmp_backup_dir, tmp_backup_label, &tmp_backup))
+      {
+         pgmoneta_log_error("Unable to get backup for directory %s", tmp_backup_root);
+         goto error;
+      }
+      if (!incremental)
+      {
+         tmp_backup->type = TYPE_FULL;
+         memset(tmp_backup->parent_label, 0, sizeof(tmp_backup->parent_label));
+      }
+      else
+      {
+         snprintf(tmp_backup->parent_label, sizeof(tmp_backup->parent_label), "%s", oldest_backup->parent_label);
+      }
+      if (pgmoneta_save_info(tmp_backup_dir, tmp_backup))
+      {
+         pgmoneta_log_error("Unable to save backup info for directory %s", tmp_backup_root);
+         goto error;
+      }
+      //  Now that tmp_backup is the new new_backup, replace it inside the nodes
+      pgmoneta_art_insert(nodes, NODE_BACKUP, (uintptr_t)tmp_backup, ValueMem);
+      pgmoneta_delete_directory(backup_dir);
+      if (rename(tmp_backup_root, backup_dir) != 0)
+      {
+         pgmoneta_log_error("rollup: could not rename directory %s to %s", tmp_backup_root, backup_dir);
+         goto error;
+      }
    }
 
    workflow = pgmoneta_workflow_create(WORKFLOW_TYPE_POST_ROLLUP, tmp_backup);
@@ -973,6 +1147,82 @@ error:
    return 1;
 }
 
+int
+pgmoneta_apply_incremental_backup(int server, char* label, char* to, struct workers* workers)
+{
+   char* server_dir = NULL;
+   char* from = NULL;
+   char* target = NULL;
+   char* manifest = NULL;
+   struct backup* backup = NULL;
+   struct art* backups = NULL;
+
+   server_dir = pgmoneta_get_server_backup(server);
+   from = pgmoneta_get_server_backup_identifier_data(server, label);
+
+   target = pgmoneta_append(target, to);
+   if (!pgmoneta_ends_with(target, "/"))
+   {
+      target = pgmoneta_append_char(target, '/');
+   }
+
+   pgmoneta_load_info(server_dir, label, &backup);
+   if (backup == NULL || backup->type != TYPE_INCREMENTAL)
+   {
+      pgmoneta_log_error("Backup %s is not incremental backup", label);
+      free(backup);
+      goto error;
+   }
+
+   pgmoneta_art_create(&backups);
+   pgmoneta_art_insert(backups, label, (uintptr_t)backup, ValueMem);
+
+   if (apply_backup_directory(server, label, from, target, "", backups, workers))
+   {
+      goto error;
+   }
+
+   pgmoneta_workers_wait(workers);
+   if (workers != NULL && !workers->outcome)
+   {
+      goto error;
+   }
+
+   // The directory holds a full data directory now
+   if (write_backup_label(from, target, NULL, NULL))
+   {
+      goto error;
+   }
+
+   // The manifest of the backup lists the incremental files
+   manifest = pgmoneta_append(manifest, target);
+   manifest = pgmoneta_append(manifest, "backup_manifest");
+   if (pgmoneta_exists(manifest))
+   {
+      pgmoneta_delete_file(manifest, NULL);
+   }
+
+   pgmoneta_delete_server_workspace(server, label);
+
+   pgmoneta_art_destroy(backups);
+   free(server_dir);
+   free(from);
+   free(target);
+   free(manifest);
+   return 0;
+
+error:
+   pgmoneta_workers_wait(workers);
+   pgmoneta_delete_server_workspace(server, label);
+
+   pgmoneta_art_destroy(backups);
+   free(server_dir);
+   free(from);
+   free(target);
+   free(manifest);
+   return 1;
+}
+
 int
 pgmoneta_copy_postgresql_restore(char* from, char* to, char* base, char* server, char* id, struct backup* backup, struct workers* workers)
 {
@@ -1721,82 +1971,671 @@ error:
    return 1;
 }
 
-static uint32_t
-find_reconstructed_block_length(struct rfile* s)
+static int
+rollup_backup_incremental(int server, char* label, struct deque* prior_labels, struct backup* backup)
 {
-   uint32_t block_length = 0;
-   if (s == NULL)
-   {
-      return 0;
-   }
-   block_length = s->truncation_block_length;
-   for (uint32_t i = 0; i < s->num_blocks; i++)
+   char* server_dir = NULL;
+   char* data_dir = NULL;
+   char* staging_root = NULL;
+   char* staging_dir = NULL;
+   char* prior_label = NULL;
+   char* path = NULL;
+   char* sep = NULL;
+   char* bare_file_name = NULL;
+   char* stored_name = NULL;
+   char relative_dir[MAX_PATH];
+   char output_dir[MAX_PATH_CONCAT];
+   char manifest_path[MAX_PATH_CONCAT];
+   char from[MAX_PATH_CONCAT];
+   char to[MAX_PATH_CONCAT];
+   char stored[MAX_PATH_CONCAT];
+   int number_of_workers = 0;
+   struct backup* prior = NULL;
+   struct art* backups = NULL;
+   struct json* manifest = NULL;
+   struct json* files = NULL;
+   struct json* f = NULL;
+   struct json_iterator* fiter = NULL;
+   struct deque* incrementals = NULL;
+   struct deque_iterator* iter = NULL;
+   struct workers* workers = NULL;
+
+   server_dir = pgmoneta_get_server_backup(server);
+   data_dir = pgmoneta_get_server_backup_identifier_data(server, label);
+   prior_label = (char*)pgmoneta_deque_peek_last(prior_labels, NULL);
+
+   pgmoneta_load_info(server_dir, prior_label, &prior);
+   if (prior == NULL)
    {
-      if (s->relative_block_numbers[i] >= block_length)
-      {
-         block_length = s->relative_block_numbers[i] + 1;
-      }
+      pgmoneta_log_error("Unable to find backup %s", prior_label);
+      goto error;
    }
 
-   return block_length;
-}
+   pgmoneta_art_create(&backups);
+   pgmoneta_art_insert(backups, prior_label, (uintptr_t)prior, ValueMem);
+   pgmoneta_art_insert(backups, label, (uintptr_t)backup, ValueRef);
 
-static void
-rfile_destroy_cb(uintptr_t data)
-{
-   pgmoneta_rfile_destroy((struct rfile*) data);
-}
+   staging_root = pgmoneta_append(staging_root, server_dir);
+   staging_root = pgmoneta_append(staging_root, TMP_SUFFIX);
+   staging_root = pgmoneta_append(staging_root, "_");
+   staging_root = pgmoneta_append(staging_root, label);
+   staging_dir = pgmoneta_append(staging_dir, staging_root);
+   staging_dir = pgmoneta_append(staging_dir, "/data/");
 
-static bool
-is_full_file(struct rfile* rf)
-{
-   if (rf == NULL)
+   memset(manifest_path, 0, MAX_PATH_CONCAT);
+   snprintf(manifest_path, MAX_PATH_CONCAT, "%sbackup_manifest", data_dir);
+   if (pgmoneta_json_read_file(manifest_path, &manifest))
    {
-      return false;
+      pgmoneta_log_error("Unable to read manifest %s", manifest_path);
+      goto error;
    }
-   return rf->header_length == 0;
-}
 
-static int
-read_block(struct rfile* rf, off_t offset, uint32_t blocksz, uint8_t* buffer)
-{
-   uint32_t nread = 0;
-   if (fseek(rf->fp, offset, SEEK_SET))
+   files = (struct json*)pgmoneta_json_get(manifest, MANIFEST_FILES);
+   if (files == NULL)
    {
-      pgmoneta_log_error("unable to locate file pointer to offset %llu in file %s", offset, rf->filepath);
       goto error;
    }
 
-   nread = fread(buffer, 1, blocksz, rf->fp);
-   if (nread != blocksz)
+   // The incremental files are the only ones that change
+   pgmoneta_deque_create(false, &incrementals);
+   pgmoneta_json_iterator_create(files, &fiter);
+   while (pgmoneta_json_iterator_next(fiter))
    {
-      pgmoneta_log_error("unable to read block at offset %llu from file %s", offset, rf->filepath);
-      goto error;
+      f = (struct json*)pgmoneta_value_data(fiter->value);
+      path = (char*)pgmoneta_json_get(f, "Path");
+      if (pgmoneta_is_incremental_path(path))
+      {
+         pgmoneta_deque_add(incrementals, NULL, (uintptr_t)path, ValueString);
+      }
    }
+   pgmoneta_json_iterator_destroy(fiter);
+   fiter = NULL;
 
-   return 0;
-error:
-   return 1;
-}
-
-static int
-write_reconstructed_file_full(char* output_file_path,
-                              uint32_t block_length,
-                              struct rfile** source_map,
-                              off_t* offset_map,
-                              uint32_t blocksz)
-{
-   FILE* wfp = NULL;
-   uint8_t buffer[blocksz];
-   struct rfile* s = NULL;
+   clear_manifest_incremental_entries(manifest);
 
-   wfp = fopen(output_file_path, "wb+");
-   if (wfp == NULL)
+   number_of_workers = pgmoneta_get_number_of_workers(server);
+   if (number_of_workers > 0)
    {
-      pgmoneta_log_error("reconstruct: unable to open file for reconstruction at %s", output_file_path);
-      goto error;
+      pgmoneta_workers_initialize(number_of_workers, &workers);
+      pgmoneta_deque_set_thread_safe((struct deque*)files->elements);
    }
-   for (uint32_t i = 0; i < block_length; i++)
+
+   pgmoneta_deque_iterator_create(incrementals, &iter);
+   while (pgmoneta_deque_iterator_next(iter))
+   {
+      path = (char*)pgmoneta_value_data(iter->value);
+      sep = strrchr(path, '/');
+      if (sep == NULL)
+      {
+         pgmoneta_log_error("Rollup: unexpected incremental file %s", path);
+         goto error;
+      }
+
+      memset(relative_dir, 0, MAX_PATH);
+      memcpy(relative_dir, path, sep - path + 1);
+      bare_file_name = sep + 1 + INCREMENTAL_PREFIX_LENGTH;
+
+      memset(output_dir, 0, MAX_PATH_CONCAT);
+      snprintf(output_dir, MAX_PATH_CONCAT, "%s%s", staging_dir, relative_dir);
+      if (pgmoneta_mkdir(output_dir))
+      {
+         pgmoneta_log_error("Rollup: unable to create directory %s", output_dir);
+         goto error;
+      }
+      create_workspace_directory(server, label, relative_dir);
+      create_workspace_directories(server, prior_labels, relative_dir);
+
+      if (workers != NULL)
+      {
+         struct build_backup_file_input* wi = NULL;
+
+         if (!workers->outcome)
+         {
+            pgmoneta_log_error("Rollup: workers returned error");
+            goto error;
+         }
+
+         create_reconstruct_backup_file_input(server, label, output_dir, relative_dir, bare_file_name,
+                                              prior_labels, backups, true, files, workers, &wi);
+         pgmoneta_workers_add(workers, do_rollup_backup_file, (struct worker_common*)wi);
+      }
+      else
+      {
+         if (rollup_backup_file(server, label, output_dir, relative_dir, bare_file_name, prior_labels, backups, files))
+         {
+            pgmoneta_log_error("Rollup: unable to roll up file %s", path);
+            goto error;
+         }
+      }
+   }
+   pgmoneta_deque_iterator_destroy(iter);
+   iter = NULL;
+
+   pgmoneta_workers_wait(workers);
+
+   if (workers != NULL && !workers->outcome)
+   {
+      goto error;
+   }
+
+   if (write_backup_label_incremental(server, prior_label, data_dir, staging_dir))
+   {
+      goto error;
+   }
+
+   memset(manifest_path, 0, MAX_PATH_CONCAT);
+   snprintf(manifest_path, MAX_PATH_CONCAT, "%sbackup_manifest", staging_dir);
+   if (pgmoneta_write_postgresql_manifest(manifest, manifest_path))
+   {
+      pgmoneta_log_error("Fail to write manifest to %s", manifest_path);
+      goto error;
+   }
+
+   // Everything is staged, so replace the stored incremental files with the rolled up ones.
+   // The rolled up file is a full file when the parent had the full file
+   pgmoneta_deque_iterator_create(incrementals, &iter);
+   while (pgmoneta_deque_iterator_next(iter))
+   {
+      path = (char*)pgmoneta_value_data(iter->value);
+      sep = strrchr(path, '/');
+
+      memset(relative_dir, 0, MAX_PATH);
+      memcpy(relative_dir, path, sep - path + 1);
+      bare_file_name = sep + 1 + INCREMENTAL_PREFIX_LENGTH;
+
+      memset(from, 0, MAX_PATH_CONCAT);
+      memset(to, 0, MAX_PATH_CONCAT);
+      memset(stored, 0, MAX_PATH_CONCAT);
+
+      snprintf(from, MAX_PATH_CONCAT, "%s%s", staging_dir, path);
+      snprintf(to, MAX_PATH_CONCAT, "%s%s", data_dir, path);
+      if (!pgmoneta_exists(from))
+      {
+         snprintf(from, MAX_PATH_CONCAT, "%s%s%s", staging_dir, relative_dir, bare_file_name);
+         snprintf(to, MAX_PATH_CONCAT, "%s%s%s", data_dir, relative_dir, bare_file_name);
+      }
+
+      if (pgmoneta_backup_file_final_name(path, backup->encryption, backup->compression, &stored_name))
+      {
+         goto error;
+      }
+      snprintf(stored, MAX_PATH_CONCAT, "%s%s", data_dir, stored_name);
+      free(stored_name);
+      stored_name = NULL;
+
+      if (rename(from, to) != 0)
+      {
+         pgmoneta_log_error("Rollup: could not rename file %s to %s", from, to);
+         goto error;
+      }
+
+      if (strcmp(stored, to) && pgmoneta_exists(stored))
+      {
+         pgmoneta_delete_file(stored, NULL);
+      }
+   }
+   pgmoneta_deque_iterator_destroy(iter);
+   iter = NULL;
+
+   memset(from, 0, MAX_PATH_CONCAT);
+   memset(to, 0, MAX_PATH_CONCAT);
+   snprintf(from, MAX_PATH_CONCAT, "%sbackup_label", staging_dir);
+   snprintf(to, MAX_PATH_CONCAT, "%sbackup_label", data_dir);
+   if (rename(from, to) != 0)
+   {
+      pgmoneta_log_error("Rollup: could not rename file %s to %s", from, to);
+      goto error;
+   }
+
+   memset(to, 0, MAX_PATH_CONCAT);
+   snprintf(to, MAX_PATH_CONCAT, "%sbackup_manifest", data_dir);
+   if (rename(manifest_path, to) != 0)
+   {
+      pgmoneta_log_error("Rollup: could not rename file %s to %s", manifest_path, to);
+      goto error;
+   }
+
+   pgmoneta_delete_server_workspace(server, label);
+   cleanup_workspaces(server, prior_labels);
+   pgmoneta_delete_directory(staging_root);
+
+   pgmoneta_workers_destroy(workers);
+   pgmoneta_deque_destroy(incrementals);
+   pgmoneta_json_destroy(manifest);
+   pgmoneta_art_destroy(backups);
+   free(server_dir);
+   free(data_dir);
+   free(staging_root);
+   free(staging_dir);
+   return 0;
+
+error:
+   pgmoneta_workers_wait(workers);
+   pgmoneta_delete_server_workspace(server, label);
+   cleanup_workspaces(server, prior_labels);
+   if (pgmoneta_exists(staging_root))
+   {
+      pgmoneta_delete_directory(staging_root);
+   }
+
+   pgmoneta_workers_destroy(workers);
+   pgmoneta_json_iterator_destroy(fiter);
+   pgmoneta_deque_iterator_destroy(iter);
+   pgmoneta_deque_destroy(incrementals);
+   pgmoneta_json_destroy(manifest);
+   if (backups != NULL)
+   {
+      pgmoneta_art_destroy(backups);
+   }
+   else
+   {
+      free(prior);
+   }
+   free(stored_name);
+   free(server_dir);
+   free(data_dir);
+   free(staging_root);
+   free(staging_dir);
+   return 1;
+}
+
+static int
+rollup_backup_file(int server,
+                   char* label,
+                   char* output_dir,
+                   char* relative_dir,
+                   char* bare_file_name,
+                   struct deque* prior_labels,
+                   struct art* backups,
+                   struct json* files)
+{
+   bool full_file_found = false;
+   char* prior_label = NULL;
+   char* full_path = NULL;
+   char* stored_path = NULL;
+   char incr_file_name[MAX_PATH];
+   char ofullpath[MAX_PATH_CONCAT];
+   char manifest_path[MAX_PATH_CONCAT];
+   struct backup* bck = NULL;
+   struct backup* prior = NULL;
+   struct rfile* newest = NULL;
+   struct rfile* oldest = NULL;
+   struct json* file = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   prior_label = (char*)pgmoneta_deque_peek_last(prior_labels, NULL);
+   bck = (struct backup*)pgmoneta_art_search(backups, label);
+   prior = (struct backup*)pgmoneta_art_search(backups, prior_label);
+
+   // A full file in the parent means the relation started there,
+   // so there are no older blocks to keep as references
+   full_path = pgmoneta_get_server_backup_identifier_data(server, prior_label);
+   full_path = pgmoneta_append(full_path, relative_dir);
+   full_path = pgmoneta_append(full_path, bare_file_name);
+   if (pgmoneta_backup_file_final_name(full_path, prior->encryption, prior->compression, &stored_path))
+   {
+      goto error;
+   }
+   full_file_found = pgmoneta_exists(full_path) || pgmoneta_exists(stored_path);
+
+   if (full_file_found)
+   {
+      if (reconstruct_backup_file(server, label, output_dir, relative_dir, bare_file_name, prior_labels, backups, true, files))
+      {
+         goto error;
+      }
+   }
+   else
+   {
+      memset(incr_file_name, 0, MAX_PATH);
+      memset(ofullpath, 0, MAX_PATH_CONCAT);
+      memset(manifest_path, 0, MAX_PATH_CONCAT);
+
+      snprintf(incr_file_name, MAX_PATH, "%s%s", INCREMENTAL_PREFIX, bare_file_name);
+      snprintf(ofullpath, MAX_PATH_CONCAT, "%s%s", output_dir, incr_file_name);
+      snprintf(manifest_path, MAX_PATH_CONCAT, "%s%s", relative_dir, incr_file_name);
+
+      if (pgmoneta_incremental_rfile_initialize(server, label, relative_dir, incr_file_name, bck->encryption, bck->compression, &newest))
+      {
+         goto error;
+      }
+      if (pgmoneta_incremental_rfile_initialize(server, prior_label, relative_dir, incr_file_name, prior->encryption, prior->compression, &oldest))
+      {
+         goto error;
+      }
+
+      if (write_merged_file_incremental(ofullpath, newest, oldest, config->common.servers[server].block_size))
+      {
+         pgmoneta_log_error("Rollup: fail to write merged incremental file at %s", ofullpath);
+         goto error;
+      }
+
+      if (get_file_manifest(ofullpath, manifest_path, &file))
+      {
+         pgmoneta_log_error("Unable to get manifest for file %s", ofullpath);
+         goto error;
+      }
+      pgmoneta_json_append(files, (uintptr_t)file, ValueJSON);
+   }
+
+   pgmoneta_rfile_destroy(newest);
+   pgmoneta_rfile_destroy(oldest);
+   free(full_path);
+   free(stored_path);
+   return 0;
+
+error:
+   pgmoneta_rfile_destroy(newest);
+   pgmoneta_rfile_destroy(oldest);
+   free(full_path);
+   free(stored_path);
+   return 1;
+}
+
+static int
+apply_backup_directory(int server, char* label, char* from_root, char* to_root, char* relative_dir,
+                       struct art* backups, struct workers* workers)
+{
+   bool workspace = false;
+   char from_dir[MAX_PATH_CONCAT];
+   char to_dir[MAX_PATH_CONCAT];
+   char from_path[MAX_PATH_CONCAT];
+   char to_path[MAX_PATH_CONCAT];
+   char incr_path[MAX_PATH_CONCAT];
+   char sub_dir[MAX_PATH];
+   DIR* d = NULL;
+   struct dirent* entry = NULL;
+   struct stat st;
+
+   memset(from_dir, 0, MAX_PATH_CONCAT);
+   memset(to_dir, 0, MAX_PATH_CONCAT);
+   snprintf(from_dir, MAX_PATH_CONCAT, "%s%s", from_root, relative_dir);
+   snprintf(to_dir, MAX_PATH_CONCAT, "%s%s", to_root, relative_dir);
+
+   if (pgmoneta_mkdir(to_dir))
+   {
+      pgmoneta_log_error("Apply: unable to create directory %s", to_dir);
+      goto error;
+   }
+
+   // Remove what is no longer in the backup
+   d = opendir(to_dir);
+   if (d == NULL)
+   {
+      pgmoneta_log_error("Apply: unable to open directory %s", to_dir);
+      goto error;
+   }
+
+   while ((entry = readdir(d)) != NULL)
+   {
+      if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, ".."))
+      {
+         continue;
+      }
+
+      memset(from_path, 0, MAX_PATH_CONCAT);
+      memset(incr_path, 0, MAX_PATH_CONCAT);
+      snprintf(from_path, MAX_PATH_CONCAT, "%s%s", from_dir, entry->d_name);
+      snprintf(incr_path, MAX_PATH_CONCAT, "%s%s%s", from_dir, INCREMENTAL_PREFIX, entry->d_name);
+
+      if (!pgmoneta_exists(from_path) && !pgmoneta_exists(incr_path))
+      {
+         memset(to_path, 0, MAX_PATH_CONCAT);
+         snprintf(to_path, MAX_PATH_CONCAT, "%s%s", to_dir, entry->d_name);
+
+         if (!lstat(to_path, &st) && S_ISDIR(st.st_mode))
+         {
+            pgmoneta_delete_directory(to_path);
+         }
+         else
+         {
+            pgmoneta_delete_file(to_path, NULL);
+         }
+      }
+   }
+   closedir(d);
+
+   d = opendir(from_dir);
+   if (d == NULL)
+   {
+      pgmoneta_log_error("Apply: unable to open directory %s", from_dir);
+      goto error;
+   }
+
+   while ((entry = readdir(d)) != NULL)
+   {
+      if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, ".."))
+      {
+         continue;
+      }
+
+      memset(from_path, 0, MAX_PATH_CONCAT);
+      memset(to_path, 0, MAX_PATH_CONCAT);
+      snprintf(from_path, MAX_PATH_CONCAT, "%s%s", from_dir, entry->d_name);
+      snprintf(to_path, MAX_PATH_CONCAT, "%s%s", to_dir, entry->d_name);
+
+      if (stat(from_path, &st))
+      {
+         continue;
+      }
+
+      if (S_ISDIR(st.st_mode))
+      {
+         memset(sub_dir, 0, MAX_PATH);
+         snprintf(sub_dir, MAX_PATH, "%s%s/", relative_dir, entry->d_name);
+
+         if (apply_backup_directory(server, label, from_root, to_root, sub_dir, backups, workers))
+         {
+            goto error;
+         }
+      }
+      else if (strlen(relative_dir) == 0 &&
+               (!strcmp(entry->d_name, "backup_label") || !strcmp(entry->d_name, "backup_manifest")))
+      {
+         continue;
+      }
+      else if (pgmoneta_starts_with(entry->d_name, INCREMENTAL_PREFIX))
+      {
+         if (!workspace)
+         {
+            create_workspace_directory(server, label, relative_dir);
+            workspace = true;
+         }
+
+         if (workers != NULL)
+         {
+            struct build_backup_file_input* wi = NULL;
+
+            if (!workers->outcome)
+            {
+               goto error;
+            }
+
+            create_reconstruct_backup_file_input(server, label, to_dir, relative_dir, entry->d_name + INCREMENTAL_PREFIX_LENGTH,
+                                                 NULL, backups, true, NULL, workers, &wi);
+            pgmoneta_workers_add(workers, do_apply_backup_file, (struct worker_common*)wi);
+         }
+         else if (apply_backup_file(server, label, to_dir, relative_dir, entry->d_name + INCREMENTAL_PREFIX_LENGTH, backups))
+         {
+            goto error;
+         }
+      }
+      else
+      {
+         pgmoneta_copy_file(from_path, to_path, workers);
+      }
+   }
+   closedir(d);
+
+   return 0;
+
+error:
+   if (d != NULL)
+   {
+      closedir(d);
+   }
+   return 1;
+}
+
+static int
+apply_backup_file(int server, char* label, char* output_dir, char* relative_dir, char* bare_file_name, struct art* backups)
+{
+   int fd = -1;
+   uint32_t blocksz;
+   uint32_t block_length;
+   char to_path[MAX_PATH_CONCAT];
+   char incr_file_name[MAX_PATH];
+   char* base_file_name = NULL;
+   struct backup* bck = NULL;
+   struct rfile* rf = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   blocksz = config->common.servers[server].block_size;
+   bck = (struct backup*)pgmoneta_art_search(backups, label);
+
+   if (file_base_name(bare_file_name, &base_file_name))
+   {
+      goto error;
+   }
+
+   memset(to_path, 0, MAX_PATH_CONCAT);
+   memset(incr_file_name, 0, MAX_PATH);
+   snprintf(to_path, MAX_PATH_CONCAT, "%s%s", output_dir, base_file_name);
+   snprintf(incr_file_name, MAX_PATH, "%s%s", INCREMENTAL_PREFIX, base_file_name);
+
+   if (pgmoneta_incremental_rfile_initialize(server, label, relative_dir, incr_file_name, bck->encryption, bck->compression, &rf))
+   {
+      goto error;
+   }
+
+   // The parent has the file, so only the changed blocks are written
+   fd = open(to_path, O_WRONLY);
+   if (fd < 0)
+   {
+      pgmoneta_log_error("Apply: unable to open %s: %s", to_path, strerror(errno));
+      goto error;
+   }
+
+   block_length = find_reconstructed_block_length(rf);
+   if (ftruncate(fd, (off_t)block_length * blocksz))
+   {
+      pgmoneta_log_error("Apply: unable to truncate %s: %s", to_path, strerror(errno));
+      goto error;
+   }
+
+   {
+      uint8_t buffer[blocksz];
+
+      for (uint32_t i = 0; i < rf->num_blocks; i++)
+      {
+         if (read_block(rf, rf->header_length + (off_t)i * blocksz, blocksz, buffer))
+         {
+            goto error;
+         }
+
+         if (pwrite(fd, buffer, blocksz, (off_t)rf->relative_block_numbers[i] * blocksz) != (ssize_t)blocksz)
+         {
+            pgmoneta_log_error("Apply: unable to write block %u of %s: %s", rf->relative_block_numbers[i], to_path, strerror(errno));
+            goto error;
+         }
+      }
+   }
+
+   close(fd);
+   pgmoneta_rfile_destroy(rf);
+   free(base_file_name);
+   return 0;
+
+error:
+   if (fd >= 0)
+   {
+      close(fd);
+   }
+   pgmoneta_rfile_destroy(rf);
+   free(base_file_name);
+   return 1;
+}
+
+static uint32_t
+find_reconstructed_block_length(struct rfile* s)
+{
+   uint32_t block_length = 0;
+   if (s == NULL)
+   {
+      return 0;
+   }
+   block_length = s->truncation_block_length;
+   for (uint32_t i = 0; i < s->num_blocks; i++)
+   {
+      if (s->relative_block_numbers[i] >= block_length)
+      {
+         block_length = s->relative_block_numbers[i] + 1;
+      }
+   }
+
+   return block_length;
+}
+
+static void
+rfile_destroy_cb(uintptr_t data)
+{
+   pgmoneta_rfile_destroy((struct rfile*) data);
+}
+
+static bool
+is_full_file(struct rfile* rf)
+{
+   if (rf == NULL)
+   {
+      return false;
+   }
+   return rf->header_length == 0;
+}
+
+static int
+read_block(struct rfile* rf, off_t offset, uint32_t blocksz, uint8_t* buffer)
+{
+   uint32_t nread = 0;
+   if (fseek(rf->fp, offset, SEEK_SET))
+   {
+      pgmoneta_log_error("unable to locate file pointer to offset %llu in file %s", offset, rf->filepath);
+      goto error;
+   }
+
+   nread = fread(buffer, 1, blocksz, rf->fp);
+   if (nread != blocksz)
+   {
+      pgmoneta_log_error("unable to read block at offset %llu from file %s", offset, rf->filepath);
+      goto error;
+   }
+
+   return 0;
+error:
+   return 1;
+}
+
+static int
+write_reconstructed_file_full(char* output_file_path,
+                              uint32_t block_length,
+                              struct rfile** source_map,
+                              off_t* offset_map,
+                              uint32_t blocksz)
+{
+   FILE* wfp = NULL;
+   uint8_t buffer[blocksz];
+   struct rfile* s = NULL;
+
+   wfp = fopen(output_file_path, "wb+");
+   if (wfp == NULL)
+   {
+      pgmoneta_log_error("reconstruct: unable to open file for reconstruction at %s", output_file_path);
+      goto error;
+   }
+   for (uint32_t i = 0; i < block_length; i++)
    {
       memset(buffer, 0, blocksz);
       s = source_map[i];
@@ -1943,6 +2782,146 @@ error:
 
 }
 
+static int
+write_merged_file_incremental(char* output_file_path, struct rfile* newest, struct rfile* oldest, uint32_t blocksz)
+{
+   FILE* wfp = NULL;
+   size_t hdrlen = 0;
+   size_t hdrptr = 0;
+   uint8_t buffer[blocksz];
+   uint32_t n = 0;
+   uint32_t num_blocks = 0;
+   uint32_t magic = INCREMENTAL_MAGIC;
+   void* header = NULL;
+   struct merge_block* blocks = NULL;
+
+   pgmoneta_log_debug("merge incremental file %s", output_file_path);
+
+   // Only the blocks referenced by the two headers are looked at,
+   // so the cost follows the number of changed blocks and not the relation size
+   blocks = malloc(sizeof(struct merge_block) * ((size_t)newest->num_blocks + oldest->num_blocks + 1));
+   if (blocks == NULL)
+   {
+      goto error;
+   }
+
+   for (uint32_t i = 0; i < newest->num_blocks; i++)
+   {
+      blocks[n].blkno = newest->relative_block_numbers[i];
+      blocks[n].priority = 0;
+      blocks[n].source = newest;
+      blocks[n].offset = newest->header_length + ((off_t)i * blocksz);
+      n++;
+   }
+
+   for (uint32_t i = 0; i < oldest->num_blocks; i++)
+   {
+      // blocks truncated away before the newest backup are gone
+      if (oldest->relative_block_numbers[i] >= newest->truncation_block_length)
+      {
+         continue;
+      }
+      blocks[n].blkno = oldest->relative_block_numbers[i];
+      blocks[n].priority = 1;
+      blocks[n].source = oldest;
+      blocks[n].offset = oldest->header_length + ((off_t)i * blocksz);
+      n++;
+   }
+
+   // newest wins, it sorts first among the entries of a block
+   qsort(blocks, n, sizeof(struct merge_block), merge_block_compare);
+   for (uint32_t i = 0; i < n; i++)
+   {
+      if (num_blocks > 0 && blocks[num_blocks - 1].blkno == blocks[i].blkno)
+      {
+         continue;
+      }
+      blocks[num_blocks++] = blocks[i];
+   }
+
+   hdrlen = sizeof(uint32_t) * (1 + 1 + 1 + num_blocks);
+   if (num_blocks > 0 && hdrlen % blocksz != 0)
+   {
+      hdrlen += (blocksz - (hdrlen % blocksz));
+   }
+
+   header = malloc(hdrlen);
+   if (header == NULL)
+   {
+      goto error;
+   }
+   memset(header, 0, hdrlen);
+
+   memcpy(header + hdrptr, &magic, sizeof(uint32_t));
+   hdrptr += sizeof(uint32_t);
+
+   memcpy(header + hdrptr, &num_blocks, sizeof(uint32_t));
+   hdrptr += sizeof(uint32_t);
+
+   memcpy(header + hdrptr, &newest->truncation_block_length, sizeof(uint32_t));
+   hdrptr += sizeof(uint32_t);
+
+   for (uint32_t i = 0; i < num_blocks; i++)
+   {
+      memcpy(header + hdrptr, &blocks[i].blkno, sizeof(uint32_t));
+      hdrptr += sizeof(uint32_t);
+   }
+
+   wfp = fopen(output_file_path, "wb+");
+   if (wfp == NULL)
+   {
+      pgmoneta_log_error("merge: unable to open file for merging at %s", output_file_path);
+      goto error;
+   }
+
+   if (fwrite(header, 1, hdrlen, wfp) != hdrlen)
+   {
+      pgmoneta_log_error("merge: fail to write header to file %s", output_file_path);
+      goto error;
+   }
+
+   for (uint32_t i = 0; i < num_blocks; i++)
+   {
+      if (read_block(blocks[i].source, blocks[i].offset, blocksz, buffer))
+      {
+         goto error;
+      }
+      if (fwrite(buffer, 1, blocksz, wfp) != blocksz)
+      {
+         pgmoneta_log_error("merge: fail to write to file %s", output_file_path);
+         goto error;
+      }
+   }
+
+   free(blocks);
+   free(header);
+   fclose(wfp);
+   return 0;
+
+error:
+   free(blocks);
+   free(header);
+   if (wfp != NULL)
+   {
+      fclose(wfp);
+   }
+   return 1;
+}
+
+static int
+merge_block_compare(const void* a, const void* b)
+{
+   const struct merge_block* x = (const struct merge_block*)a;
+   const struct merge_block* y = (const struct merge_block*)b;
+
+   if (x->blkno != y->blkno)
+   {
+      return x->blkno < y->blkno ? -1 : 1;
+   }
+
+   return (x->priority > y->priority) - (x->priority < y->priority);
+}
+
 static int
 write_backup_label(char* from_dir, char* to_dir, char* lsn_entry, char* tli_entry)
 {
@@ -2469,7 +3448,7 @@ carry_out_workflow(struct workflow* workflow, struct art* nodes)
    current = workflow;
    while (current != NULL)
    {
-      if (current->execute(current->name(), nodes))
+      if (pgmoneta_workflow_step(current, nodes))
       {
          ret = RESTORE_MISSING_LABEL;
          pgmoneta_log_error("execute/%s", current->name());
@@ -2513,6 +3492,28 @@ cleanup_workspaces(int server, struct deque* labels)
    pgmoneta_deque_iterator_destroy(iter);
 }
 
+static int
+fetch_backup_data(int server, char* label, struct deque* fetched)
+{
+   bool f = false;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   if (pgmoneta_download_fetch(server, label, &f))
+   {
+      pgmoneta_log_error("Restore: Unable to fetch %s/%s from remote storage", config->common.servers[server].name, label);
+      return 1;
+   }
+
+   if (f)
+   {
+      pgmoneta_deque_add(fetched, NULL, (uintptr_t)label, ValueString);
+   }
+
+   return 0;
+}
+
 static int
 construct_backup_label_chain(int server, char* newest_label, char* oldest_label, bool inclusive, struct deque** labels)
 {
@@ -2683,6 +3684,56 @@ error:
    return;
 }
 
+static void
+do_apply_backup_file(struct worker_common* wc)
+{
+   struct build_backup_file_input* input = (struct build_backup_file_input*)wc;
+   if (apply_backup_file(input->server,
+                         input->label,
+                         input->output_dir,
+                         input->relative_dir,
+                         input->file_name,
+                         input->backups))
+   {
+      goto error;
+   }
+
+   free(input);
+   return;
+
+error:
+   pgmoneta_log_error("Apply: unable to apply file %s%s", input->relative_dir, input->file_name);
+   input->common.workers->outcome = false;
+   free(input);
+   return;
+}
+
+static void
+do_rollup_backup_file(struct worker_common* wc)
+{
+   struct build_backup_file_input* input = (struct build_backup_file_input*)wc;
+   if (rollup_backup_file(input->server,
+                          input->label,
+                          input->output_dir,
+                          input->relative_dir,
+                          input->file_name,
+                          input->prior_labels,
+                          input->backups,
+                          input->files))
+   {
+      goto error;
+   }
+
+   free(input);
+   return;
+
+error:
+   pgmoneta_log_error("Rollup: unable to roll up file %s%s", input->relative_dir, input->file_name);
+   input->common.workers->outcome = false;
+   free(input);
+   return;
+}
+
 static void
 create_reconstruct_backup_file_input(int server,
                                      char* label,
@@ -28,6 +28,7 @@
 
 /* pgmoneta */
 #include <pgmoneta.h>
+#include <delete.h>
 #include <logging.h>
 #include <management.h>
 #include <utils.h>
@@ -76,6 +77,11 @@ pgmoneta_retention(char** argv)
          goto error;
       }
 
+      if (pgmoneta_art_insert(nodes, NODE_SERVER_ID, (uintptr_t)server, ValueInt32))
+      {
+         goto error;
+      }
+
       if (pgmoneta_workflow_execute(workflow, nodes, &en, &ec))
       {
          goto error;
@@ -89,6 +95,9 @@ pgmoneta_retention(char** argv)
 
       config->common.servers[server].active_retention = false;
       atomic_store(&config->common.servers[server].repository, false);
+
+      /* The trash is purged without the repository lock */
+      pgmoneta_purge_trash(server);
    }
 
    pgmoneta_stop_logging();
@@ -28,15 +28,20 @@
 
 /* pgmoneta */
 #include <pgmoneta.h>
+#include <deque.h>
+#include <download.h>
 #include <http.h>
 #include <logging.h>
 #include <security.h>
+#include <storage.h>
 #include <utils.h>
 #include <workflow.h>
 
 /* system */
 #include <assert.h>
 #include <dirent.h>
+#include <inttypes.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -49,8 +54,18 @@ static int azure_upload_files(char* local_root, char* azure_root, char* relative
 static int azure_send_upload_request(char* local_root, char* azure_root, char* relative_path);
 static int azure_add_request_headers(struct http_request* request, char* auth_value, char* utc_date);
 
+static int azure_get_authorization(char* string_to_sign, char** auth_value);
+static int azure_connect(struct http** connection);
+
+static int azure_list(struct download_engine* engine, struct deque* objects);
+static int azure_get(struct download_engine* engine, char* key, uint64_t offset, uint64_t length,
+                     struct http** connection, struct http_request** request);
+
 static char* azure_get_host(void);
+static char* azure_get_request_path(char* path);
+static char* azure_get_resource(char* request_path);
 static char* azure_get_basepath(int server, char* identifier);
+static char* azure_get_wal_path(int server);
 
 struct workflow*
 pgmoneta_storage_create_azure(void)
@@ -321,16 +336,12 @@ azure_send_upload_request(char* local_root, char* azure_root, char* relative_pat
 {
    char utc_date[UTC_TIME_LENGTH];
    char* string_to_sign = NULL;
-   char* signing_key = NULL;
-   char* base64_signature = NULL;
-   size_t base64_signature_length;
    char* local_path = NULL;
    char* azure_path = NULL;
    char* azure_host = NULL;
    char* auth_value = NULL;
-   unsigned char* signature_hmac = NULL;
-   int hmac_length = 0;
-   size_t signing_key_length = 0;
+   char* azure_put_path = NULL;
+   char* resource = NULL;
    FILE* file = NULL;
    struct stat file_info;
    void* file_data = NULL;
@@ -339,7 +350,6 @@ azure_send_upload_request(char* local_root, char* azure_root, char* relative_pat
    struct http_response* response = NULL;
    struct main_configuration* config;
    char size_str[64];
-   char azure_put_path[MAX_PATH];
 
    config = (struct main_configuration*)shmem;
 
@@ -413,38 +423,26 @@ azure_send_upload_request(char* local_root, char* azure_root, char* relative_pat
       string_to_sign = pgmoneta_append(string_to_sign, "\n\napplication/octet-stream\n\n\n\n\n\n\nx-ms-blob-type:BlockBlob\nx-ms-date:");
    }
 
-   string_to_sign = pgmoneta_append(string_to_sign, utc_date);
-   string_to_sign = pgmoneta_append(string_to_sign, "\nx-ms-version:2021-08-06\n/");
-   string_to_sign = pgmoneta_append(string_to_sign, config->azure_storage_account);
-   string_to_sign = pgmoneta_append(string_to_sign, "/");
-   string_to_sign = pgmoneta_append(string_to_sign, config->azure_container);
-   string_to_sign = pgmoneta_append(string_to_sign, "/");
-   string_to_sign = pgmoneta_append(string_to_sign, azure_path);
+   azure_put_path = azure_get_request_path(azure_path);
+   resource = azure_get_resource(azure_put_path);
 
-   pgmoneta_base64_decode(config->azure_shared_key, strlen(config->azure_shared_key), (void**)&signing_key, &signing_key_length);
+   string_to_sign = pgmoneta_append(string_to_sign, utc_date);
+   string_to_sign = pgmoneta_append(string_to_sign, "\nx-ms-version:2021-08-06\n");
+   string_to_sign = pgmoneta_append(string_to_sign, resource);
 
-   if (pgmoneta_generate_string_hmac_sha256_hash(signing_key, signing_key_length, string_to_sign, strlen(string_to_sign), &signature_hmac, &hmac_length))
+   if (azure_get_authorization(string_to_sign, &auth_value))
    {
       goto error;
    }
 
-   pgmoneta_base64_encode((char*) signature_hmac, hmac_length, &base64_signature, &base64_signature_length);
-
-   auth_value = pgmoneta_append(auth_value, "SharedKey ");
-   auth_value = pgmoneta_append(auth_value, config->azure_storage_account);
-   auth_value = pgmoneta_append(auth_value, ":");
-   auth_value = pgmoneta_append(auth_value, base64_signature);
-
    azure_host = azure_get_host();
 
-   if (pgmoneta_http_create(azure_host, 443, true, &connection))
+   if (azure_connect(&connection))
    {
       pgmoneta_log_error("Failed to connect to Azure host: %s", azure_host);
       goto error;
    }
 
-   snprintf(azure_put_path, sizeof(azure_put_path), "/%s/%s", config->azure_container, azure_path);
-
    if (pgmoneta_http_request_create(PGMONETA_HTTP_PUT, azure_put_path, &request))
    {
       goto error;
@@ -490,11 +488,10 @@ azure_send_upload_request(char* local_root, char* azure_root, char* relative_pat
    free(local_path);
    free(azure_path);
    free(azure_host);
-   free(base64_signature);
-   free(signature_hmac);
+   free(azure_put_path);
+   free(resource);
    free(string_to_sign);
    free(auth_value);
-   free(signing_key);
    free(file_data);
 
    pgmoneta_http_request_destroy(request);
@@ -520,20 +517,8 @@ error:
       free(azure_host);
    }
 
-   if (signing_key != NULL)
-   {
-      free(signing_key);
-   }
-
-   if (base64_signature != NULL)
-   {
-      free(base64_signature);
-   }
-
-   if (signature_hmac != NULL)
-   {
-      free(signature_hmac);
-   }
+   free(azure_put_path);
+   free(resource);
 
    if (string_to_sign != NULL)
    {
@@ -573,6 +558,434 @@ error:
    return 1;
 }
 
+int
+pgmoneta_azure_wal_upload(int server, char* filename)
+{
+   int ret = 1;
+   char* local_root = NULL;
+   char* remote_root = NULL;
+
+   local_root = pgmoneta_get_server_wal(server);
+   remote_root = azure_get_wal_path(server);
+
+   ret = azure_send_upload_request(local_root, remote_root, filename);
+
+   free(local_root);
+   free(remote_root);
+
+   return ret;
+}
+
+int
+pgmoneta_azure_download(int server, char* label)
+{
+   int ret = 1;
+   struct download_engine engine;
+
+   memset(&engine, 0, sizeof(struct download_engine));
+   engine.name = azure_storage_name();
+   engine.server = server;
+   engine.root = azure_get_basepath(server, label);
+   engine.list = &azure_list;
+   engine.get = &azure_get;
+
+   ret = pgmoneta_download_backup(&engine, label);
+
+   free(engine.root);
+
+   return ret;
+}
+
+static int
+azure_list(struct download_engine* engine, struct deque* objects)
+{
+   char utc_date[UTC_TIME_LENGTH];
+   int status_code = 0;
+   char* prefix = NULL;
+   char* encoded_prefix = NULL;
+   char* marker = NULL;
+   char* path = NULL;
+   char* resource = NULL;
+   char* request_path = NULL;
+   char* string_to_sign = NULL;
+   char* auth_value = NULL;
+   struct download_buffer buffer = {0};
+   struct http* connection = NULL;
+   struct http_request* request = NULL;
+
+   prefix = pgmoneta_append(prefix, engine->root);
+   prefix = pgmoneta_append(prefix, "/");
+   encoded_prefix = pgmoneta_http_uri_encode(prefix);
+
+   path = azure_get_request_path("");
+   resource = azure_get_resource(path);
+
+   do
+   {
+      char* p = NULL;
+      char* blob = NULL;
+
+      memset(&utc_date[0], 0, sizeof(utc_date));
+
+      if (pgmoneta_get_timestamp_UTC_format(utc_date))
+      {
+         goto error;
+      }
+
+      free(string_to_sign);
+      string_to_sign = NULL;
+      string_to_sign = pgmoneta_append(string_to_sign, "GET\n\n\n\n\n\n\n\n\n\n\n\nx-ms-date:");
+      string_to_sign = pgmoneta_append(string_to_sign, utc_date);
+      string_to_sign = pgmoneta_append(string_to_sign, "\nx-ms-version:2021-08-06\n");
+      string_to_sign = pgmoneta_append(string_to_sign, resource);
+      string_to_sign = pgmoneta_append(string_to_sign, "\ncomp:list");
+      if (marker != NULL)
+      {
+         string_to_sign = pgmoneta_append(string_to_sign, "\nmarker:");
+         string_to_sign = pgmoneta_append(string_to_sign, marker);
+      }
+      string_to_sign = pgmoneta_append(string_to_sign, "\nprefix:");
+      string_to_sign = pgmoneta_append(string_to_sign, prefix);
+      string_to_sign = pgmoneta_append(string_to_sign, "\nrestype:container");
+
+      free(auth_value);
+      auth_value = NULL;
+      if (azure_get_authorization(string_to_sign, &auth_value))
+      {
+         goto error;
+      }
+
+      free(request_path);
+      request_path = NULL;
+      request_path = pgmoneta_append(request_path, path);
+      request_path = pgmoneta_append(request_path, "?restype=container&comp=list&prefix=");
+      request_path = pgmoneta_append(request_path, encoded_prefix);
+      if (marker != NULL)
+      {
+         char* encoded_marker = pgmoneta_http_uri_encode(marker);
+
+         request_path = pgmoneta_append(request_path, "&marker=");
+         request_path = pgmoneta_append(request_path, encoded_marker);
+         free(encoded_marker);
+      }
+
+      if (azure_connect(&connection))
+      {
+         goto error;
+      }
+
+      if (pgmoneta_http_request_create(PGMONETA_HTTP_GET, request_path, &request))
+      {
+         goto error;
+      }
+
+      if (pgmoneta_http_request_add_header(request, "Authorization", auth_value) ||
+          pgmoneta_http_request_add_header(request, "x-ms-date", utc_date) ||
+          pgmoneta_http_request_add_header(request, "x-ms-version", "2021-08-06"))
+      {
+         goto error;
+      }
+
+      free(buffer.data);
+      buffer.data = NULL;
+      buffer.size = 0;
+
+      if (pgmoneta_http_invoke_stream(connection, request, pgmoneta_download_buffer_sink, &buffer, &status_code))
+      {
+         goto error;
+      }
+
+      if (status_code != 200)
+      {
+         pgmoneta_log_error("Azure list of %s failed with status code: %d", prefix, status_code);
+         goto error;
+      }
+
+      p = buffer.data;
+      while ((blob = pgmoneta_download_xml_value(p, "Blob", &p)) != NULL)
+      {
+         char* name = pgmoneta_download_xml_value(blob, "Name", NULL);
+         char* size = pgmoneta_download_xml_value(blob, "Content-Length", NULL);
+
+         if (name != NULL && size != NULL && pgmoneta_starts_with(name, prefix))
+         {
+            pgmoneta_deque_add(objects, name + strlen(prefix), (uintptr_t)strtoull(size, NULL, 10), ValueUInt64);
+         }
+
+         free(name);
+         free(size);
+         free(blob);
+      }
+
+      free(marker);
+      marker = pgmoneta_download_xml_value(buffer.data, "NextMarker", NULL);
+      if (marker != NULL && strlen(marker) == 0)
+      {
+         free(marker);
+         marker = NULL;
+      }
+
+      pgmoneta_http_request_destroy(request);
+      request = NULL;
+      pgmoneta_http_destroy(connection);
+      connection = NULL;
+   }
+   while (marker != NULL);
+
+   free(prefix);
+   free(encoded_prefix);
+   free(path);
+   free(resource);
+   free(request_path);
+   free(string_to_sign);
+   free(auth_value);
+   free(buffer.data);
+
+   return 0;
+
+error:
+
+   pgmoneta_http_request_destroy(request);
+   pgmoneta_http_destroy(connection);
+
+   free(prefix);
+   free(encoded_prefix);
+   free(marker);
+   free(path);
+   free(resource);
+   free(request_path);
+   free(string_to_sign);
+   free(auth_value);
+   free(buffer.data);
+
+   return 1;
+}
+
+static int
+azure_get(struct download_engine* engine, char* key, uint64_t offset, uint64_t length,
+          struct http** connection, struct http_request** request)
+{
+   char utc_date[UTC_TIME_LENGTH];
+   char range[128];
+   char* azure_path = NULL;
+   char* request_path = NULL;
+   char* resource = NULL;
+   char* string_to_sign = NULL;
+   char* auth_value = NULL;
+   struct http* c = NULL;
+   struct http_request* r = NULL;
+
+   *connection = NULL;
+   *request = NULL;
+
+   memset(&utc_date[0], 0, sizeof(utc_date));
+   memset(&range[0], 0, sizeof(range));
+
+   if (pgmoneta_get_timestamp_UTC_format(utc_date))
+   {
+      goto error;
+   }
+
+   if (length > 0)
+   {
+      snprintf(range, sizeof(range), "bytes=%" PRIu64 "-%" PRIu64, offset, offset + length - 1);
+   }
+
+   azure_path = pgmoneta_append(azure_path, engine->root);
+   azure_path = pgmoneta_append(azure_path, "/");
+   azure_path = pgmoneta_append(azure_path, key);
+
+   request_path = azure_get_request_path(azure_path);
+   resource = azure_get_resource(request_path);
+
+   string_to_sign = pgmoneta_append(string_to_sign, "GET\n\n\n\n\n\n\n\n\n\n\n");
+   string_to_sign = pgmoneta_append(string_to_sign, range);
+   string_to_sign = pgmoneta_append(string_to_sign, "\nx-ms-date:");
+   string_to_sign = pgmoneta_append(string_to_sign, utc_date);
+   string_to_sign = pgmoneta_append(string_to_sign, "\nx-ms-version:2021-08-06\n");
+   string_to_sign = pgmoneta_append(string_to_sign, resource);
+
+   if (azure_get_authorization(string_to_sign, &auth_value))
+   {
+      goto error;
+   }
+
+   if (azure_connect(&c))
+   {
+      goto error;
+   }
+
+   if (pgmoneta_http_request_create(PGMONETA_HTTP_GET, request_path, &r))
+   {
+      goto error;
+   }
+
+   if (pgmoneta_http_request_add_header(r, "Authorization", auth_value) ||
+       pgmoneta_http_request_add_header(r, "x-ms-date", utc_date) ||
+       pgmoneta_http_request_add_header(r, "x-ms-version", "2021-08-06"))
+   {
+      goto error;
+   }
+
+   if (length > 0 && pgmoneta_http_request_add_header(r, "Range", range))
+   {
+      goto error;
+   }
+
+   *connection = c;
+   *request = r;
+
+   free(azure_path);
+   free(request_path);
+   free(resource);
+   free(string_to_sign);
+   free(auth_value);
+
+   return 0;
+
+error:
+
+   pgmoneta_http_request_destroy(r);
+   pgmoneta_http_destroy(c);
+
+   free(azure_path);
+   free(request_path);
+   free(resource);
+   free(string_to_sign);
+   free(auth_value);
+
+   return 1;
+}
+
+static int
+azure_get_authorization(char* string_to_sign, char** auth_value)
+{
+   char* signing_key = NULL;
+   char* base64_signature = NULL;
+   size_t base64_signature_length;
+   size_t signing_key_length = 0;
+   unsigned char* signature_hmac = NULL;
+   int hmac_length = 0;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   *auth_value = NULL;
+
+   if (pgmoneta_base64_decode(config->azure_shared_key, strlen(config->azure_shared_key), (void**)&signing_key, &signing_key_length))
+   {
+      goto error;
+   }
+
+   if (pgmoneta_generate_string_hmac_sha256_hash(signing_key, signing_key_length, string_to_sign, strlen(string_to_sign), &signature_hmac, &hmac_length))
+   {
+      goto error;
+   }
+
+   pgmoneta_base64_encode((char*) signature_hmac, hmac_length, &base64_signature, &base64_signature_length);
+
+   *auth_value = pgmoneta_append(*auth_value, "SharedKey ");
+   *auth_value = pgmoneta_append(*auth_value, config->azure_storage_account);
+   *auth_value = pgmoneta_append(*auth_value, ":");
+   *auth_value = pgmoneta_append(*auth_value, base64_signature);
+
+   free(signing_key);
+   free(signature_hmac);
+   free(base64_signature);
+
+   return 0;
+
+error:
+
+   free(signing_key);
+   free(signature_hmac);
+   free(base64_signature);
+
+   return 1;
+}
+
+static int
+azure_connect(struct http** connection)
+{
+   int port = 443;
+   bool secure = true;
+   char* host = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   if (strlen(config->azure_endpoint) > 0)
+   {
+      if (pgmoneta_http_parse_endpoint(config->azure_endpoint, &host, &port, &secure))
+      {
+         pgmoneta_log_error("Invalid azure_endpoint: %s", config->azure_endpoint);
+         goto error;
+      }
+   }
+   else
+   {
+      host = azure_get_host();
+   }
+
+   if (pgmoneta_http_create(host, port, secure, connection))
+   {
+      goto error;
+   }
+
+   free(host);
+
+   return 0;
+
+error:
+
+   free(host);
+
+   return 1;
+}
+
+static char*
+azure_get_request_path(char* path)
+{
+   char* p = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   p = pgmoneta_append(p, "/");
+
+   /* Emulators use path style addressing */
+   if (strlen(config->azure_endpoint) > 0)
+   {
+      p = pgmoneta_append(p, config->azure_storage_account);
+      p = pgmoneta_append(p, "/");
+   }
+
+   p = pgmoneta_append(p, config->azure_container);
+
+   if (strlen(path) > 0)
+   {
+      p = pgmoneta_append(p, "/");
+      p = pgmoneta_append(p, path);
+   }
+
+   return p;
+}
+
+static char*
+azure_get_resource(char* request_path)
+{
+   char* r = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   r = pgmoneta_append(r, "/");
+   r = pgmoneta_append(r, config->azure_storage_account);
+   r = pgmoneta_append(r, request_path);
+
+   return r;
+}
+
 static char*
 azure_get_host()
 {
@@ -607,6 +1020,25 @@ azure_get_basepath(int server, char* identifier)
    return d;
 }
 
+static char*
+azure_get_wal_path(int server)
+{
+   char* d = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   d = pgmoneta_append(d, config->azure_base_dir);
+   if (!pgmoneta_ends_with(config->azure_base_dir, "/"))
+   {
+      d = pgmoneta_append(d, "/");
+   }
+   d = pgmoneta_append(d, config->common.servers[server].name);
+   d = pgmoneta_append(d, "/wal");
+
+   return d;
+}
+
 static int
 azure_add_request_headers(struct http_request* request, char* auth_value, char* utc_date)
 {
@@ -28,19 +28,25 @@
 
 /* pgmoneta */
 #include <pgmoneta.h>
+#include <deque.h>
+#include <download.h>
 #include <http.h>
 #include <logging.h>
 #include <security.h>
+#include <storage.h>
 #include <utils.h>
 #include <workflow.h>
 
 /* system */
 #include <assert.h>
 #include <dirent.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#define S3_EMPTY_SHA256 "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"
+
 static char* s3_storage_name(void);
 static int s3_storage_setup(char*, struct art*);
 static int s3_storage_execute(char*, struct art*);
@@ -50,8 +56,18 @@ static int s3_upload_files(char* local_root, char* s3_root, char* relative_path)
 static int s3_send_upload_request(char* local_root, char* s3_root, char* relative_path);
 static int s3_add_request_headers(struct http_request* request, char* auth_value, char* file_sha256, char* long_date);
 
+static int s3_get_authorization(char* method, char* path, char* query, char* host, char* payload_sha256,
+                                char* short_date, char* long_date, bool storage_class, char** auth_value);
+static int s3_connect(struct http** connection);
+
+static int s3_list(struct download_engine* engine, struct deque* objects);
+static int s3_get(struct download_engine* engine, char* key, uint64_t offset, uint64_t length,
+                  struct http** connection, struct http_request** request);
+
 static char* s3_get_host(void);
+static char* s3_get_request_path(char* path);
 static char* s3_get_basepath(int server, char* identifier);
+static char* s3_get_wal_path(int server);
 
 struct workflow*
 pgmoneta_storage_create_s3(void)
@@ -286,33 +302,18 @@ s3_send_upload_request(char* local_root, char* s3_root, char* relative_path)
 {
    char short_date[SHORT_TIME_LENGTH];
    char long_date[LONG_TIME_LENGTH];
-   char* canonical_request = NULL;
    char* auth_value = NULL;
-   char* string_to_sign = NULL;
    char* s3_host = NULL;
    char* s3_path = NULL;
    char* request_path = NULL;
    char* file_sha256 = NULL;
-   char* canonical_request_sha256 = NULL;
-   char* key = NULL;
    char* local_path = NULL;
-   unsigned char* date_key_hmac = NULL;
-   unsigned char* date_region_key_hmac = NULL;
-   unsigned char* date_region_service_key_hmac = NULL;
-   unsigned char* signing_key_hmac = NULL;
-   unsigned char* signature_hmac = NULL;
-   unsigned char* signature_hex = NULL;
-   int hmac_length = 0;
    FILE* file = NULL;
    struct stat file_info;
    void* file_data = NULL;
    struct http* connection = NULL;
    struct http_request* request = NULL;
    struct http_response* response = NULL;
-   struct main_configuration* config;
-
-   config = (struct main_configuration*)shmem;
-
    local_path = pgmoneta_append(local_path, local_root);
    if (strlen(relative_path) > 0)
    {
@@ -344,68 +345,13 @@ s3_send_upload_request(char* local_root, char* s3_root, char* relative_path)
    pgmoneta_create_sha256_file(local_path, &file_sha256);
 
    s3_host = s3_get_host();
+   request_path = s3_get_request_path(s3_path);
 
-   canonical_request = pgmoneta_append(canonical_request, "PUT\n/");
-   canonical_request = pgmoneta_append(canonical_request, s3_path);
-   canonical_request = pgmoneta_append(canonical_request, "\n\nhost:");
-   canonical_request = pgmoneta_append(canonical_request, s3_host);
-   canonical_request = pgmoneta_append(canonical_request, "\nx-amz-content-sha256:");
-   canonical_request = pgmoneta_append(canonical_request, file_sha256);
-   canonical_request = pgmoneta_append(canonical_request, "\nx-amz-date:");
-   canonical_request = pgmoneta_append(canonical_request, long_date);
-   canonical_request = pgmoneta_append(canonical_request, "\nx-amz-storage-class:REDUCED_REDUNDANCY\n\nhost;x-amz-content-sha256;x-amz-date;x-amz-storage-class\n");
-   canonical_request = pgmoneta_append(canonical_request, file_sha256);
-
-   pgmoneta_generate_string_sha256_hash(canonical_request, &canonical_request_sha256);
-
-   string_to_sign = pgmoneta_append(string_to_sign, "AWS4-HMAC-SHA256\n");
-   string_to_sign = pgmoneta_append(string_to_sign, long_date);
-   string_to_sign = pgmoneta_append(string_to_sign, "\n");
-   string_to_sign = pgmoneta_append(string_to_sign, short_date);
-   string_to_sign = pgmoneta_append(string_to_sign, "/");
-   string_to_sign = pgmoneta_append(string_to_sign, config->s3_aws_region);
-   string_to_sign = pgmoneta_append(string_to_sign, "/s3/aws4_request\n");
-   string_to_sign = pgmoneta_append(string_to_sign, canonical_request_sha256);
-
-   key = pgmoneta_append(key, "AWS4");
-   key = pgmoneta_append(key, config->s3_secret_access_key);
-
-   if (pgmoneta_generate_string_hmac_sha256_hash(key, strlen(key), short_date, SHORT_TIME_LENGTH - 1, &date_key_hmac, &hmac_length))
-   {
-      goto error;
-   }
-
-   if (pgmoneta_generate_string_hmac_sha256_hash((char*)date_key_hmac, hmac_length, config->s3_aws_region, strlen(config->s3_aws_region), &date_region_key_hmac, &hmac_length))
-   {
-      goto error;
-   }
-
-   if (pgmoneta_generate_string_hmac_sha256_hash((char*)date_region_key_hmac, hmac_length, "s3", strlen("s3"), &date_region_service_key_hmac, &hmac_length))
-   {
-      goto error;
-   }
-
-   if (pgmoneta_generate_string_hmac_sha256_hash((char*)date_region_service_key_hmac, hmac_length, "aws4_request", strlen("aws4_request"), &signing_key_hmac, &hmac_length))
-   {
-      goto error;
-   }
-
-   if (pgmoneta_generate_string_hmac_sha256_hash((char*)signing_key_hmac, hmac_length, string_to_sign, strlen(string_to_sign), &signature_hmac, &hmac_length))
+   if (s3_get_authorization("PUT", request_path, "", s3_host, file_sha256, short_date, long_date, true, &auth_value))
    {
       goto error;
    }
 
-   pgmoneta_convert_base32_to_hex(signature_hmac, hmac_length, &signature_hex);
-
-   auth_value = pgmoneta_append(auth_value, "AWS4-HMAC-SHA256 Credential=");
-   auth_value = pgmoneta_append(auth_value, config->s3_access_key_id);
-   auth_value = pgmoneta_append(auth_value, "/");
-   auth_value = pgmoneta_append(auth_value, short_date);
-   auth_value = pgmoneta_append(auth_value, "/");
-   auth_value = pgmoneta_append(auth_value, config->s3_aws_region);
-   auth_value = pgmoneta_append(auth_value, "/s3/aws4_request,SignedHeaders=host;x-amz-content-sha256;x-amz-date;x-amz-storage-class,Signature=");
-   auth_value = pgmoneta_append(auth_value, (char*)signature_hex);
-
    file = fopen(local_path, "rb");
    if (file == NULL)
    {
@@ -431,14 +377,11 @@ s3_send_upload_request(char* local_root, char* s3_root, char* relative_path)
    fclose(file);
    file = NULL;
 
-   if (pgmoneta_http_create(s3_host, 443, true, &connection))
+   if (s3_connect(&connection))
    {
       goto error;
    }
 
-   request_path = pgmoneta_append(request_path, "/");
-   request_path = pgmoneta_append(request_path, s3_path);
-
    if (pgmoneta_http_request_create(PGMONETA_HTTP_PUT, request_path, &request))
    {
       goto error;
@@ -473,18 +416,8 @@ s3_send_upload_request(char* local_root, char* s3_root, char* relative_path)
    free(s3_host);
    free(request_path);
    free(file_sha256);
-   free(signature_hex);
-   free(signature_hmac);
-   free(signing_key_hmac);
-   free(date_region_service_key_hmac);
-   free(date_region_key_hmac);
-   free(date_key_hmac);
-   free(key);
    free(local_path);
    free(s3_path);
-   free(canonical_request_sha256);
-   free(canonical_request);
-   free(string_to_sign);
    free(auth_value);
    free(file_data);
 
@@ -498,20 +431,9 @@ error:
 
    free(s3_host);
    free(request_path);
-   free(signature_hex);
-   free(signature_hmac);
-
-   free(signing_key_hmac);
-   free(date_region_service_key_hmac);
-   free(date_region_key_hmac);
-   free(date_key_hmac);
-   free(key);
    free(local_path);
    free(s3_path);
-   free(canonical_request_sha256);
    free(file_sha256);
-   free(canonical_request);
-   free(string_to_sign);
    free(auth_value);
    free(file_data);
 
@@ -538,14 +460,508 @@ error:
    return 1;
 }
 
+int
+pgmoneta_s3_wal_upload(int server, char* filename)
+{
+   int ret = 1;
+   char* local_root = NULL;
+   char* remote_root = NULL;
+
+   local_root = pgmoneta_get_server_wal(server);
+   remote_root = s3_get_wal_path(server);
+
+   ret = s3_send_upload_request(local_root, remote_root, filename);
+
+   free(local_root);
+   free(remote_root);
+
+   return ret;
+}
+
+int
+pgmoneta_s3_download(int server, char* label)
+{
+   int ret = 1;
+   struct download_engine engine;
+
+   memset(&engine, 0, sizeof(struct download_engine));
+   engine.name = s3_storage_name();
+   engine.server = server;
+   engine.root = s3_get_basepath(server, label);
+   engine.list = &s3_list;
+   engine.get = &s3_get;
+
+   ret = pgmoneta_download_backup(&engine, label);
+
+   free(engine.root);
+
+   return ret;
+}
+
+static int
+s3_list(struct download_engine* engine, struct deque* objects)
+{
+   char short_date[SHORT_TIME_LENGTH];
+   char long_date[LONG_TIME_LENGTH];
+   int status_code = 0;
+   bool truncated = true;
+   char* prefix = NULL;
+   char* encoded_prefix = NULL;
+   char* token = NULL;
+   char* query = NULL;
+   char* path = NULL;
+   char* request_path = NULL;
+   char* is_truncated = NULL;
+   char* s3_host = NULL;
+   char* auth_value = NULL;
+   struct download_buffer buffer = {0};
+   struct http* connection = NULL;
+   struct http_request* request = NULL;
+
+   prefix = pgmoneta_append(prefix, engine->root);
+   prefix = pgmoneta_append(prefix, "/");
+   encoded_prefix = pgmoneta_http_uri_encode(prefix);
+
+   s3_host = s3_get_host();
+   path = s3_get_request_path("");
+
+   while (truncated)
+   {
+      char* p = NULL;
+      char* contents = NULL;
+
+      memset(&short_date[0], 0, sizeof(short_date));
+      memset(&long_date[0], 0, sizeof(long_date));
+
+      if (pgmoneta_get_timestamp_ISO8601_format(short_date, long_date))
+      {
+         goto error;
+      }
+
+      /* The canonical query string is sorted by name */
+      free(query);
+      query = NULL;
+      if (token != NULL)
+      {
+         char* encoded_token = pgmoneta_http_uri_encode(token);
+
+         query = pgmoneta_append(query, "continuation-token=");
+         query = pgmoneta_append(query, encoded_token);
+         query = pgmoneta_append(query, "&");
+         free(encoded_token);
+      }
+      query = pgmoneta_append(query, "list-type=2&prefix=");
+      query = pgmoneta_append(query, encoded_prefix);
+
+      free(auth_value);
+      auth_value = NULL;
+      if (s3_get_authorization("GET", path, query, s3_host, S3_EMPTY_SHA256, short_date, long_date, false, &auth_value))
+      {
+         goto error;
+      }
+
+      if (s3_connect(&connection))
+      {
+         goto error;
+      }
+
+      free(request_path);
+      request_path = NULL;
+      request_path = pgmoneta_append(request_path, path);
+      request_path = pgmoneta_append(request_path, "?");
+      request_path = pgmoneta_append(request_path, query);
+
+      if (pgmoneta_http_request_create(PGMONETA_HTTP_GET, request_path, &request))
+      {
+         goto error;
+      }
+
+      if (pgmoneta_http_request_add_header(request, "Authorization", auth_value) ||
+          pgmoneta_http_request_add_header(request, "x-amz-content-sha256", S3_EMPTY_SHA256) ||
+          pgmoneta_http_request_add_header(request, "x-amz-date", long_date))
+      {
+         goto error;
+      }
+
+      free(buffer.data);
+      buffer.data = NULL;
+      buffer.size = 0;
+
+      if (pgmoneta_http_invoke_stream(connection, request, pgmoneta_download_buffer_sink, &buffer, &status_code))
+      {
+         goto error;
+      }
+
+      if (status_code != 200)
+      {
+         pgmoneta_log_error("S3 list of %s failed with status code: %d", prefix, status_code);
+         goto error;
+      }
+
+      p = buffer.data;
+      while ((contents = pgmoneta_download_xml_value(p, "Contents", &p)) != NULL)
+      {
+         char* key = pgmoneta_download_xml_value(contents, "Key", NULL);
+         char* size = pgmoneta_download_xml_value(contents, "Size", NULL);
+
+         if (key != NULL && size != NULL && pgmoneta_starts_with(key, prefix) && !pgmoneta_ends_with(key, "/"))
+         {
+            pgmoneta_deque_add(objects, key + strlen(prefix), (uintptr_t)strtoull(size, NULL, 10), ValueUInt64);
+         }
+
+         free(key);
+         free(size);
+         free(contents);
+      }
+
+      is_truncated = pgmoneta_download_xml_value(buffer.data, "IsTruncated", NULL);
+      truncated = is_truncated != NULL && !strcmp(is_truncated, "true");
+      free(is_truncated);
+      is_truncated = NULL;
+
+      free(token);
+      token = NULL;
+
+      if (truncated)
+      {
+         token = pgmoneta_download_xml_value(buffer.data, "NextContinuationToken", NULL);
+         if (token == NULL)
+         {
+            truncated = false;
+         }
+      }
+
+      pgmoneta_http_request_destroy(request);
+      request = NULL;
+      pgmoneta_http_destroy(connection);
+      connection = NULL;
+   }
+
+   free(prefix);
+   free(encoded_prefix);
+   free(token);
+   free(query);
+   free(path);
+   free(request_path);
+   free(s3_host);
+   free(auth_value);
+   free(buffer.data);
+
+   return 0;
+
+error:
+
+   pgmoneta_http_request_destroy(request);
+   pgmoneta_http_destroy(connection);
+
+   free(prefix);
+   free(encoded_prefix);
+   free(token);
+   free(query);
+   free(path);
+   free(request_path);
+   free(s3_host);
+   free(auth_value);
+   free(buffer.data);
+
+   return 1;
+}
+
+static int
+s3_get(struct download_engine* engine, char* key, uint64_t offset, uint64_t length,
+       struct http** connection, struct http_request** request)
+{
+   char short_date[SHORT_TIME_LENGTH];
+   char long_date[LONG_TIME_LENGTH];
+   char range[128];
+   char* s3_path = NULL;
+   char* s3_host = NULL;
+   char* request_path = NULL;
+   char* auth_value = NULL;
+   struct http* c = NULL;
+   struct http_request* r = NULL;
+
+   *connection = NULL;
+   *request = NULL;
+
+   memset(&short_date[0], 0, sizeof(short_date));
+   memset(&long_date[0], 0, sizeof(long_date));
+
+   if (pgmoneta_get_timestamp_ISO8601_format(short_date, long_date))
+   {
+      goto error;
+   }
+
+   s3_path = pgmoneta_append(s3_path, engine->root);
+   s3_path = pgmoneta_append(s3_path, "/");
+   s3_path = pgmoneta_append(s3_path, key);
+
+   s3_host = s3_get_host();
+   request_path = s3_get_request_path(s3_path);
+
+   if (s3_get_authorization("GET", request_path, "", s3_host, S3_EMPTY_SHA256, short_date, long_date, false, &auth_value))
+   {
+      goto error;
+   }
+
+   if (s3_connect(&c))
+   {
+      goto error;
+   }
+
+   if (pgmoneta_http_request_create(PGMONETA_HTTP_GET, request_path, &r))
+   {
+      goto error;
+   }
+
+   if (pgmoneta_http_request_add_header(r, "Authorization", auth_value) ||
+       pgmoneta_http_request_add_header(r, "x-amz-content-sha256", S3_EMPTY_SHA256) ||
+       pgmoneta_http_request_add_header(r, "x-amz-date", long_date))
+   {
+      goto error;
+   }
+
+   if (length > 0)
+   {
+      snprintf(range, sizeof(range), "bytes=%" PRIu64 "-%" PRIu64, offset, offset + length - 1);
+      if (pgmoneta_http_request_add_header(r, "Range", range))
+      {
+         goto error;
+      }
+   }
+
+   *connection = c;
+   *request = r;
+
+   free(s3_path);
+   free(s3_host);
+   free(request_path);
+   free(auth_value);
+
+   return 0;
+
+error:
+
+   pgmoneta_http_request_destroy(r);
+   pgmoneta_http_destroy(c);
+
+   free(s3_path);
+   free(s3_host);
+   free(request_path);
+   free(auth_value);
+
+   return 1;
+}
+
+static int
+s3_get_authorization(char* method, char* path, char* query, char* host, char* payload_sha256,
+                     char* short_date, char* long_date, bool storage_class, char** auth_value)
+{
+   char* canonical_request = NULL;
+   char* canonical_request_sha256 = NULL;
+   char* string_to_sign = NULL;
+   char* signed_headers = NULL;
+   char* key = NULL;
+   unsigned char* date_key_hmac = NULL;
+   unsigned char* date_region_key_hmac = NULL;
+   unsigned char* date_region_service_key_hmac = NULL;
+   unsigned char* signing_key_hmac = NULL;
+   unsigned char* signature_hmac = NULL;
+   unsigned char* signature_hex = NULL;
+   int hmac_length = 0;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   *auth_value = NULL;
+
+   if (storage_class)
+   {
+      signed_headers = "host;x-amz-content-sha256;x-amz-date;x-amz-storage-class";
+   }
+   else
+   {
+      signed_headers = "host;x-amz-content-sha256;x-amz-date";
+   }
+
+   canonical_request = pgmoneta_append(canonical_request, method);
+   canonical_request = pgmoneta_append(canonical_request, "\n");
+   canonical_request = pgmoneta_append(canonical_request, path);
+   canonical_request = pgmoneta_append(canonical_request, "\n");
+   canonical_request = pgmoneta_append(canonical_request, query);
+   canonical_request = pgmoneta_append(canonical_request, "\nhost:");
+   canonical_request = pgmoneta_append(canonical_request, host);
+   canonical_request = pgmoneta_append(canonical_request, "\nx-amz-content-sha256:");
+   canonical_request = pgmoneta_append(canonical_request, payload_sha256);
+   canonical_request = pgmoneta_append(canonical_request, "\nx-amz-date:");
+   canonical_request = pgmoneta_append(canonical_request, long_date);
+   if (storage_class)
+   {
+      canonical_request = pgmoneta_append(canonical_request, "\nx-amz-storage-class:REDUCED_REDUNDANCY");
+   }
+   canonical_request = pgmoneta_append(canonical_request, "\n\n");
+   canonical_request = pgmoneta_append(canonical_request, signed_headers);
+   canonical_request = pgmoneta_append(canonical_request, "\n");
+   canonical_request = pgmoneta_append(canonical_request, payload_sha256);
+
+   pgmoneta_generate_string_sha256_hash(canonical_request, &canonical_request_sha256);
+
+   string_to_sign = pgmoneta_append(string_to_sign, "AWS4-HMAC-SHA256\n");
+   string_to_sign = pgmoneta_append(string_to_sign, long_date);
+   string_to_sign = pgmoneta_append(string_to_sign, "\n");
+   string_to_sign = pgmoneta_append(string_to_sign, short_date);
+   string_to_sign = pgmoneta_append(string_to_sign, "/");
+   string_to_sign = pgmoneta_append(string_to_sign, config->s3_aws_region);
+   string_to_sign = pgmoneta_append(string_to_sign, "/s3/aws4_request\n");
+   string_to_sign = pgmoneta_append(string_to_sign, canonical_request_sha256);
+
+   key = pgmoneta_append(key, "AWS4");
+   key = pgmoneta_append(key, config->s3_secret_access_key);
+
+   if (pgmoneta_generate_string_hmac_sha256_hash(key, strlen(key), short_date, SHORT_TIME_LENGTH - 1, &date_key_hmac, &hmac_length))
+   {
+      goto error;
+   }
+
+   if (pgmoneta_generate_string_hmac_sha256_hash((char*)date_key_hmac, hmac_length, config->s3_aws_region, strlen(config->s3_aws_region), &date_region_key_hmac, &hmac_length))
+   {
+      goto error;
+   }
+
+   if (pgmoneta_generate_string_hmac_sha256_hash((char*)date_region_key_hmac, hmac_length, "s3", strlen("s3"), &date_region_service_key_hmac, &hmac_length))
+   {
+      goto error;
+   }
+
+   if (pgmoneta_generate_string_hmac_sha256_hash((char*)date_region_service_key_hmac, hmac_length, "aws4_request", strlen("aws4_request"), &signing_key_hmac, &hmac_length))
+   {
+      goto error;
+   }
+
+   if (pgmoneta_generate_string_hmac_sha256_hash((char*)signing_key_hmac, hmac_length, string_to_sign, strlen(string_to_sign), &signature_hmac, &hmac_length))
+   {
+      goto error;
+   }
+
+   pgmoneta_convert_base32_to_hex(signature_hmac, hmac_length, &signature_hex);
+
+   *auth_value = pgmoneta_append(*auth_value, "AWS4-HMAC-SHA256 Credential=");
+   *auth_value = pgmoneta_append(*auth_value, config->s3_access_key_id);
+   *auth_value = pgmoneta_append(*auth_value, "/");
+   *auth_value = pgmoneta_append(*auth_value, short_date);
+   *auth_value = pgmoneta_append(*auth_value, "/");
+   *auth_value = pgmoneta_append(*auth_value, config->s3_aws_region);
+   *auth_value = pgmoneta_append(*auth_value, "/s3/aws4_request,SignedHeaders=");
+   *auth_value = pgmoneta_append(*auth_value, signed_headers);
+   *auth_value = pgmoneta_append(*auth_value, ",Signature=");
+   *auth_value = pgmoneta_append(*auth_value, (char*)signature_hex);
+
+   free(signature_hex);
+   free(signature_hmac);
+   free(signing_key_hmac);
+   free(date_region_service_key_hmac);
+   free(date_region_key_hmac);
+   free(date_key_hmac);
+   free(key);
+   free(canonical_request_sha256);
+   free(canonical_request);
+   free(string_to_sign);
+
+   return 0;
+
+error:
+
+   free(signature_hex);
+   free(signature_hmac);
+   free(signing_key_hmac);
+   free(date_region_service_key_hmac);
+   free(date_region_key_hmac);
+   free(date_key_hmac);
+   free(key);
+   free(canonical_request_sha256);
+   free(canonical_request);
+   free(string_to_sign);
+
+   return 1;
+}
+
+static int
+s3_connect(struct http** connection)
+{
+   int port = 443;
+   bool secure = true;
+   char* host = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   if (strlen(config->s3_endpoint) > 0)
+   {
+      if (pgmoneta_http_parse_endpoint(config->s3_endpoint, &host, &port, &secure))
+      {
+         pgmoneta_log_error("Invalid s3_endpoint: %s", config->s3_endpoint);
+         goto error;
+      }
+   }
+   else
+   {
+      host = s3_get_host();
+   }
+
+   if (pgmoneta_http_create(host, port, secure, connection))
+   {
+      goto error;
+   }
+
+   free(host);
+
+   return 0;
+
+error:
+
+   free(host);
+
+   return 1;
+}
+
+static char*
+s3_get_request_path(char* path)
+{
+   char* p = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   p = pgmoneta_append(p, "/");
+
+   /* Emulators use path style addressing */
+   if (strlen(config->s3_endpoint) > 0)
+   {
+      p = pgmoneta_append(p, config->s3_bucket);
+      p = pgmoneta_append(p, "/");
+   }
+
+   p = pgmoneta_append(p, path);
+
+   return p;
+}
+
 static char*
 s3_get_host(void)
 {
    char* host = NULL;
+   int port = 0;
+   bool secure = false;
    struct main_configuration* config;
 
    config = (struct main_configuration*)shmem;
 
+   if (strlen(config->s3_endpoint) > 0 &&
+       !pgmoneta_http_parse_endpoint(config->s3_endpoint, &host, &port, &secure))
+   {
+      return host;
+   }
+
    host = pgmoneta_append(host, config->s3_bucket);
    host = pgmoneta_append(host, ".s3.");
    host = pgmoneta_append(host, config->s3_aws_region);
@@ -574,6 +990,25 @@ s3_get_basepath(int server, char* identifier)
    return d;
 }
 
+static char*
+s3_get_wal_path(int server)
+{
+   char* d = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   d = pgmoneta_append(d, config->s3_base_dir);
+   if (!pgmoneta_ends_with(config->s3_base_dir, "/"))
+   {
+      d = pgmoneta_append(d, "/");
+   }
+   d = pgmoneta_append(d, config->common.servers[server].name);
+   d = pgmoneta_append(d, "/wal");
+
+   return d;
+}
+
 static int
 s3_add_request_headers(struct http_request* request, char* auth_value, char* file_sha256, char* long_date)
 {
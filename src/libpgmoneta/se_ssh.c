@@ -31,9 +31,11 @@
 /* pgmoneta */
 #include <pgmoneta.h>
 #include <backup.h>
+#include <deque.h>
 #include <logging.h>
 #include <security.h>
 #include <utils.h>
+#include <workers.h>
 #include <workflow.h>
 
 /* system */
@@ -41,9 +43,57 @@
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <libssh/libssh.h>
 #include <libssh/sftp.h>
 
+#if LIBSSH_VERSION_INT >= SSH_VERSION_INT(0, 11, 0)
+#define HAVE_SFTP_AIO
+#endif
+
+#define SFTP_CHUNK_SIZE     (256 * 1024)
+#define SFTP_PIPELINE_DEPTH 32
+#define SFTP_MAX_SESSIONS   8
+
+/* Writes that may have completed out of order at the end of a partial file */
+#define SFTP_PIPELINE_WINDOW ((uint64_t)SFTP_PIPELINE_DEPTH * SFTP_CHUNK_SIZE)
+
+/** @struct sftp_pipeline
+ * Defines the outstanding write requests of a file
+ */
+struct sftp_pipeline
+{
+#ifdef HAVE_SFTP_AIO
+   sftp_aio requests[SFTP_PIPELINE_DEPTH]; /**< The requests */
+#endif
+   int head;                               /**< The oldest request */
+   int in_flight;                          /**< The number of requests in flight */
+};
+
+/** @struct sftp_copy_file_info
+ * Defines a file to copy
+ */
+struct sftp_copy_file_info
+{
+   char* relative_path; /**< The relative path */
+   uint64_t size;       /**< The size */
+};
+
+/** @struct sftp_copy_input
+ * Defines the files copied over one SFTP session
+ */
+struct sftp_copy_input
+{
+   struct worker_common common;          /**< The worker common */
+   char* local_root;                     /**< The local root */
+   char* remote_root;                    /**< The remote root */
+   struct sftp_copy_file_info** files;   /**< The files */
+   int number_of_files;                  /**< The number of files */
+   bool success;                         /**< Were all files copied */
+};
+
 static char* ssh_storage_name(void);
 static int ssh_storage_setup(char*, struct art*);
 static int ssh_storage_backup_execute(char*, struct art*);
@@ -59,8 +109,18 @@ static char* get_remote_server_wal(int server);
 static int read_latest_backup_sha256(char* path);
 
 static int sftp_make_directory(char* local_dir, char* remote_dir);
-static int sftp_copy_directory(char* local_root, char* remote_root, char* relative_path);
-static int sftp_copy_file(char* local_root, char* remote_root, char* relative_path);
+static int ssh_open_session(ssh_session* ssh_s, sftp_session* sftp_s);
+
+static int sftp_copy_backup(int server, char* local_root, char* remote_root);
+static void sftp_copy_cleanup(int number_of_files, struct sftp_copy_file_info** infos, int number_of_sessions, struct sftp_copy_input** inputs);
+static int sftp_copy_file_info_compare(const void* a, const void* b);
+static void do_sftp_copy(struct worker_common* wc);
+static int sftp_collect_files(char* local_root, char* remote_root, char* relative_path, struct deque* files);
+static int sftp_copy_file(ssh_session ses, sftp_session sfs, char* local_root, char* remote_root, char* relative_path);
+static size_t sftp_chunk_size(sftp_session sfs);
+static int sftp_write_file(sftp_session sfs, sftp_file dfile, FILE* sfile);
+static int sftp_pipeline_write(struct sftp_pipeline* pipeline, sftp_file file, void* data, size_t size);
+static int sftp_pipeline_drain(struct sftp_pipeline* pipeline);
 static int sftp_wal_prepare(sftp_file* file, int segsize);
 static bool sftp_exists(char* path);
 static int sftp_get_file_size(char* file_path, size_t* file_size);
@@ -75,6 +135,8 @@ static bool is_error = false;
 
 static char* latest_remote_root = NULL;
 
+static struct sftp_pipeline wal_pipeline;
+
 struct workflow*
 pgmoneta_storage_create_ssh(int workflow_type)
 {
@@ -119,6 +181,38 @@ ssh_storage_setup(char* name __attribute__((unused)), struct art* nodes)
 {
    int server = -1;
    char* label = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+#ifdef DEBUG
+   pgmoneta_dump_art(nodes);
+
+   assert(pgmoneta_art_contains_key(nodes, NODE_SERVER_ID));
+   assert(pgmoneta_art_contains_key(nodes, NODE_LABEL));
+#endif
+
+   server = (int)pgmoneta_art_search(nodes, NODE_SERVER_ID);
+   label = (char*)pgmoneta_art_search(nodes, NODE_LABEL);
+
+   pgmoneta_log_debug("SSH storage engine (setup): %s/%s", config->common.servers[server].name, label);
+
+   if (ssh_open_session(&session, &sftp))
+   {
+      is_error = true;
+      return 1;
+   }
+
+   is_error = false;
+
+   return 0;
+}
+
+static int
+ssh_open_session(ssh_session* ssh_s, sftp_session* sftp_s)
+{
+   ssh_session ses = NULL;
+   sftp_session sfs = NULL;
    ssh_key srv_pubkey = NULL;
    ssh_key client_pubkey = NULL;
    ssh_key client_privkey = NULL;
@@ -136,50 +230,41 @@ ssh_storage_setup(char* name __attribute__((unused)), struct art* nodes)
 
    config = (struct main_configuration*)shmem;
 
-#ifdef DEBUG
-   pgmoneta_dump_art(nodes);
-
-   assert(pgmoneta_art_contains_key(nodes, NODE_SERVER_ID));
-   assert(pgmoneta_art_contains_key(nodes, NODE_LABEL));
-#endif
-
-   server = (int)pgmoneta_art_search(nodes, NODE_SERVER_ID);
-   label = (char*)pgmoneta_art_search(nodes, NODE_LABEL);
-
-   pgmoneta_log_debug("SSH storage engine (setup): %s/%s", config->common.servers[server].name, label);
+   *ssh_s = NULL;
+   *sftp_s = NULL;
 
    homedir = getenv("HOME");
    pubkey_path = "/.ssh/id_rsa.pub";
    privkey_path = "/.ssh/id_rsa";
 
-   session = ssh_new();
+   ses = ssh_new();
 
-   if (session == NULL)
+   if (ses == NULL)
    {
       goto error;
    }
 
-   ssh_options_set(session, SSH_OPTIONS_USER, config->ssh_username);
-   ssh_options_set(session, SSH_OPTIONS_HOST, config->ssh_hostname);
+   ssh_options_set(ses, SSH_OPTIONS_USER, config->ssh_username);
+   ssh_options_set(ses, SSH_OPTIONS_HOST, config->ssh_hostname);
 
    if (strlen(config->ssh_ciphers) == 0)
    {
-      ssh_options_set(session, SSH_OPTIONS_CIPHERS_C_S, "aes256-ctr,aes192-ctr,aes128-ctr");
+      ssh_options_set(ses, SSH_OPTIONS_CIPHERS_C_S, "aes256-ctr,aes192-ctr,aes128-ctr");
    }
    else
    {
-      ssh_options_set(session, SSH_OPTIONS_CIPHERS_C_S, config->ssh_ciphers);
+      ssh_options_set(ses, SSH_OPTIONS_CIPHERS_C_S, config->ssh_ciphers);
    }
 
-   rc = ssh_connect(session);
+   rc = ssh_connect(ses);
    if (rc != SSH_OK)
    {
       pgmoneta_log_error("Remote Backup: Error connecting to %s: %s",
-                         config->ssh_hostname, ssh_get_error(session));
+                         config->ssh_hostname, ssh_get_error(ses));
       goto error;
    }
 
-   rc = ssh_get_server_publickey(session, &srv_pubkey);
+   rc = ssh_get_server_publickey(ses, &srv_pubkey);
    if (rc < 0)
    {
       goto error;
@@ -192,7 +277,7 @@ ssh_storage_setup(char* name __attribute__((unused)), struct art* nodes)
       goto error;
    }
 
-   state = ssh_session_is_known_server(session);
+   state = ssh_session_is_known_server(ses);
    switch (state)
    {
       case SSH_KNOWN_HOSTS_OK:
@@ -207,7 +292,7 @@ ssh_storage_setup(char* name __attribute__((unused)), struct art* nodes)
          pgmoneta_log_error("could not find known host file: %s", strerror(errno));
          goto error;
       case SSH_KNOWN_HOSTS_UNKNOWN:
-         rc = ssh_session_update_known_hosts(session);
+         rc = ssh_session_update_known_hosts(ses);
          if (rc < 0)
          {
             pgmoneta_log_error("could not update known_hosts file: %s", strerror(errno));
@@ -240,29 +325,30 @@ ssh_storage_setup(char* name __attribute__((unused)), struct art* nodes)
       goto error;
    }
 
-   rc = ssh_userauth_publickey(session, NULL, client_privkey);
+   rc = ssh_userauth_publickey(ses, NULL, client_privkey);
    if (rc != SSH_AUTH_SUCCESS)
    {
       pgmoneta_log_error("could not authenticate with public/private key: %s", strerror(errno));
       goto error;
    }
 
-   sftp = sftp_new(session);
+   sfs = sftp_new(ses);
 
-   if (sftp == NULL)
+   if (sfs == NULL)
    {
-      pgmoneta_log_error("Error: %s", ssh_get_error(session));
+      pgmoneta_log_error("Error: %s", ssh_get_error(ses));
       goto error;
    }
 
-   rc = sftp_init(sftp);
+   rc = sftp_init(sfs);
    if (rc != SSH_OK)
    {
-      pgmoneta_log_error("Error: %s", sftp_get_error(sftp));
+      pgmoneta_log_error("Error: %s", sftp_get_error(sfs));
       goto error;
    }
 
-   is_error = false;
+   *ssh_s = ses;
+   *sftp_s = sfs;
 
    ssh_string_free_char(hexa);
    ssh_clean_pubkey_hash(&srv_pubkey_hash);
@@ -277,8 +363,6 @@ ssh_storage_setup(char* name __attribute__((unused)), struct art* nodes)
 
 error:
 
-   is_error = true;
-
    ssh_string_free_char(hexa);
    ssh_clean_pubkey_hash(&srv_pubkey_hash);
    ssh_key_free(srv_pubkey);
@@ -288,10 +372,17 @@ error:
    free(pubkey_full_path);
    free(privkey_full_path);
 
-   sftp_free(sftp);
+   if (sfs != NULL)
+   {
+      sftp_free(sfs);
+   }
+
+   if (ses != NULL)
+   {
+      ssh_disconnect(ses);
+      ssh_free(ses);
+   }
 
-   ssh_disconnect(session);
-   ssh_free(session);
    return 1;
 }
 
@@ -379,13 +470,13 @@ ssh_storage_backup_execute(char* name __attribute__((unused)), struct art* nodes
       }
    }
 
-   sftp_copy_file(local_root, remote_root, "/backup.info");
-   sftp_copy_file(local_root, remote_root, "/backup.sha256");
+   sftp_copy_file(session, sftp, local_root, remote_root, "/backup.info");
+   sftp_copy_file(session, sftp, local_root, remote_root, "/backup.sha256");
 
    local_root = pgmoneta_append(local_root, "/data");
    remote_root = pgmoneta_append(remote_root, "/data");
 
-   if (sftp_copy_directory(local_root, remote_root, "") != 0)
+   if (sftp_copy_backup(server, local_root, remote_root) != 0)
    {
       pgmoneta_log_error("failed to transfer the backup directory from the local host to the remote server: %s", strerror(errno));
       goto error;
@@ -620,14 +711,259 @@ error:
 }
 
 static int
-sftp_copy_directory(char* local_root, char* remote_root, char* relative_path)
+sftp_copy_backup(int server, char* local_root, char* remote_root)
+{
+   int number_of_sessions = 0;
+   int number_of_files = 0;
+   uint64_t* totals = NULL;
+   struct deque* files = NULL;
+   struct deque_iterator* iter = NULL;
+   struct sftp_copy_file_info** infos = NULL;
+   struct sftp_copy_input** inputs = NULL;
+   struct workers* workers = NULL;
+   bool success = true;
+
+   if (pgmoneta_deque_create(false, &files))
+   {
+      goto error;
+   }
+
+   if (sftp_collect_files(local_root, remote_root, "", files))
+   {
+      goto error;
+   }
+
+   number_of_files = (int)pgmoneta_deque_size(files);
+
+   number_of_sessions = MIN(pgmoneta_get_number_of_workers(server), SFTP_MAX_SESSIONS);
+   number_of_sessions = MIN(number_of_sessions, number_of_files);
+
+   if (number_of_sessions <= 1)
+   {
+      pgmoneta_deque_iterator_create(files, &iter);
+      while (pgmoneta_deque_iterator_next(iter))
+      {
+         if (sftp_copy_file(session, sftp, local_root, remote_root, iter->tag))
+         {
+            goto error;
+         }
+      }
+      pgmoneta_deque_iterator_destroy(iter);
+      iter = NULL;
+   }
+   else
+   {
+      int n = 0;
+
+      infos = (struct sftp_copy_file_info**)calloc(number_of_files, sizeof(struct sftp_copy_file_info*));
+      inputs = (struct sftp_copy_input**)calloc(number_of_sessions, sizeof(struct sftp_copy_input*));
+      totals = (uint64_t*)calloc(number_of_sessions, sizeof(uint64_t));
+
+      if (infos == NULL || inputs == NULL || totals == NULL)
+      {
+         goto error;
+      }
+
+      pgmoneta_deque_iterator_create(files, &iter);
+      while (pgmoneta_deque_iterator_next(iter))
+      {
+         infos[n] = (struct sftp_copy_file_info*)calloc(1, sizeof(struct sftp_copy_file_info));
+         if (infos[n] == NULL)
+         {
+            goto error;
+         }
+
+         infos[n]->relative_path = iter->tag;
+         infos[n]->size = (uint64_t)pgmoneta_value_data(iter->value);
+         n++;
+      }
+      pgmoneta_deque_iterator_destroy(iter);
+      iter = NULL;
+
+      qsort(infos, number_of_files, sizeof(struct sftp_copy_file_info*), sftp_copy_file_info_compare);
+
+      for (int i = 0; i < number_of_sessions; i++)
+      {
+         inputs[i] = (struct sftp_copy_input*)calloc(1, sizeof(struct sftp_copy_input));
+         if (inputs[i] == NULL)
+         {
+            goto error;
+         }
+
+         inputs[i]->local_root = local_root;
+         inputs[i]->remote_root = remote_root;
+         inputs[i]->files = (struct sftp_copy_file_info**)calloc(number_of_files, sizeof(struct sftp_copy_file_info*));
+         inputs[i]->success = true;
+
+         if (inputs[i]->files == NULL)
+         {
+            goto error;
+         }
+      }
+
+      /* Largest files first, each to the session with the least data */
+      for (int i = 0; i < number_of_files; i++)
+      {
+         int least = 0;
+
+         for (int j = 1; j < number_of_sessions; j++)
+         {
+            if (totals[j] < totals[least])
+            {
+               least = j;
+            }
+         }
+
+         inputs[least]->files[inputs[least]->number_of_files++] = infos[i];
+         totals[least] += infos[i]->size;
+      }
+
+      if (pgmoneta_workers_initialize(number_of_sessions, &workers))
+      {
+         goto error;
+      }
+
+      for (int i = 0; i < number_of_sessions; i++)
+      {
+         pgmoneta_workers_add(workers, do_sftp_copy, (struct worker_common*)inputs[i]);
+      }
+
+      pgmoneta_workers_wait(workers);
+
+      for (int i = 0; i < number_of_sessions; i++)
+      {
+         if (!inputs[i]->success)
+         {
+            success = false;
+         }
+      }
+
+      pgmoneta_workers_destroy(workers);
+      workers = NULL;
+   }
+
+   sftp_copy_cleanup(number_of_files, infos, number_of_sessions, inputs);
+   free(totals);
+   pgmoneta_deque_destroy(files);
+
+   return success ? 0 : 1;
+
+error:
+
+   pgmoneta_deque_iterator_destroy(iter);
+   pgmoneta_workers_wait(workers);
+   pgmoneta_workers_destroy(workers);
+
+   sftp_copy_cleanup(number_of_files, infos, number_of_sessions, inputs);
+   free(totals);
+   pgmoneta_deque_destroy(files);
+
+   return 1;
+}
+
+static void
+sftp_copy_cleanup(int number_of_files, struct sftp_copy_file_info** infos, int number_of_sessions, struct sftp_copy_input** inputs)
+{
+   if (infos != NULL)
+   {
+      for (int i = 0; i < number_of_files; i++)
+      {
+         free(infos[i]);
+      }
+      free(infos);
+   }
+
+   if (inputs != NULL)
+   {
+      for (int i = 0; i < number_of_sessions; i++)
+      {
+         if (inputs[i] != NULL)
+         {
+            free(inputs[i]->files);
+            free(inputs[i]);
+         }
+      }
+      free(inputs);
+   }
+}
+
+static int
+sftp_copy_file_info_compare(const void* a, const void* b)
+{
+   struct sftp_copy_file_info* fa = *(struct sftp_copy_file_info**)a;
+   struct sftp_copy_file_info* fb = *(struct sftp_copy_file_info**)b;
+
+   if (fa->size > fb->size)
+   {
+      return -1;
+   }
+   else if (fa->size < fb->size)
+   {
+      return 1;
+   }
+
+   return 0;
+}
+
+static void
+do_sftp_copy(struct worker_common* wc)
+{
+   ssh_session ses = NULL;
+   sftp_session sfs = NULL;
+   struct sftp_copy_input* input = (struct sftp_copy_input*)wc;
+
+   if (ssh_open_session(&ses, &sfs))
+   {
+      pgmoneta_log_error("SSH: Unable to open a session");
+      goto error;
+   }
+
+   for (int i = 0; i < input->number_of_files; i++)
+   {
+      if (sftp_copy_file(ses, sfs, input->local_root, input->remote_root, input->files[i]->relative_path))
+      {
+         pgmoneta_log_error("SSH: Unable to copy %s%s", input->local_root, input->files[i]->relative_path);
+         goto error;
+      }
+   }
+
+   sftp_free(sfs);
+   ssh_disconnect(ses);
+   ssh_free(ses);
+
+   return;
+
+error:
+
+   input->success = false;
+
+   if (wc->workers != NULL)
+   {
+      wc->workers->outcome = false;
+   }
+
+   if (sfs != NULL)
+   {
+      sftp_free(sfs);
+   }
+
+   if (ses != NULL)
+   {
+      ssh_disconnect(ses);
+      ssh_free(ses);
+   }
+}
+
+static int
+sftp_collect_files(char* local_root, char* remote_root, char* relative_path, struct deque* files)
 {
    char* from = NULL;
    char* to = NULL;
-   char* relative_file;
+   char* relative_file = NULL;
    int rc;
-   DIR* dir;
+   DIR* dir = NULL;
    struct dirent* entry;
+   struct stat st;
    mode_t mode = 0;
 
    from = pgmoneta_append(from, local_root);
@@ -665,23 +1001,32 @@ sftp_copy_directory(char* local_root, char* remote_root, char* relative_path)
 
          snprintf(relative_dir, sizeof(relative_dir), "%s/%s", relative_path, entry->d_name);
 
-         sftp_copy_directory(local_root, remote_root, relative_dir);
+         if (sftp_collect_files(local_root, remote_root, relative_dir, files))
+         {
+            goto error;
+         }
       }
       else
       {
+         char* path = NULL;
+
          relative_file = NULL;
 
          relative_file = pgmoneta_append(relative_file, relative_path);
          relative_file = pgmoneta_append(relative_file, "/");
          relative_file = pgmoneta_append(relative_file, entry->d_name);
 
-         if (sftp_copy_file(local_root, remote_root, relative_file))
-         {
-            free(relative_file);
-            goto error;
-         }
+         path = pgmoneta_append(path, local_root);
+         path = pgmoneta_append(path, relative_file);
+
+         memset(&st, 0, sizeof(struct stat));
+         stat(path, &st);
+
+         pgmoneta_deque_add(files, relative_file, (uintptr_t)st.st_size, ValueUInt64);
 
+         free(path);
          free(relative_file);
+         relative_file = NULL;
       }
    }
 
@@ -694,7 +1039,10 @@ sftp_copy_directory(char* local_root, char* remote_root, char* relative_path)
 
 error:
 
-   closedir(dir);
+   if (dir != NULL)
+   {
+      closedir(dir);
+   }
 
    free(from);
    free(to);
@@ -703,17 +1051,20 @@ error:
 }
 
 static int
-sftp_copy_file(char* local_root, char* remote_root, char* relative_path)
+sftp_copy_file(ssh_session ses, sftp_session sfs, char* local_root, char* remote_root, char* relative_path)
 {
    char* s = NULL;
    char* d = NULL;
+   char* partial = NULL;
    char* sha256 = NULL;
    char* latest_sha256 = NULL;
    char* latest_backup_path = NULL;
-   char buffer[16384];
    FILE* sfile = NULL;
    sftp_file dfile = NULL;
-   unsigned long read_bytes = 0;
+   sftp_attributes attributes = NULL;
+   struct stat st;
+   uint64_t offset = 0;
+   int flags = O_WRONLY | O_CREAT | O_TRUNC;
    mode_t mode = 0;
    bool is_link = false;
 
@@ -723,14 +1074,17 @@ sftp_copy_file(char* local_root, char* remote_root, char* relative_path)
    d = pgmoneta_append(d, remote_root);
    d = pgmoneta_append(d, relative_path);
 
-   pgmoneta_create_sha256_file(s, &sha256);
+   partial = pgmoneta_append(partial, d);
+   partial = pgmoneta_append(partial, ".partial");
 
    if (latest_remote_root != NULL)
    {
+      pgmoneta_create_sha256_file(s, &sha256);
+
       latest_backup_path = pgmoneta_append(latest_backup_path, latest_remote_root);
       latest_backup_path = pgmoneta_append(latest_backup_path, relative_path);
 
-      if ((latest_sha256 = (char*)pgmoneta_art_search(tree_map, relative_path)) != NULL)
+      if (sha256 != NULL && (latest_sha256 = (char*)pgmoneta_art_search(tree_map, relative_path)) != NULL)
       {
          if (!strcmp(latest_sha256, sha256))
          {
@@ -741,14 +1095,31 @@ sftp_copy_file(char* local_root, char* remote_root, char* relative_path)
 
    if (is_link)
    {
-      if (sftp_symlink(sftp, latest_backup_path, d) < 0)
+      if (sftp_symlink(sfs, latest_backup_path, d) < 0)
       {
-         pgmoneta_log_error("Failed to link remotely: %s", ssh_get_error(session));
+         pgmoneta_log_error("Failed to link remotely: %s", ssh_get_error(ses));
          goto error;
       }
    }
    else
    {
+      if (stat(s, &st) != 0)
+      {
+         goto error;
+      }
+
+      /* The file is uploaded as .partial and renamed once complete, so only a
+       * .partial file is resumed. The pipelined writes can complete out of order,
+       * so the tail of the file may have gaps; resume before the write window */
+      attributes = sftp_stat(sfs, partial);
+      if (attributes != NULL && attributes->type == SSH_FILEXFER_TYPE_REGULAR &&
+          attributes->size <= (uint64_t)st.st_size && attributes->size > SFTP_PIPELINE_WINDOW)
+      {
+         offset = attributes->size - SFTP_PIPELINE_WINDOW;
+         offset -= offset % SFTP_CHUNK_SIZE;
+         flags = O_WRONLY;
+      }
+
       mode = pgmoneta_get_permission(s);
 
       sfile = fopen(s, "rb");
@@ -758,18 +1129,47 @@ sftp_copy_file(char* local_root, char* remote_root, char* relative_path)
          goto error;
       }
 
-      dfile = sftp_open(sftp, d, O_WRONLY | O_CREAT | O_TRUNC, mode);
+      dfile = sftp_open(sfs, partial, flags, mode);
 
       if (dfile == NULL)
       {
          goto error;
       }
 
-      memset(buffer, 0, sizeof(buffer));
+      if (offset > 0)
+      {
+         pgmoneta_log_debug("SSH: Resuming %s at %" PRIu64, partial, offset);
+
+         if (fseeko(sfile, (off_t)offset, SEEK_SET) != 0 || sftp_seek64(dfile, offset) < 0)
+         {
+            goto error;
+         }
+      }
 
-      while ((read_bytes = fread(buffer, 1, sizeof(buffer), sfile)) > 0)
+      if (sftp_write_file(sfs, dfile, sfile))
       {
-         sftp_write(dfile, buffer, read_bytes);
+         pgmoneta_log_error("SSH: Unable to write %s: %s", partial, ssh_get_error(ses));
+         goto error;
+      }
+
+      if (sftp_close(dfile) != SSH_OK)
+      {
+         dfile = NULL;
+         pgmoneta_log_error("SSH: Unable to close %s: %s", partial, ssh_get_error(ses));
+         goto error;
+      }
+      dfile = NULL;
+
+      if (sftp_rename(sfs, partial, d) < 0)
+      {
+         /* Servers without posix-rename don't replace an existing file */
+         sftp_unlink(sfs, d);
+
+         if (sftp_rename(sfs, partial, d) < 0)
+         {
+            pgmoneta_log_error("SSH: Unable to rename %s: %s", partial, ssh_get_error(ses));
+            goto error;
+         }
       }
    }
 
@@ -778,19 +1178,16 @@ sftp_copy_file(char* local_root, char* remote_root, char* relative_path)
       fclose(sfile);
    }
 
-   if (dfile != NULL)
+   if (attributes != NULL)
    {
-      sftp_close(dfile);
+      sftp_attributes_free(attributes);
    }
 
    free(s);
    free(d);
+   free(partial);
    free(sha256);
-
-   if (latest_backup_path != NULL)
-   {
-      free(latest_backup_path);
-   }
+   free(latest_backup_path);
 
    return 0;
 
@@ -806,40 +1203,209 @@ error:
       sftp_close(dfile);
    }
 
+   if (attributes != NULL)
+   {
+      sftp_attributes_free(attributes);
+   }
+
    free(s);
    free(d);
+   free(partial);
    free(sha256);
+   free(latest_backup_path);
 
-   if (latest_backup_path != NULL)
+   return 1;
+}
+
+static size_t
+sftp_chunk_size(sftp_session sfs)
+{
+   size_t chunk = SFTP_CHUNK_SIZE;
+
+#ifdef HAVE_SFTP_AIO
+   sftp_limits_t limits = NULL;
+
+   limits = sftp_limits(sfs);
+   if (limits != NULL)
    {
-      free(latest_backup_path);
+      if (limits->max_write_length > 0 && limits->max_write_length < chunk)
+      {
+         chunk = limits->max_write_length;
+      }
+      sftp_limits_free(limits);
+   }
+#else
+   (void)sfs;
+#endif
+
+   return chunk;
+}
+
+static int
+sftp_write_file(sftp_session sfs, sftp_file dfile, FILE* sfile)
+{
+   size_t chunk = 0;
+   size_t read_bytes = 0;
+   char* buffer = NULL;
+   struct sftp_pipeline pipeline;
+
+   memset(&pipeline, 0, sizeof(struct sftp_pipeline));
+
+   chunk = sftp_chunk_size(sfs);
+
+   buffer = (char*)malloc(chunk);
+   if (buffer == NULL)
+   {
+      goto error;
+   }
+
+   while ((read_bytes = fread(buffer, 1, chunk, sfile)) > 0)
+   {
+      if (sftp_pipeline_write(&pipeline, dfile, buffer, read_bytes))
+      {
+         goto error;
+      }
+   }
+
+   if (ferror(sfile))
+   {
+      goto error;
+   }
+
+   if (sftp_pipeline_drain(&pipeline))
+   {
+      goto error;
    }
 
+   free(buffer);
+
+   return 0;
+
+error:
+
+   sftp_pipeline_drain(&pipeline);
+
+   free(buffer);
+
    return 1;
 }
 
+static int
+sftp_pipeline_write(struct sftp_pipeline* pipeline, sftp_file file, void* data, size_t size)
+{
+#ifdef HAVE_SFTP_AIO
+   if (pipeline->in_flight == SFTP_PIPELINE_DEPTH)
+   {
+      if (sftp_aio_wait_write(&pipeline->requests[pipeline->head]) < 0)
+      {
+         pipeline->head = (pipeline->head + 1) % SFTP_PIPELINE_DEPTH;
+         pipeline->in_flight--;
+         return 1;
+      }
+
+      pipeline->head = (pipeline->head + 1) % SFTP_PIPELINE_DEPTH;
+      pipeline->in_flight--;
+   }
+
+   /* The data is copied into the request, so the buffer can be reused */
+   if (sftp_aio_begin_write(file, data, size, &pipeline->requests[(pipeline->head + pipeline->in_flight) % SFTP_PIPELINE_DEPTH]) < 0)
+   {
+      return 1;
+   }
+
+   pipeline->in_flight++;
+
+   return 0;
+#else
+   if (sftp_write(file, data, size) != (ssize_t)size)
+   {
+      return 1;
+   }
+
+   return 0;
+#endif
+}
+
+static int
+sftp_pipeline_drain(struct sftp_pipeline* pipeline)
+{
+   int ret = 0;
+
+#ifdef HAVE_SFTP_AIO
+   while (pipeline->in_flight > 0)
+   {
+      if (sftp_aio_wait_write(&pipeline->requests[pipeline->head]) < 0)
+      {
+         ret = 1;
+      }
+
+      pipeline->head = (pipeline->head + 1) % SFTP_PIPELINE_DEPTH;
+      pipeline->in_flight--;
+   }
+#else
+   (void)pipeline;
+#endif
+
+   pipeline->head = 0;
+
+   return ret;
+}
+
 static int
 sftp_wal_prepare(sftp_file* file, int segsize)
 {
-   char buffer[8192] = {0};
+   size_t chunk = 0;
    size_t written = 0;
+   char* buffer = NULL;
 
    if (file == NULL || *file == NULL)
    {
       return 1;
    }
 
+   chunk = sftp_chunk_size(sftp);
+
+   buffer = (char*)calloc(1, chunk);
+   if (buffer == NULL)
+   {
+      return 1;
+   }
+
    while (written < (size_t)segsize)
    {
-      written += sftp_write(*file, buffer, sizeof(buffer));
+      size_t size = MIN(chunk, (size_t)segsize - written);
+
+      if (sftp_pipeline_write(&wal_pipeline, *file, buffer, size))
+      {
+         goto error;
+      }
+
+      written += size;
+   }
+
+   if (sftp_pipeline_drain(&wal_pipeline))
+   {
+      goto error;
    }
 
    if (sftp_seek(*file, 0) < 0)
    {
-      pgmoneta_log_error("WAL error: %s", ssh_get_error(session));
-      return 1;
+      goto error;
    }
+
+   free(buffer);
+
    return 0;
+
+error:
+
+   pgmoneta_log_error("WAL error: %s", ssh_get_error(session));
+
+   sftp_pipeline_drain(&wal_pipeline);
+
+   free(buffer);
+
+   return 1;
 }
 
 static int
@@ -1030,6 +1596,35 @@ error:
    return 1;
 }
 
+int
+pgmoneta_sftp_wal_write(sftp_file file, void* data, size_t size)
+{
+   size_t chunk = 0;
+   size_t written = 0;
+
+   if (file == NULL)
+   {
+      return 1;
+   }
+
+   chunk = sftp_chunk_size(sftp);
+
+   while (written < size)
+   {
+      size_t length = MIN(chunk, size - written);
+
+      if (sftp_pipeline_write(&wal_pipeline, file, (char*)data + written, length))
+      {
+         pgmoneta_log_error("WAL error: %s", ssh_get_error(session));
+         return 1;
+      }
+
+      written += length;
+   }
+
+   return 0;
+}
+
 int
 pgmoneta_sftp_wal_close(int server, char* filename, bool partial, sftp_file* file)
 {
@@ -1045,6 +1640,11 @@ pgmoneta_sftp_wal_close(int server, char* filename, bool partial, sftp_file* fil
       return 1;
    }
 
+   if (sftp_pipeline_drain(&wal_pipeline))
+   {
+      pgmoneta_log_error("WAL error: %s", ssh_get_error(session));
+   }
+
    if (partial)
    {
       pgmoneta_log_warn("Not renaming %s.partial, this segment is incomplete", filename);
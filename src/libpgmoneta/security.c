@@ -40,6 +40,8 @@
 #include <nmmintrin.h>
 #include <wmmintrin.h>
 #endif
+#include <errno.h>
+#include <fcntl.h>
 #include <stdatomic.h>
 #include <stdbool.h>
 #include <stddef.h>
@@ -76,6 +78,9 @@
 #define NUMBER_OF_SECURITY_MESSAGES    5
 #define SECURITY_BUFFER_SIZE        1024
 
+#define HASH_READ_BUFFER_SIZE   1048576
+#define HASH_READ_ALIGNMENT        4096
+
 static signed char has_security;
 static ssize_t security_lengths[NUMBER_OF_SECURITY_MESSAGES];
 static char security_messages[NUMBER_OF_SECURITY_MESSAGES][SECURITY_BUFFER_SIZE];
@@ -116,6 +121,7 @@ static int  server_signature(char* password, char* salt, int salt_length, int it
 static int  create_ssl_client(SSL_CTX* ctx, char* key, char* cert, char* root, int socket, SSL** ssl);
 
 static int create_hash_file(char* filename, char* algorithm, char** hash);
+static int create_hash_files(char* filename, int n, char** algorithms, struct token_bucket* bucket, char** hashes);
 
 typedef int (*crc_impl_t)(const void*, size_t, uint32_t*);
 static crc_impl_t crc_impl = NULL;
@@ -2767,113 +2773,158 @@ error:
 static int
 create_hash_file(char* filename, char* algorithm, char** hash)
 {
-   EVP_MD_CTX* md_ctx = NULL;
+   return create_hash_files(filename, 1, &algorithm, NULL, hash);
+}
+
+static int
+create_hash_files(char* filename, int n, char** algorithms, struct token_bucket* bucket, char** hashes)
+{
+   EVP_MD_CTX* md_ctx[2] = {NULL, NULL};
    const EVP_MD* md = NULL;
    unsigned char md_value[EVP_MAX_MD_SIZE] = {0};
    unsigned int md_len = 0;
-   FILE* file = NULL;
-   char read_buf[16384] = {0};
-   unsigned long read_bytes = 0;
-   char* hash_buf = NULL;
-   unsigned int hash_len = 0;
+   int fd = -1;
+   void* read_buf = NULL;
+   ssize_t read_bytes = 0;
+   char* hash_buf[2] = {NULL, NULL};
 
-   md = EVP_get_digestbyname(algorithm);
-   if (md == NULL)
+   if (n < 1 || n > 2)
    {
-      pgmoneta_log_error("Invalid message digest: %s", algorithm);
-      goto error;
+      return 1;
    }
 
-   if (strcmp("SHA224", algorithm) == 0)
-   {
-      hash_len = 57;
-   }
-   else if (strcmp("SHA256", algorithm) == 0)
-   {
-      hash_len = 65;
-   }
-   else if (strcmp("SHA384", algorithm) == 0)
-   {
-      hash_len = 97;
-   }
-   else
+   for (int i = 0; i < n; i++)
    {
-      hash_len = 129;
-   }
+      hashes[i] = NULL;
 
-   hash_buf = malloc(hash_len);
-   if (hash_buf == NULL)
-   {
-      goto error;
-   }
+      md = EVP_get_digestbyname(algorithms[i]);
+      if (md == NULL)
+      {
+         pgmoneta_log_error("Invalid message digest: %s", algorithms[i]);
+         goto error;
+      }
 
-   memset(hash_buf, 0, hash_len);
+      hash_buf[i] = calloc(1, EVP_MD_size(md) * 2 + 1);
+      if (hash_buf[i] == NULL)
+      {
+         goto error;
+      }
 
-   md_ctx = EVP_MD_CTX_new();
-   if (md_ctx == NULL)
-   {
-      goto error;
-   }
+      md_ctx[i] = EVP_MD_CTX_new();
+      if (md_ctx[i] == NULL)
+      {
+         goto error;
+      }
 
 #if OPENSSL_VERSION_NUMBER >= 0x30000000L
-   if (!EVP_DigestInit_ex2(md_ctx, md, NULL))
+      if (!EVP_DigestInit_ex2(md_ctx[i], md, NULL))
 #else
-   if (!EVP_DigestInit_ex(md_ctx, md, NULL))
+      if (!EVP_DigestInit_ex(md_ctx[i], md, NULL))
 #endif
+      {
+         pgmoneta_log_error("Message digest initialization failed");
+         goto error;
+      }
+   }
+
+   fd = open(filename, O_RDONLY);
+   if (fd == -1)
    {
-      pgmoneta_log_error("Message digest initialization failed");
       goto error;
    }
 
-   file = fopen(filename, "rb");
-   if (file == NULL)
+#ifdef HAVE_LINUX
+   posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+   if (posix_memalign(&read_buf, HASH_READ_ALIGNMENT, HASH_READ_BUFFER_SIZE))
    {
+      read_buf = NULL;
       goto error;
    }
 
-   memset(read_buf, 0, sizeof(read_buf));
-
-   while ((read_bytes = fread(read_buf, 1, sizeof(read_buf), file)) > 0)
+   /* Every digest is fed from the same read, so the file is only read once */
+   while ((read_bytes = read(fd, read_buf, HASH_READ_BUFFER_SIZE)) != 0)
    {
-      if (!EVP_DigestUpdate(md_ctx, read_buf, read_bytes))
+      if (read_bytes < 0)
       {
-         pgmoneta_log_error("Message digest update failed");
+         if (errno == EINTR)
+         {
+            continue;
+         }
+
+         pgmoneta_log_error("Could not read %s: %s", filename, strerror(errno));
+         errno = 0;
          goto error;
       }
+
+      if (bucket != NULL)
+      {
+         while (1)
+         {
+            if (!pgmoneta_token_bucket_consume(bucket, read_bytes))
+            {
+               break;
+            }
+            else
+            {
+               SLEEP(500000000L)
+            }
+         }
+      }
+
+      for (int i = 0; i < n; i++)
+      {
+         if (!EVP_DigestUpdate(md_ctx[i], read_buf, read_bytes))
+         {
+            pgmoneta_log_error("Message digest update failed");
+            goto error;
+         }
+      }
    }
 
-   if (!EVP_DigestFinal_ex(md_ctx, md_value, &md_len))
+   for (int i = 0; i < n; i++)
    {
-      pgmoneta_log_error("Message digest finalization failed");
-      goto error;
-   }
+      if (!EVP_DigestFinal_ex(md_ctx[i], md_value, &md_len))
+      {
+         pgmoneta_log_error("Message digest finalization failed");
+         goto error;
+      }
 
-   EVP_MD_CTX_free(md_ctx);
+      EVP_MD_CTX_free(md_ctx[i]);
+      md_ctx[i] = NULL;
 
-   for (size_t i = 0; i < md_len; i++)
-   {
-      sprintf(&hash_buf[i * 2], "%02x", md_value[i]);
-   }
+      for (size_t j = 0; j < md_len; j++)
+      {
+         sprintf(&hash_buf[i][j * 2], "%02x", md_value[j]);
+      }
 
-   hash_buf[hash_len - 1] = 0;
-   *hash = hash_buf;
+      hashes[i] = hash_buf[i];
+   }
 
-   fclose(file);
+   free(read_buf);
+   close(fd);
 
    return 0;
 
 error:
 
-   free(hash_buf);
-
-   if (md_ctx != NULL)
+   for (int i = 0; i < n; i++)
    {
-      EVP_MD_CTX_free(md_ctx);
+      free(hash_buf[i]);
+      hashes[i] = NULL;
+
+      if (md_ctx[i] != NULL)
+      {
+         EVP_MD_CTX_free(md_ctx[i]);
+      }
    }
 
-   if (file != NULL)
+   free(read_buf);
+
+   if (fd != -1)
    {
-      fclose(file);
+      close(fd);
    }
 
    return 1;
@@ -2891,6 +2942,60 @@ pgmoneta_create_sha512_file(char* filename, char** sha512)
    return create_hash_file(filename, "SHA512", sha512);
 }
 
+int
+pgmoneta_create_sha512_file_limited(char* filename, struct token_bucket* bucket, char** sha512)
+{
+   char* algorithm = "SHA512";
+
+   return create_hash_files(filename, 1, &algorithm, bucket, sha512);
+}
+
+int
+pgmoneta_create_sha256_sha512_file(char* filename, char** sha256, char** sha512)
+{
+   char* algorithms[2] = {"SHA256", "SHA512"};
+   char* hashes[2] = {NULL, NULL};
+
+   *sha256 = NULL;
+   *sha512 = NULL;
+
+   if (create_hash_files(filename, 2, algorithms, NULL, hashes))
+   {
+      return 1;
+   }
+
+   *sha256 = hashes[0];
+   *sha512 = hashes[1];
+
+   return 0;
+}
+
+int
+pgmoneta_create_checksum_file(char* filename, char* algorithm, char** checksum)
+{
+   *checksum = NULL;
+
+   if (algorithm == NULL)
+   {
+      return 1;
+   }
+
+   if (!strcasecmp(algorithm, "CRC32C"))
+   {
+      return pgmoneta_create_crc32c_file(filename, checksum);
+   }
+
+   if (!strcasecmp(algorithm, "SHA224") || !strcasecmp(algorithm, "SHA256") ||
+       !strcasecmp(algorithm, "SHA384") || !strcasecmp(algorithm, "SHA512"))
+   {
+      return create_hash_file(filename, algorithm, checksum);
+   }
+
+   pgmoneta_log_error("Unsupported checksum algorithm: %s", algorithm);
+
+   return 1;
+}
+
 int
 pgmoneta_generate_string_sha256_hash(char* string, char** sha256)
 {
@@ -3030,6 +3135,7 @@ pgmoneta_crc32c_sse42(const void* buffer, size_t size, uint32_t* crc)
    return 0;
 }
 #endif // __x86_64__
+#endif // HAVE_CRC32_SSE42
 
 static int
 pgmoneta_crc32c_software(const void* buffer, size_t size, uint32_t* crc)
@@ -3111,13 +3217,11 @@ pgmoneta_crc32c_software(const void* buffer, size_t size, uint32_t* crc)
 
    return 0;
 }
-#endif // HAVE_CRC32_SSE42
 
 void
 pgmoneta_crc_init(void)
 {
-#ifdef HAVE_CRC32_SSE42
-#if defined(__x86_64__) || defined(__i386__)
+#if defined(HAVE_CRC32_SSE42) && defined(__x86_64__)
    if (cpu_supports_sse42())
    {
       crc_impl = pgmoneta_crc32c_sse42;
@@ -3126,7 +3230,6 @@ pgmoneta_crc_init(void)
 #endif
 
    crc_impl = pgmoneta_crc32c_software;
-#endif
 }
 
 int
@@ -3153,51 +3256,79 @@ pgmoneta_create_crc32c_buffer(void* buffer, size_t size, uint32_t* crc)
 int
 pgmoneta_create_crc32c_file(char* path, char** crc)
 {
-   FILE* file = NULL;
-   char read_buf[16384];
-   unsigned long read_bytes = 0;
-   char* crc_string;
+   int fd = -1;
+   void* read_buf = NULL;
+   ssize_t read_bytes = 0;
+   char* crc_string = NULL;
    uint32_t crc_buf = 0;
+   unsigned char* bytes = NULL;
 
-   file = fopen(path, "rb");
+   *crc = NULL;
 
-   if (file == NULL)
+   fd = open(path, O_RDONLY);
+   if (fd == -1)
    {
       goto error;
    }
 
-   memset(read_buf, 0, sizeof(read_buf));
+#ifdef HAVE_LINUX
+   posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+   if (posix_memalign(&read_buf, HASH_READ_ALIGNMENT, HASH_READ_BUFFER_SIZE))
+   {
+      read_buf = NULL;
+      goto error;
+   }
+
+   pgmoneta_init_crc32c(&crc_buf);
 
-   while ((read_bytes = fread(read_buf, 1, sizeof(read_buf), file)) > 0)
+   while ((read_bytes = read(fd, read_buf, HASH_READ_BUFFER_SIZE)) != 0)
    {
+      if (read_bytes < 0)
+      {
+         if (errno == EINTR)
+         {
+            continue;
+         }
+
+         pgmoneta_log_error("Could not read %s: %s", path, strerror(errno));
+         errno = 0;
+         goto error;
+      }
+
       pgmoneta_create_crc32c_buffer(read_buf, read_bytes, &crc_buf);
    }
 
-   crc_string = malloc(9);
+   pgmoneta_finalize_crc32c(&crc_buf);
 
+   crc_string = calloc(1, 9);
    if (crc_string == NULL)
    {
       goto error;
    }
 
-   memset(crc_string, 0, 9);
-
-   for (int i = 0; i < 8; i++)
+   /* Same encoding as the backup manifest: the bytes of the CRC in host order */
+   bytes = (unsigned char*)&crc_buf;
+   for (int i = 0; i < 4; i++)
    {
-      sprintf(crc_string, "%08x", crc_buf);
+      sprintf(&crc_string[i * 2], "%02x", bytes[i]);
    }
 
    *crc = crc_string;
 
-   fclose(file);
+   free(read_buf);
+   close(fd);
 
    return 0;
 
 error:
 
-   if (file != NULL)
+   free(read_buf);
+
+   if (fd != -1)
    {
-      fclose(file);
+      close(fd);
    }
 
    return 1;
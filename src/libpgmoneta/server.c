@@ -46,6 +46,30 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 
+/*
+ * The data directory, without the contents that BASE_BACKUP leaves out. In the database
+ * directories that is the temporary relations, and every fork but the init fork of the
+ * unlogged relations, which are the ones with an _init file in the same directory
+ */
+#define DATABASE_DIRECTORY "^(base/[0-9]+|pg_tblspc/[0-9]+/[^/]+/[0-9]+)/"
+#define DATA_FILES_QUERY \
+   "WITH RECURSIVE files(path, size, isdir, modification) AS (" \
+   " SELECT f, s.size, s.isdir, s.modification" \
+   " FROM pg_ls_dir('.', true, false) AS f, LATERAL pg_stat_file(f, true) AS s" \
+   " UNION ALL" \
+   " SELECT d.path || '/' || f, s.size, s.isdir, s.modification" \
+   " FROM files AS d, LATERAL pg_ls_dir(d.path, true, false) AS f, LATERAL pg_stat_file(d.path || '/' || f, true) AS s" \
+   " WHERE d.isdir AND d.path !~ '(^|/)pgsql_tmp'" \
+   " AND d.path NOT IN ('pg_wal', 'pg_dynshmem', 'pg_notify', 'pg_replslot', 'pg_serial', 'pg_snapshots', 'pg_stat_tmp', 'pg_subtrans'))" \
+   " SELECT path, size, isdir, to_char(modification AT TIME ZONE 'UTC', 'YYYY-MM-DD HH24:MI:SS') || ' GMT' FROM files" \
+   " WHERE isdir IS NOT NULL" \
+   " AND path NOT IN ('postmaster.pid', 'postmaster.opts', 'backup_label', 'backup_label.old', 'tablespace_map', 'current_logfiles')" \
+   " AND path !~ '(^|/)(pgsql_tmp[^/]*|pg_internal\\.init)$'" \
+   " AND path !~ '" DATABASE_DIRECTORY "t[0-9]+_[0-9]+(_[a-z]+)?(\\.[0-9]+)?$'" \
+   " AND NOT (path ~ '" DATABASE_DIRECTORY "[0-9]+(_(fsm|vm))?(\\.[0-9]+)?$'" \
+   " AND regexp_replace(path, '(_(fsm|vm))?(\\.[0-9]+)?$', '') || '_init' IN (SELECT path FROM files WHERE path ~ '_init$'))" \
+   " ORDER BY isdir DESC, size DESC;"
+
 static int get_primary(SSL* ssl, int socket, bool* primary);
 static int get_wal_level(SSL* ssl, int socket, bool* replica);
 static int get_wal_size(SSL* ssl, int socket, int* ws);
@@ -56,7 +80,6 @@ static int get_summarize_wal(SSL* ssl, int socket, bool* sw);
 static int has_predefined_role(SSL* ssl, int socket, char* usr, char* role, bool* has_role);
 static int has_superuser_role(SSL* ssl, int socket, char* usr, bool* is_superuser);
 static int has_execute_privilege(SSL* ssl, int socket, char* usr, char* func_name, bool* has_privilege);
-static int transform_hex_bytea_to_binary(char* hex_bytea, uint8_t** out, int* len);
 static int transform_text_to_label_file_contents(char* text, struct label_file_contents* lf);
 static int process_server_parameters(int server, struct deque* server_parameters);
 static int query_execute(SSL* ssl, int socket, char* query, struct query_response** response);
@@ -294,11 +317,8 @@ pgmoneta_server_read_binary_file(int srv, SSL* ssl, char* relative_file_path, in
    char* user = NULL;
    bool has_role = false;
    bool has_privilege = false;
-   char bytea_data_buffer[DEFAULT_BURST];
-   uint8_t* b_out = NULL;
-   int b_len = 0;
-   char query[MISC_LENGTH];
-   struct query_response* response = NULL;
+   void* data = NULL;
+   size_t size = 0;
    struct main_configuration* config;
 
    config = (struct main_configuration*)shmem;
@@ -335,38 +355,16 @@ pgmoneta_server_read_binary_file(int srv, SSL* ssl, char* relative_file_path, in
       goto error;
    }
 
-   memset(query, 0, sizeof(query));
-   snprintf(query, sizeof(query), "SELECT pg_read_binary_file('%s', %d, %d, false);", relative_file_path, offset, length);
-
-   if (query_execute(ssl, socket, query, &response))
-   {
-      goto error;
-   }
-
-   if (response->number_of_columns != 1)
+   if (pgmoneta_receive_file_range(srv, ssl, socket, relative_file_path, (uint64_t)offset, (uint64_t)length, &data, &size))
    {
-      pgmoneta_log_error("Unexpected number of columns in query response");
       goto error;
    }
 
-   memset(bytea_data_buffer, 0, DEFAULT_BURST);
-
-   /* Note: we get data in hex format */
-   snprintf(bytea_data_buffer, DEFAULT_BURST, "%s", response->tuples->data[0]);
-
-   /* Transform it to binary */
-   if (transform_hex_bytea_to_binary(bytea_data_buffer, &b_out, &b_len))
-   {
-      goto error;
-   }
+   *out = (uint8_t*)data;
+   *len = (int)size;
 
-   *out = b_out;
-   *len = b_len;
-   pgmoneta_free_query_response(response);
    return 0;
 error:
-   free(b_out);
-   pgmoneta_free_query_response(response);
    return 1;
 }
 
@@ -583,22 +581,23 @@ pgmoneta_server_start_backup(int srv, SSL* ssl, int socket, char* label, char**
          goto error;
       }
       memset(query, 0, sizeof(query));
-      snprintf(query, sizeof(query), "SELECT * FROM  pg_backup_start('%s', false);", label);
+      snprintf(query, sizeof(query), "SELECT * FROM  pg_backup_start('%s', true);", label);
    }
    else
    {
-      if (has_execute_privilege(ssl, socket, user, "pg_start_backup(text, boolean)", &has_privilege))
+      if (has_execute_privilege(ssl, socket, user, "pg_start_backup(text, boolean, boolean)", &has_privilege))
       {
          goto error;
       }
 
       if (!has_privilege)
       {
-         pgmoneta_log_warn("Connection user: %s does not have EXECUTE privilege on 'pg_start_backup(text, boolean)' function", user);
+         pgmoneta_log_warn("Connection user: %s does not have EXECUTE privilege on 'pg_start_backup(text, boolean, boolean)' function", user);
          goto error;
       }
       memset(query, 0, sizeof(query));
-      snprintf(query, sizeof(query), "SELECT * FROM  pg_start_backup('%s', false);", label);
+      /* Before 15 the backup is exclusive unless asked otherwise */
+      snprintf(query, sizeof(query), "SELECT * FROM  pg_start_backup('%s', true, false);", label);
    }
 
    if (query_execute(ssl, socket, query, &response))
@@ -623,12 +622,13 @@ error:
 }
 
 int
-pgmoneta_server_stop_backup(int srv, SSL* ssl, int socket, char** lsn, struct label_file_contents* lf)
+pgmoneta_server_stop_backup(int srv, SSL* ssl, int socket, char** lsn, char** label_file, struct label_file_contents* lf)
 {
    int version;
    char* user = NULL;
    char* stop_backup_lsn = NULL;
-   struct label_file_contents label_file = {0};
+   char* stop_backup_label_file = NULL;
+   struct label_file_contents label_file_contents = {0};
    bool has_privilege = false;
    char query[MISC_LENGTH];
    struct query_response* response = NULL;
@@ -662,18 +662,18 @@ pgmoneta_server_stop_backup(int srv, SSL* ssl, int socket, char** lsn, struct la
    }
    else
    {
-      if (has_execute_privilege(ssl, socket, user, "pg_stop_backup(boolean)", &has_privilege))
+      if (has_execute_privilege(ssl, socket, user, "pg_stop_backup(boolean, boolean)", &has_privilege))
       {
          goto error;
       }
 
       if (!has_privilege)
       {
-         pgmoneta_log_warn("Connection user: %s does not have EXECUTE privilege on 'pg_stop_backup(boolean)' function", user);
+         pgmoneta_log_warn("Connection user: %s does not have EXECUTE privilege on 'pg_stop_backup(boolean, boolean)' function", user);
          goto error;
       }
       memset(query, 0, sizeof(query));
-      snprintf(query, sizeof(query), "SELECT * FROM  pg_stop_backup(false);");
+      snprintf(query, sizeof(query), "SELECT * FROM  pg_stop_backup(false, false);");
    }
 
    if (query_execute(ssl, socket, query, &response))
@@ -687,13 +687,60 @@ pgmoneta_server_stop_backup(int srv, SSL* ssl, int socket, char** lsn, struct la
    }
 
    stop_backup_lsn = pgmoneta_append(stop_backup_lsn, pgmoneta_query_response_get_data(response, 0));
-   if (transform_text_to_label_file_contents(pgmoneta_query_response_get_data(response, 1), &label_file))
+   if (transform_text_to_label_file_contents(pgmoneta_query_response_get_data(response, 1), &label_file_contents))
    {
       goto error;
    }
 
+   if (label_file != NULL)
+   {
+      stop_backup_label_file = pgmoneta_append(stop_backup_label_file, pgmoneta_query_response_get_data(response, 1));
+      *label_file = stop_backup_label_file;
+   }
+
    *lsn = stop_backup_lsn;
-   *lf = label_file;
+   *lf = label_file_contents;
+
+   pgmoneta_free_query_response(response);
+   return 0;
+error:
+   free(stop_backup_lsn);
+   pgmoneta_free_query_response(response);
+   return 1;
+}
+
+int
+pgmoneta_server_system_identifier(int srv, SSL* ssl, int socket, uint64_t* system_identifier)
+{
+   char* cell_output = NULL;
+   struct query_response* response = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   if (ssl == NULL && socket < 0)
+   {
+      pgmoneta_log_error("Unable to connect to server %s", config->common.servers[srv].name);
+      goto error;
+   }
+
+   if (query_execute(ssl, socket, "SELECT system_identifier FROM pg_control_system();", &response))
+   {
+      goto error;
+   }
+
+   if (response == NULL || response->number_of_columns != 1)
+   {
+      goto error;
+   }
+
+   cell_output = pgmoneta_query_response_get_data(response, 0);
+   if (cell_output == NULL || strcmp(cell_output, "") == 0)
+   {
+      goto error;
+   }
+
+   *system_identifier = strtoull(cell_output, NULL, 10);
 
    pgmoneta_free_query_response(response);
    return 0;
@@ -702,6 +749,49 @@ error:
    return 1;
 }
 
+int
+pgmoneta_server_data_files(int srv, SSL* ssl, int socket, struct query_response** response)
+{
+   char* user = NULL;
+   bool has_privilege = false;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   *response = NULL;
+
+   if (ssl == NULL && socket < 0)
+   {
+      pgmoneta_log_error("Unable to connect to server %s", config->common.servers[srv].name);
+      goto error;
+   }
+
+   user = config->common.servers[srv].username;
+
+   /* Check if the user has EXECUTE privilege on 'pg_ls_dir(text, boolean, boolean)' */
+   if (has_execute_privilege(ssl, socket, user, "pg_ls_dir(text, boolean, boolean)", &has_privilege))
+   {
+      goto error;
+   }
+
+   if (!has_privilege)
+   {
+      pgmoneta_log_warn("Connection user: %s does not have EXECUTE privilege on 'pg_ls_dir(text, boolean, boolean)' function", user);
+      goto error;
+   }
+
+   if (query_execute(ssl, socket, DATA_FILES_QUERY, response))
+   {
+      goto error;
+   }
+
+   return 0;
+error:
+   pgmoneta_free_query_response(*response);
+   *response = NULL;
+   return 1;
+}
+
 static int
 get_wal_size(SSL* ssl, int socket, int* ws)
 {
@@ -1402,71 +1492,6 @@ error:
    return 1;
 }
 
-static int
-transform_hex_bytea_to_binary(char* hex_bytea, uint8_t** out, int* len)
-{
-   size_t hex_len;
-   size_t binary_len = 0;
-   uint8_t* binary_out = NULL;
-   char* hb = NULL;
-   int hi, lo;
-   char hex_chr_str[2] = {0};
-
-   /* check if valid hex bytea string */
-   if (hex_bytea == NULL || strncmp(hex_bytea, "\\x", 2) != 0)
-   {
-      pgmoneta_log_error("invalid hex bytea (missing \\x prefix)");
-      goto error;
-   }
-
-   /* skip '\x' */
-   hb = hex_bytea + 2;
-   hex_len = strlen(hb);
-
-   /* the requested chunk is not present in the file */
-   if (hex_len == 0)
-   {
-      pgmoneta_log_warn("the requested chunk is not present or exceeds the boundary of the file");
-      goto done;
-   }
-
-   if (hex_len % 2 != 0)
-   {
-      pgmoneta_log_error("invalid hex bytea (partial data)");
-      goto error;
-   }
-
-   binary_len = hex_len / 2;
-   binary_out = (uint8_t*)malloc(sizeof(uint8_t) * binary_len);
-   if (binary_out == NULL)
-   {
-      goto error;
-   }
-
-   for (size_t i = 0; i < binary_len; i++)
-   {
-      hex_chr_str[0] = hb[2 * i];
-      sscanf(hex_chr_str, "%x", &hi);
-      hex_chr_str[0] = hb[2 * i + 1];
-      sscanf(hex_chr_str, "%x", &lo);
-      if (hi == -1 || lo == -1)
-      {
-         pgmoneta_log_error("invalid hex character encountered");
-         goto error;
-      }
-      binary_out[i] = (uint8_t)(hi << 4) | (uint8_t)lo;
-   }
-
-done:
-   *out = binary_out;
-   *len = binary_len;
-   return 0;
-error:
-
-   free(binary_out);
-   return 1;
-}
-
 static int
 transform_text_to_label_file_contents(char* text, struct label_file_contents* lf)
 {
@@ -36,6 +36,9 @@
 
 void* shmem = NULL;
 void* prometheus_cache_shmem = NULL;
+void* catalog_shmem = NULL;
+void* jobs_shmem = NULL;
+void* instrument_shmem = NULL;
 
 int
 pgmoneta_create_shared_memory(size_t size, unsigned char hp, void** shmem)
@@ -80,17 +80,10 @@ pgmoneta_status(SSL* ssl, int client_fd, uint8_t compression, uint8_t encryption
       goto error;
    }
 
-   d = NULL;
-   d = pgmoneta_append(d, config->base_dir);
-   d = pgmoneta_append(d, "/");
-
-   used_size = pgmoneta_directory_size(d);
+   used_size = pgmoneta_used_space();
 
    pgmoneta_json_put(response, MANAGEMENT_ARGUMENT_USED_SPACE, (uintptr_t)used_size, ValueUInt64);
 
-   free(d);
-   d = NULL;
-
    free_size = pgmoneta_free_space(config->base_dir);
    total_size = pgmoneta_total_space(config->base_dir);
 
@@ -148,15 +141,10 @@ pgmoneta_status(SSL* ssl, int client_fd, uint8_t compression, uint8_t encryption
       free(d);
       d = NULL;
 
-      d = pgmoneta_get_server(i);
-
-      server_size = pgmoneta_directory_size(d);
+      server_size = pgmoneta_disk_usage(i, DISK_USAGE_SERVER);
 
       pgmoneta_json_put(js, MANAGEMENT_ARGUMENT_SERVER_SIZE, (uintptr_t)server_size, ValueUInt64);
 
-      free(d);
-      d = NULL;
-
       if (strlen(config->common.servers[i].workspace) > 0)
       {
          workspace_size = pgmoneta_directory_size(config->common.servers[i].workspace);
@@ -166,11 +154,7 @@ pgmoneta_status(SSL* ssl, int client_fd, uint8_t compression, uint8_t encryption
          workspace_size = 0;
       }
 
-      hot_standby_size = 0;
-      for (int j = 0; j < config->common.servers[i].number_of_hot_standbys; j++)
-      {
-         hot_standby_size += pgmoneta_directory_size(config->common.servers[i].hot_standby[j]);
-      }
+      hot_standby_size = pgmoneta_disk_usage(i, DISK_USAGE_HOT_STANDBY);
 
       pgmoneta_json_put(js, MANAGEMENT_ARGUMENT_WORKSPACE_FREE_SPACE, (uintptr_t)workspace_size, ValueUInt64);
 
@@ -295,17 +279,10 @@ pgmoneta_status_details(SSL* ssl, int client_fd, uint8_t compression, uint8_t en
       goto error;
    }
 
-   d = NULL;
-   d = pgmoneta_append(d, config->base_dir);
-   d = pgmoneta_append(d, "/");
-
-   used_size = pgmoneta_directory_size(d);
+   used_size = pgmoneta_used_space();
 
    pgmoneta_json_put(response, MANAGEMENT_ARGUMENT_USED_SPACE, (uintptr_t)used_size, ValueUInt64);
 
-   free(d);
-   d = NULL;
-
    free_size = pgmoneta_free_space(config->base_dir);
    total_size = pgmoneta_total_space(config->base_dir);
 
@@ -358,15 +335,10 @@ pgmoneta_status_details(SSL* ssl, int client_fd, uint8_t compression, uint8_t en
       pgmoneta_json_put(js, MANAGEMENT_ARGUMENT_ONLINE, (uintptr_t)config->common.servers[i].online, ValueBool);
       pgmoneta_json_put(js, MANAGEMENT_ARGUMENT_PRIMARY, (uintptr_t)config->common.servers[i].primary, ValueBool);
 
-      d = pgmoneta_get_server(i);
-
-      server_size = pgmoneta_directory_size(d);
+      server_size = pgmoneta_disk_usage(i, DISK_USAGE_SERVER);
 
       pgmoneta_json_put(js, MANAGEMENT_ARGUMENT_SERVER_SIZE, (uintptr_t)server_size, ValueUInt64);
 
-      free(d);
-      d = NULL;
-
       if (strlen(config->common.servers[i].workspace) > 0)
       {
          d = pgmoneta_get_server_workspace(i);
@@ -379,11 +351,7 @@ pgmoneta_status_details(SSL* ssl, int client_fd, uint8_t compression, uint8_t en
          workspace_size = 0;
       }
 
-      hot_standby_size = 0;
-      for (int j = 0; j < config->common.servers[i].number_of_hot_standbys; j++)
-      {
-         hot_standby_size += pgmoneta_directory_size(config->common.servers[i].hot_standby[j]);
-      }
+      hot_standby_size = pgmoneta_disk_usage(i, DISK_USAGE_HOT_STANDBY);
 
       pgmoneta_json_put(js, MANAGEMENT_ARGUMENT_WORKSPACE_FREE_SPACE, (uintptr_t)workspace_size, ValueUInt64);
 
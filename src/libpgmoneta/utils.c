@@ -30,9 +30,12 @@
 #include <pgmoneta.h>
 #include <aes.h>
 #include <compression.h>
+#include <instrument.h>
 #include <logging.h>
 #include <utils.h>
 #include <info.h>
+#include <job.h>
+#include <wal.h>
 
 /* system */
 #include <assert.h>
@@ -88,7 +91,10 @@ static char* get_server_basepath(int server);
 static int get_permissions(char* from, int* permissions);
 
 static void do_copy_file(struct worker_common* wc);
+static void do_extract_wal_file(struct worker_common* wc);
 static void do_delete_file(struct worker_common* wc);
+
+static void disk_usage_adjust(atomic_ullong* counter, int64_t delta);
 bool pgmoneta_is_number(char* str, int base);
 
 int32_t
@@ -1722,6 +1728,214 @@ pgmoneta_directory_size(char* directory)
    return total_size;
 }
 
+unsigned long
+pgmoneta_file_disk_size(char* file)
+{
+   struct stat st;
+   unsigned long l;
+
+   memset(&st, 0, sizeof(struct stat));
+
+   if (file == NULL || stat(file, &st) || st.st_blksize <= 0)
+   {
+      errno = 0;
+      return 0;
+   }
+
+   l = st.st_size / st.st_blksize;
+
+   if (st.st_size % st.st_blksize != 0)
+   {
+      l += 1;
+   }
+
+   return l * st.st_blksize;
+}
+
+void
+pgmoneta_disk_usage_add(int server, int kind, int64_t delta)
+{
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   if (config == NULL || server < 0 || server >= config->common.number_of_servers ||
+       kind < 0 || kind >= NUMBER_OF_DISK_USAGES || delta == 0)
+   {
+      return;
+   }
+
+   disk_usage_adjust(&config->common.servers[server].disk_usage[kind], delta);
+
+   if (kind == DISK_USAGE_BACKUP || kind == DISK_USAGE_WAL)
+   {
+      disk_usage_adjust(&config->common.servers[server].disk_usage[DISK_USAGE_SERVER], delta);
+      disk_usage_adjust(&config->used_space, delta);
+   }
+}
+
+unsigned long
+pgmoneta_disk_usage(int server, int kind)
+{
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   if (config == NULL || server < 0 || server >= config->common.number_of_servers ||
+       kind < 0 || kind >= NUMBER_OF_DISK_USAGES)
+   {
+      return 0;
+   }
+
+   if (!atomic_load(&config->common.servers[server].disk_usage_valid))
+   {
+      pgmoneta_disk_usage_reconcile(server);
+   }
+
+   return (unsigned long)atomic_load(&config->common.servers[server].disk_usage[kind]);
+}
+
+void
+pgmoneta_disk_usage_refresh(int server, int kind)
+{
+   char* d = NULL;
+   unsigned long size = 0;
+   unsigned long long old = 0;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   if (config == NULL || server < 0 || server >= config->common.number_of_servers)
+   {
+      return;
+   }
+
+   switch (kind)
+   {
+      case DISK_USAGE_SERVER:
+         d = pgmoneta_get_server(server);
+         size = pgmoneta_directory_size(d);
+         break;
+      case DISK_USAGE_BACKUP:
+         d = pgmoneta_get_server_backup(server);
+         size = pgmoneta_directory_size(d);
+         free(d);
+
+         /* Deleted backups count until their trash is purged */
+         d = pgmoneta_get_server_trash(server);
+         if (pgmoneta_exists(d))
+         {
+            size += pgmoneta_directory_size(d);
+         }
+         break;
+      case DISK_USAGE_WAL:
+         d = pgmoneta_get_server_wal(server);
+         size = pgmoneta_directory_size(d);
+         break;
+      case DISK_USAGE_WAL_SHIPPING:
+         d = pgmoneta_get_server_wal_shipping(server);
+         if (d != NULL)
+         {
+            size = pgmoneta_directory_size(d);
+         }
+         break;
+      case DISK_USAGE_HOT_STANDBY:
+         for (int j = 0; j < config->common.servers[server].number_of_hot_standbys; j++)
+         {
+            d = pgmoneta_append(d, config->common.servers[server].hot_standby[j]);
+            if (!pgmoneta_ends_with(d, "/"))
+            {
+               d = pgmoneta_append_char(d, '/');
+            }
+            d = pgmoneta_append(d, config->common.servers[server].name);
+
+            if (pgmoneta_exists(d))
+            {
+               size += pgmoneta_directory_size(d);
+            }
+            free(d);
+            d = NULL;
+         }
+         break;
+      default:
+         return;
+   }
+
+   old = atomic_exchange(&config->common.servers[server].disk_usage[kind], size);
+
+   /* Backup and WAL are part of the server directory and of base_dir */
+   if (kind == DISK_USAGE_BACKUP || kind == DISK_USAGE_WAL)
+   {
+      disk_usage_adjust(&config->common.servers[server].disk_usage[DISK_USAGE_SERVER], (int64_t)size - (int64_t)old);
+      disk_usage_adjust(&config->used_space, (int64_t)size - (int64_t)old);
+   }
+
+   free(d);
+}
+
+void
+pgmoneta_disk_usage_reconcile(int server)
+{
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   if (config == NULL || server < 0 || server >= config->common.number_of_servers)
+   {
+      return;
+   }
+
+   /* The server counter goes last, so it overrides the adjustments of the others */
+   for (int i = NUMBER_OF_DISK_USAGES - 1; i >= 0; i--)
+   {
+      pgmoneta_disk_usage_refresh(server, i);
+   }
+
+   atomic_store(&config->common.servers[server].disk_usage_valid, true);
+}
+
+unsigned long
+pgmoneta_used_space(void)
+{
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   if (config == NULL)
+   {
+      return 0;
+   }
+
+   if (!atomic_load(&config->used_space_valid))
+   {
+      pgmoneta_used_space_refresh();
+   }
+
+   return (unsigned long)atomic_load(&config->used_space);
+}
+
+void
+pgmoneta_used_space_refresh(void)
+{
+   char* d = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   if (config == NULL)
+   {
+      return;
+   }
+
+   d = pgmoneta_append(d, config->base_dir);
+   d = pgmoneta_append(d, "/");
+
+   atomic_store(&config->used_space, pgmoneta_directory_size(d));
+   atomic_store(&config->used_space_valid, true);
+
+   free(d);
+}
+
 int
 pgmoneta_get_directories(char* base, int* number_of_directories, char*** dirs)
 {
@@ -2095,6 +2309,27 @@ error:
    return 1;
 }
 
+static void
+do_extract_wal_file(struct worker_common* wc)
+{
+   struct worker_input* wi = (struct worker_input*)wc;
+   char* to = NULL;
+
+   to = pgmoneta_append(to, wi->to);
+
+   if (pgmoneta_copy_and_extract_file(wi->from, &to))
+   {
+      pgmoneta_log_error("Unable to extract WAL file %s to %s", wi->from, wi->to);
+      if (wi->common.workers != NULL)
+      {
+         wi->common.workers->outcome = false;
+      }
+   }
+
+   free(to);
+   free(wi);
+}
+
 static void
 do_delete_file(struct worker_common* wc)
 {
@@ -2343,6 +2578,7 @@ do_copy_file(struct worker_common* wc)
          {
             nread -= nwritten;
             out += nwritten;
+            pgmoneta_job_progress(nwritten, 0);
          }
          else if (errno != EINTR)
          {
@@ -2362,6 +2598,9 @@ do_copy_file(struct worker_common* wc)
          goto error;
       }
       close(fd_from);
+
+      pgmoneta_job_progress(0, 1);
+      pgmoneta_instrument_files(1);
    }
 
 #ifdef DEBUG
@@ -2788,7 +3027,7 @@ error:
 }
 
 int
-pgmoneta_copy_wal_files(char* from, char* to, char* start, struct workers* workers)
+pgmoneta_copy_wal_files(char* from, char* to, char* start, struct wal_range* range, struct workers* workers)
 {
    int number_of_wal_files = 0;
    char** wal_files = NULL;
@@ -2823,42 +3062,58 @@ pgmoneta_copy_wal_files(char* from, char* to, char* start, struct workers* worke
          free(bn);
       }
 
-      if (strcmp(basename, start) >= 0)
+      if (strcmp(basename, start) >= 0 && pgmoneta_wal_range_contains(range, basename))
       {
-         if (pgmoneta_ends_with(basename, ".partial"))
+         ff = pgmoneta_append(ff, from);
+         if (!pgmoneta_ends_with(ff, "/"))
          {
-            ff = pgmoneta_append(ff, from);
-            if (!pgmoneta_ends_with(ff, "/"))
-            {
-               ff = pgmoneta_append(ff, "/");
-            }
-            ff = pgmoneta_append(ff, wal_files[i]);
+            ff = pgmoneta_append(ff, "/");
+         }
+         ff = pgmoneta_append(ff, wal_files[i]);
 
-            tf = pgmoneta_append(tf, to);
-            if (!pgmoneta_ends_with(tf, "/"))
-            {
-               tf = pgmoneta_append(tf, "/");
-            }
+         tf = pgmoneta_append(tf, to);
+         if (!pgmoneta_ends_with(tf, "/"))
+         {
+            tf = pgmoneta_append(tf, "/");
+         }
+
+         if (pgmoneta_ends_with(basename, ".partial"))
+         {
             tf = pgmoneta_append(tf, basename);
+            pgmoneta_copy_file(ff, tf, workers);
          }
-         else
+         else if (pgmoneta_is_encrypted(wal_files[i]) || pgmoneta_is_compressed(wal_files[i]))
          {
-            ff = pgmoneta_append(ff, from);
-            if (!pgmoneta_ends_with(ff, "/"))
+            struct worker_input* wi = NULL;
+
+            // PostgreSQL reads plain segments from pg_wal
+            tf = pgmoneta_append(tf, wal_files[i]);
+            if (pgmoneta_create_worker_input(NULL, ff, tf, 0, workers, &wi))
             {
-               ff = pgmoneta_append(ff, "/");
+               goto error;
             }
-            ff = pgmoneta_append(ff, wal_files[i]);
 
-            tf = pgmoneta_append(tf, to);
-            if (!pgmoneta_ends_with(tf, "/"))
+            if (workers != NULL)
+            {
+               if (workers->outcome)
+               {
+                  pgmoneta_workers_add(workers, do_extract_wal_file, (struct worker_common*)wi);
+               }
+               else
+               {
+                  free(wi);
+               }
+            }
+            else
             {
-               tf = pgmoneta_append(tf, "/");
+               do_extract_wal_file((struct worker_common*)wi);
             }
+         }
+         else
+         {
             tf = pgmoneta_append(tf, wal_files[i]);
+            pgmoneta_copy_file(ff, tf, workers);
          }
-
-         pgmoneta_copy_file(ff, tf, workers);
       }
 
       free(basename);
@@ -2880,6 +3135,10 @@ pgmoneta_copy_wal_files(char* from, char* to, char* start, struct workers* worke
 
 error:
 
+   free(basename);
+   free(ff);
+   free(tf);
+
    for (int i = 0; i < number_of_wal_files; i++)
    {
       free(wal_files[i]);
@@ -3445,6 +3704,17 @@ pgmoneta_get_server_backup(int server)
    return d;
 }
 
+char*
+pgmoneta_get_server_trash(int server)
+{
+   char* d = NULL;
+
+   d = get_server_basepath(server);
+   d = pgmoneta_append(d, "trash/");
+
+   return d;
+}
+
 char*
 pgmoneta_get_server_wal(int server)
 {
@@ -3456,6 +3726,28 @@ pgmoneta_get_server_wal(int server)
    return d;
 }
 
+char*
+pgmoneta_get_server_wal_index(int server)
+{
+   char* d = NULL;
+
+   d = get_server_basepath(server);
+   d = pgmoneta_append(d, "wal_index");
+
+   return d;
+}
+
+char*
+pgmoneta_get_server_wal_prefetch(int server)
+{
+   char* d = NULL;
+
+   d = get_server_basepath(server);
+   d = pgmoneta_append(d, "wal_prefetch/");
+
+   return d;
+}
+
 char*
 pgmoneta_get_server_summary(int server)
 {
@@ -4012,6 +4304,7 @@ pgmoneta_copy_and_extract_file(char* from, char** to)
       free(old_to);
       old_to = new_to;
       new_to = NULL;
+      *to = old_to;
    }
 
    if (pgmoneta_is_compressed(old_to))
@@ -5217,3 +5510,24 @@ pgmoneta_normalize_path(char* directory_path, char* filename, char* default_path
    pgmoneta_log_warn("No path specified for config file %s", filename);
    return 1;
 }
+
+static void
+disk_usage_adjust(atomic_ullong* counter, int64_t delta)
+{
+   unsigned long long current;
+   unsigned long long updated;
+
+   current = atomic_load(counter);
+   do
+   {
+      if (delta < 0 && (unsigned long long)(-delta) > current)
+      {
+         updated = 0;
+      }
+      else
+      {
+         updated = current + delta;
+      }
+   }
+   while (!atomic_compare_exchange_weak(counter, &current, updated));
+}
@@ -28,6 +28,7 @@
 /* pgmoneta */
 #include <art.h>
 #include <json.h>
+#include <memory.h>
 #include <utils.h>
 
 /* System */
@@ -62,13 +63,29 @@ static char* mem_to_string_cb(uintptr_t data, int32_t format, char* tag, int ind
 
 int
 pgmoneta_value_create(enum value_type type, uintptr_t data, struct value** value)
+{
+   return pgmoneta_value_create_with_arena(NULL, type, data, NULL, value);
+}
+
+int
+pgmoneta_value_create_with_config(uintptr_t data, struct value_config* config, struct value** value)
+{
+   return pgmoneta_value_create_with_arena(NULL, ValueRef, data, config, value);
+}
+
+int
+pgmoneta_value_create_with_arena(struct memory_arena* arena, enum value_type type, uintptr_t data, struct value_config* config, struct value** value)
 {
    struct value* val = NULL;
+   if (config != NULL)
+   {
+      type = ValueRef;
+   }
    if (type == ValueNone)
    {
       goto error;
    }
-   val = (struct value*) malloc(sizeof(struct value));
+   val = (struct value*) pgmoneta_memory_arena_alloc(arena, sizeof(struct value));
    if (val == NULL)
    {
       goto error;
@@ -142,15 +159,18 @@ pgmoneta_value_create(enum value_type type, uintptr_t data, struct value** value
    switch (type)
    {
       case ValueString:
-      {
-         val->data = (uintptr_t)pgmoneta_append(NULL, (char*)data);
-         val->destroy_data = free_destroy_cb;
-         break;
-      }
       case ValueBASE64:
       {
-         val->data = (uintptr_t)pgmoneta_append(NULL, (char*)data);
-         val->destroy_data = free_destroy_cb;
+         if (arena != NULL)
+         {
+            val->data = (uintptr_t)pgmoneta_memory_arena_strdup(arena, (char*)data);
+            val->destroy_data = noop_destroy_cb;
+         }
+         else
+         {
+            val->data = (uintptr_t)pgmoneta_append(NULL, (char*)data);
+            val->destroy_data = free_destroy_cb;
+         }
          break;
       }
       case ValueMem:
@@ -174,43 +194,39 @@ pgmoneta_value_create(enum value_type type, uintptr_t data, struct value** value
          val->destroy_data = noop_destroy_cb;
          break;
    }
-   *value = val;
-   return 0;
-
-error:
-   return 1;
-}
-
-int
-pgmoneta_value_create_with_config(uintptr_t data, struct value_config* config, struct value** value)
-{
-   if (pgmoneta_value_create(ValueRef, data, value))
-   {
-      return 1;
-   }
    if (config != NULL)
    {
       if (config->destroy_data != NULL)
       {
-         (*value)->destroy_data = config->destroy_data;
+         val->destroy_data = config->destroy_data;
       }
       if (config->to_string != NULL)
       {
-         (*value)->to_string = config->to_string;
+         val->to_string = config->to_string;
       }
    }
+   *value = val;
    return 0;
+
+error:
+   return 1;
 }
 
 int
 pgmoneta_value_destroy(struct value* value)
+{
+   return pgmoneta_value_destroy_with_arena(NULL, value);
+}
+
+int
+pgmoneta_value_destroy_with_arena(struct memory_arena* arena, struct value* value)
 {
    if (value == NULL)
    {
       return 0;
    }
    value->destroy_data(value->data);
-   free(value);
+   pgmoneta_memory_arena_free(arena, value);
    return 0;
 }
 
@@ -29,20 +29,133 @@
 /* pgmoneta */
 #include "backup.h"
 #include <pgmoneta.h>
+#include <info.h>
 #include <logging.h>
 #include <management.h>
 #include <network.h>
 #include <security.h>
 #include <utils.h>
+#include <verify.h>
+#include <wal.h>
+#include <walfile.h>
+#include <walfile/pg_control.h>
+#include <walfile/rm.h>
+#include <walfile/rmgr.h>
+#include <workers.h>
 #include <workflow.h>
 
 /* system */
 #include <errno.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <sys/stat.h>
 
 #define NAME "verify"
 
+#define VERIFICATION_STATE "verification"
+
+#define WAL_VERIFICATION_DIRECTORY "wal-verification/"
+#define WAL_RECORD_MAX_SIZE        (1020 * 1024 * 1024)
+
+/** @struct verification_input
+ * Defines the input of a verification task
+ */
+struct verification_input
+{
+   struct worker_common common;  /**< The common base */
+   int server;                   /**< The server */
+   char path[MAX_PATH];          /**< The absolute file path */
+   char* hash;                   /**< The expected hash */
+   struct token_bucket* bucket;  /**< The I/O budget, optional */
+   atomic_bool* failed;          /**< Set if the verification failed */
+};
+
+/** @struct wal_segment
+ * Defines a segment of a WAL verification
+ */
+struct wal_segment
+{
+   char name[MISC_LENGTH];   /**< The file name */
+   uint32_t tli;             /**< The timeline of the file name */
+   uint32_t log;             /**< The log identifier of the file name */
+   uint32_t seg;             /**< The segment of the file name */
+   bool partial;             /**< Is the segment partial */
+   bool history_missing;     /**< Is the history of the timeline missing */
+   bool scanned;             /**< Was the segment scanned */
+   bool valid;               /**< Is the segment valid */
+   bool end_of_wal;          /**< Does the WAL end in the segment */
+   uint64_t sysid;           /**< The system identifier */
+   uint32_t seg_size;        /**< The segment size */
+   uint64_t start;           /**< The LSN of the segment */
+   uint64_t bad_lsn;         /**< The first bad LSN */
+   char reason[MISC_LENGTH]; /**< The reason for the first bad LSN */
+   uint64_t records;         /**< The number of records starting in the segment */
+   uint64_t bytes;           /**< The number of bytes scanned */
+   uint64_t first_record;    /**< The LSN of the first record starting in the segment, or 0 */
+   uint64_t first_prev;      /**< The xl_prev of the first record */
+   uint64_t last_record;     /**< The LSN of the last record starting in the segment */
+   uint64_t next_record;     /**< The LSN of the record following the last record */
+};
+
+/** @struct wal_verification_input
+ * Defines the input of a WAL verification task
+ */
+struct wal_verification_input
+{
+   struct worker_common common;      /**< The common base */
+   int server;                       /**< The server */
+   char* directory;                  /**< The WAL directory */
+   char* workspace;                  /**< The directory for extracted segments */
+   struct wal_segment* segments;     /**< The segments */
+   int number_of_segments;           /**< The number of segments */
+   int index;                        /**< The segment to verify */
+   struct timeline_history* history; /**< The history of the timeline */
+};
+
+/** @struct wal_scan
+ * Defines the state of a segment scan
+ */
+struct wal_scan
+{
+   struct wal_verification_input* input; /**< The input */
+   struct wal_segment* segment;          /**< The segment */
+   char* data;                           /**< The segment data */
+   size_t size;                          /**< The number of bytes up to the first unused page */
+   uint16_t magic;                       /**< The page magic */
+   uint32_t blcksz;                      /**< The page size */
+   uint32_t seg_size;                    /**< The segment size */
+   int other;                            /**< The following segment that is loaded, or -1 */
+   char* other_data;                     /**< The data of the following segment */
+   size_t other_size;                    /**< The size of the following segment */
+   char* record;                         /**< The buffer for records spanning pages */
+   size_t record_size;                   /**< The size of the record buffer */
+};
+
+static int verify_backup(int server, struct backup* backup, struct workers* workers, struct token_bucket* bucket);
+static void do_verification(struct worker_common* wc);
+static char* read_verification_state(int server);
+static int write_verification_state(int server, char* label);
+static void do_wal_verification(struct worker_common* wc);
+static int load_segment(struct wal_verification_input* wi, int index, char** data, size_t* size);
+static char* wal_page(struct wal_scan* scan, uint64_t lsn);
+static bool is_zero_page(char* page);
+static bool validate_page(struct wal_scan* scan, char* page, uint64_t pageaddr, uint32_t* tli);
+static int read_record(struct wal_scan* scan, uint64_t lsn, uint32_t length, char** record, uint64_t* end);
+static bool is_end_of_wal(struct wal_scan* scan, uint64_t lsn);
+static bool timeline_allowed(uint32_t tli, struct timeline_history* history, uint32_t page_tli, uint64_t pageaddr);
+static uint64_t segment_lsn(struct wal_segment* segment, uint32_t seg_size);
+static uint64_t next_record_lsn(uint64_t lsn, uint32_t blcksz, uint32_t seg_size);
+static void mark_segment(struct wal_segment* segment, uint64_t lsn, char* fmt, ...);
+static void check_archive(int server, struct wal_segment* segments, int number_of_segments, struct timeline_history** histories,
+                          uint32_t seg_size, struct wal_verification* wv);
+static void check_timeline_switch(int server, struct wal_segment* last, uint64_t last_start, struct wal_segment* first,
+                                  uint64_t first_start, struct timeline_history* history, uint32_t seg_size,
+                                  struct wal_verification* wv);
+static void add_gap(int server, struct wal_verification* wv, uint32_t tli, uint64_t from, uint64_t to, uint32_t seg_size);
+
 void
 pgmoneta_verify(SSL* ssl, int client_fd, int server, uint8_t compression, uint8_t encryption, struct json* payload)
 {
@@ -151,7 +264,7 @@ pgmoneta_verify(SSL* ssl, int client_fd, int server, uint8_t compression, uint8_
    current = workflow;
    while (current != NULL)
    {
-      if (current->execute(current->name(), nodes))
+      if (pgmoneta_workflow_step(current, nodes))
       {
          goto error;
       }
@@ -303,26 +416,19 @@ void
 pgmoneta_sha512_verification(char** argv)
 {
    int server = 0;
+   int start = 0;
+   int count = 0;
+   int number_of_workers = 0;
    struct main_configuration* config;
    char* backup_dir = NULL;
+   char* last = NULL;
    int number_of_backups = 0;
    struct backup** backups = NULL;
-   char* sha512_path = NULL;
-   FILE* sha512_file = NULL;
-   char buffer[4096];
-   char* root = NULL;
-   char* filename = NULL;
-   char* hash = NULL;
-   char* calculated_hash = NULL;
-   char* absolute_file_path = NULL;
+   struct workers* workers = NULL;
+   struct token_bucket* bucket = NULL;
    bool active = false;
    bool locked = false;
-   int line = 0;
    int err = 0;
-   char* elapsed = NULL;
-   struct timespec start_t;
-   struct timespec end_t;
-   double total_seconds;
 
    pgmoneta_start_logging();
 
@@ -330,6 +436,19 @@ pgmoneta_sha512_verification(char** argv)
 
    pgmoneta_set_proc_title(1, argv, "verification", NULL);
 
+   if (config->verification_max_rate > 0)
+   {
+      bucket = (struct token_bucket*)malloc(sizeof(struct token_bucket));
+      if (bucket == NULL || pgmoneta_token_bucket_init(bucket, config->verification_max_rate))
+      {
+         pgmoneta_log_error("Verification: Failed to initialize the token bucket");
+         free(bucket);
+         bucket = NULL;
+         err = 1;
+         goto done;
+      }
+   }
+
    for (server = 0; server < config->common.number_of_servers; server++)
    {
       if (!config->common.servers[server].online)
@@ -358,129 +477,66 @@ pgmoneta_sha512_verification(char** argv)
          goto server_cleanup;
       }
 
-      for (int i = 0; i < number_of_backups; i++)
+      if (number_of_backups == 0)
       {
-#ifdef HAVE_FREEBSD
-         clock_gettime(CLOCK_MONOTONIC_FAST, &start_t);
-#else
-         clock_gettime(CLOCK_MONOTONIC_RAW, &start_t);
-#endif
+         goto server_cleanup;
+      }
+
+      pgmoneta_sort_backups(backups, number_of_backups, false);
 
-         if (!pgmoneta_is_backup_struct_valid(server, backups[i]))
+      /* Continue with the backup following the last one verified, wrapping around */
+      start = 0;
+      last = read_verification_state(server);
+      if (last != NULL)
+      {
+         while (start < number_of_backups && strcmp(backups[start]->label, last) <= 0)
          {
-            err = 1;
-            continue;
+            start++;
+         }
+
+         if (start == number_of_backups)
+         {
+            start = 0;
          }
-         root = pgmoneta_get_server_backup_identifier(server, backups[i]->label);
+      }
+
+      count = number_of_backups;
+      if (config->verification_backups > 0 && config->verification_backups < count)
+      {
+         count = config->verification_backups;
+      }
 
-         sha512_path = pgmoneta_append(sha512_path, root);
-         sha512_path = pgmoneta_append(sha512_path, "/backup.sha512");
+      number_of_workers = pgmoneta_get_number_of_workers(server);
+      if (number_of_workers > 0)
+      {
+         pgmoneta_workers_initialize(number_of_workers, &workers);
+      }
+
+      for (int i = 0; i < count; i++)
+      {
+         struct backup* backup = backups[(start + i) % number_of_backups];
 
-         sha512_file = fopen(sha512_path, "r");
-         if (sha512_file == NULL)
+         if (!pgmoneta_is_backup_struct_valid(server, backup))
          {
-            pgmoneta_log_error("Verification: Server %s / Could not open file %s: %s",
-                               config->common.servers[server].name, sha512_path,
-                               strerror(errno));
             err = 1;
-            goto backup_cleanup;
+            continue;
          }
 
-         line = 0;
-         while (fgets(&buffer[0], sizeof(buffer), sha512_file) != NULL)
+         if (verify_backup(server, backup, workers, bucket))
          {
-            char* entry = NULL;
-
-            line++;
-            entry = strtok(&buffer[0], " ");
-            if (entry == NULL)
-            {
-               pgmoneta_log_error("Verification: Server %s / %s: formatting error at line %d",
-                                  config->common.servers[server].name, sha512_path, sha512_path,
-                                  line);
-               err = 1;
-               goto cleanup;
-            }
-
-            hash = strdup(entry);
-            if (hash == NULL)
-            {
-               pgmoneta_log_error("Verification: Server %s / Memory allocation error for hash",
-                                  config->common.servers[server].name);
-               err = 1;
-               goto cleanup;
-            }
-
-            entry = strtok(NULL, "\n");
-            if (entry == NULL || strlen(entry) < 3)
-            {
-               pgmoneta_log_error("Verification: Server %s / %s: formatting error at line %d",
-                                  config->common.servers[server].name, sha512_path, line);
-               err = 1;
-               goto cleanup;
-            }
-
-            // skip the " *." or " */"
-            filename = entry + 3;
-
-            absolute_file_path = pgmoneta_append(absolute_file_path, root);
-            if (!pgmoneta_ends_with(absolute_file_path, "/"))
-            {
-               absolute_file_path = pgmoneta_append(absolute_file_path, "/");
-            }
-
-            absolute_file_path = pgmoneta_append(absolute_file_path, filename);
-
-            if (pgmoneta_create_sha512_file(absolute_file_path, &calculated_hash))
-            {
-               pgmoneta_log_error("Verification: Server %s / Could not create hash for %s",
-                                  config->common.servers[server].name, absolute_file_path);
-               err = 1;
-               goto cleanup;
-            }
-
-            if (strcmp(hash, calculated_hash) != 0)
-            {
-               pgmoneta_log_error("Verification: Server %s / Hash mismatch for %s | Expected: %s | Got: %s",
-                                  config->common.servers[server].name,
-                                  absolute_file_path, hash, calculated_hash);
-               err = 1;
-            }
-
-cleanup:
-            free(hash);
-            hash = NULL;
-
-            free(absolute_file_path);
-            absolute_file_path = NULL;
-
-            free(calculated_hash);
-            calculated_hash = NULL;
+            err = 1;
          }
 
-#ifdef HAVE_FREEBSD
-         clock_gettime(CLOCK_MONOTONIC_FAST, &end_t);
-#else
-         clock_gettime(CLOCK_MONOTONIC_RAW, &end_t);
-#endif
-
-         elapsed = pgmoneta_get_timestamp_string(start_t, end_t, &total_seconds);
-         pgmoneta_log_info("Verification: %s/%s (Elapsed: %s)", config->common.servers[server].name, backups[i]->label, elapsed);
-         free(elapsed);
-
-backup_cleanup:
-         if (sha512_file != NULL)
+         if (write_verification_state(server, backup->label))
          {
-            fclose(sha512_file);
-            sha512_file = NULL;
+            pgmoneta_log_warn("Verification: Server %s / Could not store the verification state",
+                              config->common.servers[server].name);
          }
-         free(sha512_path);
-         sha512_path = NULL;
-
-         free(root);
-         root = NULL;
       }
 
+      pgmoneta_workers_destroy(workers);
+      workers = NULL;
+
 server_cleanup:
       for (int i = 0; i < number_of_backups; i++)
       {
@@ -491,10 +547,14 @@ server_cleanup:
       }
       free(backups);
       backups = NULL;
+      number_of_backups = 0;
 
       free(backup_dir);
       backup_dir = NULL;
 
+      free(last);
+      last = NULL;
+
       if (locked)
       {
          atomic_store(&config->common.servers[server].repository, false);
@@ -502,6 +562,1540 @@ server_cleanup:
       }
    }
 
+done:
+
+   pgmoneta_token_bucket_destroy(bucket);
+
+   pgmoneta_stop_logging();
+   exit(err);
+}
+
+void
+pgmoneta_verify_wal(SSL* ssl, int client_fd, int server, uint8_t compression, uint8_t encryption, struct json* payload)
+{
+   char* elapsed = NULL;
+   char* lsn = NULL;
+   struct timespec start_t;
+   struct timespec end_t;
+   double total_seconds;
+   struct wal_verification* wv = NULL;
+   struct deque_iterator* giter = NULL;
+   struct json* gaps = NULL;
+   struct json* response = NULL;
+   struct main_configuration* config;
+
+   pgmoneta_start_logging();
+
+   config = (struct main_configuration*)shmem;
+
+#ifdef HAVE_FREEBSD
+   clock_gettime(CLOCK_MONOTONIC_FAST, &start_t);
+#else
+   clock_gettime(CLOCK_MONOTONIC_RAW, &start_t);
+#endif
+
+   if (pgmoneta_verify_wal_archive(server, &wv))
+   {
+      pgmoneta_management_response_error(ssl, client_fd, config->common.servers[server].name, MANAGEMENT_ERROR_VERIFY_WAL_ERROR, NAME, compression, encryption, payload);
+      pgmoneta_log_error("Verify WAL: Error scanning the WAL archive for %s", config->common.servers[server].name);
+
+      goto error;
+   }
+
+   if (pgmoneta_management_create_response(payload, server, &response))
+   {
+      pgmoneta_management_response_error(ssl, client_fd, config->common.servers[server].name, MANAGEMENT_ERROR_ALLOCATION, NAME, compression, encryption, payload);
+
+      goto error;
+   }
+
+   if (pgmoneta_json_create(&gaps))
+   {
+      pgmoneta_management_response_error(ssl, client_fd, config->common.servers[server].name, MANAGEMENT_ERROR_ALLOCATION, NAME, compression, encryption, payload);
+
+      goto error;
+   }
+
+   if (pgmoneta_deque_iterator_create(wv->gaps, &giter))
+   {
+      pgmoneta_management_response_error(ssl, client_fd, config->common.servers[server].name, MANAGEMENT_ERROR_ALLOCATION, NAME, compression, encryption, payload);
+
+      goto error;
+   }
+
+   while (pgmoneta_deque_iterator_next(giter))
+   {
+      pgmoneta_json_append(gaps, (uintptr_t)pgmoneta_value_data(giter->value), ValueString);
+   }
+
+   if (!wv->valid)
+   {
+      lsn = pgmoneta_lsn_to_string(wv->first_bad_lsn);
+   }
+
+   pgmoneta_json_put(response, MANAGEMENT_ARGUMENT_SERVER, (uintptr_t)config->common.servers[server].name, ValueString);
+   pgmoneta_json_put(response, MANAGEMENT_ARGUMENT_VALID, (uintptr_t)wv->valid, ValueBool);
+   pgmoneta_json_put(response, MANAGEMENT_ARGUMENT_SEGMENTS, (uintptr_t)wv->segments, ValueUInt64);
+   pgmoneta_json_put(response, MANAGEMENT_ARGUMENT_RECORDS, (uintptr_t)wv->records, ValueUInt64);
+   pgmoneta_json_put(response, MANAGEMENT_ARGUMENT_FIRST_BAD_LSN, (uintptr_t)(lsn != NULL ? lsn : ""), ValueString);
+   pgmoneta_json_put(response, MANAGEMENT_ARGUMENT_REASON, (uintptr_t)wv->reason, ValueString);
+   pgmoneta_json_put(response, MANAGEMENT_ARGUMENT_GAPS, (uintptr_t)gaps, ValueJSON);
+   gaps = NULL;
+
+#ifdef HAVE_FREEBSD
+   clock_gettime(CLOCK_MONOTONIC_FAST, &end_t);
+#else
+   clock_gettime(CLOCK_MONOTONIC_RAW, &end_t);
+#endif
+
+   if (pgmoneta_management_response_ok(ssl, client_fd, start_t, end_t, compression, encryption, payload))
+   {
+      pgmoneta_management_response_error(ssl, client_fd, config->common.servers[server].name, MANAGEMENT_ERROR_VERIFY_WAL_NETWORK, NAME, compression, encryption, payload);
+      pgmoneta_log_error("Verify WAL: Error sending response for %s", config->common.servers[server].name);
+
+      goto error;
+   }
+
+   elapsed = pgmoneta_get_timestamp_string(start_t, end_t, &total_seconds);
+
+   pgmoneta_log_info("Verify WAL: %s (Elapsed: %s)", config->common.servers[server].name, elapsed);
+
+   pgmoneta_deque_iterator_destroy(giter);
+
+   pgmoneta_destroy_wal_verification(wv);
+
+   pgmoneta_json_destroy(payload);
+
+   pgmoneta_disconnect(client_fd);
+
+   pgmoneta_stop_logging();
+
+   free(lsn);
+   free(elapsed);
+
+   exit(0);
+
+error:
+
+   pgmoneta_deque_iterator_destroy(giter);
+
+   pgmoneta_destroy_wal_verification(wv);
+
+   pgmoneta_json_destroy(gaps);
+   pgmoneta_json_destroy(payload);
+
+   pgmoneta_disconnect(client_fd);
+
+   pgmoneta_stop_logging();
+
+   free(lsn);
+   free(elapsed);
+
+   exit(1);
+}
+
+void
+pgmoneta_wal_verification(char** argv)
+{
+   int err = 0;
+   struct wal_verification* wv = NULL;
+   struct main_configuration* config;
+
+   pgmoneta_start_logging();
+
+   config = (struct main_configuration*)shmem;
+
+   pgmoneta_set_proc_title(1, argv, "wal verification", NULL);
+
+   for (int server = 0; server < config->common.number_of_servers; server++)
+   {
+      if (!config->common.servers[server].online)
+      {
+         pgmoneta_log_debug("WAL verification: Server %s is offline", config->common.servers[server].name);
+         continue;
+      }
+
+      if (pgmoneta_verify_wal_archive(server, &wv))
+      {
+         pgmoneta_log_error("WAL verification: %s: Unable to scan the WAL archive", config->common.servers[server].name);
+         err = 1;
+         continue;
+      }
+
+      if (!wv->valid || !pgmoneta_deque_empty(wv->gaps))
+      {
+         err = 1;
+      }
+
+      pgmoneta_destroy_wal_verification(wv);
+      wv = NULL;
+   }
+
    pgmoneta_stop_logging();
    exit(err);
 }
+
+int
+pgmoneta_verify_wal_archive(int server, struct wal_verification** result)
+{
+   char* directory = NULL;
+   char* workspace = NULL;
+   char* elapsed = NULL;
+   char* lsn = NULL;
+   char** files = NULL;
+   int number_of_files = 0;
+   int number_of_segments = 0;
+   int number_of_workers = 0;
+   int reference = -1;
+   struct wal_segment* segments = NULL;
+   struct wal_segment* bad = NULL;
+   struct timeline_history** histories = NULL;
+   struct wal_verification* wv = NULL;
+   struct wal_verification_input* wi = NULL;
+   struct workers* workers = NULL;
+   struct timespec start_t;
+   struct timespec end_t;
+   double total_seconds;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   *result = NULL;
+
+#ifdef HAVE_FREEBSD
+   clock_gettime(CLOCK_MONOTONIC_FAST, &start_t);
+#else
+   clock_gettime(CLOCK_MONOTONIC_RAW, &start_t);
+#endif
+
+   wv = (struct wal_verification*)malloc(sizeof(struct wal_verification));
+   if (wv == NULL)
+   {
+      goto error;
+   }
+
+   memset(wv, 0, sizeof(struct wal_verification));
+   wv->valid = true;
+
+   if (pgmoneta_deque_create(false, &wv->gaps))
+   {
+      goto error;
+   }
+
+   directory = pgmoneta_get_server_wal(server);
+
+   if (pgmoneta_get_wal_files(directory, &number_of_files, &files))
+   {
+      pgmoneta_log_error("WAL verification: %s: Unable to get the WAL files", config->common.servers[server].name);
+      goto error;
+   }
+
+   if (number_of_files > 0)
+   {
+      segments = (struct wal_segment*)malloc(sizeof(struct wal_segment) * number_of_files);
+      histories = (struct timeline_history**)malloc(sizeof(struct timeline_history*) * number_of_files);
+      if (segments == NULL || histories == NULL)
+      {
+         goto error;
+      }
+
+      memset(segments, 0, sizeof(struct wal_segment) * number_of_files);
+      memset(histories, 0, sizeof(struct timeline_history*) * number_of_files);
+   }
+
+   for (int i = 0; i < number_of_files; i++)
+   {
+      struct wal_segment* segment = &segments[number_of_segments];
+
+      if (strlen(files[i]) < 24 || strlen(files[i]) >= sizeof(segment->name) ||
+          sscanf(files[i], "%08X%08X%08X", &segment->tli, &segment->log, &segment->seg) != 3)
+      {
+         continue;
+      }
+
+      /* The completed segment is preferred over a partial one of the same name */
+      if (number_of_segments > 0 && strstr(files[i], ".partial") != NULL &&
+          !strncmp(segments[number_of_segments - 1].name, files[i], 24))
+      {
+         continue;
+      }
+
+      memcpy(segment->name, files[i], strlen(files[i]));
+      segment->partial = strstr(files[i], ".partial") != NULL;
+      segment->valid = true;
+
+      number_of_segments++;
+   }
+
+   /* The history is shared by all the segments of a timeline */
+   for (int i = 0; i < number_of_segments; i++)
+   {
+      if (i > 0 && segments[i].tli == segments[i - 1].tli)
+      {
+         histories[i] = histories[i - 1];
+         segments[i].history_missing = segments[i - 1].history_missing;
+      }
+      else if (segments[i].tli > 1 && pgmoneta_get_timeline_history(server, segments[i].tli, &histories[i]))
+      {
+         segments[i].history_missing = true;
+      }
+   }
+
+   workspace = pgmoneta_get_server_workspace(server);
+   workspace = pgmoneta_append(workspace, WAL_VERIFICATION_DIRECTORY);
+
+   if (pgmoneta_exists(workspace))
+   {
+      pgmoneta_delete_directory(workspace);
+   }
+
+   if (pgmoneta_mkdir(workspace))
+   {
+      pgmoneta_log_error("WAL verification: %s: Unable to create %s", config->common.servers[server].name, workspace);
+      goto error;
+   }
+
+   /* Initialize the CRC32C implementation before the workers share it */
+   pgmoneta_crc_init();
+
+   number_of_workers = pgmoneta_get_number_of_workers(server);
+   if (number_of_workers > 0)
+   {
+      pgmoneta_workers_initialize(number_of_workers, &workers);
+   }
+
+   for (int i = 0; i < number_of_segments; i++)
+   {
+      wi = (struct wal_verification_input*)malloc(sizeof(struct wal_verification_input));
+      if (wi == NULL)
+      {
+         goto error;
+      }
+
+      memset(wi, 0, sizeof(struct wal_verification_input));
+      wi->server = server;
+      wi->directory = directory;
+      wi->workspace = workspace;
+      wi->segments = segments;
+      wi->number_of_segments = number_of_segments;
+      wi->index = i;
+      wi->history = histories[i];
+      wi->common.workers = workers;
+
+      if (workers != NULL)
+      {
+         pgmoneta_workers_add(workers, do_wal_verification, (struct worker_common*)wi);
+      }
+      else
+      {
+         do_wal_verification((struct worker_common*)wi);
+      }
+   }
+
+   pgmoneta_workers_wait(workers);
+   pgmoneta_workers_destroy(workers);
+   workers = NULL;
+
+   for (int i = 0; i < number_of_segments; i++)
+   {
+      if (segments[i].seg_size == 0)
+      {
+         continue;
+      }
+
+      if (reference == -1)
+      {
+         reference = i;
+      }
+      else if (segments[i].seg_size != segments[reference].seg_size || segments[i].sysid != segments[reference].sysid)
+      {
+         mark_segment(&segments[i], segments[i].start, "Segment size or system identifier differs from %s", segments[reference].name);
+      }
+   }
+
+   if (reference != -1)
+   {
+      check_archive(server, segments, number_of_segments, histories, segments[reference].seg_size, wv);
+   }
+
+   for (int i = 0; i < number_of_segments; i++)
+   {
+      if (segments[i].scanned)
+      {
+         wv->segments++;
+         wv->records += segments[i].records;
+         wv->bytes += segments[i].bytes;
+      }
+
+      if (!segments[i].valid && bad == NULL)
+      {
+         bad = &segments[i];
+      }
+   }
+
+   if (bad != NULL)
+   {
+      wv->valid = false;
+      wv->first_bad_lsn = bad->bad_lsn;
+      snprintf(wv->reason, sizeof(wv->reason), "%s: %s", bad->name, bad->reason);
+
+      lsn = pgmoneta_lsn_to_string(bad->bad_lsn);
+      pgmoneta_log_error("WAL verification: %s: First bad LSN %s (%s)", config->common.servers[server].name, lsn, wv->reason);
+   }
+
+#ifdef HAVE_FREEBSD
+   clock_gettime(CLOCK_MONOTONIC_FAST, &end_t);
+#else
+   clock_gettime(CLOCK_MONOTONIC_RAW, &end_t);
+#endif
+
+   elapsed = pgmoneta_get_timestamp_string(start_t, end_t, &total_seconds);
+
+   pgmoneta_log_info("WAL verification: %s (Segments: %lu, Records: %lu, Gaps: %d, Elapsed: %s, %.1f MB/s)",
+                     config->common.servers[server].name, wv->segments, wv->records,
+                     pgmoneta_deque_size(wv->gaps), elapsed,
+                     total_seconds > 0 ? (wv->bytes / total_seconds) / (1024.0 * 1024.0) : 0.0);
+
+   pgmoneta_delete_directory(workspace);
+
+   for (int i = 0; i < number_of_segments; i++)
+   {
+      if (i == 0 || histories[i] != histories[i - 1])
+      {
+         pgmoneta_free_timeline_history(histories[i]);
+      }
+   }
+
+   for (int i = 0; i < number_of_files; i++)
+   {
+      free(files[i]);
+   }
+   free(files);
+
+   free(histories);
+   free(segments);
+   free(directory);
+   free(workspace);
+   free(elapsed);
+   free(lsn);
+
+   *result = wv;
+
+   return 0;
+
+error:
+
+   pgmoneta_workers_wait(workers);
+   pgmoneta_workers_destroy(workers);
+
+   if (workspace != NULL)
+   {
+      pgmoneta_delete_directory(workspace);
+   }
+
+   for (int i = 0; i < number_of_segments; i++)
+   {
+      if (i == 0 || histories[i] != histories[i - 1])
+      {
+         pgmoneta_free_timeline_history(histories[i]);
+      }
+   }
+
+   for (int i = 0; i < number_of_files; i++)
+   {
+      free(files[i]);
+   }
+   free(files);
+
+   pgmoneta_destroy_wal_verification(wv);
+
+   free(histories);
+   free(segments);
+   free(directory);
+   free(workspace);
+   free(elapsed);
+   free(lsn);
+
+   return 1;
+}
+
+void
+pgmoneta_destroy_wal_verification(struct wal_verification* result)
+{
+   if (result == NULL)
+   {
+      return;
+   }
+
+   pgmoneta_deque_destroy(result->gaps);
+   free(result);
+}
+
+static int
+verify_backup(int server, struct backup* backup, struct workers* workers, struct token_bucket* bucket)
+{
+   char* root = NULL;
+   char* sha512_path = NULL;
+   char* elapsed = NULL;
+   FILE* sha512_file = NULL;
+   char buffer[4096];
+   int line = 0;
+   unsigned long files = 0;
+   unsigned long bytes = 0;
+   atomic_bool failed;
+   struct verification_input* vi = NULL;
+   struct stat st;
+   struct timespec start_t;
+   struct timespec end_t;
+   double total_seconds;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   atomic_init(&failed, false);
+
+#ifdef HAVE_FREEBSD
+   clock_gettime(CLOCK_MONOTONIC_FAST, &start_t);
+#else
+   clock_gettime(CLOCK_MONOTONIC_RAW, &start_t);
+#endif
+
+   root = pgmoneta_get_server_backup_identifier(server, backup->label);
+
+   sha512_path = pgmoneta_append(sha512_path, root);
+   sha512_path = pgmoneta_append(sha512_path, "/backup.sha512");
+
+   sha512_file = fopen(sha512_path, "r");
+   if (sha512_file == NULL)
+   {
+      pgmoneta_log_error("Verification: Server %s / Could not open file %s: %s",
+                         config->common.servers[server].name, sha512_path,
+                         strerror(errno));
+      errno = 0;
+      goto error;
+   }
+
+   if (workers != NULL)
+   {
+      workers->outcome = true;
+   }
+
+   while (fgets(&buffer[0], sizeof(buffer), sha512_file) != NULL)
+   {
+      char* entry = NULL;
+      char* hash = NULL;
+      char* filename = NULL;
+
+      line++;
+      entry = strtok(&buffer[0], " ");
+      if (entry == NULL)
+      {
+         pgmoneta_log_error("Verification: Server %s / %s: formatting error at line %d",
+                            config->common.servers[server].name, sha512_path, line);
+         atomic_store(&failed, true);
+         continue;
+      }
+
+      hash = entry;
+
+      entry = strtok(NULL, "\n");
+      if (entry == NULL || strlen(entry) < 3)
+      {
+         pgmoneta_log_error("Verification: Server %s / %s: formatting error at line %d",
+                            config->common.servers[server].name, sha512_path, line);
+         atomic_store(&failed, true);
+         continue;
+      }
+
+      // skip the " *." or " */"
+      filename = entry + 3;
+
+      vi = (struct verification_input*)malloc(sizeof(struct verification_input));
+      if (vi == NULL)
+      {
+         goto error;
+      }
+
+      memset(vi, 0, sizeof(struct verification_input));
+      snprintf(vi->path, sizeof(vi->path), "%s%s%s", root, pgmoneta_ends_with(root, "/") ? "" : "/", filename);
+      vi->server = server;
+      vi->hash = strdup(hash);
+      vi->bucket = bucket;
+      vi->failed = &failed;
+      vi->common.workers = workers;
+
+      if (vi->hash == NULL)
+      {
+         free(vi);
+         goto error;
+      }
+
+      if (!stat(vi->path, &st))
+      {
+         bytes += st.st_size;
+      }
+      files++;
+
+      if (workers != NULL)
+      {
+         pgmoneta_workers_add(workers, do_verification, (struct worker_common*)vi);
+      }
+      else
+      {
+         do_verification((struct worker_common*)vi);
+      }
+   }
+
+   pgmoneta_workers_wait(workers);
+
+   if (workers != NULL && !workers->outcome)
+   {
+      atomic_store(&failed, true);
+   }
+
+#ifdef HAVE_FREEBSD
+   clock_gettime(CLOCK_MONOTONIC_FAST, &end_t);
+#else
+   clock_gettime(CLOCK_MONOTONIC_RAW, &end_t);
+#endif
+
+   elapsed = pgmoneta_get_timestamp_string(start_t, end_t, &total_seconds);
+
+   atomic_fetch_add(&config->common.servers[server].verification_files, files);
+   atomic_fetch_add(&config->common.servers[server].verification_bytes, bytes);
+   atomic_store(&config->common.servers[server].verification_throughput,
+                total_seconds > 0 ? (unsigned long)(bytes / total_seconds) : bytes);
+   atomic_store(&config->common.servers[server].last_verification_time, (long long)time(NULL));
+
+   pgmoneta_log_info("Verification: %s/%s (Elapsed: %s)", config->common.servers[server].name, backup->label, elapsed);
+
+   fclose(sha512_file);
+
+   free(elapsed);
+   free(sha512_path);
+   free(root);
+
+   return atomic_load(&failed) ? 1 : 0;
+
+error:
+
+   pgmoneta_workers_wait(workers);
+
+   if (sha512_file != NULL)
+   {
+      fclose(sha512_file);
+   }
+
+   free(elapsed);
+   free(sha512_path);
+   free(root);
+
+   return 1;
+}
+
+static void
+do_verification(struct worker_common* wc)
+{
+   char* calculated_hash = NULL;
+   struct verification_input* vi = (struct verification_input*)wc;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   /* The I/O budget is taken per chunk read while hashing */
+   if (pgmoneta_create_sha512_file_limited(vi->path, vi->bucket, &calculated_hash))
+   {
+      pgmoneta_log_error("Verification: Server %s / Could not create hash for %s",
+                         config->common.servers[vi->server].name, vi->path);
+      goto error;
+   }
+
+   if (strcmp(vi->hash, calculated_hash) != 0)
+   {
+      pgmoneta_log_error("Verification: Server %s / Hash mismatch for %s | Expected: %s | Got: %s",
+                         config->common.servers[vi->server].name,
+                         vi->path, vi->hash, calculated_hash);
+      goto error;
+   }
+
+   free(calculated_hash);
+   free(vi->hash);
+   free(vi);
+
+   return;
+
+error:
+
+   atomic_fetch_add(&config->common.servers[vi->server].verification_failed_files, 1);
+   atomic_store(vi->failed, true);
+
+   free(calculated_hash);
+   free(vi->hash);
+   free(vi);
+}
+
+static char*
+read_verification_state(int server)
+{
+   char* path = NULL;
+   char* label = NULL;
+   char buffer[MISC_LENGTH];
+   FILE* file = NULL;
+
+   path = pgmoneta_get_server(server);
+   path = pgmoneta_append(path, VERIFICATION_STATE);
+
+   file = fopen(path, "r");
+   if (file == NULL)
+   {
+      goto done;
+   }
+
+   memset(&buffer[0], 0, sizeof(buffer));
+   if (fgets(&buffer[0], sizeof(buffer), file) != NULL)
+   {
+      buffer[strcspn(&buffer[0], "\n")] = '\0';
+
+      if (strlen(&buffer[0]) > 0)
+      {
+         label = strdup(&buffer[0]);
+      }
+   }
+
+   fclose(file);
+
+done:
+
+   free(path);
+
+   return label;
+}
+
+static int
+write_verification_state(int server, char* label)
+{
+   char* path = NULL;
+   char* tmp_path = NULL;
+   FILE* file = NULL;
+
+   path = pgmoneta_get_server(server);
+   path = pgmoneta_append(path, VERIFICATION_STATE);
+
+   tmp_path = pgmoneta_append(tmp_path, path);
+   tmp_path = pgmoneta_append(tmp_path, ".tmp");
+
+   file = fopen(tmp_path, "w");
+   if (file == NULL)
+   {
+      goto error;
+   }
+
+   fprintf(file, "%s\n", label);
+   fflush(file);
+   fsync(fileno(file));
+   fclose(file);
+
+   if (rename(tmp_path, path))
+   {
+      goto error;
+   }
+
+   free(path);
+   free(tmp_path);
+
+   return 0;
+
+error:
+
+   free(path);
+   free(tmp_path);
+
+   return 1;
+}
+
+static void
+do_wal_verification(struct worker_common* wc)
+{
+   struct wal_verification_input* wi = (struct wal_verification_input*)wc;
+   struct wal_segment* segment = &wi->segments[wi->index];
+   struct xlog_long_page_header_data* long_header = NULL;
+   struct xlog_page_header_data* header = NULL;
+   struct xlog_record* record = NULL;
+   struct wal_scan scan;
+   char* buffer = NULL;
+   char* path = NULL;
+   uint32_t page_tli = 0;
+   uint32_t length = 0;
+   uint32_t crc = 0;
+   uint64_t lsn = 0;
+   uint64_t end = 0;
+   uint64_t prev = 0;
+   size_t limit = 0;
+   bool switched = false;
+   int ret;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   memset(&scan, 0, sizeof(struct wal_scan));
+   scan.input = wi;
+   scan.segment = segment;
+   scan.other = -1;
+
+   if (load_segment(wi, wi->index, &scan.data, &limit))
+   {
+      path = pgmoneta_append(path, wi->directory);
+      path = pgmoneta_append(path, segment->name);
+
+      /* Removed by the retention policy while scanning */
+      if (!pgmoneta_exists(path))
+      {
+         goto done;
+      }
+
+      segment->scanned = true;
+      mark_segment(segment, 0, "Unable to read the segment");
+      goto done;
+   }
+
+   if (limit < SIZE_OF_XLOG_LONG_PHD || is_zero_page(scan.data))
+   {
+      /* The segment being streamed has not received its first page yet */
+      if (segment->partial)
+      {
+         goto done;
+      }
+
+      segment->scanned = true;
+      mark_segment(segment, 0, "Segment has no long page header");
+      goto done;
+   }
+
+   segment->scanned = true;
+   segment->bytes = limit;
+
+   long_header = (struct xlog_long_page_header_data*)scan.data;
+
+   scan.magic = long_header->std.xlp_magic;
+   scan.seg_size = long_header->xlp_seg_size;
+   scan.blcksz = long_header->xlp_xlog_blcksz;
+
+   segment->sysid = long_header->xlp_sysid;
+   segment->seg_size = scan.seg_size;
+
+   if (scan.seg_size < 1024 * 1024 || scan.seg_size > 1024 * 1024 * 1024 || (scan.seg_size & (scan.seg_size - 1)) != 0 ||
+       scan.blcksz < 1024 || scan.blcksz > 65536 || (scan.blcksz & (scan.blcksz - 1)) != 0)
+   {
+      mark_segment(segment, 0, "Invalid segment size %u or page size %u", scan.seg_size, scan.blcksz);
+      goto done;
+   }
+
+   segment->start = segment_lsn(segment, scan.seg_size);
+
+   if (pgmoneta_wal_magic_to_version(scan.magic) == -1)
+   {
+      mark_segment(segment, segment->start, "Unknown page magic %04X", scan.magic);
+      goto done;
+   }
+
+   if (limit < scan.seg_size && !segment->partial)
+   {
+      mark_segment(segment, segment->start + limit, "Segment is truncated at %zu bytes", limit);
+   }
+
+   if (limit > scan.seg_size)
+   {
+      limit = scan.seg_size;
+   }
+   limit -= limit % scan.blcksz;
+
+   /* The page headers, up to the first page that was never written */
+   for (scan.size = 0; scan.size < limit; scan.size += scan.blcksz)
+   {
+      if (scan.size > 0 && is_zero_page(scan.data + scan.size))
+      {
+         break;
+      }
+
+      if (!validate_page(&scan, scan.data + scan.size, segment->start + scan.size, &page_tli))
+      {
+         goto done;
+      }
+   }
+
+   /* Skip the end of a record that started in the previous segment */
+   lsn = segment->start + SIZE_OF_XLOG_LONG_PHD;
+   header = (struct xlog_page_header_data*)scan.data;
+
+   if (header->xlp_info & XLP_FIRST_IS_CONTRECORD)
+   {
+      uint32_t remaining = header->xlp_rem_len;
+
+      while (true)
+      {
+         uint64_t page_end = lsn - (lsn % scan.blcksz) + scan.blcksz;
+
+         if (remaining <= page_end - lsn)
+         {
+            lsn = MAXALIGN(lsn + remaining);
+            break;
+         }
+
+         remaining -= page_end - lsn;
+         lsn = page_end;
+
+         if (lsn >= segment->start + scan.size)
+         {
+            break;
+         }
+
+         header = (struct xlog_page_header_data*)(scan.data + (lsn - segment->start));
+         if (!(header->xlp_info & XLP_FIRST_IS_CONTRECORD) || header->xlp_rem_len != remaining)
+         {
+            mark_segment(segment, lsn, "Invalid continuation record length %u, expected %u", header->xlp_rem_len, remaining);
+            goto done;
+         }
+
+         lsn += SIZE_OF_XLOG_SHORT_PHD;
+      }
+   }
+
+   while (lsn < segment->start + scan.size)
+   {
+      if (lsn % scan.blcksz == 0)
+      {
+         header = (struct xlog_page_header_data*)(scan.data + (lsn - segment->start));
+         if (header->xlp_info & XLP_FIRST_IS_CONTRECORD)
+         {
+            mark_segment(segment, lsn, "Unexpected continuation record");
+            goto done;
+         }
+
+         lsn += SIZE_OF_XLOG_SHORT_PHD;
+      }
+
+      memcpy(&length, scan.data + (lsn - segment->start), sizeof(uint32_t));
+
+      if (length == 0)
+      {
+         break;
+      }
+
+      if (length < SIZE_OF_XLOG_RECORD || length > WAL_RECORD_MAX_SIZE)
+      {
+         mark_segment(segment, lsn, "Invalid record length %u", length);
+         goto done;
+      }
+
+      ret = read_record(&scan, lsn, length, &buffer, &end);
+      if (ret == 1)
+      {
+         goto done;
+      }
+      else if (ret == 2)
+      {
+         if (!is_end_of_wal(&scan, end))
+         {
+            mark_segment(segment, lsn, "Record is incomplete");
+         }
+         else
+         {
+            segment->end_of_wal = true;
+         }
+         goto done;
+      }
+
+      record = (struct xlog_record*)buffer;
+
+      if (prev != 0 && record->xl_prev != prev)
+      {
+         mark_segment(segment, lsn, "Record xl_prev %X/%X, expected %X/%X",
+                      (uint32_t)(record->xl_prev >> 32), (uint32_t)record->xl_prev,
+                      (uint32_t)(prev >> 32), (uint32_t)prev);
+      }
+
+      /* The CRC covers the record data followed by the header up to xl_crc */
+      pgmoneta_init_crc32c(&crc);
+      pgmoneta_create_crc32c_buffer(buffer + SIZE_OF_XLOG_RECORD, length - SIZE_OF_XLOG_RECORD, &crc);
+      pgmoneta_create_crc32c_buffer(buffer, offsetof(struct xlog_record, xl_crc), &crc);
+      pgmoneta_finalize_crc32c(&crc);
+
+      if (!pgmoneta_compare_crc32c(crc, record->xl_crc))
+      {
+         mark_segment(segment, lsn, "Record CRC32C %08X, expected %08X", crc, record->xl_crc);
+      }
+
+      if (segment->first_record == 0)
+      {
+         segment->first_record = lsn;
+         segment->first_prev = record->xl_prev;
+      }
+      segment->last_record = lsn;
+      segment->records++;
+
+      prev = lsn;
+
+      if (record->xl_rmid == RM_XLOG_ID && (record->xl_info & ~XLR_INFO_MASK) == XLOG_SWITCH)
+      {
+         /* The remainder of the segment is unused */
+         lsn = segment->start + scan.seg_size;
+         switched = true;
+         break;
+      }
+
+      lsn = MAXALIGN(end);
+   }
+
+   if (!switched && lsn < segment->start + scan.seg_size)
+   {
+      if (is_end_of_wal(&scan, lsn))
+      {
+         segment->end_of_wal = true;
+      }
+      else
+      {
+         mark_segment(segment, lsn, "Unexpected end of WAL");
+      }
+   }
+
+   segment->next_record = next_record_lsn(lsn, scan.blcksz, scan.seg_size);
+
+done:
+
+   if (!segment->valid)
+   {
+      pgmoneta_log_debug("WAL verification: %s/%s: %s", config->common.servers[wi->server].name,
+                         segment->name, segment->reason);
+   }
+
+   free(scan.data);
+   free(scan.other_data);
+   free(scan.record);
+   free(path);
+   free(wi);
+}
+
+static int
+load_segment(struct wal_verification_input* wi, int index, char** data, size_t* size)
+{
+   char* from = NULL;
+   char* to = NULL;
+   char* d = NULL;
+   char prefix[MISC_LENGTH];
+   FILE* file = NULL;
+   struct stat st;
+
+   *data = NULL;
+   *size = 0;
+
+   from = pgmoneta_append(from, wi->directory);
+   from = pgmoneta_append(from, wi->segments[index].name);
+
+   if (pgmoneta_is_encrypted(from) || pgmoneta_is_compressed(from))
+   {
+      /* A segment can be extracted by two tasks at the same time */
+      snprintf(&prefix[0], sizeof(prefix), "%d-", wi->index);
+
+      to = pgmoneta_append(to, wi->workspace);
+      to = pgmoneta_append(to, &prefix[0]);
+      to = pgmoneta_append(to, wi->segments[index].name);
+
+      if (pgmoneta_copy_and_extract_file(from, &to))
+      {
+         goto error;
+      }
+   }
+
+   file = fopen(to != NULL ? to : from, "rb");
+   if (file == NULL)
+   {
+      goto error;
+   }
+
+   if (fstat(fileno(file), &st) || st.st_size <= 0)
+   {
+      goto error;
+   }
+
+   d = (char*)malloc(st.st_size);
+   if (d == NULL)
+   {
+      goto error;
+   }
+
+   if (fread(d, 1, st.st_size, file) != (size_t)st.st_size)
+   {
+      goto error;
+   }
+
+   fclose(file);
+
+   if (to != NULL)
+   {
+      remove(to);
+   }
+
+   *data = d;
+   *size = (size_t)st.st_size;
+
+   free(from);
+   free(to);
+
+   return 0;
+
+error:
+
+   if (file != NULL)
+   {
+      fclose(file);
+   }
+
+   if (to != NULL)
+   {
+      remove(to);
+   }
+
+   free(d);
+   free(from);
+   free(to);
+
+   return 1;
+}
+
+static char*
+wal_page(struct wal_scan* scan, uint64_t lsn)
+{
+   uint64_t page = lsn - (lsn % scan->blcksz);
+   uint64_t seg_start = page - (page % scan->seg_size);
+   struct wal_segment* segments = scan->input->segments;
+   int index = scan->input->index + 1;
+
+   if (seg_start == scan->segment->start)
+   {
+      return page - seg_start < scan->size ? scan->data + (page - seg_start) : NULL;
+   }
+
+   while (index < scan->input->number_of_segments && segments[index].tli == scan->segment->tli &&
+          segment_lsn(&segments[index], scan->seg_size) < seg_start)
+   {
+      index++;
+   }
+
+   if (index >= scan->input->number_of_segments || segments[index].tli != scan->segment->tli ||
+       segment_lsn(&segments[index], scan->seg_size) != seg_start)
+   {
+      return NULL;
+   }
+
+   if (scan->other != index)
+   {
+      free(scan->other_data);
+      scan->other_data = NULL;
+      scan->other_size = 0;
+      scan->other = -1;
+
+      if (load_segment(scan->input, index, &scan->other_data, &scan->other_size))
+      {
+         return NULL;
+      }
+
+      scan->other = index;
+   }
+
+   if (page - seg_start + scan->blcksz > scan->other_size)
+   {
+      return NULL;
+   }
+
+   return scan->other_data + (page - seg_start);
+}
+
+static bool
+is_zero_page(char* page)
+{
+   struct xlog_page_header_data* header = (struct xlog_page_header_data*)page;
+
+   return header->xlp_magic == 0 && header->xlp_pageaddr == 0;
+}
+
+static bool
+validate_page(struct wal_scan* scan, char* page, uint64_t pageaddr, uint32_t* tli)
+{
+   struct xlog_page_header_data* header = (struct xlog_page_header_data*)page;
+   struct xlog_long_page_header_data* long_header = (struct xlog_long_page_header_data*)page;
+   bool first = (pageaddr % scan->seg_size) == 0;
+
+   if (header->xlp_magic != scan->magic)
+   {
+      mark_segment(scan->segment, pageaddr, "Invalid page magic %04X", header->xlp_magic);
+      return false;
+   }
+
+   if ((header->xlp_info & ~XLP_ALL_FLAGS) != 0)
+   {
+      mark_segment(scan->segment, pageaddr, "Invalid page info bits %04X", header->xlp_info);
+      return false;
+   }
+
+   if (first != ((header->xlp_info & XLP_LONG_HEADER) != 0))
+   {
+      mark_segment(scan->segment, pageaddr, "Invalid page header type");
+      return false;
+   }
+
+   if (first && (long_header->xlp_seg_size != scan->seg_size || long_header->xlp_xlog_blcksz != scan->blcksz ||
+                 long_header->xlp_sysid != scan->segment->sysid))
+   {
+      mark_segment(scan->segment, pageaddr, "Long page header does not match the segment");
+      return false;
+   }
+
+   if (header->xlp_pageaddr != pageaddr)
+   {
+      mark_segment(scan->segment, pageaddr, "Unexpected page address %X/%X",
+                   (uint32_t)(header->xlp_pageaddr >> 32), (uint32_t)header->xlp_pageaddr);
+      return false;
+   }
+
+   if (header->xlp_tli < *tli)
+   {
+      mark_segment(scan->segment, pageaddr, "Timeline %u went back from %u", header->xlp_tli, *tli);
+      return false;
+   }
+
+   if (!scan->segment->history_missing &&
+       !timeline_allowed(scan->segment->tli, scan->input->history, header->xlp_tli, pageaddr))
+   {
+      mark_segment(scan->segment, pageaddr, "Timeline %u is not in the history of timeline %u",
+                   header->xlp_tli, scan->segment->tli);
+      return false;
+   }
+
+   *tli = header->xlp_tli;
+
+   return true;
+}
+
+static int
+read_record(struct wal_scan* scan, uint64_t lsn, uint32_t length, char** record, uint64_t* end)
+{
+   struct xlog_page_header_data* header = NULL;
+   uint32_t offset = lsn % scan->blcksz;
+   uint32_t copied = 0;
+   uint32_t header_size = 0;
+   uint32_t n = 0;
+   uint32_t tli = 0;
+   char* page = scan->data + (lsn - scan->segment->start - offset);
+   char* r = NULL;
+
+   /* Most records are on a single page and are checked in place */
+   if (length <= scan->blcksz - offset)
+   {
+      *record = page + offset;
+      *end = lsn + length;
+      return 0;
+   }
+
+   if (scan->record_size < length)
+   {
+      r = (char*)realloc(scan->record, length);
+      if (r == NULL)
+      {
+         mark_segment(scan->segment, lsn, "Out of memory for a record of %u bytes", length);
+         return 1;
+      }
+
+      scan->record = r;
+      scan->record_size = length;
+   }
+
+   copied = scan->blcksz - offset;
+   memcpy(scan->record, page + offset, copied);
+   lsn += copied;
+
+   while (copied < length)
+   {
+      page = wal_page(scan, lsn);
+      if (page == NULL || is_zero_page(page))
+      {
+         *end = lsn;
+         return 2;
+      }
+
+      if (page < scan->data || page >= scan->data + scan->size)
+      {
+         tli = 0;
+         if (!validate_page(scan, page, lsn, &tli))
+         {
+            return 1;
+         }
+      }
+
+      header = (struct xlog_page_header_data*)page;
+      if (!(header->xlp_info & XLP_FIRST_IS_CONTRECORD) || header->xlp_rem_len != length - copied)
+      {
+         mark_segment(scan->segment, lsn, "Invalid continuation record length %u, expected %u",
+                      header->xlp_rem_len, length - copied);
+         return 1;
+      }
+
+      header_size = (lsn % scan->seg_size == 0) ? SIZE_OF_XLOG_LONG_PHD : SIZE_OF_XLOG_SHORT_PHD;
+      n = MIN(scan->blcksz - header_size, length - copied);
+
+      memcpy(scan->record + copied, page + header_size, n);
+      copied += n;
+
+      *end = lsn + header_size + n;
+      lsn += scan->blcksz;
+   }
+
+   *record = scan->record;
+
+   return 0;
+}
+
+static bool
+is_end_of_wal(struct wal_scan* scan, uint64_t lsn)
+{
+   uint64_t seg_start = lsn - (lsn % scan->seg_size);
+   struct wal_segment* segments = scan->input->segments;
+
+   for (int i = scan->input->index; i < scan->input->number_of_segments && segments[i].tli == scan->segment->tli; i++)
+   {
+      if (segment_lsn(&segments[i], scan->seg_size) == seg_start)
+      {
+         return segments[i].partial || i + 1 >= scan->input->number_of_segments || segments[i + 1].tli != segments[i].tli;
+      }
+      else if (segment_lsn(&segments[i], scan->seg_size) > seg_start)
+      {
+         break;
+      }
+   }
+
+   /* A missing segment is reported as a gap */
+   return true;
+}
+
+static bool
+timeline_allowed(uint32_t tli, struct timeline_history* history, uint32_t page_tli, uint64_t pageaddr)
+{
+   if (page_tli == tli)
+   {
+      return true;
+   }
+
+   /* The first segment of a timeline holds the WAL of its parent up to the switch point */
+   for (struct timeline_history* h = history; h != NULL; h = h->next)
+   {
+      if (h->parent_tli == page_tli && pageaddr <= (((uint64_t)h->switchpos_hi << 32) | h->switchpos_lo))
+      {
+         return true;
+      }
+   }
+
+   return false;
+}
+
+static uint64_t
+segment_lsn(struct wal_segment* segment, uint32_t seg_size)
+{
+   return ((uint64_t)segment->log << 32) + (uint64_t)segment->seg * seg_size;
+}
+
+static uint64_t
+next_record_lsn(uint64_t lsn, uint32_t blcksz, uint32_t seg_size)
+{
+   lsn = MAXALIGN(lsn);
+
+   if (lsn % seg_size == 0)
+   {
+      return lsn + SIZE_OF_XLOG_LONG_PHD;
+   }
+   else if (lsn % blcksz == 0)
+   {
+      return lsn + SIZE_OF_XLOG_SHORT_PHD;
+   }
+
+   return lsn;
+}
+
+static void
+mark_segment(struct wal_segment* segment, uint64_t lsn, char* fmt, ...)
+{
+   va_list args;
+
+   /* Keep the first bad LSN of the segment */
+   if (!segment->valid && segment->bad_lsn <= lsn)
+   {
+      return;
+   }
+
+   segment->valid = false;
+   segment->bad_lsn = lsn;
+
+   va_start(args, fmt);
+   vsnprintf(&segment->reason[0], sizeof(segment->reason), fmt, args);
+   va_end(args);
+}
+
+static void
+check_archive(int server, struct wal_segment* segments, int number_of_segments, struct timeline_history** histories,
+              uint32_t seg_size, struct wal_verification* wv)
+{
+   uint64_t start = 0;
+   uint64_t previous = 0;
+   uint64_t expected_next = 0;
+   uint64_t expected_prev = 0;
+
+   for (int i = 0; i < number_of_segments; i++)
+   {
+      struct wal_segment* segment = &segments[i];
+
+      start = segment_lsn(segment, seg_size);
+
+      if (segment->seg_size == 0)
+      {
+         segment->start = start;
+
+         if (!segment->valid)
+         {
+            segment->bad_lsn = start;
+         }
+      }
+
+      if (i > 0 && segments[i - 1].tli == segment->tli)
+      {
+         if (start != previous + seg_size)
+         {
+            add_gap(server, wv, segment->tli, previous + seg_size, start, seg_size);
+            expected_next = 0;
+            expected_prev = 0;
+         }
+      }
+      else
+      {
+         expected_next = 0;
+         expected_prev = 0;
+
+         if (segment->history_missing)
+         {
+            mark_segment(segment, start, "History of timeline %u is missing", segment->tli);
+         }
+         else if (i > 0)
+         {
+            check_timeline_switch(server, &segments[i - 1], previous, segment, start, histories[i], seg_size, wv);
+         }
+      }
+
+      previous = start;
+
+      if (!segment->scanned)
+      {
+         expected_next = 0;
+         expected_prev = 0;
+         continue;
+      }
+
+      if (segment->first_record != 0)
+      {
+         if (expected_next != 0 && segment->first_record != expected_next)
+         {
+            mark_segment(segment, expected_next, "Record expected at %X/%X, found at %X/%X",
+                         (uint32_t)(expected_next >> 32), (uint32_t)expected_next,
+                         (uint32_t)(segment->first_record >> 32), (uint32_t)segment->first_record);
+         }
+         else if (expected_prev != 0 && segment->first_prev != expected_prev)
+         {
+            mark_segment(segment, segment->first_record, "Record xl_prev %X/%X, expected %X/%X",
+                         (uint32_t)(segment->first_prev >> 32), (uint32_t)segment->first_prev,
+                         (uint32_t)(expected_prev >> 32), (uint32_t)expected_prev);
+         }
+
+         expected_next = segment->next_record;
+         expected_prev = segment->last_record;
+      }
+
+      if (!segment->valid || segment->end_of_wal)
+      {
+         expected_next = 0;
+         expected_prev = 0;
+      }
+   }
+}
+
+static void
+check_timeline_switch(int server, struct wal_segment* last, uint64_t last_start, struct wal_segment* first,
+                      uint64_t first_start, struct timeline_history* history, uint32_t seg_size,
+                      struct wal_verification* wv)
+{
+   uint64_t switchpos = 0;
+   uint64_t switch_start = 0;
+   struct timeline_history* h = history;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   while (h != NULL && h->parent_tli != last->tli)
+   {
+      h = h->next;
+   }
+
+   if (h == NULL)
+   {
+      mark_segment(first, first_start, "Timeline %u does not follow timeline %u", first->tli, last->tli);
+      return;
+   }
+
+   switchpos = ((uint64_t)h->switchpos_hi << 32) | h->switchpos_lo;
+   switch_start = switchpos - (switchpos % seg_size);
+
+   /* The segment holding the switch point is copied to the new timeline */
+   if (last_start + seg_size < switch_start)
+   {
+      add_gap(server, wv, last->tli, last_start + seg_size, switch_start, seg_size);
+   }
+
+   /* Timelines without any segment between the two */
+   for (h = h->next; h != NULL; h = h->next)
+   {
+      char gap[MISC_LENGTH];
+
+      snprintf(&gap[0], sizeof(gap), "Timeline %u", h->parent_tli);
+      pgmoneta_deque_add(wv->gaps, NULL, (uintptr_t)&gap[0], ValueString);
+      pgmoneta_log_warn("WAL verification: %s: Missing timeline %u", config->common.servers[server].name, h->parent_tli);
+   }
+
+   if (first_start > switch_start)
+   {
+      add_gap(server, wv, first->tli, switch_start, first_start, seg_size);
+   }
+}
+
+static void
+add_gap(int server, struct wal_verification* wv, uint32_t tli, uint64_t from, uint64_t to, uint32_t seg_size)
+{
+   char* gap = NULL;
+   char* first = NULL;
+   char* last = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   first = pgmoneta_wal_file_name(tli, from / seg_size, seg_size);
+   last = pgmoneta_wal_file_name(tli, to / seg_size - 1, seg_size);
+
+   gap = pgmoneta_append(gap, first);
+   if (strcmp(first, last))
+   {
+      gap = pgmoneta_append(gap, " - ");
+      gap = pgmoneta_append(gap, last);
+   }
+
+   pgmoneta_deque_add(wv->gaps, NULL, (uintptr_t)gap, ValueString);
+
+   pgmoneta_log_warn("WAL verification: %s: Missing %s", config->common.servers[server].name, gap);
+
+   free(gap);
+   free(first);
+   free(last);
+}
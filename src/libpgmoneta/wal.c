@@ -46,19 +46,24 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 #include <libssh/libssh.h>
 #include <libssh/sftp.h>
 #include <openssl/ssl.h>
 
+/* Seconds between the Unix epoch and the PostgreSQL epoch */
+#define POSTGRES_EPOCH_OFFSET 946684800
+
 int mappings_size = 0;
 oid_mapping* oidMappings = NULL;
 bool enable_translation = false;
 
 static int wal_fetch_history(char* basedir, int timeline, SSL* ssl, int socket);
-static FILE* wal_open(char* root, char* filename, int segsize);
+static FILE* wal_open(int srv, int kind, char* root, char* filename, int segsize);
 static int wal_close(char* root, char* filename, bool partial, FILE* file);
 static int wal_prepare(FILE* file, int segsize);
 static int wal_send_status_report(SSL* ssl, int socket, int64_t received, int64_t flushed, int64_t applied);
@@ -68,6 +73,12 @@ static int wal_find_streaming_start(char* basedir, int segsize, uint32_t* timeli
 static int wal_read_replication_slot(SSL* ssl, int socket, char* slot, char* name, int segsize, uint32_t* high32, uint32_t* low32, uint32_t* timeline);
 static int wal_shipping_setup(int srv, char** wal_shipping);
 static void update_wal_lsn(int srv, size_t xlogptr);
+static int wal_segment_key(char* file, uint32_t* tli, uint64_t* key);
+static int wal_range_add(struct wal_range** range, uint32_t tli, uint64_t from, uint64_t to, uint64_t per);
+static uint32_t wal_latest_timeline(int srv);
+static int wal_parse_time(char* value, time_t* result);
+static uint64_t wal_index_find(int srv, struct wal_range* range, uint64_t start_segno, time_t target, uint64_t per);
+static void wal_index_segment(int srv, char* filename, struct message* msg, size_t xlogptr, size_t segsize);
 
 void
 pgmoneta_wal(int srv, char** argv)
@@ -192,7 +203,7 @@ pgmoneta_wal(int srv, char** argv)
    current = head;
    while (current != NULL)
    {
-      if (current->execute(current->name(), nodes))
+      if (pgmoneta_workflow_step(current, nodes))
       {
          goto error;
       }
@@ -388,14 +399,15 @@ pgmoneta_wal(int srv, char** argv)
                      segno = xlogptr / segsize;
                      curr_xlogoff = 0;
                      filename = pgmoneta_wal_file_name(timeline, segno, segsize);
-                     if ((wal_file = wal_open(d, filename, segsize)) == NULL)
+                     if ((wal_file = wal_open(srv, DISK_USAGE_WAL, d, filename, segsize)) == NULL)
                      {
                         pgmoneta_log_error("Could not create or open WAL segment file at %s", d);
                         goto error;
                      }
                      memset(config->common.servers[srv].current_wal_filename, 0, MISC_LENGTH);
                      snprintf(config->common.servers[srv].current_wal_filename, MISC_LENGTH, "%s.partial", filename);
-                     if ((wal_shipping_file = wal_open(wal_shipping, filename, segsize)) == NULL)
+                     wal_index_segment(srv, filename, msg, xlogptr, segsize);
+                     if ((wal_shipping_file = wal_open(srv, DISK_USAGE_WAL_SHIPPING, wal_shipping, filename, segsize)) == NULL)
                      {
                         if (wal_shipping != NULL)
                         {
@@ -440,7 +452,7 @@ pgmoneta_wal(int srv, char** argv)
 
                      if (sftp_wal_file != NULL)
                      {
-                        sftp_write(sftp_wal_file, msg->data + hdrlen + bytes_written, bytes_to_write);
+                        pgmoneta_sftp_wal_write(sftp_wal_file, msg->data + hdrlen + bytes_written, bytes_to_write);
                      }
 
                      if (wal_shipping_file != NULL)
@@ -484,14 +496,15 @@ pgmoneta_wal(int srv, char** argv)
                            segno = xlogptr / segsize;
                            curr_xlogoff = 0;
                            filename = pgmoneta_wal_file_name(timeline, segno, segsize);
-                           if ((wal_file = wal_open(d, filename, segsize)) == NULL)
+                           if ((wal_file = wal_open(srv, DISK_USAGE_WAL, d, filename, segsize)) == NULL)
                            {
                               pgmoneta_log_error("Could not create or open WAL segment file at %s", d);
                               goto error;
                            }
                            memset(config->common.servers[srv].current_wal_filename, 0, MISC_LENGTH);
                            snprintf(config->common.servers[srv].current_wal_filename, MISC_LENGTH, "%s.partial", filename);
-                           if ((wal_shipping_file = wal_open(wal_shipping, filename, segsize)) == NULL)
+                           wal_index_segment(srv, filename, msg, xlogptr, segsize);
+                           if ((wal_shipping_file = wal_open(srv, DISK_USAGE_WAL_SHIPPING, wal_shipping, filename, segsize)) == NULL)
                            {
                               if (wal_shipping != NULL)
                               {
@@ -511,7 +524,7 @@ pgmoneta_wal(int srv, char** argv)
                            fflush(wal_file);
                            if (sftp_wal_file != NULL)
                            {
-                              sftp_write(sftp_wal_file, msg->data + hdrlen + bytes_written, bytes_left);
+                              pgmoneta_sftp_wal_write(sftp_wal_file, msg->data + hdrlen + bytes_written, bytes_left);
                            }
                            if (wal_shipping_file != NULL)
                            {
@@ -866,6 +879,567 @@ pgmoneta_free_timeline_history(struct timeline_history* history)
    }
 }
 
+int
+pgmoneta_wal_recovery_range(int srv, struct backup* backup, char* position, struct wal_range** range)
+{
+   char tokens[512];
+   char* ptr = NULL;
+   char* saveptr = NULL;
+   char* target = NULL;
+   char* value = NULL;
+   char* tli_value = NULL;
+   uint32_t target_tli = 0;
+   uint32_t hi = 0;
+   uint32_t lo = 0;
+   uint64_t per;
+   uint64_t start_segno;
+   uint64_t end_segno = UINT64_MAX;
+   uint64_t prev_segno = 0;
+   uint64_t from;
+   uint64_t to;
+   time_t target_time = 0;
+   bool has_time = false;
+   bool found = false;
+   struct timeline_history* history = NULL;
+   struct wal_range* r = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   *range = NULL;
+
+   if (position == NULL || strlen(position) == 0 || strlen(position) >= sizeof(tokens))
+   {
+      return 0;
+   }
+
+   per = 0x100000000ULL / (uint64_t)config->common.servers[srv].wal_size;
+   start_segno = (((uint64_t)backup->start_lsn_hi32 << 32) | backup->start_lsn_lo32) / config->common.servers[srv].wal_size;
+
+   memset(&tokens[0], 0, sizeof(tokens));
+   memcpy(&tokens[0], position, strlen(position));
+
+   ptr = strtok_r(&tokens[0], ",", &saveptr);
+   while (ptr != NULL)
+   {
+      char* equal = strchr(ptr, '=');
+
+      if (equal != NULL)
+      {
+         *equal = '\0';
+      }
+
+      if (!strcmp(ptr, "current") || !strcmp(ptr, "immediate") || !strcmp(ptr, "name") ||
+          !strcmp(ptr, "xid") || !strcmp(ptr, "lsn") || !strcmp(ptr, "time"))
+      {
+         /* The first target wins, like in the recovery configuration */
+         if (target == NULL)
+         {
+            target = ptr;
+            value = equal != NULL ? equal + 1 : "";
+         }
+      }
+      else if (!strcmp(ptr, "timeline"))
+      {
+         tli_value = equal != NULL ? equal + 1 : "";
+      }
+
+      ptr = strtok_r(NULL, ",", &saveptr);
+   }
+
+   if (target == NULL || !strcmp(target, "name") || !strcmp(target, "xid"))
+   {
+      /* The end of the recovery is only known by replaying the WAL */
+   }
+   else if (!strcmp(target, "current") || !strcmp(target, "immediate"))
+   {
+      end_segno = (((uint64_t)backup->end_lsn_hi32 << 32) | backup->end_lsn_lo32) / config->common.servers[srv].wal_size;
+   }
+   else if (!strcmp(target, "lsn"))
+   {
+      if (sscanf(value, "%X/%X", &hi, &lo) == 2)
+      {
+         end_segno = (((uint64_t)hi << 32) | lo) / config->common.servers[srv].wal_size + 1;
+      }
+   }
+   else if (!strcmp(target, "time"))
+   {
+      has_time = !wal_parse_time(value, &target_time);
+   }
+
+   if (tli_value == NULL || strlen(tli_value) == 0 || !strcmp(tli_value, "latest"))
+   {
+      target_tli = wal_latest_timeline(srv);
+   }
+   else if (!strcmp(tli_value, "current"))
+   {
+      target_tli = backup->start_timeline;
+   }
+   else
+   {
+      target_tli = (uint32_t)strtoul(tli_value, NULL, 0);
+   }
+
+   if (target_tli < backup->start_timeline)
+   {
+      target_tli = backup->start_timeline;
+   }
+
+   if (pgmoneta_get_timeline_history(srv, target_tli, &history))
+   {
+      pgmoneta_log_warn("Restore: No history for timeline %u, using all timelines", target_tli);
+
+      if (end_segno == UINT64_MAX && !has_time)
+      {
+         return 0;
+      }
+
+      if (wal_range_add(range, 0, start_segno, end_segno, per))
+      {
+         goto error;
+      }
+   }
+   else
+   {
+      for (struct timeline_history* h = history; h != NULL; h = h->next)
+      {
+         uint64_t switch_segno = (((uint64_t)h->switchpos_hi << 32) | h->switchpos_lo) / config->common.servers[srv].wal_size;
+
+         if (h->parent_tli == backup->start_timeline)
+         {
+            found = true;
+         }
+
+         if (found)
+         {
+            from = MAX(prev_segno, start_segno);
+            to = MIN(switch_segno, end_segno);
+
+            if (from <= to && wal_range_add(range, h->parent_tli, from, to, per))
+            {
+               goto error;
+            }
+         }
+
+         prev_segno = switch_segno;
+      }
+
+      if (target_tli == backup->start_timeline)
+      {
+         found = true;
+      }
+
+      if (!found)
+      {
+         /* The backup is not on the path to the target timeline, leave it to the recovery */
+         pgmoneta_log_warn("Restore: Timeline %u is not an ancestor of timeline %u", backup->start_timeline, target_tli);
+         pgmoneta_free_wal_range(*range);
+         *range = NULL;
+         pgmoneta_free_timeline_history(history);
+         return 0;
+      }
+
+      from = MAX(prev_segno, start_segno);
+      if (from <= end_segno && wal_range_add(range, target_tli, from, end_segno, per))
+      {
+         goto error;
+      }
+   }
+
+   if (has_time)
+   {
+      end_segno = wal_index_find(srv, *range, start_segno, target_time, per);
+
+      if (end_segno != UINT64_MAX)
+      {
+         /* One segment after the first one that started past the target */
+         end_segno++;
+
+         for (r = *range; r != NULL; r = r->next)
+         {
+            uint64_t key = ((end_segno / per) << 32) | (end_segno % per);
+
+            if (r->to > key)
+            {
+               r->to = key;
+            }
+         }
+      }
+   }
+
+   pgmoneta_free_timeline_history(history);
+
+   return 0;
+
+error:
+
+   pgmoneta_free_timeline_history(history);
+   pgmoneta_free_wal_range(*range);
+   *range = NULL;
+
+   return 1;
+}
+
+bool
+pgmoneta_wal_range_contains(struct wal_range* range, char* file)
+{
+   uint32_t tli = 0;
+   uint64_t key = 0;
+
+   if (range == NULL)
+   {
+      return true;
+   }
+
+   if (wal_segment_key(file, &tli, &key))
+   {
+      return true;
+   }
+
+   for (struct wal_range* r = range; r != NULL; r = r->next)
+   {
+      if ((r->tli == 0 || r->tli == tli) && key >= r->from && key <= r->to)
+      {
+         return true;
+      }
+   }
+
+   return false;
+}
+
+void
+pgmoneta_free_wal_range(struct wal_range* range)
+{
+   struct wal_range* r = range;
+   while (r != NULL)
+   {
+      struct wal_range* next = r->next;
+      free(r);
+      r = next;
+   }
+}
+
+int
+pgmoneta_wal_index_prune(int srv)
+{
+   char* wal_dir = NULL;
+   char* path = NULL;
+   char* tmp = NULL;
+   char line[MISC_LENGTH];
+   char segment[MISC_LENGTH];
+   int number_of_files = 0;
+   char** files = NULL;
+   uint32_t tli = 0;
+   uint64_t key = 0;
+   uint64_t oldest = UINT64_MAX;
+   long long t = 0;
+   FILE* in = NULL;
+   FILE* out = NULL;
+
+   path = pgmoneta_get_server_wal_index(srv);
+
+   if (!pgmoneta_exists(path))
+   {
+      free(path);
+      return 0;
+   }
+
+   wal_dir = pgmoneta_get_server_wal(srv);
+   pgmoneta_get_files(wal_dir, &number_of_files, &files);
+
+   for (int i = 0; i < number_of_files; i++)
+   {
+      if (!wal_segment_key(files[i], &tli, &key) && key < oldest)
+      {
+         oldest = key;
+      }
+   }
+
+   tmp = pgmoneta_append(tmp, path);
+   tmp = pgmoneta_append(tmp, ".tmp");
+
+   in = fopen(path, "r");
+   out = fopen(tmp, "w");
+
+   if (in == NULL || out == NULL)
+   {
+      pgmoneta_log_error("Unable to prune WAL index %s", path);
+      goto error;
+   }
+
+   memset(&line[0], 0, sizeof(line));
+   while (fgets(&line[0], sizeof(line), in) != NULL)
+   {
+      memset(&segment[0], 0, sizeof(segment));
+      if (sscanf(&line[0], "%127s %lld", &segment[0], &t) == 2 &&
+          !wal_segment_key(&segment[0], &tli, &key) && oldest != UINT64_MAX && key >= oldest)
+      {
+         fputs(&line[0], out);
+      }
+      memset(&line[0], 0, sizeof(line));
+   }
+
+   fclose(in);
+   in = NULL;
+   fclose(out);
+   out = NULL;
+
+   if (rename(tmp, path))
+   {
+      pgmoneta_log_error("Unable to replace WAL index %s: %s", path, strerror(errno));
+      goto error;
+   }
+
+   for (int i = 0; i < number_of_files; i++)
+   {
+      free(files[i]);
+   }
+   free(files);
+   free(wal_dir);
+   free(path);
+   free(tmp);
+
+   return 0;
+
+error:
+
+   if (in != NULL)
+   {
+      fclose(in);
+   }
+   if (out != NULL)
+   {
+      fclose(out);
+   }
+   if (tmp != NULL)
+   {
+      remove(tmp);
+   }
+   for (int i = 0; i < number_of_files; i++)
+   {
+      free(files[i]);
+   }
+   free(files);
+   free(wal_dir);
+   free(path);
+   free(tmp);
+
+   return 1;
+}
+
+static int
+wal_segment_key(char* file, uint32_t* tli, uint64_t* key)
+{
+   uint32_t log = 0;
+   uint32_t seg = 0;
+
+   if (file == NULL || strlen(file) < 24)
+   {
+      return 1;
+   }
+
+   for (int i = 0; i < 24; i++)
+   {
+      if (!isxdigit((unsigned char)file[i]))
+      {
+         return 1;
+      }
+   }
+
+   if (sscanf(file, "%08X%08X%08X", tli, &log, &seg) != 3)
+   {
+      return 1;
+   }
+
+   *key = ((uint64_t)log << 32) | seg;
+
+   return 0;
+}
+
+static int
+wal_range_add(struct wal_range** range, uint32_t tli, uint64_t from, uint64_t to, uint64_t per)
+{
+   struct wal_range* r = NULL;
+
+   r = (struct wal_range*)malloc(sizeof(struct wal_range));
+   if (r == NULL)
+   {
+      return 1;
+   }
+
+   memset(r, 0, sizeof(struct wal_range));
+   r->tli = tli;
+   r->from = ((from / per) << 32) | (from % per);
+   r->to = to == UINT64_MAX ? UINT64_MAX : ((to / per) << 32) | (to % per);
+   r->next = *range;
+
+   *range = r;
+
+   return 0;
+}
+
+static uint32_t
+wal_latest_timeline(int srv)
+{
+   char* wal_dir = NULL;
+   int number_of_files = 0;
+   char** files = NULL;
+   uint32_t tli = 0;
+   uint32_t latest = 1;
+
+   wal_dir = pgmoneta_get_server_wal(srv);
+   pgmoneta_get_files(wal_dir, &number_of_files, &files);
+
+   for (int i = 0; i < number_of_files; i++)
+   {
+      if (strlen(files[i]) >= 8 && sscanf(files[i], "%08X", &tli) == 1 && tli > latest)
+      {
+         latest = tli;
+      }
+      free(files[i]);
+   }
+
+   free(files);
+   free(wal_dir);
+
+   return latest;
+}
+
+static int
+wal_parse_time(char* value, time_t* result)
+{
+   struct tm tm;
+   char* rest = NULL;
+   int sign = 1;
+   int hours = 0;
+   int minutes = 0;
+   time_t t;
+
+   memset(&tm, 0, sizeof(struct tm));
+
+   rest = strptime(value, "%Y-%m-%d %H:%M:%S", &tm);
+   if (rest == NULL)
+   {
+      return 1;
+   }
+
+   t = timegm(&tm);
+
+   /* Fractional seconds */
+   if (*rest == '.')
+   {
+      rest++;
+      while (isdigit((unsigned char)*rest))
+      {
+         rest++;
+      }
+   }
+
+   while (isspace((unsigned char)*rest))
+   {
+      rest++;
+   }
+
+   if (*rest == '+' || *rest == '-')
+   {
+      sign = *rest == '-' ? -1 : 1;
+      rest++;
+      if (sscanf(rest, "%2d:%2d", &hours, &minutes) < 1 && sscanf(rest, "%2d%2d", &hours, &minutes) < 1)
+      {
+         return 1;
+      }
+      t -= sign * (hours * 3600 + minutes * 60);
+   }
+   else if (*rest == 'Z' || !strncasecmp(rest, "UTC", 3) || !strncasecmp(rest, "GMT", 3))
+   {
+      /* Ok */
+   }
+   else
+   {
+      /* The server time zone is not known, so use the latest time it could be */
+      t += 14 * 3600;
+   }
+
+   *result = t;
+
+   return 0;
+}
+
+static uint64_t
+wal_index_find(int srv, struct wal_range* range, uint64_t start_segno, time_t target, uint64_t per)
+{
+   char* path = NULL;
+   char line[MISC_LENGTH];
+   char segment[MISC_LENGTH];
+   uint32_t tli = 0;
+   uint64_t key = 0;
+   uint64_t segno = 0;
+   uint64_t result = UINT64_MAX;
+   long long t = 0;
+   FILE* file = NULL;
+
+   path = pgmoneta_get_server_wal_index(srv);
+   file = fopen(path, "r");
+
+   if (file == NULL)
+   {
+      free(path);
+      return UINT64_MAX;
+   }
+
+   memset(&line[0], 0, sizeof(line));
+   while (fgets(&line[0], sizeof(line), file) != NULL)
+   {
+      memset(&segment[0], 0, sizeof(segment));
+      if (sscanf(&line[0], "%127s %lld", &segment[0], &t) == 2 &&
+          !wal_segment_key(&segment[0], &tli, &key) &&
+          pgmoneta_wal_range_contains(range, &segment[0]))
+      {
+         segno = (key >> 32) * per + (key & 0xFFFFFFFF);
+
+         if (segno >= start_segno && (time_t)t > target && segno < result)
+         {
+            result = segno;
+         }
+      }
+      memset(&line[0], 0, sizeof(line));
+   }
+
+   fclose(file);
+   free(path);
+
+   return result;
+}
+
+static void
+wal_index_segment(int srv, char* filename, struct message* msg, size_t xlogptr, size_t segsize)
+{
+   int64_t wal_end;
+   int64_t send_time;
+   char* path = NULL;
+   FILE* file = NULL;
+
+   wal_end = pgmoneta_read_int64(msg->data + 9);
+   send_time = pgmoneta_read_int64(msg->data + 17);
+
+   /* Only a receiver that keeps up knows when the segment was started */
+   if (wal_end < (int64_t)xlogptr || (size_t)(wal_end - xlogptr) > segsize)
+   {
+      return;
+   }
+
+   path = pgmoneta_get_server_wal_index(srv);
+   file = fopen(path, "a");
+
+   if (file != NULL)
+   {
+      fprintf(file, "%s %lld\n", filename, (long long)(send_time / 1000000 + POSTGRES_EPOCH_OFFSET));
+      fclose(file);
+   }
+
+   free(path);
+}
+
 static int
 wal_fetch_history(char* basedir, int timeline, SSL* ssl, int socket)
 {
@@ -929,7 +1503,7 @@ error:
 }
 
 static FILE*
-wal_open(char* root, char* filename, int segsize)
+wal_open(int srv, int kind, char* root, char* filename, int segsize)
 {
    if (root == NULL || strlen(root) == 0 || !pgmoneta_exists(root))
    {
@@ -986,6 +1560,8 @@ wal_open(char* root, char* filename, int segsize)
       goto error;
    }
 
+   pgmoneta_disk_usage_add(srv, kind, segsize);
+
    pgmoneta_permission(path, 6, 0, 0);
 
    free(path);
@@ -0,0 +1,529 @@
+/*
+ * Copyright (C) 2025 The pgmoneta community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* pgmoneta */
+#include <pgmoneta.h>
+#include <art.h>
+#include <logging.h>
+#include <storage.h>
+#include <utils.h>
+#include <walarchive.h>
+#include <workers.h>
+
+/* system */
+#include <ctype.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/** @struct wal_archive_input
+ * Defines the input for the upload of a WAL file
+ */
+struct wal_archive_input
+{
+   struct worker_common common;   /**< The worker common */
+   int server;                    /**< The server */
+   char filename[MISC_LENGTH];    /**< The file name */
+   bool archived;                 /**< Was the file archived */
+};
+
+static void do_wal_archive(struct worker_common* wc);
+static bool is_segment(char* filename);
+static bool is_archivable(char* filename);
+static int read_status(char* path, struct art* archived);
+static int write_status(char* path, int number_of_files, char** files, struct art* archived);
+static uint64_t segment_end_lsn(char* filename, int segsize);
+
+int
+pgmoneta_wal_archive(int server)
+{
+   bool active = false;
+   int number_of_workers = 0;
+   int number_of_files = 0;
+   int number_of_archived = 0;
+   int number_of_failed = 0;
+   uint64_t lsn = 0;
+   int64_t pending_time = 0;
+   char* wal_dir = NULL;
+   char* status_path = NULL;
+   char* elapsed = NULL;
+   char** files = NULL;
+   double total_seconds = 0;
+   struct timespec start_t;
+   struct timespec end_t;
+   struct art* archived = NULL;
+   struct wal_archive_input** inputs = NULL;
+   struct workers* workers = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   if (!(config->storage_engine & (STORAGE_ENGINE_S3 | STORAGE_ENGINE_AZURE)))
+   {
+      return 0;
+   }
+
+   if (!atomic_compare_exchange_strong(&config->common.servers[server].wal_archive_active, &active, true))
+   {
+      pgmoneta_log_debug("WAL archive: %s is already active", config->common.servers[server].name);
+      return 0;
+   }
+
+#ifdef HAVE_FREEBSD
+   clock_gettime(CLOCK_MONOTONIC_FAST, &start_t);
+#else
+   clock_gettime(CLOCK_MONOTONIC_RAW, &start_t);
+#endif
+
+   wal_dir = pgmoneta_get_server_wal(server);
+   status_path = pgmoneta_get_server(server);
+   status_path = pgmoneta_append(status_path, WAL_ARCHIVE_STATUS);
+
+   if (pgmoneta_art_create(&archived))
+   {
+      goto error;
+   }
+
+   if (read_status(status_path, archived))
+   {
+      goto error;
+   }
+
+   if (pgmoneta_get_files(wal_dir, &number_of_files, &files))
+   {
+      goto error;
+   }
+
+   if (number_of_files > 0)
+   {
+      inputs = (struct wal_archive_input**)calloc(number_of_files, sizeof(struct wal_archive_input*));
+      if (inputs == NULL)
+      {
+         goto error;
+      }
+   }
+
+   number_of_workers = pgmoneta_get_number_of_workers(server);
+   if (number_of_workers > 0)
+   {
+      pgmoneta_workers_initialize(number_of_workers, &workers);
+   }
+
+   /* The number of in-flight uploads is bounded by the number of workers */
+   for (int i = 0; i < number_of_files; i++)
+   {
+      if (!is_archivable(files[i]) || pgmoneta_art_contains_key(archived, files[i]))
+      {
+         continue;
+      }
+
+      inputs[i] = (struct wal_archive_input*)calloc(1, sizeof(struct wal_archive_input));
+      if (inputs[i] == NULL)
+      {
+         goto error;
+      }
+
+      inputs[i]->server = server;
+      memcpy(inputs[i]->filename, files[i], MIN(strlen(files[i]), (size_t)MISC_LENGTH - 1));
+
+      if (workers != NULL)
+      {
+         pgmoneta_workers_add(workers, do_wal_archive, (struct worker_common*)inputs[i]);
+      }
+      else
+      {
+         do_wal_archive((struct worker_common*)inputs[i]);
+      }
+   }
+
+   pgmoneta_workers_wait(workers);
+
+   for (int i = 0; i < number_of_files; i++)
+   {
+      if (inputs[i] == NULL)
+      {
+         continue;
+      }
+
+      if (inputs[i]->archived)
+      {
+         pgmoneta_art_insert(archived, files[i], (uintptr_t)true, ValueBool);
+         number_of_archived++;
+      }
+      else
+      {
+         number_of_failed++;
+      }
+   }
+
+   if (write_status(status_path, number_of_files, files, archived))
+   {
+      pgmoneta_log_error("WAL archive: Unable to write %s", status_path);
+   }
+
+   /* The archive is complete up to the first segment that isn't archived */
+   for (int i = 0; i < number_of_files; i++)
+   {
+      if (!is_segment(files[i]))
+      {
+         continue;
+      }
+
+      if (pgmoneta_art_contains_key(archived, files[i]))
+      {
+         lsn = segment_end_lsn(files[i], config->common.servers[server].wal_size);
+      }
+      else
+      {
+         char* path = NULL;
+         struct stat st;
+
+         path = pgmoneta_append(path, wal_dir);
+         path = pgmoneta_append(path, files[i]);
+
+         if (stat(path, &st) == 0)
+         {
+            pending_time = (int64_t)st.st_mtime;
+         }
+         else
+         {
+            pending_time = (int64_t)time(NULL);
+         }
+
+         free(path);
+         break;
+      }
+   }
+
+   atomic_store(&config->common.servers[server].wal_archive_lsn, lsn);
+   atomic_store(&config->common.servers[server].wal_archive_pending_time, pending_time);
+
+#ifdef HAVE_FREEBSD
+   clock_gettime(CLOCK_MONOTONIC_FAST, &end_t);
+#else
+   clock_gettime(CLOCK_MONOTONIC_RAW, &end_t);
+#endif
+
+   if (number_of_archived > 0 || number_of_failed > 0)
+   {
+      elapsed = pgmoneta_get_timestamp_string(start_t, end_t, &total_seconds);
+
+      pgmoneta_log_info("WAL archive: %s %d files (%d failed) (Elapsed: %s)",
+                        config->common.servers[server].name, number_of_archived, number_of_failed, elapsed);
+   }
+
+   pgmoneta_workers_destroy(workers);
+
+   for (int i = 0; i < number_of_files; i++)
+   {
+      if (inputs != NULL)
+      {
+         free(inputs[i]);
+      }
+      free(files[i]);
+   }
+   free(inputs);
+   free(files);
+
+   pgmoneta_art_destroy(archived);
+
+   free(elapsed);
+   free(status_path);
+   free(wal_dir);
+
+   atomic_store(&config->common.servers[server].wal_archive_active, false);
+
+   return number_of_failed > 0 ? 1 : 0;
+
+error:
+
+   pgmoneta_workers_wait(workers);
+   pgmoneta_workers_destroy(workers);
+
+   for (int i = 0; i < number_of_files; i++)
+   {
+      if (inputs != NULL)
+      {
+         free(inputs[i]);
+      }
+      free(files[i]);
+   }
+   free(inputs);
+   free(files);
+
+   pgmoneta_art_destroy(archived);
+
+   free(elapsed);
+   free(status_path);
+   free(wal_dir);
+
+   atomic_store(&config->common.servers[server].wal_archive_active, false);
+
+   return 1;
+}
+
+int
+pgmoneta_wal_archive_status(int server, struct art** archived)
+{
+   char* status_path = NULL;
+   struct art* a = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   *archived = NULL;
+
+   if (!(config->storage_engine & (STORAGE_ENGINE_S3 | STORAGE_ENGINE_AZURE)))
+   {
+      return 0;
+   }
+
+   status_path = pgmoneta_get_server(server);
+   status_path = pgmoneta_append(status_path, WAL_ARCHIVE_STATUS);
+
+   if (pgmoneta_art_create(&a))
+   {
+      goto error;
+   }
+
+   if (read_status(status_path, a))
+   {
+      goto error;
+   }
+
+   *archived = a;
+
+   free(status_path);
+
+   return 0;
+
+error:
+
+   pgmoneta_art_destroy(a);
+   free(status_path);
+
+   return 1;
+}
+
+static void
+do_wal_archive(struct worker_common* wc)
+{
+   bool ok = false;
+   struct wal_archive_input* input = (struct wal_archive_input*)wc;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   for (int i = 0; !ok && i < WAL_ARCHIVE_RETRIES; i++)
+   {
+      if (i > 0)
+      {
+         sleep(i);
+      }
+
+      ok = true;
+
+      if ((config->storage_engine & STORAGE_ENGINE_S3) && pgmoneta_s3_wal_upload(input->server, input->filename))
+      {
+         ok = false;
+      }
+
+      if (ok && (config->storage_engine & STORAGE_ENGINE_AZURE) && pgmoneta_azure_wal_upload(input->server, input->filename))
+      {
+         ok = false;
+      }
+   }
+
+   if (!ok)
+   {
+      pgmoneta_log_warn("WAL archive: Unable to upload %s for %s, will retry later",
+                        input->filename, config->common.servers[input->server].name);
+   }
+
+   input->archived = ok;
+}
+
+static bool
+is_segment(char* filename)
+{
+   if (strlen(filename) < 24)
+   {
+      return false;
+   }
+
+   for (int i = 0; i < 24; i++)
+   {
+      if (!isxdigit((unsigned char)filename[i]))
+      {
+         return false;
+      }
+   }
+
+   if (strlen(filename) > 24 && filename[24] != '.')
+   {
+      return false;
+   }
+
+   return !pgmoneta_ends_with(filename, ".partial");
+}
+
+static bool
+is_archivable(char* filename)
+{
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   if (pgmoneta_ends_with(filename, ".history"))
+   {
+      return true;
+   }
+
+   if (!is_segment(filename))
+   {
+      return false;
+   }
+
+   /* Only upload segments that have reached their final form */
+   if (config->encryption != ENCRYPTION_NONE)
+   {
+      return pgmoneta_is_encrypted(filename);
+   }
+
+   if (config->compression_type != COMPRESSION_NONE)
+   {
+      return pgmoneta_is_compressed(filename);
+   }
+
+   return strlen(filename) == 24;
+}
+
+static int
+read_status(char* path, struct art* archived)
+{
+   char line[MISC_LENGTH];
+   FILE* file = NULL;
+
+   file = fopen(path, "r");
+   if (file == NULL)
+   {
+      return 0;
+   }
+
+   memset(&line[0], 0, sizeof(line));
+   while (fgets(&line[0], sizeof(line), file) != NULL)
+   {
+      line[strcspn(&line[0], "\r\n")] = '\0';
+
+      if (strlen(&line[0]) > 0)
+      {
+         pgmoneta_art_insert(archived, &line[0], (uintptr_t)true, ValueBool);
+      }
+
+      memset(&line[0], 0, sizeof(line));
+   }
+
+   fclose(file);
+
+   return 0;
+}
+
+static int
+write_status(char* path, int number_of_files, char** files, struct art* archived)
+{
+   char* tmp_path = NULL;
+   FILE* file = NULL;
+
+   tmp_path = pgmoneta_append(tmp_path, path);
+   tmp_path = pgmoneta_append(tmp_path, ".tmp");
+
+   file = fopen(tmp_path, "w");
+   if (file == NULL)
+   {
+      goto error;
+   }
+
+   /* Files that have been removed from the WAL directory are dropped */
+   for (int i = 0; i < number_of_files; i++)
+   {
+      if (pgmoneta_art_contains_key(archived, files[i]))
+      {
+         fprintf(file, "%s\n", files[i]);
+      }
+   }
+
+   if (fflush(file) != 0 || fsync(fileno(file)) != 0)
+   {
+      goto error;
+   }
+
+   fclose(file);
+   file = NULL;
+
+   if (rename(tmp_path, path) != 0)
+   {
+      goto error;
+   }
+
+   free(tmp_path);
+
+   return 0;
+
+error:
+
+   if (file != NULL)
+   {
+      fclose(file);
+   }
+
+   free(tmp_path);
+
+   return 1;
+}
+
+static uint64_t
+segment_end_lsn(char* filename, int segsize)
+{
+   uint32_t tli = 0;
+   uint32_t log = 0;
+   uint32_t seg = 0;
+   uint64_t segments_per_id = 0;
+
+   if (segsize <= 0 || sscanf(filename, "%08X%08X%08X", &tli, &log, &seg) != 3)
+   {
+      return 0;
+   }
+
+   segments_per_id = 0x100000000ULL / segsize;
+
+   return ((uint64_t)log * segments_per_id + seg + 1) * (uint64_t)segsize;
+}
@@ -0,0 +1,570 @@
+/*
+ * Copyright (C) 2025 The pgmoneta community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* pgmoneta */
+#include <pgmoneta.h>
+#include <logging.h>
+#include <management.h>
+#include <network.h>
+#include <security.h>
+#include <utils.h>
+#include <walfetch.h>
+#include <workers.h>
+
+/* system */
+#include <ctype.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NAME "wal-fetch"
+
+#define WAL_FETCH_WAIT_LOOPS 6000     /* 60 seconds in steps of 10 ms */
+
+static char* wal_fetch_find(int server, char* file);
+static int wal_fetch_extract(char* from, char* file, char* to);
+static int wal_fetch_file(int server, char* file, char* path);
+static char* wal_fetch_spool(int server, char* path);
+static bool wal_fetch_pending(char* spool, char* file);
+static bool wal_fetch_segment(char* file, uint32_t* tli, uint64_t* segno, int segsize);
+static void wal_prefetch(int server, char* file, char* path);
+static void do_prefetch(struct worker_common* wc);
+
+static char* wal_fetch_extensions[] = {
+   "",
+   ".zstd",
+   ".gz",
+   ".lz4",
+   ".bz2",
+   ".aes",
+   ".zstd.aes",
+   ".gz.aes",
+   ".lz4.aes",
+   ".bz2.aes",
+   ".partial"
+};
+
+void
+pgmoneta_wal_fetch(SSL* ssl, int client_fd, int server, uint8_t compression, uint8_t encryption, struct json* payload)
+{
+   char* file = NULL;
+   char* path = NULL;
+   char* elapsed = NULL;
+   struct timespec start_t;
+   struct timespec end_t;
+   double total_seconds;
+   struct json* request = NULL;
+   struct json* response = NULL;
+   struct main_configuration* config;
+
+   pgmoneta_start_logging();
+
+   config = (struct main_configuration*)shmem;
+
+#ifdef HAVE_FREEBSD
+   clock_gettime(CLOCK_MONOTONIC_FAST, &start_t);
+#else
+   clock_gettime(CLOCK_MONOTONIC_RAW, &start_t);
+#endif
+
+   request = (struct json*)pgmoneta_json_get(payload, MANAGEMENT_CATEGORY_REQUEST);
+   file = (char*)pgmoneta_json_get(request, MANAGEMENT_ARGUMENT_FILENAME);
+   path = (char*)pgmoneta_json_get(request, MANAGEMENT_ARGUMENT_DESTINATION_FILE);
+
+   if (file == NULL || path == NULL || strlen(file) == 0 || strchr(file, '/') != NULL || path[0] != '/')
+   {
+      pgmoneta_management_response_error(ssl, client_fd, config->common.servers[server].name, MANAGEMENT_ERROR_WAL_FETCH_ERROR, NAME, compression, encryption, payload);
+      pgmoneta_log_error("WAL fetch: Invalid request for %s", config->common.servers[server].name);
+
+      goto error;
+   }
+
+   if (wal_fetch_file(server, file, path))
+   {
+      pgmoneta_management_response_error(ssl, client_fd, config->common.servers[server].name, MANAGEMENT_ERROR_WAL_FETCH_NOFILE, NAME, compression, encryption, payload);
+      /* The recovery asks for files that do not exist to find its end */
+      pgmoneta_log_debug("WAL fetch: No %s for %s", file, config->common.servers[server].name);
+
+      goto error;
+   }
+
+   if (pgmoneta_management_create_response(payload, server, &response))
+   {
+      pgmoneta_management_response_error(ssl, client_fd, config->common.servers[server].name, MANAGEMENT_ERROR_ALLOCATION, NAME, compression, encryption, payload);
+
+      goto error;
+   }
+
+   pgmoneta_json_put(response, MANAGEMENT_ARGUMENT_SERVER, (uintptr_t)config->common.servers[server].name, ValueString);
+   pgmoneta_json_put(response, MANAGEMENT_ARGUMENT_FILENAME, (uintptr_t)file, ValueString);
+
+#ifdef HAVE_FREEBSD
+   clock_gettime(CLOCK_MONOTONIC_FAST, &end_t);
+#else
+   clock_gettime(CLOCK_MONOTONIC_RAW, &end_t);
+#endif
+
+   if (pgmoneta_management_response_ok(ssl, client_fd, start_t, end_t, compression, encryption, payload))
+   {
+      pgmoneta_management_response_error(ssl, client_fd, config->common.servers[server].name, MANAGEMENT_ERROR_WAL_FETCH_NETWORK, NAME, compression, encryption, payload);
+      pgmoneta_log_error("WAL fetch: Error sending response for %s", config->common.servers[server].name);
+
+      goto error;
+   }
+
+   elapsed = pgmoneta_get_timestamp_string(start_t, end_t, &total_seconds);
+
+   pgmoneta_log_debug("WAL fetch: %s/%s (Elapsed: %s)", config->common.servers[server].name, file, elapsed);
+
+   /* Release the recovery before the next segments are extracted */
+   pgmoneta_disconnect(client_fd);
+   client_fd = -1;
+
+   wal_prefetch(server, file, path);
+
+   pgmoneta_json_destroy(payload);
+
+   pgmoneta_stop_logging();
+
+   free(elapsed);
+
+   exit(0);
+
+error:
+
+   pgmoneta_json_destroy(payload);
+
+   pgmoneta_disconnect(client_fd);
+
+   pgmoneta_stop_logging();
+
+   free(elapsed);
+
+   exit(1);
+}
+
+char*
+pgmoneta_wal_fetch_command(int server)
+{
+   char* cmd = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   cmd = pgmoneta_append(cmd, "pgmoneta-cli -c ");
+   cmd = pgmoneta_append(cmd, config->common.configuration_path);
+   cmd = pgmoneta_append(cmd, " wal-fetch ");
+   cmd = pgmoneta_append(cmd, config->common.servers[server].name);
+   cmd = pgmoneta_append(cmd, " %f %p");
+
+   return cmd;
+}
+
+static int
+wal_fetch_file(int server, char* file, char* path)
+{
+   char* spool = NULL;
+   char* prefetched = NULL;
+   char* archived = NULL;
+   char* tmp = NULL;
+
+   spool = wal_fetch_spool(server, path);
+   if (spool == NULL)
+   {
+      goto error;
+   }
+
+   prefetched = pgmoneta_append(prefetched, spool);
+   prefetched = pgmoneta_append(prefetched, file);
+
+   /* A prefetch of the file may already be running */
+   for (int i = 0; i < WAL_FETCH_WAIT_LOOPS && !pgmoneta_exists(prefetched) && wal_fetch_pending(spool, file); i++)
+   {
+      SLEEP(10000000L);
+   }
+
+   if (pgmoneta_exists(prefetched))
+   {
+      if (rename(prefetched, path))
+      {
+         /* The prefetch directory is on another file system */
+         tmp = pgmoneta_append(tmp, path);
+         tmp = pgmoneta_append(tmp, ".pgmoneta");
+
+         if (pgmoneta_copy_file(prefetched, tmp, NULL) || rename(tmp, path))
+         {
+            pgmoneta_log_error("WAL fetch: Unable to move %s to %s", prefetched, path);
+            remove(tmp);
+            goto error;
+         }
+
+         remove(prefetched);
+      }
+   }
+   else
+   {
+      archived = wal_fetch_find(server, file);
+      if (archived == NULL)
+      {
+         goto error;
+      }
+
+      if (wal_fetch_extract(archived, file, path))
+      {
+         goto error;
+      }
+   }
+
+   free(spool);
+   free(prefetched);
+   free(archived);
+   free(tmp);
+
+   return 0;
+
+error:
+
+   free(spool);
+   free(prefetched);
+   free(archived);
+   free(tmp);
+
+   return 1;
+}
+
+static char*
+wal_fetch_find(int server, char* file)
+{
+   char* wal_dir = NULL;
+   char* f = NULL;
+
+   wal_dir = pgmoneta_get_server_wal(server);
+
+   for (size_t i = 0; i < sizeof(wal_fetch_extensions) / sizeof(wal_fetch_extensions[0]); i++)
+   {
+      f = pgmoneta_append(f, wal_dir);
+      f = pgmoneta_append(f, file);
+      f = pgmoneta_append(f, wal_fetch_extensions[i]);
+
+      if (pgmoneta_exists(f))
+      {
+         free(wal_dir);
+         return f;
+      }
+
+      free(f);
+      f = NULL;
+   }
+
+   free(wal_dir);
+
+   return NULL;
+}
+
+static int
+wal_fetch_extract(char* from, char* file, char* to)
+{
+   char pid[MISC_LENGTH];
+   char* ext = NULL;
+   char* tmp = NULL;
+
+   /* Extract next to the target and rename, so a partial file is never seen */
+   ext = strrchr(from, '/') != NULL ? strrchr(from, '/') + 1 : from;
+   ext += strlen(file);
+
+   memset(&pid[0], 0, sizeof(pid));
+   snprintf(&pid[0], sizeof(pid), ".%d", getpid());
+
+   tmp = pgmoneta_append(tmp, to);
+   tmp = pgmoneta_append(tmp, &pid[0]);
+   if (strcmp(ext, ".partial"))
+   {
+      tmp = pgmoneta_append(tmp, ext);
+   }
+
+   if (pgmoneta_copy_and_extract_file(from, &tmp))
+   {
+      pgmoneta_log_error("WAL fetch: Unable to extract %s", from);
+      goto error;
+   }
+
+   if (rename(tmp, to))
+   {
+      pgmoneta_log_error("WAL fetch: Unable to rename %s to %s: %s", tmp, to, strerror(errno));
+      goto error;
+   }
+
+   free(tmp);
+
+   return 0;
+
+error:
+
+   if (tmp != NULL)
+   {
+      remove(tmp);
+   }
+   free(tmp);
+
+   return 1;
+}
+
+static char*
+wal_fetch_spool(int server, char* path)
+{
+   char* dir = NULL;
+   char* hash = NULL;
+   char* spool = NULL;
+   char* slash = NULL;
+
+   /* Each restored cluster gets its own directory, keyed by its pg_wal directory,
+    * so concurrent recoveries of the same server never prune each other's segments */
+   dir = pgmoneta_append(dir, path);
+   slash = strrchr(dir, '/');
+   if (slash != NULL)
+   {
+      *slash = '\0';
+   }
+
+   if (pgmoneta_generate_string_sha256_hash(dir, &hash) || hash == NULL)
+   {
+      free(dir);
+      return NULL;
+   }
+
+   spool = pgmoneta_get_server_wal_prefetch(server);
+   spool = pgmoneta_append(spool, hash);
+   spool = pgmoneta_append(spool, "/");
+
+   free(dir);
+   free(hash);
+
+   return spool;
+}
+
+static bool
+wal_fetch_pending(char* spool, char* file)
+{
+   int number_of_files = 0;
+   char** files = NULL;
+   bool pending = false;
+   size_t length = strlen(file);
+
+   if (pgmoneta_get_files(spool, &number_of_files, &files))
+   {
+      return false;
+   }
+
+   for (int i = 0; i < number_of_files; i++)
+   {
+      if (!pending && !strncmp(files[i], file, length) && files[i][length] == '.')
+      {
+         pid_t pid = (pid_t)strtol(files[i] + length + 1, NULL, 10);
+
+         if (pid > 0 && (kill(pid, 0) == 0 || errno != ESRCH))
+         {
+            pending = true;
+         }
+         else
+         {
+            /* Left behind by a prefetch that did not finish */
+            char* f = NULL;
+
+            f = pgmoneta_append(f, spool);
+            f = pgmoneta_append(f, files[i]);
+            remove(f);
+            free(f);
+            errno = 0;
+         }
+      }
+      free(files[i]);
+   }
+   free(files);
+
+   return pending;
+}
+
+static bool
+wal_fetch_segment(char* file, uint32_t* tli, uint64_t* segno, int segsize)
+{
+   uint32_t log = 0;
+   uint32_t seg = 0;
+
+   if (strlen(file) != 24)
+   {
+      return false;
+   }
+
+   for (int i = 0; i < 24; i++)
+   {
+      if (!isxdigit((unsigned char)file[i]))
+      {
+         return false;
+      }
+   }
+
+   if (sscanf(file, "%08X%08X%08X", tli, &log, &seg) != 3)
+   {
+      return false;
+   }
+
+   *segno = (uint64_t)log * (0x100000000ULL / segsize) + seg;
+
+   return true;
+}
+
+static void
+wal_prefetch(int server, char* file, char* path)
+{
+   uint32_t tli = 0;
+   uint64_t segno = 0;
+   int segsize;
+   int number_of_files = 0;
+   char** files = NULL;
+   char* spool = NULL;
+   int number_of_workers = 0;
+   struct workers* workers = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   segsize = config->common.servers[server].wal_size;
+
+   if (config->wal_prefetch <= 0 || segsize <= 0 || !wal_fetch_segment(file, &tli, &segno, segsize))
+   {
+      return;
+   }
+
+   spool = wal_fetch_spool(server, path);
+   if (spool == NULL)
+   {
+      goto done;
+   }
+
+   if (pgmoneta_mkdir(spool))
+   {
+      pgmoneta_log_warn("WAL fetch: Unable to create %s", spool);
+      goto done;
+   }
+
+   /* Drop the segments the recovery has moved past */
+   if (!pgmoneta_get_files(spool, &number_of_files, &files))
+   {
+      for (int i = 0; i < number_of_files; i++)
+      {
+         if (strncmp(files[i], file, 24) < 0)
+         {
+            char* f = NULL;
+
+            f = pgmoneta_append(f, spool);
+            f = pgmoneta_append(f, files[i]);
+            remove(f);
+            free(f);
+         }
+         free(files[i]);
+      }
+      free(files);
+   }
+
+   number_of_workers = pgmoneta_get_number_of_workers(server);
+   if (number_of_workers > 0)
+   {
+      pgmoneta_workers_initialize(number_of_workers, &workers);
+   }
+
+   for (int i = 1; i <= config->wal_prefetch; i++)
+   {
+      char* name = NULL;
+      char* archived = NULL;
+      char* to = NULL;
+      struct worker_input* wi = NULL;
+
+      name = pgmoneta_wal_file_name(tli, segno + i, segsize);
+
+      to = pgmoneta_append(to, spool);
+      to = pgmoneta_append(to, name);
+
+      if (pgmoneta_exists(to) || wal_fetch_pending(spool, name))
+      {
+         free(name);
+         free(to);
+         continue;
+      }
+
+      archived = wal_fetch_find(server, name);
+      if (archived == NULL || pgmoneta_ends_with(archived, ".partial"))
+      {
+         /* The end of the archive, or a segment that is still streamed */
+         free(name);
+         free(archived);
+         free(to);
+         break;
+      }
+
+      if (!pgmoneta_create_worker_input(NULL, archived, to, 0, workers, &wi))
+      {
+         if (workers != NULL)
+         {
+            pgmoneta_workers_add(workers, do_prefetch, (struct worker_common*)wi);
+         }
+         else
+         {
+            do_prefetch((struct worker_common*)wi);
+         }
+      }
+
+      free(name);
+      free(archived);
+      free(to);
+   }
+
+   pgmoneta_workers_wait(workers);
+   pgmoneta_workers_destroy(workers);
+
+done:
+
+   free(spool);
+}
+
+static void
+do_prefetch(struct worker_common* wc)
+{
+   struct worker_input* wi = (struct worker_input*)wc;
+   char* name = strrchr(wi->to, '/') + 1;
+
+   if (wal_fetch_extract(wi->from, name, wi->to))
+   {
+      pgmoneta_log_warn("WAL fetch: Unable to prefetch %s", name);
+   }
+
+   free(wi);
+}
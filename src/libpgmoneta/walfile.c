@@ -80,6 +80,12 @@ error:
 
 int
 pgmoneta_read_walfile(int server, char* path, struct walfile** wf)
+{
+   return pgmoneta_read_walfile_filtered(server, path, NULL, NULL, wf);
+}
+
+int
+pgmoneta_read_walfile_filtered(int server, char* path, wal_record_filter filter, void* filter_data, struct walfile** wf)
 {
    int error_code = PGMONETA_WAL_SUCCESS;
    struct walfile* new_wf = NULL;
@@ -111,7 +117,7 @@ pgmoneta_read_walfile(int server, char* path, struct walfile** wf)
       goto error;
    }
 
-   if (pgmoneta_wal_parse_wal_file(path, server, new_wf))
+   if (pgmoneta_wal_parse_wal_file(path, server, filter, filter_data, new_wf))
    {
       pgmoneta_log_error("Failed to parse WAL file: %s", path);
       error_code = PGMONETA_WAL_ERR_FORMAT;
@@ -136,18 +142,18 @@ pgmoneta_write_walfile(struct walfile* wf, int server __attribute__((unused)), c
    int error_code = PGMONETA_WAL_SUCCESS;
    FILE* file = NULL;
    struct deque_iterator* record_iterator = NULL;
-   uint32_t block_size = wf->long_phd->xlp_xlog_blcksz;
-   uint64_t seg_size = wf->long_phd->xlp_seg_size;
+   uint32_t block_size = 0;
+   uint64_t seg_size = 0;
    int current_page = 0;
    size_t current_pos = SIZE_OF_XLOG_LONG_PHD;  /* Position in current page */
    size_t file_pos = current_pos;               /* Absolute file position */
+   char* segment = NULL;
    char* encoded_record = NULL;
    struct decoded_xlog_record* record = NULL;
    uint32_t written = 0;
    uint32_t total_length = 0;
    size_t space_left = 0;
    size_t to_write = 0;
-   size_t current_size = 0;
 
    if (!wf || !path)
    {
@@ -155,11 +161,15 @@ pgmoneta_write_walfile(struct walfile* wf, int server __attribute__((unused)), c
       return PGMONETA_WAL_ERR_PARAM;
    }
 
-   file = fopen(path, "wb");
-   if (!file)
+   block_size = wf->long_phd->xlp_xlog_blcksz;
+   seg_size = wf->long_phd->xlp_seg_size;
+
+   /* The segment is assembled in memory, zero filled, and written with a single call */
+   segment = calloc(1, seg_size);
+   if (!segment)
    {
-      pgmoneta_log_error("Unable to open WAL file for writing: %s", path);
-      error_code = PGMONETA_WAL_ERR_IO;
+      pgmoneta_log_error("Failed to allocate WAL segment buffer");
+      error_code = PGMONETA_WAL_ERR_MEMORY;
       goto error;
    }
 
@@ -170,12 +180,7 @@ pgmoneta_write_walfile(struct walfile* wf, int server __attribute__((unused)), c
       goto error;
    }
 
-   if (fwrite(wf->long_phd, SIZE_OF_XLOG_LONG_PHD, 1, file) != 1)
-   {
-      pgmoneta_log_error("Failed to write WAL header to file: %s", path);
-      error_code = PGMONETA_WAL_ERR_IO;
-      goto error;
-   }
+   memcpy(segment, wf->long_phd, SIZE_OF_XLOG_LONG_PHD);
 
    /* Iterate through all records */
    while (pgmoneta_deque_iterator_next(record_iterator))
@@ -208,7 +213,6 @@ pgmoneta_write_walfile(struct walfile* wf, int server __attribute__((unused)), c
             current_page++;
             current_pos = 0;
             file_pos = current_page * block_size;
-            fseek(file, file_pos, SEEK_SET);
          }
 
          /* Write short header if we're at the start of a new page (not page 0) */
@@ -221,13 +225,15 @@ pgmoneta_write_walfile(struct walfile* wf, int server __attribute__((unused)), c
             short_header.xlp_pageaddr = wf->long_phd->std.xlp_pageaddr + (current_page * block_size);
             short_header.xlp_rem_len = total_length - written;
 
-            if (fwrite(&short_header, SIZE_OF_XLOG_SHORT_PHD, 1, file) != 1)
+            if (file_pos + SIZE_OF_XLOG_SHORT_PHD > seg_size)
             {
-               pgmoneta_log_error("Failed to write page header");
-               error_code = PGMONETA_WAL_ERR_IO;
+               pgmoneta_log_error("WAL records exceed the segment size of %s", path);
+               error_code = PGMONETA_WAL_ERR_FORMAT;
                goto error;
             }
 
+            memcpy(segment + file_pos, &short_header, SIZE_OF_XLOG_SHORT_PHD);
+
             current_pos = SIZE_OF_XLOG_SHORT_PHD;
             file_pos += SIZE_OF_XLOG_SHORT_PHD;
          }
@@ -243,65 +249,49 @@ pgmoneta_write_walfile(struct walfile* wf, int server __attribute__((unused)), c
          to_write = (total_length - written) < space_left ?
                     (total_length - written) : space_left;
 
-         /* Write record data */
-         if (fwrite(encoded_record + written, 1, to_write, file) != to_write)
+         if (file_pos + to_write > seg_size)
          {
-            pgmoneta_log_error("Failed to write WAL record data");
-            error_code = PGMONETA_WAL_ERR_IO;
+            pgmoneta_log_error("WAL records exceed the segment size of %s", path);
+            error_code = PGMONETA_WAL_ERR_FORMAT;
             goto error;
          }
 
+         /* Write record data */
+         memcpy(segment + file_pos, encoded_record + written, to_write);
+
          written += to_write;
          current_pos += to_write;
          file_pos += to_write;
       }
 
-      /* Add padding for alignment after record */
+      /* Add padding for alignment after record, the buffer is already zeroed */
       if (current_pos % MAXIMUM_ALIGNOF != 0)
       {
          size_t padding = MAXIMUM_ALIGNOF - (current_pos % MAXIMUM_ALIGNOF);
-         if (padding > 0)
-         {
-            char zero_padding[8] = {0};
-            if (fwrite(zero_padding, 1, padding, file) != padding)
-            {
-               pgmoneta_log_error("Failed to write padding after WAL record (page %d, position %zu, padding %zu bytes) to file: %s",
-                                  current_page, current_pos, padding, path);
-               error_code = PGMONETA_WAL_ERR_IO;
-               goto error;
-            }
-            current_pos += padding;
-            file_pos += padding;
-         }
+         current_pos += padding;
+         file_pos += padding;
       }
    }
 
-   /* Fill remaining segment with zeros */
-   current_size = file_pos;
-   if (current_size < seg_size)
+   file = fopen(path, "wb");
+   if (!file)
    {
-      size_t zero_bytes = seg_size - current_size;
-      char* zeros = calloc(1, zero_bytes);
-      if (!zeros)
-      {
-         pgmoneta_log_error("Failed to allocate zero buffer");
-         error_code = PGMONETA_WAL_ERR_MEMORY;
-         goto error;
-      }
+      pgmoneta_log_error("Unable to open WAL file for writing: %s", path);
+      error_code = PGMONETA_WAL_ERR_IO;
+      goto error;
+   }
 
-      if (fwrite(zeros, 1, zero_bytes, file) != zero_bytes)
-      {
-         free(zeros);
-         pgmoneta_log_error("Failed to write zero padding");
-         error_code = PGMONETA_WAL_ERR_IO;
-         goto error;
-      }
-      free(zeros);
+   if (fwrite(segment, 1, seg_size, file) != seg_size)
+   {
+      pgmoneta_log_error("Failed to write WAL file: %s", path);
+      error_code = PGMONETA_WAL_ERR_IO;
+      goto error;
    }
 
    pgmoneta_deque_iterator_destroy(record_iterator);
    fclose(file);
    free(encoded_record);
+   free(segment);
    return PGMONETA_WAL_SUCCESS;
 
 error:
@@ -310,6 +300,7 @@ error:
       fclose(file);
    }
    free(encoded_record);
+   free(segment);
    pgmoneta_deque_iterator_destroy(record_iterator);
    return error_code;
 }
@@ -338,6 +329,7 @@ pgmoneta_destroy_walfile(struct walfile* wf)
          free(record);
          continue;
       }
+      free(record->raw);
       if (record->main_data != NULL)
       {
          free(record->main_data);
@@ -51,10 +51,10 @@
 struct server* server_config;
 
 static int decode_xlog_record(char* buffer, struct decoded_xlog_record* decoded, struct xlog_record* record, uint32_t block_size, uint16_t magic_value, xlog_rec_ptr lsn);
+static transaction_id read_toplevel_xid(char* buffer, struct xlog_record* record, uint16_t magic_value);
 static void record_json(struct decoded_xlog_record* record, uint8_t magic_value, struct value** value);
 static bool get_record_block_tag_extended(struct decoded_xlog_record* pRecord, int id, struct rel_file_locator* pLocator, enum fork_number* pNumber, block_number* pInt, buffer* pVoid);
 static char* get_record_block_ref_info(char* buf, struct decoded_xlog_record* record, bool pretty, bool detailed_format, uint32_t* fpi_len, uint8_t magic_value);
-static int magic_value_to_postgres_version(uint16_t magic_value);
 
 static bool is_included(char* rm, struct deque* rms, uint64_t s_lsn, uint64_t start_lsn, uint64_t e_lsn, uint64_t end_lsn,
                         uint32_t xid, struct deque* xids, char** included_objects, char* rm_desc, uint32_t xl_info, rmgr_id rm_id);
@@ -80,8 +80,8 @@ is_bimg_apply(uint8_t bimg_info)
    return (bimg_info & BKPIMAGE_APPLY) != 0;
 }
 
-static int
-magic_value_to_postgres_version(uint16_t magic_value)
+int
+pgmoneta_wal_magic_to_version(uint16_t magic_value)
 {
    switch (magic_value)
    {
@@ -105,7 +105,7 @@ magic_value_to_postgres_version(uint16_t magic_value)
 bool
 pgmoneta_wal_is_bkp_image_compressed(uint16_t magic_value, uint8_t bimg_info)
 {
-   if (magic_value_to_postgres_version(magic_value) >= 15)
+   if (pgmoneta_wal_magic_to_version(magic_value) >= 15)
    {
       return (bimg_info & (BKPIMAGE_COMPRESS_PGLZ | BKPIMAGE_COMPRESS_LZ4 | BKPIMAGE_COMPRESS_ZSTD)) != 0;
    }
@@ -186,7 +186,7 @@ error:
 }
 
 int
-pgmoneta_wal_parse_wal_file(char* path, int server, struct walfile* wal_file)
+pgmoneta_wal_parse_wal_file(char* path, int server, wal_record_filter filter, void* filter_data, struct walfile* wal_file)
 {
 #define MALLOC(pointer, size) \
         pointer = malloc(size); \
@@ -246,11 +246,11 @@ pgmoneta_wal_parse_wal_file(char* path, int server, struct walfile* wal_file)
       goto error;
    }
 
-   assert(magic_value_to_postgres_version(long_header->std.xlp_magic) != -1);
+   assert(pgmoneta_wal_magic_to_version(long_header->std.xlp_magic) != -1);
 
    if (server == -1)
    {
-      config->common.servers[0].version = magic_value_to_postgres_version(long_header->std.xlp_magic);
+      config->common.servers[0].version = pgmoneta_wal_magic_to_version(long_header->std.xlp_magic);
       server_config = &config->common.servers[0];
    }
    else
@@ -280,7 +280,7 @@ pgmoneta_wal_parse_wal_file(char* path, int server, struct walfile* wal_file)
 
       if (partial_record->xlog_record_bytes_read == 0)
       {
-         decoded = malloc(sizeof(struct decoded_xlog_record));
+         decoded = calloc(1, sizeof(struct decoded_xlog_record));
          if (decoded == NULL)
          {
             pgmoneta_log_fatal("Error: Could not allocate memory for decoded");
@@ -496,35 +496,44 @@ pgmoneta_wal_parse_wal_file(char* path, int server, struct walfile* wal_file)
          goto error;
       }
 
-      if (decode_xlog_record(buffer, decoded, record, wal_file->long_phd->xlp_xlog_blcksz, wal_file->long_phd->std.xlp_magic, lsn))
+      if (filter != NULL && !filter(record, filter_data))
+      {
+         /* Only the header is looked at, the data is kept for the encoding */
+         decoded->header = *record;
+         decoded->lsn = lsn;
+         decoded->record_origin = INVALID_REP_ORIGIN_ID;
+         decoded->toplevel_xid = read_toplevel_xid(buffer, record, wal_file->long_phd->std.xlp_magic);
+         decoded->max_block_id = -1;
+         decoded->raw = buffer;
+         buffer = NULL;
+      }
+      else if (decode_xlog_record(buffer, decoded, record, wal_file->long_phd->xlp_xlog_blcksz, wal_file->long_phd->std.xlp_magic, lsn))
       {
          goto error;
       }
-      else
+
+      if (lsn_array_size >= lsn_array_capacity)
       {
-         if (lsn_array_size >= lsn_array_capacity)
+         lsn_array_capacity *= 2;
+         xlog_rec_ptr* temp_array = realloc(lsn_array, lsn_array_capacity * sizeof(xlog_rec_ptr));
+         if (temp_array == NULL)
          {
-            lsn_array_capacity *= 2;
-            xlog_rec_ptr* temp_array = realloc(lsn_array, lsn_array_capacity * sizeof(xlog_rec_ptr));
-            if (temp_array == NULL)
-            {
-               pgmoneta_log_error("Error: Could not reallocate LSN array");
-               goto error;
-            }
-            lsn_array = temp_array;
+            pgmoneta_log_error("Error: Could not reallocate LSN array");
+            goto error;
          }
+         lsn_array = temp_array;
+      }
 
-         lsn_array[lsn_array_size] = lsn;
-         lsn_array_size++;
+      lsn_array[lsn_array_size] = lsn;
+      lsn_array_size++;
 
-         if (pgmoneta_deque_add(wal_file->records, NULL, (uintptr_t) decoded, ValueRef))
-         {
-            free(decoded);
-            decoded = NULL;
-            goto error;
-         }
+      if (pgmoneta_deque_add(wal_file->records, NULL, (uintptr_t) decoded, ValueRef))
+      {
+         free(decoded);
          decoded = NULL;
+         goto error;
       }
+      decoded = NULL;
       free(buffer);
       buffer = NULL;
       free(record);
@@ -564,6 +573,10 @@ error:
    free(temp_buffer);
    free(buffer);
    free(record);
+   if (decoded != NULL)
+   {
+      free(decoded->raw);
+   }
    free(decoded);
    decoded = NULL;
 
@@ -578,6 +591,111 @@ error:
    return 1;
 }
 
+/**
+ * Read the top-level XID of a subtransaction record from the block headers,
+ * without decoding the blocks or the main data
+ *
+ * @param buffer The record data following the XLogRecord header
+ * @param record The record header
+ * @param magic_value The magic value of the WAL file
+ * @return The top-level XID, or INVALID_TRANSACTION_ID if there is none
+ */
+static transaction_id
+read_toplevel_xid(char* buffer, struct xlog_record* record, uint16_t magic_value)
+{
+   uint32_t remaining = 0;
+   uint32_t datatotal = 0;
+   char* ptr = NULL;
+   uint8_t block_id;
+   uint8_t fork_flags;
+   uint8_t bimg_info;
+   uint16_t length;
+   transaction_id xid = INVALID_TRANSACTION_ID;
+
+#define SKIP_HEADER_FIELD(_size)            \
+        do {                                    \
+           if (remaining < (_size))            \
+           return INVALID_TRANSACTION_ID;      \
+           ptr += (_size);                     \
+           remaining -= (_size);               \
+        } while (0)
+
+   if (buffer == NULL || record->xl_tot_len < SIZE_OF_XLOG_RECORD)
+   {
+      return INVALID_TRANSACTION_ID;
+   }
+
+   remaining = record->xl_tot_len - SIZE_OF_XLOG_RECORD;
+   ptr = buffer;
+
+   while (remaining > datatotal)
+   {
+      block_id = (uint8_t)*ptr;
+      SKIP_HEADER_FIELD(sizeof(uint8_t));
+
+      if (block_id == XLR_BLOCK_ID_DATA_SHORT || block_id == XLR_BLOCK_ID_DATA_LONG)
+      {
+         /* The main data header is always the last one */
+         break;
+      }
+      else if (block_id == XLR_BLOCK_ID_ORIGIN)
+      {
+         SKIP_HEADER_FIELD(sizeof(rep_origin_id));
+      }
+      else if (block_id == XLR_BLOCK_ID_TOPLEVEL_XID)
+      {
+         if (remaining < sizeof(transaction_id))
+         {
+            return INVALID_TRANSACTION_ID;
+         }
+         memcpy(&xid, ptr, sizeof(transaction_id));
+         break;
+      }
+      else if (block_id <= XLR_MAX_BLOCK_ID)
+      {
+         if (remaining < sizeof(uint8_t) + sizeof(uint16_t))
+         {
+            return INVALID_TRANSACTION_ID;
+         }
+         fork_flags = (uint8_t)*ptr;
+         memcpy(&length, ptr + sizeof(uint8_t), sizeof(uint16_t));
+         SKIP_HEADER_FIELD(sizeof(uint8_t) + sizeof(uint16_t));
+         datatotal += length;
+
+         if (fork_flags & BKPBLOCK_HAS_IMAGE)
+         {
+            if (remaining < 2 * sizeof(uint16_t) + sizeof(uint8_t))
+            {
+               return INVALID_TRANSACTION_ID;
+            }
+            memcpy(&length, ptr, sizeof(uint16_t));
+            bimg_info = (uint8_t)ptr[2 * sizeof(uint16_t)];
+            SKIP_HEADER_FIELD(2 * sizeof(uint16_t) + sizeof(uint8_t));
+            datatotal += length;
+
+            if (pgmoneta_wal_is_bkp_image_compressed(magic_value, bimg_info) && (bimg_info & BKPIMAGE_HAS_HOLE))
+            {
+               SKIP_HEADER_FIELD(sizeof(uint16_t));
+            }
+         }
+
+         if (!(fork_flags & BKPBLOCK_SAME_REL))
+         {
+            SKIP_HEADER_FIELD(sizeof(struct rel_file_locator));
+         }
+         SKIP_HEADER_FIELD(sizeof(block_number));
+      }
+      else
+      {
+         break;
+      }
+   }
+
+#undef SKIP_HEADER_FIELD
+
+   return xid;
+}
+
 static int
 decode_xlog_record(char* buffer, struct decoded_xlog_record* decoded, struct xlog_record* record, uint32_t block_size, uint16_t magic_value, xlog_rec_ptr lsn)
 {
@@ -2136,6 +2254,21 @@ pgmoneta_wal_encode_xlog_record(struct decoded_xlog_record* decoded, uint16_t ma
    record = decoded->header;
    total_length = SIZE_OF_XLOG_RECORD;
 
+   if (decoded->raw != NULL)
+   {
+      buffer = malloc(record.xl_tot_len);
+      if (!buffer)
+      {
+         pgmoneta_log_error("Failed to allocate memory for xlog record encoding");
+         return NULL;
+      }
+
+      memcpy(buffer, &record, SIZE_OF_XLOG_RECORD);
+      memcpy(buffer + SIZE_OF_XLOG_RECORD, decoded->raw, record.xl_tot_len - SIZE_OF_XLOG_RECORD);
+
+      return buffer;
+   }
+
    if (decoded->record_origin != INVALID_REP_ORIGIN_ID)
    {
       total_length += sizeof(uint8_t);
@@ -30,12 +30,20 @@
 #include <pgmoneta.h>
 #include <achv.h>
 #include <backup.h>
+#include <compression.h>
+#include <extension.h>
+#include <instrument.h>
+#include <job.h>
+#include <json.h>
 #include <logging.h>
+#include <manifest.h>
 #include <network.h>
+#include <passthrough.h>
 #include <security.h>
 #include <server.h>
 #include <tablespace.h>
 #include <utils.h>
+#include <workers.h>
 #include <workflow.h>
 
 /* system */
@@ -44,12 +52,52 @@
 #include <stdlib.h>
 #include <string.h>
 
+/** @struct parallel_file
+ * Defines a file copied by a parallel backup
+ */
+struct parallel_file
+{
+   char path[MAX_PATH];              /**< The path relative to the data directory */
+   uint64_t size;                    /**< The size */
+   char last_modified[MISC_LENGTH];  /**< The last modification time */
+   char checksum[MANIFEST_CHECKSUM_LENGTH]; /**< The checksum */
+   bool exists;                      /**< Was the file copied */
+};
+
+/** @struct parallel_connection
+ * Defines a connection of a parallel backup, and the files it copies
+ */
+struct parallel_connection
+{
+   struct worker_common common;          /**< The worker common structure */
+   int server;                           /**< The server */
+   SSL* ssl;                             /**< The SSL structure */
+   int socket;                           /**< The socket */
+   char* directory;                      /**< The data directory of the backup */
+   struct token_bucket* bucket;          /**< The backup token bucket */
+   struct token_bucket* network_bucket;  /**< The network token bucket */
+   int number_of_files;                  /**< The number of files */
+   struct parallel_file** files;         /**< The files */
+};
+
 static char* basebackup_name(void);
 static int basebackup_execute(char*, struct art*);
 
+static uint64_t estimate_backup_size(char* server_backup);
+
 static int send_upload_manifest(SSL* ssl, int socket);
 static int upload_manifest(SSL* ssl, int socket, char* path);
 
+static bool parallel_backup_supported(int server, SSL* ssl, int socket, char* incremental, struct tablespace* tablespaces);
+static int parallel_backup(int server, int usr, SSL* ssl, int socket, char* label, char* directory,
+                           struct token_bucket* bucket, struct token_bucket* network_bucket,
+                           char** start_lsn, uint32_t* start_timeline, char** stop_lsn, uint32_t* stop_timeline);
+static void parallel_backup_copy(struct worker_common* wc);
+static int parallel_backup_copy_file(struct parallel_connection* pc, struct parallel_file* pf);
+static int parallel_backup_manifest(int server, char* directory, uint64_t system_identifier,
+                                    int number_of_files, struct parallel_file** files,
+                                    char* start_lsn, uint32_t timeline, char* stop_lsn);
+
 struct workflow*
 pgmoneta_create_basebackup(void)
 {
@@ -107,12 +155,16 @@ basebackup_execute(char* name __attribute__((unused)), struct art* nodes)
    char startpos[20];
    char endpos[20];
    char* chkptpos = NULL;
+   char* start_lsn = NULL;
+   char* stop_lsn = NULL;
    uint32_t start_timeline = 0;
    uint32_t end_timeline = 0;
    char old_label_path[MAX_PATH];
    int backup_max_rate;
    int network_max_rate;
    uint64_t biggest_file_size;
+   uint64_t passthrough_size = 0;
+   bool passthrough = false;
    struct main_configuration* config;
    struct message* basebackup_msg = NULL;
    struct message* tablespace_msg = NULL;
@@ -147,6 +199,8 @@ basebackup_execute(char* name __attribute__((unused)), struct art* nodes)
 
    pgmoneta_log_debug("Basebackup (execute): %s", config->common.servers[server].name, label);
 
+   pgmoneta_job_total(estimate_backup_size(server_backup), 0);
+
 #ifdef HAVE_FREEBSD
    clock_gettime(CLOCK_MONOTONIC_FAST, &start_t);
 #else
@@ -249,138 +303,173 @@ basebackup_execute(char* name __attribute__((unused)), struct art* nodes)
    }
    pgmoneta_free_query_response(response);
    response = NULL;
-   pgmoneta_close_ssl(ssl);
-   pgmoneta_disconnect(socket);
 
-   if (pgmoneta_server_authenticate(server, "postgres", config->common.users[usr].username, config->common.users[usr].password, true, &ssl, &socket) != AUTH_SUCCESS)
+   if (parallel_backup_supported(server, ssl, socket, incremental, tablespaces))
    {
-      pgmoneta_log_info("Invalid credentials for %s", config->common.users[usr].username);
-      goto error;
-   }
+      pgmoneta_mkdir(backup_base);
+
+      if (parallel_backup(server, usr, ssl, socket, label, backup_data, bucket, network_bucket,
+                          &start_lsn, &start_timeline, &stop_lsn, &end_timeline))
+      {
+         pgmoneta_log_error("Backup: Could not backup %s", config->common.servers[server].name);
 
-   pgmoneta_memory_stream_buffer_init(&buffer);
+         backup->valid = VALID_FALSE;
+         snprintf(backup->label, sizeof(backup->label), "%s", label);
+         if (pgmoneta_save_info(server_backup, backup))
+         {
+            pgmoneta_log_error("Backup: Could not save backup %s", label);
+            goto error;
+         }
 
-   if (incremental != NULL)
+         goto error;
+      }
+
+      memset(startpos, 0, sizeof(startpos));
+      snprintf(startpos, sizeof(startpos), "%s", start_lsn);
+      memset(endpos, 0, sizeof(endpos));
+      snprintf(endpos, sizeof(endpos), "%s", stop_lsn);
+   }
+   else
    {
-      // send UPLOAD_MANIFEST
-      if (send_upload_manifest(ssl, socket))
+      pgmoneta_close_ssl(ssl);
+      pgmoneta_disconnect(socket);
+
+      if (pgmoneta_server_authenticate(server, "postgres", config->common.users[usr].username, config->common.users[usr].password, true, &ssl, &socket) != AUTH_SUCCESS)
       {
-         pgmoneta_log_error("Fail to send UPLOAD_MANIFEST to server %s", config->common.servers[server].name);
+         pgmoneta_log_info("Invalid credentials for %s", config->common.users[usr].username);
          goto error;
       }
-      manifest_path = pgmoneta_append(NULL, incremental);
-      manifest_path = pgmoneta_append(manifest_path, "data/backup_manifest");
-      if (upload_manifest(ssl, socket, manifest_path))
+
+      pgmoneta_memory_stream_buffer_init(&buffer);
+
+      if (incremental != NULL)
+      {
+         // send UPLOAD_MANIFEST
+         if (send_upload_manifest(ssl, socket))
+         {
+            pgmoneta_log_error("Fail to send UPLOAD_MANIFEST to server %s", config->common.servers[server].name);
+            goto error;
+         }
+         manifest_path = pgmoneta_append(NULL, incremental);
+         manifest_path = pgmoneta_append(manifest_path, "data/backup_manifest");
+         if (upload_manifest(ssl, socket, manifest_path))
+         {
+            pgmoneta_log_error("Fail to upload manifest to server %s", config->common.servers[server].name);
+            goto error;
+         }
+         // receive and ignore the result set for UPLOAD_MANIFEST
+         if (pgmoneta_consume_data_row_messages(server, ssl, socket, buffer, &response))
+         {
+            goto error;
+         }
+         pgmoneta_free_query_response(response);
+         response = NULL;
+      }
+
+      tag = pgmoneta_append(tag, "pgmoneta_");
+      tag = pgmoneta_append(tag, label);
+
+      pgmoneta_create_base_backup_message(config->common.servers[server].version, incremental != NULL, tag, true,
+                                          config->compression_type, config->compression_level,
+                                          pgmoneta_get_compression_workers(server),
+                                          config->manifest_checksum, &basebackup_msg);
+
+      status = pgmoneta_write_message(ssl, socket, basebackup_msg);
+      if (status != MESSAGE_STATUS_OK)
       {
-         pgmoneta_log_error("Fail to upload manifest to server %s", config->common.servers[server].name);
          goto error;
       }
-      // receive and ignore the result set for UPLOAD_MANIFEST
+
+      // Receive the first result set, which contains the WAL starting point
       if (pgmoneta_consume_data_row_messages(server, ssl, socket, buffer, &response))
       {
          goto error;
       }
+      memset(startpos, 0, sizeof(startpos));
+      memcpy(startpos, response->tuples[0].data[0], strlen(response->tuples[0].data[0]));
+      start_timeline = atoi(response->tuples[0].data[1]);
       pgmoneta_free_query_response(response);
       response = NULL;
-   }
-
-   tag = pgmoneta_append(tag, "pgmoneta_");
-   tag = pgmoneta_append(tag, label);
-
-   pgmoneta_create_base_backup_message(config->common.servers[server].version, incremental != NULL, tag, true,
-                                       config->compression_type, config->compression_level,
-                                       &basebackup_msg);
 
-   status = pgmoneta_write_message(ssl, socket, basebackup_msg);
-   if (status != MESSAGE_STATUS_OK)
-   {
-      goto error;
-   }
+      pgmoneta_mkdir(backup_base);
 
-   // Receive the first result set, which contains the WAL starting point
-   if (pgmoneta_consume_data_row_messages(server, ssl, socket, buffer, &response))
-   {
-      goto error;
-   }
-   memset(startpos, 0, sizeof(startpos));
-   memcpy(startpos, response->tuples[0].data[0], strlen(response->tuples[0].data[0]));
-   start_timeline = atoi(response->tuples[0].data[1]);
-   pgmoneta_free_query_response(response);
-   response = NULL;
-
-   pgmoneta_mkdir(backup_base);
-
-   if (config->common.servers[server].version < 15)
-   {
-      if (pgmoneta_receive_archive_files(server, ssl, socket, buffer, backup_base, tablespaces, bucket, network_bucket))
+      if (config->common.servers[server].version < 15)
       {
-         pgmoneta_log_error("Backup: Could not backup %s", config->common.servers[server].name);
-
-         backup->valid = VALID_FALSE;
-         snprintf(backup->label, sizeof(backup->label), "%s", label);
-         if (pgmoneta_save_info(server_backup, backup))
+         if (pgmoneta_receive_archive_files(server, ssl, socket, buffer, backup_base, tablespaces, bucket, network_bucket))
          {
-            pgmoneta_log_error("Backup: Could not save backup %s", label);
+            pgmoneta_log_error("Backup: Could not backup %s", config->common.servers[server].name);
+
+            backup->valid = VALID_FALSE;
+            snprintf(backup->label, sizeof(backup->label), "%s", label);
+            if (pgmoneta_save_info(server_backup, backup))
+            {
+               pgmoneta_log_error("Backup: Could not save backup %s", label);
+               goto error;
+            }
+
             goto error;
          }
-
-         goto error;
       }
-   }
-   else
-   {
-      if (pgmoneta_receive_archive_stream(server, ssl, socket, buffer, backup_base, tablespaces, bucket, network_bucket))
+      else
       {
-         pgmoneta_log_error("Backup: Could not backup %s", config->common.servers[server].name);
+         passthrough = config->compression_passthrough && incremental == NULL && tablespaces == NULL &&
+                       (config->compression_type == COMPRESSION_SERVER_GZIP ||
+                        config->compression_type == COMPRESSION_SERVER_ZSTD ||
+                        config->compression_type == COMPRESSION_SERVER_LZ4);
 
-         backup->valid = VALID_FALSE;
-         snprintf(backup->label, sizeof(backup->label), "%s", label);
-         if (pgmoneta_save_info(server_backup, backup))
+         if (pgmoneta_receive_archive_stream(server, ssl, socket, buffer, backup_base, tablespaces, passthrough, bucket, network_bucket))
          {
-            pgmoneta_log_error("Backup: Could not save backup %s", label);
+            pgmoneta_log_error("Backup: Could not backup %s", config->common.servers[server].name);
+
+            backup->valid = VALID_FALSE;
+            snprintf(backup->label, sizeof(backup->label), "%s", label);
+            if (pgmoneta_save_info(server_backup, backup))
+            {
+               pgmoneta_log_error("Backup: Could not save backup %s", label);
+               goto error;
+            }
+
             goto error;
          }
+      }
 
+      // Receive the final result set, which contains the WAL ending point
+      if (pgmoneta_consume_data_row_messages(server, ssl, socket, buffer, &response))
+      {
          goto error;
       }
-   }
-
-   // Receive the final result set, which contains the WAL ending point
-   if (pgmoneta_consume_data_row_messages(server, ssl, socket, buffer, &response))
-   {
-      goto error;
-   }
-   memset(endpos, 0, sizeof(endpos));
-   memcpy(endpos, response->tuples[0].data[0], strlen(response->tuples[0].data[0]));
-   end_timeline = atoi(response->tuples[0].data[1]);
-   pgmoneta_free_query_response(response);
-   response = NULL;
-
-   // remove backup_label.old if it exists
-   memset(old_label_path, 0, MAX_PATH);
-   if (pgmoneta_ends_with(backup_base, "/"))
-   {
-      snprintf(old_label_path, MAX_PATH, "%sdata/%s", backup_base, "backup_label.old");
-   }
-   else
-   {
-      snprintf(old_label_path, MAX_PATH, "%s/data/%s", backup_base, "backup_label.old");
-   }
+      memset(endpos, 0, sizeof(endpos));
+      memcpy(endpos, response->tuples[0].data[0], strlen(response->tuples[0].data[0]));
+      end_timeline = atoi(response->tuples[0].data[1]);
+      pgmoneta_free_query_response(response);
+      response = NULL;
 
-   if (pgmoneta_exists(old_label_path))
-   {
-      if (pgmoneta_exists(old_label_path))
+      // remove backup_label.old if it exists
+      memset(old_label_path, 0, MAX_PATH);
+      if (pgmoneta_ends_with(backup_base, "/"))
       {
-         pgmoneta_delete_file(old_label_path, NULL);
+         snprintf(old_label_path, MAX_PATH, "%sdata/%s", backup_base, "backup_label.old");
       }
       else
       {
-         pgmoneta_log_debug("%s doesn't exists", old_label_path);
+         snprintf(old_label_path, MAX_PATH, "%s/data/%s", backup_base, "backup_label.old");
       }
-   }
 
-   // receive and ignore the last result set, it's just a summary
-   pgmoneta_consume_data_row_messages(server, ssl, socket, buffer, &response);
+      if (pgmoneta_exists(old_label_path))
+      {
+         if (pgmoneta_exists(old_label_path))
+         {
+            pgmoneta_delete_file(old_label_path, NULL);
+         }
+         else
+         {
+            pgmoneta_log_debug("%s doesn't exists", old_label_path);
+         }
+      }
+
+      // receive and ignore the last result set, it's just a summary
+      pgmoneta_consume_data_row_messages(server, ssl, socket, buffer, &response);
+   }
 
 #ifdef HAVE_FREEBSD
    clock_gettime(CLOCK_MONOTONIC_FAST, &end_t);
@@ -398,7 +487,34 @@ basebackup_execute(char* name __attribute__((unused)), struct art* nodes)
 
    pgmoneta_log_debug("Base: %s/%s (Elapsed: %s)", config->common.servers[server].name, label, &elapsed[0]);
 
-   if (!incremental)
+   if (passthrough)
+   {
+      char backup_label[MAX_PATH];
+
+      // the WAL and checkpoint information is read from the backup_label
+      memset(backup_label, 0, sizeof(backup_label));
+      if (pgmoneta_ends_with(backup_data, "/"))
+      {
+         snprintf(backup_label, sizeof(backup_label), "%sbackup_label", backup_data);
+      }
+      else
+      {
+         snprintf(backup_label, sizeof(backup_label), "%s/backup_label", backup_data);
+      }
+
+      if (pgmoneta_passthrough_extract_file(backup_data, "backup_label", backup_label))
+      {
+         pgmoneta_log_error("Backup: Could not extract backup_label for %s", config->common.servers[server].name);
+         goto error;
+      }
+
+      if (pgmoneta_passthrough_size(backup_data, &passthrough_size, &biggest_file_size))
+      {
+         goto error;
+      }
+      size = passthrough_size;
+   }
+   else if (!incremental)
    {
       size = pgmoneta_directory_size(backup_data);
       biggest_file_size = pgmoneta_biggest_file(backup_data);
@@ -418,6 +534,7 @@ basebackup_execute(char* name __attribute__((unused)), struct art* nodes)
    snprintf(backup->label, sizeof(backup->label), "%s", label);
    backup->number_of_tablespaces = 0;
    backup->compression = config->compression_type;
+   backup->passthrough = passthrough;
    backup->encryption = config->encryption;
    snprintf(backup->wal, sizeof(backup->wal), "%s", wal);
    backup->restore_size = size;
@@ -481,6 +598,8 @@ basebackup_execute(char* name __attribute__((unused)), struct art* nodes)
    pgmoneta_token_bucket_destroy(network_bucket);
    free(manifest_path);
    free(chkptpos);
+   free(start_lsn);
+   free(stop_lsn);
    free(tag);
    free(wal);
 
@@ -513,12 +632,44 @@ error:
    pgmoneta_token_bucket_destroy(network_bucket);
    free(manifest_path);
    free(chkptpos);
+   free(start_lsn);
+   free(stop_lsn);
    free(tag);
    free(wal);
 
    return 1;
 }
 
+static uint64_t
+estimate_backup_size(char* server_backup)
+{
+   int number_of_backups = 0;
+   struct backup** backups = NULL;
+   uint64_t size = 0;
+
+   if (server_backup == NULL || pgmoneta_load_infos(server_backup, &number_of_backups, &backups))
+   {
+      return 0;
+   }
+
+   /* The latest valid backup is the best guess for the size of the next one */
+   for (int i = number_of_backups - 1; size == 0 && i >= 0; i--)
+   {
+      if (backups[i] != NULL && backups[i]->valid == VALID_TRUE)
+      {
+         size = backups[i]->restore_size;
+      }
+   }
+
+   for (int i = 0; i < number_of_backups; i++)
+   {
+      free(backups[i]);
+   }
+   free(backups);
+
+   return size;
+}
+
 static int
 send_upload_manifest(SSL* ssl, int socket)
 {
@@ -578,3 +729,516 @@ error:
    }
    return 1;
 }
+
+static bool
+parallel_backup_supported(int server, SSL* ssl, int socket, char* incremental, struct tablespace* tablespaces)
+{
+   bool supported = false;
+   struct query_response* qr = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   if (config->backup_connections < 2 || incremental != NULL)
+   {
+      return false;
+   }
+
+   if (!config->common.servers[server].has_extension)
+   {
+      pgmoneta_log_debug("Parallel backup: pgmoneta_ext isn't installed on %s", config->common.servers[server].name);
+      return false;
+   }
+
+   if (tablespaces != NULL)
+   {
+      pgmoneta_log_debug("Parallel backup: %s has tablespaces", config->common.servers[server].name);
+      return false;
+   }
+
+   pgmoneta_ext_privilege(ssl, socket, &qr);
+   if (qr != NULL && qr->tuples != NULL && qr->tuples->data != NULL && qr->tuples->data[0] != NULL && qr->tuples->data[0][0] == 't')
+   {
+      supported = true;
+   }
+   else
+   {
+      pgmoneta_log_debug("Parallel backup: %s isn't a superuser on %s", config->common.servers[server].username, config->common.servers[server].name);
+   }
+
+   pgmoneta_free_query_response(qr);
+
+   return supported;
+}
+
+static int
+parallel_backup(int server, int usr, SSL* ssl, int socket, char* label, char* directory,
+                struct token_bucket* bucket, struct token_bucket* network_bucket,
+                char** start_lsn, uint32_t* start_timeline, char** stop_lsn, uint32_t* stop_timeline)
+{
+   int connections;
+   int number_of_entries = 0;
+   int number_of_files = 0;
+   time_t now;
+   struct tm tm;
+   uint64_t system_identifier = 0;
+   uint64_t* totals = NULL;
+   char* tag = NULL;
+   char* path = NULL;
+   char* checksum = NULL;
+   char* label_file = NULL;
+   FILE* file = NULL;
+   struct label_file_contents lf = {0};
+   struct parallel_file* pf = NULL;
+   struct parallel_file** files = NULL;
+   struct parallel_connection** inputs = NULL;
+   struct query_response* qr = NULL;
+   struct tuple* tup = NULL;
+   struct workers* workers = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   connections = config->backup_connections;
+
+   *start_lsn = NULL;
+   *start_timeline = 0;
+   *stop_lsn = NULL;
+   *stop_timeline = 0;
+
+   inputs = (struct parallel_connection**)calloc(connections, sizeof(struct parallel_connection*));
+   totals = (uint64_t*)calloc(connections, sizeof(uint64_t));
+
+   if (inputs == NULL || totals == NULL)
+   {
+      goto error;
+   }
+
+   /* Authentication isn't thread safe, so the connections are opened up front */
+   for (int i = 0; i < connections; i++)
+   {
+      inputs[i] = (struct parallel_connection*)calloc(1, sizeof(struct parallel_connection));
+      if (inputs[i] == NULL)
+      {
+         goto error;
+      }
+
+      inputs[i]->server = server;
+      inputs[i]->socket = -1;
+      inputs[i]->directory = directory;
+      inputs[i]->bucket = bucket;
+      inputs[i]->network_bucket = network_bucket;
+
+      if (pgmoneta_server_authenticate(server, "postgres", config->common.users[usr].username, config->common.users[usr].password,
+                                       false, &inputs[i]->ssl, &inputs[i]->socket) != AUTH_SUCCESS)
+      {
+         pgmoneta_log_error("Parallel backup: Could not open connection %d to %s", i + 1, config->common.servers[server].name);
+         goto error;
+      }
+   }
+
+   tag = pgmoneta_append(tag, "pgmoneta_");
+   tag = pgmoneta_append(tag, label);
+
+   if (pgmoneta_server_system_identifier(server, ssl, socket, &system_identifier))
+   {
+      pgmoneta_log_error("Parallel backup: Could not get the system identifier of %s", config->common.servers[server].name);
+      goto error;
+   }
+
+   /* The backup is bound to this session, and is aborted by the server if it goes away before the stop */
+   if (pgmoneta_server_start_backup(server, ssl, socket, tag, start_lsn))
+   {
+      pgmoneta_log_error("Parallel backup: Could not start the backup on %s", config->common.servers[server].name);
+      goto error;
+   }
+
+   if (pgmoneta_server_data_files(server, ssl, socket, &qr))
+   {
+      pgmoneta_log_error("Parallel backup: Could not list the data directory of %s", config->common.servers[server].name);
+      goto error;
+   }
+
+   for (tup = qr->tuples; tup != NULL; tup = tup->next)
+   {
+      number_of_entries++;
+   }
+
+   /* One more for backup_label */
+   files = (struct parallel_file**)calloc(number_of_entries + 1, sizeof(struct parallel_file*));
+   if (files == NULL)
+   {
+      goto error;
+   }
+
+   for (int i = 0; i < connections; i++)
+   {
+      inputs[i]->files = (struct parallel_file**)calloc(number_of_entries + 1, sizeof(struct parallel_file*));
+      if (inputs[i]->files == NULL)
+      {
+         goto error;
+      }
+   }
+
+   if (pgmoneta_mkdir(directory))
+   {
+      pgmoneta_log_error("Parallel backup: Could not create %s", directory);
+      goto error;
+   }
+
+   /* Directories come first, then the files by descending size */
+   for (tup = qr->tuples; tup != NULL; tup = tup->next)
+   {
+      int least = 0;
+
+      if (tup->data[0] == NULL)
+      {
+         continue;
+      }
+
+      if (tup->data[2] != NULL && tup->data[2][0] == 't')
+      {
+         path = pgmoneta_append(NULL, directory);
+         path = pgmoneta_append(path, tup->data[0]);
+
+         if (pgmoneta_mkdir(path))
+         {
+            pgmoneta_log_error("Parallel backup: Could not create %s", path);
+            goto error;
+         }
+
+         free(path);
+         path = NULL;
+
+         continue;
+      }
+
+      pf = (struct parallel_file*)calloc(1, sizeof(struct parallel_file));
+      if (pf == NULL)
+      {
+         goto error;
+      }
+
+      snprintf(pf->path, sizeof(pf->path), "%s", tup->data[0]);
+      snprintf(pf->last_modified, sizeof(pf->last_modified), "%s", tup->data[3] != NULL ? tup->data[3] : "");
+      pf->size = tup->data[1] != NULL ? strtoull(tup->data[1], NULL, 10) : 0;
+
+      files[number_of_files++] = pf;
+
+      /* Largest files first, each to the connection with the least data */
+      for (int i = 1; i < connections; i++)
+      {
+         if (totals[i] < totals[least])
+         {
+            least = i;
+         }
+      }
+
+      inputs[least]->files[inputs[least]->number_of_files++] = pf;
+      totals[least] += pf->size;
+   }
+
+   pgmoneta_free_query_response(qr);
+   qr = NULL;
+
+   if (pgmoneta_workers_initialize(connections, &workers))
+   {
+      goto error;
+   }
+
+   for (int i = 0; i < connections; i++)
+   {
+      inputs[i]->common.workers = workers;
+      pgmoneta_workers_add(workers, parallel_backup_copy, (struct worker_common*)inputs[i]);
+   }
+
+   pgmoneta_workers_wait(workers);
+
+   if (!workers->outcome)
+   {
+      goto error;
+   }
+
+   pgmoneta_workers_destroy(workers);
+   workers = NULL;
+
+   if (pgmoneta_server_stop_backup(server, ssl, socket, stop_lsn, &label_file, &lf))
+   {
+      pgmoneta_log_error("Parallel backup: Could not stop the backup on %s", config->common.servers[server].name);
+      goto error;
+   }
+
+   /* A non-exclusive backup fails when the timeline changes while it runs */
+   *start_timeline = lf.start_tli;
+   *stop_timeline = lf.start_tli;
+
+   path = pgmoneta_append(NULL, directory);
+   path = pgmoneta_append(path, "backup_label");
+
+   file = fopen(path, "wb");
+   if (file == NULL)
+   {
+      pgmoneta_log_error("Parallel backup: Could not create %s", path);
+      goto error;
+   }
+
+   if (fputs(label_file, file) == EOF || fflush(file))
+   {
+      pgmoneta_log_error("Parallel backup: Could not write %s", path);
+      goto error;
+   }
+
+   fclose(file);
+   file = NULL;
+
+   if (pgmoneta_create_checksum_file(path, pgmoneta_manifest_checksum_name(config->manifest_checksum), &checksum))
+   {
+      goto error;
+   }
+
+   pf = (struct parallel_file*)calloc(1, sizeof(struct parallel_file));
+   if (pf == NULL)
+   {
+      goto error;
+   }
+
+   now = time(NULL);
+   gmtime_r(&now, &tm);
+
+   snprintf(pf->path, sizeof(pf->path), "%s", "backup_label");
+   strftime(pf->last_modified, sizeof(pf->last_modified), "%Y-%m-%d %H:%M:%S GMT", &tm);
+   snprintf(pf->checksum, sizeof(pf->checksum), "%s", checksum);
+   pf->size = strlen(label_file);
+   pf->exists = true;
+
+   files[number_of_files++] = pf;
+
+   if (parallel_backup_manifest(server, directory, system_identifier, number_of_files, files,
+                                *start_lsn, *start_timeline, *stop_lsn))
+   {
+      goto error;
+   }
+
+   for (int i = 0; i < connections; i++)
+   {
+      pgmoneta_close_ssl(inputs[i]->ssl);
+      if (inputs[i]->socket != -1)
+      {
+         pgmoneta_disconnect(inputs[i]->socket);
+      }
+      free(inputs[i]->files);
+      free(inputs[i]);
+   }
+
+   for (int i = 0; i < number_of_files; i++)
+   {
+      free(files[i]);
+   }
+
+   pgmoneta_free_query_response(qr);
+   free(inputs);
+   free(files);
+   free(totals);
+   free(checksum);
+   free(label_file);
+   free(path);
+   free(tag);
+
+   return 0;
+
+error:
+
+   pgmoneta_workers_wait(workers);
+   pgmoneta_workers_destroy(workers);
+
+   if (file != NULL)
+   {
+      fclose(file);
+   }
+
+   if (inputs != NULL)
+   {
+      for (int i = 0; i < connections; i++)
+      {
+         if (inputs[i] != NULL)
+         {
+            pgmoneta_close_ssl(inputs[i]->ssl);
+            if (inputs[i]->socket != -1)
+            {
+               pgmoneta_disconnect(inputs[i]->socket);
+            }
+            free(inputs[i]->files);
+            free(inputs[i]);
+         }
+      }
+   }
+
+   for (int i = 0; i < number_of_files; i++)
+   {
+      free(files[i]);
+   }
+
+   pgmoneta_free_query_response(qr);
+   free(inputs);
+   free(files);
+   free(totals);
+   free(checksum);
+   free(label_file);
+   free(path);
+   free(tag);
+
+   return 1;
+}
+
+static void
+parallel_backup_copy(struct worker_common* wc)
+{
+   struct parallel_connection* pc = (struct parallel_connection*)wc;
+
+   pgmoneta_memory_init();
+
+   for (int i = 0; i < pc->number_of_files; i++)
+   {
+      if (!wc->workers->outcome)
+      {
+         break;
+      }
+
+      if (parallel_backup_copy_file(pc, pc->files[i]))
+      {
+         pgmoneta_log_error("Parallel backup: Could not copy %s", pc->files[i]->path);
+         wc->workers->outcome = false;
+         break;
+      }
+   }
+
+   pgmoneta_memory_destroy();
+}
+
+static int
+parallel_backup_copy_file(struct parallel_connection* pc, struct parallel_file* pf)
+{
+   bool exists = false;
+   uint64_t size = 0;
+   char* path = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   path = pgmoneta_append(NULL, pc->directory);
+   path = pgmoneta_append(path, pf->path);
+
+   if (pgmoneta_receive_file(pc->server, pc->ssl, pc->socket, pf->path, path, pc->bucket, pc->network_bucket,
+                             &exists, &size, pgmoneta_manifest_checksum_name(config->manifest_checksum),
+                             pf->checksum))
+   {
+      goto error;
+   }
+
+   if (!exists)
+   {
+      /* Removed since it was listed, so it is left out like BASE_BACKUP does */
+      pgmoneta_log_debug("Parallel backup: %s was removed", pf->path);
+   }
+
+   pf->size = size;
+   pf->exists = exists;
+
+   pgmoneta_job_progress(size, 1);
+   pgmoneta_instrument_files(1);
+
+   free(path);
+
+   return 0;
+
+error:
+   free(path);
+
+   return 1;
+}
+
+static int
+parallel_backup_manifest(int server, char* directory, uint64_t system_identifier,
+                         int number_of_files, struct parallel_file** files,
+                         char* start_lsn, uint32_t timeline, char* stop_lsn)
+{
+   char* path = NULL;
+   struct json* manifest = NULL;
+   struct json* entries = NULL;
+   struct json* wal_ranges = NULL;
+   struct json* entry = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   if (pgmoneta_json_create(&manifest) || pgmoneta_json_create(&entries) || pgmoneta_json_create(&wal_ranges))
+   {
+      goto error;
+   }
+
+   for (int i = 0; i < number_of_files; i++)
+   {
+      if (!files[i]->exists)
+      {
+         continue;
+      }
+
+      if (pgmoneta_json_create(&entry))
+      {
+         goto error;
+      }
+
+      pgmoneta_json_put(entry, "Path", (uintptr_t)files[i]->path, ValueString);
+      pgmoneta_json_put(entry, "Size", (uintptr_t)files[i]->size, ValueUInt64);
+      pgmoneta_json_put(entry, "Last-Modified", (uintptr_t)files[i]->last_modified, ValueString);
+      pgmoneta_json_put(entry, "Checksum-Algorithm", (uintptr_t)pgmoneta_manifest_checksum_name(config->manifest_checksum), ValueString);
+      pgmoneta_json_put(entry, "Checksum", (uintptr_t)files[i]->checksum, ValueString);
+
+      pgmoneta_json_append(entries, (uintptr_t)entry, ValueJSON);
+      entry = NULL;
+   }
+
+   if (pgmoneta_json_create(&entry))
+   {
+      goto error;
+   }
+
+   pgmoneta_json_put(entry, "Timeline", (uintptr_t)timeline, ValueInt32);
+   pgmoneta_json_put(entry, "Start-LSN", (uintptr_t)start_lsn, ValueString);
+   pgmoneta_json_put(entry, "End-LSN", (uintptr_t)stop_lsn, ValueString);
+
+   pgmoneta_json_append(wal_ranges, (uintptr_t)entry, ValueJSON);
+   entry = NULL;
+
+   pgmoneta_json_put(manifest, MANIFEST_KEY_VERSION, (uintptr_t)(config->common.servers[server].version >= 17 ? 2 : 1), ValueInt32);
+   pgmoneta_json_put(manifest, MANIFEST_KEY_SYS_IDENTIFIER, (uintptr_t)system_identifier, ValueUInt64);
+   pgmoneta_json_put(manifest, MANIFEST_KEY_FILES, (uintptr_t)entries, ValueJSON);
+   entries = NULL;
+   pgmoneta_json_put(manifest, MANIFEST_KEY_WAL_RANGES, (uintptr_t)wal_ranges, ValueJSON);
+   wal_ranges = NULL;
+   pgmoneta_json_put(manifest, MANIFEST_KEY_CHECKSUM, (uintptr_t)"", ValueString);
+
+   path = pgmoneta_append(NULL, directory);
+   path = pgmoneta_append(path, "backup_manifest");
+
+   if (pgmoneta_write_postgresql_manifest(manifest, path))
+   {
+      pgmoneta_log_error("Parallel backup: Could not write %s", path);
+      goto error;
+   }
+
+   pgmoneta_json_destroy(manifest);
+   free(path);
+
+   return 0;
+
+error:
+
+   pgmoneta_json_destroy(entry);
+   pgmoneta_json_destroy(entries);
+   pgmoneta_json_destroy(wal_ranges);
+   pgmoneta_json_destroy(manifest);
+   free(path);
+
+   return 1;
+}
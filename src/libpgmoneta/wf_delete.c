@@ -31,6 +31,8 @@
 #include <pgmoneta.h>
 #include <art.h>
 #include <backup.h>
+#include <catalog.h>
+#include <delete.h>
 #include <link.h>
 #include <logging.h>
 #include <management.h>
@@ -318,7 +320,7 @@ delete_backup(int server, int index, struct backup* backup __attribute__((unused
          pgmoneta_workers_destroy(workers);
 
          /* Delete from */
-         pgmoneta_delete_directory(d);
+         pgmoneta_move_to_trash(server, d);
          free(d);
          d = NULL;
 
@@ -352,7 +354,7 @@ delete_backup(int server, int index, struct backup* backup __attribute__((unused
       else if (prev_index != -1)
       {
          /* Latest valid backup */
-         pgmoneta_delete_directory(d);
+         pgmoneta_move_to_trash(server, d);
       }
       else if (next_index != -1)
       {
@@ -372,7 +374,7 @@ delete_backup(int server, int index, struct backup* backup __attribute__((unused
          pgmoneta_workers_destroy(workers);
 
          /* Delete from */
-         pgmoneta_delete_directory(d);
+         pgmoneta_move_to_trash(server, d);
          free(d);
          d = NULL;
 
@@ -406,15 +408,18 @@ delete_backup(int server, int index, struct backup* backup __attribute__((unused
       else
       {
          /* Only valid backup */
-         pgmoneta_delete_directory(d);
+         pgmoneta_move_to_trash(server, d);
       }
    }
    else
    {
       /* Just delete */
-      pgmoneta_delete_directory(d);
+      pgmoneta_move_to_trash(server, d);
    }
 
+   /* The files are removed from the trash after the repository lock is released */
+   pgmoneta_catalog_remove(server, backups[index]->label);
+
    free(temp_backup);
    free(backup_dir);
    free(d);
@@ -158,7 +158,7 @@ extra_execute(char* name __attribute__((unused)), struct art* nodes)
 
    for (int i = 0; i < config->common.servers[server].number_of_extra; i++)
    {
-      if (pgmoneta_receive_extra_files(ssl, socket, config->common.servers[server].name, config->common.servers[server].extra[i], root, &info_extra) != 0)
+      if (pgmoneta_receive_extra_files(server, ssl, socket, config->common.servers[server].name, config->common.servers[server].extra[i], root, &info_extra) != 0)
       {
          pgmoneta_log_warn("extra failed: Server %s failed to retrieve extra files %s", config->common.servers[server].name, config->common.servers[server].extra[i]);
       }
@@ -31,17 +31,20 @@
 #include <art.h>
 #include <logging.h>
 #include <manifest.h>
+#include <passthrough.h>
 #include <restore.h>
 #include <utils.h>
 #include <workflow.h>
 
 /* system */
 #include <assert.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 static char* hot_standby_name(void);
 static int hot_standby_execute(char*, struct art*);
+static bool hot_standby_is_parent(char* destination, char* label, int number_of_backups, struct backup** backups);
 
 struct workflow*
 pgmoneta_create_hot_standby(void)
@@ -137,6 +140,7 @@ hot_standby_execute(char* name __attribute__((unused)), struct art* nodes)
          struct art* added_files = NULL;
          struct art_iterator* added_iter = NULL;
          bool error = false;
+         bool refresh = false;
 
          root = pgmoneta_append(root, config->common.servers[server].hot_standby[i]);
          if (!pgmoneta_ends_with(root, "/"))
@@ -218,63 +222,109 @@ hot_standby_execute(char* name __attribute__((unused)), struct art* nodes)
                f = NULL;
             }
 
-            while (pgmoneta_art_iterator_next(changed_iter))
+            if (backups[number_of_backups - 1]->passthrough)
             {
                from = pgmoneta_append(from, source);
-               if (!pgmoneta_ends_with(from, "/"))
-               {
-                  from = pgmoneta_append_char(from, '/');
-               }
                from = pgmoneta_append(from, "data/");
-               from = pgmoneta_append(from, changed_iter->key);
 
-               to = pgmoneta_append(to, destination);
-               if (!pgmoneta_ends_with(to, "/"))
+               pgmoneta_log_trace("hot_standby passthrough: %s -> %s", from, destination);
+
+               if ((changed_files != NULL && pgmoneta_passthrough_extract(from, changed_files, destination)) ||
+                   (added_files != NULL && pgmoneta_passthrough_extract(from, added_files, destination)))
                {
-                  to = pgmoneta_append_char(to, '/');
+                  free(from);
+                  from = NULL;
+                  error = true;
+                  goto cleanup;
                }
-               to = pgmoneta_append(to, changed_iter->key);
-
-               pgmoneta_log_trace("hot_standby changed: %s -> %s", from, to);
-
-               pgmoneta_copy_file(from, to, workers);
 
                free(from);
                from = NULL;
-
-               free(to);
-               to = NULL;
             }
-
-            while (pgmoneta_art_iterator_next(added_iter))
+            else
             {
-               from = pgmoneta_append(from, source);
-               if (!pgmoneta_ends_with(from, "/"))
+               while (pgmoneta_art_iterator_next(changed_iter))
                {
-                  from = pgmoneta_append_char(from, '/');
+                  from = pgmoneta_append(from, source);
+                  if (!pgmoneta_ends_with(from, "/"))
+                  {
+                     from = pgmoneta_append_char(from, '/');
+                  }
+                  from = pgmoneta_append(from, "data/");
+                  from = pgmoneta_append(from, changed_iter->key);
+
+                  to = pgmoneta_append(to, destination);
+                  if (!pgmoneta_ends_with(to, "/"))
+                  {
+                     to = pgmoneta_append_char(to, '/');
+                  }
+                  to = pgmoneta_append(to, changed_iter->key);
+
+                  pgmoneta_log_trace("hot_standby changed: %s -> %s", from, to);
+
+                  pgmoneta_copy_file(from, to, workers);
+
+                  free(from);
+                  from = NULL;
+
+                  free(to);
+                  to = NULL;
                }
-               from = pgmoneta_append(from, "data/");
-               from = pgmoneta_append(from, added_iter->key);
 
-               to = pgmoneta_append(to, destination);
-               if (!pgmoneta_ends_with(to, "/"))
+               while (pgmoneta_art_iterator_next(added_iter))
                {
-                  to = pgmoneta_append_char(to, '/');
+                  from = pgmoneta_append(from, source);
+                  if (!pgmoneta_ends_with(from, "/"))
+                  {
+                     from = pgmoneta_append_char(from, '/');
+                  }
+                  from = pgmoneta_append(from, "data/");
+                  from = pgmoneta_append(from, added_iter->key);
+
+                  to = pgmoneta_append(to, destination);
+                  if (!pgmoneta_ends_with(to, "/"))
+                  {
+                     to = pgmoneta_append_char(to, '/');
+                  }
+                  to = pgmoneta_append(to, added_iter->key);
+
+                  pgmoneta_log_trace("hot_standby new: %s -> %s", from, to);
+
+                  pgmoneta_copy_file(from, to, workers);
+
+                  free(from);
+                  from = NULL;
+
+                  free(to);
+                  to = NULL;
                }
-               to = pgmoneta_append(to, added_iter->key);
-
-               pgmoneta_log_trace("hot_standby new: %s -> %s", from, to);
-
-               pgmoneta_copy_file(from, to, workers);
+            }
+         }
+         else if (incremental && hot_standby_is_parent(destination, label, number_of_backups, backups))
+         {
+            /* the directory holds the parent, so only the changed blocks are written */
+            if (number_of_workers > 0 && workers == NULL)
+            {
+               pgmoneta_workers_initialize(number_of_workers, &workers);
+            }
 
-               free(from);
-               from = NULL;
+            if (pgmoneta_apply_incremental_backup(server, label, destination, workers))
+            {
+               pgmoneta_log_warn("Hotstandby: Unable to apply backup %s to %s, doing a full copy", label, destination);
 
-               free(to);
-               to = NULL;
+               if (workers != NULL)
+               {
+                  workers->outcome = true;
+               }
+               refresh = false;
+            }
+            else
+            {
+               refresh = true;
             }
          }
-         else
+
+         if (!refresh && (incremental || !pgmoneta_exists(destination) || number_of_backups < 2))
          {
             /* incremental or  number of backups < 2 */
             if (incremental && source == NULL)
@@ -306,9 +356,20 @@ hot_standby_execute(char* name __attribute__((unused)), struct art* nodes)
             pgmoneta_mkdir(root);
             pgmoneta_mkdir(destination);
 
-            pgmoneta_copy_postgresql_hotstandby(server, source, destination,
-                                                config->common.servers[server].hot_standby_tablespaces[i],
-                                                backups[number_of_backups - 1], workers);
+            if (!incremental && backups[number_of_backups - 1]->passthrough)
+            {
+               if (pgmoneta_passthrough_extract(source, NULL, destination))
+               {
+                  error = true;
+                  goto cleanup;
+               }
+            }
+            else
+            {
+               pgmoneta_copy_postgresql_hotstandby(server, source, destination,
+                                                   config->common.servers[server].hot_standby_tablespaces[i],
+                                                   backups[number_of_backups - 1], workers);
+            }
          }
          pgmoneta_log_debug("hot_standby source:      %s", source);
          pgmoneta_log_debug("hot_standby destination: %s", destination);
@@ -392,6 +453,8 @@ cleanup:
       free(source_root);
    }
 
+   pgmoneta_disk_usage_refresh(server, DISK_USAGE_HOT_STANDBY);
+
    free(base);
    free(source);
    for (int i = 0; i < number_of_backups; i++)
@@ -402,3 +465,77 @@ cleanup:
 
    return failed_count;
 }
+
+static bool
+hot_standby_is_parent(char* destination, char* label, int number_of_backups, struct backup** backups)
+{
+   char* backup_label = NULL;
+   char line[MISC_LENGTH];
+   uint32_t hi = 0;
+   uint32_t lo = 0;
+   bool found = false;
+   struct backup* backup = NULL;
+   struct backup* parent = NULL;
+   FILE* file = NULL;
+
+   for (int i = 0; i < number_of_backups; i++)
+   {
+      if (!strcmp(backups[i]->label, label))
+      {
+         backup = backups[i];
+      }
+   }
+
+   if (backup == NULL)
+   {
+      goto error;
+   }
+
+   for (int i = 0; i < number_of_backups; i++)
+   {
+      if (!strcmp(backups[i]->label, backup->parent_label))
+      {
+         parent = backups[i];
+      }
+   }
+
+   // Tablespaces are linked outside of the directory, so they are always copied
+   if (parent == NULL || backup->number_of_tablespaces > 0 || parent->number_of_tablespaces > 0)
+   {
+      goto error;
+   }
+
+   backup_label = pgmoneta_append(backup_label, destination);
+   if (!pgmoneta_ends_with(backup_label, "/"))
+   {
+      backup_label = pgmoneta_append_char(backup_label, '/');
+   }
+   backup_label = pgmoneta_append(backup_label, "backup_label");
+
+   file = fopen(backup_label, "r");
+   if (file == NULL)
+   {
+      goto error;
+   }
+
+   memset(line, 0, sizeof(line));
+   while (fgets(line, sizeof(line), file) != NULL)
+   {
+      if (sscanf(line, "START WAL LOCATION: %X/%X", &hi, &lo) == 2)
+      {
+         found = true;
+         break;
+      }
+      memset(line, 0, sizeof(line));
+   }
+
+   fclose(file);
+   free(backup_label);
+
+   return found && hi == parent->start_lsn_hi32 && lo == parent->start_lsn_lo32;
+
+error:
+   free(backup_label);
+
+   return false;
+}
@@ -139,7 +139,9 @@ link_execute(char* name __attribute__((unused)), struct art* nodes)
       }
       for (int j = index - 1; j >= 0 && next_newest == -1; j--)
       {
+         // passthrough archives have no files to link
          if (pgmoneta_is_backup_struct_valid(server, backups[j]) &&
+             !backups[index]->passthrough && !backups[j]->passthrough &&
              backups[j]->major_version == backups[number_of_backups - 1]->major_version)
          {
             if (next_newest == -1)
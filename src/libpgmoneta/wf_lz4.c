@@ -128,7 +128,11 @@ lz4_execute_compress(char* name __attribute__((unused)), struct art* nodes)
    clock_gettime(CLOCK_MONOTONIC_RAW, &start_t);
 #endif
 
-   if (tarfile == NULL)
+   if (tarfile == NULL && backup->passthrough)
+   {
+      pgmoneta_log_debug("LZ4 (compress): %s/%s is kept as the server side compressed archive", config->common.servers[server].name, label);
+   }
+   else if (tarfile == NULL)
    {
       number_of_workers = pgmoneta_get_number_of_workers(server);
       if (number_of_workers > 0)
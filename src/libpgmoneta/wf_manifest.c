@@ -86,6 +86,7 @@ manifest_execute(char* name __attribute__((unused)), struct art* nodes)
    struct json* entry = NULL;
    struct csv_writer* writer = NULL;
    char file_path[MAX_PATH];
+   char* checksum = NULL;
    char* info[MANIFEST_COLUMN_COUNT];
    struct main_configuration* config;
 
@@ -153,9 +154,14 @@ manifest_execute(char* name __attribute__((unused)), struct art* nodes)
    {
       memset(file_path, 0, MAX_PATH);
       snprintf(file_path, MAX_PATH, "%s", (char*)pgmoneta_json_get(entry, "Path"));
+      checksum = pgmoneta_manifest_checksum_entry((char*)pgmoneta_json_get(entry, "Checksum-Algorithm"),
+                                                  (char*)pgmoneta_json_get(entry, "Checksum"),
+                                                  (uint64_t)pgmoneta_json_get(entry, "Size"));
       info[MANIFEST_PATH_INDEX] = file_path;
-      info[MANIFEST_CHECKSUM_INDEX] = (char*)pgmoneta_json_get(entry, "Checksum");
+      info[MANIFEST_CHECKSUM_INDEX] = checksum;
       pgmoneta_csv_write(writer, MANIFEST_COLUMN_COUNT, info);
+      free(checksum);
+      checksum = NULL;
       pgmoneta_json_destroy(entry);
       entry = NULL;
    }
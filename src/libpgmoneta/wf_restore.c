@@ -29,9 +29,12 @@
 /* pgmoneta */
 #include "art.h"
 #include <pgmoneta.h>
+#include <job.h>
 #include <logging.h>
 #include <restore.h>
 #include <utils.h>
+#include <wal.h>
+#include <walfetch.h>
 #include <workflow.h>
 
 /* system */
@@ -58,6 +61,7 @@ static int restore_excluded_files_teardown(char*, struct art*);
 
 static char* get_user_password(char* username);
 static void create_standby_signal(char* basedir);
+static bool is_wal_fetch(struct art* nodes);
 
 struct workflow*
 pgmoneta_create_restore(void)
@@ -211,6 +215,8 @@ restore_execute(char* name __attribute__((unused)), struct art* nodes)
 
    pgmoneta_delete_directory(to);
 
+   pgmoneta_job_total(backup->restore_size, 0);
+
    number_of_workers = pgmoneta_get_number_of_workers(server);
    if (number_of_workers > 0)
    {
@@ -375,6 +381,7 @@ recovery_info_execute(char* name __attribute__((unused)), struct art* nodes)
    FILE* tfile = NULL;
    char* path = NULL;
    bool mode = false;
+   bool wal_fetch = false;
    char* ptr = NULL;
    struct main_configuration* config;
 
@@ -405,6 +412,8 @@ recovery_info_execute(char* name __attribute__((unused)), struct art* nodes)
       primary = (bool)pgmoneta_art_search(nodes, NODE_PRIMARY);
    }
 
+   wal_fetch = is_wal_fetch(nodes);
+
    pgmoneta_log_debug("Recovery (execute): %s/%s", config->common.servers[server].name, label);
 
    if (!is_recovery_info)
@@ -449,7 +458,8 @@ recovery_info_execute(char* name __attribute__((unused)), struct art* nodes)
             if (pgmoneta_starts_with(&buffer[0], "standby_mode") ||
                 pgmoneta_starts_with(&buffer[0], "recovery_target") ||
                 pgmoneta_starts_with(&buffer[0], "primary_conninfo") ||
-                pgmoneta_starts_with(&buffer[0], "primary_slot_name"))
+                pgmoneta_starts_with(&buffer[0], "primary_slot_name") ||
+                (wal_fetch && pgmoneta_starts_with(&buffer[0], "restore_command")))
             {
                memset(&line[0], 0, sizeof(line));
                snprintf(&line[0], sizeof(line), "#%s", &buffer[0]);
@@ -489,6 +499,17 @@ recovery_info_execute(char* name __attribute__((unused)), struct art* nodes)
          snprintf(&line[0], sizeof(line), "primary_slot_name = \'%s\'\n", config->common.servers[server].wal_slot);
          fputs(&line[0], tfile);
 
+         if (wal_fetch)
+         {
+            char* cmd = pgmoneta_wal_fetch_command(server);
+
+            memset(&line[0], 0, sizeof(line));
+            snprintf(&line[0], sizeof(line), "restore_command = \'%s\'\n", cmd);
+            fputs(&line[0], tfile);
+
+            free(cmd);
+         }
+
          ptr = strtok(&tokens[0], ",");
 
          while (ptr != NULL)
@@ -724,7 +745,9 @@ copy_wal_execute(char* name __attribute__((unused)), struct art* nodes)
    bool copy_wal = false;
    int server = 0;
    char* label = NULL;
+   char* position = NULL;
    struct backup* backup = NULL;
+   struct wal_range* range = NULL;
    int number_of_workers = 0;
    struct workers* workers = NULL;
    struct main_configuration* config;
@@ -745,16 +768,26 @@ copy_wal_execute(char* name __attribute__((unused)), struct art* nodes)
       return 0;
    }
 
-   number_of_workers = pgmoneta_get_number_of_workers(server);
-   if (number_of_workers > 0)
+   /* The recovery fetches its WAL through restore_command */
+   if (is_wal_fetch(nodes))
    {
-      pgmoneta_workers_initialize(number_of_workers, &workers);
+      return 0;
    }
 
    server = (int)pgmoneta_art_search(nodes, NODE_SERVER_ID);
    label = (char*) pgmoneta_art_search(nodes, NODE_LABEL);
    directory = (char*)pgmoneta_art_search(nodes, NODE_TARGET_ROOT);
    backup = (struct backup*)pgmoneta_art_search(nodes, NODE_BACKUP);
+   if (pgmoneta_art_contains_key(nodes, USER_POSITION))
+   {
+      position = (char*)pgmoneta_art_search(nodes, USER_POSITION);
+   }
+
+   number_of_workers = pgmoneta_get_number_of_workers(server);
+   if (number_of_workers > 0)
+   {
+      pgmoneta_workers_initialize(number_of_workers, &workers);
+   }
 
    origwal = pgmoneta_get_server_backup_identifier_data_wal(server, label);
    waldir = pgmoneta_get_server_wal(server);
@@ -766,7 +799,16 @@ copy_wal_execute(char* name __attribute__((unused)), struct art* nodes)
    waltarget = pgmoneta_append(waltarget, label);
    waltarget = pgmoneta_append(waltarget, "/pg_wal/");
 
-   pgmoneta_copy_wal_files(waldir, waltarget, &backup->wal[0], workers);
+   /* Only the segments the recovery target can reach */
+   if (pgmoneta_wal_recovery_range(server, backup, position, &range))
+   {
+      goto error;
+   }
+
+   if (pgmoneta_copy_wal_files(waldir, waltarget, &backup->wal[0], range, workers))
+   {
+      goto error;
+   }
 
    pgmoneta_workers_wait(workers);
    if (workers != NULL && !workers->outcome)
@@ -775,6 +817,7 @@ copy_wal_execute(char* name __attribute__((unused)), struct art* nodes)
    }
    pgmoneta_workers_destroy(workers);
 
+   pgmoneta_free_wal_range(range);
    free(origwal);
    free(waldir);
    free(waltarget);
@@ -783,8 +826,10 @@ copy_wal_execute(char* name __attribute__((unused)), struct art* nodes)
 error:
    if (number_of_workers > 0)
    {
+      pgmoneta_workers_wait(workers);
       pgmoneta_workers_destroy(workers);
    }
+   pgmoneta_free_wal_range(range);
    free(origwal);
    free(waldir);
    free(waltarget);
@@ -823,13 +868,19 @@ restore_excluded_files_execute(char* name __attribute__((unused)), struct art* n
 
    pgmoneta_log_debug("Excluded (execute): %s/%s", config->common.servers[server].name, identifier);
 
+   backup = (struct backup*)pgmoneta_art_search(nodes, NODE_BACKUP);
+
+   if (backup->passthrough)
+   {
+      // the excluded files were extracted together with the rest of the archive
+      return 0;
+   }
+
    if (pgmoneta_get_restore_last_files_names(&restore_last_files_names))
    {
       goto error;
    }
 
-   backup = (struct backup*)pgmoneta_art_search(nodes, NODE_BACKUP);
-
    switch (backup->compression)
    {
       case COMPRESSION_CLIENT_GZIP:
@@ -1097,6 +1148,32 @@ get_user_password(char* username)
    return NULL;
 }
 
+static bool
+is_wal_fetch(struct art* nodes)
+{
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   /* restore_command is only set up when the recovery configuration is written */
+   if (!config->wal_fetch)
+   {
+      return false;
+   }
+
+   if (!pgmoneta_art_contains_key(nodes, NODE_RECOVERY_INFO) || !(bool)pgmoneta_art_search(nodes, NODE_RECOVERY_INFO))
+   {
+      return false;
+   }
+
+   if (!pgmoneta_art_contains_key(nodes, NODE_PRIMARY) || (bool)pgmoneta_art_search(nodes, NODE_PRIMARY))
+   {
+      return false;
+   }
+
+   return pgmoneta_art_contains_key(nodes, USER_POSITION) && pgmoneta_art_search(nodes, USER_POSITION) != 0;
+}
+
 static void
 create_standby_signal(char* basedir)
 {
@@ -28,25 +28,40 @@
 
 /* pgmoneta */
 #include <pgmoneta.h>
+#include <deque.h>
 #include <logging.h>
 #include <security.h>
-#include <string.h>
 #include <utils.h>
+#include <value.h>
 #include <verify.h>
+#include <workers.h>
 #include <workflow.h>
 
 /* system */
 #include <assert.h>
 #include <dirent.h>
 #include <errno.h>
+#include <string.h>
 #include <unistd.h>
 
+/** @struct sha512_input
+ * Defines the input of a SHA512 task
+ */
+struct sha512_input
+{
+   struct worker_common common; /**< The common base */
+   char path[MAX_PATH];         /**< The absolute file path */
+   bool with_sha256;            /**< Also calculate the SHA256 hash */
+   char* sha256;                /**< The resulting SHA256 hash */
+   char* sha512;                /**< The resulting hash */
+};
+
 static char* sha512_name(void);
 static int sha512_execute(char*, struct art*);
 
-static int write_backup_sha512(char* root, char* relative_path);
-
-static FILE* sha512_file = NULL;
+static int write_backup_sha512(char* root, char* relative_path, bool sha256, struct deque* files, struct workers* workers);
+static void do_sha512(struct worker_common* wc);
+static void sha512_input_destroy(uintptr_t data);
 
 struct workflow*
 pgmoneta_create_sha512(void)
@@ -74,10 +89,20 @@ static int
 sha512_execute(char* name __attribute__((unused)), struct art* nodes)
 {
    int server = -1;
+   int number_of_workers = 0;
    char* label = NULL;
    char* root = NULL;
    char* d = NULL;
    char* sha512_path = NULL;
+   char* sha256_path = NULL;
+   char* tag = NULL;
+   bool sha256 = false;
+   FILE* sha512_file = NULL;
+   FILE* sha256_file = NULL;
+   struct deque* files = NULL;
+   struct deque_iterator* iter = NULL;
+   struct sha512_input* si = NULL;
+   struct workers* workers = NULL;
    struct main_configuration* config;
 
    config = (struct main_configuration*)shmem;
@@ -105,18 +130,95 @@ sha512_execute(char* name __attribute__((unused)), struct art* nodes)
       goto error;
    }
 
+   /* The remote storage engines need SHA256 of the data files, which is done in the same read */
+   sha256 = config->storage_engine & (STORAGE_ENGINE_SSH | STORAGE_ENGINE_S3 | STORAGE_ENGINE_AZURE);
+   if (sha256)
+   {
+      sha256_path = pgmoneta_append(sha256_path, root);
+      sha256_path = pgmoneta_append(sha256_path, "backup.sha256");
+
+      sha256_file = fopen(sha256_path, "w");
+      if (sha256_file == NULL)
+      {
+         goto error;
+      }
+   }
+
    d = pgmoneta_get_server_backup_identifier_data(server, label);
 
-   if (write_backup_sha512(root, ""))
+   if (pgmoneta_deque_create(false, &files))
+   {
+      goto error;
+   }
+
+   number_of_workers = pgmoneta_get_number_of_workers(server);
+   if (number_of_workers > 0)
+   {
+      pgmoneta_workers_initialize(number_of_workers, &workers);
+   }
+
+   if (write_backup_sha512(root, "", sha256, files, workers))
    {
       goto error;
    }
 
+   pgmoneta_workers_wait(workers);
+   if (workers != NULL && !workers->outcome)
+   {
+      goto error;
+   }
+
+   /* Hashes are calculated out of order, so write them sorted by path */
+   pgmoneta_deque_sort(files);
+
+   if (pgmoneta_deque_iterator_create(files, &iter))
+   {
+      goto error;
+   }
+
+   while (pgmoneta_deque_iterator_next(iter))
+   {
+      tag = iter->tag;
+      si = (struct sha512_input*)iter->value->data;
+
+      if (si->sha512 == NULL)
+      {
+         pgmoneta_log_error("SHA512: Could not create hash for %s", si->path);
+         goto error;
+      }
+
+      fprintf(sha512_file, "%s *.%s\n", si->sha512, tag);
+
+      if (si->with_sha256)
+      {
+         if (si->sha256 == NULL)
+         {
+            pgmoneta_log_error("SHA256: Could not create hash for %s", si->path);
+            goto error;
+         }
+
+         fprintf(sha256_file, "%s:%s\n", tag + strlen("/data"), si->sha256);
+      }
+   }
+
+   pgmoneta_deque_iterator_destroy(iter);
+   iter = NULL;
+
    pgmoneta_permission(sha512_path, 6, 0, 0);
 
    fclose(sha512_file);
 
+   if (sha256_file != NULL)
+   {
+      pgmoneta_permission(sha256_path, 6, 0, 0);
+      fclose(sha256_file);
+   }
+
+   pgmoneta_workers_destroy(workers);
+   pgmoneta_deque_destroy(files);
+
    free(sha512_path);
+   free(sha256_path);
    free(root);
    free(d);
 
@@ -129,7 +231,19 @@ error:
       fclose(sha512_file);
    }
 
+   if (sha256_file != NULL)
+   {
+      fclose(sha256_file);
+   }
+
+   pgmoneta_workers_wait(workers);
+   pgmoneta_workers_destroy(workers);
+
+   pgmoneta_deque_iterator_destroy(iter);
+   pgmoneta_deque_destroy(files);
+
    free(sha512_path);
+   free(sha256_path);
    free(root);
    free(d);
 
@@ -137,13 +251,12 @@ error:
 }
 
 static int
-write_backup_sha512(char* root, char* relative_path)
+write_backup_sha512(char* root, char* relative_path, bool sha256, struct deque* files, struct workers* workers)
 {
    char* dir_path = NULL;
    char* relative_file_path;
-   char* absolute_file_path;
-   char* buffer;
-   char* sha512;
+   struct sha512_input* si = NULL;
+   struct value_config vc = {0};
    DIR* dir;
    struct dirent* entry;
 
@@ -155,6 +268,8 @@ write_backup_sha512(char* root, char* relative_path)
       goto error;
    }
 
+   vc.destroy_data = &sha512_input_destroy;
+
    while ((entry = readdir(dir)) != NULL)
    {
       char relative_dir[1024];
@@ -168,36 +283,44 @@ write_backup_sha512(char* root, char* relative_path)
 
          snprintf(relative_dir, sizeof(relative_dir), "%s/%s", relative_path, entry->d_name);
 
-         write_backup_sha512(root, relative_dir);
+         if (write_backup_sha512(root, relative_dir, sha256, files, workers))
+         {
+            goto error;
+         }
       }
-      else if (strcmp(entry->d_name, "backup.sha512"))
+      else if (strcmp(entry->d_name, "backup.sha512") && strcmp(entry->d_name, "backup.sha256"))
       {
          relative_file_path = NULL;
-         absolute_file_path = NULL;
-         sha512 = NULL;
-         buffer = NULL;
 
          relative_file_path = pgmoneta_append(relative_file_path, relative_path);
          relative_file_path = pgmoneta_append(relative_file_path, "/");
          relative_file_path = pgmoneta_append(relative_file_path, entry->d_name);
 
-         absolute_file_path = pgmoneta_append(absolute_file_path, root);
-         absolute_file_path = pgmoneta_append(absolute_file_path, "/");
-         absolute_file_path = pgmoneta_append(absolute_file_path, relative_file_path);
+         si = (struct sha512_input*)malloc(sizeof(struct sha512_input));
+         if (si == NULL)
+         {
+            free(relative_file_path);
+            goto error;
+         }
 
-         pgmoneta_create_sha512_file(absolute_file_path, &sha512);
+         memset(si, 0, sizeof(struct sha512_input));
+         snprintf(si->path, sizeof(si->path), "%s/%s", root, relative_file_path);
+         si->with_sha256 = sha256 && pgmoneta_starts_with(relative_file_path, "/data/");
+         si->common.workers = workers;
 
-         buffer = pgmoneta_append(buffer, sha512);
-         buffer = pgmoneta_append(buffer, " *.");
-         buffer = pgmoneta_append(buffer, relative_file_path);
-         buffer = pgmoneta_append(buffer, "\n");
+         /* The deque owns the input, the task only fills in the hash */
+         pgmoneta_deque_add_with_config(files, relative_file_path, (uintptr_t)si, &vc);
 
-         fputs(buffer, sha512_file);
+         if (workers != NULL)
+         {
+            pgmoneta_workers_add(workers, do_sha512, (struct worker_common*)si);
+         }
+         else
+         {
+            do_sha512((struct worker_common*)si);
+         }
 
-         free(buffer);
-         free(sha512);
          free(relative_file_path);
-         free(absolute_file_path);
       }
    }
 
@@ -219,6 +342,45 @@ error:
    return 1;
 }
 
+static void
+do_sha512(struct worker_common* wc)
+{
+   int ret = 0;
+   struct sha512_input* si = (struct sha512_input*)wc;
+
+   if (si->with_sha256)
+   {
+      ret = pgmoneta_create_sha256_sha512_file(si->path, &si->sha256, &si->sha512);
+   }
+   else
+   {
+      ret = pgmoneta_create_sha512_file(si->path, &si->sha512);
+   }
+
+   if (ret)
+   {
+      pgmoneta_log_error("SHA512: Could not create hash for %s", si->path);
+
+      if (wc->workers != NULL)
+      {
+         wc->workers->outcome = false;
+      }
+   }
+}
+
+static void
+sha512_input_destroy(uintptr_t data)
+{
+   struct sha512_input* si = (struct sha512_input*)data;
+
+   if (si != NULL)
+   {
+      free(si->sha256);
+      free(si->sha512);
+      free(si);
+   }
+}
+
 int
 pgmoneta_update_sha512(char* root_dir, char* filename)
 {
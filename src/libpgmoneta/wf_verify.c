@@ -32,6 +32,7 @@
 #include <csv.h>
 #include <logging.h>
 #include <management.h>
+#include <manifest.h>
 #include <security.h>
 #include <utils.h>
 #include <workflow.h>
@@ -144,21 +145,39 @@ verify_execute(char* name __attribute__((unused)), struct art* nodes)
    {
       struct worker_input* payload = NULL;
       struct json* j = NULL;
+      char* algorithm = NULL;
+      char* checksum = NULL;
+      int64_t size = -1;
+
+      if (pgmoneta_manifest_checksum_parse(columns[MANIFEST_CHECKSUM_INDEX], &algorithm, &checksum, &size))
+      {
+         pgmoneta_log_error("Verify: Invalid checksum for %s", columns[MANIFEST_PATH_INDEX]);
+         free(columns);
+         columns = NULL;
+         continue;
+      }
 
       if (pgmoneta_create_worker_input(NULL, NULL, NULL, -1, workers, &payload))
       {
+         free(algorithm);
+         free(checksum);
          goto error;
       }
 
       if (pgmoneta_json_create(&j))
       {
+         free(algorithm);
+         free(checksum);
          goto error;
       }
 
       pgmoneta_json_put(j, MANAGEMENT_ARGUMENT_DIRECTORY, (uintptr_t)pgmoneta_art_search(nodes, NODE_TARGET_BASE), ValueString);
-      pgmoneta_json_put(j, MANAGEMENT_ARGUMENT_FILENAME, (uintptr_t)columns[0], ValueString);
-      pgmoneta_json_put(j, MANAGEMENT_ARGUMENT_ORIGINAL, (uintptr_t)columns[1], ValueString);
-      pgmoneta_json_put(j, MANAGEMENT_ARGUMENT_HASH_ALGORITHM, (uintptr_t)"SHA512", ValueString);
+      pgmoneta_json_put(j, MANAGEMENT_ARGUMENT_FILENAME, (uintptr_t)columns[MANIFEST_PATH_INDEX], ValueString);
+      pgmoneta_json_put(j, MANAGEMENT_ARGUMENT_ORIGINAL, (uintptr_t)checksum, ValueString);
+      pgmoneta_json_put(j, MANAGEMENT_ARGUMENT_HASH_ALGORITHM, (uintptr_t)algorithm, ValueString);
+
+      free(algorithm);
+      free(checksum);
 
       payload->data = j;
       payload->failed = failed_deque;
@@ -244,7 +263,7 @@ do_verify(struct worker_common* wc)
       goto error;
    }
 
-   if (!pgmoneta_create_sha512_file(f, &hash_cal))
+   if (!pgmoneta_create_checksum_file(f, (char*)pgmoneta_json_get(j, MANAGEMENT_ARGUMENT_HASH_ALGORITHM), &hash_cal))
    {
       if (strcmp(hash_cal, (char*)pgmoneta_json_get(j, MANAGEMENT_ARGUMENT_ORIGINAL)))
       {
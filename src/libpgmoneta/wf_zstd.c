@@ -130,7 +130,11 @@ zstd_execute_compress(char* name __attribute__((unused)), struct art* nodes)
 
    tarfile = (char*)pgmoneta_art_search(nodes, NODE_TARGET_FILE);
 
-   if (tarfile == NULL)
+   if (tarfile == NULL && backup->passthrough)
+   {
+      pgmoneta_log_debug("ZSTD (compress): %s/%s is kept as the server side compressed archive", config->common.servers[server].name, label);
+   }
+   else if (tarfile == NULL)
    {
       number_of_workers = pgmoneta_get_number_of_workers(server);
       if (number_of_workers > 0)
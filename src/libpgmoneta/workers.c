@@ -29,6 +29,7 @@
 #include <pgmoneta.h>
 #include <deque.h>
 #include <logging.h>
+#include <memory.h>
 #include <workers.h>
 #include <value.h>
 
@@ -349,6 +350,8 @@ worker_do(struct worker* worker)
          {
             task->function(task->wc);
             free(task);
+
+            pgmoneta_memory_arena_scope_release();
          }
 
          pthread_mutex_lock(&workers->worker_lock);
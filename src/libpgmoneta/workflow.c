@@ -31,8 +31,11 @@
 #include <pgmoneta.h>
 #include <art.h>
 #include <hot_standby.h>
+#include <instrument.h>
+#include <job.h>
 #include <logging.h>
 #include <management.h>
+#include <memory.h>
 #include <storage.h>
 #include <utils.h>
 #include <workflow.h>
@@ -292,6 +295,49 @@ error:
    return 1;
 }
 
+int
+pgmoneta_workflow_step(struct workflow* workflow, struct art* nodes)
+{
+   int server = -1;
+   int ret;
+   struct backup* backup = NULL;
+   struct backup_phase* phase = NULL;
+   struct instrument_sample sample;
+
+   if (pgmoneta_art_contains_key(nodes, NODE_SERVER_ID))
+   {
+      server = (int)pgmoneta_art_search(nodes, NODE_SERVER_ID);
+   }
+
+   /* The steps of a backup are kept with the backup */
+   if (workflow->type == WORKFLOW_TYPE_BACKUP || workflow->type == WORKFLOW_TYPE_INCREMENTAL_BACKUP)
+   {
+      backup = (struct backup*)pgmoneta_art_search(nodes, NODE_BACKUP);
+      if (backup != NULL && backup->number_of_phases < NUMBER_OF_PHASES)
+      {
+         phase = &backup->phases[backup->number_of_phases];
+      }
+   }
+
+   pgmoneta_job_phase(workflow->name());
+
+   pgmoneta_instrument_begin(&sample);
+
+   ret = workflow->execute(workflow->name(), nodes);
+
+   pgmoneta_instrument_end(server, workflow->type, workflow->name(), &sample, phase);
+
+   /* Everything the step kept in its arena goes at once */
+   pgmoneta_memory_arena_scope_release();
+
+   if (phase != NULL)
+   {
+      backup->number_of_phases++;
+   }
+
+   return ret;
+}
+
 int
 pgmoneta_workflow_execute(struct workflow* workflow, struct art* nodes,
                           char** error_name, int* error_code)
@@ -318,7 +364,15 @@ pgmoneta_workflow_execute(struct workflow* workflow, struct art* nodes,
    current = workflow;
    while (current != NULL)
    {
-      if (current->execute(current->name(), nodes))
+      if (pgmoneta_job_cancelled())
+      {
+         en = current->name();
+         ec = MANAGEMENT_ERROR_JOB_CANCELLED;
+         pgmoneta_log_info("%s: Job cancelled", en);
+         goto error;
+      }
+
+      if (pgmoneta_workflow_step(current, nodes))
       {
          en = current->name();
          ec = get_error_code(current->type, EXECUTE, nodes);
@@ -487,11 +541,11 @@ wf_backup(void)
    current->next = pgmoneta_create_permissions(PERMISSION_TYPE_BACKUP);
    current = current->next;
 
+   current->next = pgmoneta_create_sha512();
+   current = current->next;
+
    if (config->storage_engine & STORAGE_ENGINE_SSH)
    {
-      current->next = pgmoneta_create_sha256();
-      current = current->next;
-
       current->next = pgmoneta_storage_create_ssh(WORKFLOW_TYPE_BACKUP);
       current = current->next;
    }
@@ -508,9 +562,6 @@ wf_backup(void)
       current = current->next;
    }
 
-   current->next = pgmoneta_create_sha512();
-   current = current->next;
-
 #ifdef DEBUG
    current = head;
    while (current != NULL)
@@ -541,7 +592,12 @@ wf_restore(struct backup* backup)
       current = current->next;
    }
 
-   if (backup->compression == COMPRESSION_CLIENT_GZIP || backup->compression == COMPRESSION_SERVER_GZIP)
+   if (backup->passthrough)
+   {
+      current->next = pgmoneta_create_passthrough();
+      current = current->next;
+   }
+   else if (backup->compression == COMPRESSION_CLIENT_GZIP || backup->compression == COMPRESSION_SERVER_GZIP)
    {
       current->next = pgmoneta_create_gzip(false);
       current = current->next;
@@ -690,11 +746,11 @@ wf_post_rollup(struct backup* backup)
    current->next = pgmoneta_create_permissions(PERMISSION_TYPE_BACKUP);
    current = current->next;
 
+   current->next = pgmoneta_create_sha512();
+   current = current->next;
+
    if (config->storage_engine & STORAGE_ENGINE_SSH)
    {
-      current->next = pgmoneta_create_sha256();
-      current = current->next;
-
       current->next = pgmoneta_storage_create_ssh(WORKFLOW_TYPE_BACKUP);
       current = current->next;
    }
@@ -711,9 +767,6 @@ wf_post_rollup(struct backup* backup)
       current = current->next;
    }
 
-   current->next = pgmoneta_create_sha512();
-   current = current->next;
-
 #ifdef DEBUG
    current = head;
    while (current != NULL)
@@ -785,11 +838,11 @@ wf_incremental_backup(void)
    current->next = pgmoneta_create_permissions(PERMISSION_TYPE_BACKUP);
    current = current->next;
 
+   current->next = pgmoneta_create_sha512();
+   current = current->next;
+
    if (config->storage_engine & STORAGE_ENGINE_SSH)
    {
-      current->next = pgmoneta_create_sha256();
-      current = current->next;
-
       current->next = pgmoneta_storage_create_ssh(WORKFLOW_TYPE_BACKUP);
       current = current->next;
    }
@@ -806,9 +859,6 @@ wf_incremental_backup(void)
       current = current->next;
    }
 
-   current->next = pgmoneta_create_sha512();
-   current = current->next;
-
 #ifdef DEBUG
    current = head;
    while (current != NULL)
@@ -839,7 +889,12 @@ wf_verify(struct backup* backup)
       current = current->next;
    }
 
-   if (backup->compression == COMPRESSION_CLIENT_GZIP || backup->compression == COMPRESSION_SERVER_GZIP)
+   if (backup->passthrough)
+   {
+      current->next = pgmoneta_create_passthrough();
+      current = current->next;
+   }
+   else if (backup->compression == COMPRESSION_CLIENT_GZIP || backup->compression == COMPRESSION_SERVER_GZIP)
    {
       current->next = pgmoneta_create_gzip(false);
       current = current->next;
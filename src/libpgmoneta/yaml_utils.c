@@ -204,6 +204,10 @@ handle_scalar_event(yaml_event_t* event, parser_state_t* state,
             {
                config->configuration_file = strdup(value);
             }
+            else if (strcmp(*current_key, "workers") == 0)
+            {
+               config->workers = atoi(value);
+            }
             free(*current_key);
             *current_key = NULL;
          }
@@ -28,6 +28,7 @@
 
 /* pgmoneta */
 #include <pgmoneta.h>
+#include <instrument.h>
 #include <logging.h>
 #include <management.h>
 #include <utils.h>
@@ -1017,6 +1018,7 @@ zstd_compress(char* from, char* to, ZSTD_CCtx* cctx, size_t zin_size, void* zin,
 
    fclose(fout);
    fclose(fin);
+   pgmoneta_instrument_files(1);
 
    return 0;
 
@@ -1094,6 +1096,7 @@ zstd_decompress(char* from, char* to, ZSTD_DCtx* dctx, size_t zin_size, void* zi
 
    fclose(fin);
    fclose(fout);
+   pgmoneta_instrument_files(1);
 
    return 0;
 
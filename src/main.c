@@ -32,11 +32,14 @@
 #include <aes.h>
 #include <backup.h>
 #include <bzip2_compression.h>
+#include <catalog.h>
 #include <cmd.h>
 #include <configuration.h>
 #include <delete.h>
 #include <gzip_compression.h>
 #include <info.h>
+#include <instrument.h>
+#include <job.h>
 #include <keep.h>
 #include <logging.h>
 #include <lz4_compression.h>
@@ -55,7 +58,9 @@
 #include <stddef.h>
 #include <utils.h>
 #include <verify.h>
+#include <walfetch.h>
 #include <wal.h>
+#include <walarchive.h>
 #include <zstandard_compression.h>
 
 /* system */
@@ -86,7 +91,7 @@
 #define SIGNALS_NUMBER 6
 
 static void accept_mgt_cb(struct ev_loop* loop, struct ev_io* watcher, int revents);
-static void accept_metrics_cb(struct ev_loop* loop, struct ev_io* watcher, int revents);
+static void metrics_exit_cb(struct ev_loop* loop, struct ev_child* watcher, int revents);
 static void accept_management_cb(struct ev_loop* loop, struct ev_io* watcher, int revents);
 static void shutdown_cb(struct ev_loop* loop, ev_signal* w, int revents);
 static void reload_cb(struct ev_loop* loop, ev_signal* w, int revents);
@@ -94,7 +99,9 @@ static void coredump_cb(struct ev_loop* loop, ev_signal* w, int revents);
 static void wal_cb(struct ev_loop* loop, ev_periodic* w, int revents);
 static void retention_cb(struct ev_loop* loop, ev_periodic* w, int revents);
 static void verification_cb(struct ev_loop* loop, ev_periodic* w, int revents);
+static void wal_verification_cb(struct ev_loop* loop, ev_periodic* w, int revents);
 static void valid_cb(struct ev_loop* loop, ev_periodic* w, int revents);
+static void disk_usage_cb(struct ev_loop* loop, ev_periodic* w, int revents);
 static void wal_streaming_cb(struct ev_loop* loop, ev_periodic* w, int revents);
 static bool accept_fatal(int error);
 static bool reload_configuration(void);
@@ -109,6 +116,8 @@ static int verify_replication_slot(char* slot_name, int srv, SSL* ssl, int socke
 static int  create_pidfile(void);
 static void remove_pidfile(void);
 static void shutdown_ports(void);
+static void stop_metrics(void);
+static void shutdown_management(void);
 
 struct accept_io
 {
@@ -123,7 +132,8 @@ static char** argv_ptr;
 static struct ev_loop* main_loop = NULL;
 static struct accept_io io_mgt;
 static int unix_management_socket = -1;
-static struct accept_io io_metrics[MAX_FDS];
+static struct ev_child metrics_child;
+static pid_t metrics_pid = 0;
 static int* metrics_fds = NULL;
 static int metrics_fds_length = -1;
 static struct accept_io io_management[MAX_FDS];
@@ -157,15 +167,37 @@ shutdown_mgt(void)
 static void
 start_metrics(void)
 {
-   for (int i = 0; i < metrics_fds_length; i++)
+   pid_t pid;
+
+   /* A long-lived process serves all scrapes over persistent connections */
+   pid = fork();
+   if (pid == -1)
+   {
+      pgmoneta_log_error("Metrics: No fork");
+      return;
+   }
+   else if (pid == 0)
    {
-      int sockfd = *(metrics_fds + i);
+      shutdown_management();
+
+      pgmoneta_set_proc_title(1, argv_ptr, "metrics", NULL);
+      pgmoneta_prometheus_server(metrics_fds, metrics_fds_length);
+   }
+
+   metrics_pid = pid;
+
+   ev_child_init(&metrics_child, metrics_exit_cb, pid, 0);
+   ev_child_start(main_loop, &metrics_child);
+}
 
-      memset(&io_metrics[i], 0, sizeof(struct accept_io));
-      ev_io_init((struct ev_io*)&io_metrics[i], accept_metrics_cb, sockfd, EV_READ);
-      io_metrics[i].socket = sockfd;
-      io_metrics[i].argv = argv_ptr;
-      ev_io_start(main_loop, (struct ev_io*)&io_metrics[i]);
+static void
+stop_metrics(void)
+{
+   if (metrics_pid > 0)
+   {
+      ev_child_stop(main_loop, &metrics_child);
+      kill(metrics_pid, SIGTERM);
+      metrics_pid = 0;
    }
 }
 
@@ -174,8 +206,7 @@ shutdown_metrics(void)
 {
    for (int i = 0; i < metrics_fds_length; i++)
    {
-      ev_io_stop(main_loop, (struct ev_io*)&io_metrics[i]);
-      pgmoneta_disconnect(io_metrics[i].socket);
+      pgmoneta_disconnect(*(metrics_fds + i));
       errno = 0;
    }
 }
@@ -256,8 +287,13 @@ main(int argc, char** argv)
    struct ev_periodic valid;
    struct ev_periodic wal_streaming;
    struct ev_periodic verification;
+   struct ev_periodic wal_verification;
+   struct ev_periodic disk_usage;
    size_t shmem_size;
    size_t prometheus_cache_shmem_size = 0;
+   size_t catalog_shmem_size = 0;
+   size_t jobs_shmem_size = 0;
+   size_t instrument_shmem_size = 0;
    struct main_configuration* config = NULL;
    int ret;
    char* os = NULL;
@@ -651,6 +687,38 @@ main(int argc, char** argv)
       errx(1, "Error in creating and initializing prometheus cache shared memory");
    }
 
+   if (pgmoneta_catalog_init(&catalog_shmem_size, &catalog_shmem))
+   {
+#ifdef HAVE_SYSTEMD
+      sd_notifyf(0, "STATUS=Error in creating and initializing backup catalog shared memory");
+#endif
+      errx(1, "Error in creating and initializing backup catalog shared memory");
+   }
+
+   if (pgmoneta_job_init(&jobs_shmem_size, &jobs_shmem))
+   {
+#ifdef HAVE_SYSTEMD
+      sd_notifyf(0, "STATUS=Error in creating and initializing job shared memory");
+#endif
+      errx(1, "Error in creating and initializing job shared memory");
+   }
+
+   if (pgmoneta_instrument_init(&instrument_shmem_size, &instrument_shmem))
+   {
+#ifdef HAVE_SYSTEMD
+      sd_notifyf(0, "STATUS=Error in creating and initializing instrumentation shared memory");
+#endif
+      errx(1, "Error in creating and initializing instrumentation shared memory");
+   }
+
+   for (int i = 0; i < config->common.number_of_servers; i++)
+   {
+      if (pgmoneta_catalog_load(i))
+      {
+         pgmoneta_log_debug("Backup catalog will be loaded on demand for %s", config->common.servers[i].name);
+      }
+   }
+
    /* Bind Unix Domain Socket */
    if (pgmoneta_bind_unix_socket(config->unix_socket_dir, MAIN_UDS, &unix_management_socket))
    {
@@ -765,9 +833,10 @@ main(int argc, char** argv)
    ev_periodic_init (&wal_streaming, wal_streaming_cb, 0., 60, 0);
    ev_periodic_start (main_loop, &wal_streaming);
 
-   /* Start WAL compression */
+   /* Start WAL compression and archiving */
    if (config->compression_type != COMPRESSION_NONE ||
-       config->encryption != ENCRYPTION_NONE)
+       config->encryption != ENCRYPTION_NONE ||
+       config->storage_engine & (STORAGE_ENGINE_S3 | STORAGE_ENGINE_AZURE))
    {
       ev_periodic_init(&wal, wal_cb, 0., 60, 0);
       ev_periodic_start(main_loop, &wal);
@@ -781,6 +850,17 @@ main(int argc, char** argv)
    ev_periodic_init(&verification, verification_cb, 0., config->verification, 0);
    ev_periodic_start(main_loop, &verification);
 
+   /* Start WAL verification job */
+   if (config->wal_verification > 0)
+   {
+      ev_periodic_init(&wal_verification, wal_verification_cb, 0., config->wal_verification, 0);
+      ev_periodic_start(main_loop, &wal_verification);
+   }
+
+   /* Start disk usage reconciliation */
+   ev_periodic_init(&disk_usage, disk_usage_cb, 0., config->disk_usage_interval, 0);
+   ev_periodic_start(main_loop, &disk_usage);
+
    pgmoneta_log_info("Started on %s", config->host);
    pgmoneta_log_debug("Management: %d", unix_management_socket);
    for (int i = 0; i < metrics_fds_length; i++)
@@ -820,6 +900,7 @@ main(int argc, char** argv)
 #endif
 
    shutdown_management();
+   stop_metrics();
    shutdown_metrics();
    shutdown_mgt();
 
@@ -838,6 +919,9 @@ main(int argc, char** argv)
    pgmoneta_stop_logging();
    pgmoneta_destroy_shared_memory(shmem, shmem_size);
    pgmoneta_destroy_shared_memory(prometheus_cache_shmem, prometheus_cache_shmem_size);
+   pgmoneta_destroy_shared_memory(catalog_shmem, catalog_shmem_size);
+   pgmoneta_destroy_shared_memory(jobs_shmem, jobs_shmem_size);
+   pgmoneta_destroy_shared_memory(instrument_shmem, instrument_shmem_size);
 
    if (daemon || stop)
    {
@@ -861,6 +945,7 @@ error:
 
    if (metrics_started)
    {
+      stop_metrics();
       shutdown_metrics();
    }
 
@@ -877,6 +962,9 @@ error:
    pgmoneta_stop_logging();
    pgmoneta_destroy_shared_memory(shmem, shmem_size);
    pgmoneta_destroy_shared_memory(prometheus_cache_shmem, prometheus_cache_shmem_size);
+   pgmoneta_destroy_shared_memory(catalog_shmem, catalog_shmem_size);
+   pgmoneta_destroy_shared_memory(jobs_shmem, jobs_shmem_size);
+   pgmoneta_destroy_shared_memory(instrument_shmem, instrument_shmem_size);
 
    if (daemon || stop)
    {
@@ -996,6 +1084,7 @@ accept_mgt_cb(struct ev_loop* loop, struct ev_io* watcher, int revents)
                pgmoneta_json_clone(payload, &pyl);
 
                pgmoneta_set_proc_title(1, ai->argv, "backup", config->common.servers[srv].name);
+               pgmoneta_job_schedule(&client_fd, srv, MANAGEMENT_BACKUP, compression, encryption, pyl);
                pgmoneta_backup(client_fd, srv, compression, encryption, pyl);
             }
          }
@@ -1086,6 +1175,7 @@ accept_mgt_cb(struct ev_loop* loop, struct ev_io* watcher, int revents)
             pgmoneta_json_clone(payload, &pyl);
 
             pgmoneta_set_proc_title(1, ai->argv, "delete", config->common.servers[srv].name);
+            pgmoneta_job_schedule(&client_fd, srv, MANAGEMENT_DELETE, compression, encryption, pyl);
             pgmoneta_delete_backup(client_fd, srv, compression, encryption, pyl);
             pgmoneta_delete_wal(srv);
          }
@@ -1128,6 +1218,7 @@ accept_mgt_cb(struct ev_loop* loop, struct ev_io* watcher, int revents)
             pgmoneta_json_clone(payload, &pyl);
 
             pgmoneta_set_proc_title(1, ai->argv, "restore", config->common.servers[srv].name);
+            pgmoneta_job_schedule(&client_fd, srv, MANAGEMENT_RESTORE, compression, encryption, pyl);
             pgmoneta_restore(NULL, client_fd, srv, compression, encryption, pyl);
          }
       }
@@ -1169,6 +1260,7 @@ accept_mgt_cb(struct ev_loop* loop, struct ev_io* watcher, int revents)
             pgmoneta_json_clone(payload, &pyl);
 
             pgmoneta_set_proc_title(1, ai->argv, "verify", config->common.servers[srv].name);
+            pgmoneta_job_schedule(&client_fd, srv, MANAGEMENT_VERIFY, compression, encryption, pyl);
             pgmoneta_verify(NULL, client_fd, srv, compression, encryption, pyl);
          }
       }
@@ -1210,6 +1302,7 @@ accept_mgt_cb(struct ev_loop* loop, struct ev_io* watcher, int revents)
             pgmoneta_json_clone(payload, &pyl);
 
             pgmoneta_set_proc_title(1, ai->argv, "archive", config->common.servers[srv].name);
+            pgmoneta_job_schedule(&client_fd, srv, MANAGEMENT_ARCHIVE, compression, encryption, pyl);
             pgmoneta_archive(NULL, client_fd, srv, compression, encryption, pyl);
          }
       }
@@ -1220,6 +1313,39 @@ accept_mgt_cb(struct ev_loop* loop, struct ev_io* watcher, int revents)
          goto error;
       }
    }
+   else if (id == MANAGEMENT_JOB_LIST || id == MANAGEMENT_JOB_CANCEL || id == MANAGEMENT_JOB_SUBSCRIBE)
+   {
+      pid = fork();
+      if (pid == -1)
+      {
+         pgmoneta_management_response_error(NULL, client_fd, NULL, MANAGEMENT_ERROR_JOB_NOFORK, NAME, compression, encryption, payload);
+         pgmoneta_log_error("Job: No fork (%d)", MANAGEMENT_ERROR_JOB_NOFORK);
+         goto error;
+      }
+      else if (pid == 0)
+      {
+         struct json* pyl = NULL;
+
+         shutdown_ports();
+
+         pgmoneta_json_clone(payload, &pyl);
+
+         pgmoneta_set_proc_title(1, ai->argv, "job", NULL);
+
+         if (id == MANAGEMENT_JOB_LIST)
+         {
+            pgmoneta_job_list(NULL, client_fd, compression, encryption, pyl);
+         }
+         else if (id == MANAGEMENT_JOB_CANCEL)
+         {
+            pgmoneta_job_cancel(NULL, client_fd, compression, encryption, pyl);
+         }
+         else
+         {
+            pgmoneta_job_subscribe(NULL, client_fd, compression, encryption, pyl);
+         }
+      }
+   }
    else if (id == MANAGEMENT_SHUTDOWN)
    {
 #ifdef HAVE_FREEBSD
@@ -1700,6 +1826,88 @@ accept_mgt_cb(struct ev_loop* loop, struct ev_io* watcher, int revents)
          }
       }
    }
+   else if (id == MANAGEMENT_VERIFY_WAL)
+   {
+      server = (char*)pgmoneta_json_get(request, MANAGEMENT_ARGUMENT_SERVER);
+
+      srv = -1;
+      for (int i = 0; srv == -1 && i < config->common.number_of_servers; i++)
+      {
+         if (!strcmp(config->common.servers[i].name, server))
+         {
+            srv = i;
+         }
+      }
+
+      if (srv != -1)
+      {
+         pid = fork();
+         if (pid == -1)
+         {
+            pgmoneta_management_response_error(NULL, client_fd, server, MANAGEMENT_ERROR_VERIFY_WAL_NOFORK, NAME, compression, encryption, payload);
+            pgmoneta_log_error("Verify WAL: No fork %s (%d)", server, MANAGEMENT_ERROR_VERIFY_WAL_NOFORK);
+            goto error;
+         }
+         else if (pid == 0)
+         {
+            struct json* pyl = NULL;
+
+            shutdown_ports();
+
+            pgmoneta_json_clone(payload, &pyl);
+
+            pgmoneta_set_proc_title(1, ai->argv, "verify-wal", config->common.servers[srv].name);
+            pgmoneta_verify_wal(NULL, client_fd, srv, compression, encryption, pyl);
+         }
+      }
+      else
+      {
+         pgmoneta_management_response_error(NULL, client_fd, server, MANAGEMENT_ERROR_VERIFY_WAL_NOSERVER, NAME, compression, encryption, payload);
+         pgmoneta_log_error("Verify WAL: No server %s (%d)", server, MANAGEMENT_ERROR_VERIFY_WAL_NOSERVER);
+         goto error;
+      }
+   }
+   else if (id == MANAGEMENT_WAL_FETCH)
+   {
+      server = (char*)pgmoneta_json_get(request, MANAGEMENT_ARGUMENT_SERVER);
+
+      srv = -1;
+      for (int i = 0; srv == -1 && i < config->common.number_of_servers; i++)
+      {
+         if (!strcmp(config->common.servers[i].name, server))
+         {
+            srv = i;
+         }
+      }
+
+      if (srv != -1)
+      {
+         pid = fork();
+         if (pid == -1)
+         {
+            pgmoneta_management_response_error(NULL, client_fd, server, MANAGEMENT_ERROR_WAL_FETCH_NOFORK, NAME, compression, encryption, payload);
+            pgmoneta_log_error("WAL fetch: No fork %s (%d)", server, MANAGEMENT_ERROR_WAL_FETCH_NOFORK);
+            goto error;
+         }
+         else if (pid == 0)
+         {
+            struct json* pyl = NULL;
+
+            shutdown_ports();
+
+            pgmoneta_json_clone(payload, &pyl);
+
+            pgmoneta_set_proc_title(1, ai->argv, "wal-fetch", config->common.servers[srv].name);
+            pgmoneta_wal_fetch(NULL, client_fd, srv, compression, encryption, pyl);
+         }
+      }
+      else
+      {
+         pgmoneta_management_response_error(NULL, client_fd, server, MANAGEMENT_ERROR_WAL_FETCH_NOSERVER, NAME, compression, encryption, payload);
+         pgmoneta_log_error("WAL fetch: No server %s (%d)", server, MANAGEMENT_ERROR_WAL_FETCH_NOSERVER);
+         goto error;
+      }
+   }
    else if (id == MANAGEMENT_MODE)
    {
       char* action = NULL;
@@ -1843,89 +2051,52 @@ error:
 }
 
 static void
-accept_metrics_cb(struct ev_loop* loop, struct ev_io* watcher, int revents)
+metrics_exit_cb(struct ev_loop* loop, struct ev_child* watcher, int revents)
 {
-   struct sockaddr_in6 client_addr;
-   socklen_t client_addr_length;
-   int client_fd;
    struct main_configuration* config;
-   SSL_CTX* ctx = NULL;
-   SSL* client_ssl = NULL;
+
+   config = (struct main_configuration*)shmem;
+
+   ev_child_stop(loop, watcher);
+   metrics_pid = 0;
 
    if (EV_ERROR & revents)
    {
-      pgmoneta_log_debug("accept_metrics_cb: invalid event: %s", strerror(errno));
+      pgmoneta_log_debug("metrics_exit_cb: invalid event: %s", strerror(errno));
       errno = 0;
-      return;
    }
 
-   config = (struct main_configuration*)shmem;
-
-   client_addr_length = sizeof(client_addr);
-   client_fd = accept(watcher->fd, (struct sockaddr*)&client_addr, &client_addr_length);
-   if (client_fd == -1)
+   if (!keep_running || config->metrics <= 0)
    {
-      if (accept_fatal(errno) && keep_running)
-      {
-         pgmoneta_log_warn("Restarting listening port due to: %s (%d)", strerror(errno), watcher->fd);
-
-         shutdown_metrics();
-
-         free(metrics_fds);
-         metrics_fds = NULL;
-         metrics_fds_length = 0;
+      return;
+   }
 
-         if (pgmoneta_bind(config->host, config->metrics, &metrics_fds, &metrics_fds_length))
-         {
-            pgmoneta_log_fatal("Could not bind to %s:%d", config->host, config->metrics);
-            exit(1);
-         }
+   pgmoneta_log_warn("Metrics: Process %d exited with status %d, restarting", watcher->rpid, watcher->rstatus);
 
-         if (metrics_fds_length > MAX_FDS)
-         {
-            pgmoneta_log_fatal("Too many descriptors %d", metrics_fds_length);
-            exit(1);
-         }
+   shutdown_metrics();
 
-         start_metrics();
+   free(metrics_fds);
+   metrics_fds = NULL;
+   metrics_fds_length = 0;
 
-         for (int i = 0; i < metrics_fds_length; i++)
-         {
-            pgmoneta_log_debug("Metrics: %d", *(metrics_fds + i));
-         }
-      }
-      else
-      {
-         pgmoneta_log_debug("accept: %s (%d)", strerror(errno), watcher->fd);
-      }
-      errno = 0;
-      return;
+   if (pgmoneta_bind(config->host, config->metrics, &metrics_fds, &metrics_fds_length))
+   {
+      pgmoneta_log_fatal("Could not bind to %s:%d", config->host, config->metrics);
+      exit(1);
    }
 
-   if (!fork())
+   if (metrics_fds_length > MAX_FDS)
    {
-      ev_loop_fork(loop);
-      shutdown_ports();
-      if (strlen(config->metrics_cert_file) > 0 && strlen(config->metrics_key_file) > 0)
-      {
-         if (pgmoneta_create_ssl_ctx(false, &ctx))
-         {
-            pgmoneta_log_error("Could not create metrics SSL context");
-            return;
-         }
-
-         if (pgmoneta_create_ssl_server(ctx, config->metrics_key_file, config->metrics_cert_file, config->metrics_ca_file, client_fd, &client_ssl))
-         {
-            pgmoneta_log_error("Could not create metrics SSL server");
-            return;
-         }
-      }
-      /* We are leaving the socket descriptor valid such that the client won't reuse it */
-      pgmoneta_prometheus(client_ssl, client_fd);
+      pgmoneta_log_fatal("Too many descriptors %d", metrics_fds_length);
+      exit(1);
    }
 
-   pgmoneta_close_ssl(client_ssl);
-   pgmoneta_disconnect(client_fd);
+   start_metrics();
+
+   for (int i = 0; i < metrics_fds_length; i++)
+   {
+      pgmoneta_log_debug("Metrics: %d", *(metrics_fds + i));
+   }
 }
 
 static void
@@ -2057,6 +2228,7 @@ reload_services_only(void)
 
    config = (struct main_configuration*)shmem;
 
+   stop_metrics();
    shutdown_metrics();
 
    free(metrics_fds);
@@ -2197,11 +2369,20 @@ wal_cb(struct ev_loop* loop __attribute__((unused)), ev_periodic* w __attribute_
                   pgmoneta_encrypt_wal(d);
                }
 
+               /* Segments were counted with their full size, retention removes them with their size on disk */
+               if (config->compression_type != COMPRESSION_NONE || config->encryption != ENCRYPTION_NONE)
+               {
+                  pgmoneta_disk_usage_refresh(i, DISK_USAGE_WAL);
+               }
+
                free(d);
 
                atomic_store(&config->common.servers[i].repository, false);
             }
 
+            /* Uploads don't hold the repository lock */
+            pgmoneta_wal_archive(i);
+
             exit(0);
          }
       }
@@ -2246,6 +2427,23 @@ verification_cb(struct ev_loop* loop __attribute__((unused)), ev_periodic* w __a
    }
 }
 
+static void
+wal_verification_cb(struct ev_loop* loop __attribute__((unused)), ev_periodic* w __attribute__((unused)), int revents)
+{
+   if (EV_ERROR & revents)
+   {
+      pgmoneta_log_trace("wal_verification_cb: got invalid event: %s", strerror(errno));
+      errno = 0;
+      return;
+   }
+
+   if (!fork())
+   {
+      shutdown_ports();
+      pgmoneta_wal_verification(argv_ptr);
+   }
+}
+
 static void
 valid_cb(struct ev_loop* loop __attribute__((unused)), ev_periodic* w __attribute__((unused)), int revents)
 {
@@ -2317,6 +2515,58 @@ valid_cb(struct ev_loop* loop __attribute__((unused)), ev_periodic* w __attribut
    }
 }
 
+static void
+disk_usage_cb(struct ev_loop* loop __attribute__((unused)), ev_periodic* w __attribute__((unused)), int revents)
+{
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   if (EV_ERROR & revents)
+   {
+      pgmoneta_log_trace("disk_usage_cb: got invalid event: %s", strerror(errno));
+      errno = 0;
+      return;
+   }
+
+   if (!fork())
+   {
+      shutdown_ports();
+
+      pgmoneta_start_logging();
+      pgmoneta_memory_init();
+
+      pgmoneta_set_proc_title(1, argv_ptr, "disk usage", NULL);
+
+      /* The scan is a background task, so stay out of the way of backups and WAL */
+      if (setpriority(PRIO_PROCESS, 0, 19))
+      {
+         errno = 0;
+      }
+
+      for (int i = 0; keep_running && i < config->common.number_of_servers; i++)
+      {
+         pgmoneta_disk_usage_reconcile(i);
+
+         pgmoneta_log_debug("Disk usage: %s Server %lu Backup %lu WAL %lu",
+                            config->common.servers[i].name,
+                            pgmoneta_disk_usage(i, DISK_USAGE_SERVER),
+                            pgmoneta_disk_usage(i, DISK_USAGE_BACKUP),
+                            pgmoneta_disk_usage(i, DISK_USAGE_WAL));
+      }
+
+      if (keep_running)
+      {
+         pgmoneta_used_space_refresh();
+      }
+
+      pgmoneta_memory_destroy();
+      pgmoneta_stop_logging();
+
+      exit(0);
+   }
+}
+
 static void
 wal_streaming_cb(struct ev_loop* loop __attribute__((unused)), ev_periodic* w __attribute__((unused)), int revents)
 {
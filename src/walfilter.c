@@ -41,6 +41,7 @@
 #include <walfile/rm_heap.h>
 #include <walfile/rmgr.h>
 #include <walfile/wal_reader.h>
+#include <workers.h>
 #include <yaml_utils.h>
 
 /* system */
@@ -48,15 +49,62 @@
 #include <unistd.h>
 #include <err.h>
 #include <libgen.h>
+#include <stdatomic.h>
 #include <stdio.h>
+#include <time.h>
+#ifdef HAVE_LINUX
+#include <sys/sysinfo.h>
+#endif
 
 #define OPERATION_DELETE "DELETE"
 
+/** @struct walfilter_predicate
+ * The filter predicate applied to the record headers
+ */
+struct walfilter_predicate
+{
+   bool delete_operation;         /**< Filter DELETE operations */
+   transaction_id* xids;          /**< The sorted XIDs to filter */
+   int xid_count;                 /**< The number of XIDs to filter */
+   transaction_id* delete_xids;   /**< The sorted XIDs of the DELETE operations */
+   int delete_xid_count;          /**< The number of XIDs of the DELETE operations */
+};
+
+/** @struct walfilter_input
+ * The input for a WAL file processed by a worker
+ */
+struct walfilter_input
+{
+   struct worker_common common;             /**< The worker common */
+   char source[MAX_PATH];                   /**< The source WAL file */
+   char target[MAX_PATH];                   /**< The target WAL file */
+   char* wal_path;                          /**< The decrypted and decompressed WAL file */
+   struct walfile* wf;                      /**< The WAL file */
+   struct walfilter_predicate* predicate;   /**< The filter predicate */
+   atomic_int* records_marked;              /**< The number of records marked as NOOP */
+   bool success;                            /**< The outcome of the last stage */
+};
+
 int pgmoneta_init_crc32c(uint32_t* crc);
 int pgmoneta_create_crc32c_buffer(void* buffer, size_t size, uint32_t* crc);
 int pgmoneta_finalize_crc32c(uint32_t* crc);
 static int pgmoneta_recalculate_record_crc(struct decoded_xlog_record* record, uint16_t magic);
 
+static int prepare_walfile(char* source, char** wal_path);
+static void do_prepare(struct worker_common* wc);
+static void do_filter_and_write(struct worker_common* wc);
+static int process_walfile(struct walfile* wf);
+static int apply_predicate(struct walfile* wf, struct walfilter_predicate* predicate, int* records_marked);
+static int collect_delete_xids(int walfile_count, struct walfilter_input** inputs, struct walfilter_predicate* predicate);
+static bool is_heap_delete(struct xlog_record* record);
+static bool needs_decoding(struct xlog_record* record, void* data);
+static bool xid_is_filtered(transaction_id* xids, int xid_count, transaction_id xid);
+static int compare_xid(const void* a, const void* b);
+static int sort_xids(transaction_id* xids, int xid_count);
+static int get_number_of_workers(config_t* yaml_config);
+static void destroy_inputs(struct walfilter_input** inputs, int count);
+static void destroy_partial_record(void);
+
 static void
 usage(void)
 {
@@ -69,90 +117,76 @@ usage(void)
    printf("\n");
    printf("Options:\n");
    printf("  -c, --config CONFIG_PATH  Override configuration file path from YAML\n");
+   printf("  -q, --quiet               Don't report the throughput\n");
    printf("\n");
    printf("pgmoneta: %s\n", PGMONETA_HOMEPAGE);
    printf("Report bugs: %s\n", PGMONETA_ISSUES);
 }
 
 /**
- * Process and maintain WAL files integrity after filtering
+ * Maintain the integrity of a WAL file after filtering
  *
- * @param walfile_count Number of walfiles
- * @param walfiles Array of walfile pointers
+ * @param wf The WAL file
+ * @return 0 on success, otherwise 1
  */
-void
-pgmoneta_process_walfiles(int walfile_count, struct walfile** walfiles)
+static int
+process_walfile(struct walfile* wf)
 {
-   if (walfiles == NULL || walfile_count <= 0)
+   struct deque_iterator* iter = NULL;
+
+   if (wf == NULL || wf->records == NULL)
    {
-      pgmoneta_log_error("No WAL files to process for CRC recalculation\n");
-      return;
+      pgmoneta_log_error("WAL file has no records, skipping");
+      return 0;
    }
 
-   pgmoneta_log_debug("Processing %d WAL files for CRC recalculation", walfile_count);
-
-   for (int i = 0; i < walfile_count; i++)
+   if (pgmoneta_deque_iterator_create(wf->records, &iter))
    {
-      struct walfile* wf = walfiles[i];
+      pgmoneta_log_error("Failed to create iterator for WAL file records");
+      goto error;
+   }
 
-      if (wf == NULL)
-      {
-         pgmoneta_log_error("WAL file #%d is NULL, skipping", i);
-         continue;
-      }
+   while (pgmoneta_deque_iterator_next(iter))
+   {
+      struct decoded_xlog_record* record = (struct decoded_xlog_record*)iter->value->data;
 
-      if (wf->records == NULL)
+      if (record == NULL)
       {
-         pgmoneta_log_error("WAL file #%d has no records, skipping", i);
          continue;
       }
 
-      pgmoneta_log_debug("Processing WAL file #%d...", i);
-
-      struct deque_iterator* iter = NULL;
-      if (pgmoneta_deque_iterator_create(wf->records, &iter))
-      {
-         pgmoneta_log_error("Failed to create iterator for WAL file records");
-         return;
-      }
-
-      while (pgmoneta_deque_iterator_next(iter))
+      // Check if this record was modified (converted to NOOP)
+      if (record->header.xl_rmid == RM_XLOG_ID &&
+          (record->header.xl_info & ~XLR_INFO_MASK) == XLOG_NOOP)
       {
-         struct decoded_xlog_record* record = (struct decoded_xlog_record*)iter->value->data;
-
-         if (record == NULL)
-         {
-            continue;
-         }
-
-         // Check if this record was modified (converted to NOOP)
-         if (record->header.xl_rmid == RM_XLOG_ID &&
-             (record->header.xl_info & ~XLR_INFO_MASK) == XLOG_NOOP)
+         if (!pgmoneta_recalculate_record_crc(record, wf->long_phd->std.xlp_magic))
          {
-            if (!pgmoneta_recalculate_record_crc(record, wf->long_phd->std.xlp_magic))
+            xlog_rec_ptr prev_lsn = record->lsn;
+            if (pgmoneta_deque_iterator_next(iter))
             {
-               xlog_rec_ptr prev_lsn = record->lsn;
-               if (pgmoneta_deque_iterator_next(iter))
-               {
-                  record = (struct decoded_xlog_record*)iter->value->data;
-                  record->header.xl_prev = prev_lsn;
+               record = (struct decoded_xlog_record*)iter->value->data;
+               record->header.xl_prev = prev_lsn;
 
-                  if (pgmoneta_recalculate_record_crc(record, wf->long_phd->std.xlp_magic))
-                  {
-                     pgmoneta_log_error("Failed to recalculate CRC for record (with updated xl_prev) at LSN %X/%X", LSN_FORMAT_ARGS(record->lsn));
-                  }
+               if (pgmoneta_recalculate_record_crc(record, wf->long_phd->std.xlp_magic))
+               {
+                  pgmoneta_log_error("Failed to recalculate CRC for record (with updated xl_prev) at LSN %X/%X", LSN_FORMAT_ARGS(record->lsn));
                }
             }
-            else
-            {
-               pgmoneta_log_error("Failed to recalculate CRC for NOOP record at LSN %X/%X", LSN_FORMAT_ARGS(record->lsn));
-            }
+         }
+         else
+         {
+            pgmoneta_log_error("Failed to recalculate CRC for NOOP record at LSN %X/%X", LSN_FORMAT_ARGS(record->lsn));
          }
       }
-
-      pgmoneta_deque_iterator_destroy(iter);
    }
-   pgmoneta_log_debug("WAL files processing completed");
+
+   pgmoneta_deque_iterator_destroy(iter);
+
+   return 0;
+
+error:
+
+   return 1;
 }
 
 /*
@@ -230,246 +264,460 @@ error:
 }
 
 /**
- * Filter out DELETE operations from WAL files
+ * Decrypt and decompress a WAL file into /tmp when needed
  *
- * @param file_count Pointer to the number of WAL files
- * @param walfiles Pointer to the array of WAL file pointers
- * @return 0 on success, non-zero on failure
+ * @param source The source WAL file
+ * @param wal_path The resulting WAL file
+ * @return 0 on success, otherwise 1
  */
-int
-pgmoneta_filter_operation_delete(int* file_count, struct walfile*** walfiles)
+static int
+prepare_walfile(char* source, char** wal_path)
 {
-#define XID_IS_DELETED(xid) \
-        ({ int found = 0; \
-           for (int k = 0; k < delete_xid_count; k++) { \
-              if (delete_xids[k] == (xid)) { found = 1; break; } \
-           } found; })
-
-   transaction_id* delete_xids = NULL;
-   int delete_xid_count = 0;
-   int delete_xid_capacity = 16;
-   int records_marked = 0;
+   char* path = NULL;
+   char* tmp_wal = NULL;
+   char* stripped = NULL;
+   bool copy = true;
+
+   *wal_path = NULL;
 
-   delete_xids = malloc(delete_xid_capacity * sizeof(transaction_id));
-   if (!delete_xids)
+   path = pgmoneta_append(path, source);
+
+   if (pgmoneta_is_encrypted(path))
    {
-      return 1;
+      tmp_wal = pgmoneta_format_and_append(tmp_wal, "/tmp/%s", basename(path));
+
+      pgmoneta_copy_file(path, tmp_wal, NULL);
+      copy = false;
+
+      pgmoneta_strip_extension(basename(path), &stripped);
+
+      free(path);
+      path = NULL;
+
+      path = pgmoneta_format_and_append(path, "/tmp/%s", stripped);
+      free(stripped);
+      stripped = NULL;
+
+      if (pgmoneta_decrypt_file(tmp_wal, path))
+      {
+         pgmoneta_log_fatal("Failed to decrypt WAL file at %s", source);
+         goto error;
+      }
+
+      free(tmp_wal);
+      tmp_wal = NULL;
    }
 
-   /* Pass 1: collect XIDs from DELETE records */
-   for (int i = 0; i < *file_count; i++)
+   if (pgmoneta_is_compressed(path))
    {
-      struct walfile* wf = (*walfiles)[i];
-      if (wf == NULL || wf->records == NULL)
+      tmp_wal = pgmoneta_format_and_append(tmp_wal, "/tmp/%s", basename(path));
+
+      if (copy)
       {
-         continue;
+         pgmoneta_copy_file(path, tmp_wal, NULL);
       }
 
-      struct deque_iterator* iter = NULL;
-      pgmoneta_deque_iterator_create(wf->records, &iter);
+      pgmoneta_strip_extension(basename(path), &stripped);
 
-      while (pgmoneta_deque_iterator_next(iter))
+      free(path);
+      path = NULL;
+
+      path = pgmoneta_format_and_append(path, "/tmp/%s", stripped);
+      free(stripped);
+      stripped = NULL;
+
+      if (pgmoneta_decompress(tmp_wal, path))
       {
-         struct decoded_xlog_record* rec = (struct decoded_xlog_record*)iter->value->data;
-         if (rec->header.xl_rmid == RM_HEAP_ID)
-         {
-            uint8_t info = rec->header.xl_info & ~XLR_INFO_MASK;
-            info &= XLOG_HEAP_OPMASK;
-            if (info == XLOG_HEAP_DELETE)
-            {
-               struct xl_heap_delete* del = (struct xl_heap_delete*)rec->main_data;
+         pgmoneta_log_fatal("Failed to decompress WAL file at %s", source);
+         goto error;
+      }
 
-               if (!del)
-               {
-                  continue;
-               }
+      free(tmp_wal);
+      tmp_wal = NULL;
+   }
 
-               int already_exists = 0;
-               for (int j = 0; j < delete_xid_count; j++)
-               {
-                  if (delete_xids[j] == del->xmax)
-                  {
-                     already_exists = 1;
-                     break;
-                  }
-               }
+   *wal_path = path;
 
-               if (already_exists)
-               {
-                  continue;
-               }
+   return 0;
 
-               if (delete_xid_count == delete_xid_capacity)
-               {
-                  delete_xid_capacity *= 2;
-                  transaction_id* new_delete_xids = realloc(delete_xids, delete_xid_capacity * sizeof(transaction_id));
-                  if (!new_delete_xids)
-                  {
-                     pgmoneta_deque_iterator_destroy(iter);
-                     free(delete_xids);
-                     return 1;
-                  }
-                  delete_xids = new_delete_xids;
-               }
+error:
 
-               delete_xids[delete_xid_count++] = del->xmax;
-            }
-         }
-      }
-      pgmoneta_deque_iterator_destroy(iter);
-   }
+   free(tmp_wal);
+   free(stripped);
+   free(path);
+
+   return 1;
+}
 
-   /* Pass 2: mark matching records as NOOP */
-   for (int i = 0; i < *file_count; i++)
+static void
+do_prepare(struct worker_common* wc)
+{
+   struct walfilter_input* wi = (struct walfilter_input*)wc;
+
+   wi->success = false;
+
+   if (prepare_walfile(wi->source, &wi->wal_path))
    {
-      struct walfile* wf = (*walfiles)[i];
-      if (wf == NULL || wf->records == NULL)
+      if (wc->workers != NULL)
       {
-         continue;
+         wc->workers->outcome = false;
       }
+   }
+   else
+   {
+      wi->success = true;
+   }
+}
 
-      struct deque_iterator* rec_iter = NULL;
-      pgmoneta_deque_iterator_create(wf->records, &rec_iter);
+static void
+do_filter_and_write(struct worker_common* wc)
+{
+   int records_marked = 0;
+   struct walfilter_input* wi = (struct walfilter_input*)wc;
 
-      while (pgmoneta_deque_iterator_next(rec_iter))
-      {
-         struct decoded_xlog_record* rec = (struct decoded_xlog_record*)rec_iter->value->data;
-         int match = 0;
+   wi->success = false;
 
-         if (rec->header.xl_rmid == RM_HEAP_ID)
-         {
-            uint8_t info = rec->header.xl_info & ~XLR_INFO_MASK;
-            info &= XLOG_HEAP_OPMASK;
-            if (info == XLOG_HEAP_DELETE)
-            {
-               match = 1;
-            }
-         }
+   if (apply_predicate(wi->wf, wi->predicate, &records_marked))
+   {
+      pgmoneta_log_error("Failed to apply filter on %s", wi->source);
+      goto error;
+   }
 
-         if (!match)
-         {
-            if (XID_IS_DELETED(rec->header.xl_xid) || XID_IS_DELETED(rec->toplevel_xid))
-            {
-               match = 1;
-            }
-         }
+   atomic_fetch_add(wi->records_marked, records_marked);
 
-         if (match)
-         {
-            /* Change to NOOP (RM_XLOG, XLOG_NOOP) */
-            rec->header.xl_info = XLOG_NOOP;
-            rec->header.xl_rmid = RM_XLOG_ID;
+   if (records_marked > 0 && process_walfile(wi->wf))
+   {
+      pgmoneta_log_error("Failed to recalculate CRCs for %s", wi->source);
+      goto error;
+   }
 
-            records_marked++;
-         }
-      }
-      pgmoneta_deque_iterator_destroy(rec_iter);
+   if (pgmoneta_write_walfile(wi->wf, -1, wi->target))
+   {
+      pgmoneta_log_error("Failed to write WAL file %s", wi->target);
+      goto error;
    }
 
-   pgmoneta_log_debug("Total records marked as NOOP: %d", records_marked);
-   pgmoneta_log_debug("Total XIDs collected from DELETE: %d", delete_xid_count);
-   if (delete_xid_count > 0)
+   pgmoneta_log_debug("WAL file written successfully: %s", wi->target);
+
+   wi->success = true;
+
+   return;
+
+error:
+
+   if (wc->workers != NULL)
    {
-      char* delete_xids_str = NULL;
-      for (int i = 0; i < delete_xid_count; i++)
+      wc->workers->outcome = false;
+   }
+}
+
+/**
+ * Mark the records matching the predicate as NOOP in a single pass.
+ * Only the record headers and the top-level XID are inspected
+ *
+ * @param wf The WAL file
+ * @param predicate The filter predicate
+ * @param records_marked The number of records marked
+ * @return 0 on success, otherwise 1
+ */
+static int
+apply_predicate(struct walfile* wf, struct walfilter_predicate* predicate, int* records_marked)
+{
+   struct deque_iterator* iter = NULL;
+   struct decoded_xlog_record* rec = NULL;
+   bool match = false;
+
+   *records_marked = 0;
+
+   if (wf == NULL || wf->records == NULL)
+   {
+      return 0;
+   }
+
+   if (!predicate->delete_operation && predicate->xid_count == 0)
+   {
+      return 0;
+   }
+
+   if (pgmoneta_deque_iterator_create(wf->records, &iter))
+   {
+      pgmoneta_log_error("Failed to create iterator for WAL file records");
+      goto error;
+   }
+
+   while (pgmoneta_deque_iterator_next(iter))
+   {
+      rec = (struct decoded_xlog_record*)iter->value->data;
+
+      match = (predicate->delete_operation && is_heap_delete(&rec->header)) ||
+              xid_is_filtered(predicate->delete_xids, predicate->delete_xid_count, rec->header.xl_xid) ||
+              xid_is_filtered(predicate->delete_xids, predicate->delete_xid_count, rec->toplevel_xid) ||
+              xid_is_filtered(predicate->xids, predicate->xid_count, rec->header.xl_xid) ||
+              xid_is_filtered(predicate->xids, predicate->xid_count, rec->toplevel_xid);
+
+      if (match)
       {
-         delete_xids_str = pgmoneta_format_and_append(delete_xids_str, "%u%s", delete_xids[i], (i < delete_xid_count - 1) ? ", " : "");
+         /* Change to NOOP (RM_XLOG, XLOG_NOOP) */
+         rec->header.xl_info = XLOG_NOOP;
+         rec->header.xl_rmid = RM_XLOG_ID;
+
+         (*records_marked)++;
       }
-      pgmoneta_log_debug("Collected XIDs: %s", delete_xids_str ? delete_xids_str : "");
-      free(delete_xids_str);
    }
 
-   free(delete_xids);
+   pgmoneta_deque_iterator_destroy(iter);
 
    return 0;
+
+error:
+
+   return 1;
 }
 
 /**
- * Filter out records with specific XIDs from WAL files
+ * Collect the XIDs of the DELETE operations. The record header is checked
+ * before the main data is touched
  *
- * @param file_count Pointer to the number of WAL files
- * @param walfiles Pointer to the array of WAL file pointers
- * @param xids Array of XIDs to filter out
- * @param xid_count Number of XIDs in the array
- * @return 0 on success, non-zero on failure
+ * @param walfile_count The number of WAL files
+ * @param inputs The WAL file inputs
+ * @param predicate The filter predicate
+ * @return 0 on success, otherwise 1
  */
-int
-pgmoneta_filter_xids(int* file_count, struct walfile*** walfiles, int* xids, int xid_count)
+static int
+collect_delete_xids(int walfile_count, struct walfilter_input** inputs, struct walfilter_predicate* predicate)
 {
-#define XID_IS_FILTERED(xid) \
-        ({ int found = 0; \
-           for (int k = 0; k < xid_count; k++) { \
-              if ((transaction_id) xids[k] == (xid)) { found = 1; break; } \
-           } found; })
-
-   int match = 0;
-   struct deque_iterator* rec_iter = NULL;
-   struct decoded_xlog_record* rec = NULL;
+   int capacity = 16;
+   struct deque_iterator* iter = NULL;
 
-   if (xids == NULL || xid_count <= 0)
+   predicate->delete_xid_count = 0;
+   predicate->delete_xids = malloc(capacity * sizeof(transaction_id));
+   if (predicate->delete_xids == NULL)
    {
-      goto done;
+      goto error;
    }
 
-   /* Mark matching records as NOOP */
-   for (int i = 0; i < *file_count; i++)
+   for (int i = 0; i < walfile_count; i++)
    {
-      struct walfile* wf = (*walfiles)[i];
+      struct walfile* wf = inputs[i]->wf;
+
       if (wf == NULL || wf->records == NULL)
       {
          continue;
       }
 
-      rec_iter = NULL;
-      if (pgmoneta_deque_iterator_create(wf->records, &rec_iter))
+      if (pgmoneta_deque_iterator_create(wf->records, &iter))
       {
          pgmoneta_log_error("Failed to create iterator for WAL file records");
          goto error;
       }
 
-      while (pgmoneta_deque_iterator_next(rec_iter))
+      while (pgmoneta_deque_iterator_next(iter))
       {
-         rec = (struct decoded_xlog_record*)rec_iter->value->data;
-         match = 0;
+         struct decoded_xlog_record* rec = (struct decoded_xlog_record*)iter->value->data;
+         struct xl_heap_delete* del = NULL;
 
-         /* Check if the record's XID or toplevel_xid matches any of the filtered XIDs */
-         if (XID_IS_FILTERED(rec->header.xl_xid) || XID_IS_FILTERED(rec->toplevel_xid))
+         if (!is_heap_delete(&rec->header))
          {
-            match = 1;
+            continue;
          }
 
-         if (match)
+         del = (struct xl_heap_delete*)rec->main_data;
+         if (del == NULL)
          {
-            /* Change to NOOP (RM_XLOG, XLOG_NOOP) */
-            rec->header.xl_info = XLOG_NOOP;
-            rec->header.xl_rmid = RM_XLOG_ID;
+            continue;
+         }
+
+         if (predicate->delete_xid_count == capacity)
+         {
+            transaction_id* new_delete_xids = NULL;
+
+            capacity *= 2;
+            new_delete_xids = realloc(predicate->delete_xids, capacity * sizeof(transaction_id));
+            if (new_delete_xids == NULL)
+            {
+               goto error;
+            }
+            predicate->delete_xids = new_delete_xids;
          }
+
+         predicate->delete_xids[predicate->delete_xid_count++] = del->xmax;
       }
-      pgmoneta_deque_iterator_destroy(rec_iter);
+
+      pgmoneta_deque_iterator_destroy(iter);
+      iter = NULL;
    }
 
-   if (xid_count > 0)
+   predicate->delete_xid_count = sort_xids(predicate->delete_xids, predicate->delete_xid_count);
+
+   pgmoneta_log_debug("Total XIDs collected from DELETE: %d", predicate->delete_xid_count);
+   if (predicate->delete_xid_count > 0)
    {
-      char* filter_xids_str = NULL;
-      for (int i = 0; i < xid_count; i++)
+      char* delete_xids_str = NULL;
+      for (int i = 0; i < predicate->delete_xid_count; i++)
       {
-         filter_xids_str = pgmoneta_format_and_append(filter_xids_str, "%u%s", xids[i], (i < xid_count - 1) ? ", " : "");
+         delete_xids_str = pgmoneta_format_and_append(delete_xids_str, "%u%s", predicate->delete_xids[i],
+                                                      (i < predicate->delete_xid_count - 1) ? ", " : "");
       }
-      pgmoneta_log_debug("Filtered XIDs: %s", filter_xids_str ? filter_xids_str : "");
-      free(filter_xids_str);
+      pgmoneta_log_debug("Collected XIDs: %s", delete_xids_str ? delete_xids_str : "");
+      free(delete_xids_str);
    }
 
-done:
    return 0;
 
 error:
-   if (rec_iter)
+
+   pgmoneta_deque_iterator_destroy(iter);
+
+   return 1;
+}
+
+static bool
+is_heap_delete(struct xlog_record* record)
+{
+   uint8_t info;
+
+   if (record->xl_rmid != RM_HEAP_ID)
    {
-      pgmoneta_deque_iterator_destroy(rec_iter);
-      rec_iter = NULL;
+      return false;
    }
 
-   return 1;
+   info = record->xl_info & ~XLR_INFO_MASK;
+   info &= XLOG_HEAP_OPMASK;
+
+   return info == XLOG_HEAP_DELETE;
+}
+
+/**
+ * Only the main data of the heap DELETE records is needed, for their xmax.
+ * Every other record is marked, and written, based on its header and the
+ * top-level XID the reader picks out of its block headers
+ *
+ * @param record The record header
+ * @param data The filter predicate
+ * @return true if the record is decoded, otherwise false
+ */
+static bool
+needs_decoding(struct xlog_record* record, void* data)
+{
+   struct walfilter_predicate* predicate = (struct walfilter_predicate*)data;
+
+   return predicate->delete_operation && is_heap_delete(record);
+}
+
+static bool
+xid_is_filtered(transaction_id* xids, int xid_count, transaction_id xid)
+{
+   if (xid_count == 0)
+   {
+      return false;
+   }
+
+   if (xid < xids[0] || xid > xids[xid_count - 1])
+   {
+      return false;
+   }
+
+   return bsearch(&xid, xids, xid_count, sizeof(transaction_id), compare_xid) != NULL;
+}
+
+static int
+compare_xid(const void* a, const void* b)
+{
+   transaction_id x = *(const transaction_id*)a;
+   transaction_id y = *(const transaction_id*)b;
+
+   return (x > y) - (x < y);
+}
+
+/**
+ * Sort the XIDs and remove the duplicates
+ *
+ * @param xids The XIDs
+ * @param xid_count The number of XIDs
+ * @return The number of unique XIDs
+ */
+static int
+sort_xids(transaction_id* xids, int xid_count)
+{
+   int unique = 0;
+
+   if (xid_count <= 1)
+   {
+      return xid_count;
+   }
+
+   qsort(xids, xid_count, sizeof(transaction_id), compare_xid);
+
+   for (int i = 1; i < xid_count; i++)
+   {
+      if (xids[i] != xids[unique])
+      {
+         xids[++unique] = xids[i];
+      }
+   }
+
+   return unique + 1;
+}
+
+static int
+get_number_of_workers(config_t* yaml_config)
+{
+   int nw = yaml_config->workers;
+
+   if (nw <= 0)
+   {
+#ifdef HAVE_LINUX
+      nw = get_nprocs();
+#else
+      nw = 16;
+#endif
+   }
+
+   return MAX(nw, 1);
+}
+
+static void
+destroy_inputs(struct walfilter_input** inputs, int count)
+{
+   if (inputs == NULL)
+   {
+      return;
+   }
+
+   for (int i = 0; i < count; i++)
+   {
+      if (inputs[i] != NULL)
+      {
+         if (inputs[i]->wf != NULL)
+         {
+            pgmoneta_destroy_walfile(inputs[i]->wf);
+         }
+         free(inputs[i]->wal_path);
+         free(inputs[i]);
+      }
+   }
+
+   free(inputs);
+}
+
+static void
+destroy_partial_record(void)
+{
+   if (partial_record != NULL)
+   {
+      if (partial_record->xlog_record != NULL)
+      {
+         free(partial_record->xlog_record);
+         partial_record->xlog_record = NULL;
+      }
+      if (partial_record->data_buffer != NULL)
+      {
+         free(partial_record->data_buffer);
+         partial_record->data_buffer = NULL;
+      }
+      free(partial_record);
+      partial_record = NULL;
+   }
 }
 
 int
@@ -480,20 +728,21 @@ main(int argc, char* argv[])
    char* logfile = NULL;
    int file_count = 0;
    char** files = NULL;
-   char* file_path = NULL;
    char* wal_files_path = NULL;
    int loaded = 1;
    char* configuration_path = NULL;
    size_t size;
-   char* tmp_wal = NULL;
-   struct walfile* wf = NULL;
-   char* decompressed_file_name = NULL;
-   char* decrypted_file_name = NULL;
-   char* wal_path = NULL;
-   bool copy = true;
-   struct walfile** walfiles = NULL;
-   int walfile_count = 0;
-   char* target_pg_wal_dir = NULL;
+   struct walfilter_input** inputs = NULL;
+   struct walfilter_predicate predicate = {0};
+   struct workers* workers = NULL;
+   int number_of_workers = 0;
+   atomic_int records_marked;
+   uint64_t records = 0;
+   uint64_t bytes = 0;
+   struct timespec start_t;
+   struct timespec end_t;
+   double elapsed = 0;
+   bool quiet = false;
    int optind = 0;
    char* yaml_file = NULL;
    int num_results = 0;
@@ -507,6 +756,9 @@ main(int argc, char* argv[])
    num_options = sizeof(options) / sizeof(options[0]);
    cli_result results[num_options];
 
+   atomic_init(&records_marked, 0);
+   memset(&yaml_config, 0, sizeof(config_t));
+
    if (argc < 2)
    {
       usage();
@@ -534,8 +786,11 @@ main(int argc, char* argv[])
       {
          configuration_path = optarg;
       }
+      else if (!strcmp(optname, "q") || !strcmp(optname, "quiet"))
+      {
+         quiet = true;
+      }
    }
-
    if (yaml_file == NULL)
    {
       warnx("Missing <yaml_config_file> argument");
@@ -628,138 +883,155 @@ main(int argc, char* argv[])
       goto error;
    }
 
-   partial_record = malloc(sizeof(struct partial_xlog_record));
-   if (partial_record == NULL)
-   {
-      pgmoneta_log_error("Failed to allocate memory for partial_record");
-      goto error;
-   }
-
-   partial_record->data_buffer_bytes_read = 0;
-   partial_record->xlog_record_bytes_read = 0;
-   partial_record->xlog_record = NULL;
-   partial_record->data_buffer = NULL;
-
-   walfiles = malloc(file_count * sizeof(struct walfile*));
-   if (walfiles == NULL)
+   inputs = calloc(file_count, sizeof(struct walfilter_input*));
+   if (inputs == NULL && file_count > 0)
    {
-      pgmoneta_log_error("Failed to allocate memory for walfiles array");
+      pgmoneta_log_error("Failed to allocate memory for WAL file inputs");
       goto error;
    }
 
    for (int i = 0; i < file_count; i++)
    {
-      walfiles[i] = NULL;
-   }
-
-   for (int i = 0; i < file_count; i++)
-   {
-      file_path = malloc(MAX_PATH);
-      snprintf(file_path, MAX_PATH, "%s/%s", wal_files_path, files[i]);
+      char* name = NULL;
 
-      if (!pgmoneta_is_file(file_path))
+      inputs[i] = calloc(1, sizeof(struct walfilter_input));
+      if (inputs[i] == NULL)
       {
-         pgmoneta_log_fatal("WAL file at %s does not exist", file_path);
+         pgmoneta_log_error("Failed to allocate memory for WAL file input");
          goto error;
       }
 
-      free(wal_path);
-      wal_path = NULL;
-      wal_path = pgmoneta_append(wal_path, file_path);
+      snprintf(inputs[i]->source, MAX_PATH, "%s/%s", wal_files_path, files[i]);
 
-      if (pgmoneta_is_encrypted(wal_path))
+      if (!pgmoneta_is_file(inputs[i]->source))
       {
-         free(tmp_wal);
-         tmp_wal = NULL;
-         tmp_wal = pgmoneta_format_and_append(tmp_wal, "/tmp/%s", basename(wal_path));
-
-         pgmoneta_copy_file(wal_path, tmp_wal, NULL);
-         copy = false;
-
-         pgmoneta_strip_extension(basename(wal_path), &decrypted_file_name);
-
-         free(wal_path);
-         wal_path = NULL;
-
-         wal_path = pgmoneta_format_and_append(wal_path, "/tmp/%s", decrypted_file_name);
-         free(decrypted_file_name);
-         decrypted_file_name = NULL;
+         pgmoneta_log_fatal("WAL file at %s does not exist", inputs[i]->source);
+         goto error;
+      }
 
-         if (pgmoneta_decrypt_file(tmp_wal, wal_path))
+      name = pgmoneta_append(name, files[i]);
+      if (pgmoneta_is_compressed(name) || pgmoneta_is_encrypted(name))
+      {
+         // Remove extension for compressed or encrypted files
+         char* dot = strrchr(name, '.');
+         if (dot != NULL)
          {
-            pgmoneta_log_fatal("Failed to decrypt WAL file at %s", file_path);
-            goto error;
+            *dot = '\0';
          }
       }
+      snprintf(inputs[i]->target, MAX_PATH, "%s/%s", yaml_config.target_dir, name);
+      free(name);
+
+      inputs[i]->predicate = &predicate;
+      inputs[i]->records_marked = &records_marked;
+   }
 
-      if (pgmoneta_is_compressed(wal_path))
+   number_of_workers = get_number_of_workers(&yaml_config);
+   if (number_of_workers > 1)
+   {
+      if (pgmoneta_workers_initialize(number_of_workers, &workers))
       {
-         free(tmp_wal);
-         tmp_wal = NULL;
+         pgmoneta_log_error("Failed to initialize %d workers", number_of_workers);
+         goto error;
+      }
+   }
 
-         tmp_wal = pgmoneta_format_and_append(tmp_wal, "/tmp/%s", basename(wal_path));
+   pgmoneta_log_debug("Using %d workers", number_of_workers);
 
-         if (copy)
-         {
-            pgmoneta_copy_file(wal_path, tmp_wal, NULL);
-         }
+#ifdef HAVE_FREEBSD
+   clock_gettime(CLOCK_MONOTONIC_FAST, &start_t);
+#else
+   clock_gettime(CLOCK_MONOTONIC_RAW, &start_t);
+#endif
 
-         pgmoneta_strip_extension(basename(wal_path), &decompressed_file_name);
+   /* Stage 1: decrypt and decompress in parallel */
+   for (int i = 0; i < file_count; i++)
+   {
+      inputs[i]->common.workers = workers;
 
-         free(wal_path);
-         wal_path = NULL;
+      if (workers != NULL)
+      {
+         pgmoneta_workers_add(workers, do_prepare, (struct worker_common*)inputs[i]);
+      }
+      else
+      {
+         do_prepare((struct worker_common*)inputs[i]);
+      }
+   }
 
-         wal_path = pgmoneta_format_and_append(wal_path, "/tmp/%s", decompressed_file_name);
-         free(decompressed_file_name);
-         decompressed_file_name = NULL;
+   pgmoneta_workers_wait(workers);
 
-         if (pgmoneta_decompress(tmp_wal, wal_path))
-         {
-            pgmoneta_log_fatal("Failed to decompress WAL file at %s", file_path);
-            goto error;
-         }
+   for (int i = 0; i < file_count; i++)
+   {
+      if (!inputs[i]->success)
+      {
+         goto error;
       }
+   }
 
-      if (pgmoneta_read_walfile(-1, wal_path, &wf))
+   /* Build the predicate */
+   for (int i = 0; i < yaml_config.operation_count; i++)
+   {
+      if (!strcmp(yaml_config.operations[i], OPERATION_DELETE))
+      {
+         predicate.delete_operation = true;
+      }
+   }
+
+   if (yaml_config.xid_count > 0)
+   {
+      predicate.xids = malloc(yaml_config.xid_count * sizeof(transaction_id));
+      if (predicate.xids == NULL)
       {
-         pgmoneta_log_fatal("Failed to read WAL file at %s", file_path);
+         pgmoneta_log_error("Failed to allocate memory for XIDs");
          goto error;
       }
 
-      walfiles[walfile_count] = wf;
-      walfile_count++;
-      wf = NULL;
+      for (int i = 0; i < yaml_config.xid_count; i++)
+      {
+         predicate.xids[i] = (transaction_id)yaml_config.xids[i];
+      }
 
-      free(file_path);
-      file_path = NULL;
+      predicate.xid_count = sort_xids(predicate.xids, yaml_config.xid_count);
+   }
+
+   /* Stage 2: parse in order, since records can continue into the next segment */
+   partial_record = malloc(sizeof(struct partial_xlog_record));
+   if (partial_record == NULL)
+   {
+      pgmoneta_log_error("Failed to allocate memory for partial_record");
+      goto error;
    }
 
-   if (yaml_config.operation_count > 0)
+   partial_record->data_buffer_bytes_read = 0;
+   partial_record->xlog_record_bytes_read = 0;
+   partial_record->xlog_record = NULL;
+   partial_record->data_buffer = NULL;
+
+   for (int i = 0; i < file_count; i++)
    {
-      for (int i = 0; i < yaml_config.operation_count; i++)
+      if (pgmoneta_read_walfile_filtered(-1, inputs[i]->wal_path, needs_decoding, &predicate, &inputs[i]->wf))
       {
-         if (!strcmp(yaml_config.operations[i], OPERATION_DELETE))
-         {
-            if (pgmoneta_filter_operation_delete(&walfile_count, &walfiles))
-            {
-               pgmoneta_log_error("Failed to apply filter on operation %s", yaml_config.operations[i]);
-               goto error;
-            }
-         }
+         pgmoneta_log_fatal("Failed to read WAL file at %s", inputs[i]->source);
+         goto error;
+      }
+
+      bytes += pgmoneta_get_file_size(inputs[i]->wal_path);
+      if (inputs[i]->wf->records != NULL)
+      {
+         records += pgmoneta_deque_size(inputs[i]->wf->records);
       }
    }
 
-   if (yaml_config.xid_count > 0)
+   if (predicate.delete_operation)
    {
-      if (pgmoneta_filter_xids(&walfile_count, &walfiles, yaml_config.xids, yaml_config.xid_count))
+      if (collect_delete_xids(file_count, inputs, &predicate))
       {
-         pgmoneta_log_error("Failed to apply filter on XIDs");
+         pgmoneta_log_error("Failed to apply filter on operation %s", OPERATION_DELETE);
          goto error;
       }
    }
 
-   pgmoneta_process_walfiles(walfile_count, walfiles);
-
    if (pgmoneta_exists(yaml_config.target_dir))
    {
       if (pgmoneta_delete_directory(yaml_config.target_dir))
@@ -775,96 +1047,62 @@ main(int argc, char* argv[])
       goto error;
    }
 
-   target_pg_wal_dir = pgmoneta_append(target_pg_wal_dir, yaml_config.target_dir);
-
-   if (chdir(target_pg_wal_dir))
-   {
-      pgmoneta_log_error("Failed to change directory to %s", target_pg_wal_dir);
-      goto error;
-   }
-
-   for (int i = 0; i < walfile_count; i++)
+   /* Stage 3: filter, recalculate the CRCs and write in parallel */
+   for (int i = 0; i < file_count; i++)
    {
-      if (pgmoneta_is_compressed(files[i]) || pgmoneta_is_encrypted(files[i]))
-      {
-         // Remove extension for compressed or encrypted files
-         char* dot = strrchr(files[i], '.');
-         if (dot != NULL)
-         {
-            *dot = '\0';
-         }
-      }
-
-      if (pgmoneta_write_walfile(walfiles[i], -1, files[i]))
+      if (workers != NULL)
       {
-         pgmoneta_log_error("Failed to write WAL file %d", i);
-         goto error;
+         pgmoneta_workers_add(workers, do_filter_and_write, (struct worker_common*)inputs[i]);
       }
       else
       {
-         pgmoneta_log_debug("WAL file %d written successfully: %s", i, files[i]);
+         do_filter_and_write((struct worker_common*)inputs[i]);
       }
    }
 
-   pgmoneta_log_info("Filtered WAL files written successfully to %s", target_pg_wal_dir);
-
-   if (target_pg_wal_dir != NULL)
-   {
-      free(target_pg_wal_dir);
-      target_pg_wal_dir = NULL;
-   }
+   pgmoneta_workers_wait(workers);
 
-   if (walfiles != NULL)
+   for (int i = 0; i < file_count; i++)
    {
-      for (int i = 0; i < walfile_count; i++)
+      if (!inputs[i]->success)
       {
-         if (walfiles[i] != NULL)
-         {
-            pgmoneta_destroy_walfile(walfiles[i]);
-            walfiles[i] = NULL;
-         }
+         goto error;
       }
-      free(walfiles);
-      walfiles = NULL;
    }
 
-   free(tmp_wal);
-   tmp_wal = NULL;
-   free(wal_path);
-   wal_path = NULL;
-   if (partial_record != NULL)
+#ifdef HAVE_FREEBSD
+   clock_gettime(CLOCK_MONOTONIC_FAST, &end_t);
+#else
+   clock_gettime(CLOCK_MONOTONIC_RAW, &end_t);
+#endif
+
+   elapsed = pgmoneta_compute_duration(start_t, end_t);
+
+   pgmoneta_log_debug("Total records marked as NOOP: %d", atomic_load(&records_marked));
+   pgmoneta_log_info("Filtered WAL files written successfully to %s", yaml_config.target_dir);
+
+   if (!quiet)
    {
-      if (partial_record->xlog_record != NULL)
+      printf("Processed %" PRIu64 " records (%" PRIu64 " bytes) in %d WAL files in %.3f seconds\n",
+             records, bytes, file_count, elapsed);
+      if (elapsed > 0)
       {
-         free(partial_record->xlog_record);
-         partial_record->xlog_record = NULL;
-      }
-      if (partial_record->data_buffer != NULL)
-      {
-         free(partial_record->data_buffer);
-         partial_record->data_buffer = NULL;
+         printf("Throughput: %.0f records/s, %.0f bytes/s\n", records / elapsed, bytes / elapsed);
       }
-      free(partial_record);
-      partial_record = NULL;
-   }
-   if (file_path != NULL)
-   {
-      free(file_path);
-      file_path = NULL;
-   }
-   if (wal_files_path != NULL)
-   {
-      free(wal_files_path);
-      wal_files_path = NULL;
+      printf("Records marked as NOOP: %d\n", atomic_load(&records_marked));
    }
+
+   pgmoneta_workers_destroy(workers);
+   destroy_inputs(inputs, file_count);
+   destroy_partial_record();
+   free(predicate.xids);
+   free(predicate.delete_xids);
+   free(wal_files_path);
    if (files)
    {
       for (int i = 0; i < file_count; i++)
       {
-         if (files[i] != NULL)
-         {
-            free(files[i]);
-         }
+         free(files[i]);
       }
       free(files);
       files = NULL;
@@ -880,63 +1118,18 @@ main(int argc, char* argv[])
    return 0;
 
 error:
-   if (target_pg_wal_dir != NULL)
-   {
-      free(target_pg_wal_dir);
-      target_pg_wal_dir = NULL;
-   }
-
-   if (walfiles != NULL)
-   {
-      for (int i = 0; i < walfile_count; i++)
-      {
-         if (walfiles[i] != NULL)
-         {
-            pgmoneta_destroy_walfile(walfiles[i]);
-            walfiles[i] = NULL;
-         }
-      }
-      free(walfiles);
-      walfiles = NULL;
-   }
-
-   free(tmp_wal);
-   tmp_wal = NULL;
-   free(wal_path);
-   wal_path = NULL;
-   if (partial_record != NULL)
-   {
-      if (partial_record->xlog_record != NULL)
-      {
-         free(partial_record->xlog_record);
-         partial_record->xlog_record = NULL;
-      }
-      if (partial_record->data_buffer != NULL)
-      {
-         free(partial_record->data_buffer);
-         partial_record->data_buffer = NULL;
-      }
-      free(partial_record);
-      partial_record = NULL;
-   }
-   if (file_path != NULL)
-   {
-      free(file_path);
-      file_path = NULL;
-   }
-   if (wal_files_path != NULL)
-   {
-      free(wal_files_path);
-      wal_files_path = NULL;
-   }
+   pgmoneta_workers_wait(workers);
+   pgmoneta_workers_destroy(workers);
+   destroy_inputs(inputs, file_count);
+   destroy_partial_record();
+   free(predicate.xids);
+   free(predicate.delete_xids);
+   free(wal_files_path);
    if (files)
    {
       for (int i = 0; i < file_count; i++)
       {
-         if (files[i] != NULL)
-         {
-            free(files[i]);
-         }
+         free(files[i]);
       }
       free(files);
       files = NULL;
@@ -0,0 +1,211 @@
+/*
+ * Copyright (C) 2025 The pgmoneta community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* pgmoneta */
+#include <pgmoneta.h>
+#include <art.h>
+#include <link.h>
+#include <manifest.h>
+#include <tsbenchmark.h>
+#include <utils.h>
+
+/* system */
+#include <stdlib.h>
+#include <sys/stat.h>
+
+/** @struct manifest_state
+ * Defines the manifests of two consecutive backups
+ */
+struct manifest_state
+{
+   char* old_manifest; /**< The manifest of the older backup */
+   char* new_manifest; /**< The manifest of the newer backup */
+};
+
+/** @struct link_state
+ * Defines the directories of two consecutive backups
+ */
+struct link_state
+{
+   char* previous; /**< The older backup */
+   char* current;  /**< The newer backup, linked against the older one */
+};
+
+static int manifest_setup(struct benchmark_context* context);
+static int manifest_run(struct benchmark_context* context);
+static void manifest_teardown(struct benchmark_context* context);
+
+static int link_setup(struct benchmark_context* context);
+static int link_reset(struct benchmark_context* context);
+static int link_run(struct benchmark_context* context);
+static void link_teardown(struct benchmark_context* context);
+
+static struct benchmark benchmarks[] = {
+   {"manifest_compare", NULL, manifest_setup, NULL, manifest_run, manifest_teardown},
+   {"link_comparefiles", NULL, link_setup, link_reset, link_run, link_teardown},
+};
+
+struct benchmark*
+pgmoneta_benchmark_backup(int* number)
+{
+   *number = sizeof(benchmarks) / sizeof(struct benchmark);
+
+   return &benchmarks[0];
+}
+
+static int
+manifest_setup(struct benchmark_context* context)
+{
+   struct stat st;
+   struct manifest_state* state = NULL;
+
+   state = (struct manifest_state*)calloc(1, sizeof(struct manifest_state));
+   if (state == NULL)
+   {
+      return 1;
+   }
+
+   context->data = state;
+
+   state->old_manifest = pgmoneta_benchmark_path(context, "old_manifest.csv");
+   state->new_manifest = pgmoneta_benchmark_path(context, "new_manifest.csv");
+
+   if (pgmoneta_benchmark_generate_manifest(context->options, state->old_manifest, 0) ||
+       pgmoneta_benchmark_generate_manifest(context->options, state->new_manifest, 1))
+   {
+      return 1;
+   }
+
+   context->bytes = 0;
+   if (!stat(state->old_manifest, &st))
+   {
+      context->bytes += st.st_size;
+   }
+   if (!stat(state->new_manifest, &st))
+   {
+      context->bytes += st.st_size;
+   }
+   context->items = context->options->manifest_entries;
+
+   return 0;
+}
+
+static int
+manifest_run(struct benchmark_context* context)
+{
+   struct manifest_state* state = (struct manifest_state*)context->data;
+   struct art* deleted_files = NULL;
+   struct art* changed_files = NULL;
+   struct art* added_files = NULL;
+   int ret;
+
+   ret = pgmoneta_compare_manifests(state->old_manifest, state->new_manifest, &deleted_files, &changed_files, &added_files);
+
+   pgmoneta_art_destroy(deleted_files);
+   pgmoneta_art_destroy(changed_files);
+   pgmoneta_art_destroy(added_files);
+
+   return ret;
+}
+
+static void
+manifest_teardown(struct benchmark_context* context)
+{
+   struct manifest_state* state = (struct manifest_state*)context->data;
+
+   if (state != NULL)
+   {
+      pgmoneta_delete_file(state->old_manifest, NULL);
+      pgmoneta_delete_file(state->new_manifest, NULL);
+      free(state->old_manifest);
+      free(state->new_manifest);
+      free(state);
+   }
+   context->data = NULL;
+}
+
+static int
+link_setup(struct benchmark_context* context)
+{
+   uint64_t bytes = 0;
+   struct link_state* state = NULL;
+
+   state = (struct link_state*)calloc(1, sizeof(struct link_state));
+   if (state == NULL)
+   {
+      return 1;
+   }
+
+   context->data = state;
+
+   state->previous = pgmoneta_benchmark_path(context, "previous");
+   state->current = pgmoneta_benchmark_path(context, "current");
+
+   context->items = context->options->files;
+
+   return pgmoneta_benchmark_generate_pgdata(context->options, state->previous, 0, &bytes);
+}
+
+static int
+link_reset(struct benchmark_context* context)
+{
+   struct link_state* state = (struct link_state*)context->data;
+
+   pgmoneta_delete_directory(state->current);
+
+   return pgmoneta_benchmark_generate_pgdata(context->options, state->current, 1, &context->bytes);
+}
+
+static int
+link_run(struct benchmark_context* context)
+{
+   struct link_state* state = (struct link_state*)context->data;
+
+   if (pgmoneta_link_comparefiles(state->current, state->previous, context->workers))
+   {
+      return 1;
+   }
+
+   return pgmoneta_benchmark_wait(context);
+}
+
+static void
+link_teardown(struct benchmark_context* context)
+{
+   struct link_state* state = (struct link_state*)context->data;
+
+   if (state != NULL)
+   {
+      pgmoneta_delete_directory(state->current);
+      pgmoneta_delete_directory(state->previous);
+      free(state->current);
+      free(state->previous);
+      free(state);
+   }
+   context->data = NULL;
+}
@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2025 The pgmoneta community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* pgmoneta */
+#include <pgmoneta.h>
+#include <aes.h>
+#include <bzip2_compression.h>
+#include <gzip_compression.h>
+#include <lz4_compression.h>
+#include <tsbenchmark.h>
+#include <utils.h>
+#include <zstandard_compression.h>
+
+/* system */
+#include <stdlib.h>
+
+/** @struct data_operation
+ * Defines an in place operation on a data directory
+ */
+struct data_operation
+{
+   int (*prepare)(char* directory, struct workers* workers);   /**< The unmeasured preparation, optional */
+   int (*operation)(char* directory, struct workers* workers); /**< The measured operation */
+};
+
+static int zstd_compress_data(char* directory, struct workers* workers);
+static int zstd_decompress_data(char* directory, struct workers* workers);
+
+static int data_setup(struct benchmark_context* context);
+static int data_reset(struct benchmark_context* context);
+static int data_run(struct benchmark_context* context);
+static void data_teardown(struct benchmark_context* context);
+
+static struct data_operation gzip_compress = {NULL, pgmoneta_gzip_data};
+static struct data_operation gzip_decompress = {pgmoneta_gzip_data, pgmoneta_gunzip_data};
+static struct data_operation zstd_compress = {NULL, zstd_compress_data};
+static struct data_operation zstd_decompress = {zstd_compress_data, zstd_decompress_data};
+static struct data_operation lz4_compress = {NULL, pgmoneta_lz4c_data};
+static struct data_operation lz4_decompress = {pgmoneta_lz4c_data, pgmoneta_lz4d_data};
+static struct data_operation bzip2_compress = {NULL, pgmoneta_bzip2_data};
+static struct data_operation bzip2_decompress = {pgmoneta_bzip2_data, pgmoneta_bunzip2_data};
+static struct data_operation aes_encrypt = {NULL, pgmoneta_encrypt_data};
+static struct data_operation aes_decrypt = {pgmoneta_encrypt_data, pgmoneta_decrypt_directory};
+
+static struct benchmark benchmarks[] = {
+   {"compression_gzip", &gzip_compress, data_setup, data_reset, data_run, data_teardown},
+   {"decompression_gzip", &gzip_decompress, data_setup, data_reset, data_run, data_teardown},
+   {"compression_zstd", &zstd_compress, data_setup, data_reset, data_run, data_teardown},
+   {"decompression_zstd", &zstd_decompress, data_setup, data_reset, data_run, data_teardown},
+   {"compression_lz4", &lz4_compress, data_setup, data_reset, data_run, data_teardown},
+   {"decompression_lz4", &lz4_decompress, data_setup, data_reset, data_run, data_teardown},
+   {"compression_bzip2", &bzip2_compress, data_setup, data_reset, data_run, data_teardown},
+   {"decompression_bzip2", &bzip2_decompress, data_setup, data_reset, data_run, data_teardown},
+   {"encryption_aes", &aes_encrypt, data_setup, data_reset, data_run, data_teardown},
+   {"decryption_aes", &aes_decrypt, data_setup, data_reset, data_run, data_teardown},
+};
+
+struct benchmark*
+pgmoneta_benchmark_data(int* number)
+{
+   *number = sizeof(benchmarks) / sizeof(struct benchmark);
+
+   return &benchmarks[0];
+}
+
+static int
+zstd_compress_data(char* directory, struct workers* workers)
+{
+   pgmoneta_zstandardc_data(directory, workers);
+
+   return 0;
+}
+
+static int
+zstd_decompress_data(char* directory, struct workers* workers)
+{
+   pgmoneta_zstandardd_directory(directory, workers);
+
+   return 0;
+}
+
+static int
+data_setup(struct benchmark_context* context)
+{
+   context->data = pgmoneta_benchmark_path(context, "data");
+   context->items = context->options->files;
+
+   return 0;
+}
+
+static int
+data_reset(struct benchmark_context* context)
+{
+   char* directory = (char*)context->data;
+   struct data_operation* op = (struct data_operation*)context->arg;
+
+   pgmoneta_delete_directory(directory);
+
+   if (pgmoneta_benchmark_generate_pgdata(context->options, directory, 0, &context->bytes))
+   {
+      return 1;
+   }
+
+   if (op->prepare != NULL)
+   {
+      if (op->prepare(directory, context->workers))
+      {
+         return 1;
+      }
+
+      return pgmoneta_benchmark_wait(context);
+   }
+
+   return 0;
+}
+
+static int
+data_run(struct benchmark_context* context)
+{
+   struct data_operation* op = (struct data_operation*)context->arg;
+
+   if (op->operation((char*)context->data, context->workers))
+   {
+      return 1;
+   }
+
+   return pgmoneta_benchmark_wait(context);
+}
+
+static void
+data_teardown(struct benchmark_context* context)
+{
+   pgmoneta_delete_directory((char*)context->data);
+   free(context->data);
+   context->data = NULL;
+}
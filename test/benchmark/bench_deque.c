@@ -0,0 +1,211 @@
+/*
+ * Copyright (C) 2025 The pgmoneta community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* pgmoneta */
+#include <pgmoneta.h>
+#include <deque.h>
+#include <tsbenchmark.h>
+
+/* system */
+#include <stdio.h>
+#include <stdlib.h>
+
+static int offer_poll_setup(struct benchmark_context* context);
+static int offer_poll_run(struct benchmark_context* context);
+
+static int lookup_setup(struct benchmark_context* context);
+static int lookup_run(struct benchmark_context* context);
+
+static int remove_reset(struct benchmark_context* context);
+static int remove_run(struct benchmark_context* context);
+
+static void deque_teardown(struct benchmark_context* context);
+static struct deque* tagged_deque(int elements);
+
+static struct benchmark benchmarks[] = {
+   {"deque_offer_poll", NULL, offer_poll_setup, NULL, offer_poll_run, NULL},
+   {"deque_lookup", NULL, lookup_setup, NULL, lookup_run, deque_teardown},
+   {"deque_iterator_remove", NULL, offer_poll_setup, remove_reset, remove_run, deque_teardown},
+};
+
+struct benchmark*
+pgmoneta_benchmark_deque(int* number)
+{
+   *number = sizeof(benchmarks) / sizeof(struct benchmark);
+
+   return &benchmarks[0];
+}
+
+static int
+offer_poll_setup(struct benchmark_context* context)
+{
+   context->items = context->options->deque_elements;
+
+   return 0;
+}
+
+static int
+offer_poll_run(struct benchmark_context* context)
+{
+   int elements = context->options->deque_elements;
+   struct deque* deque = NULL;
+   int ret = 0;
+
+   if (pgmoneta_deque_create(false, &deque))
+   {
+      return 1;
+   }
+
+   /* Offer the whole queue, then drain it from both ends like the workers and the WAL readers */
+   for (int i = 0; i < elements; i++)
+   {
+      if (pgmoneta_deque_add(deque, NULL, (uintptr_t)i, ValueInt32))
+      {
+         ret = 1;
+         goto done;
+      }
+   }
+
+   for (int i = 0; i < elements / 2; i++)
+   {
+      if (pgmoneta_deque_poll(deque, NULL) != (uintptr_t)i)
+      {
+         ret = 1;
+         goto done;
+      }
+   }
+
+   while (!pgmoneta_deque_empty(deque))
+   {
+      pgmoneta_deque_poll_last(deque, NULL);
+   }
+
+done:
+   pgmoneta_deque_destroy(deque);
+
+   return ret;
+}
+
+static int
+lookup_setup(struct benchmark_context* context)
+{
+   context->data = tagged_deque(context->options->deque_elements);
+   context->items = context->options->deque_elements;
+
+   return context->data == NULL ? 1 : 0;
+}
+
+static int
+lookup_run(struct benchmark_context* context)
+{
+   int elements = context->options->deque_elements;
+   struct deque* deque = (struct deque*)context->data;
+   uint64_t state = context->options->seed;
+   uint32_t key = 0;
+   char tag[MISC_LENGTH];
+
+   for (int i = 0; i < elements; i++)
+   {
+      state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+      key = (uint32_t)((state >> 33) % (uint64_t)elements);
+
+      snprintf(&tag[0], sizeof(tag), "%08x", key);
+      if (pgmoneta_deque_get(deque, &tag[0]) != (uintptr_t)key)
+      {
+         return 1;
+      }
+   }
+
+   return 0;
+}
+
+static int
+remove_reset(struct benchmark_context* context)
+{
+   deque_teardown(context);
+
+   context->data = tagged_deque(context->options->deque_elements);
+
+   return context->data == NULL ? 1 : 0;
+}
+
+static int
+remove_run(struct benchmark_context* context)
+{
+   struct deque* deque = (struct deque*)context->data;
+   struct deque_iterator* iter = NULL;
+
+   /* Filter every other entry, like the manifest comparison does for unchanged files */
+   if (pgmoneta_deque_iterator_create(deque, &iter))
+   {
+      return 1;
+   }
+
+   while (pgmoneta_deque_iterator_next(iter))
+   {
+      if (pgmoneta_value_data(iter->value) % 2 == 0)
+      {
+         pgmoneta_deque_iterator_remove(iter);
+      }
+   }
+
+   pgmoneta_deque_iterator_destroy(iter);
+
+   return pgmoneta_deque_size(deque) == (uint32_t)(context->options->deque_elements / 2) ? 0 : 1;
+}
+
+static void
+deque_teardown(struct benchmark_context* context)
+{
+   pgmoneta_deque_destroy((struct deque*)context->data);
+   context->data = NULL;
+}
+
+static struct deque*
+tagged_deque(int elements)
+{
+   struct deque* deque = NULL;
+   char tag[MISC_LENGTH];
+
+   if (pgmoneta_deque_create(false, &deque))
+   {
+      return NULL;
+   }
+
+   for (int i = 0; i < elements; i++)
+   {
+      snprintf(&tag[0], sizeof(tag), "%08x", i);
+      if (pgmoneta_deque_add(deque, &tag[0], (uintptr_t)i, ValueInt32))
+      {
+         pgmoneta_deque_destroy(deque);
+         return NULL;
+      }
+   }
+
+   return deque;
+}
@@ -0,0 +1,244 @@
+/*
+ * Copyright (C) 2025 The pgmoneta community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* pgmoneta */
+#include <pgmoneta.h>
+#include <deque.h>
+#include <info.h>
+#include <json.h>
+#include <prometheus.h>
+#include <restore.h>
+#include <tsbenchmark.h>
+#include <utils.h>
+#include <value.h>
+
+/* system */
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#define PROMETHEUS_REQUEST "GET /metrics HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n"
+
+/** @struct incremental_state
+ * Defines the input of an incremental reconstruction
+ */
+struct incremental_state
+{
+   char* input_dir;            /**< The data directory of the incremental backup */
+   char* output_dir;           /**< The reconstructed data directory */
+   struct backup* backup;      /**< The incremental backup */
+   struct deque* prior_labels; /**< The labels of the prior backups */
+   struct json* manifest;      /**< The manifest of the incremental backup */
+};
+
+static int incremental_setup(struct benchmark_context* context);
+static int incremental_reset(struct benchmark_context* context);
+static int incremental_run(struct benchmark_context* context);
+static void incremental_teardown(struct benchmark_context* context);
+
+static int prometheus_setup(struct benchmark_context* context);
+static int prometheus_run(struct benchmark_context* context);
+
+static struct benchmark benchmarks[] = {
+   {"incremental_reconstruct", NULL, incremental_setup, incremental_reset, incremental_run, incremental_teardown},
+   {"prometheus_metrics", NULL, prometheus_setup, NULL, prometheus_run, NULL},
+};
+
+struct benchmark*
+pgmoneta_benchmark_restore(int* number)
+{
+   *number = sizeof(benchmarks) / sizeof(struct benchmark);
+
+   return &benchmarks[0];
+}
+
+static int
+incremental_setup(struct benchmark_context* context)
+{
+   char* server_dir = NULL;
+   struct incremental_state* state = NULL;
+
+   state = (struct incremental_state*)calloc(1, sizeof(struct incremental_state));
+   if (state == NULL)
+   {
+      return 1;
+   }
+
+   context->data = state;
+
+   if (pgmoneta_benchmark_generate_backups(context->options, &context->bytes))
+   {
+      return 1;
+   }
+
+   context->items = context->options->files;
+
+   /* The combine expects the directories without a trailing slash */
+   state->input_dir = pgmoneta_get_server_backup_identifier_data(BENCHMARK_SERVER, BENCHMARK_INCREMENTAL_LABEL);
+   state->input_dir[strlen(state->input_dir) - 1] = '\0';
+   state->output_dir = pgmoneta_benchmark_path(context, "restore");
+
+   server_dir = pgmoneta_get_server_backup(BENCHMARK_SERVER);
+   pgmoneta_load_info(server_dir, BENCHMARK_INCREMENTAL_LABEL, &state->backup);
+   free(server_dir);
+
+   if (state->backup == NULL)
+   {
+      return 1;
+   }
+
+   if (pgmoneta_deque_create(false, &state->prior_labels))
+   {
+      return 1;
+   }
+
+   return pgmoneta_deque_add(state->prior_labels, NULL, (uintptr_t)BENCHMARK_FULL_LABEL, ValueString);
+}
+
+static int
+incremental_reset(struct benchmark_context* context)
+{
+   char* path = NULL;
+   struct incremental_state* state = (struct incremental_state*)context->data;
+
+   pgmoneta_delete_directory(state->output_dir);
+   pgmoneta_delete_server_workspace(BENCHMARK_SERVER, NULL);
+
+   /* The combine rewrites the manifest entries */
+   pgmoneta_json_destroy(state->manifest);
+   state->manifest = NULL;
+
+   path = pgmoneta_format_and_append(path, "%s/backup_manifest", state->input_dir);
+   if (pgmoneta_json_read_file(path, &state->manifest))
+   {
+      free(path);
+      return 1;
+   }
+   free(path);
+
+   return 0;
+}
+
+static int
+incremental_run(struct benchmark_context* context)
+{
+   struct incremental_state* state = (struct incremental_state*)context->data;
+
+   return pgmoneta_combine_backups(BENCHMARK_SERVER, BENCHMARK_INCREMENTAL_LABEL, context->root,
+                                   state->input_dir, state->output_dir, state->prior_labels,
+                                   state->backup, state->manifest, false, true);
+}
+
+static void
+incremental_teardown(struct benchmark_context* context)
+{
+   struct incremental_state* state = (struct incremental_state*)context->data;
+
+   if (state != NULL)
+   {
+      if (state->output_dir != NULL)
+      {
+         pgmoneta_delete_directory(state->output_dir);
+      }
+      pgmoneta_delete_server_workspace(BENCHMARK_SERVER, NULL);
+
+      pgmoneta_json_destroy(state->manifest);
+      pgmoneta_deque_destroy(state->prior_labels);
+      free(state->backup);
+      free(state->input_dir);
+      free(state->output_dir);
+      free(state);
+   }
+   context->data = NULL;
+}
+
+static int
+prometheus_setup(struct benchmark_context* context)
+{
+   uint64_t bytes = 0;
+
+   context->items = 1;
+
+   /* Render the backup sections against real backups */
+   return pgmoneta_benchmark_generate_backups(context->options, &bytes);
+}
+
+static int
+prometheus_run(struct benchmark_context* context)
+{
+   char buffer[8192];
+   int sockets[2];
+   int status = 0;
+   ssize_t n;
+   uint64_t total = 0;
+   pid_t pid;
+
+   if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets))
+   {
+      return 1;
+   }
+
+   /* A scrape is served by a forked process, exactly like the metrics endpoint */
+   pid = fork();
+   if (pid == -1)
+   {
+      close(sockets[0]);
+      close(sockets[1]);
+      return 1;
+   }
+   else if (pid == 0)
+   {
+      close(sockets[0]);
+      pgmoneta_prometheus(NULL, sockets[1]);
+      exit(0);
+   }
+
+   close(sockets[1]);
+
+   if (write(sockets[0], PROMETHEUS_REQUEST, strlen(PROMETHEUS_REQUEST)) != (ssize_t)strlen(PROMETHEUS_REQUEST))
+   {
+      close(sockets[0]);
+      waitpid(pid, &status, 0);
+      return 1;
+   }
+
+   while ((n = read(sockets[0], &buffer[0], sizeof(buffer))) > 0)
+   {
+      total += n;
+   }
+
+   close(sockets[0]);
+   waitpid(pid, &status, 0);
+
+   context->bytes = total;
+
+   return (WIFEXITED(status) && WEXITSTATUS(status) == 0) ? 0 : 1;
+}
@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2025 The pgmoneta community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* pgmoneta */
+#include <pgmoneta.h>
+#include <brt.h>
+#include <tsbenchmark.h>
+#include <utils.h>
+#include <walfile.h>
+#include <walfile/wal_reader.h>
+
+/* system */
+#include <stdio.h>
+#include <stdlib.h>
+
+#define BENCHMARK_RELATIONS_PER_FILE 32
+
+static int wal_setup(struct benchmark_context* context);
+static int wal_run(struct benchmark_context* context);
+static void wal_teardown(struct benchmark_context* context);
+static char* wal_segment(struct benchmark_context* context, int segment);
+
+static int brt_setup(struct benchmark_context* context);
+static int brt_run(struct benchmark_context* context);
+
+static struct benchmark benchmarks[] = {
+   {"wal_parse", NULL, wal_setup, NULL, wal_run, wal_teardown},
+   {"brt_mark", NULL, brt_setup, NULL, brt_run, NULL},
+};
+
+struct benchmark*
+pgmoneta_benchmark_wal(int* number)
+{
+   *number = sizeof(benchmarks) / sizeof(struct benchmark);
+
+   return &benchmarks[0];
+}
+
+static int
+wal_setup(struct benchmark_context* context)
+{
+   char* path = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   context->data = pgmoneta_benchmark_path(context, "wal");
+   if (pgmoneta_mkdir((char*)context->data))
+   {
+      return 1;
+   }
+
+   for (int i = 0; i < context->options->wal_segments; i++)
+   {
+      path = wal_segment(context, i);
+
+      if (pgmoneta_benchmark_generate_walfile(context->options, path))
+      {
+         free(path);
+         return 1;
+      }
+
+      free(path);
+   }
+
+   context->bytes = (uint64_t)context->options->wal_segments * config->common.servers[BENCHMARK_SERVER].wal_size;
+   context->items = (uint64_t)context->options->wal_segments * context->options->wal_records;
+
+   return 0;
+}
+
+static int
+wal_run(struct benchmark_context* context)
+{
+   char* path = NULL;
+   struct walfile* wf = NULL;
+   int ret = 0;
+
+   for (int i = 0; ret == 0 && i < context->options->wal_segments; i++)
+   {
+      path = wal_segment(context, i);
+
+      partial_record = (struct partial_xlog_record*)calloc(1, sizeof(struct partial_xlog_record));
+
+      if (pgmoneta_read_walfile(BENCHMARK_SERVER, path, &wf))
+      {
+         ret = 1;
+      }
+
+      pgmoneta_destroy_walfile(wf);
+      wf = NULL;
+
+      if (partial_record != NULL)
+      {
+         free(partial_record->xlog_record);
+         free(partial_record->data_buffer);
+         free(partial_record);
+         partial_record = NULL;
+      }
+
+      free(path);
+   }
+
+   return ret;
+}
+
+static void
+wal_teardown(struct benchmark_context* context)
+{
+   pgmoneta_delete_directory((char*)context->data);
+   free(context->data);
+   context->data = NULL;
+}
+
+static char*
+wal_segment(struct benchmark_context* context, int segment)
+{
+   char* path = NULL;
+
+   path = pgmoneta_format_and_append(path, "%s/%08X%08X%08X", (char*)context->data, 1, 0, segment + 1);
+
+   return path;
+}
+
+static int
+brt_setup(struct benchmark_context* context)
+{
+   uint64_t blocks = (context->options->file_size + 8191) / 8192;
+
+   context->items = (uint64_t)context->options->files * BENCHMARK_RELATIONS_PER_FILE * (blocks > 0 ? blocks : 1);
+   context->bytes = 0;
+
+   return 0;
+}
+
+static int
+brt_run(struct benchmark_context* context)
+{
+   block_ref_table* brt = NULL;
+   struct rel_file_locator rlocator;
+   uint64_t relations = (uint64_t)context->options->files * BENCHMARK_RELATIONS_PER_FILE;
+   uint64_t blocks = context->items / relations;
+   block_number blkno;
+
+   if (pgmoneta_brt_create_empty(&brt))
+   {
+      return 1;
+   }
+
+   for (uint64_t r = 0; r < relations; r++)
+   {
+      rlocator.spcOid = 1663;
+      rlocator.dbOid = 1 + (r / 1000);
+      rlocator.relNumber = 16384 + r;
+
+      /* Spread the blocks over four times the relation size so both chunk representations are used */
+      for (uint64_t b = 0; b < blocks; b++)
+      {
+         blkno = (block_number)((b * 7919 + r) % (blocks * 4));
+
+         if (pgmoneta_brt_mark_block_modified(brt, &rlocator, MAIN_FORKNUM, blkno))
+         {
+            pgmoneta_brt_destroy(brt);
+            return 1;
+         }
+      }
+   }
+
+   pgmoneta_brt_destroy(brt);
+
+   return 0;
+}
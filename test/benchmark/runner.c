@@ -0,0 +1,678 @@
+/*
+ * Copyright (C) 2025 The pgmoneta community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* pgmoneta */
+#include <pgmoneta.h>
+#include <cmd.h>
+#include <configuration.h>
+#include <json.h>
+#include <logging.h>
+#include <memory.h>
+#include <prometheus.h>
+#include <shmem.h>
+#include <tsbenchmark.h>
+#include <utils.h>
+#include <value.h>
+#include <workers.h>
+
+/* system */
+#include <err.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#ifndef PGMONETA_BENCHMARK_COMMIT
+#define PGMONETA_BENCHMARK_COMMIT "unknown"
+#endif
+
+static void usage(void);
+static int parse_size(char* s, size_t* size);
+static int environment_create(struct benchmark_options* options);
+static void environment_destroy(struct benchmark_options* options, bool scratch);
+static int write_master_key(struct benchmark_options* options);
+static int run_benchmark(struct benchmark_options* options, struct benchmark* benchmark, FILE* out);
+static void report(struct benchmark_options* options, struct benchmark* benchmark, struct benchmark_context* context, double* samples, FILE* out);
+static int compare_double(const void* a, const void* b);
+static double now(void);
+
+static size_t prometheus_cache_size = 0;
+
+static void
+usage(void)
+{
+   printf("pgmoneta-benchmark %s\n", VERSION);
+   printf("  Benchmark the backup, restore, compression and WAL paths on synthetic data\n");
+   printf("\n");
+
+   printf("Usage:\n");
+   printf("  pgmoneta-benchmark [ -b BENCHMARK ] [ -i ITERATIONS ] [ -o FILE ]\n");
+   printf("\n");
+   printf("Options:\n");
+   printf("  -b,  --benchmark        Only run the benchmarks starting with this name\n");
+   printf("  -l,  --list             List the benchmarks\n");
+   printf("  -i,  --iterations       The number of measured iterations (default %d)\n", BENCHMARK_DEFAULT_ITERATIONS);
+   printf("  -w,  --warmup           The number of warmup iterations (default %d)\n", BENCHMARK_DEFAULT_WARMUP);
+   printf("  -f,  --files            The number of relation files (default %d)\n", BENCHMARK_DEFAULT_FILES);
+   printf("  -s,  --size             The size of a relation file, K/M/G suffixes allowed (default 1M)\n");
+   printf("  -c,  --compressibility  The compressible percentage of each block (default %d)\n", BENCHMARK_DEFAULT_COMPRESSIBILITY);
+   printf("  -C,  --changed          The percentage of relations, and their blocks, changed between backups (default %d)\n", BENCHMARK_DEFAULT_CHANGED);
+   printf("  -S,  --seed             The seed of the data generator (default %d)\n", BENCHMARK_DEFAULT_SEED);
+   printf("  -W,  --workers          The number of workers, 0 runs inline (default 0)\n");
+   printf("       --wal-segments     The number of WAL segments (default %d)\n", BENCHMARK_DEFAULT_WAL_SEGMENTS);
+   printf("       --wal-records      The number of records per WAL segment (default %d)\n", BENCHMARK_DEFAULT_WAL_RECORDS);
+   printf("       --manifest-entries The number of manifest entries (default %d)\n", BENCHMARK_DEFAULT_MANIFEST);
+   printf("       --deque-elements   The number of deque elements (default %d)\n", BENCHMARK_DEFAULT_DEQUE);
+   printf("  -d,  --directory        The scratch directory (default a temporary directory)\n");
+   printf("  -o,  --output           Append the results to a file instead of standard output\n");
+   printf("  -V,  --version          Display version information\n");
+   printf("  -?,  --help             Display help\n");
+   printf("\n");
+   printf("Each benchmark is reported as one JSON object per line\n");
+   printf("\n");
+   printf("pgmoneta: %s\n", PGMONETA_HOMEPAGE);
+   printf("Report bugs: %s\n", PGMONETA_ISSUES);
+}
+
+int
+main(int argc, char** argv)
+{
+   int optind = 0;
+   int num_options = 0;
+   int num_results = 0;
+   int number = 0;
+   int failed = 0;
+   bool scratch = false;
+   char* output = NULL;
+   FILE* out = stdout;
+   struct benchmark* benchmarks = NULL;
+   struct benchmark* (*groups[])(int*) = {pgmoneta_benchmark_data, pgmoneta_benchmark_backup,
+                                          pgmoneta_benchmark_wal, pgmoneta_benchmark_restore,
+                                          pgmoneta_benchmark_deque};
+   struct benchmark_options options;
+
+   cli_option cli_options[] = {
+      {"b", "benchmark", true},
+      {"l", "list", false},
+      {"i", "iterations", true},
+      {"w", "warmup", true},
+      {"f", "files", true},
+      {"s", "size", true},
+      {"c", "compressibility", true},
+      {"C", "changed", true},
+      {"S", "seed", true},
+      {"W", "workers", true},
+      {"", "wal-segments", true},
+      {"", "wal-records", true},
+      {"", "manifest-entries", true},
+      {"", "deque-elements", true},
+      {"d", "directory", true},
+      {"o", "output", true},
+      {"V", "version", false},
+      {"?", "help", false},
+   };
+
+   memset(&options, 0, sizeof(struct benchmark_options));
+   options.iterations = BENCHMARK_DEFAULT_ITERATIONS;
+   options.warmup = BENCHMARK_DEFAULT_WARMUP;
+   options.files = BENCHMARK_DEFAULT_FILES;
+   options.file_size = BENCHMARK_DEFAULT_FILE_SIZE;
+   options.compressibility = BENCHMARK_DEFAULT_COMPRESSIBILITY;
+   options.changed = BENCHMARK_DEFAULT_CHANGED;
+   options.seed = BENCHMARK_DEFAULT_SEED;
+   options.wal_segments = BENCHMARK_DEFAULT_WAL_SEGMENTS;
+   options.wal_records = BENCHMARK_DEFAULT_WAL_RECORDS;
+   options.manifest_entries = BENCHMARK_DEFAULT_MANIFEST;
+   options.deque_elements = BENCHMARK_DEFAULT_DEQUE;
+
+   num_options = sizeof(cli_options) / sizeof(cli_options[0]);
+   cli_result results[num_options];
+
+   num_results = cmd_parse(argc, argv, cli_options, num_options, results, num_options, false, NULL, &optind);
+
+   if (num_results < 0)
+   {
+      errx(1, "Error parsing command line\n");
+   }
+
+   for (int i = 0; i < num_results; i++)
+   {
+      char* optname = results[i].option_name;
+      char* optarg = results[i].argument;
+
+      if (optname == NULL)
+      {
+         break;
+      }
+      else if (!strcmp(optname, "b") || !strcmp(optname, "benchmark"))
+      {
+         snprintf(&options.filter[0], sizeof(options.filter), "%s", optarg);
+      }
+      else if (!strcmp(optname, "l") || !strcmp(optname, "list"))
+      {
+         options.list = true;
+      }
+      else if (!strcmp(optname, "i") || !strcmp(optname, "iterations"))
+      {
+         options.iterations = atoi(optarg);
+      }
+      else if (!strcmp(optname, "w") || !strcmp(optname, "warmup"))
+      {
+         options.warmup = atoi(optarg);
+      }
+      else if (!strcmp(optname, "f") || !strcmp(optname, "files"))
+      {
+         options.files = atoi(optarg);
+      }
+      else if (!strcmp(optname, "s") || !strcmp(optname, "size"))
+      {
+         if (parse_size(optarg, &options.file_size))
+         {
+            errx(1, "Invalid size: %s", optarg);
+         }
+      }
+      else if (!strcmp(optname, "c") || !strcmp(optname, "compressibility"))
+      {
+         options.compressibility = atoi(optarg);
+      }
+      else if (!strcmp(optname, "C") || !strcmp(optname, "changed"))
+      {
+         options.changed = atoi(optarg);
+      }
+      else if (!strcmp(optname, "S") || !strcmp(optname, "seed"))
+      {
+         options.seed = (unsigned int)strtoul(optarg, NULL, 10);
+      }
+      else if (!strcmp(optname, "W") || !strcmp(optname, "workers"))
+      {
+         options.workers = atoi(optarg);
+      }
+      else if (!strcmp(optname, "wal-segments"))
+      {
+         options.wal_segments = atoi(optarg);
+      }
+      else if (!strcmp(optname, "wal-records"))
+      {
+         options.wal_records = atoi(optarg);
+      }
+      else if (!strcmp(optname, "manifest-entries"))
+      {
+         options.manifest_entries = atoi(optarg);
+      }
+      else if (!strcmp(optname, "deque-elements"))
+      {
+         options.deque_elements = atoi(optarg);
+      }
+      else if (!strcmp(optname, "d") || !strcmp(optname, "directory"))
+      {
+         snprintf(&options.directory[0], sizeof(options.directory), "%s", optarg);
+      }
+      else if (!strcmp(optname, "o") || !strcmp(optname, "output"))
+      {
+         output = optarg;
+      }
+      else if (!strcmp(optname, "V") || !strcmp(optname, "version"))
+      {
+         printf("pgmoneta-benchmark %s\n", VERSION);
+         exit(0);
+      }
+      else if (!strcmp(optname, "?") || !strcmp(optname, "help"))
+      {
+         usage();
+         exit(0);
+      }
+   }
+
+   if (options.iterations < 1 || options.iterations > BENCHMARK_MAX_ITERATIONS ||
+       options.warmup < 0 || options.files < 1 || options.wal_segments < 1 || options.wal_records < 1 ||
+       options.manifest_entries < 1 || options.deque_elements < 1 || options.workers < 0 ||
+       options.compressibility < 0 || options.compressibility > 100 ||
+       options.changed < 0 || options.changed > 100)
+   {
+      errx(1, "Invalid benchmark options");
+   }
+
+   if (options.list)
+   {
+      for (size_t g = 0; g < sizeof(groups) / sizeof(groups[0]); g++)
+      {
+         benchmarks = groups[g](&number);
+         for (int i = 0; i < number; i++)
+         {
+            printf("%s\n", benchmarks[i].name);
+         }
+      }
+      exit(0);
+   }
+
+   if (output != NULL)
+   {
+      out = fopen(output, "a");
+      if (out == NULL)
+      {
+         errx(1, "Could not open %s", output);
+      }
+   }
+
+   if (strlen(options.directory) == 0)
+   {
+      char template[] = "/tmp/pgmoneta-benchmark.XXXXXX";
+
+      if (mkdtemp(&template[0]) == NULL)
+      {
+         errx(1, "Could not create a scratch directory");
+      }
+
+      snprintf(&options.directory[0], sizeof(options.directory), "%s", &template[0]);
+      scratch = true;
+   }
+
+   if (environment_create(&options))
+   {
+      errx(1, "Could not create the benchmark environment in %s", options.directory);
+   }
+
+   for (size_t g = 0; g < sizeof(groups) / sizeof(groups[0]); g++)
+   {
+      benchmarks = groups[g](&number);
+      for (int i = 0; i < number; i++)
+      {
+         if (strlen(options.filter) > 0 && !pgmoneta_starts_with(benchmarks[i].name, options.filter))
+         {
+            continue;
+         }
+
+         if (run_benchmark(&options, &benchmarks[i], out))
+         {
+            warnx("Benchmark %s failed, see %s/pgmoneta-benchmark.log", benchmarks[i].name, options.directory);
+            failed++;
+         }
+      }
+   }
+
+   environment_destroy(&options, scratch);
+
+   if (out != stdout)
+   {
+      fclose(out);
+   }
+
+   return failed == 0 ? 0 : 1;
+}
+
+char*
+pgmoneta_benchmark_path(struct benchmark_context* context, char* name)
+{
+   char* path = NULL;
+
+   path = pgmoneta_format_and_append(path, "%s/%s", context->root, name);
+
+   return path;
+}
+
+int
+pgmoneta_benchmark_wait(struct benchmark_context* context)
+{
+   if (context->workers == NULL)
+   {
+      return 0;
+   }
+
+   pgmoneta_workers_wait(context->workers);
+
+   if (!context->workers->outcome)
+   {
+      context->workers->outcome = true;
+      return 1;
+   }
+
+   return 0;
+}
+
+static int
+parse_size(char* s, size_t* size)
+{
+   char* end = NULL;
+   unsigned long long value;
+
+   value = strtoull(s, &end, 10);
+
+   if (end == s)
+   {
+      return 1;
+   }
+
+   switch (*end)
+   {
+      case 'k':
+      case 'K':
+         value *= 1024ULL;
+         break;
+      case 'm':
+      case 'M':
+         value *= 1024ULL * 1024ULL;
+         break;
+      case 'g':
+      case 'G':
+         value *= 1024ULL * 1024ULL * 1024ULL;
+         break;
+      case '\0':
+         break;
+      default:
+         return 1;
+   }
+
+   *size = (size_t)value;
+
+   return 0;
+}
+
+static int
+environment_create(struct benchmark_options* options)
+{
+   size_t size;
+   struct main_configuration* config;
+
+   size = sizeof(struct main_configuration);
+   if (pgmoneta_create_shared_memory(size, HUGEPAGE_OFF, &shmem))
+   {
+      return 1;
+   }
+
+   pgmoneta_init_main_configuration(shmem);
+
+   config = (struct main_configuration*)shmem;
+
+   /* Everything lives in the scratch directory, including the master key */
+   snprintf(&config->common.home_dir[0], sizeof(config->common.home_dir), "%s", options->directory);
+   snprintf(&config->base_dir[0], sizeof(config->base_dir), "%s/base", options->directory);
+   snprintf(&config->workspace[0], sizeof(config->workspace), "%s/workspace/", options->directory);
+
+   config->common.log_type = PGMONETA_LOGGING_TYPE_FILE;
+   config->common.log_level = PGMONETA_LOGGING_LEVEL_ERROR;
+   snprintf(&config->common.log_path[0], sizeof(config->common.log_path), "%s/pgmoneta-benchmark.log", options->directory);
+
+   config->workers = options->workers;
+   config->encryption = ENCRYPTION_AES_256_CBC;
+   config->metrics = 0;
+
+   config->common.number_of_servers = 1;
+   snprintf(&config->common.servers[BENCHMARK_SERVER].name[0], sizeof(config->common.servers[BENCHMARK_SERVER].name), "%s", "primary");
+   config->common.servers[BENCHMARK_SERVER].version = 17;
+   config->common.servers[BENCHMARK_SERVER].minor_version = 0;
+   config->common.servers[BENCHMARK_SERVER].block_size = 8192;
+   config->common.servers[BENCHMARK_SERVER].segment_size = 1024 * 1024 * 1024;
+   config->common.servers[BENCHMARK_SERVER].relseg_size = 131072;
+   config->common.servers[BENCHMARK_SERVER].wal_size = 16 * 1024 * 1024;
+   config->common.servers[BENCHMARK_SERVER].workers = options->workers;
+   config->common.servers[BENCHMARK_SERVER].valid = true;
+
+   if (pgmoneta_mkdir(config->base_dir) || pgmoneta_mkdir(config->workspace))
+   {
+      return 1;
+   }
+
+   if (write_master_key(options))
+   {
+      return 1;
+   }
+
+   if (pgmoneta_init_prometheus_cache(&prometheus_cache_size, &prometheus_cache_shmem))
+   {
+      return 1;
+   }
+
+   if (pgmoneta_start_logging())
+   {
+      return 1;
+   }
+
+   pgmoneta_memory_init();
+
+   return 0;
+}
+
+static void
+environment_destroy(struct benchmark_options* options, bool scratch)
+{
+   pgmoneta_memory_destroy();
+   pgmoneta_stop_logging();
+
+   if (scratch)
+   {
+      pgmoneta_delete_directory(options->directory);
+   }
+
+   pgmoneta_destroy_shared_memory(prometheus_cache_shmem, prometheus_cache_size);
+   pgmoneta_destroy_shared_memory(shmem, sizeof(struct main_configuration));
+}
+
+static int
+write_master_key(struct benchmark_options* options)
+{
+   char key[32];
+   char* encoded = NULL;
+   size_t encoded_length = 0;
+   char* path = NULL;
+   FILE* file = NULL;
+
+   /* A fixed key keeps the encrypted output identical between runs */
+   for (size_t i = 0; i < sizeof(key); i++)
+   {
+      key[i] = (char)((options->seed + i * 31) & 0xFF);
+   }
+
+   path = pgmoneta_format_and_append(path, "%s/.pgmoneta", options->directory);
+   if (mkdir(path, S_IRWXU) && !pgmoneta_exists(path))
+   {
+      goto error;
+   }
+
+   path = pgmoneta_append(path, "/master.key");
+
+   if (pgmoneta_base64_encode(&key[0], sizeof(key), &encoded, &encoded_length))
+   {
+      goto error;
+   }
+
+   file = fopen(path, "w");
+   if (file == NULL)
+   {
+      goto error;
+   }
+
+   fputs(encoded, file);
+   fclose(file);
+
+   if (chmod(path, S_IRUSR | S_IWUSR))
+   {
+      goto error;
+   }
+
+   free(encoded);
+   free(path);
+
+   return 0;
+
+error:
+
+   free(encoded);
+   free(path);
+
+   return 1;
+}
+
+static int
+run_benchmark(struct benchmark_options* options, struct benchmark* benchmark, FILE* out)
+{
+   double samples[BENCHMARK_MAX_ITERATIONS];
+   double start;
+   int ret = 1;
+   struct benchmark_context context;
+
+   memset(&context, 0, sizeof(struct benchmark_context));
+   context.options = options;
+   context.arg = benchmark->arg;
+   snprintf(&context.root[0], sizeof(context.root), "%s/%s", options->directory, benchmark->name);
+
+   if (pgmoneta_mkdir(context.root))
+   {
+      return 1;
+   }
+
+   if (options->workers > 0)
+   {
+      if (pgmoneta_workers_initialize(options->workers, &context.workers))
+      {
+         return 1;
+      }
+   }
+
+   if (benchmark->setup != NULL && benchmark->setup(&context))
+   {
+      goto done;
+   }
+
+   for (int i = 0; i < options->warmup + options->iterations; i++)
+   {
+      if (benchmark->reset != NULL && benchmark->reset(&context))
+      {
+         goto done;
+      }
+
+      start = now();
+
+      if (benchmark->run(&context))
+      {
+         goto done;
+      }
+
+      if (i >= options->warmup)
+      {
+         samples[i - options->warmup] = now() - start;
+      }
+   }
+
+   report(options, benchmark, &context, &samples[0], out);
+
+   ret = 0;
+
+done:
+
+   if (benchmark->teardown != NULL)
+   {
+      benchmark->teardown(&context);
+   }
+
+   pgmoneta_workers_destroy(context.workers);
+   pgmoneta_delete_directory(context.root);
+
+   return ret;
+}
+
+static void
+report(struct benchmark_options* options, struct benchmark* benchmark, struct benchmark_context* context, double* samples, FILE* out)
+{
+   double sum = 0.0;
+   double mean;
+   double median;
+   double variance = 0.0;
+   int n = options->iterations;
+   char* s = NULL;
+   struct json* result = NULL;
+
+   qsort(samples, n, sizeof(double), compare_double);
+
+   for (int i = 0; i < n; i++)
+   {
+      sum += samples[i];
+   }
+   mean = sum / n;
+
+   for (int i = 0; i < n; i++)
+   {
+      variance += (samples[i] - mean) * (samples[i] - mean);
+   }
+   variance = n > 1 ? variance / (n - 1) : 0.0;
+
+   median = (n % 2 == 1) ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) / 2.0;
+
+   if (pgmoneta_json_create(&result))
+   {
+      return;
+   }
+
+   pgmoneta_json_put(result, "benchmark", (uintptr_t)benchmark->name, ValueString);
+   pgmoneta_json_put(result, "version", (uintptr_t)VERSION, ValueString);
+   pgmoneta_json_put(result, "commit", (uintptr_t)PGMONETA_BENCHMARK_COMMIT, ValueString);
+   pgmoneta_json_put(result, "seed", (uintptr_t)options->seed, ValueUInt32);
+   pgmoneta_json_put(result, "files", (uintptr_t)options->files, ValueInt32);
+   pgmoneta_json_put(result, "file_size", (uintptr_t)options->file_size, ValueUInt64);
+   pgmoneta_json_put(result, "compressibility", (uintptr_t)options->compressibility, ValueInt32);
+   pgmoneta_json_put(result, "changed", (uintptr_t)options->changed, ValueInt32);
+   pgmoneta_json_put(result, "workers", (uintptr_t)options->workers, ValueInt32);
+   pgmoneta_json_put(result, "iterations", (uintptr_t)n, ValueInt32);
+   pgmoneta_json_put(result, "bytes", (uintptr_t)context->bytes, ValueUInt64);
+   pgmoneta_json_put(result, "items", (uintptr_t)context->items, ValueUInt64);
+   pgmoneta_json_put(result, "min", pgmoneta_value_from_double(samples[0]), ValueDouble);
+   pgmoneta_json_put(result, "median", pgmoneta_value_from_double(median), ValueDouble);
+   pgmoneta_json_put(result, "mean", pgmoneta_value_from_double(mean), ValueDouble);
+   pgmoneta_json_put(result, "max", pgmoneta_value_from_double(samples[n - 1]), ValueDouble);
+   pgmoneta_json_put(result, "stddev", pgmoneta_value_from_double(sqrt(variance)), ValueDouble);
+   pgmoneta_json_put(result, "bytes_per_second", pgmoneta_value_from_double(median > 0.0 ? context->bytes / median : 0.0), ValueDouble);
+   pgmoneta_json_put(result, "items_per_second", pgmoneta_value_from_double(median > 0.0 ? context->items / median : 0.0), ValueDouble);
+
+   s = pgmoneta_json_to_string(result, FORMAT_JSON_COMPACT, NULL, 0);
+   fprintf(out, "%s\n", s);
+   fflush(out);
+
+   free(s);
+   pgmoneta_json_destroy(result);
+}
+
+static int
+compare_double(const void* a, const void* b)
+{
+   double x = *(const double*)a;
+   double y = *(const double*)b;
+
+   return (x > y) - (x < y);
+}
+
+static double
+now(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+
+   return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
@@ -0,0 +1,236 @@
+/*
+ * Copyright (C) 2025 The pgmoneta community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PGMONETA_TSBENCHMARK_H
+#define PGMONETA_TSBENCHMARK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* pgmoneta */
+#include <pgmoneta.h>
+#include <workers.h>
+
+/* system */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define BENCHMARK_SERVER 0
+
+#define BENCHMARK_MAX_ITERATIONS 1000
+
+#define BENCHMARK_DEFAULT_ITERATIONS      5
+#define BENCHMARK_DEFAULT_WARMUP          1
+#define BENCHMARK_DEFAULT_FILES           32
+#define BENCHMARK_DEFAULT_FILE_SIZE       (1024 * 1024)
+#define BENCHMARK_DEFAULT_COMPRESSIBILITY 50
+#define BENCHMARK_DEFAULT_SEED            42
+#define BENCHMARK_DEFAULT_WAL_SEGMENTS    2
+#define BENCHMARK_DEFAULT_WAL_RECORDS     20000
+#define BENCHMARK_DEFAULT_MANIFEST        100000
+#define BENCHMARK_DEFAULT_CHANGED         25
+#define BENCHMARK_DEFAULT_DEQUE           1000000
+
+#define BENCHMARK_FULL_LABEL        "20250101000000"
+#define BENCHMARK_INCREMENTAL_LABEL "20250102000000"
+
+/** @struct benchmark_options
+ * Defines the parameters of a benchmark run, all data is derived from the seed
+ */
+struct benchmark_options
+{
+   int iterations;           /**< The number of measured iterations */
+   int warmup;               /**< The number of unmeasured iterations */
+   int files;                /**< The number of relation files */
+   size_t file_size;         /**< The size of each relation file */
+   int compressibility;      /**< The percentage of each block that is compressible */
+   int changed;              /**< The percentage of relations, and of their blocks, changed between backups */
+   unsigned int seed;        /**< The seed of the data generator */
+   int wal_segments;         /**< The number of WAL segments */
+   int wal_records;          /**< The number of records in each WAL segment */
+   int manifest_entries;     /**< The number of entries in each manifest */
+   int deque_elements;       /**< The number of elements in each deque */
+   int workers;              /**< The number of workers, 0 runs inline */
+   char directory[MAX_PATH]; /**< The scratch directory */
+   char filter[MISC_LENGTH]; /**< Only run benchmarks whose name starts with this prefix */
+   bool list;                /**< Only list the benchmarks */
+};
+
+/** @struct benchmark_context
+ * Defines the state shared by the callbacks of a benchmark
+ */
+struct benchmark_context
+{
+   struct benchmark_options* options; /**< The options */
+   char root[MAX_PATH];               /**< The scratch directory of the benchmark */
+   struct workers* workers;           /**< The optional workers */
+   void* arg;                         /**< The argument of the benchmark */
+   uint64_t bytes;                    /**< The bytes processed by one iteration */
+   uint64_t items;                    /**< The items processed by one iteration */
+   void* data;                        /**< The benchmark specific state */
+};
+
+/** @struct benchmark
+ * Defines a benchmark, only run is measured
+ */
+struct benchmark
+{
+   char* name;                                          /**< The name */
+   void* arg;                                           /**< The argument, available as context->arg */
+   int (*setup)(struct benchmark_context* context);     /**< Prepare the data set, optional */
+   int (*reset)(struct benchmark_context* context);     /**< Restore the data set before each iteration, optional */
+   int (*run)(struct benchmark_context* context);       /**< The measured operation */
+   void (*teardown)(struct benchmark_context* context); /**< Release the state, optional */
+};
+
+/**
+ * Get a path in the scratch directory of a benchmark
+ * @param context The context
+ * @param name The name
+ * @return The path
+ */
+char*
+pgmoneta_benchmark_path(struct benchmark_context* context, char* name);
+
+/**
+ * Wait for the workers of a benchmark
+ * @param context The context
+ * @return 0 if all tasks succeeded, otherwise 1
+ */
+int
+pgmoneta_benchmark_wait(struct benchmark_context* context);
+
+/**
+ * Generate a synthetic PGDATA directory
+ * @param options The options
+ * @param directory The directory
+ * @param variant Blocks are changed for a non-zero variant
+ * @param bytes [out] The number of bytes generated
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_benchmark_generate_pgdata(struct benchmark_options* options, char* directory, int variant, uint64_t* bytes);
+
+/**
+ * Generate a block of synthetic relation data
+ * @param options The options
+ * @param file The file number
+ * @param block The block number
+ * @param variant The variant
+ * @param buffer The buffer
+ * @param size The size of the buffer
+ */
+void
+pgmoneta_benchmark_generate_block(struct benchmark_options* options, int file, int block, int variant, char* buffer, size_t size);
+
+/**
+ * Is a block changed by an incremental backup
+ * @param options The options
+ * @param file The file number
+ * @param block The block number
+ * @return True if changed, otherwise false
+ */
+bool
+pgmoneta_benchmark_is_changed(struct benchmark_options* options, int file, int block);
+
+/**
+ * Generate a manifest in the CSV format used by the manifest comparison
+ * @param options The options
+ * @param path The path
+ * @param variant Entries are changed, added and removed for a non-zero variant
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_benchmark_generate_manifest(struct benchmark_options* options, char* path, int variant);
+
+/**
+ * Generate a WAL segment
+ * @param options The options
+ * @param path The path
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_benchmark_generate_walfile(struct benchmark_options* options, char* path);
+
+/**
+ * Generate a full backup and an incremental backup on top of it in the server
+ * backup directory
+ * @param options The options
+ * @param bytes [out] The restore size of the incremental backup
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_benchmark_generate_backups(struct benchmark_options* options, uint64_t* bytes);
+
+/**
+ * Get the compression and encryption benchmarks
+ * @param number [out] The number of benchmarks
+ * @return The benchmarks
+ */
+struct benchmark*
+pgmoneta_benchmark_data(int* number);
+
+/**
+ * Get the manifest and link benchmarks
+ * @param number [out] The number of benchmarks
+ * @return The benchmarks
+ */
+struct benchmark*
+pgmoneta_benchmark_backup(int* number);
+
+/**
+ * Get the WAL and block reference table benchmarks
+ * @param number [out] The number of benchmarks
+ * @return The benchmarks
+ */
+struct benchmark*
+pgmoneta_benchmark_wal(int* number);
+
+/**
+ * Get the incremental reconstruction and Prometheus benchmarks
+ * @param number [out] The number of benchmarks
+ * @return The benchmarks
+ */
+struct benchmark*
+pgmoneta_benchmark_restore(int* number);
+
+/**
+ * Get the deque benchmarks
+ * @param number [out] The number of benchmarks
+ * @return The benchmarks
+ */
+struct benchmark*
+pgmoneta_benchmark_deque(int* number);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -116,4 +116,18 @@ pgmoneta_test_json_suite();
 Suite*
 pgmoneta_test_utils_suite();
 
+/**
+ * Set up a catalog suite for pgmoneta
+ * @return The result
+ */
+Suite*
+pgmoneta_test_catalog_suite();
+
+/**
+ * Set up a WAL verification suite for pgmoneta
+ * @return The result
+ */
+Suite*
+pgmoneta_test_verify_wal_suite();
+
 #endif
\ No newline at end of file
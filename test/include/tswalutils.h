@@ -87,8 +87,50 @@
 #define RANDOM_TOPLEVEL_XID                     INVALID_TRANSACTION_ID
 #define RANDOM_PARTIAL                          false
 
+/* Random values for a subtransaction record */
+#define RANDOM_SUBXACT_XID                      1234
+#define RANDOM_SUBXACT_TOPLEVEL_XID             1000
+#define RANDOM_SUBXACT_SPC_OID                  1663
+#define RANDOM_SUBXACT_DB_OID                   5
+#define RANDOM_SUBXACT_REL_NUMBER               16384
+#define RANDOM_SUBXACT_BLKNO                    0
+#define RANDOM_SUBXACT_BLOCK_DATA_LEN           32
+#define RANDOM_SUBXACT_MAIN_DATA_LEN            3
+
+/* Random values for a segment of XLOG_NOOP records */
+#define RANDOM_NOOP_MAIN_DATA_LEN               100
+
 /* Random values for usage inside tests */
 #define RANDOM_WALFILE_NAME                     "/00000001000000000000001D"
 
 struct walfile*
 pgmoneta_test_generate_check_point_shutdown_v17();
+
+/**
+ * Generate a WAL file with a heap INSERT record of a subtransaction.
+ * The record references a block and carries the top-level XID
+ * @return The WAL file, or NULL on error
+ */
+struct walfile*
+pgmoneta_test_generate_subtransaction_v17(void);
+
+/**
+ * Generate a WAL segment of XLOG_NOOP records, which span pages.
+ * The CRC32C and xl_prev of the records are set by pgmoneta_test_seal_walfile
+ * @param pageaddr The LSN of the segment
+ * @param number_of_records The number of records
+ * @param xlog_switch End the segment with an XLOG_SWITCH record
+ * @return The WAL file, or NULL on error
+ */
+struct walfile*
+pgmoneta_test_generate_segment_v17(uint64_t pageaddr, int number_of_records, bool xlog_switch);
+
+/**
+ * Link the records of a written WAL segment through xl_prev, and set their CRC32C
+ * @param path The path of the segment
+ * @param prev [in/out] The LSN of the record before the segment, or 0.
+ *             Set to the LSN of the last record of the segment
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_test_seal_walfile(char* path, uint64_t* prev);
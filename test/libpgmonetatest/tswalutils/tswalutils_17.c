@@ -31,7 +31,10 @@
 #include <pgmoneta.h>
 #include <configuration.h>
 #include <deque.h>
+#include <security.h>
 #include <walfile/pg_control.h>
+#include <walfile/rm_heap.h>
+#include <walfile/rmgr.h>
 #include <utils.h>
 #include <value.h>
 #include <tsclient.h>
@@ -222,3 +225,428 @@ error:
 
    return NULL;
 }
+
+struct walfile*
+pgmoneta_test_generate_subtransaction_v17(void)
+{
+   struct walfile* wf = NULL;
+   struct decoded_xlog_record* rec = NULL;
+   struct decoded_bkp_block* blk = NULL;
+   uint32_t total_length = 0;
+
+   wf = (struct walfile*)malloc(sizeof(struct walfile));
+   if (wf == NULL)
+   {
+      goto error;
+   }
+
+   memset(wf, 0, sizeof(struct walfile));
+
+   wf->long_phd = (struct xlog_long_page_header_data*)malloc(sizeof(struct xlog_long_page_header_data));
+   if (wf->long_phd == NULL)
+   {
+      goto error;
+   }
+
+   memset(wf->long_phd, 0, sizeof(struct xlog_long_page_header_data));
+   wf->long_phd->std.xlp_pageaddr = RANDOM_PAGEADDR;
+   wf->long_phd->std.xlp_magic = RANDOM_MAGIC;
+   wf->long_phd->std.xlp_info = RANDOM_INFO;
+   wf->long_phd->std.xlp_tli = RANDOM_TLI;
+   wf->long_phd->xlp_seg_size = RANDOM_SEG_SIZE;
+   wf->long_phd->xlp_xlog_blcksz = RANDOM_XLOG_BLCKSZ;
+   wf->long_phd->std.xlp_rem_len = RANDOM_REMLEN;
+
+   if (pgmoneta_deque_create(false, &wf->page_headers))
+   {
+      goto error;
+   }
+
+   if (pgmoneta_deque_create(false, &wf->records))
+   {
+      goto error;
+   }
+
+   rec = (struct decoded_xlog_record*)malloc(sizeof(struct decoded_xlog_record));
+   if (rec == NULL)
+   {
+      goto error;
+   }
+
+   memset(rec, 0, sizeof(struct decoded_xlog_record));
+
+   rec->main_data_len = RANDOM_SUBXACT_MAIN_DATA_LEN;
+   rec->max_block_id = 0;
+   rec->oversized = RANDOM_OVERSIZED;
+   rec->record_origin = RANDOM_RECORD_ORIGIN;
+   rec->toplevel_xid = RANDOM_SUBXACT_TOPLEVEL_XID;
+   rec->partial = RANDOM_PARTIAL;
+
+   /* The heap page the tuple goes to, with the tuple as block data */
+   blk = &rec->blocks[0];
+   blk->in_use = true;
+   blk->rlocator.spcOid = RANDOM_SUBXACT_SPC_OID;
+   blk->rlocator.dbOid = RANDOM_SUBXACT_DB_OID;
+   blk->rlocator.relNumber = RANDOM_SUBXACT_REL_NUMBER;
+   blk->forknum = MAIN_FORKNUM;
+   blk->blkno = RANDOM_SUBXACT_BLKNO;
+   blk->flags = BKPBLOCK_HAS_DATA;
+   blk->has_data = true;
+   blk->data_len = RANDOM_SUBXACT_BLOCK_DATA_LEN;
+
+   blk->data = (char*)malloc(blk->data_len);
+   if (blk->data == NULL)
+   {
+      goto error;
+   }
+
+   for (int i = 0; i < blk->data_len; i++)
+   {
+      blk->data[i] = (char)i;
+   }
+
+   total_length = sizeof(struct xlog_record);
+
+   /* The top-level XID */
+   total_length += sizeof(uint8_t);
+   total_length += sizeof(transaction_id);
+
+   /* The block header and the block data */
+   total_length += sizeof(uint8_t);
+   total_length += sizeof(uint8_t);
+   total_length += sizeof(uint16_t);
+   total_length += sizeof(struct rel_file_locator);
+   total_length += sizeof(block_number);
+   total_length += blk->data_len;
+
+   /* The main data */
+   total_length += sizeof(uint8_t);
+   total_length += sizeof(uint8_t);
+   total_length += rec->main_data_len;
+
+   rec->header.xl_tot_len = total_length;
+   rec->header.xl_xid = RANDOM_SUBXACT_XID;
+   rec->header.xl_prev = 0;
+   rec->header.xl_info = XLOG_HEAP_INSERT;
+   rec->header.xl_rmid = RM_HEAP_ID;
+   rec->header.xl_crc = 0;
+   rec->size = rec->header.xl_tot_len;
+
+   rec->main_data = (char*)malloc(rec->main_data_len);
+   if (rec->main_data == NULL)
+   {
+      goto error;
+   }
+
+   memset(rec->main_data, 0, rec->main_data_len);
+
+   if (pgmoneta_deque_add(wf->records, NULL, (uintptr_t)rec, ValueRef))
+   {
+      goto error;
+   }
+
+   return wf;
+
+error:
+   if (rec != NULL)
+   {
+      free(rec->blocks[0].data);
+      free(rec->main_data);
+      free(rec);
+   }
+
+   if (wf != NULL)
+   {
+      free(wf->long_phd);
+
+      if (wf->page_headers != NULL)
+      {
+         pgmoneta_deque_destroy(wf->page_headers);
+      }
+
+      if (wf->records != NULL)
+      {
+         pgmoneta_deque_destroy(wf->records);
+      }
+
+      free(wf);
+   }
+
+   return NULL;
+}
+
+struct walfile*
+pgmoneta_test_generate_segment_v17(uint64_t pageaddr, int number_of_records, bool xlog_switch)
+{
+   struct walfile* wf = NULL;
+   struct decoded_xlog_record* rec = NULL;
+   int total = number_of_records + (xlog_switch ? 1 : 0);
+
+   wf = (struct walfile*)malloc(sizeof(struct walfile));
+   if (wf == NULL)
+   {
+      goto error;
+   }
+
+   memset(wf, 0, sizeof(struct walfile));
+
+   wf->long_phd = (struct xlog_long_page_header_data*)malloc(sizeof(struct xlog_long_page_header_data));
+   if (wf->long_phd == NULL)
+   {
+      goto error;
+   }
+
+   memset(wf->long_phd, 0, sizeof(struct xlog_long_page_header_data));
+   wf->long_phd->std.xlp_pageaddr = pageaddr;
+   wf->long_phd->std.xlp_magic = RANDOM_MAGIC;
+   wf->long_phd->std.xlp_info = XLP_LONG_HEADER;
+   wf->long_phd->std.xlp_tli = RANDOM_TLI;
+   wf->long_phd->xlp_seg_size = RANDOM_SEG_SIZE;
+   wf->long_phd->xlp_xlog_blcksz = RANDOM_XLOG_BLCKSZ;
+   wf->long_phd->std.xlp_rem_len = 0;
+
+   if (pgmoneta_deque_create(false, &wf->page_headers))
+   {
+      goto error;
+   }
+
+   if (pgmoneta_deque_create(false, &wf->records))
+   {
+      goto error;
+   }
+
+   for (int i = 0; i < total; i++)
+   {
+      bool last = xlog_switch && i == total - 1;
+
+      rec = (struct decoded_xlog_record*)malloc(sizeof(struct decoded_xlog_record));
+      if (rec == NULL)
+      {
+         goto error;
+      }
+
+      memset(rec, 0, sizeof(struct decoded_xlog_record));
+
+      rec->main_data_len = last ? 0 : RANDOM_NOOP_MAIN_DATA_LEN;
+      rec->max_block_id = RANDOM_MAX_BLOCK_ID;
+      rec->oversized = RANDOM_OVERSIZED;
+      rec->record_origin = RANDOM_RECORD_ORIGIN;
+      rec->toplevel_xid = RANDOM_TOPLEVEL_XID;
+      rec->partial = RANDOM_PARTIAL;
+
+      rec->header.xl_tot_len = sizeof(struct xlog_record);
+      if (rec->main_data_len > 0)
+      {
+         rec->header.xl_tot_len += sizeof(uint8_t) + sizeof(uint8_t) + rec->main_data_len;
+      }
+      rec->header.xl_xid = 0;
+      rec->header.xl_prev = 0;
+      rec->header.xl_info = last ? XLOG_SWITCH : XLOG_NOOP;
+      rec->header.xl_rmid = RM_XLOG_ID;
+      rec->header.xl_crc = 0;
+      rec->size = rec->header.xl_tot_len;
+
+      if (rec->main_data_len > 0)
+      {
+         rec->main_data = (char*)malloc(rec->main_data_len);
+         if (rec->main_data == NULL)
+         {
+            goto error;
+         }
+
+         for (uint32_t j = 0; j < rec->main_data_len; j++)
+         {
+            rec->main_data[j] = (char)(i + j);
+         }
+      }
+
+      if (pgmoneta_deque_add(wf->records, NULL, (uintptr_t)rec, ValueRef))
+      {
+         goto error;
+      }
+
+      rec = NULL;
+   }
+
+   return wf;
+
+error:
+   if (rec != NULL)
+   {
+      free(rec->main_data);
+      free(rec);
+   }
+
+   if (wf != NULL)
+   {
+      free(wf->long_phd);
+
+      if (wf->page_headers != NULL)
+      {
+         pgmoneta_deque_destroy(wf->page_headers);
+      }
+
+      if (wf->records != NULL)
+      {
+         struct deque_iterator* iter = NULL;
+
+         if (!pgmoneta_deque_iterator_create(wf->records, &iter))
+         {
+            while (pgmoneta_deque_iterator_next(iter))
+            {
+               struct decoded_xlog_record* r = (struct decoded_xlog_record*)iter->value->data;
+
+               free(r->main_data);
+               free(r);
+            }
+            pgmoneta_deque_iterator_destroy(iter);
+         }
+
+         pgmoneta_deque_destroy(wf->records);
+      }
+
+      free(wf);
+   }
+
+   return NULL;
+}
+
+int
+pgmoneta_test_seal_walfile(char* path, uint64_t* prev)
+{
+   struct xlog_long_page_header_data* long_header = NULL;
+   struct xlog_record* header = NULL;
+   char* segment = NULL;
+   char* record = NULL;
+   uint32_t seg_size = 0;
+   uint32_t blcksz = 0;
+   uint32_t length = 0;
+   uint32_t crc = 0;
+   uint64_t start = 0;
+   uint64_t lsn = 0;
+   uint64_t pos = 0;
+   uint32_t copied = 0;
+   uint32_t n = 0;
+   FILE* file = NULL;
+
+   segment = (char*)malloc(RANDOM_SEG_SIZE);
+   if (segment == NULL)
+   {
+      goto error;
+   }
+
+   file = fopen(path, "rb");
+   if (file == NULL || fread(segment, 1, RANDOM_SEG_SIZE, file) != RANDOM_SEG_SIZE)
+   {
+      goto error;
+   }
+   fclose(file);
+   file = NULL;
+
+   long_header = (struct xlog_long_page_header_data*)segment;
+   seg_size = long_header->xlp_seg_size;
+   blcksz = long_header->xlp_xlog_blcksz;
+   start = long_header->std.xlp_pageaddr;
+
+   if (seg_size != RANDOM_SEG_SIZE)
+   {
+      goto error;
+   }
+
+   pgmoneta_crc_init();
+
+   lsn = start + SIZE_OF_XLOG_LONG_PHD;
+   while (lsn < start + seg_size)
+   {
+      if (lsn % blcksz == 0)
+      {
+         lsn += SIZE_OF_XLOG_SHORT_PHD;
+      }
+
+      memcpy(&length, segment + (lsn - start), sizeof(uint32_t));
+      if (length == 0)
+      {
+         break;
+      }
+
+      record = (char*)malloc(length);
+      if (record == NULL)
+      {
+         goto error;
+      }
+
+      /* Gather the record from its pages */
+      copied = 0;
+      for (pos = lsn; copied < length; pos += n)
+      {
+         if (pos % blcksz == 0)
+         {
+            pos += SIZE_OF_XLOG_SHORT_PHD;
+         }
+
+         n = MIN(blcksz - (uint32_t)(pos % blcksz), length - copied);
+         memcpy(record + copied, segment + (pos - start), n);
+         copied += n;
+      }
+
+      header = (struct xlog_record*)record;
+      header->xl_prev = *prev;
+
+      /* The CRC covers the record data followed by the header up to xl_crc */
+      pgmoneta_init_crc32c(&crc);
+      pgmoneta_create_crc32c_buffer(record + SIZE_OF_XLOG_RECORD, length - SIZE_OF_XLOG_RECORD, &crc);
+      pgmoneta_create_crc32c_buffer(record, offsetof(struct xlog_record, xl_crc), &crc);
+      pgmoneta_finalize_crc32c(&crc);
+      header->xl_crc = crc;
+
+      /* Scatter it back */
+      copied = 0;
+      for (pos = lsn; copied < length; pos += n)
+      {
+         if (pos % blcksz == 0)
+         {
+            pos += SIZE_OF_XLOG_SHORT_PHD;
+         }
+
+         n = MIN(blcksz - (uint32_t)(pos % blcksz), length - copied);
+         memcpy(segment + (pos - start), record + copied, n);
+         copied += n;
+      }
+
+      *prev = lsn;
+
+      if (header->xl_rmid == RM_XLOG_ID && (header->xl_info & ~XLR_INFO_MASK) == XLOG_SWITCH)
+      {
+         free(record);
+         record = NULL;
+         break;
+      }
+
+      free(record);
+      record = NULL;
+
+      lsn = MAXALIGN(pos);
+   }
+
+   file = fopen(path, "wb");
+   if (file == NULL || fwrite(segment, 1, RANDOM_SEG_SIZE, file) != RANDOM_SEG_SIZE)
+   {
+      goto error;
+   }
+   fclose(file);
+
+   free(segment);
+
+   return 0;
+
+error:
+   if (file != NULL)
+   {
+      fclose(file);
+   }
+
+   free(record);
+   free(segment);
+
+   return 1;
+}
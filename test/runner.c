@@ -49,6 +49,8 @@ main(int argc, char* argv[])
    Suite* json_suite;
    Suite* server_api_suite;
    Suite* utils_suite;
+   Suite* catalog_suite;
+   Suite* verify_wal_suite;
    SRunner* sr;
 
    pgmoneta_test_environment_create();
@@ -65,6 +67,8 @@ main(int argc, char* argv[])
    json_suite = pgmoneta_test_json_suite();
    server_api_suite = pgmoneta_test_server_api_suite();
    utils_suite = pgmoneta_test_utils_suite();
+   catalog_suite = pgmoneta_test_catalog_suite();
+   verify_wal_suite = pgmoneta_test_verify_wal_suite();
 
    sr = srunner_create(backup_suite);
    srunner_add_suite(sr, restore_suite);
@@ -78,6 +82,8 @@ main(int argc, char* argv[])
    srunner_add_suite(sr, json_suite);
    srunner_add_suite(sr, server_api_suite);
    srunner_add_suite(sr, utils_suite);
+   srunner_add_suite(sr, catalog_suite);
+   srunner_add_suite(sr, verify_wal_suite);
    srunner_set_log (sr, "-");
    srunner_set_fork_status(sr, CK_NOFORK);
    srunner_run(sr, NULL, NULL, CK_VERBOSE);
@@ -29,6 +29,7 @@
 
 #include <pgmoneta.h>
 #include <art.h>
+#include <memory.h>
 #include <tscommon.h>
 #include <tssuite.h>
 #include <utils.h>
@@ -440,6 +441,147 @@ START_TEST(test_art_iterator_remove)
    pgmoneta_art_destroy(t);
 }
 END_TEST
+START_TEST(test_art_iterator_order)
+{
+   struct art* t = NULL;
+   struct art_iterator* iter = NULL;
+   char key[32];
+   char prev[32];
+   int cnt = 0;
+
+   pgmoneta_art_create(&t);
+   ck_assert_ptr_nonnull(t);
+
+   for (int i = 999; i >= 0; i--)
+   {
+      snprintf(key, sizeof(key), "key_%d", i * 7919 % 1000);
+      ck_assert(!pgmoneta_art_insert(t, key, (uintptr_t)i, ValueInt32));
+   }
+   ck_assert(!pgmoneta_art_insert(t, "key", 0, ValueInt32));
+   ck_assert(!pgmoneta_art_insert(t, "a_very_long_shared_prefix_a", 0, ValueInt32));
+   ck_assert(!pgmoneta_art_insert(t, "a_very_long_shared_prefix_b", 0, ValueInt32));
+
+   ck_assert(!pgmoneta_art_iterator_create(t, &iter));
+   memset(prev, 0, sizeof(prev));
+   while (pgmoneta_art_iterator_next(iter))
+   {
+      if (cnt > 0)
+      {
+         ck_assert_msg(strcmp(prev, iter->key) < 0, "%s returned after %s", iter->key, prev);
+      }
+      snprintf(prev, sizeof(prev), "%s", iter->key);
+      cnt++;
+   }
+   ck_assert_int_eq(cnt, 1003);
+   ck_assert(!pgmoneta_art_iterator_has_next(iter));
+
+   pgmoneta_art_iterator_destroy(iter);
+   pgmoneta_art_destroy(t);
+}
+END_TEST
+START_TEST(test_art_iterator_range)
+{
+   struct art* t = NULL;
+   struct art_iterator* iter = NULL;
+   char key[32];
+   int cnt = 0;
+
+   pgmoneta_art_create(&t);
+   ck_assert_ptr_nonnull(t);
+
+   for (int i = 0; i < 300; i++)
+   {
+      snprintf(key, sizeof(key), "base/%d/%d", i % 3, i);
+      ck_assert(!pgmoneta_art_insert(t, key, (uintptr_t)i, ValueInt32));
+   }
+   ck_assert(!pgmoneta_art_insert(t, "global/pg_control", 0, ValueInt32));
+
+   ck_assert(!pgmoneta_art_iterator_create(t, &iter));
+
+   /* Seek to a key that is not in the tree */
+   ck_assert(!pgmoneta_art_iterator_seek(iter, "base/2/97"));
+   ck_assert(pgmoneta_art_iterator_next(iter));
+   ck_assert_str_eq(iter->key, "base/2/98");
+   ck_assert(pgmoneta_art_iterator_next(iter));
+   ck_assert_str_eq(iter->key, "global/pg_control");
+   ck_assert(!pgmoneta_art_iterator_next(iter));
+
+   /* Half open range */
+   ck_assert(!pgmoneta_art_iterator_range(iter, "base/0/12", "base/0/15"));
+   ck_assert(pgmoneta_art_iterator_next(iter));
+   ck_assert_str_eq(iter->key, "base/0/12");
+   ck_assert(pgmoneta_art_iterator_next(iter));
+   ck_assert_str_eq(iter->key, "base/0/120");
+   ck_assert(!pgmoneta_art_iterator_range(iter, NULL, "base/0/102"));
+   ck_assert(pgmoneta_art_iterator_next(iter));
+   ck_assert_str_eq(iter->key, "base/0/0");
+   ck_assert(!pgmoneta_art_iterator_next(iter));
+
+   /* Prefix scan, removing every key on the way */
+   ck_assert(!pgmoneta_art_iterator_prefix(iter, "base/1/"));
+   while (pgmoneta_art_iterator_next(iter))
+   {
+      ck_assert(pgmoneta_starts_with(iter->key, "base/1/"));
+      pgmoneta_art_iterator_remove(iter);
+      cnt++;
+   }
+   ck_assert_int_eq(cnt, 100);
+   ck_assert_int_eq(t->size, 201);
+   ck_assert(!pgmoneta_art_contains_key(t, "base/1/1"));
+   ck_assert(pgmoneta_art_contains_key(t, "base/2/2"));
+
+   pgmoneta_art_iterator_destroy(iter);
+   pgmoneta_art_destroy(t);
+}
+END_TEST
+START_TEST(test_art_arena)
+{
+   struct memory_arena* arena = NULL;
+   struct art* t = NULL;
+   char key[32];
+   char* big = NULL;
+   uint64_t blocks = 0;
+
+   ck_assert(!pgmoneta_memory_arena_create(1024, &arena));
+   ck_assert_ptr_nonnull(arena);
+
+   big = pgmoneta_memory_arena_alloc(arena, 4096);
+   ck_assert_ptr_nonnull(big);
+   ck_assert_int_eq((uintptr_t)big % MEMORY_ARENA_ALIGNMENT, 0);
+   memset(big, 'x', 4096);
+
+   ck_assert(!pgmoneta_art_create_with_arena(arena, &t));
+   ck_assert_ptr_nonnull(t);
+
+   for (int i = 0; i < 500; i++)
+   {
+      snprintf(key, sizeof(key), "key_%d", i);
+      ck_assert(!pgmoneta_art_insert(t, key, (uintptr_t)key, ValueString));
+   }
+   ck_assert(!pgmoneta_art_insert(t, "key_0", (uintptr_t)"replaced", ValueString));
+   ck_assert_int_eq(t->size, 500);
+   ck_assert_str_eq((char*)pgmoneta_art_search(t, "key_0"), "replaced");
+   ck_assert_str_eq((char*)pgmoneta_art_search(t, "key_499"), "key_499");
+
+   ck_assert(!pgmoneta_art_delete(t, "key_1"));
+   ck_assert(!pgmoneta_art_contains_key(t, "key_1"));
+   ck_assert_int_eq(t->size, 499);
+
+   ck_assert(arena->allocations > 1000);
+   ck_assert(arena->blocks < arena->allocations / 10);
+
+   pgmoneta_art_destroy(t);
+
+   /* A reset keeps a single block around for the next round */
+   blocks = arena->blocks;
+   pgmoneta_memory_arena_reset(arena);
+   ck_assert_int_eq(arena->size, sizeof(struct memory_arena_block) + 1024);
+   ck_assert_ptr_nonnull(pgmoneta_memory_arena_strdup(arena, "again"));
+   ck_assert_int_eq(arena->blocks, blocks);
+
+   pgmoneta_memory_arena_destroy(arena);
+}
+END_TEST
 START_TEST(test_art_insert_search_extensive)
 {
    struct art* t = NULL;
@@ -621,6 +763,9 @@ pgmoneta_test_art_suite()
    tcase_add_test(tc_art_basic, test_art_clear);
    tcase_add_test(tc_art_basic, test_art_iterator_read);
    tcase_add_test(tc_art_basic, test_art_iterator_remove);
+   tcase_add_test(tc_art_basic, test_art_iterator_order);
+   tcase_add_test(tc_art_basic, test_art_iterator_range);
+   tcase_add_test(tc_art_basic, test_art_arena);
 
    tc_art_advanced = tcase_create("art_advanced_test");
    tcase_set_timeout(tc_art_advanced, 60);
@@ -0,0 +1,287 @@
+/*
+ * Copyright (C) 2025 The pgmoneta community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <pgmoneta.h>
+#include <catalog.h>
+#include <info.h>
+#include <shmem.h>
+#include <tscommon.h>
+#include <tssuite.h>
+#include <utils.h>
+
+#include <signal.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+static size_t catalog_size = 0;
+
+static void catalog_setup(void);
+static void catalog_teardown(void);
+static void catalog_save(char* label, int type, char* parent, char valid);
+static void catalog_free_labels(int number_of_labels, char** labels);
+
+START_TEST(test_catalog_labels)
+{
+   int number_of_labels = 0;
+   char** labels = NULL;
+   char* child = NULL;
+   char* root = NULL;
+
+   catalog_save("20250101000000", TYPE_FULL, "", VALID_TRUE);
+   catalog_save("20250102000000", TYPE_INCREMENTAL, "20250101000000", VALID_TRUE);
+   catalog_save("20250103000000", TYPE_INCREMENTAL, "20250102000000", VALID_TRUE);
+
+   ck_assert(!pgmoneta_catalog_load(PRIMARY_SERVER));
+
+   ck_assert(!pgmoneta_catalog_labels(PRIMARY_SERVER, &number_of_labels, &labels));
+   ck_assert_int_eq(number_of_labels, 3);
+   ck_assert_str_eq(labels[0], "20250101000000");
+   ck_assert_str_eq(labels[1], "20250102000000");
+   ck_assert_str_eq(labels[2], "20250103000000");
+
+   ck_assert(!pgmoneta_catalog_child(PRIMARY_SERVER, "20250101000000", &child));
+   ck_assert_ptr_nonnull(child);
+   ck_assert_str_eq(child, "20250102000000");
+
+   ck_assert(!pgmoneta_catalog_root(PRIMARY_SERVER, "20250103000000", &root));
+   ck_assert_ptr_nonnull(root);
+   ck_assert_str_eq(root, "20250101000000");
+
+   ck_assert(!pgmoneta_catalog_remove(PRIMARY_SERVER, "20250103000000"));
+   free(child);
+   child = NULL;
+   ck_assert(!pgmoneta_catalog_child(PRIMARY_SERVER, "20250102000000", &child));
+   ck_assert_ptr_null(child);
+
+   catalog_free_labels(number_of_labels, labels);
+   free(root);
+}
+END_TEST
+START_TEST(test_catalog_in_progress)
+{
+   int number = 0;
+   int number_of_labels = 0;
+   char** labels = NULL;
+   char* d = NULL;
+
+   catalog_save("20250101000000", TYPE_FULL, "", VALID_TRUE);
+
+   /* A backup without backup.info yet */
+   d = pgmoneta_get_server_backup_identifier(PRIMARY_SERVER, "20250102000000");
+   ck_assert(!pgmoneta_mkdir(d));
+
+   ck_assert(!pgmoneta_catalog_load(PRIMARY_SERVER));
+
+   ck_assert(!pgmoneta_catalog_labels(PRIMARY_SERVER, &number_of_labels, &labels));
+   ck_assert_int_eq(number_of_labels, 1);
+   ck_assert_str_eq(labels[0], "20250101000000");
+   catalog_free_labels(number_of_labels, labels);
+
+   /* The backup.info is written while the backup is running */
+   catalog_save("20250102000000", TYPE_FULL, "", VALID_UNKNOWN);
+
+   ck_assert(!pgmoneta_catalog_labels(PRIMARY_SERVER, &number_of_labels, &labels));
+   ck_assert_int_eq(number_of_labels, 2);
+   ck_assert_str_eq(labels[0], "20250101000000");
+   ck_assert_str_eq(labels[1], "20250102000000");
+   catalog_free_labels(number_of_labels, labels);
+
+   ck_assert(!pgmoneta_catalog_number_of_valid_backups(PRIMARY_SERVER, &number));
+   ck_assert_int_eq(number, 1);
+
+   /* The backup.info is refreshed once the backup is done */
+   catalog_save("20250102000000", TYPE_FULL, "", VALID_TRUE);
+
+   ck_assert(!pgmoneta_catalog_labels(PRIMARY_SERVER, &number_of_labels, &labels));
+   ck_assert_int_eq(number_of_labels, 2);
+   catalog_free_labels(number_of_labels, labels);
+
+   ck_assert(!pgmoneta_catalog_number_of_valid_backups(PRIMARY_SERVER, &number));
+   ck_assert_int_eq(number, 2);
+
+   /* A reload gives the same catalog */
+   ck_assert(!pgmoneta_catalog_load(PRIMARY_SERVER));
+
+   ck_assert(!pgmoneta_catalog_labels(PRIMARY_SERVER, &number_of_labels, &labels));
+   ck_assert_int_eq(number_of_labels, 2);
+   ck_assert_str_eq(labels[0], "20250101000000");
+   ck_assert_str_eq(labels[1], "20250102000000");
+   catalog_free_labels(number_of_labels, labels);
+
+   free(d);
+}
+END_TEST
+START_TEST(test_catalog_stale_lock)
+{
+   pid_t pid;
+   int number_of_labels = 0;
+   char** labels = NULL;
+   struct catalog* c = NULL;
+
+   catalog_save("20250101000000", TYPE_FULL, "", VALID_TRUE);
+
+   ck_assert(!pgmoneta_catalog_load(PRIMARY_SERVER));
+
+   /* A process that died while holding the lock */
+   pid = fork();
+   ck_assert_int_ne(pid, -1);
+   if (pid == 0)
+   {
+      _exit(0);
+   }
+   ck_assert_int_eq(waitpid(pid, NULL, 0), pid);
+
+   c = (struct catalog*)catalog_shmem;
+   atomic_store(&c->servers[PRIMARY_SERVER].lock, (int)pid);
+
+   ck_assert(!pgmoneta_catalog_labels(PRIMARY_SERVER, &number_of_labels, &labels));
+   ck_assert_int_eq(number_of_labels, 1);
+   ck_assert_str_eq(labels[0], "20250101000000");
+   ck_assert_int_eq(atomic_load(&c->servers[PRIMARY_SERVER].lock), 0);
+   catalog_free_labels(number_of_labels, labels);
+}
+END_TEST
+START_TEST(test_catalog_server_name)
+{
+   int number_of_labels = 0;
+   char** labels = NULL;
+   char name[MISC_LENGTH];
+   struct catalog* c = NULL;
+
+   catalog_save("20250101000000", TYPE_FULL, "", VALID_TRUE);
+
+   ck_assert(!pgmoneta_catalog_load(PRIMARY_SERVER));
+
+   /* The slot belongs to another server, as after a reload that moved the servers */
+   c = (struct catalog*)catalog_shmem;
+   memcpy(&name[0], &c->servers[PRIMARY_SERVER].name[0], sizeof(name));
+   snprintf(&c->servers[PRIMARY_SERVER].name[0], sizeof(c->servers[PRIMARY_SERVER].name), "%s", "moved");
+
+   ck_assert(pgmoneta_catalog_labels(PRIMARY_SERVER, &number_of_labels, &labels));
+   ck_assert_int_eq(number_of_labels, 0);
+   ck_assert_ptr_null(labels);
+
+   memcpy(&c->servers[PRIMARY_SERVER].name[0], &name[0], sizeof(name));
+
+   ck_assert(!pgmoneta_catalog_labels(PRIMARY_SERVER, &number_of_labels, &labels));
+   ck_assert_int_eq(number_of_labels, 1);
+   catalog_free_labels(number_of_labels, labels);
+}
+END_TEST
+
+Suite*
+pgmoneta_test_catalog_suite()
+{
+   Suite* s;
+   TCase* tc_catalog;
+
+   s = suite_create("pgmoneta_test_catalog");
+
+   tc_catalog = tcase_create("catalog_test");
+   tcase_set_timeout(tc_catalog, 60);
+   tcase_add_checked_fixture(tc_catalog, catalog_setup, catalog_teardown);
+   tcase_add_test(tc_catalog, test_catalog_labels);
+   tcase_add_test(tc_catalog, test_catalog_in_progress);
+   tcase_add_test(tc_catalog, test_catalog_stale_lock);
+   tcase_add_test(tc_catalog, test_catalog_server_name);
+   suite_add_tcase(s, tc_catalog);
+
+   return s;
+}
+
+static void
+catalog_setup(void)
+{
+   char* d = NULL;
+
+   pgmoneta_test_setup();
+
+   d = pgmoneta_get_server_backup(PRIMARY_SERVER);
+   pgmoneta_delete_directory(d);
+   pgmoneta_mkdir(d);
+   free(d);
+
+   ck_assert(!pgmoneta_catalog_init(&catalog_size, &catalog_shmem));
+}
+
+static void
+catalog_teardown(void)
+{
+   char* d = NULL;
+
+   pgmoneta_destroy_shared_memory(catalog_shmem, catalog_size);
+   catalog_shmem = NULL;
+   catalog_size = 0;
+
+   d = pgmoneta_get_server_backup(PRIMARY_SERVER);
+   pgmoneta_delete_directory(d);
+   pgmoneta_mkdir(d);
+   free(d);
+
+   pgmoneta_test_teardown();
+}
+
+static void
+catalog_save(char* label, int type, char* parent, char valid)
+{
+   char* d = NULL;
+   char* b = NULL;
+   struct backup* backup = NULL;
+
+   backup = (struct backup*)malloc(sizeof(struct backup));
+   ck_assert_ptr_nonnull(backup);
+   memset(backup, 0, sizeof(struct backup));
+
+   snprintf(&backup->label[0], sizeof(backup->label), "%s", label);
+   snprintf(&backup->parent_label[0], sizeof(backup->parent_label), "%s", parent);
+   backup->type = type;
+   backup->valid = valid;
+
+   b = pgmoneta_get_server_backup_identifier(PRIMARY_SERVER, label);
+   ck_assert(!pgmoneta_mkdir(b));
+
+   d = pgmoneta_get_server_backup(PRIMARY_SERVER);
+   ck_assert(!pgmoneta_save_info(d, backup));
+
+   free(backup);
+   free(b);
+   free(d);
+}
+
+static void
+catalog_free_labels(int number_of_labels, char** labels)
+{
+   for (int i = 0; i < number_of_labels; i++)
+   {
+      free(labels[i]);
+   }
+   free(labels);
+}
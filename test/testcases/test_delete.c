@@ -27,12 +27,16 @@
  *
  */
 
+#include <delete.h>
 #include <info.h>
 #include <tsclient.h>
 #include <tssuite.h>
 #include <tscommon.h>
 #include <utils.h>
 
+#include <dirent.h>
+#include <string.h>
+
 // test delete a single full backup
 START_TEST(test_pgmoneta_delete_full)
 {
@@ -146,6 +150,63 @@ START_TEST(test_pgmoneta_delete_chain_root)
    free(bcks_after);
 }
 END_TEST
+// test a deleted backup is moved into the trash and purged
+START_TEST(test_pgmoneta_delete_trash)
+{
+   int found = 0;
+   int entries = 0;
+   char* d = NULL;
+   char* trash = NULL;
+   int num_bck = 0;
+   struct backup** bcks = NULL;
+   DIR* dir = NULL;
+   struct dirent* entry = NULL;
+
+   d = pgmoneta_get_server_backup(PRIMARY_SERVER);
+   trash = pgmoneta_get_server_trash(PRIMARY_SERVER);
+
+   found = !pgmoneta_tsclient_delete("primary", "oldest");
+   ck_assert_msg(found, "success status not found");
+
+   pgmoneta_load_infos(d, &num_bck, &bcks);
+   ck_assert_int_eq(num_bck, 0);
+
+   dir = opendir(trash);
+   ck_assert_ptr_nonnull(dir);
+   while ((entry = readdir(dir)) != NULL)
+   {
+      if (strcmp(entry->d_name, ".") && strcmp(entry->d_name, ".."))
+      {
+         entries++;
+      }
+   }
+   closedir(dir);
+   ck_assert_int_eq(entries, 1);
+
+   ck_assert_int_eq(pgmoneta_purge_trash(PRIMARY_SERVER), 0);
+
+   entries = 0;
+   dir = opendir(trash);
+   ck_assert_ptr_nonnull(dir);
+   while ((entry = readdir(dir)) != NULL)
+   {
+      if (strcmp(entry->d_name, ".") && strcmp(entry->d_name, ".."))
+      {
+         entries++;
+      }
+   }
+   closedir(dir);
+   ck_assert_int_eq(entries, 0);
+
+   free(d);
+   free(trash);
+   for (int i = 0; i < num_bck; i++)
+   {
+      free(bcks[i]);
+   }
+   free(bcks);
+}
+END_TEST
 
 Suite*
 pgmoneta_test_delete_suite()
@@ -160,6 +221,7 @@ pgmoneta_test_delete_suite()
    tcase_set_timeout(tc_delete_full, 60);
    tcase_add_checked_fixture(tc_delete_full, pgmoneta_test_add_backup, pgmoneta_test_basedir_cleanup);
    tcase_add_test(tc_delete_full, test_pgmoneta_delete_full);
+   tcase_add_test(tc_delete_full, test_pgmoneta_delete_trash);
    suite_add_tcase(s, tc_delete_full);
 
    tc_delete_chain = tcase_create("delete_chain_test");
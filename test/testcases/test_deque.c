@@ -292,6 +292,210 @@ START_TEST(test_deque_sort)
    pgmoneta_deque_destroy(dq);
 }
 END_TEST
+START_TEST(test_deque_wraparound)
+{
+   struct deque* dq = NULL;
+   struct deque_iterator* iter = NULL;
+   int next = 0;
+   int expected = 0;
+   char tag[MISC_LENGTH];
+
+   pgmoneta_deque_create(false, &dq);
+
+   // keep the head moving through the ring buffer while it grows
+   for (int round = 0; round < 100; round++)
+   {
+      for (int i = 0; i < 3; i++)
+      {
+         snprintf(&tag[0], sizeof(tag), "%d", next);
+         ck_assert(!pgmoneta_deque_add(dq, tag, next, ValueInt32));
+         next++;
+      }
+      ck_assert_int_eq(pgmoneta_deque_poll(dq, NULL), expected);
+      expected++;
+   }
+   ck_assert_int_eq(dq->size, 200);
+   ck_assert_int_eq(pgmoneta_deque_peek(dq, NULL), expected);
+   ck_assert_int_eq(pgmoneta_deque_peek_last(dq, NULL), next - 1);
+
+   // remove every third node, from both sides of the ring buffer
+   pgmoneta_deque_iterator_create(dq, &iter);
+   while (pgmoneta_deque_iterator_next(iter))
+   {
+      if (pgmoneta_value_data(iter->value) % 3 == 0)
+      {
+         pgmoneta_deque_iterator_remove(iter);
+      }
+   }
+   pgmoneta_deque_iterator_destroy(iter);
+
+   pgmoneta_deque_iterator_create(dq, &iter);
+   while (pgmoneta_deque_iterator_next(iter))
+   {
+      if (expected % 3 == 0)
+      {
+         expected++;
+      }
+      ck_assert_int_eq(pgmoneta_value_data(iter->value), expected);
+      snprintf(&tag[0], sizeof(tag), "%d", expected);
+      ck_assert_str_eq(iter->tag, tag);
+      expected++;
+   }
+   ck_assert_int_eq(expected, next);
+   pgmoneta_deque_iterator_destroy(iter);
+
+   while (!pgmoneta_deque_empty(dq))
+   {
+      pgmoneta_deque_poll_last(dq, NULL);
+   }
+   ck_assert_int_eq(pgmoneta_deque_poll(dq, NULL), 0);
+
+   pgmoneta_deque_destroy(dq);
+}
+END_TEST
+START_TEST(test_deque_index)
+{
+   struct deque* dq = NULL;
+   char tag[MISC_LENGTH];
+   char* t = NULL;
+   int size = DEQUE_INDEX_THRESHOLD * 4;
+
+   pgmoneta_deque_create(true, &dq);
+   for (int i = 0; i < size; i++)
+   {
+      snprintf(&tag[0], sizeof(tag), "tag%d", i);
+      ck_assert(!pgmoneta_deque_add(dq, tag, i, ValueInt32));
+   }
+
+   ck_assert_ptr_null(dq->index);
+   ck_assert_int_eq(pgmoneta_deque_get(dq, "tag42"), 42);
+   ck_assert_ptr_nonnull(dq->index);
+   ck_assert(!pgmoneta_deque_exists(dq, "tag"));
+   ck_assert(!pgmoneta_deque_exists(dq, ""));
+   ck_assert(!pgmoneta_deque_exists(dq, NULL));
+
+   // the index follows additions and removals
+   ck_assert(!pgmoneta_deque_add(dq, "new", 1000, ValueInt32));
+   ck_assert_int_eq(pgmoneta_deque_get(dq, "new"), 1000);
+   ck_assert_int_eq(pgmoneta_deque_poll(dq, &t), 0);
+   ck_assert_str_eq(t, "tag0");
+   free(t);
+   ck_assert(!pgmoneta_deque_exists(dq, "tag0"));
+   ck_assert_int_eq(pgmoneta_deque_remove(dq, "tag42"), 1);
+   ck_assert(!pgmoneta_deque_exists(dq, "tag42"));
+   for (int i = 1; i < size; i++)
+   {
+      snprintf(&tag[0], sizeof(tag), "tag%d", i);
+      ck_assert_int_eq(pgmoneta_deque_exists(dq, tag), i != 42);
+   }
+   ck_assert_ptr_nonnull(dq->index);
+
+   // the first node of a tag wins, also after the index is rebuilt
+   ck_assert(!pgmoneta_deque_add(dq, "tag7", 2000, ValueInt32));
+   ck_assert_int_eq(pgmoneta_deque_get(dq, "tag7"), 7);
+   ck_assert_int_eq(pgmoneta_deque_remove(dq, "tag8"), 1);
+   ck_assert_int_eq(pgmoneta_deque_get(dq, "tag7"), 7);
+   pgmoneta_deque_sort(dq);
+   ck_assert_int_eq(pgmoneta_deque_get(dq, "tag7"), 7);
+   ck_assert_int_eq(pgmoneta_deque_get(dq, "tag9"), 9);
+   ck_assert_int_eq(pgmoneta_deque_remove(dq, "tag7"), 2);
+   ck_assert(!pgmoneta_deque_exists(dq, "tag7"));
+   ck_assert_int_eq(pgmoneta_deque_get(dq, "new"), 1000);
+
+   ck_assert(!pgmoneta_deque_clear(dq));
+   ck_assert_ptr_null(dq->index);
+   ck_assert(!pgmoneta_deque_exists(dq, "new"));
+
+   pgmoneta_deque_destroy(dq);
+}
+END_TEST
+
+START_TEST(test_deque_iterator_remove_lookup)
+{
+   struct deque* dq = NULL;
+   struct deque_iterator* iter = NULL;
+   char tag[MISC_LENGTH];
+   char* t = NULL;
+   char* str = NULL;
+   int sizes[2] = {DEQUE_MINIMUM_CAPACITY, DEQUE_INDEX_THRESHOLD * 2};
+   int size = 0;
+   int removed = 0;
+   int cnt = 0;
+   int v = 0;
+
+   // a small deque searches the nodes, a large one builds the tag index during the iteration
+   for (int k = 0; k < 2; k++)
+   {
+      size = sizes[k];
+      removed = 0;
+      cnt = 0;
+
+      pgmoneta_deque_create(false, &dq);
+      for (int i = 0; i < size; i++)
+      {
+         snprintf(&tag[0], sizeof(tag), "tag%d", i);
+         ck_assert(!pgmoneta_deque_add(dq, tag, i, ValueInt32));
+      }
+
+      pgmoneta_deque_iterator_create(dq, &iter);
+      while (pgmoneta_deque_iterator_next(iter))
+      {
+         v = (int)pgmoneta_value_data(iter->value);
+
+         // remove the first nodes and every third one after them
+         if (v < 3 || v % 3 == 0)
+         {
+            pgmoneta_deque_iterator_remove(iter);
+            removed++;
+         }
+
+         // the removed nodes are gone while the iteration goes on
+         ck_assert_int_eq(pgmoneta_deque_size(dq), size - removed);
+         ck_assert_int_eq(pgmoneta_deque_peek(dq, NULL), v < 3 ? v + 1 : 4);
+         ck_assert_int_eq(pgmoneta_deque_peek_last(dq, NULL), v == size - 1 && v % 3 == 0 ? size - 2 : size - 1);
+         ck_assert(!pgmoneta_deque_exists(dq, "tag0"));
+         snprintf(&tag[0], sizeof(tag), "tag%d", v);
+         ck_assert_int_eq(pgmoneta_deque_exists(dq, tag), !(v < 3 || v % 3 == 0));
+         ck_assert_int_eq(pgmoneta_deque_get(dq, "tag5"), 5);
+      }
+
+      pgmoneta_deque_iterator_destroy(iter);
+
+      str = pgmoneta_deque_to_string(dq, FORMAT_JSON_COMPACT, NULL, 0);
+      ck_assert(pgmoneta_starts_with(str, "[tag4:4,tag5:5,tag7:7"));
+      free(str);
+
+      // nodes added while a removed slot is pending, also when the deque grows, go to the tail
+      pgmoneta_deque_iterator_create(dq, &iter);
+      ck_assert(pgmoneta_deque_iterator_next(iter));
+      pgmoneta_deque_iterator_remove(iter);
+      removed++;
+      for (int i = 0; i < size; i++)
+      {
+         snprintf(&tag[0], sizeof(tag), "new%d", i);
+         ck_assert(!pgmoneta_deque_add(dq, tag, 1000 + i, ValueInt32));
+      }
+      ck_assert_int_eq(pgmoneta_deque_size(dq), 2 * size - removed);
+      ck_assert_int_eq(pgmoneta_deque_peek(dq, NULL), 5);
+      ck_assert_int_eq(pgmoneta_deque_peek_last(dq, NULL), 1000 + size - 1);
+      ck_assert_int_eq(pgmoneta_deque_get(dq, "new0"), 1000);
+      while (pgmoneta_deque_iterator_next(iter))
+      {
+         cnt++;
+      }
+      ck_assert_int_eq(cnt, 2 * size - removed);
+      pgmoneta_deque_iterator_destroy(iter);
+
+      ck_assert_int_eq(pgmoneta_deque_poll(dq, &t), 5);
+      ck_assert_str_eq(t, "tag5");
+      free(t);
+      ck_assert_int_eq(pgmoneta_deque_poll_last(dq, &t), 1000 + size - 1);
+      free(t);
+
+      pgmoneta_deque_destroy(dq);
+   }
+}
+END_TEST
 
 Suite*
 pgmoneta_test_deque_suite()
@@ -313,6 +517,9 @@ pgmoneta_test_deque_suite()
    tcase_add_test(tc_deque_basic, test_deque_iterator_read);
    tcase_add_test(tc_deque_basic, test_deque_iterator_remove);
    tcase_add_test(tc_deque_basic, test_deque_sort);
+   tcase_add_test(tc_deque_basic, test_deque_wraparound);
+   tcase_add_test(tc_deque_basic, test_deque_index);
+   tcase_add_test(tc_deque_basic, test_deque_iterator_remove_lookup);
 
    suite_add_tcase(s, tc_deque_basic);
 
@@ -27,9 +27,23 @@
  *
  */
 
+/* pgmoneta */
+#include <pgmoneta.h>
+#include <info.h>
+#include <message.h>
+#include <network.h>
+#include <security.h>
 #include <tssuite.h>
 #include <tsclient.h>
 #include <tscommon.h>
+#include <utils.h>
+
+/* system */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void execute_query(SSL* ssl, int socket, char* query, char** result);
 
 // test restore
 START_TEST(test_pgmoneta_restore)
@@ -40,12 +54,104 @@ START_TEST(test_pgmoneta_restore)
 }
 END_TEST
 
+// test a rolled up incremental backup restores to the same files as the chain it replaces
+START_TEST(test_pgmoneta_restore_rollup)
+{
+   SSL* ssl = NULL;
+   int socket = -1;
+   int ret = 0;
+   char* relation = NULL;
+   char* size_before = NULL;
+   char* size_after = NULL;
+   char* d = NULL;
+   char* combined = NULL;
+   char* combined_file = NULL;
+   char* rolled_up = NULL;
+   char* rolled_up_file = NULL;
+   int num_bck = 0;
+   struct backup** bcks = NULL;
+
+   ret = !pgmoneta_server_authenticate(PRIMARY_SERVER, "mydb", "myuser", "password", false, &ssl, &socket);
+   ck_assert_msg(ret, "failed to establish a connection to the user: myuser and database: mydb");
+
+   execute_query(ssl, socket, "DROP TABLE IF EXISTS t_rollup;", NULL);
+   execute_query(ssl, socket, "CREATE TABLE t_rollup (id int, pad text);", NULL);
+   execute_query(ssl, socket, "INSERT INTO t_rollup SELECT i, repeat('x', 200) FROM generate_series(1, 20000) i;", NULL);
+   execute_query(ssl, socket, "SELECT pg_relation_filepath('t_rollup');", &relation);
+
+   ck_assert(!pgmoneta_tsclient_backup("primary", NULL));
+
+   execute_query(ssl, socket, "UPDATE t_rollup SET pad = repeat('y', 200) WHERE id % 100 = 0;", NULL);
+
+   ck_assert(!pgmoneta_tsclient_backup("primary", "newest"));
+
+   // Truncate the tail of the relation, and change some of the remaining blocks
+   execute_query(ssl, socket, "SELECT pg_relation_size('t_rollup');", &size_before);
+   execute_query(ssl, socket, "DELETE FROM t_rollup WHERE id > 10000;", NULL);
+   execute_query(ssl, socket, "VACUUM t_rollup;", NULL);
+   execute_query(ssl, socket, "SELECT pg_relation_size('t_rollup');", &size_after);
+   ck_assert_int_lt(strtoll(size_after, NULL, 10), strtoll(size_before, NULL, 10));
+   execute_query(ssl, socket, "UPDATE t_rollup SET pad = repeat('z', 200) WHERE id % 250 = 0;", NULL);
+
+   ck_assert(!pgmoneta_tsclient_backup("primary", "newest"));
+
+   d = pgmoneta_get_server_backup(PRIMARY_SERVER);
+   pgmoneta_load_infos(d, &num_bck, &bcks);
+   ck_assert_int_eq(num_bck, 3);
+
+   rolled_up = pgmoneta_append(rolled_up, TEST_RESTORE_DIR);
+   rolled_up = pgmoneta_append(rolled_up, "/primary-");
+   rolled_up = pgmoneta_append(rolled_up, bcks[2]->label);
+
+   combined = pgmoneta_append(combined, rolled_up);
+   combined = pgmoneta_append(combined, "-combined");
+
+   // Restore from the full chain
+   ck_assert(!pgmoneta_tsclient_restore("primary", "newest", "current"));
+   ck_assert_int_eq(rename(rolled_up, combined), 0);
+
+   // Deleting the middle backup merges the newest incremental backup with it
+   ck_assert(!pgmoneta_tsclient_delete("primary", bcks[1]->label));
+   ck_assert(!pgmoneta_tsclient_restore("primary", "newest", "current"));
+
+   combined_file = pgmoneta_append(combined_file, combined);
+   combined_file = pgmoneta_append(combined_file, "/");
+   combined_file = pgmoneta_append(combined_file, relation);
+
+   rolled_up_file = pgmoneta_append(rolled_up_file, rolled_up);
+   rolled_up_file = pgmoneta_append(rolled_up_file, "/");
+   rolled_up_file = pgmoneta_append(rolled_up_file, relation);
+
+   ck_assert_int_eq(pgmoneta_get_file_size(rolled_up_file), pgmoneta_get_file_size(combined_file));
+   ck_assert_msg(pgmoneta_compare_files(rolled_up_file, combined_file), "%s differs from %s", rolled_up_file, combined_file);
+
+   execute_query(ssl, socket, "DROP TABLE t_rollup;", NULL);
+
+   pgmoneta_disconnect(socket);
+
+   for (int i = 0; i < num_bck; i++)
+   {
+      free(bcks[i]);
+   }
+   free(bcks);
+   free(d);
+   free(relation);
+   free(size_before);
+   free(size_after);
+   free(combined);
+   free(combined_file);
+   free(rolled_up);
+   free(rolled_up_file);
+}
+END_TEST
+
 Suite*
 pgmoneta_test_restore_suite()
 {
    Suite* s;
    TCase* tc_restore_full;
    TCase* tc_restore_incremental;
+   TCase* tc_restore_rollup;
 
    s = suite_create("pgmoneta_test_restore");
 
@@ -61,5 +167,26 @@ pgmoneta_test_restore_suite()
    tcase_add_test(tc_restore_incremental, test_pgmoneta_restore);
    suite_add_tcase(s, tc_restore_incremental);
 
+   tc_restore_rollup = tcase_create("rollup_restore_test");
+   tcase_set_timeout(tc_restore_rollup, 120);
+   tcase_add_checked_fixture(tc_restore_rollup, pgmoneta_test_setup, pgmoneta_test_basedir_cleanup);
+   tcase_add_test(tc_restore_rollup, test_pgmoneta_restore_rollup);
+   suite_add_tcase(s, tc_restore_rollup);
+
    return s;
-}
\ No newline at end of file
+}
+
+static void
+execute_query(SSL* ssl, int socket, char* query, char** result)
+{
+   struct query_response* qr = NULL;
+
+   ck_assert_msg(!pgmoneta_test_execute_query(PRIMARY_SERVER, ssl, socket, query, &qr), "failed to execute a query: '%s'", query);
+
+   if (result != NULL)
+   {
+      *result = pgmoneta_append(NULL, pgmoneta_query_response_get_data(qr, 0));
+   }
+
+   pgmoneta_free_query_response(qr);
+}
@@ -104,7 +104,7 @@ START_TEST(test_server_api_backup)
    ret = !pgmoneta_server_start_backup(PRIMARY_SERVER, srv_ssl, srv_socket, "test_backup", &start_lsn);
    ck_assert_msg(ret, "failed to start backup");
 
-   ret = !pgmoneta_server_stop_backup(PRIMARY_SERVER, srv_ssl, srv_socket, &stop_lsn, &lf);
+   ret = !pgmoneta_server_stop_backup(PRIMARY_SERVER, srv_ssl, srv_socket, &stop_lsn, NULL, &lf);
    ck_assert_msg(ret, "failed to stop backup");
 
    free(start_lsn);
@@ -0,0 +1,277 @@
+/*
+ * Copyright (C) 2025 The pgmoneta community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <pgmoneta.h>
+#include <deque.h>
+#include <shmem.h>
+#include <tscommon.h>
+#include <tssuite.h>
+#include <tswalutils.h>
+#include <utils.h>
+#include <verify.h>
+#include <walfile.h>
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* The records of a segment span its first four pages */
+#define VERIFY_RECORDS 200
+
+static char verify_base_dir[MAX_PATH];
+
+static void verify_setup(void);
+static void verify_teardown(void);
+static void verify_write(uint32_t seg, bool xlog_switch, uint64_t* prev);
+static void verify_corrupt(uint32_t seg, size_t offset, void* data, size_t size);
+static struct wal_verification* verify_archive(void);
+
+START_TEST(test_verify_wal_valid)
+{
+   uint64_t prev = 0;
+   struct wal_verification* wv = NULL;
+
+   verify_write(0x10, true, &prev);
+   verify_write(0x11, true, &prev);
+   verify_write(0x12, false, &prev);
+
+   wv = verify_archive();
+
+   ck_assert(wv->valid);
+   ck_assert_uint_eq(wv->first_bad_lsn, 0);
+   ck_assert_uint_eq(wv->segments, 3);
+   ck_assert_uint_eq(wv->records, 3 * VERIFY_RECORDS + 2);
+   ck_assert_int_eq(pgmoneta_deque_size(wv->gaps), 0);
+
+   pgmoneta_destroy_wal_verification(wv);
+}
+END_TEST
+START_TEST(test_verify_wal_crc)
+{
+   uint64_t prev = 0;
+   char byte = 0x7F;
+   struct wal_verification* wv = NULL;
+
+   verify_write(0x10, true, &prev);
+   verify_write(0x11, true, &prev);
+   verify_write(0x12, false, &prev);
+
+   /* The main data of the first record of 0/11000028 */
+   verify_corrupt(0x11, SIZE_OF_XLOG_LONG_PHD + SIZE_OF_XLOG_RECORD + 10, &byte, sizeof(byte));
+
+   wv = verify_archive();
+
+   ck_assert(!wv->valid);
+   ck_assert_uint_eq(wv->first_bad_lsn, 0x11000000 + SIZE_OF_XLOG_LONG_PHD);
+   ck_assert_ptr_nonnull(strstr(wv->reason, "000000010000000000000011"));
+   ck_assert_ptr_nonnull(strstr(wv->reason, "CRC32C"));
+   ck_assert_int_eq(pgmoneta_deque_size(wv->gaps), 0);
+
+   pgmoneta_destroy_wal_verification(wv);
+}
+END_TEST
+START_TEST(test_verify_wal_page_address)
+{
+   uint64_t prev = 0;
+   uint64_t pageaddr = 0x21002000;
+   struct wal_verification* wv = NULL;
+
+   verify_write(0x10, true, &prev);
+   verify_write(0x11, true, &prev);
+   verify_write(0x12, false, &prev);
+
+   /* The second page of 0/11000000 claims to be somewhere else */
+   verify_corrupt(0x11, RANDOM_XLOG_BLCKSZ + offsetof(struct xlog_page_header_data, xlp_pageaddr), &pageaddr, sizeof(pageaddr));
+
+   wv = verify_archive();
+
+   ck_assert(!wv->valid);
+   ck_assert_uint_eq(wv->first_bad_lsn, 0x11000000 + RANDOM_XLOG_BLCKSZ);
+   ck_assert_ptr_nonnull(strstr(wv->reason, "page address"));
+
+   pgmoneta_destroy_wal_verification(wv);
+}
+END_TEST
+START_TEST(test_verify_wal_prev)
+{
+   uint64_t prev = 0;
+   uint64_t wrong = 0;
+   struct wal_verification* wv = NULL;
+
+   verify_write(0x10, true, &prev);
+
+   /* The first record of 0/11000000 doesn't point back at the XLOG_SWITCH of 0/10000000 */
+   wrong = prev - 8;
+   verify_write(0x11, true, &wrong);
+   verify_write(0x12, false, &wrong);
+
+   wv = verify_archive();
+
+   ck_assert(!wv->valid);
+   ck_assert_uint_eq(wv->first_bad_lsn, 0x11000000 + SIZE_OF_XLOG_LONG_PHD);
+   ck_assert_ptr_nonnull(strstr(wv->reason, "xl_prev"));
+
+   pgmoneta_destroy_wal_verification(wv);
+}
+END_TEST
+START_TEST(test_verify_wal_gap)
+{
+   uint64_t prev = 0;
+   char* tag = NULL;
+   struct wal_verification* wv = NULL;
+
+   verify_write(0x10, true, &prev);
+   verify_write(0x11, true, &prev);
+   verify_write(0x14, false, &prev);
+
+   wv = verify_archive();
+
+   ck_assert(wv->valid);
+   ck_assert_uint_eq(wv->segments, 3);
+   ck_assert_int_eq(pgmoneta_deque_size(wv->gaps), 1);
+   ck_assert_str_eq((char*)pgmoneta_deque_peek(wv->gaps, &tag), "000000010000000000000012 - 000000010000000000000013");
+
+   pgmoneta_destroy_wal_verification(wv);
+}
+END_TEST
+
+Suite*
+pgmoneta_test_verify_wal_suite()
+{
+   Suite* s;
+   TCase* tc_verify_wal;
+
+   s = suite_create("pgmoneta_test_verify_wal");
+
+   tc_verify_wal = tcase_create("verify_wal_test");
+   tcase_set_timeout(tc_verify_wal, 60);
+   tcase_add_checked_fixture(tc_verify_wal, verify_setup, verify_teardown);
+   tcase_add_test(tc_verify_wal, test_verify_wal_valid);
+   tcase_add_test(tc_verify_wal, test_verify_wal_crc);
+   tcase_add_test(tc_verify_wal, test_verify_wal_page_address);
+   tcase_add_test(tc_verify_wal, test_verify_wal_prev);
+   tcase_add_test(tc_verify_wal, test_verify_wal_gap);
+   suite_add_tcase(s, tc_verify_wal);
+
+   return s;
+}
+
+static void
+verify_setup(void)
+{
+   char* d = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   pgmoneta_test_setup();
+
+   /* The WAL archive of the test server is left alone */
+   memcpy(&verify_base_dir[0], &config->base_dir[0], sizeof(verify_base_dir));
+   memset(&config->base_dir[0], 0, sizeof(config->base_dir));
+   snprintf(&config->base_dir[0], sizeof(config->base_dir), "%s/verify", TEST_BASE_DIR);
+
+   d = pgmoneta_get_server_wal(PRIMARY_SERVER);
+   pgmoneta_delete_directory(d);
+   ck_assert(!pgmoneta_mkdir(d));
+   free(d);
+}
+
+static void
+verify_teardown(void)
+{
+   char* d = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   d = pgmoneta_append(d, config->base_dir);
+   pgmoneta_delete_directory(d);
+   free(d);
+
+   memcpy(&config->base_dir[0], &verify_base_dir[0], sizeof(config->base_dir));
+
+   pgmoneta_test_teardown();
+}
+
+static void
+verify_write(uint32_t seg, bool xlog_switch, uint64_t* prev)
+{
+   char* path = NULL;
+   char* name = NULL;
+   struct walfile* wf = NULL;
+
+   name = pgmoneta_wal_file_name(RANDOM_TLI, seg, RANDOM_SEG_SIZE);
+   ck_assert_ptr_nonnull(name);
+
+   path = pgmoneta_get_server_wal(PRIMARY_SERVER);
+   path = pgmoneta_append(path, name);
+
+   wf = pgmoneta_test_generate_segment_v17((uint64_t)seg * RANDOM_SEG_SIZE, VERIFY_RECORDS, xlog_switch);
+   ck_assert_ptr_nonnull(wf);
+
+   ck_assert(!pgmoneta_write_walfile(wf, PRIMARY_SERVER, path));
+   ck_assert(!pgmoneta_test_seal_walfile(path, prev));
+
+   pgmoneta_destroy_walfile(wf);
+   free(name);
+   free(path);
+}
+
+static void
+verify_corrupt(uint32_t seg, size_t offset, void* data, size_t size)
+{
+   char* path = NULL;
+   char* name = NULL;
+   FILE* file = NULL;
+
+   name = pgmoneta_wal_file_name(RANDOM_TLI, seg, RANDOM_SEG_SIZE);
+   path = pgmoneta_get_server_wal(PRIMARY_SERVER);
+   path = pgmoneta_append(path, name);
+
+   file = fopen(path, "r+b");
+   ck_assert_ptr_nonnull(file);
+   ck_assert_int_eq(fseek(file, (long)offset, SEEK_SET), 0);
+   ck_assert_uint_eq(fwrite(data, 1, size, file), size);
+   fclose(file);
+
+   free(name);
+   free(path);
+}
+
+static struct wal_verification*
+verify_archive(void)
+{
+   struct wal_verification* wv = NULL;
+
+   ck_assert(!pgmoneta_verify_wal_archive(PRIMARY_SERVER, &wv));
+   ck_assert_ptr_nonnull(wv);
+
+   return wv;
+}
@@ -36,8 +36,10 @@
 #include <tscommon.h>
 #include <tssuite.h>
 #include <tswalutils.h>
+#include <info.h>
 #include <utils.h>
 #include <value.h>
+#include <wal.h>
 #include <walfile.h>
 
 /* system */
@@ -47,37 +49,219 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <sys/mman.h>
 #include <sys/types.h>
 
 static void test_walfile(struct walfile* (*generate)(void));
+static void test_walfile_filtered(struct walfile* (*generate)(void));
+static bool skip_record(struct xlog_record* record, void* data);
+static void init_partial_record(void);
+static void destroy_partial_record(void);
 static void compare_walfile(struct walfile* wf1, struct walfile* wf2);
+static void compare_toplevel_xids(struct walfile* wf1, struct walfile* wf2);
 static bool compare_long_page_headers(struct xlog_long_page_header_data* h1, struct xlog_long_page_header_data* h2);
 static void compare_deque(struct deque* dq1, struct deque* dq2, void (*compare)(void*, void*));
 static bool compare_xlog_page_header(void* a, void* b);
 static void compare_xlog_record(void* a, void* b);
 static void destroy_walfile(struct walfile* wf);
+static void wal_range_setup(void);
+static void wal_range_teardown(void);
+static void wal_range_write(char* path, char* content);
+static struct wal_range* wal_range_compute(uint32_t tli, uint64_t start, uint64_t end, char* position);
+static bool wal_range_has(struct wal_range* range, uint32_t tli, uint32_t log, uint32_t seg);
+
+/* The test timelines are 32 (0x20) to 35 (0x23), which the test server doesn't reach */
+#define WAL_RANGE_SEGMENT_SIZE (16 * 1024 * 1024)
+#define WAL_RANGE_TIME         1735689600
+
+static int wal_range_saved_size = 0;
 
 START_TEST(test_check_point_shutdown_v17)
 {
    test_walfile(pgmoneta_test_generate_check_point_shutdown_v17);
 }
 END_TEST
+START_TEST(test_check_point_shutdown_v17_filtered)
+{
+   test_walfile_filtered(pgmoneta_test_generate_check_point_shutdown_v17);
+}
+END_TEST
+START_TEST(test_subtransaction_v17)
+{
+   test_walfile(pgmoneta_test_generate_subtransaction_v17);
+}
+END_TEST
+START_TEST(test_subtransaction_v17_filtered)
+{
+   test_walfile_filtered(pgmoneta_test_generate_subtransaction_v17);
+}
+END_TEST
+
+START_TEST(test_wal_range_current)
+{
+   struct wal_range* range = NULL;
+
+   /* Timeline 32 starts at 0/1000000, the backup runs from segment 2 to 3 */
+   range = wal_range_compute(32, 0x2000028, 0x3000100, "current,timeline=current");
+   ck_assert_ptr_nonnull(range);
+   ck_assert_ptr_null(range->next);
+   ck_assert_uint_eq(range->tli, 32);
+
+   ck_assert(!wal_range_has(range, 32, 0, 1));
+   ck_assert(wal_range_has(range, 32, 0, 2));
+   ck_assert(wal_range_has(range, 32, 0, 3));
+   ck_assert(!wal_range_has(range, 32, 0, 4));
+   ck_assert(!wal_range_has(range, 1, 0, 2));
+   ck_assert(pgmoneta_wal_range_contains(range, "00000020.history"));
+
+   pgmoneta_free_wal_range(range);
+}
+END_TEST
+START_TEST(test_wal_range_lsn)
+{
+   struct wal_range* range = NULL;
+
+   range = wal_range_compute(32, 0x2000028, 0x3000100, "lsn=0/4000010,timeline=32");
+   ck_assert_ptr_nonnull(range);
+
+   ck_assert(wal_range_has(range, 32, 0, 2));
+   ck_assert(wal_range_has(range, 32, 0, 5));
+   ck_assert(!wal_range_has(range, 32, 0, 6));
+
+   pgmoneta_free_wal_range(range);
+}
+END_TEST
+START_TEST(test_wal_range_timeline_switch)
+{
+   struct wal_range* range = NULL;
+
+   /* Timeline 34 comes from 32 at 0/5000000 and 33 at 0/9000000 */
+   range = wal_range_compute(32, 0x2000028, 0x3000100, "lsn=0/B000010,timeline=34");
+   ck_assert_ptr_nonnull(range);
+
+   ck_assert(!wal_range_has(range, 32, 0, 1));
+   ck_assert(wal_range_has(range, 32, 0, 2));
+   ck_assert(wal_range_has(range, 32, 0, 5));
+   ck_assert(!wal_range_has(range, 32, 0, 6));
+   ck_assert(!wal_range_has(range, 33, 0, 4));
+   ck_assert(wal_range_has(range, 33, 0, 5));
+   ck_assert(wal_range_has(range, 33, 0, 9));
+   ck_assert(!wal_range_has(range, 33, 0, 10));
+   ck_assert(!wal_range_has(range, 34, 0, 8));
+   ck_assert(wal_range_has(range, 34, 0, 9));
+   ck_assert(wal_range_has(range, 34, 0, 12));
+   ck_assert(!wal_range_has(range, 34, 0, 13));
+   ck_assert(!wal_range_has(range, 35, 0, 9));
+
+   pgmoneta_free_wal_range(range);
+}
+END_TEST
+START_TEST(test_wal_range_time)
+{
+   struct wal_range* range = NULL;
+
+   /* The segments 2 to 5 of timeline 32 start a minute apart in the WAL index */
+   range = wal_range_compute(32, 0x2000028, 0x3000100, "time=2025-01-01 00:01:30+00,timeline=32");
+   ck_assert_ptr_nonnull(range);
+
+   ck_assert(wal_range_has(range, 32, 0, 2));
+   ck_assert(wal_range_has(range, 32, 0, 5));
+   ck_assert(!wal_range_has(range, 32, 0, 6));
+
+   pgmoneta_free_wal_range(range);
+
+   range = wal_range_compute(32, 0x2000028, 0x3000100, "time=2025-01-01 02:31:30+02:30,timeline=32");
+   ck_assert_ptr_nonnull(range);
+
+   ck_assert(wal_range_has(range, 32, 0, 5));
+   ck_assert(!wal_range_has(range, 32, 0, 6));
+
+   pgmoneta_free_wal_range(range);
+}
+END_TEST
+START_TEST(test_wal_range_time_without_zone)
+{
+   struct wal_range* range = NULL;
+
+   /* Without a time zone the latest time it could be is used, which is past the WAL index */
+   range = wal_range_compute(32, 0x2000028, 0x3000100, "time=2025-01-01 00:01:30,timeline=32");
+   ck_assert_ptr_nonnull(range);
+
+   ck_assert(!wal_range_has(range, 32, 0, 1));
+   ck_assert(wal_range_has(range, 32, 0, 6));
+   ck_assert(wal_range_has(range, 32, 1, 0));
+
+   pgmoneta_free_wal_range(range);
+}
+END_TEST
+START_TEST(test_wal_range_name_xid)
+{
+   struct wal_range* range = NULL;
+
+   /* Only replaying the WAL finds a named restore point or a transaction */
+   range = wal_range_compute(32, 0x2000028, 0x3000100, "name=restore,timeline=33");
+   ck_assert_ptr_nonnull(range);
+
+   ck_assert(wal_range_has(range, 32, 0, 5));
+   ck_assert(!wal_range_has(range, 32, 0, 6));
+   ck_assert(wal_range_has(range, 33, 0, 5));
+   ck_assert(wal_range_has(range, 33, 1, 5));
+
+   pgmoneta_free_wal_range(range);
+
+   range = wal_range_compute(32, 0x2000028, 0x3000100, "xid=1000,timeline=33");
+   ck_assert_ptr_nonnull(range);
+
+   ck_assert(!wal_range_has(range, 32, 0, 6));
+   ck_assert(wal_range_has(range, 33, 1, 5));
+
+   pgmoneta_free_wal_range(range);
+}
+END_TEST
+START_TEST(test_wal_range_not_ancestor)
+{
+   struct wal_range* range = NULL;
+
+   /* Timeline 35 comes from 32 at 0/3000000, so a backup on 33 isn't on its path */
+   range = wal_range_compute(33, 0x6000028, 0x7000100, "lsn=0/8000000,timeline=35");
+   ck_assert_ptr_null(range);
+
+   ck_assert(pgmoneta_wal_range_contains(range, "000000230000000000000008"));
+   ck_assert(pgmoneta_wal_range_contains(range, "000000210000000000000001"));
+}
+END_TEST
 
 Suite*
 pgmoneta_test_wal_utils_suite()
 {
    Suite* s;
    TCase* tc_wal_utils;
+   TCase* tc_wal_range;
    s = suite_create("pgmoneta_test_wal_utils");
 
    tc_wal_utils = tcase_create("test_wal_utils");
    tcase_add_checked_fixture(tc_wal_utils, pgmoneta_test_setup, pgmoneta_test_basedir_cleanup);
    tcase_set_timeout(tc_wal_utils, 60);
    tcase_add_test(tc_wal_utils, test_check_point_shutdown_v17);
+   tcase_add_test(tc_wal_utils, test_check_point_shutdown_v17_filtered);
+   tcase_add_test(tc_wal_utils, test_subtransaction_v17);
+   tcase_add_test(tc_wal_utils, test_subtransaction_v17_filtered);
    suite_add_tcase(s, tc_wal_utils);
 
+   tc_wal_range = tcase_create("test_wal_range");
+   tcase_add_checked_fixture(tc_wal_range, wal_range_setup, wal_range_teardown);
+   tcase_set_timeout(tc_wal_range, 60);
+   tcase_add_test(tc_wal_range, test_wal_range_current);
+   tcase_add_test(tc_wal_range, test_wal_range_lsn);
+   tcase_add_test(tc_wal_range, test_wal_range_timeline_switch);
+   tcase_add_test(tc_wal_range, test_wal_range_time);
+   tcase_add_test(tc_wal_range, test_wal_range_time_without_zone);
+   tcase_add_test(tc_wal_range, test_wal_range_name_xid);
+   tcase_add_test(tc_wal_range, test_wal_range_not_ancestor);
+   suite_add_tcase(s, tc_wal_range);
+
    return s;
 }
 
@@ -109,11 +293,7 @@ test_walfile(struct walfile* (*generate)(void))
    // 2. Write this structure to disk
    ck_assert_msg(!pgmoneta_write_walfile(wf, 0, path), "failed to write walfile to disk");
 
-   partial_record = malloc(sizeof(struct partial_xlog_record));
-   partial_record->data_buffer_bytes_read = 0;
-   partial_record->xlog_record_bytes_read = 0;
-   partial_record->xlog_record = NULL;
-   partial_record->data_buffer = NULL;
+   init_partial_record();
 
    // 3. Read the walfile from disk
    ck_assert_msg(!pgmoneta_read_walfile(0, path, &read_wf), "failed to read walfile from disk");
@@ -123,6 +303,109 @@ test_walfile(struct walfile* (*generate)(void))
 
    destroy_walfile(wf);
    destroy_walfile(read_wf);
+   destroy_partial_record();
+   free(path);
+}
+
+static void
+test_walfile_filtered(struct walfile* (*generate)(void))
+{
+   int skipped = 0;
+   int records = 0;
+   struct walfile* wf = NULL;
+   struct walfile* filtered_wf = NULL;
+   struct walfile* read_wf = NULL;
+   struct deque_iterator* iter = NULL;
+   char* dir = NULL;
+   char* path = NULL;
+   char* filtered_path = NULL;
+
+   dir = pgmoneta_append(dir, TEST_BASE_DIR);
+   dir = pgmoneta_append(dir, "/walfiles");
+   ck_assert(!pgmoneta_mkdir(dir));
+
+   path = pgmoneta_append(path, dir);
+   path = pgmoneta_append(path, RANDOM_WALFILE_NAME);
+
+   filtered_path = pgmoneta_append(filtered_path, dir);
+   filtered_path = pgmoneta_append(filtered_path, "/filtered");
+   ck_assert(!pgmoneta_mkdir(filtered_path));
+   filtered_path = pgmoneta_append(filtered_path, RANDOM_WALFILE_NAME);
+
+   wf = generate();
+   ck_assert_ptr_nonnull(wf);
+   ck_assert_msg(!pgmoneta_write_walfile(wf, 0, path), "failed to write walfile to disk");
+
+   // 1. Read the walfile without decoding any record
+   init_partial_record();
+   ck_assert_msg(!pgmoneta_read_walfile_filtered(0, path, skip_record, &skipped, &filtered_wf), "failed to read walfile from disk");
+   destroy_partial_record();
+
+   ck_assert(!pgmoneta_deque_iterator_create(filtered_wf->records, &iter));
+   while (pgmoneta_deque_iterator_next(iter))
+   {
+      struct decoded_xlog_record* rec = (struct decoded_xlog_record*)iter->value->data;
+
+      if (rec->partial)
+      {
+         continue;
+      }
+
+      records++;
+      ck_assert_ptr_nonnull(rec->raw);
+      ck_assert_ptr_null(rec->main_data);
+      ck_assert_uint_eq(rec->main_data_len, 0);
+      ck_assert_int_eq(rec->max_block_id, -1);
+   }
+   pgmoneta_deque_iterator_destroy(iter);
+
+   ck_assert_int_gt(records, 0);
+   ck_assert_int_eq(skipped, records);
+
+   // 2. The top-level XID is still read, from the block headers
+   compare_toplevel_xids(wf, filtered_wf);
+
+   // 3. The records that weren't decoded are written back unchanged
+   ck_assert_msg(!pgmoneta_write_walfile(filtered_wf, 0, filtered_path), "failed to write walfile to disk");
+
+   init_partial_record();
+   ck_assert_msg(!pgmoneta_read_walfile(0, filtered_path, &read_wf), "failed to read walfile from disk");
+   destroy_partial_record();
+
+   compare_walfile(wf, read_wf);
+
+   destroy_walfile(wf);
+   destroy_walfile(read_wf);
+   pgmoneta_destroy_walfile(filtered_wf);
+   free(filtered_path);
+   free(path);
+   free(dir);
+}
+
+static bool
+skip_record(struct xlog_record* record __attribute__((unused)), void* data)
+{
+   int* skipped = (int*)data;
+
+   (*skipped)++;
+
+   return false;
+}
+
+static void
+init_partial_record(void)
+{
+   partial_record = malloc(sizeof(struct partial_xlog_record));
+   ck_assert_ptr_nonnull(partial_record);
+   partial_record->data_buffer_bytes_read = 0;
+   partial_record->xlog_record_bytes_read = 0;
+   partial_record->xlog_record = NULL;
+   partial_record->data_buffer = NULL;
+}
+
+static void
+destroy_partial_record(void)
+{
    if (partial_record != NULL)
    {
       if (partial_record->xlog_record != NULL)
@@ -136,7 +419,6 @@ test_walfile(struct walfile* (*generate)(void))
       free(partial_record);
       partial_record = NULL;
    }
-   free(path);
 }
 
 static void
@@ -154,6 +436,30 @@ compare_walfile(struct walfile* wf1, struct walfile* wf2)
    compare_deque(wf1->records, wf2->records, compare_xlog_record);
 }
 
+static void
+compare_toplevel_xids(struct walfile* wf1, struct walfile* wf2)
+{
+   struct deque_iterator* iter1 = NULL;
+   struct deque_iterator* iter2 = NULL;
+
+   ck_assert_uint_eq(pgmoneta_deque_size(wf1->records), pgmoneta_deque_size(wf2->records));
+
+   ck_assert(pgmoneta_deque_iterator_create(wf1->records, &iter1) == 0 &&
+             pgmoneta_deque_iterator_create(wf2->records, &iter2) == 0);
+
+   while (pgmoneta_deque_iterator_next(iter1) && pgmoneta_deque_iterator_next(iter2))
+   {
+      struct decoded_xlog_record* rec1 = (struct decoded_xlog_record*)iter1->value->data;
+      struct decoded_xlog_record* rec2 = (struct decoded_xlog_record*)iter2->value->data;
+
+      ck_assert_uint_eq(rec1->header.xl_xid, rec2->header.xl_xid);
+      ck_assert_uint_eq(rec1->toplevel_xid, rec2->toplevel_xid);
+   }
+
+   pgmoneta_deque_iterator_destroy(iter1);
+   pgmoneta_deque_iterator_destroy(iter2);
+}
+
 static bool
 compare_long_page_headers(struct xlog_long_page_header_data* h1, struct xlog_long_page_header_data* h2)
 {
@@ -324,4 +630,152 @@ destroy_walfile(struct walfile* wf)
    }
 
    free(wf);
-}
\ No newline at end of file
+}
+static void
+wal_range_setup(void)
+{
+   char* wal_dir = NULL;
+   char* path = NULL;
+   char* saved = NULL;
+   char content[1024];
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   pgmoneta_test_setup();
+
+   wal_range_saved_size = config->common.servers[PRIMARY_SERVER].wal_size;
+   config->common.servers[PRIMARY_SERVER].wal_size = WAL_RANGE_SEGMENT_SIZE;
+
+   wal_dir = pgmoneta_get_server_wal(PRIMARY_SERVER);
+   pgmoneta_mkdir(wal_dir);
+
+   path = pgmoneta_append(NULL, wal_dir);
+   path = pgmoneta_append(path, "00000020.history");
+   wal_range_write(path, "1\t0/1000000\tno recovery target specified\n");
+   free(path);
+
+   path = pgmoneta_append(NULL, wal_dir);
+   path = pgmoneta_append(path, "00000021.history");
+   wal_range_write(path, "1\t0/1000000\tno recovery target specified\n"
+                   "32\t0/5000000\tno recovery target specified\n");
+   free(path);
+
+   path = pgmoneta_append(NULL, wal_dir);
+   path = pgmoneta_append(path, "00000022.history");
+   wal_range_write(path, "1\t0/1000000\tno recovery target specified\n"
+                   "32\t0/5000000\tno recovery target specified\n"
+                   "33\t0/9000000\tno recovery target specified\n");
+   free(path);
+
+   path = pgmoneta_append(NULL, wal_dir);
+   path = pgmoneta_append(path, "00000023.history");
+   wal_range_write(path, "1\t0/1000000\tno recovery target specified\n"
+                   "32\t0/3000000\tno recovery target specified\n");
+   free(path);
+
+   /* The WAL index of the test server is kept aside */
+   path = pgmoneta_get_server_wal_index(PRIMARY_SERVER);
+   saved = pgmoneta_append(NULL, path);
+   saved = pgmoneta_append(saved, ".saved");
+
+   if (pgmoneta_exists(path))
+   {
+      ck_assert(!rename(path, saved));
+   }
+
+   memset(&content[0], 0, sizeof(content));
+   for (int i = 0; i < 4; i++)
+   {
+      snprintf(&content[strlen(content)], sizeof(content) - strlen(content), "%08X%08X%08X %lld\n",
+               32, 0, 2 + i, (long long)WAL_RANGE_TIME + i * 60);
+   }
+   wal_range_write(path, &content[0]);
+
+   free(saved);
+   free(path);
+   free(wal_dir);
+}
+
+static void
+wal_range_teardown(void)
+{
+   char* wal_dir = NULL;
+   char* path = NULL;
+   char* saved = NULL;
+   char name[MISC_LENGTH];
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   wal_dir = pgmoneta_get_server_wal(PRIMARY_SERVER);
+
+   for (uint32_t tli = 32; tli <= 35; tli++)
+   {
+      memset(&name[0], 0, sizeof(name));
+      snprintf(&name[0], sizeof(name), "%08X.history", tli);
+
+      path = pgmoneta_append(NULL, wal_dir);
+      path = pgmoneta_append(path, &name[0]);
+      remove(path);
+      free(path);
+   }
+
+   path = pgmoneta_get_server_wal_index(PRIMARY_SERVER);
+   saved = pgmoneta_append(NULL, path);
+   saved = pgmoneta_append(saved, ".saved");
+
+   remove(path);
+   if (pgmoneta_exists(saved))
+   {
+      rename(saved, path);
+   }
+
+   config->common.servers[PRIMARY_SERVER].wal_size = wal_range_saved_size;
+
+   free(saved);
+   free(path);
+   free(wal_dir);
+
+   pgmoneta_test_teardown();
+}
+
+static void
+wal_range_write(char* path, char* content)
+{
+   FILE* file = NULL;
+
+   file = fopen(path, "w");
+   ck_assert_ptr_nonnull(file);
+   ck_assert_int_eq(fputs(content, file) >= 0, 1);
+   fclose(file);
+}
+
+static struct wal_range*
+wal_range_compute(uint32_t tli, uint64_t start, uint64_t end, char* position)
+{
+   struct backup backup;
+   struct wal_range* range = NULL;
+
+   memset(&backup, 0, sizeof(struct backup));
+   backup.start_timeline = tli;
+   backup.start_lsn_hi32 = (uint32_t)(start >> 32);
+   backup.start_lsn_lo32 = (uint32_t)(start & 0xFFFFFFFF);
+   backup.end_lsn_hi32 = (uint32_t)(end >> 32);
+   backup.end_lsn_lo32 = (uint32_t)(end & 0xFFFFFFFF);
+
+   ck_assert(!pgmoneta_wal_recovery_range(PRIMARY_SERVER, &backup, position, &range));
+
+   return range;
+}
+
+static bool
+wal_range_has(struct wal_range* range, uint32_t tli, uint32_t log, uint32_t seg)
+{
+   char file[MISC_LENGTH];
+
+   memset(&file[0], 0, sizeof(file));
+   snprintf(&file[0], sizeof(file), "%08X%08X%08X", tli, log, seg);
+
+   return pgmoneta_wal_range_contains(range, &file[0]);
+}